@@ -149,6 +149,7 @@
         'cpu_unittest.cc',
         'debug/leak_tracker_unittest.cc',
         'debug/stack_trace_unittest.cc',
+        'debug/trace_event_binary_unittest.cc',
         'debug/trace_event_unittest.cc',
         'debug/trace_event_win_unittest.cc',
         'dir_reader_posix_unittest.cc',
@@ -171,6 +172,7 @@
         'i18n/time_formatting_unittest.cc',
         'json/json_parser_unittest.cc',
         'json/json_reader_unittest.cc',
+        'json/json_stream_reader_unittest.cc',
         'json/json_value_converter_unittest.cc',
         'json/json_value_serializer_unittest.cc',
         'json/json_writer_unittest.cc',
@@ -201,6 +203,7 @@
         'message_pump_glib_unittest.cc',
         'message_pump_libevent_unittest.cc',
         'metrics/field_trial_unittest.cc',
+        'metrics/histogram_shared_memory_unittest.cc',
         'metrics/histogram_unittest.cc',
         'metrics/stats_table_unittest.cc',
         'observer_list_unittest.cc',
@@ -513,6 +516,8 @@
       ],
       'sources': [
         'perftimer.cc',
+        'test/perf_test_threads.cc',
+        'test/perf_test_threads.h',
         'test/run_all_perftests.cc',
       ],
       'direct_dependent_settings': {
@@ -532,6 +537,24 @@
         }],
       ],
     },
+    {
+      'target_name': 'base_perftests',
+      'type': 'executable',
+      'dependencies': [
+        'base',
+        'test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'sources': [
+        'debug/trace_event_perftest.cc',
+        'metrics/histogram_perftest.cc',
+        'tracked_objects_perftest.cc',
+        'utf_string_conversions_perftest.cc',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+    },
   ],
   'conditions': [
     ['OS == "android"', {
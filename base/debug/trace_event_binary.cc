@@ -0,0 +1,426 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "base/debug/trace_event.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const char kMagic[] = "CRTRACE1";
+const size_t kMagicSize = sizeof(kMagic) - 1;
+
+enum RecordType {
+  kStringRecord = 1,
+  kThreadEventsRecord = 2,
+};
+
+void AppendVarint(uint64 value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+// Zigzag encodes |value|, so that small negative values stay short.
+void AppendSignedVarint(int64 value, std::string* out) {
+  AppendVarint((static_cast<uint64>(value) << 1) ^
+               static_cast<uint64>(value >> 63), out);
+}
+
+void AppendValue(unsigned char type,
+                 TraceEvent::TraceValue value,
+                 std::string* out) {
+  switch (type) {
+    case TRACE_VALUE_TYPE_BOOL:
+      out->push_back(value.as_bool ? 1 : 0);
+      break;
+    case TRACE_VALUE_TYPE_INT:
+      AppendSignedVarint(value.as_int, out);
+      break;
+    case TRACE_VALUE_TYPE_DOUBLE: {
+      uint64 bits;
+      memcpy(&bits, &value.as_double, sizeof(bits));
+      for (size_t i = 0; i < sizeof(bits); ++i)
+        out->push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+      break;
+    }
+    case TRACE_VALUE_TYPE_POINTER:
+      AppendVarint(reinterpret_cast<uintptr_t>(value.as_pointer), out);
+      break;
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING:
+      // The length is offset by one, so that zero stands for NULL.
+      if (!value.as_string) {
+        AppendVarint(0, out);
+      } else {
+        size_t length = strlen(value.as_string);
+        AppendVarint(length + 1, out);
+        out->append(value.as_string, length);
+      }
+      break;
+    default:
+      NOTREACHED() << "Unknown trace value type " << static_cast<int>(type);
+      // Fall through.
+    case TRACE_VALUE_TYPE_UINT:
+      AppendVarint(value.as_uint, out);
+      break;
+  }
+}
+
+// Reads the fields of a binary trace in order.
+class BinaryTraceReader {
+ public:
+  // Reads |data| from offset |pos|.
+  BinaryTraceReader(const std::string& data, size_t pos)
+      : data_(data),
+        pos_(pos) {
+  }
+
+  bool AtEnd() const { return pos_ == data_.size(); }
+
+  bool ReadByte(unsigned char* value) {
+    if (pos_ >= data_.size())
+      return false;
+    *value = static_cast<unsigned char>(data_[pos_++]);
+    return true;
+  }
+
+  bool ReadBytes(size_t size, std::string* value) {
+    if (size > data_.size() - pos_)
+      return false;
+    value->assign(data_, pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool ReadVarint(uint64* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      unsigned char byte;
+      if (!ReadByte(&byte))
+        return false;
+      *value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool ReadSignedVarint(int64* value) {
+    uint64 zigzag;
+    if (!ReadVarint(&zigzag))
+      return false;
+    *value = static_cast<int64>(zigzag >> 1) ^ -static_cast<int64>(zigzag & 1);
+    return true;
+  }
+
+  // Reads a string number, which must refer to one of |strings|.
+  bool ReadStringId(const std::vector<std::string>& strings, size_t* id) {
+    uint64 value;
+    if (!ReadVarint(&value) || value >= strings.size())
+      return false;
+    *id = static_cast<size_t>(value);
+    return true;
+  }
+
+  // Reads an argument value of type |type|. String values are stored in
+  // |string_value|, which |value| then points to.
+  bool ReadValue(unsigned char type,
+                 TraceEvent::TraceValue* value,
+                 std::string* string_value) {
+    switch (type) {
+      case TRACE_VALUE_TYPE_BOOL: {
+        unsigned char byte;
+        if (!ReadByte(&byte))
+          return false;
+        value->as_bool = byte != 0;
+        return true;
+      }
+      case TRACE_VALUE_TYPE_UINT:
+        return ReadVarint(&value->as_uint);
+      case TRACE_VALUE_TYPE_INT: {
+        int64 int_value;
+        if (!ReadSignedVarint(&int_value))
+          return false;
+        value->as_int = int_value;
+        return true;
+      }
+      case TRACE_VALUE_TYPE_DOUBLE: {
+        uint64 bits = 0;
+        for (size_t i = 0; i < sizeof(bits); ++i) {
+          unsigned char byte;
+          if (!ReadByte(&byte))
+            return false;
+          bits |= static_cast<uint64>(byte) << (8 * i);
+        }
+        memcpy(&value->as_double, &bits, sizeof(bits));
+        return true;
+      }
+      case TRACE_VALUE_TYPE_POINTER: {
+        uint64 pointer;
+        if (!ReadVarint(&pointer))
+          return false;
+        value->as_pointer =
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(pointer));
+        return true;
+      }
+      case TRACE_VALUE_TYPE_STRING:
+      case TRACE_VALUE_TYPE_COPY_STRING: {
+        uint64 length;
+        if (!ReadVarint(&length))
+          return false;
+        if (length == 0) {
+          value->as_string = NULL;
+          return true;
+        }
+        if (!ReadBytes(static_cast<size_t>(length - 1), string_value))
+          return false;
+        value->as_string = string_value->c_str();
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+ private:
+  const std::string& data_;
+  size_t pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceReader);
+};
+
+}  // namespace
+
+TraceBinaryWriter::TraceBinaryWriter() : file_(NULL), write_failed_(false) {
+}
+
+TraceBinaryWriter::~TraceBinaryWriter() {
+  if (file_)
+    file_util::CloseFile(file_);
+}
+
+bool TraceBinaryWriter::Open(const FilePath& path) {
+  AutoLock lock(lock_);
+  DCHECK(!file_);
+  file_ = file_util::OpenFile(path, "wb");
+  if (!file_)
+    return false;
+  buffer_.assign(kMagic, kMagicSize);
+  AppendVarint(static_cast<uint32>(TraceLog::GetInstance()->process_id()),
+               &buffer_);
+  WriteBufferLocked();
+  return true;
+}
+
+void TraceBinaryWriter::WriteEvents(const TraceEvent* events, size_t count) {
+  AutoLock lock(lock_);
+  if (!file_ || !count)
+    return;
+
+  // Group the events by thread, keeping them in order.
+  std::vector<int> thread_ids;
+  base::hash_map<int, std::vector<const TraceEvent*> > thread_events;
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<const TraceEvent*>& events_of_thread =
+        thread_events[events[i].thread_id()];
+    if (events_of_thread.empty())
+      thread_ids.push_back(events[i].thread_id());
+    events_of_thread.push_back(&events[i]);
+  }
+
+  buffer_.clear();
+  for (size_t i = 0; i < thread_ids.size(); ++i) {
+    const std::vector<const TraceEvent*>& events_of_thread =
+        thread_events[thread_ids[i]];
+    AppendThreadEventsLocked(thread_ids[i], &events_of_thread[0],
+                             events_of_thread.size());
+  }
+  WriteBufferLocked();
+}
+
+bool TraceBinaryWriter::Flush() {
+  AutoLock lock(lock_);
+  if (file_ && fflush(file_) != 0)
+    write_failed_ = true;
+  return !write_failed_;
+}
+
+uint32 TraceBinaryWriter::InternStringLocked(const char* str, bool is_static) {
+  lock_.AssertAcquired();
+  if (is_static) {
+    base::hash_map<const char*, uint32>::const_iterator it =
+        static_string_ids_.find(str);
+    if (it != static_string_ids_.end())
+      return it->second;
+  }
+
+  std::string value(str);
+  uint32 id;
+  base::hash_map<std::string, uint32>::const_iterator it =
+      string_ids_.find(value);
+  if (it != string_ids_.end()) {
+    id = it->second;
+  } else {
+    id = static_cast<uint32>(string_ids_.size());
+    string_ids_[value] = id;
+    buffer_.push_back(kStringRecord);
+    AppendVarint(value.size(), &buffer_);
+    buffer_.append(value);
+  }
+  if (is_static)
+    static_string_ids_[str] = id;
+  return id;
+}
+
+void TraceBinaryWriter::AppendThreadEventsLocked(
+    int thread_id,
+    const TraceEvent* const* events,
+    size_t count) {
+  lock_.AssertAcquired();
+  // The strings of the events are appended to |buffer_| as they are found,
+  // so the events go after them.
+  std::string record;
+  int64& last_timestamp = last_timestamps_[thread_id];
+  for (size_t i = 0; i < count; ++i) {
+    const TraceEvent& event = *events[i];
+    // The name and argument names of copied events may be freed with them.
+    bool is_static = !(event.flags() & TRACE_EVENT_FLAG_COPY);
+
+    int64 timestamp = event.timestamp().ToInternalValue();
+    AppendSignedVarint(timestamp - last_timestamp, &record);
+    last_timestamp = timestamp;
+    record.push_back(event.phase());
+    AppendVarint(InternStringLocked(
+        TraceLog::GetCategoryName(event.category_enabled()), true), &record);
+    AppendVarint(InternStringLocked(event.name(), is_static), &record);
+    record.push_back(static_cast<char>(event.flags()));
+    if (event.flags() & TRACE_EVENT_FLAG_HAS_ID)
+      AppendVarint(event.id(), &record);
+
+    int num_args = 0;
+    while (num_args < kTraceMaxNumArgs && event.arg_name(num_args))
+      ++num_args;
+    record.push_back(static_cast<char>(num_args));
+    for (int j = 0; j < num_args; ++j) {
+      AppendVarint(InternStringLocked(event.arg_name(j), is_static), &record);
+      record.push_back(static_cast<char>(event.arg_type(j)));
+      AppendValue(event.arg_type(j), event.arg_value(j), &record);
+    }
+  }
+
+  buffer_.push_back(kThreadEventsRecord);
+  AppendVarint(static_cast<uint32>(thread_id), &buffer_);
+  AppendVarint(count, &buffer_);
+  buffer_.append(record);
+}
+
+void TraceBinaryWriter::WriteBufferLocked() {
+  lock_.AssertAcquired();
+  if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size())
+    write_failed_ = true;
+}
+
+bool ConvertBinaryTraceToJSON(const std::string& binary_trace,
+                              std::string* json) {
+  json->clear();
+  if (binary_trace.compare(0, kMagicSize, kMagic) != 0)
+    return false;
+  BinaryTraceReader reader(binary_trace, kMagicSize);
+  uint64 process_id;
+  if (!reader.ReadVarint(&process_id))
+    return false;
+
+  std::vector<std::string> strings;
+  base::hash_map<int, int64> last_timestamps;
+  bool first_event = true;
+  *json += "[";
+  while (!reader.AtEnd()) {
+    unsigned char record_type;
+    if (!reader.ReadByte(&record_type))
+      return false;
+
+    if (record_type == kStringRecord) {
+      uint64 length;
+      std::string value;
+      if (!reader.ReadVarint(&length) ||
+          !reader.ReadBytes(static_cast<size_t>(length), &value))
+        return false;
+      strings.push_back(value);
+      continue;
+    }
+
+    if (record_type != kThreadEventsRecord)
+      return false;
+    uint64 thread_id;
+    uint64 count;
+    if (!reader.ReadVarint(&thread_id) || !reader.ReadVarint(&count))
+      return false;
+    int64& timestamp = last_timestamps[static_cast<int>(thread_id)];
+    for (uint64 i = 0; i < count; ++i) {
+      int64 delta;
+      unsigned char phase;
+      size_t category;
+      size_t name;
+      unsigned char flags;
+      uint64 id = 0;
+      unsigned char num_args;
+      if (!reader.ReadSignedVarint(&delta) ||
+          !reader.ReadByte(&phase) ||
+          !reader.ReadStringId(strings, &category) ||
+          !reader.ReadStringId(strings, &name) ||
+          !reader.ReadByte(&flags) ||
+          ((flags & TRACE_EVENT_FLAG_HAS_ID) && !reader.ReadVarint(&id)) ||
+          !reader.ReadByte(&num_args) ||
+          num_args > kTraceMaxNumArgs)
+        return false;
+      timestamp += delta;
+
+      const char* arg_names[kTraceMaxNumArgs];
+      unsigned char arg_types[kTraceMaxNumArgs];
+      unsigned long long arg_values[kTraceMaxNumArgs];
+      std::string string_values[kTraceMaxNumArgs];
+      for (int j = 0; j < num_args; ++j) {
+        size_t arg_name;
+        TraceEvent::TraceValue value;
+        value.as_uint = 0;
+        if (!reader.ReadStringId(strings, &arg_name) ||
+            !reader.ReadByte(&arg_types[j]) ||
+            !reader.ReadValue(arg_types[j], &value, &string_values[j]))
+          return false;
+        arg_names[j] = strings[arg_name].c_str();
+        arg_values[j] = value.as_uint;
+      }
+
+      // The event copies the strings, which only live until the next one.
+      TraceEvent event(static_cast<int>(thread_id),
+                       TimeTicks::FromInternalValue(timestamp),
+                       phase, NULL, strings[name].c_str(), id,
+                       num_args, arg_names, arg_types, arg_values,
+                       flags | TRACE_EVENT_FLAG_COPY);
+      if (!first_event)
+        *json += ",";
+      first_event = false;
+      event.AppendAsJSON(strings[category].c_str(),
+                         static_cast<int>(process_id), json);
+    }
+  }
+  *json += "]";
+  return true;
+}
+
+}  // namespace debug
+}  // namespace base
@@ -0,0 +1,110 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A compact binary format for trace events, which TraceLog can write to a
+// file while tracing instead of handing JSON to its output callback. Long
+// traces are much smaller and cheaper to produce this way;
+// ConvertBinaryTraceToJSON() turns them into the usual JSON when needed.
+//
+// The file starts with the magic "CRTRACE1" and the process id, followed by
+// records which each start with a type byte:
+//   kStringRecord:       The length and bytes of a string. Strings are
+//                        numbered in the order they appear; events refer to
+//                        categories, names and argument names by number, so
+//                        each is only written once.
+//   kThreadEventsRecord: The thread id, the number of events, and that many
+//                        events of the thread. The timestamp of each event is
+//                        stored as the difference from the previous event of
+//                        the same thread.
+// Integers are written as LEB128 varints, with signed ones zigzag encoded.
+
+#ifndef BASE_DEBUG_TRACE_EVENT_BINARY_H_
+#define BASE_DEBUG_TRACE_EVENT_BINARY_H_
+#pragma once
+
+#include <stdio.h>
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+
+class FilePath;
+
+namespace base {
+namespace debug {
+
+class TraceEvent;
+
+// Encodes trace events and appends them to a file. Events can be written
+// from any thread.
+class BASE_EXPORT TraceBinaryWriter
+    : public base::RefCountedThreadSafe<TraceBinaryWriter> {
+ public:
+  TraceBinaryWriter();
+
+  // Creates or truncates the file at |path|, and writes the header with the
+  // process id of TraceLog. Returns false if the file could not be created.
+  bool Open(const FilePath& path);
+
+  // Writes |count| events, grouping them by thread. Timestamps take the least
+  // room when the events of each thread are written in timestamp order.
+  void WriteEvents(const TraceEvent* events, size_t count);
+
+  // Writes out the data buffered by the file. Returns false if any write
+  // since Open() failed, in which case the file is incomplete.
+  bool Flush();
+
+ private:
+  friend class base::RefCountedThreadSafe<TraceBinaryWriter>;
+
+  ~TraceBinaryWriter();
+
+  // Returns the number of the string |str|, appending a kStringRecord for it
+  // to |buffer_| if it is new. If |is_static| is set, |str| is known to live
+  // as long as the process, and is looked up by address first.
+  uint32 InternStringLocked(const char* str, bool is_static);
+
+  // Appends the kThreadEventsRecord of |count| events of |thread_id|, pointed
+  // to by |events|, to |buffer_|.
+  void AppendThreadEventsLocked(int thread_id,
+                                const TraceEvent* const* events,
+                                size_t count);
+
+  // Writes |buffer_| to |file_|, and records whether that failed.
+  void WriteBufferLocked();
+
+  Lock lock_;
+
+  FILE* file_;
+
+  // Set when a write to |file_| fails.
+  bool write_failed_;
+
+  // The numbers of the strings written so far.
+  base::hash_map<const char*, uint32> static_string_ids_;
+  base::hash_map<std::string, uint32> string_ids_;
+
+  // The timestamp of the last event written for each thread.
+  base::hash_map<int, int64> last_timestamps_;
+
+  // The records being written by WriteEvents().
+  std::string buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBinaryWriter);
+};
+
+// Converts |binary_trace|, as written by TraceBinaryWriter, to the JSON array
+// of events that TraceResultBuffer produces, in |json|. Returns false if
+// |binary_trace| is not a valid binary trace.
+BASE_EXPORT bool ConvertBinaryTraceToJSON(const std::string& binary_trace,
+                                          std::string* json);
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_TRACE_EVENT_BINARY_H_
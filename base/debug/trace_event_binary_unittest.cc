@@ -0,0 +1,232 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/debug/trace_event.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/json/json_reader.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/scoped_temp_dir.h"
+#include "base/threading/platform_thread.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+class TraceEventBinaryTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("trace");
+    TraceLog::DeleteForTesting();
+    TraceLog::Resurrect();
+    old_thread_name_ = PlatformThread::GetName();
+  }
+
+  virtual void TearDown() OVERRIDE {
+    PlatformThread::SetName(old_thread_name_ ? old_thread_name_ : "");
+  }
+
+  // Converts the binary trace at |path_| to JSON.
+  bool ReadAsJSON(std::string* json) {
+    std::string binary_trace;
+    return file_util::ReadFileToString(path_, &binary_trace) &&
+           ConvertBinaryTraceToJSON(binary_trace, json);
+  }
+
+  // Returns an event of |thread_id| with the given arguments.
+  static TraceEvent MakeEvent(int thread_id,
+                              int64 timestamp,
+                              const char* name,
+                              const char* arg_name,
+                              unsigned char arg_type,
+                              unsigned long long arg_value,
+                              unsigned char flags) {
+    return TraceEvent(thread_id, TimeTicks::FromInternalValue(timestamp),
+                      TRACE_EVENT_PHASE_INSTANT,
+                      TraceLog::GetCategoryEnabled("binary"), name, 42,
+                      arg_name ? 1 : 0, &arg_name, &arg_type, &arg_value,
+                      flags);
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  const char* old_thread_name_;
+
+ private:
+  // The TraceLog is torn down after each test.
+  ShadowingAtExitManager at_exit_manager_;
+};
+
+}  // namespace
+
+// Each kind of event converts to the JSON that TraceLog would have produced.
+TEST_F(TraceEventBinaryTest, SameJSONAsTraceLog) {
+  union {
+    double as_double;
+    const void* as_pointer;
+    const char* as_string;
+    unsigned long long as_uint;
+  } value;
+  std::vector<TraceEvent> events;
+  events.push_back(MakeEvent(1, 1000, "none", NULL, 0, 0,
+                             TRACE_EVENT_FLAG_NONE));
+  events.push_back(MakeEvent(1, 1005, "bool", "b", TRACE_VALUE_TYPE_BOOL, 1,
+                             TRACE_EVENT_FLAG_NONE));
+  events.push_back(MakeEvent(1, 999, "int", "i", TRACE_VALUE_TYPE_INT,
+                             static_cast<unsigned long long>(-12345),
+                             TRACE_EVENT_FLAG_HAS_ID));
+  events.push_back(MakeEvent(1, 2000000, "uint", "u", TRACE_VALUE_TYPE_UINT,
+                             0xfedcba9876543210ULL, TRACE_EVENT_FLAG_NONE));
+  value.as_uint = 0;
+  value.as_double = 3.25;
+  events.push_back(MakeEvent(1, 2000001, "double", "d",
+                             TRACE_VALUE_TYPE_DOUBLE, value.as_uint,
+                             TRACE_EVENT_FLAG_NONE));
+  value.as_uint = 0;
+  value.as_pointer = &events;
+  events.push_back(MakeEvent(1, 2000002, "pointer", "p",
+                             TRACE_VALUE_TYPE_POINTER, value.as_uint,
+                             TRACE_EVENT_FLAG_NONE));
+  value.as_uint = 0;
+  value.as_string = "with \"quotes\" and \\";
+  events.push_back(MakeEvent(1, 2000003, "string", "s",
+                             TRACE_VALUE_TYPE_STRING, value.as_uint,
+                             TRACE_EVENT_FLAG_NONE));
+  value.as_uint = 0;
+  value.as_string = NULL;
+  events.push_back(MakeEvent(1, 2000004, "null", "s", TRACE_VALUE_TYPE_STRING,
+                             value.as_uint, TRACE_EVENT_FLAG_NONE));
+  std::string copied_name("copied");
+  value.as_string = copied_name.c_str();
+  events.push_back(MakeEvent(2, 1500, copied_name.c_str(), "c",
+                             TRACE_VALUE_TYPE_COPY_STRING, value.as_uint,
+                             TRACE_EVENT_FLAG_COPY));
+  events.push_back(MakeEvent(2, 1400, "none", NULL, 0, 0,
+                             TRACE_EVENT_FLAG_NONE));
+
+  scoped_refptr<TraceBinaryWriter> writer(new TraceBinaryWriter);
+  ASSERT_TRUE(writer->Open(path_));
+  writer->WriteEvents(&events[0], 4);
+  writer->WriteEvents(&events[4], events.size() - 4);
+  writer = NULL;
+
+  std::string expected = "[";
+  TraceEvent::AppendEventsAsJSON(events, 0, events.size(), &expected);
+  expected += "]";
+  std::string json;
+  ASSERT_TRUE(ReadAsJSON(&json));
+  EXPECT_EQ(expected, json);
+}
+
+// The events are written to the file while tracing, and the rest when tracing
+// is disabled.
+TEST_F(TraceEventBinaryTest, WrittenWhileTracing) {
+  const int kNumEvents = 5000;
+  PlatformThread::SetName("binary_thread");
+
+  scoped_refptr<TraceBinaryWriter> writer(new TraceBinaryWriter);
+  ASSERT_TRUE(writer->Open(path_));
+  TraceLog::GetInstance()->SetBinaryWriter(writer);
+  TraceLog::GetInstance()->SetEnabled("binary");
+  for (int i = 0; i < kNumEvents; ++i)
+    TRACE_EVENT_INSTANT1("binary", "event", "i", i);
+
+  // The writer thread has been handed most of the events, and writes them
+  // while tracing.
+  TraceLog::GetInstance()->WaitForBinaryWriterForTesting();
+  EXPECT_TRUE(writer->Flush());
+  int64 size_while_tracing = 0;
+  ASSERT_TRUE(file_util::GetFileSize(path_, &size_while_tracing));
+  EXPECT_GT(size_while_tracing, 1000);
+
+  TraceLog::GetInstance()->SetDisabled();
+  TraceLog::GetInstance()->SetBinaryWriter(NULL);
+  writer = NULL;
+
+  std::string json;
+  ASSERT_TRUE(ReadAsJSON(&json));
+  int64 size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(path_, &size));
+  scoped_ptr<Value> root(base::JSONReader::Read(json));
+  ListValue* events = NULL;
+  ASSERT_TRUE(root.get());
+  ASSERT_TRUE(root->GetAsList(&events));
+
+  int next_arg = 0;
+  bool found_thread_name = false;
+  for (size_t i = 0; i < events->GetSize(); ++i) {
+    DictionaryValue* event = NULL;
+    ASSERT_TRUE(events->GetDictionary(i, &event));
+    std::string name;
+    ASSERT_TRUE(event->GetString("name", &name));
+    if (name == "thread_name") {
+      std::string thread_name;
+      EXPECT_TRUE(event->GetString("args.name", &thread_name));
+      found_thread_name |= thread_name == "binary_thread";
+      continue;
+    }
+    EXPECT_EQ("event", name);
+    int arg = -1;
+    EXPECT_TRUE(event->GetInteger("args.i", &arg));
+    EXPECT_EQ(next_arg++, arg);
+  }
+  EXPECT_EQ(kNumEvents, next_arg);
+  EXPECT_TRUE(found_thread_name);
+
+  // Each event takes a fraction of its size as JSON.
+  EXPECT_LT(size * 3, static_cast<int64>(json.size()));
+}
+
+#if defined(OS_LINUX)
+// Failed writes are reported by Flush().
+TEST_F(TraceEventBinaryTest, ReportsWriteErrors) {
+  std::vector<TraceEvent> events;
+  events.push_back(MakeEvent(1, 1000, "event", "i", TRACE_VALUE_TYPE_INT, 5,
+                             TRACE_EVENT_FLAG_NONE));
+  scoped_refptr<TraceBinaryWriter> writer(new TraceBinaryWriter);
+  ASSERT_TRUE(writer->Open(FilePath("/dev/full")));
+  writer->WriteEvents(&events[0], events.size());
+  EXPECT_FALSE(writer->Flush());
+}
+#endif
+
+TEST_F(TraceEventBinaryTest, InvalidTraces) {
+  std::vector<TraceEvent> events;
+  events.push_back(MakeEvent(1, 1000, "event", "i", TRACE_VALUE_TYPE_INT, 5,
+                             TRACE_EVENT_FLAG_NONE));
+  scoped_refptr<TraceBinaryWriter> writer(new TraceBinaryWriter);
+  ASSERT_TRUE(writer->Open(path_));
+  writer->WriteEvents(&events[0], events.size());
+  writer = NULL;
+
+  std::string binary_trace;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &binary_trace));
+  std::string json;
+  EXPECT_TRUE(ConvertBinaryTraceToJSON(binary_trace, &json));
+
+  // Truncated anywhere but between records.
+  EXPECT_FALSE(ConvertBinaryTraceToJSON(
+      binary_trace.substr(0, binary_trace.size() - 1), &json));
+  EXPECT_FALSE(ConvertBinaryTraceToJSON(binary_trace.substr(0, 4), &json));
+
+  // Unknown record type.
+  EXPECT_FALSE(ConvertBinaryTraceToJSON(binary_trace + '\x7f', &json));
+
+  // Not a binary trace.
+  EXPECT_FALSE(ConvertBinaryTraceToJSON("[{\"cat\":\"binary\"}]", &json));
+}
+
+}  // namespace debug
+}  // namespace base
@@ -8,6 +8,7 @@
 
 #include "base/bind.h"
 #include "base/debug/trace_event.h"
+#include "base/debug/trace_event_binary.h"
 #include "base/file_util.h"
 #include "base/format_macros.h"
 #include "base/lazy_instance.h"
@@ -16,11 +17,13 @@
 #include "base/stringprintf.h"
 #include "base/string_tokenizer.h"
 #include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
 #include "base/threading/thread_local.h"
 #include "base/utf_string_conversions.h"
 #include "base/stl_util.h"
 #include "base/sys_info.h"
 #include "base/third_party/dynamic_annotations/dynamic_annotations.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/time.h"
 
 #if defined(OS_WIN)
@@ -43,6 +46,20 @@ namespace debug {
 const size_t kTraceEventBufferSize = 500000;
 const size_t kTraceEventBatchSize = 1000;
 
+// The number of events in each chunk of the trace buffer. A thread only takes
+// the lock when it fills a chunk.
+const int kTraceEventChunkSize = 64;
+const size_t kTraceEventMaxChunks = kTraceEventBufferSize /
+                                    kTraceEventChunkSize;
+
+// The number of retired chunks which are written out together when writing
+// to a TraceBinaryWriter.
+const size_t kTraceEventBinaryBatchChunks = kTraceEventBatchSize /
+                                            kTraceEventChunkSize;
+
+// Event ids wrap around within the range of positive ints.
+const unsigned int kTraceEventIdMask = 0x7fffffff;
+
 #define TRACE_EVENT_MAX_CATEGORIES 100
 
 namespace {
@@ -68,6 +85,18 @@ int g_category_index = 3; // skip initial 3 categories
 LazyInstance<ThreadLocalPointer<const char> >::Leaky
     g_current_thread_name = LAZY_INSTANCE_INITIALIZER;
 
+// Holds the TraceLog::ThreadLocalEventBuffer of each thread.
+ThreadLocalStorage::StaticSlot g_event_buffer_slot = TLS_INITIALIZER;
+
+// The generation of the last TraceLog created, and of the one which is alive,
+// if any.
+base::subtle::Atomic32 g_last_generation = 0;
+base::subtle::Atomic32 g_live_generation = 0;
+
+bool TimestampLess(const TraceEvent& a, const TraceEvent& b) {
+  return a.timestamp() < b.timestamp();
+}
+
 void AppendValueAsJSON(unsigned char type,
                        TraceEvent::TraceValue value,
                        std::string* out) {
@@ -235,14 +264,21 @@ void TraceEvent::AppendEventsAsJSON(const std::vector<TraceEvent>& events,
 }
 
 void TraceEvent::AppendAsJSON(std::string* out) const {
+  AppendAsJSON(TraceLog::GetCategoryName(category_enabled_),
+               TraceLog::GetInstance()->process_id(),
+               out);
+}
+
+void TraceEvent::AppendAsJSON(const char* category_name,
+                              int process_id,
+                              std::string* out) const {
   int64 time_int64 = timestamp_.ToInternalValue();
-  int process_id = TraceLog::GetInstance()->process_id();
   // Category name checked at category creation time.
   DCHECK(!strchr(name_, '"'));
   StringAppendF(out,
       "{\"cat\":\"%s\",\"pid\":%i,\"tid\":%i,\"ts\":%" PRId64 ","
       "\"ph\":\"%c\",\"name\":\"%s\",\"args\":{",
-      TraceLog::GetCategoryName(category_enabled_),
+      category_name,
       process_id,
       thread_id_,
       time_int64,
@@ -316,14 +352,80 @@ void TraceResultBuffer::Finish() {
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+struct TraceLog::Chunk {
+  Chunk() : size(0), flushed(0) {}
+
+  TraceEvent events[kTraceEventChunkSize];
+
+  // The number of events written. Only the thread writing into the chunk
+  // changes it without the lock, and it publishes each event by storing the
+  // new size with a release barrier.
+  base::subtle::Atomic32 size;
+
+  // The number of events which have been flushed. Guarded by the lock.
+  int flushed;
+};
+
+struct TraceLog::ThreadLocalEventBuffer {
+  ThreadLocalEventBuffer()
+      : trace_log(NULL),
+        generation(0),
+        thread_id(static_cast<int>(PlatformThread::CurrentId())),
+        chunk(NULL),
+        chunk_id(0) {}
+
+  // The TraceLog which owns |chunk|, valid while |generation| is live.
+  TraceLog* trace_log;
+  int generation;
+
+  int thread_id;
+
+  // The chunk the thread writes into, or NULL.
+  Chunk* chunk;
+
+  // The id of the first event of |chunk|. The id of an event is its position
+  // in the sequence of events written by the thread.
+  unsigned int chunk_id;
+};
+
+class TraceLog::BinaryWriterThread : public SimpleThread {
+ public:
+  BinaryWriterThread(TraceLog* trace_log, TraceBinaryWriter* writer)
+      : SimpleThread("TraceBinaryWriter"),
+        trace_log_(trace_log),
+        writer_(writer) {
+  }
+
+  virtual void Run() OVERRIDE {
+    trace_log_->WriteBinaryChunksUntilStopped(writer_);
+  }
+
+ private:
+  TraceLog* trace_log_;
+  scoped_refptr<TraceBinaryWriter> writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryWriterThread);
+};
+
 // static
 TraceLog* TraceLog::GetInstance() {
   return Singleton<TraceLog, StaticMemorySingletonTraits<TraceLog> >::get();
 }
 
 TraceLog::TraceLog()
-    : enabled_(false)
-    , dispatching_to_observer_list_(false) {
+    : enabled_(false),
+      record_mode_(RECORD_UNTIL_FULL),
+      buffer_full_callback_run_(false),
+      num_chunks_(0),
+      binary_writer_cv_(&lock_),
+      binary_chunks_being_written_(0),
+      stop_binary_writer_thread_(false),
+      generation_(base::subtle::NoBarrier_AtomicIncrement(&g_last_generation,
+                                                          1)),
+      dispatching_to_observer_list_(false) {
+  if (!g_event_buffer_slot.initialized())
+    g_event_buffer_slot.Initialize(&TraceLog::OnThreadExit);
+  base::subtle::Release_Store(&g_live_generation, generation_);
   // Trace is enabled or disabled on one thread while other threads are
   // accessing the enabled flag. We don't care whether edge-case events are
   // traced or not, so we allow races on the enabled flag to keep the trace
@@ -343,6 +445,10 @@ TraceLog::TraceLog()
 }
 
 TraceLog::~TraceLog() {
+  StopBinaryWriterThread();
+  base::subtle::Release_Store(&g_live_generation, 0);
+  STLDeleteElements(&live_chunks_);
+  STLDeleteElements(&retired_chunks_);
 }
 
 const unsigned char* TraceLog::GetCategoryEnabled(const char* name) {
@@ -447,7 +553,6 @@ void TraceLog::SetEnabled(const std::vector<std::string>& included_categories,
                     OnTraceLogWillEnable());
   dispatching_to_observer_list_ = false;
 
-  logged_events_.reserve(1024);
   enabled_ = true;
   included_categories_ = included_categories;
   excluded_categories_ = excluded_categories;
@@ -535,7 +640,14 @@ void TraceLog::RemoveEnabledStateObserver(
 }
 
 float TraceLog::GetBufferPercentFull() const {
-  return (float)((double)logged_events_.size()/(double)kTraceEventBufferSize);
+  return (float)((double)base::subtle::NoBarrier_Load(&num_chunks_) /
+                 (double)kTraceEventMaxChunks);
+}
+
+void TraceLog::SetRecordMode(RecordMode mode) {
+  AutoLock lock(lock_);
+  DCHECK(!enabled_);
+  record_mode_ = mode;
 }
 
 void TraceLog::SetOutputCallback(const TraceLog::OutputCallback& cb) {
@@ -543,6 +655,23 @@ void TraceLog::SetOutputCallback(const TraceLog::OutputCallback& cb) {
   output_callback_ = cb;
 }
 
+void TraceLog::SetBinaryWriter(TraceBinaryWriter* writer) {
+  {
+    AutoLock lock(lock_);
+    DCHECK(!enabled_);
+    binary_writer_ = NULL;
+  }
+  StopBinaryWriterThread();
+  if (!writer)
+    return;
+
+  scoped_ptr<BinaryWriterThread> thread(new BinaryWriterThread(this, writer));
+  thread->Start();
+  AutoLock lock(lock_);
+  binary_writer_ = writer;
+  binary_writer_thread_ = thread.Pass();
+}
+
 void TraceLog::SetBufferFullCallback(const TraceLog::BufferFullCallback& cb) {
   AutoLock lock(lock_);
   buffer_full_callback_ = cb;
@@ -551,12 +680,33 @@ void TraceLog::SetBufferFullCallback(const TraceLog::BufferFullCallback& cb) {
 void TraceLog::Flush() {
   std::vector<TraceEvent> previous_logged_events;
   OutputCallback output_callback_copy;
+  scoped_refptr<TraceBinaryWriter> binary_writer_copy;
+  std::vector<Chunk*> chunks_to_write;
   {
     AutoLock lock(lock_);
-    previous_logged_events.swap(logged_events_);
+    if (binary_writer_) {
+      // The retired chunks are written as they are, one thread at a time,
+      // rather than merged with the others. The batches handed to the writer
+      // thread go first, to keep the events of each thread in order.
+      WaitForBinaryWriterLocked();
+      binary_writer_copy = binary_writer_;
+      TakeRetiredChunksLocked(&chunks_to_write);
+    }
+    GetUnflushedEventsLocked(&previous_logged_events, true);
     output_callback_copy = output_callback_;
   }  // release lock
 
+  if (binary_writer_copy) {
+    WriteChunks(binary_writer_copy, chunks_to_write);
+    if (!previous_logged_events.empty()) {
+      binary_writer_copy->WriteEvents(&previous_logged_events[0],
+                                      previous_logged_events.size());
+    }
+    if (!binary_writer_copy->Flush())
+      LOG(ERROR) << "Failed to write the binary trace.";
+    return;
+  }
+
   if (output_callback_copy.is_null())
     return;
 
@@ -585,82 +735,309 @@ int TraceLog::AddTraceEvent(char phase,
                             long long threshold,
                             unsigned char flags) {
   DCHECK(name);
+  if (!*category_enabled)
+    return -1;
   TimeTicks now = TimeTicks::NowFromSystemTraceTime();
-  BufferFullCallback buffer_full_callback_copy;
-  int ret_begin_id = -1;
-  {
-    AutoLock lock(lock_);
-    if (!*category_enabled)
-      return -1;
-    if (logged_events_.size() >= kTraceEventBufferSize)
+  ThreadLocalEventBuffer* buffer = GetThreadLocalEventBuffer();
+
+  const char* new_name = PlatformThread::GetName();
+  // Check if the thread name has been set or changed since the previous
+  // call (if any), but don't bother if the new name is empty. Note this will
+  // not detect a thread name change within the same char* buffer address: we
+  // favor common case performance over corner case correctness.
+  if (new_name != g_current_thread_name.Get().Get() &&
+      new_name && *new_name) {
+    g_current_thread_name.Get().Set(new_name);
+    AddThreadName(buffer->thread_id, new_name);
+  }
+
+  if (threshold_begin_id > -1) {
+    DCHECK(phase == TRACE_EVENT_PHASE_END);
+    if (DropBeginEventIfShorter(buffer, threshold_begin_id, now, threshold))
       return -1;
+  }
 
-    int thread_id = static_cast<int>(PlatformThread::CurrentId());
-
-    const char* new_name = PlatformThread::GetName();
-    // Check if the thread name has been set or changed since the previous
-    // call (if any), but don't bother if the new name is empty. Note this will
-    // not detect a thread name change within the same char* buffer address: we
-    // favor common case performance over corner case correctness.
-    if (new_name != g_current_thread_name.Get().Get() &&
-        new_name && *new_name) {
-      g_current_thread_name.Get().Set(new_name);
-      base::hash_map<int, std::string>::iterator existing_name =
-          thread_names_.find(thread_id);
-      if (existing_name == thread_names_.end()) {
-        // This is a new thread id, and a new name.
-        thread_names_[thread_id] = new_name;
-      } else {
-        // This is a thread id that we've seen before, but potentially with a
-        // new name.
-        std::vector<base::StringPiece> existing_names;
-        Tokenize(existing_name->second, ",", &existing_names);
-        bool found = std::find(existing_names.begin(),
-                               existing_names.end(),
-                               new_name) != existing_names.end();
-        if (!found) {
-          existing_name->second.push_back(',');
-          existing_name->second.append(new_name);
-        }
+  if (flags & TRACE_EVENT_FLAG_MANGLE_ID)
+    id ^= process_id_hash_;
+
+  if (!buffer->chunk ||
+      base::subtle::NoBarrier_Load(&buffer->chunk->size) ==
+          kTraceEventChunkSize) {
+    BufferFullCallback buffer_full_callback_copy;
+    {
+      AutoLock lock(lock_);
+      if (binary_writer_ &&
+          retired_chunks_.size() + 1 >= kTraceEventBinaryBatchChunks) {
+        // Hand the full chunks to the writer thread, which writes them out
+        // and frees them.
+        TakeRetiredChunksLocked(&binary_chunks_to_write_);
+        binary_writer_cv_.Broadcast();
       }
-    }
-
-    if (threshold_begin_id > -1) {
-      DCHECK(phase == TRACE_EVENT_PHASE_END);
-      size_t begin_i = static_cast<size_t>(threshold_begin_id);
-      // Return now if there has been a flush since the begin event was posted.
-      if (begin_i >= logged_events_.size())
-        return -1;
-      // Determine whether to drop the begin/end pair.
-      TimeDelta elapsed = now - logged_events_[begin_i].timestamp();
-      if (elapsed < TimeDelta::FromMicroseconds(threshold)) {
-        // Remove begin event and do not add end event.
-        // This will be expensive if there have been other events in the
-        // mean time (should be rare).
-        logged_events_.erase(logged_events_.begin() + begin_i);
-        return -1;
+      if (!ReplaceChunkLocked(buffer) && !buffer_full_callback_run_) {
+        buffer_full_callback_run_ = true;
+        buffer_full_callback_copy = buffer_full_callback_;
       }
+    }  // release lock
+
+    if (!buffer_full_callback_copy.is_null())
+      buffer_full_callback_copy.Run();
+    if (!buffer->chunk)
+      return -1;
+  }
+
+  // Only this thread writes into its chunk, so the event can be added
+  // without the lock. Flush() only reads the events up to the published size.
+  Chunk* chunk = buffer->chunk;
+  int index = base::subtle::NoBarrier_Load(&chunk->size);
+  chunk->events[index] = TraceEvent(buffer->thread_id,
+                                    now, phase, category_enabled, name, id,
+                                    num_args, arg_names, arg_types, arg_values,
+                                    flags);
+  base::subtle::Release_Store(&chunk->size, index + 1);
+  return static_cast<int>((buffer->chunk_id + index) & kTraceEventIdMask);
+}
+
+TraceLog::ThreadLocalEventBuffer* TraceLog::GetThreadLocalEventBuffer() {
+  ThreadLocalEventBuffer* buffer =
+      static_cast<ThreadLocalEventBuffer*>(g_event_buffer_slot.Get());
+  if (!buffer) {
+    buffer = new ThreadLocalEventBuffer;
+    g_event_buffer_slot.Set(buffer);
+  }
+  if (buffer->generation != generation_) {
+    // The buffer was used by a TraceLog which has been deleted since, along
+    // with the chunk.
+    buffer->trace_log = this;
+    buffer->generation = generation_;
+    buffer->chunk = NULL;
+    buffer->chunk_id = 0;
+  }
+  return buffer;
+}
+
+void TraceLog::AddThreadName(int thread_id, const char* name) {
+  AutoLock lock(lock_);
+  base::hash_map<int, std::string>::iterator existing_name =
+      thread_names_.find(thread_id);
+  if (existing_name == thread_names_.end()) {
+    // This is a new thread id, and a new name.
+    thread_names_[thread_id] = name;
+  } else {
+    // This is a thread id that we've seen before, but potentially with a
+    // new name.
+    std::vector<base::StringPiece> existing_names;
+    Tokenize(existing_name->second, ",", &existing_names);
+    bool found = std::find(existing_names.begin(),
+                           existing_names.end(),
+                           name) != existing_names.end();
+    if (!found) {
+      existing_name->second.push_back(',');
+      existing_name->second.append(name);
     }
+  }
+}
+
+bool TraceLog::DropBeginEventIfShorter(ThreadLocalEventBuffer* buffer,
+                                       int threshold_begin_id,
+                                       TimeTicks now,
+                                       long long threshold) {
+  Chunk* chunk = buffer->chunk;
+  if (!chunk)
+    return true;
+  int size = base::subtle::NoBarrier_Load(&chunk->size);
+  unsigned int index = (static_cast<unsigned int>(threshold_begin_id) -
+                        buffer->chunk_id) & kTraceEventIdMask;
+  if (index >= static_cast<unsigned int>(size)) {
+    // The begin event is in a chunk which has been handed over for flushing,
+    // so keep the pair.
+    return false;
+  }
+  // Determine whether to drop the begin/end pair.
+  TimeDelta elapsed = now - chunk->events[index].timestamp();
+  if (elapsed >= TimeDelta::FromMicroseconds(threshold))
+    return false;
+
+  AutoLock lock(lock_);
+  // Return now if there has been a flush since the begin event was posted.
+  if (static_cast<int>(index) < chunk->flushed)
+    return true;
+  // Remove begin event and do not add end event. The events after it were
+  // added by nested scopes, which have ended.
+  for (int i = index; i < size - 1; ++i)
+    chunk->events[i] = chunk->events[i + 1];
+  chunk->events[size - 1] = TraceEvent();
+  base::subtle::Release_Store(&chunk->size, size - 1);
+  return true;
+}
+
+bool TraceLog::ReplaceChunkLocked(ThreadLocalEventBuffer* buffer) {
+  lock_.AssertAcquired();
+  if (buffer->chunk) {
+    buffer->chunk_id = (buffer->chunk_id +
+        base::subtle::NoBarrier_Load(&buffer->chunk->size)) &
+        kTraceEventIdMask;
+    RetireChunkLocked(buffer->chunk);
+    buffer->chunk = NULL;
+  }
 
-    if (flags & TRACE_EVENT_FLAG_MANGLE_ID)
-      id ^= process_id_hash_;
+  Chunk* chunk = NULL;
+  if (NumChunksLocked() < kTraceEventMaxChunks) {
+    chunk = new Chunk;
+  } else if (record_mode_ == RECORD_CONTINUOUSLY && !retired_chunks_.empty()) {
+    // Reuse the oldest chunk, dropping its events.
+    chunk = retired_chunks_.front();
+    retired_chunks_.pop_front();
+    int size = base::subtle::NoBarrier_Load(&chunk->size);
+    for (int i = 0; i < size; ++i)
+      chunk->events[i] = TraceEvent();
+    base::subtle::NoBarrier_Store(&chunk->size, 0);
+    chunk->flushed = 0;
+  } else {
+    return false;
+  }
+  live_chunks_.push_back(chunk);
+  base::subtle::NoBarrier_Store(
+      &num_chunks_, static_cast<base::subtle::Atomic32>(NumChunksLocked()));
+  buffer->chunk = chunk;
+  return true;
+}
+
+void TraceLog::RetireChunkLocked(Chunk* chunk) {
+  lock_.AssertAcquired();
+  std::vector<Chunk*>::iterator it =
+      std::find(live_chunks_.begin(), live_chunks_.end(), chunk);
+  DCHECK(it != live_chunks_.end());
+  live_chunks_.erase(it);
+  retired_chunks_.push_back(chunk);
+}
 
-    ret_begin_id = static_cast<int>(logged_events_.size());
-    logged_events_.push_back(
-        TraceEvent(thread_id,
-                   now, phase, category_enabled, name, id,
-                   num_args, arg_names, arg_types, arg_values,
-                   flags));
+void TraceLog::TakeRetiredChunksLocked(std::vector<Chunk*>* chunks) {
+  lock_.AssertAcquired();
+  chunks->insert(chunks->end(), retired_chunks_.begin(),
+                 retired_chunks_.end());
+  retired_chunks_.clear();
+  base::subtle::NoBarrier_Store(
+      &num_chunks_, static_cast<base::subtle::Atomic32>(NumChunksLocked()));
+}
+
+// static
+void TraceLog::WriteChunks(TraceBinaryWriter* writer,
+                           const std::vector<Chunk*>& chunks) {
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    Chunk* chunk = chunks[i];
+    int size = base::subtle::NoBarrier_Load(&chunk->size);
+    if (chunk->flushed < size)
+      writer->WriteEvents(chunk->events + chunk->flushed, size - chunk->flushed);
+    delete chunk;
+  }
+}
+
+size_t TraceLog::NumChunksLocked() const {
+  lock_.AssertAcquired();
+  return live_chunks_.size() + retired_chunks_.size() +
+      binary_chunks_to_write_.size() + binary_chunks_being_written_;
+}
 
-    if (logged_events_.size() == kTraceEventBufferSize) {
-      buffer_full_callback_copy = buffer_full_callback_;
+void TraceLog::WaitForBinaryWriterLocked() {
+  lock_.AssertAcquired();
+  while (binary_writer_thread_.get() &&
+         (!binary_chunks_to_write_.empty() || binary_chunks_being_written_))
+    binary_writer_cv_.Wait();
+}
+
+void TraceLog::StopBinaryWriterThread() {
+  scoped_ptr<BinaryWriterThread> thread;
+  {
+    AutoLock lock(lock_);
+    if (!binary_writer_thread_.get())
+      return;
+    thread.swap(binary_writer_thread_);
+    stop_binary_writer_thread_ = true;
+    binary_writer_cv_.Broadcast();
+  }
+  // The thread writes the chunks it was handed before it exits.
+  thread->Join();
+  AutoLock lock(lock_);
+  stop_binary_writer_thread_ = false;
+}
+
+void TraceLog::WriteBinaryChunksUntilStopped(TraceBinaryWriter* writer) {
+  AutoLock lock(lock_);
+  for (;;) {
+    while (binary_chunks_to_write_.empty() && !stop_binary_writer_thread_)
+      binary_writer_cv_.Wait();
+    if (binary_chunks_to_write_.empty())
+      return;
+
+    std::vector<Chunk*> chunks;
+    chunks.swap(binary_chunks_to_write_);
+    binary_chunks_being_written_ = chunks.size();
+    {
+      AutoUnlock unlock(lock_);
+      WriteChunks(writer, chunks);
     }
-  }  // release lock
+    binary_chunks_being_written_ = 0;
+    base::subtle::NoBarrier_Store(
+        &num_chunks_, static_cast<base::subtle::Atomic32>(NumChunksLocked()));
+    binary_writer_cv_.Broadcast();
+  }
+}
+
+void TraceLog::GetUnflushedEventsLocked(std::vector<TraceEvent>* events,
+                                        bool consume) {
+  lock_.AssertAcquired();
+  for (std::deque<Chunk*>::iterator it = retired_chunks_.begin();
+       it != retired_chunks_.end(); ++it) {
+    Chunk* chunk = *it;
+    events->insert(events->end(),
+                   chunk->events + chunk->flushed,
+                   chunk->events + base::subtle::NoBarrier_Load(&chunk->size));
+  }
+  for (size_t i = 0; i < live_chunks_.size(); ++i) {
+    Chunk* chunk = live_chunks_[i];
+    // Pairs with the release store of the writing thread.
+    int size = base::subtle::Acquire_Load(&chunk->size);
+    events->insert(events->end(),
+                   chunk->events + chunk->flushed,
+                   chunk->events + size);
+    if (consume)
+      chunk->flushed = size;
+  }
+  // The events of each thread are already in order; merge the threads.
+  std::stable_sort(events->begin(), events->end(), &TimestampLess);
+  events->insert(events->end(), metadata_events_.begin(),
+                 metadata_events_.end());
+
+  if (consume) {
+    STLDeleteElements(&retired_chunks_);
+    base::subtle::NoBarrier_Store(
+        &num_chunks_, static_cast<base::subtle::Atomic32>(NumChunksLocked()));
+    metadata_events_.clear();
+    buffer_full_callback_run_ = false;
+  }
+}
 
-  if (!buffer_full_callback_copy.is_null())
-    buffer_full_callback_copy.Run();
+void TraceLog::GetEventsForTesting(std::vector<TraceEvent>* events) {
+  AutoLock lock(lock_);
+  GetUnflushedEventsLocked(events, false);
+}
 
-  return ret_begin_id;
+void TraceLog::WaitForBinaryWriterForTesting() {
+  AutoLock lock(lock_);
+  WaitForBinaryWriterLocked();
+}
+
+// static
+void TraceLog::OnThreadExit(void* value) {
+  ThreadLocalEventBuffer* buffer = static_cast<ThreadLocalEventBuffer*>(value);
+  // Hand the events of the thread over for flushing, if its TraceLog is still
+  // alive.
+  if (buffer->chunk &&
+      buffer->generation == base::subtle::Acquire_Load(&g_live_generation)) {
+    AutoLock lock(buffer->trace_log->lock_);
+    buffer->trace_log->RetireChunkLocked(buffer->chunk);
+  }
+  delete buffer;
 }
 
 void TraceLog::AddTraceEventEtw(char phase,
@@ -736,7 +1113,7 @@ void TraceLog::AddThreadNameMetadataEvents() {
       unsigned char arg_type;
       unsigned long long arg_value;
       trace_event_internal::SetTraceValue(it->second, &arg_type, &arg_value);
-      logged_events_.push_back(
+      metadata_events_.push_back(
           TraceEvent(it->first,
                      TimeTicks(), TRACE_EVENT_PHASE_METADATA,
                      &g_category_enabled[g_category_metadata],
@@ -9,14 +9,18 @@
 
 #include "build/build_config.h"
 
+#include <deque>
 #include <string>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/callback.h"
 #include "base/hash_tables.h"
 #include "base/memory/ref_counted_memory.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/observer_list.h"
 #include "base/string_util.h"
+#include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
 #include "base/timer.h"
 
@@ -44,6 +48,8 @@ namespace base {
 
 namespace debug {
 
+class TraceBinaryWriter;
+
 const int kTraceMaxNumArgs = 2;
 
 // Output records are "Events" and can be obtained via the
@@ -81,8 +87,22 @@ class BASE_EXPORT TraceEvent {
                                  size_t count,
                                  std::string* out);
   void AppendAsJSON(std::string* out) const;
+  // Same as above, for an event whose category and process are not those of
+  // this process, such as one read back from a binary trace.
+  void AppendAsJSON(const char* category_name,
+                    int process_id,
+                    std::string* out) const;
 
   TimeTicks timestamp() const { return timestamp_; }
+  int thread_id() const { return thread_id_; }
+  char phase() const { return phase_; }
+  const unsigned char* category_enabled() const { return category_enabled_; }
+  unsigned long long id() const { return id_; }
+  unsigned char flags() const { return flags_; }
+  // The arguments, up to the first one without a name.
+  const char* arg_name(int i) const { return arg_names_[i]; }
+  unsigned char arg_type(int i) const { return arg_types_[i]; }
+  TraceValue arg_value(int i) const { return arg_values_[i]; }
 
   // Exposed for unittesting:
 
@@ -214,6 +234,18 @@ class BASE_EXPORT TraceLog {
 
   float GetBufferPercentFull() const;
 
+  // What to do with new events once the trace buffer is full.
+  enum RecordMode {
+    // Drop the new events.  This is the default.
+    RECORD_UNTIL_FULL,
+    // Drop the oldest events to make room for the new ones, so that the
+    // buffer always holds the most recent events.
+    RECORD_CONTINUOUSLY,
+  };
+
+  // Sets the record mode.  Must be called while tracing is disabled.
+  void SetRecordMode(RecordMode mode);
+
   // When enough events are collected, they are handed (in bulk) to
   // the output callback. If no callback is set, the output will be
   // silently dropped. The callback must be thread safe. The string format is
@@ -223,9 +255,17 @@ class BASE_EXPORT TraceLog {
       OutputCallback;
   void SetOutputCallback(const OutputCallback& cb);
 
+  // Writes the events to |writer| instead of handing them to the output
+  // callback. They are written as they are recorded, a batch of chunks at a
+  // time by a thread of its own, and the rest on Flush(), which also logs an
+  // error if any write failed. Pass NULL to go back to the output callback.
+  // Must be called while tracing is disabled.
+  void SetBinaryWriter(TraceBinaryWriter* writer);
+
   // The trace buffer does not flush dynamically, so when it fills up,
   // subsequent trace events will be dropped. This callback is generated when
-  // the trace buffer is full. The callback must be thread safe.
+  // the trace buffer is full, unless recording continuously. The callback
+  // must be thread safe.
   typedef base::Callback<void(void)> BufferFullCallback;
   void SetBufferFullCallback(const BufferFullCallback& cb);
 
@@ -237,8 +277,8 @@ class BASE_EXPORT TraceLog {
   static const char* GetCategoryName(const unsigned char* category_enabled);
 
   // Called by TRACE_EVENT* macros, don't call this directly.
-  // Returns the index in the internal vector of the event if it was added, or
-  //         -1 if the event was not added.
+  // Returns an id for the event in the buffer of the current thread if it was
+  //         added, or -1 if the event was not added.
   // On end events, the return value of the begin event can be specified along
   // with a threshold in microseconds. If the elapsed time between begin and end
   // is less than the threshold, the begin/end event pair is dropped.
@@ -274,33 +314,124 @@ class BASE_EXPORT TraceLog {
   // Allows resurrecting our singleton instance post-AtExit processing.
   static void Resurrect();
 
-  // Allow tests to inspect TraceEvents.
-  size_t GetEventsSize() const { return logged_events_.size(); }
-  const TraceEvent& GetEventAt(size_t index) const {
-    DCHECK(index < logged_events_.size());
-    return logged_events_[index];
-  }
+  // Allow tests to inspect TraceEvents. Copies the events which have not been
+  // flushed yet into |events|, in timestamp order.
+  void GetEventsForTesting(std::vector<TraceEvent>* events);
 
   void SetProcessID(int process_id);
 
+  // Blocks until the binary writer thread has written the chunks it was
+  // handed so far.
+  void WaitForBinaryWriterForTesting();
+
  private:
   // This allows constructor and destructor to be private and usable only
   // by the Singleton class.
   friend struct StaticMemorySingletonTraits<TraceLog>;
 
+  // A fixed number of events, written by one thread.
+  struct Chunk;
+
+  // The chunk a thread is writing its events into.
+  struct ThreadLocalEventBuffer;
+
+  // The thread which writes batches of chunks to |binary_writer_|.
+  class BinaryWriterThread;
+
   TraceLog();
   ~TraceLog();
   const unsigned char* GetCategoryEnabledInternal(const char* name);
   void AddThreadNameMetadataEvents();
   void AddClockSyncMetadataEvents();
 
-  // TODO(nduca): switch to per-thread trace buffers to reduce thread
-  // synchronization.
+  // Returns the event buffer of the current thread, creating it if needed.
+  ThreadLocalEventBuffer* GetThreadLocalEventBuffer();
+
+  // Records |name| as a name of the thread |thread_id|.
+  void AddThreadName(int thread_id, const char* name);
+
+  // Removes the begin event |threshold_begin_id| of the current thread if it
+  // is less than |threshold| microseconds old. Returns true if the end event
+  // should not be added.
+  bool DropBeginEventIfShorter(ThreadLocalEventBuffer* buffer,
+                               int threshold_begin_id,
+                               TimeTicks now,
+                               long long threshold);
+
+  // Hands the chunk of |buffer| over for flushing, and gives |buffer| an
+  // empty one. Returns false if there is no room left in the trace buffer.
+  bool ReplaceChunkLocked(ThreadLocalEventBuffer* buffer);
+
+  // Moves |chunk| from the live chunks to the retired ones.
+  void RetireChunkLocked(Chunk* chunk);
+
+  // Takes the retired chunks out of the trace buffer, and appends them to
+  // |chunks| to be written without the lock.
+  void TakeRetiredChunksLocked(std::vector<Chunk*>* chunks);
+
+  // Writes the events of |chunks| which have not been flushed yet to
+  // |writer|, and deletes the chunks.
+  static void WriteChunks(TraceBinaryWriter* writer,
+                          const std::vector<Chunk*>& chunks);
+
+  // Returns the number of chunks which hold events, including the ones the
+  // binary writer thread has not deleted yet.
+  size_t NumChunksLocked() const;
+
+  // Waits for the binary writer thread to be done with the chunks it was
+  // handed. Releases the lock while waiting.
+  void WaitForBinaryWriterLocked();
+
+  // Lets the binary writer thread write the chunks it was handed, and joins
+  // it.
+  void StopBinaryWriterThread();
+
+  // Runs on the binary writer thread. Writes the chunks handed to it to
+  // |writer| until it is stopped.
+  void WriteBinaryChunksUntilStopped(TraceBinaryWriter* writer);
+
+  // Appends the events which have not been flushed yet to |events|, in
+  // timestamp order. If |consume| is set, the events are marked as flushed.
+  void GetUnflushedEventsLocked(std::vector<TraceEvent>* events, bool consume);
+
+  // Called when a thread which recorded events exits.
+  static void OnThreadExit(void* buffer);
+
+  // Guards everything but the events in the chunk each thread writes into,
+  // which the thread adds without taking the lock.
   Lock lock_;
   bool enabled_;
+  RecordMode record_mode_;
   OutputCallback output_callback_;
+  scoped_refptr<TraceBinaryWriter> binary_writer_;
   BufferFullCallback buffer_full_callback_;
-  std::vector<TraceEvent> logged_events_;
+  bool buffer_full_callback_run_;
+
+  // The chunks which are being written by a thread.
+  std::vector<Chunk*> live_chunks_;
+  // The chunks which no thread writes into any more, oldest first.
+  std::deque<Chunk*> retired_chunks_;
+  // The number of chunks holding events, readable without the lock.
+  base::subtle::Atomic32 num_chunks_;
+
+  // Writes the batches of retired chunks to |binary_writer_|, so that the
+  // threads recording events never encode or write them.
+  scoped_ptr<BinaryWriterThread> binary_writer_thread_;
+  // Signaled when chunks are handed to the writer thread, when it is done
+  // with them, and when it should stop.
+  ConditionVariable binary_writer_cv_;
+  // The chunks handed to the writer thread, oldest first.
+  std::vector<Chunk*> binary_chunks_to_write_;
+  // The number of chunks the writer thread is writing.
+  size_t binary_chunks_being_written_;
+  bool stop_binary_writer_thread_;
+  // Thread name events, added when tracing is disabled.
+  std::vector<TraceEvent> metadata_events_;
+
+  // Identifies this TraceLog to the thread-local event buffers, which
+  // outlive it.
+  int generation_;
+
   std::vector<std::string> included_categories_;
   std::vector<std::string> excluded_categories_;
   bool dispatching_to_observer_list_;
@@ -0,0 +1,65 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/compiler_specific.h"
+#include "base/debug/trace_event.h"
+#include "base/test/perf_test_threads.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const int kEventsPerThread = 200000;
+
+// Adds kEventsPerThread instant events, with an argument, from its thread.
+class TraceEventsThread : public DelegateSimpleThread::Delegate {
+ public:
+  TraceEventsThread() {}
+  virtual ~TraceEventsThread() {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kEventsPerThread; ++i)
+      TRACE_EVENT_INSTANT1("perf", "event", "i", i);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TraceEventsThread);
+};
+
+class TraceEventPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    // Records continuously so that the buffer never fills up, and no event
+    // is dropped before it is timed.
+    TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_CONTINUOUSLY);
+    TraceLog::GetInstance()->SetOutputCallback(TraceLog::OutputCallback());
+  }
+
+  virtual void TearDown() OVERRIDE {
+    TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_UNTIL_FULL);
+  }
+
+  void TraceFromThreads(int thread_count) {
+    TraceLog::GetInstance()->SetEnabled("perf");
+    TraceEventsThread delegate;
+    RunOnThreadsAndLogPerf("trace_event", &delegate, thread_count,
+                           kEventsPerThread, "ns/event");
+    TraceLog::GetInstance()->SetDisabled();
+  }
+};
+
+}  // namespace
+
+// With the events of each thread recorded into a buffer of its own, the time
+// per event should not grow with the number of threads tracing.
+TEST_F(TraceEventPerfTest, ContendedThreads) {
+  TraceFromThreads(1);
+  TraceFromThreads(8);
+  TraceFromThreads(16);
+}
+
+}  // namespace debug
+}  // namespace base
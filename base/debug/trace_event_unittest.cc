@@ -1009,7 +1009,9 @@ TEST_F(TraceEventTestFixture, StaticStringVsString) {
   TraceLog* tracer = TraceLog::GetInstance();
   // Make sure old events are flushed:
   tracer->SetEnabled(false);
-  EXPECT_EQ(0u, tracer->GetEventsSize());
+  std::vector<TraceEvent> events;
+  tracer->GetEventsForTesting(&events);
+  EXPECT_EQ(0u, events.size());
 
   {
     tracer->SetEnabled(true);
@@ -1020,10 +1022,12 @@ TEST_F(TraceEventTestFixture, StaticStringVsString) {
     TRACE_EVENT2("cat", "name2",
                  "arg1", TRACE_STR_COPY("argval"),
                  "arg2", TRACE_STR_COPY("argval"));
-    size_t num_events = tracer->GetEventsSize();
+    events.clear();
+    tracer->GetEventsForTesting(&events);
+    size_t num_events = events.size();
     EXPECT_GT(num_events, 1u);
-    const TraceEvent& event1 = tracer->GetEventAt(num_events - 2);
-    const TraceEvent& event2 = tracer->GetEventAt(num_events - 1);
+    const TraceEvent& event1 = events[num_events - 2];
+    const TraceEvent& event2 = events[num_events - 1];
     EXPECT_STREQ("name1", event1.name());
     EXPECT_STREQ("name2", event2.name());
     EXPECT_TRUE(event1.parameter_copy_storage() != NULL);
@@ -1044,10 +1048,12 @@ TEST_F(TraceEventTestFixture, StaticStringVsString) {
     TRACE_EVENT2("cat", "name2",
                  "arg1", TRACE_STR_COPY(str1),
                  "arg2", TRACE_STR_COPY(str2));
-    size_t num_events = tracer->GetEventsSize();
+    events.clear();
+    tracer->GetEventsForTesting(&events);
+    size_t num_events = events.size();
     EXPECT_GT(num_events, 1u);
-    const TraceEvent& event1 = tracer->GetEventAt(num_events - 2);
-    const TraceEvent& event2 = tracer->GetEventAt(num_events - 1);
+    const TraceEvent& event1 = events[num_events - 2];
+    const TraceEvent& event2 = events[num_events - 1];
     EXPECT_STREQ("name1", event1.name());
     EXPECT_STREQ("name2", event2.name());
     EXPECT_TRUE(event1.parameter_copy_storage() == NULL);
@@ -1349,6 +1355,67 @@ TEST_F(TraceEventTestFixture, DeepCopy) {
   EXPECT_EQ("val2", s);
 }
 
+// Test that a full trace buffer keeps the first events by default, and the
+// most recent ones when recording continuously.
+TEST_F(TraceEventTestFixture, RecordModes) {
+  ManualTestSetUp();
+  TraceLog* tracer = TraceLog::GetInstance();
+  // The events are checked without converting them to JSON.
+  tracer->SetOutputCallback(TraceLog::OutputCallback());
+
+  // More events than the trace buffer holds.
+  const int kNumEvents = 600000;
+
+  tracer->SetEnabled(true);
+  TRACE_EVENT_INSTANT0("all", "first");
+  for (int i = 1; i < kNumEvents - 1; ++i)
+    TRACE_EVENT_INSTANT0("all", "middle");
+  TRACE_EVENT_INSTANT0("all", "last");
+  std::vector<TraceEvent> events;
+  tracer->GetEventsForTesting(&events);
+  ASSERT_FALSE(events.empty());
+  EXPECT_LT(events.size(), static_cast<size_t>(kNumEvents));
+  EXPECT_STREQ("first", events.front().name());
+  EXPECT_STREQ("middle", events.back().name());
+  EXPECT_EQ(1.0f, tracer->GetBufferPercentFull());
+  tracer->SetEnabled(false);
+
+  tracer->SetRecordMode(TraceLog::RECORD_CONTINUOUSLY);
+  tracer->SetEnabled(true);
+  TRACE_EVENT_INSTANT0("all", "first");
+  for (int i = 1; i < kNumEvents - 1; ++i)
+    TRACE_EVENT_INSTANT0("all", "middle");
+  TRACE_EVENT_INSTANT0("all", "last");
+  events.clear();
+  tracer->GetEventsForTesting(&events);
+  ASSERT_FALSE(events.empty());
+  EXPECT_LT(events.size(), static_cast<size_t>(kNumEvents));
+  EXPECT_STREQ("middle", events.front().name());
+  EXPECT_STREQ("last", events.back().name());
+  EXPECT_EQ(1.0f, tracer->GetBufferPercentFull());
+  tracer->SetEnabled(false);
+  tracer->SetRecordMode(TraceLog::RECORD_UNTIL_FULL);
+}
+
+// Test that the events of a thread which has exited are flushed.
+TEST_F(TraceEventTestFixture, DataCapturedOnExitedThread) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  Thread thread("exited");
+  WaitableEvent task_complete_event(false, false);
+  thread.Start();
+  thread.message_loop()->PostTask(
+      FROM_HERE, base::Bind(&TraceManyInstantEvents,
+                            0, 100, &task_complete_event));
+  task_complete_event.Wait();
+  thread.Stop();
+
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  ValidateInstantEventPresentOnEveryThread(trace_parsed_, 1, 100);
+}
+
 // Test that TraceResultBuffer outputs the correct result whether it is added
 // in chunks or added all at once.
 TEST_F(TraceEventTestFixture, TraceResultBuffer) {
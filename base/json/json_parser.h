@@ -19,6 +19,7 @@
 #endif
 
 namespace base {
+class JSONStreamReader;
 class Value;
 }
 
@@ -145,6 +146,10 @@ class BASE_EXPORT_PRIVATE JSONParser {
     std::string* string_;
   };
 
+  // Winds the parser to the start of |input|, which must outlive the parse,
+  // and clears the error and nesting state.
+  void StartParsing(const StringPiece& input);
+
   // Quick check that the stream has capacity to consume |length| more bytes.
   bool CanConsume(int length);
 
@@ -204,6 +209,11 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // Assuming that the parser is wound to the start of a valid JSON number,
   // this parses and converts it to either an int or double value.
   Value* ConsumeNumber();
+
+  // Does the validation of ConsumeNumber() without converting the number, and
+  // returns the characters that make it up in |number|.
+  bool ConsumeNumberString(StringPiece* number);
+
   // Helper that reads characters that are ints. Returns true if a number was
   // read and false on error.
   bool ReadInt(bool allow_leading_zeros);
@@ -212,6 +222,17 @@ class BASE_EXPORT_PRIVATE JSONParser {
   // parser is wound to the first character of any of those.
   Value* ConsumeLiteral();
 
+  // Consumes |literal|, assuming the parser is wound to its first character.
+  // Returns false on failure with error information set.
+  bool ConsumeLiteralWord(const char* literal);
+
+  // Account for a dictionary or list the parser is wound into and out of,
+  // for a caller that consumes them without ConsumeDictionary() and
+  // ConsumeList().  EnterContainer() returns false with error information set
+  // if the container is nested too deeply.
+  bool EnterContainer();
+  void LeaveContainer();
+
   // Compares two string buffers of a given length.
   static bool StringsAreEqual(const char* left, const char* right, size_t len);
 
@@ -256,8 +277,10 @@ class BASE_EXPORT_PRIVATE JSONParser {
   int error_column_;
 
   friend class JSONParserTest;
+  friend class base::JSONStreamReader;
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, NextChar);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeDictionary);
+  FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeUnsortedDictionary);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeList);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeString);
   FRIEND_TEST_ALL_PREFIXES(JSONParserTest, ConsumeLiterals);
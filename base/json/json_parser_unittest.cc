@@ -85,6 +85,28 @@ TEST_F(JSONParserTest, ConsumeDictionary) {
   EXPECT_EQ("def", str);
 }
 
+TEST_F(JSONParserTest, ConsumeUnsortedDictionary) {
+  std::string input("{\"b\":1,\"c\":2,\"a\":3,\"b\":4,\"\\u0061\":5},|");
+  scoped_ptr<JSONParser> parser(NewTestParser(input));
+  scoped_ptr<Value> value(parser->ConsumeDictionary());
+  EXPECT_EQ('}', *parser->pos_);
+
+  TestLastThree(parser.get());
+
+  // The last value of a key which appears more than once is kept.
+  ASSERT_TRUE(value.get());
+  base::DictionaryValue* dict;
+  ASSERT_TRUE(value->GetAsDictionary(&dict));
+  EXPECT_EQ(3U, dict->size());
+  int int_value = 0;
+  EXPECT_TRUE(dict->GetInteger("a", &int_value));
+  EXPECT_EQ(5, int_value);
+  EXPECT_TRUE(dict->GetInteger("b", &int_value));
+  EXPECT_EQ(4, int_value);
+  EXPECT_TRUE(dict->GetInteger("c", &int_value));
+  EXPECT_EQ(2, int_value);
+}
+
 TEST_F(JSONParserTest, ConsumeLiterals) {
   // Literal |true|.
   std::string input("true,|");
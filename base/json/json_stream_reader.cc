@@ -0,0 +1,295 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_stream_reader.h"
+
+#include "base/float_util.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/values.h"
+
+namespace base {
+
+using internal::JSONParser;
+
+JSONStreamReader::JSONStreamReader(const StringPiece& json, int options)
+    // Values read are handed out on their own, so they can't refer to |json|
+    // through a hidden root.
+    : parser_(options | JSON_DETACHABLE_CHILDREN),
+      consumed_(false),
+      first_item_(false) {
+  parser_.StartParsing(json);
+}
+
+JSONStreamReader::~JSONStreamReader() {
+}
+
+bool JSONStreamReader::BeginDictionary() {
+  if (has_error())
+    return false;
+  if (PeekToken() != JSONParser::T_OBJECT_BEGIN) {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+    return false;
+  }
+  if (!parser_.EnterContainer())
+    return false;
+  consumed_ = true;
+  first_item_ = true;
+  return true;
+}
+
+bool JSONStreamReader::NextKey(StringPiece* key) {
+  if (!NextItem(JSONParser::T_OBJECT_END))
+    return false;
+  if (PeekToken() != JSONParser::T_STRING) {
+    ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY);
+    return false;
+  }
+
+  JSONParser::StringBuilder builder;
+  if (!parser_.ConsumeStringRaw(&builder))
+    return false;
+  consumed_ = true;
+  if (builder.CanBeStringPiece()) {
+    *key = builder.AsStringPiece();
+  } else {
+    key_ = builder.AsString();
+    *key = key_;
+  }
+
+  if (PeekToken() != JSONParser::T_OBJECT_PAIR_SEPARATOR) {
+    ReportError(JSONReader::JSON_SYNTAX_ERROR);
+    return false;
+  }
+  consumed_ = true;
+  return true;
+}
+
+bool JSONStreamReader::BeginList() {
+  if (has_error())
+    return false;
+  if (PeekToken() != JSONParser::T_ARRAY_BEGIN) {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+    return false;
+  }
+  if (!parser_.EnterContainer())
+    return false;
+  consumed_ = true;
+  first_item_ = true;
+  return true;
+}
+
+bool JSONStreamReader::NextListItem() {
+  return NextItem(JSONParser::T_ARRAY_END);
+}
+
+bool JSONStreamReader::ReadString(std::string* out_value) {
+  if (has_error())
+    return false;
+  if (PeekToken() != JSONParser::T_STRING) {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+    return false;
+  }
+
+  JSONParser::StringBuilder builder;
+  if (!parser_.ConsumeStringRaw(&builder))
+    return false;
+  consumed_ = true;
+  if (builder.CanBeStringPiece())
+    builder.AsStringPiece().CopyToString(out_value);
+  else
+    *out_value = builder.AsString();
+  return true;
+}
+
+bool JSONStreamReader::ReadInteger(int* out_value) {
+  if (has_error())
+    return false;
+  if (PeekToken() != JSONParser::T_NUMBER) {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+    return false;
+  }
+
+  StringPiece number;
+  if (!parser_.ConsumeNumberString(&number))
+    return false;
+  consumed_ = true;
+  if (!StringToInt(number, out_value)) {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+    return false;
+  }
+  return true;
+}
+
+bool JSONStreamReader::ReadDouble(double* out_value) {
+  if (has_error())
+    return false;
+  if (PeekToken() != JSONParser::T_NUMBER) {
+    ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+    return false;
+  }
+
+  StringPiece number;
+  if (!parser_.ConsumeNumberString(&number))
+    return false;
+  consumed_ = true;
+  int int_value;
+  if (StringToInt(number, &int_value)) {
+    *out_value = int_value;
+    return true;
+  }
+  if (!StringToDouble(number.as_string(), out_value) ||
+      !IsFinite(*out_value)) {
+    ReportError(JSONReader::JSON_SYNTAX_ERROR);
+    return false;
+  }
+  return true;
+}
+
+bool JSONStreamReader::ReadBoolean(bool* out_value) {
+  if (has_error())
+    return false;
+  switch (PeekToken()) {
+    case JSONParser::T_BOOL_TRUE:
+      if (!parser_.ConsumeLiteralWord("true"))
+        return false;
+      *out_value = true;
+      break;
+    case JSONParser::T_BOOL_FALSE:
+      if (!parser_.ConsumeLiteralWord("false"))
+        return false;
+      *out_value = false;
+      break;
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+      return false;
+  }
+  consumed_ = true;
+  return true;
+}
+
+Value* JSONStreamReader::ReadValue() {
+  if (has_error())
+    return NULL;
+  Value* value = parser_.ParseToken(PeekToken());
+  if (!value)
+    return NULL;
+  consumed_ = true;
+  return value;
+}
+
+bool JSONStreamReader::SkipValue() {
+  if (has_error())
+    return false;
+  switch (PeekToken()) {
+    case JSONParser::T_OBJECT_BEGIN: {
+      StringPiece key;
+      BeginDictionary();
+      while (NextKey(&key)) {
+        if (!SkipValue())
+          return false;
+      }
+      return !has_error();
+    }
+    case JSONParser::T_ARRAY_BEGIN:
+      BeginList();
+      while (NextListItem()) {
+        if (!SkipValue())
+          return false;
+      }
+      return !has_error();
+    case JSONParser::T_STRING: {
+      JSONParser::StringBuilder builder;
+      if (!parser_.ConsumeStringRaw(&builder))
+        return false;
+      break;
+    }
+    case JSONParser::T_NUMBER: {
+      StringPiece number;
+      if (!parser_.ConsumeNumberString(&number))
+        return false;
+      break;
+    }
+    case JSONParser::T_BOOL_TRUE:
+      if (!parser_.ConsumeLiteralWord("true"))
+        return false;
+      break;
+    case JSONParser::T_BOOL_FALSE:
+      if (!parser_.ConsumeLiteralWord("false"))
+        return false;
+      break;
+    case JSONParser::T_NULL:
+      if (!parser_.ConsumeLiteralWord("null"))
+        return false;
+      break;
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN);
+      return false;
+  }
+  consumed_ = true;
+  return true;
+}
+
+bool JSONStreamReader::ReadEndOfInput() {
+  if (has_error())
+    return false;
+  if (PeekToken() != JSONParser::T_END_OF_INPUT) {
+    ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT);
+    return false;
+  }
+  return true;
+}
+
+JSONReader::JsonParseError JSONStreamReader::error_code() const {
+  return parser_.error_code();
+}
+
+std::string JSONStreamReader::GetErrorMessage() const {
+  return parser_.GetErrorMessage();
+}
+
+JSONStreamReader::Token JSONStreamReader::PeekToken() {
+  if (consumed_) {
+    parser_.NextChar();
+    consumed_ = false;
+  }
+  return parser_.GetNextToken();
+}
+
+bool JSONStreamReader::NextItem(Token end_token) {
+  if (has_error())
+    return false;
+
+  Token token = PeekToken();
+  if (!first_item_) {
+    if (token == JSONParser::T_LIST_SEPARATOR) {
+      consumed_ = true;
+      token = PeekToken();
+      if (token == end_token &&
+          !(parser_.options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA);
+        return false;
+      }
+    } else if (token != end_token) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR);
+      return false;
+    }
+  }
+
+  // Whether this container ended or an item of it is read next, the
+  // container it is in expects a separator next.
+  first_item_ = false;
+  if (token == end_token) {
+    parser_.LeaveContainer();
+    consumed_ = true;
+    return false;
+  }
+  return true;
+}
+
+void JSONStreamReader::ReportError(JSONReader::JsonParseError code) {
+  parser_.ReportError(code, 1);
+}
+
+}  // namespace base
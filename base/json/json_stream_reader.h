@@ -0,0 +1,133 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// JSONStreamReader reads JSON one token at a time, the way XmlReader reads
+// XML, for callers which only want some of the values of a document and
+// would rather not build a Value tree for all of it.  It accepts the same
+// input as JSONReader with the same options.
+//
+// Usage, for {"name": "foo", "sizes": [1, 2]}:
+//   JSONStreamReader reader(json, JSON_PARSE_RFC);
+//   StringPiece key;
+//   if (!reader.BeginDictionary())
+//     return false;
+//   while (reader.NextKey(&key)) {
+//     if (key == "name") {
+//       reader.ReadString(&name);
+//     } else if (key == "sizes") {
+//       int size;
+//       reader.BeginList();
+//       while (reader.NextListItem() && reader.ReadInteger(&size))
+//         sizes.push_back(size);
+//     } else {
+//       reader.SkipValue();
+//     }
+//   }
+//   return reader.ReadEndOfInput();
+//
+// Once a call fails, the reader keeps the error and every later call fails,
+// so a caller may check for errors only once it is done.  A value of another
+// type than the one asked for is an error too.
+
+#ifndef BASE_JSON_JSON_STREAM_READER_H_
+#define BASE_JSON_JSON_STREAM_READER_H_
+#pragma once
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/json/json_parser.h"
+#include "base/json/json_reader.h"
+#include "base/string_piece.h"
+
+namespace base {
+
+class Value;
+
+class BASE_EXPORT JSONStreamReader {
+ public:
+  // Reads |json|, which must outlive the reader, according to |options|, the
+  // JSONParserOptions.
+  JSONStreamReader(const StringPiece& json, int options);
+  ~JSONStreamReader();
+
+  // Reads the start of a dictionary.  Each of its entries is then read by a
+  // call to NextKey() followed by reading or skipping the value.
+  bool BeginDictionary();
+
+  // Reads the key of the next entry of the dictionary being read into |key|,
+  // which is valid until the next call.  Returns false once the end of the
+  // dictionary is read, or on error.
+  bool NextKey(StringPiece* key);
+
+  // Reads the start of a list.  Each of its items is then read by a call to
+  // NextListItem() followed by reading or skipping the item.
+  bool BeginList();
+
+  // Returns true if the list being read has another item, and false once the
+  // end of the list is read, or on error.
+  bool NextListItem();
+
+  // Read the next value, which must be of the type asked for.  ReadInteger()
+  // fails on numbers which are not ints, and ReadDouble() accepts both, as
+  // Value::GetAsInteger() and Value::GetAsDouble() do.
+  bool ReadString(std::string* out_value);
+  bool ReadInteger(int* out_value);
+  bool ReadDouble(double* out_value);
+  bool ReadBoolean(bool* out_value);
+
+  // Reads the next value, of any type, into a Value owned by the caller.
+  // Returns NULL on error.
+  Value* ReadValue();
+
+  // Reads past the next value, of any type, without building it.
+  bool SkipValue();
+
+  // Checks that nothing but whitespace and comments follows the value read.
+  bool ReadEndOfInput();
+
+  bool has_error() const {
+    return error_code() != JSONReader::JSON_NO_ERROR;
+  }
+
+  // Returns the error code, JSON_NO_ERROR if no call has failed.
+  JSONReader::JsonParseError error_code() const;
+
+  // Returns the error, including its line and column, in human-readable form.
+  std::string GetErrorMessage() const;
+
+ private:
+  typedef internal::JSONParser::Token Token;
+
+  // Winds the parser past the token it last consumed, and returns the token
+  // which follows without consuming it.
+  Token PeekToken();
+
+  // Reads the separator before the next entry or item of the container being
+  // read, whose end is |end_token|.  Returns false if |end_token| is read
+  // instead, or on error.
+  bool NextItem(Token end_token);
+
+  void ReportError(JSONReader::JsonParseError code);
+
+  internal::JSONParser parser_;
+
+  // Whether the parser is still wound to the last byte of the token it last
+  // consumed, as the Consume functions of JSONParser leave it.
+  bool consumed_;
+
+  // Whether the container being read has not had any entries or items read
+  // yet, so no separator is expected before the next one.
+  bool first_item_;
+
+  // The key last read, when it had to be unescaped.
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(JSONStreamReader);
+};
+
+}  // namespace base
+
+#endif  // BASE_JSON_JSON_STREAM_READER_H_
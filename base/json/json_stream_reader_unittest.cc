@@ -0,0 +1,185 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_stream_reader.h"
+
+#include <string>
+
+#include "base/json/json_reader.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+TEST(JSONStreamReaderTest, ReadDictionary) {
+  JSONStreamReader reader(
+      "{\"name\": \"foo\\tbar\", \"count\": -3, \"ratio\": 2.5,\n"
+      " \"whole\": 4, \"enabled\": true, /* comment */ \"items\": [1, 2],\n"
+      " \"sub\": {\"x\": null}, \"esc\\u0061ped\": false}",
+      JSON_PARSE_RFC);
+  StringPiece key;
+  ASSERT_TRUE(reader.BeginDictionary());
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("name", key);
+  std::string string_value;
+  EXPECT_TRUE(reader.ReadString(&string_value));
+  EXPECT_EQ("foo\tbar", string_value);
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("count", key);
+  int int_value = 0;
+  EXPECT_TRUE(reader.ReadInteger(&int_value));
+  EXPECT_EQ(-3, int_value);
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("ratio", key);
+  double double_value = 0;
+  EXPECT_TRUE(reader.ReadDouble(&double_value));
+  EXPECT_DOUBLE_EQ(2.5, double_value);
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("whole", key);
+  EXPECT_TRUE(reader.ReadDouble(&double_value));
+  EXPECT_DOUBLE_EQ(4, double_value);
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("enabled", key);
+  bool bool_value = false;
+  EXPECT_TRUE(reader.ReadBoolean(&bool_value));
+  EXPECT_TRUE(bool_value);
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("items", key);
+  ASSERT_TRUE(reader.BeginList());
+  ASSERT_TRUE(reader.NextListItem());
+  EXPECT_TRUE(reader.ReadInteger(&int_value));
+  EXPECT_EQ(1, int_value);
+  ASSERT_TRUE(reader.NextListItem());
+  EXPECT_TRUE(reader.ReadInteger(&int_value));
+  EXPECT_EQ(2, int_value);
+  EXPECT_FALSE(reader.NextListItem());
+  EXPECT_FALSE(reader.has_error());
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("sub", key);
+  scoped_ptr<Value> value(reader.ReadValue());
+  ASSERT_TRUE(value.get());
+  scoped_ptr<Value> expected_value(JSONReader::Read("{\"x\": null}"));
+  EXPECT_TRUE(value->Equals(expected_value.get()));
+
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("escaped", key);
+  EXPECT_TRUE(reader.ReadBoolean(&bool_value));
+  EXPECT_FALSE(bool_value);
+
+  EXPECT_FALSE(reader.NextKey(&key));
+  EXPECT_FALSE(reader.has_error());
+  EXPECT_TRUE(reader.ReadEndOfInput());
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+}
+
+TEST(JSONStreamReaderTest, SkipValue) {
+  JSONStreamReader reader(
+      "[{\"a\": [1, {\"b\": \"\\u00e9\"}, [], {}], \"c\": false}, -1e3, null,"
+      " \"x\", 7]",
+      JSON_PARSE_RFC);
+  ASSERT_TRUE(reader.BeginList());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(reader.NextListItem());
+    EXPECT_TRUE(reader.SkipValue());
+  }
+  ASSERT_TRUE(reader.NextListItem());
+  int int_value = 0;
+  EXPECT_TRUE(reader.ReadInteger(&int_value));
+  EXPECT_EQ(7, int_value);
+  EXPECT_FALSE(reader.NextListItem());
+  EXPECT_TRUE(reader.ReadEndOfInput());
+}
+
+TEST(JSONStreamReaderTest, EmptyContainers) {
+  JSONStreamReader reader("{\"a\": [], \"b\": {}}", JSON_PARSE_RFC);
+  StringPiece key;
+  ASSERT_TRUE(reader.BeginDictionary());
+  ASSERT_TRUE(reader.NextKey(&key));
+  ASSERT_TRUE(reader.BeginList());
+  EXPECT_FALSE(reader.NextListItem());
+  ASSERT_TRUE(reader.NextKey(&key));
+  EXPECT_EQ("b", key);
+  ASSERT_TRUE(reader.BeginDictionary());
+  EXPECT_FALSE(reader.NextKey(&key));
+  EXPECT_FALSE(reader.NextKey(&key));
+  EXPECT_FALSE(reader.has_error());
+  EXPECT_TRUE(reader.ReadEndOfInput());
+}
+
+TEST(JSONStreamReaderTest, TrailingCommas) {
+  const char kJSON[] = "[1, 2, ]";
+  int int_value = 0;
+
+  JSONStreamReader reader(kJSON, JSON_PARSE_RFC);
+  ASSERT_TRUE(reader.BeginList());
+  ASSERT_TRUE(reader.NextListItem());
+  EXPECT_TRUE(reader.ReadInteger(&int_value));
+  ASSERT_TRUE(reader.NextListItem());
+  EXPECT_TRUE(reader.ReadInteger(&int_value));
+  EXPECT_FALSE(reader.NextListItem());
+  EXPECT_EQ(JSONReader::JSON_TRAILING_COMMA, reader.error_code());
+
+  JSONStreamReader relaxed_reader(kJSON, JSON_ALLOW_TRAILING_COMMAS);
+  EXPECT_TRUE(relaxed_reader.SkipValue());
+  EXPECT_TRUE(relaxed_reader.ReadEndOfInput());
+}
+
+TEST(JSONStreamReaderTest, Errors) {
+  int int_value = 0;
+  std::string string_value;
+  StringPiece key;
+
+  // A value of another type than the one asked for.
+  JSONStreamReader type_reader("{\"a\": 1.5}", JSON_PARSE_RFC);
+  ASSERT_TRUE(type_reader.BeginDictionary());
+  ASSERT_TRUE(type_reader.NextKey(&key));
+  EXPECT_FALSE(type_reader.ReadInteger(&int_value));
+  EXPECT_EQ(JSONReader::JSON_UNEXPECTED_TOKEN, type_reader.error_code());
+  // The error is kept.
+  EXPECT_FALSE(type_reader.NextKey(&key));
+  EXPECT_FALSE(type_reader.ReadEndOfInput());
+  EXPECT_EQ(JSONReader::JSON_UNEXPECTED_TOKEN, type_reader.error_code());
+  EXPECT_FALSE(type_reader.GetErrorMessage().empty());
+
+  JSONStreamReader key_reader("{a: 1}", JSON_PARSE_RFC);
+  ASSERT_TRUE(key_reader.BeginDictionary());
+  EXPECT_FALSE(key_reader.NextKey(&key));
+  EXPECT_EQ(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, key_reader.error_code());
+
+  JSONStreamReader separator_reader("[[] 2]", JSON_PARSE_RFC);
+  ASSERT_TRUE(separator_reader.BeginList());
+  ASSERT_TRUE(separator_reader.NextListItem());
+  EXPECT_TRUE(separator_reader.SkipValue());
+  EXPECT_FALSE(separator_reader.NextListItem());
+  EXPECT_EQ(JSONReader::JSON_SYNTAX_ERROR, separator_reader.error_code());
+
+  JSONStreamReader string_reader("\"unterminated", JSON_PARSE_RFC);
+  EXPECT_FALSE(string_reader.ReadString(&string_value));
+  EXPECT_TRUE(string_reader.has_error());
+
+  JSONStreamReader literal_reader("[tru]", JSON_PARSE_RFC);
+  EXPECT_FALSE(literal_reader.SkipValue());
+  EXPECT_EQ(JSONReader::JSON_SYNTAX_ERROR, literal_reader.error_code());
+
+  JSONStreamReader trailing_reader("[] []", JSON_PARSE_RFC);
+  EXPECT_TRUE(trailing_reader.SkipValue());
+  EXPECT_FALSE(trailing_reader.ReadEndOfInput());
+  EXPECT_EQ(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT,
+            trailing_reader.error_code());
+
+  std::string deep_json = std::string(200, '[') + std::string(200, ']');
+  JSONStreamReader deep_reader(deep_json, JSON_PARSE_RFC);
+  EXPECT_FALSE(deep_reader.SkipValue());
+  EXPECT_EQ(JSONReader::JSON_TOO_MUCH_NESTING, deep_reader.error_code());
+}
+
+}  // namespace base
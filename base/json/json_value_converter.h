@@ -10,12 +10,14 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/json/json_stream_reader.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
 #include "base/stl_util.h"
 #include "base/string16.h"
 #include "base/string_piece.h"
+#include "base/utf_string_conversions.h"
 #include "base/values.h"
 
 // JSONValueConverter converts a JSON value into a C++ struct in a
@@ -83,6 +85,14 @@
 //           "your_enum", &Message::ye, &ConvertFunc);
 //     }
 //   };
+//
+// Convert() can also read the struct straight from a JSONStreamReader, or
+// ConvertFromJSON() from a JSON string, without building a Value for the
+// whole of it.  Only the values of fields registered with a dotted path, or
+// with a custom Value converter, are built as Values then.
+//   Message message;
+//   JSONValueConverter<Message> converter;
+//   converter.ConvertFromJSON(json_string, &message);
 
 namespace base {
 
@@ -98,6 +108,8 @@ class FieldConverterBase {
   virtual ~FieldConverterBase() {}
   virtual bool ConvertField(const base::Value& value, StructType* obj)
       const = 0;
+  virtual bool ConvertFieldFromReader(JSONStreamReader* reader,
+                                      StructType* obj) const = 0;
   const std::string& field_path() const { return field_path_; }
 
  private:
@@ -110,6 +122,14 @@ class ValueConverter {
  public:
   virtual ~ValueConverter() {}
   virtual bool Convert(const base::Value& value, FieldType* field) const = 0;
+
+  // Converts the value |reader| is wound to.  By default, it is read into a
+  // Value for Convert().
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 FieldType* field) const {
+    scoped_ptr<base::Value> value(reader->ReadValue());
+    return value.get() && Convert(*value, field);
+  }
 };
 
 template <typename StructType, typename FieldType>
@@ -128,6 +148,12 @@ class FieldConverter : public FieldConverterBase<StructType> {
     return value_converter_->Convert(value, &(dst->*field_pointer_));
   }
 
+  virtual bool ConvertFieldFromReader(
+      JSONStreamReader* reader, StructType* dst) const OVERRIDE {
+    return value_converter_->ConvertFromReader(reader,
+                                               &(dst->*field_pointer_));
+  }
+
  private:
   FieldType StructType::* field_pointer_;
   scoped_ptr<ValueConverter<FieldType> > value_converter_;
@@ -146,6 +172,11 @@ class BasicValueConverter<int> : public ValueConverter<int> {
     return value.GetAsInteger(field);
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 int* field) const OVERRIDE {
+    return reader->ReadInteger(field);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -160,6 +191,11 @@ class BasicValueConverter<std::string> : public ValueConverter<std::string> {
     return value.GetAsString(field);
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 std::string* field) const OVERRIDE {
+    return reader->ReadString(field);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -174,6 +210,15 @@ class BasicValueConverter<string16> : public ValueConverter<string16> {
     return value.GetAsString(field);
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 string16* field) const OVERRIDE {
+    std::string string_value;
+    if (!reader->ReadString(&string_value))
+      return false;
+    *field = UTF8ToUTF16(string_value);
+    return true;
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -187,6 +232,11 @@ class BasicValueConverter<double> : public ValueConverter<double> {
     return value.GetAsDouble(field);
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 double* field) const OVERRIDE {
+    return reader->ReadDouble(field);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -200,6 +250,11 @@ class BasicValueConverter<bool> : public ValueConverter<bool> {
     return value.GetAsBoolean(field);
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 bool* field) const OVERRIDE {
+    return reader->ReadBoolean(field);
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -238,6 +293,13 @@ class CustomFieldConverter : public ValueConverter<FieldType> {
         convert_func_(string_value, field);
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 FieldType* field) const OVERRIDE {
+    std::string string_value;
+    return reader->ReadString(&string_value) &&
+        convert_func_(string_value, field);
+  }
+
  private:
   ConvertFunc convert_func_;
 
@@ -254,6 +316,11 @@ class NestedValueConverter : public ValueConverter<NestedType> {
     return converter_.Convert(value, field);
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 NestedType* field) const OVERRIDE {
+    return converter_.Convert(reader, field);
+  }
+
  private:
   JSONValueConverter<NestedType> converter_;
   DISALLOW_COPY_AND_ASSIGN(NestedValueConverter);
@@ -289,6 +356,22 @@ class RepeatedValueConverter : public ValueConverter<ScopedVector<Element> > {
     return true;
   }
 
+  virtual bool ConvertFromReader(JSONStreamReader* reader,
+                                 ScopedVector<Element>* field) const OVERRIDE {
+    if (!reader->BeginList())
+      return false;
+
+    while (reader->NextListItem()) {
+      scoped_ptr<Element> e(new Element);
+      if (!basic_converter_.ConvertFromReader(reader, e.get())) {
+        DVLOG(1) << "failure at " << field->size() << "-th element";
+        return false;
+      }
+      field->push_back(e.release());
+    }
+    return !reader->has_error();
+  }
+
  private:
   BasicValueConverter<Element> basic_converter_;
   DISALLOW_COPY_AND_ASSIGN(RepeatedValueConverter);
@@ -323,6 +406,23 @@ class RepeatedMessageConverter
     return true;
   }
 
+  virtual bool ConvertFromReader(
+      JSONStreamReader* reader,
+      ScopedVector<NestedType>* field) const OVERRIDE {
+    if (!reader->BeginList())
+      return false;
+
+    while (reader->NextListItem()) {
+      scoped_ptr<NestedType> nested(new NestedType);
+      if (!converter_.Convert(reader, nested.get())) {
+        DVLOG(1) << "failure at " << field->size() << "-th element";
+        return false;
+      }
+      field->push_back(nested.release());
+    }
+    return !reader->has_error();
+  }
+
  private:
   JSONValueConverter<NestedType> converter_;
   DISALLOW_COPY_AND_ASSIGN(RepeatedMessageConverter);
@@ -517,7 +617,87 @@ class JSONValueConverter {
     return true;
   }
 
+  // Converts the dictionary |reader| is wound to, reading the values of the
+  // fields as it goes and skipping the values of other keys.  Unlike above,
+  // a key which appears more than once is converted each time.
+  bool Convert(JSONStreamReader* reader, StructType* output) const {
+    if (!reader->BeginDictionary())
+      return false;
+
+    StringPiece key;
+    while (reader->NextKey(&key)) {
+      const internal::FieldConverterBase<StructType>* field_converter = NULL;
+      int matches = 0;
+      bool has_dotted_path = false;
+      for (size_t i = 0; i < fields_.size(); ++i) {
+        StringPiece path(fields_[i]->field_path());
+        size_t dot = path.find('.');
+        if (path.substr(0, dot) != key)
+          continue;
+        field_converter = fields_[i];
+        ++matches;
+        has_dotted_path |= dot != StringPiece::npos;
+      }
+
+      if (!matches) {
+        if (!reader->SkipValue())
+          return false;
+      } else if (matches == 1 && !has_dotted_path) {
+        if (!field_converter->ConvertFieldFromReader(reader, output)) {
+          DVLOG(1) << "failure at field " << field_converter->field_path();
+          return false;
+        }
+      } else if (!ConvertSubtree(key.as_string(), reader, output)) {
+        return false;
+      }
+    }
+    return !reader->has_error();
+  }
+
+  // Converts the JSON dictionary |json| like Convert() above.
+  bool ConvertFromJSON(const StringPiece& json, StructType* output) const {
+    JSONStreamReader reader(json, JSON_PARSE_RFC);
+    return Convert(&reader, output) && reader.ReadEndOfInput();
+  }
+
  private:
+  // Reads the value of |key| into a Value, and converts the fields whose
+  // paths start with |key| from it.
+  bool ConvertSubtree(const std::string& key,
+                      JSONStreamReader* reader,
+                      StructType* output) const {
+    scoped_ptr<base::Value> value(reader->ReadValue());
+    if (!value.get())
+      return false;
+
+    for (size_t i = 0; i < fields_.size(); ++i) {
+      const internal::FieldConverterBase<StructType>* field_converter =
+          fields_[i];
+      const std::string& path = field_converter->field_path();
+      if (path.compare(0, key.size(), key) != 0)
+        continue;
+
+      const base::Value* field = NULL;
+      if (path.size() == key.size()) {
+        field = value.get();
+      } else {
+        base::Value* subfield = NULL;
+        const DictionaryValue* dictionary_value = NULL;
+        if (path[key.size()] != '.' ||
+            !value->GetAsDictionary(&dictionary_value) ||
+            !dictionary_value->Get(path.substr(key.size() + 1), &subfield)) {
+          continue;
+        }
+        field = subfield;
+      }
+      if (!field_converter->ConvertField(*field, output)) {
+        DVLOG(1) << "failure at field " << path;
+        return false;
+      }
+    }
+    return true;
+  }
+
   ScopedVector<internal::FieldConverterBase<StructType> > fields_;
 
   DISALLOW_COPY_AND_ASSIGN(JSONValueConverter);
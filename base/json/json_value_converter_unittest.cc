@@ -92,6 +92,22 @@ struct NestedMessage {
   }
 };
 
+// For fields registered with dotted paths.
+struct DottedMessage {
+  int x;
+  int y;
+  std::string name;
+
+  DottedMessage() : x(0), y(0) {}
+
+  static void RegisterJSONConverter(
+      base::JSONValueConverter<DottedMessage>* converter) {
+    converter->RegisterIntField("point.x", &DottedMessage::x);
+    converter->RegisterIntField("point.y", &DottedMessage::y);
+    converter->RegisterStringField("name", &DottedMessage::name);
+  }
+};
+
 }  // namespace
 
 TEST(JSONValueConverterTest, ParseSimpleMessage) {
@@ -181,6 +197,74 @@ TEST(JSONValueConverterTest, ParseNestedMessage) {
   EXPECT_EQ(0U, second_child->string_values.size());
 }
 
+TEST(JSONValueConverterTest, ConvertFromJSON) {
+  const char normal_data[] =
+      "{\n"
+      "  \"unknown\": {\"foo\": [1, {\"bar\": null}]},\n"
+      "  \"foo\": 1.5,\n"
+      "  \"child\": {\n"
+      "    \"foo\": 1,\n"
+      "    \"bar\": \"b\\u0061r\",\n"
+      "    \"bstruct\": {},\n"
+      "    \"string_values\": [{\"val\": \"value_1\"}, {\"val\": \"value_2\"}],"
+      "    \"simple_enum\": \"bar\",\n"
+      "    \"ints\": [3, 4, 5],\n"
+      "    \"baz\": true\n"
+      "  },\n"
+      "  \"children\": [{\"foo\": 2, \"baz\": true}, {\"foo\": 3}]\n"
+      "}\n";
+
+  NestedMessage message;
+  base::JSONValueConverter<NestedMessage> converter;
+  EXPECT_TRUE(converter.ConvertFromJSON(normal_data, &message));
+
+  EXPECT_EQ(1.5, message.foo);
+  EXPECT_EQ(1, message.child.foo);
+  EXPECT_EQ("bar", message.child.bar);
+  EXPECT_TRUE(message.child.baz);
+  EXPECT_TRUE(message.child.bstruct);
+  EXPECT_EQ(SimpleMessage::BAR, message.child.simple_enum);
+  ASSERT_EQ(3U, message.child.ints.size());
+  EXPECT_EQ(5, *message.child.ints[2]);
+  ASSERT_EQ(2U, message.child.string_values.size());
+  EXPECT_EQ("value_2", *message.child.string_values[1]);
+  ASSERT_EQ(2U, message.children.size());
+  EXPECT_EQ(2, message.children[0]->foo);
+  EXPECT_TRUE(message.children[0]->baz);
+  EXPECT_EQ(3, message.children[1]->foo);
+  EXPECT_FALSE(message.children[1]->baz);
+
+  // The same failures as when converting a Value.
+  SimpleMessage simple_message;
+  base::JSONValueConverter<SimpleMessage> simple_converter;
+  EXPECT_FALSE(simple_converter.ConvertFromJSON(
+      "{\"foo\": 1, \"bar\": 2}", &simple_message));
+  EXPECT_FALSE(simple_converter.ConvertFromJSON(
+      "{\"simple_enum\": \"baz\"}", &simple_message));
+  EXPECT_FALSE(simple_converter.ConvertFromJSON(
+      "{\"ints\": [1, false]}", &simple_message));
+  // And for JSON which does not parse.
+  EXPECT_FALSE(simple_converter.ConvertFromJSON(
+      "{\"foo\": 1,}", &simple_message));
+  EXPECT_FALSE(simple_converter.ConvertFromJSON(
+      "{\"foo\": 1} 2", &simple_message));
+}
+
+TEST(JSONValueConverterTest, ConvertDottedPathsFromJSON) {
+  DottedMessage message;
+  base::JSONValueConverter<DottedMessage> converter;
+  EXPECT_TRUE(converter.ConvertFromJSON(
+      "{\"point\": {\"x\": 1, \"y\": 2, \"z\": 3}, \"name\": \"a\","
+      " \"point.x\": 4}",
+      &message));
+  EXPECT_EQ(1, message.x);
+  EXPECT_EQ(2, message.y);
+  EXPECT_EQ("a", message.name);
+
+  EXPECT_FALSE(converter.ConvertFromJSON("{\"point\": {\"x\": \"1\"}}",
+                                         &message));
+}
+
 TEST(JSONValueConverterTest, ParseFailures) {
   const char normal_data[] =
       "{\n"
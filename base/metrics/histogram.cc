@@ -16,6 +16,7 @@
 
 #include "base/debug/leak_annotations.h"
 #include "base/logging.h"
+#include "base/metrics/histogram_shared_memory.h"
 #include "base/pickle.h"
 #include "base/stringprintf.h"
 #include "base/synchronization/lock.h"
@@ -81,6 +82,56 @@ static uint32 number_of_vectors_saved_ = 0;
 // Collect the number of ranges_ elements saved because of caching ranges.
 static size_t saved_ranges_size_ = 0;
 
+namespace {
+
+// Adds |delta| to |*sum| and returns the new sum.  Where there are no 64-bit
+// atomic operations, a sample added at the same time on another thread may be
+// lost from the sum.
+int64 AddToSum(int64* sum, int64 delta) {
+#if defined(ARCH_CPU_64_BITS)
+  return subtle::NoBarrier_AtomicIncrement(
+      reinterpret_cast<subtle::Atomic64*>(sum), delta);
+#else
+  return *sum += delta;
+#endif
+}
+
+// Adds |count| samples of |value|, which goes into the bucket at |index|, to
+// |counts|, |*sum| and |*redundant_count|.
+void AccumulateCounts(Histogram::Sample value,
+                      Histogram::Count count,
+                      size_t index,
+                      subtle::Atomic32* counts,
+                      int64* sum,
+                      subtle::Atomic32* redundant_count) {
+  DCHECK(count == 1 || count == -1);
+  Histogram::Count bucket_count =
+      subtle::NoBarrier_AtomicIncrement(&counts[index], count);
+  int64 new_sum = AddToSum(sum, static_cast<int64>(count) * value);
+  Histogram::Count new_redundant_count =
+      subtle::NoBarrier_AtomicIncrement(redundant_count, count);
+  DCHECK_GE(bucket_count, 0);
+  DCHECK_GE(new_sum, 0);
+  DCHECK_GE(new_redundant_count, 0);
+}
+
+// Returns the FNV-1a hash of |name|, which places a histogram in the lookup
+// table of StatisticsRecorder.
+uint32 HashName(const std::string& name) {
+  uint32 hash = 2166136261u;
+  for (size_t i = 0; i < name.size(); ++i) {
+    hash ^= static_cast<unsigned char>(name[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// The number of slots of the lookup table of StatisticsRecorder looked at for
+// a name, before falling back on the locked map.
+const size_t kMaxLookupProbes = 8;
+
+}  // namespace
+
 Histogram* Histogram::FactoryGet(const std::string& name,
                                  Sample minimum,
                                  Sample maximum,
@@ -149,7 +200,18 @@ void Histogram::AddBoolean(bool value) {
 }
 
 void Histogram::AddSampleSet(const SampleSet& sample) {
-  sample_.Add(sample);
+  if (!shared_sample_) {
+    sample_.Add(sample);
+    return;
+  }
+  for (size_t index = 0; index < bucket_count(); ++index) {
+    subtle::NoBarrier_AtomicIncrement(&shared_sample_->counts[index],
+                                      sample.counts(index));
+  }
+  AddToSum(&shared_sample_->sum, sample.sum());
+  subtle::NoBarrier_AtomicIncrement(
+      &shared_sample_->redundant_count,
+      static_cast<Count>(sample.redundant_count()));
 }
 
 void Histogram::SetRangeDescriptions(const DescriptionPair descriptions[]) {
@@ -280,6 +342,39 @@ bool Histogram::DeserializeHistogramInfo(const std::string& histogram_info) {
   }
 
   DCHECK(pickle_flags & kIPCSerializationSourceFlag);
+  Flags flags = static_cast<Flags>(pickle_flags & ~kIPCSerializationSourceFlag);
+
+  std::vector<Histogram::Sample> custom_ranges;
+  if (histogram_type == CUSTOM_HISTOGRAM) {
+    // Check the size before allocating the ranges.
+    if (bucket_count < 2 || bucket_count > kBucketCount_MAX) {
+      DLOG(ERROR) << "Values error decoding Histogram: " << histogram_name;
+      return false;
+    }
+    custom_ranges.resize(bucket_count);
+    if (!CustomHistogram::DeserializeRanges(&iter, &custom_ranges)) {
+      DLOG(ERROR) << "Pickle error decoding ranges: " << histogram_name;
+      return false;
+    }
+  }
+
+  return AddSampleSetFromOtherProcess(histogram_name, histogram_type,
+                                      declared_min, declared_max, bucket_count,
+                                      range_checksum, flags, custom_ranges,
+                                      sample);
+}
+
+// static
+bool Histogram::AddSampleSetFromOtherProcess(
+    const std::string& histogram_name,
+    int histogram_type,
+    Sample declared_min,
+    Sample declared_max,
+    uint64 bucket_count,
+    uint32 range_checksum,
+    Flags flags,
+    const std::vector<Sample>& custom_ranges,
+    const SampleSet& sample) {
   // Since these fields may have come from an untrusted renderer, do additional
   // checks above and beyond those in Histogram::Initialize()
   if (declared_max <= 0 || declared_min <= 0 || declared_max < declared_min ||
@@ -288,8 +383,6 @@ bool Histogram::DeserializeHistogramInfo(const std::string& histogram_info) {
     return false;
   }
 
-  Flags flags = static_cast<Flags>(pickle_flags & ~kIPCSerializationSourceFlag);
-
   DCHECK_NE(NOT_VALID_IN_RENDERER, histogram_type);
 
   Histogram* render_histogram(NULL);
@@ -303,13 +396,12 @@ bool Histogram::DeserializeHistogramInfo(const std::string& histogram_info) {
   } else if (histogram_type == BOOLEAN_HISTOGRAM) {
     render_histogram = BooleanHistogram::FactoryGet(histogram_name, flags);
   } else if (histogram_type == CUSTOM_HISTOGRAM) {
-    std::vector<Histogram::Sample> sample_ranges(bucket_count);
-    if (!CustomHistogram::DeserializeRanges(&iter, &sample_ranges)) {
-      DLOG(ERROR) << "Pickle error decoding ranges: " << histogram_name;
+    if (custom_ranges.size() != bucket_count) {
+      DLOG(ERROR) << "Error decoding ranges: " << histogram_name;
       return false;
     }
     render_histogram =
-        CustomHistogram::FactoryGet(histogram_name, sample_ranges, flags);
+        CustomHistogram::FactoryGet(histogram_name, custom_ranges, flags);
   } else {
     DLOG(ERROR) << "Error Deserializing Histogram Unknown histogram_type: "
                 << histogram_type;
@@ -322,7 +414,8 @@ bool Histogram::DeserializeHistogramInfo(const std::string& histogram_info) {
   DCHECK_EQ(render_histogram->range_checksum(), range_checksum);
   DCHECK_EQ(render_histogram->histogram_type(), histogram_type);
 
-  if (render_histogram->flags() & kIPCSerializationSourceFlag) {
+  if (render_histogram->flags() & kIPCSerializationSourceFlag ||
+      render_histogram->in_shared_memory()) {
     DVLOG(1) << "Single process mode, histogram observed and not copied: "
              << histogram_name;
   } else {
@@ -393,11 +486,14 @@ size_t Histogram::bucket_count() const {
   return bucket_count_;
 }
 
-// Do a safe atomic snapshot of sample data.
-// This implementation assumes we are on a safe single thread.
+// Snapshot the sample data.  Samples may be accumulated while the counts are
+// copied, in which case the snapshot may hold some of a sample's counts but not
+// all; FindCorruption() tolerates the resulting small count mismatch.
 void Histogram::SnapshotSample(SampleSet* sample) const {
-  // Note locking not done in this version!!!
-  *sample = sample_;
+  if (shared_sample_)
+    sample->CopyFrom(*shared_sample_, bucket_count());
+  else
+    *sample = sample_;
 }
 
 bool Histogram::HasConstructorArguments(Sample minimum,
@@ -428,7 +524,8 @@ Histogram::Histogram(const std::string& name, Sample minimum,
     flags_(kNoFlags),
     cached_ranges_(new CachedRanges(bucket_count + 1, 0)),
     range_checksum_(0),
-    sample_() {
+    sample_(),
+    shared_sample_(NULL) {
   Initialize();
 }
 
@@ -441,7 +538,8 @@ Histogram::Histogram(const std::string& name, TimeDelta minimum,
     flags_(kNoFlags),
     cached_ranges_(new CachedRanges(bucket_count + 1, 0)),
     range_checksum_(0),
-    sample_() {
+    sample_(),
+    shared_sample_(NULL) {
   Initialize();
 }
 
@@ -553,8 +651,12 @@ const std::string Histogram::GetAsciiBucketRange(size_t i) const {
 
 // Update histogram data with new sample.
 void Histogram::Accumulate(Sample value, Count count, size_t index) {
-  // Note locking not done in this version!!!
-  sample_.Accumulate(value, count, index);
+  if (shared_sample_) {
+    AccumulateCounts(value, count, index, shared_sample_->counts,
+                     &shared_sample_->sum, &shared_sample_->redundant_count);
+  } else {
+    sample_.Accumulate(value, count, index);
+  }
 }
 
 void Histogram::SetBucketRange(size_t i, Sample value) {
@@ -720,13 +822,8 @@ void Histogram::SampleSet::CheckSize(const Histogram& histogram) const {
 
 void Histogram::SampleSet::Accumulate(Sample value,  Count count,
                                       size_t index) {
-  DCHECK(count == 1 || count == -1);
-  counts_[index] += count;
-  sum_ += count * value;
-  redundant_count_ += count;
-  DCHECK_GE(counts_[index], 0);
-  DCHECK_GE(sum_, 0);
-  DCHECK_GE(redundant_count_, 0);
+  AccumulateCounts(value, count, index, &counts_[0], &sum_,
+                   &redundant_count_);
 }
 
 Count Histogram::SampleSet::TotalCount() const {
@@ -760,6 +857,15 @@ void Histogram::SampleSet::Subtract(const SampleSet& other) {
   }
 }
 
+void Histogram::SampleSet::CopyFrom(const SharedSamples& shared,
+                                    size_t bucket_count) {
+  counts_.resize(bucket_count);
+  for (size_t index = 0; index < bucket_count; ++index)
+    counts_[index] = subtle::NoBarrier_Load(&shared.counts[index]);
+  sum_ = shared.sum;
+  redundant_count_ = subtle::NoBarrier_Load(&shared.redundant_count);
+}
+
 bool Histogram::SampleSet::Serialize(Pickle* pickle) const {
   pickle->WriteInt64(sum_);
   pickle->WriteInt64(redundant_count_);
@@ -777,13 +883,15 @@ bool Histogram::SampleSet::Deserialize(PickleIterator* iter) {
   DCHECK_EQ(sum_, 0);
   DCHECK_EQ(redundant_count_, 0);
 
+  int64 redundant_count;
   uint64 counts_size;
 
   if (!iter->ReadInt64(&sum_) ||
-      !iter->ReadInt64(&redundant_count_) ||
+      !iter->ReadInt64(&redundant_count) ||
       !iter->ReadUInt64(&counts_size)) {
     return false;
   }
+  redundant_count_ = static_cast<Count>(redundant_count);
 
   if (counts_size == 0)
     return false;
@@ -1037,6 +1145,72 @@ double CustomHistogram::GetBucketSize(Count current, size_t i) const {
   return 1;
 }
 
+//------------------------------------------------------------------------------
+// SparseHistogram:
+//------------------------------------------------------------------------------
+
+// static
+SparseHistogram* SparseHistogram::FactoryGet(const std::string& name,
+                                             Histogram::Flags flags) {
+  SparseHistogram* histogram(NULL);
+  if (!StatisticsRecorder::FindSparseHistogram(name, &histogram)) {
+    // To avoid racy destruction at shutdown, the following will be leaked.
+    SparseHistogram* tentative_histogram = new SparseHistogram(name, flags);
+    histogram = StatisticsRecorder::RegisterOrDeleteDuplicateSparse(
+        tentative_histogram);
+  }
+  return histogram;
+}
+
+void SparseHistogram::Add(Histogram::Sample value) {
+  base::AutoLock auto_lock(lock_);
+  ++samples_[value];
+}
+
+void SparseHistogram::SnapshotSamples(Samples* samples) const {
+  base::AutoLock auto_lock(lock_);
+  *samples = samples_;
+}
+
+void SparseHistogram::WriteHTMLGraph(std::string* output) const {
+  output->append("<PRE>");
+  WriteAscii("<br>", output);
+  output->append("</PRE>");
+}
+
+void SparseHistogram::WriteAscii(const std::string& newline,
+                                 std::string* output) const {
+  Samples snapshot;
+  SnapshotSamples(&snapshot);
+
+  Histogram::Count sample_count = 0;
+  for (Samples::const_iterator it = snapshot.begin(); it != snapshot.end();
+       ++it) {
+    sample_count += it->second;
+  }
+  StringAppendF(output, "Histogram: %s recorded %d samples",
+                histogram_name_.c_str(), sample_count);
+  if (flags_)
+    StringAppendF(output, " (flags = 0x%x)", flags_);
+  output->append(newline);
+
+  for (Samples::const_iterator it = snapshot.begin(); it != snapshot.end();
+       ++it) {
+    StringAppendF(output, "%d (%d = %3.1f%%)", it->first, it->second,
+                  it->second * 100.0 / sample_count);
+    output->append(newline);
+  }
+}
+
+SparseHistogram::SparseHistogram(const std::string& name,
+                                 Histogram::Flags flags)
+    : histogram_name_(name),
+      flags_(flags) {
+}
+
+SparseHistogram::~SparseHistogram() {
+}
+
 //------------------------------------------------------------------------------
 // The next section handles global (central) support for all histograms, as well
 // as startup/teardown of this service.
@@ -1058,6 +1232,7 @@ StatisticsRecorder::StatisticsRecorder() {
   }
   base::AutoLock auto_lock(*lock_);
   histograms_ = new HistogramMap;
+  sparse_histograms_ = new SparseHistogramMap;
   ranges_ = new RangesMap;
 }
 
@@ -1071,10 +1246,16 @@ StatisticsRecorder::~StatisticsRecorder() {
   }
   // Clean up.
   HistogramMap* histograms = NULL;
+  SparseHistogramMap* sparse_histograms = NULL;
   {
     base::AutoLock auto_lock(*lock_);
     histograms = histograms_;
     histograms_ = NULL;
+    sparse_histograms = sparse_histograms_;
+    sparse_histograms_ = NULL;
+    shared_memory_ = NULL;
+    for (size_t i = 0; i < kLookupTableSize; ++i)
+      subtle::NoBarrier_Store(&lookup_table_[i], 0);
   }
   RangesMap* ranges = NULL;
   {
@@ -1084,6 +1265,7 @@ StatisticsRecorder::~StatisticsRecorder() {
   }
   // We are going to leak the histograms and the ranges.
   delete histograms;
+  delete sparse_histograms;
   delete ranges;
   // We don't delete lock_ on purpose to avoid having to properly protect
   // against it going away after we checked for NULL in the static methods.
@@ -1120,6 +1302,9 @@ Histogram* StatisticsRecorder::RegisterOrDeleteDuplicate(Histogram* histogram) {
     (*histograms_)[name] = histogram;
     ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
     RegisterOrDeleteDuplicateRanges(histogram);
+    AddToLookupTable(histogram);
+    if (shared_memory_)
+      histogram->shared_sample_ = shared_memory_->AllocateSamples(*histogram);
     ++number_of_histograms_;
   } else {
     delete histogram;  // We already have one by this name.
@@ -1128,6 +1313,39 @@ Histogram* StatisticsRecorder::RegisterOrDeleteDuplicate(Histogram* histogram) {
   return histogram;
 }
 
+// static
+void StatisticsRecorder::SetSharedMemory(HistogramSharedMemory* shared_memory) {
+  if (lock_ == NULL)
+    return;
+  base::AutoLock auto_lock(*lock_);
+  shared_memory_ = shared_memory;
+}
+
+// static
+SparseHistogram* StatisticsRecorder::RegisterOrDeleteDuplicateSparse(
+    SparseHistogram* histogram) {
+  if (lock_ == NULL) {
+    ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
+    return histogram;
+  }
+  base::AutoLock auto_lock(*lock_);
+  if (!sparse_histograms_) {
+    ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
+    return histogram;
+  }
+  const std::string name = histogram->histogram_name();
+  SparseHistogramMap::iterator it = sparse_histograms_->find(name);
+  // Avoid overwriting a previous registration.
+  if (sparse_histograms_->end() == it) {
+    (*sparse_histograms_)[name] = histogram;
+    ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
+  } else {
+    delete histogram;  // We already have one by this name.
+    histogram = it->second;
+  }
+  return histogram;
+}
+
 // static
 void StatisticsRecorder::RegisterOrDeleteDuplicateRanges(Histogram* histogram) {
   DCHECK(histogram);
@@ -1229,6 +1447,15 @@ void StatisticsRecorder::WriteHTMLGraph(const std::string& query,
     (*it)->WriteHTMLGraph(output);
     output->append("<br><hr><br>");
   }
+
+  SparseHistograms sparse_snapshot;
+  GetSparseSnapshot(query, &sparse_snapshot);
+  for (SparseHistograms::iterator it = sparse_snapshot.begin();
+       it != sparse_snapshot.end();
+       ++it) {
+    (*it)->WriteHTMLGraph(output);
+    output->append("<br><hr><br>");
+  }
 }
 
 // static
@@ -1249,6 +1476,15 @@ void StatisticsRecorder::WriteGraph(const std::string& query,
     (*it)->WriteAscii(true, "\n", output);
     output->append("\n");
   }
+
+  SparseHistograms sparse_snapshot;
+  GetSparseSnapshot(query, &sparse_snapshot);
+  for (SparseHistograms::iterator it = sparse_snapshot.begin();
+       it != sparse_snapshot.end();
+       ++it) {
+    (*it)->WriteAscii("\n", output);
+    output->append("\n");
+  }
 }
 
 // static
@@ -1270,6 +1506,12 @@ bool StatisticsRecorder::FindHistogram(const std::string& name,
                                        Histogram** histogram) {
   if (lock_ == NULL)
     return false;
+  Histogram* found = FindInLookupTable(name);
+  if (found) {
+    *histogram = found;
+    return true;
+  }
+  // The histogram may not have made it into the lookup table.
   base::AutoLock auto_lock(*lock_);
   if (!histograms_)
     return false;
@@ -1280,6 +1522,21 @@ bool StatisticsRecorder::FindHistogram(const std::string& name,
   return true;
 }
 
+// static
+bool StatisticsRecorder::FindSparseHistogram(const std::string& name,
+                                             SparseHistogram** histogram) {
+  if (lock_ == NULL)
+    return false;
+  base::AutoLock auto_lock(*lock_);
+  if (!sparse_histograms_)
+    return false;
+  SparseHistogramMap::iterator it = sparse_histograms_->find(name);
+  if (sparse_histograms_->end() == it)
+    return false;
+  *histogram = it->second;
+  return true;
+}
+
 // private static
 void StatisticsRecorder::GetSnapshot(const std::string& query,
                                      Histograms* snapshot) {
@@ -1296,6 +1553,51 @@ void StatisticsRecorder::GetSnapshot(const std::string& query,
   }
 }
 
+// static
+void StatisticsRecorder::GetSparseSnapshot(const std::string& query,
+                                           SparseHistograms* snapshot) {
+  if (lock_ == NULL)
+    return;
+  base::AutoLock auto_lock(*lock_);
+  if (!sparse_histograms_)
+    return;
+  for (SparseHistogramMap::iterator it = sparse_histograms_->begin();
+       sparse_histograms_->end() != it;
+       ++it) {
+    if (it->first.find(query) != std::string::npos)
+      snapshot->push_back(it->second);
+  }
+}
+
+// private static
+void StatisticsRecorder::AddToLookupTable(Histogram* histogram) {
+  lock_->AssertAcquired();
+  size_t slot = HashName(histogram->histogram_name());
+  for (size_t probe = 0; probe < kMaxLookupProbes; ++probe, ++slot) {
+    subtle::AtomicWord* entry = &lookup_table_[slot & (kLookupTableSize - 1)];
+    if (!subtle::NoBarrier_Load(entry)) {
+      // Makes the histogram visible to readers of the slot.
+      subtle::Release_Store(entry,
+                            reinterpret_cast<subtle::AtomicWord>(histogram));
+      return;
+    }
+  }
+}
+
+// private static
+Histogram* StatisticsRecorder::FindInLookupTable(const std::string& name) {
+  size_t slot = HashName(name);
+  for (size_t probe = 0; probe < kMaxLookupProbes; ++probe, ++slot) {
+    Histogram* histogram = reinterpret_cast<Histogram*>(subtle::Acquire_Load(
+        &lookup_table_[slot & (kLookupTableSize - 1)]));
+    if (!histogram)
+      return NULL;
+    if (histogram->histogram_name() == name)
+      return histogram;
+  }
+  return NULL;
+}
+
 CachedRanges::CachedRanges(size_t bucket_count, int initial_value)
     : ranges_(bucket_count, initial_value),
       range_checksum_(0) {
@@ -1325,9 +1627,17 @@ bool CachedRanges::Equals(CachedRanges* other) const {
 // static
 StatisticsRecorder::HistogramMap* StatisticsRecorder::histograms_ = NULL;
 // static
+StatisticsRecorder::SparseHistogramMap*
+    StatisticsRecorder::sparse_histograms_ = NULL;
+// static
 StatisticsRecorder::RangesMap* StatisticsRecorder::ranges_ = NULL;
 // static
+HistogramSharedMemory* StatisticsRecorder::shared_memory_ = NULL;
+// static
 base::Lock* StatisticsRecorder::lock_ = NULL;
 // static
+subtle::AtomicWord
+    StatisticsRecorder::lookup_table_[StatisticsRecorder::kLookupTableSize];
+// static
 bool StatisticsRecorder::dump_on_exit_ = false;
 }  // namespace base
@@ -51,6 +51,7 @@
 #include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
+#include "base/synchronization/lock.h"
 #include "base/time.h"
 
 class Pickle;
@@ -58,7 +59,6 @@ class PickleIterator;
 
 namespace base {
 
-class Lock;
 //------------------------------------------------------------------------------
 // Histograms are often put in areas where they are called many many times, and
 // performance is critical.  As a result, they are designed to have a very low
@@ -185,6 +185,18 @@ class Lock;
         base::CustomHistogram::FactoryGet(name, custom_ranges, \
                                           base::Histogram::kNoFlags))
 
+// Support histograming of samples spread over a range too large for buckets,
+// such as error codes or sizes, each distinct value being counted on its own.
+// The histogram is looked up on each use, and samples are recorded under a
+// lock, so this is slower than the other macros. Sparse histograms are not
+// uploaded by UMA, so there is no UMA_ flavor of this macro.
+#define HISTOGRAM_SPARSE_SLOWLY(name, sample) \
+    do { \
+      base::SparseHistogram* histogram = base::SparseHistogram::FactoryGet( \
+          name, base::Histogram::kNoFlags); \
+      histogram->Add(sample); \
+    } while (0)
+
 //------------------------------------------------------------------------------
 // Define Debug vs non-debug flavors of macros.
 #ifndef NDEBUG
@@ -322,7 +334,9 @@ class BooleanHistogram;
 class CachedRanges;
 class CustomHistogram;
 class Histogram;
+class HistogramSharedMemory;
 class LinearHistogram;
+class SparseHistogram;
 
 class BASE_EXPORT Histogram {
  public:
@@ -379,6 +393,15 @@ class BASE_EXPORT Histogram {
     const char* description;  // Null means end of a list of pairs.
   };
 
+  // The statistic values of a histogram allocated in a HistogramSharedMemory,
+  // where another process can read them.  |counts| is followed by the rest of
+  // the bucket_count() counts.
+  struct SharedSamples {
+    int64 sum;
+    subtle::Atomic32 redundant_count;
+    subtle::Atomic32 counts[1];
+  };
+
   //----------------------------------------------------------------------------
   // Statistic values, developed over the life of the histogram.
 
@@ -391,7 +414,8 @@ class BASE_EXPORT Histogram {
     void Resize(const Histogram& histogram);
     void CheckSize(const Histogram& histogram) const;
 
-    // Accessor for histogram to make routine additions.
+    // Accessor for histogram to make routine additions. The counts are updated
+    // atomically, so samples can be accumulated from several threads at once.
     void Accumulate(Sample value, Count count, size_t index);
 
     // Accessor methods.
@@ -404,6 +428,10 @@ class BASE_EXPORT Histogram {
     void Add(const SampleSet& other);
     void Subtract(const SampleSet& other);
 
+    // Replaces the contents of the set with a copy of the |bucket_count|
+    // counts and the stats of |shared|.
+    void CopyFrom(const SharedSamples& shared, size_t bucket_count);
+
     bool Serialize(Pickle* pickle) const;
     bool Deserialize(PickleIterator* iter);
 
@@ -413,7 +441,8 @@ class BASE_EXPORT Histogram {
     Counts counts_;
 
     // Save simple stats locally.  Note that this MIGHT get done in base class
-    // without shared memory at some point.
+    // without shared memory at some point.  The sum is only updated atomically
+    // on 64-bit platforms, where 64-bit atomic operations are available.
     int64 sum_;         // sum of samples.
 
    private:
@@ -423,11 +452,9 @@ class BASE_EXPORT Histogram {
     // To help identify memory corruption, we reduntantly save the number of
     // samples we've accumulated into all of our buckets.  We can compare this
     // count to the sum of the counts in all buckets, and detect problems.  Note
-    // that due to races in histogram accumulation (if a histogram is indeed
-    // updated on several threads simultaneously), the tallies might mismatch,
-    // and also the snapshotting code may asynchronously get a mismatch (though
-    // generally either race based mismatch cause is VERY rare).
-    int64 redundant_count_;
+    // that the snapshotting code may asynchronously get a mismatch, if samples
+    // are accumulated while the counts are copied (though this is VERY rare).
+    Count redundant_count_;
   };
 
   //----------------------------------------------------------------------------
@@ -497,6 +524,22 @@ class BASE_EXPORT Histogram {
   // browser process.
   static bool DeserializeHistogramInfo(const std::string& histogram_info);
 
+  // Adds |sample| to the histogram named |histogram_name| in this process,
+  // building it from the other arguments if needed.  The arguments come from
+  // another process, which is not trusted, and are checked first.
+  // |custom_ranges| are only used for CUSTOM_HISTOGRAM.  Returns false if the
+  // arguments don't describe a valid histogram.
+  static bool AddSampleSetFromOtherProcess(
+      const std::string& histogram_name,
+      int histogram_type,
+      Sample declared_min,
+      Sample declared_max,
+      uint64 bucket_count,
+      uint32 range_checksum,
+      Flags flags,
+      const std::vector<Sample>& custom_ranges,
+      const SampleSet& sample);
+
   // Check to see if bucket ranges, counts and tallies in the snapshot are
   // consistent with the bucket ranges and checksums in our histogram.  This can
   // produce a false-alarm if a race occurred in the reading of the data during
@@ -518,6 +561,8 @@ class BASE_EXPORT Histogram {
   void set_cached_ranges(CachedRanges* cached_ranges) {
     cached_ranges_ = cached_ranges;
   }
+  // Whether the samples are recorded in a HistogramSharedMemory.
+  bool in_shared_memory() const { return shared_sample_ != NULL; }
   // Snapshot the current complete set of sample data.
   // Override with atomic/locked snapshot if needed.
   virtual void SnapshotSample(SampleSet* sample) const;
@@ -593,7 +638,9 @@ class BASE_EXPORT Histogram {
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, Crc32SampleHash);
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, Crc32TableTest);
 
-  friend class StatisticsRecorder;  // To allow it to delete duplicates.
+  // To allow it to delete duplicates, and to allocate the samples in shared
+  // memory.
+  friend class StatisticsRecorder;
 
   // Post constructor initialization.
   void Initialize();
@@ -626,6 +673,9 @@ class BASE_EXPORT Histogram {
   void WriteAsciiBucketGraph(double current_size, double max_size,
                              std::string* output) const;
 
+  // The size of the cache lines the sample data is padded out to.
+  static const size_t kCacheLineSize = 64;
+
   //----------------------------------------------------------------------------
   // Table for generating Crc32 values.
   static const uint32 kCrcTable[256];
@@ -654,8 +704,16 @@ class BASE_EXPORT Histogram {
   uint32 range_checksum_;
 
   // Finally, provide the state that changes with the addition of each new
-  // sample.
+  // sample.  It is padded out to cache lines of its own, so that the threads
+  // writing the counts don't keep taking away the lines holding the fields
+  // above, which are read on each addition.
+  char leading_padding_[kCacheLineSize];
   SampleSet sample_;
+  char trailing_padding_[kCacheLineSize];
+
+  // When the histogram was allocated in a HistogramSharedMemory, the samples
+  // are recorded there instead of in |sample_|.
+  SharedSamples* shared_sample_;
 
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
@@ -775,6 +833,50 @@ class BASE_EXPORT CustomHistogram : public Histogram {
   DISALLOW_COPY_AND_ASSIGN(CustomHistogram);
 };
 
+//------------------------------------------------------------------------------
+
+// SparseHistogram counts each distinct sample on its own, rather than in
+// buckets. It suits samples spread over a range too large to give buckets to,
+// of which only a few values are seen, such as error codes. Samples are
+// recorded under a lock.
+class BASE_EXPORT SparseHistogram {
+ public:
+  typedef std::map<Histogram::Sample, Histogram::Count> Samples;
+
+  // Returns the histogram registered as |name|, creating it if needed.
+  static SparseHistogram* FactoryGet(const std::string& name,
+                                     Histogram::Flags flags);
+
+  void Add(Histogram::Sample value);
+
+  // Copies the counts of the samples recorded so far to |*samples|.
+  void SnapshotSamples(Samples* samples) const;
+
+  // The following methods provide graphical histogram displays.
+  void WriteHTMLGraph(std::string* output) const;
+  void WriteAscii(const std::string& newline, std::string* output) const;
+
+  const std::string& histogram_name() const { return histogram_name_; }
+  int flags() const { return flags_; }
+
+ private:
+  friend class StatisticsRecorder;  // To allow it to delete duplicates.
+
+  SparseHistogram(const std::string& name, Histogram::Flags flags);
+  ~SparseHistogram();
+
+  const std::string histogram_name_;
+  const Histogram::Flags flags_;
+
+  // Protects |samples_|.
+  mutable base::Lock lock_;
+
+  // The count of each sample recorded.
+  Samples samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(SparseHistogram);
+};
+
 //------------------------------------------------------------------------------
 // StatisticsRecorder handles all histograms in the system.  It provides a
 // general place for histograms to register, and supports a global API for
@@ -783,6 +885,7 @@ class BASE_EXPORT CustomHistogram : public Histogram {
 class BASE_EXPORT StatisticsRecorder {
  public:
   typedef std::vector<Histogram*> Histograms;
+  typedef std::vector<SparseHistogram*> SparseHistograms;
 
   StatisticsRecorder();
 
@@ -805,6 +908,19 @@ class BASE_EXPORT StatisticsRecorder {
   // pre-existing registered cached_ranges_).
   static void RegisterOrDeleteDuplicateRanges(Histogram* histogram);
 
+  // Has the histograms registered from now on record their samples in
+  // |shared_memory|, rather than in memory of their own, until it is full.
+  // |shared_memory| is used for as long as these histograms, which is until
+  // the process exits.  This is meant to be called early on in child
+  // processes, before the histograms are used, so that the browser process
+  // can read them with HistogramSharedMemory::MergeDeltas().  Pass NULL to
+  // stop allocating histograms in |shared_memory|.
+  static void SetSharedMemory(HistogramSharedMemory* shared_memory);
+
+  // As RegisterOrDeleteDuplicate(), for sparse histograms.
+  static SparseHistogram* RegisterOrDeleteDuplicateSparse(
+      SparseHistogram* histogram);
+
   // Method for collecting stats about histograms created in browser and
   // renderer processes. |suffix| is appended to histogram names. |suffix| could
   // be either browser or renderer.
@@ -820,10 +936,14 @@ class BASE_EXPORT StatisticsRecorder {
   static void GetHistograms(Histograms* output);
 
   // Find a histogram by name. It matches the exact name. This method is thread
-  // safe.  If a matching histogram is not found, then the |histogram| is
-  // not changed.
+  // safe, and does not take the lock once the histogram is registered.  If a
+  // matching histogram is not found, then the |histogram| is not changed.
   static bool FindHistogram(const std::string& query, Histogram** histogram);
 
+  // As FindHistogram(), for sparse histograms.  This always takes the lock.
+  static bool FindSparseHistogram(const std::string& name,
+                                  SparseHistogram** histogram);
+
   static bool dump_on_exit() { return dump_on_exit_; }
 
   static void set_dump_on_exit(bool enable) { dump_on_exit_ = enable; }
@@ -834,23 +954,49 @@ class BASE_EXPORT StatisticsRecorder {
   // pointer to be copied.
   static void GetSnapshot(const std::string& query, Histograms* snapshot);
 
+  // As GetSnapshot(), for sparse histograms.
+  static void GetSparseSnapshot(const std::string& query,
+                                SparseHistograms* snapshot);
 
  private:
   // We keep all registered histograms in a map, from name to histogram.
   typedef std::map<std::string, Histogram*> HistogramMap;
+  typedef std::map<std::string, SparseHistogram*> SparseHistogramMap;
 
   // We keep all |cached_ranges_| in a map, from checksum to a list of
   // |cached_ranges_|.  Checksum is calculated from the |ranges_| in
   // |cached_ranges_|.
   typedef std::map<uint32, std::list<CachedRanges*>*> RangesMap;
 
+  // The number of slots of |lookup_table_|, a power of two.
+  static const size_t kLookupTableSize = 4096;
+
+  // Adds |histogram| to |lookup_table_|, unless the slots it may go to are
+  // all taken.  Called with |lock_| held.
+  static void AddToLookupTable(Histogram* histogram);
+
+  // Returns the histogram named |name| in |lookup_table_|, or NULL.
+  static Histogram* FindInLookupTable(const std::string& name);
+
   static HistogramMap* histograms_;
 
+  static SparseHistogramMap* sparse_histograms_;
+
   static RangesMap* ranges_;
 
+  // Where newly registered histograms are allocated, or NULL.
+  static HistogramSharedMemory* shared_memory_;
+
   // lock protects access to the above map.
   static base::Lock* lock_;
 
+  // An open addressed hash table of the registered histograms, keyed by name,
+  // which FindHistogram() reads without taking |lock_|.  Slots are only
+  // filled in under |lock_|, with Release_Store(), and are emptied when the
+  // StatisticsRecorder is destroyed.  The histograms they point to are leaked,
+  // so a reader which loaded a slot can go on using it.
+  static subtle::AtomicWord lookup_table_[kLookupTableSize];
+
   // Dump all known histograms to log.
   static bool dump_on_exit_;
 
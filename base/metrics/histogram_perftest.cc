@@ -0,0 +1,111 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "base/metrics/histogram.h"
+#include "base/stringprintf.h"
+#include "base/test/perf_test_threads.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kSamplesPerThread = 200000;
+const int kHistogramCount = 4;
+
+enum RecordMethod {
+  // Add() to histograms held on to.
+  ADD,
+  // Look the histograms up by name with FactoryGet(), then Add().
+  FACTORY_GET_AND_ADD,
+  // HISTOGRAM_SPARSE_SLOWLY().
+  SPARSE_ADD,
+};
+
+// Records kSamplesPerThread samples, spread over the shared histograms, from
+// its thread.
+class RecordSamplesThread : public DelegateSimpleThread::Delegate {
+ public:
+  RecordSamplesThread(RecordMethod method,
+                      const std::vector<std::string>& names,
+                      const std::vector<Histogram*>& histograms)
+      : method_(method),
+        names_(names),
+        histograms_(histograms) {
+  }
+  virtual ~RecordSamplesThread() {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kSamplesPerThread; ++i) {
+      int index = i % kHistogramCount;
+      switch (method_) {
+        case ADD:
+          histograms_[index]->Add(i & 1023);
+          break;
+        case FACTORY_GET_AND_ADD:
+          Histogram::FactoryGet(names_[index], 1, 1000, 50,
+                                Histogram::kNoFlags)->Add(i & 1023);
+          break;
+        case SPARSE_ADD:
+          HISTOGRAM_SPARSE_SLOWLY(names_[index], i & 1023);
+          break;
+      }
+    }
+  }
+
+ private:
+  const RecordMethod method_;
+  const std::vector<std::string>& names_;
+  const std::vector<Histogram*>& histograms_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordSamplesThread);
+};
+
+class HistogramPerfTest : public testing::Test {
+ protected:
+  // Records samples with |method| into histograms of their own.
+  void RecordFromThreads(const char* test_name,
+                         RecordMethod method,
+                         int thread_count) {
+    StatisticsRecorder recorder;
+    std::vector<std::string> names;
+    std::vector<Histogram*> histograms;
+    for (int i = 0; i < kHistogramCount; ++i) {
+      names.push_back(StringPrintf("Perf.%s.%d", test_name, i));
+      histograms.push_back(Histogram::FactoryGet(names.back(), 1, 1000, 50,
+                                                 Histogram::kNoFlags));
+    }
+
+    RecordSamplesThread delegate(method, names, histograms);
+    RunOnThreadsAndLogPerf(test_name, &delegate, thread_count,
+                           kSamplesPerThread, "ns/sample");
+  }
+};
+
+}  // namespace
+
+// The counters are updated atomically rather than under a lock, so threads
+// only contend for the cache lines of the shared histograms.
+TEST_F(HistogramPerfTest, Add) {
+  RecordFromThreads("histogram_add", ADD, 1);
+  RecordFromThreads("histogram_add", ADD, 16);
+}
+
+// Registered histograms are found without taking the lock of
+// StatisticsRecorder.
+TEST_F(HistogramPerfTest, FactoryGetAndAdd) {
+  RecordFromThreads("histogram_factory_get", FACTORY_GET_AND_ADD, 1);
+  RecordFromThreads("histogram_factory_get", FACTORY_GET_AND_ADD, 16);
+}
+
+TEST_F(HistogramPerfTest, SparseAdd) {
+  RecordFromThreads("sparse_histogram_add", SPARSE_ADD, 1);
+  RecordFromThreads("sparse_histogram_add", SPARSE_ADD, 16);
+}
+
+}  // namespace base
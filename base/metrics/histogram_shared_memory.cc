@@ -0,0 +1,225 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/histogram_shared_memory.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/atomicops.h"
+#include "base/logging.h"
+#include "base/shared_memory.h"
+
+namespace base {
+
+namespace {
+
+// The start of the arena.
+struct ArenaHeader {
+  // The number of bytes of records allocated after the header.
+  subtle::Atomic32 allocated;
+  uint32 padding;
+};
+
+// The fixed size part of a record, followed by the SharedSamples.
+struct RecordHeader {
+  // The size of the whole record, a multiple of kRecordAlignment.
+  uint32 size;
+  int32 histogram_type;
+  int32 flags;
+  int32 declared_min;
+  int32 declared_max;
+  uint32 bucket_count;
+  uint32 range_checksum;
+  uint32 name_length;
+};
+
+// Records are aligned for the sum of their SharedSamples.
+const size_t kRecordAlignment = 8;
+
+COMPILE_ASSERT(sizeof(ArenaHeader) % kRecordAlignment == 0,
+               arena_header_keeps_records_aligned);
+COMPILE_ASSERT(sizeof(RecordHeader) % kRecordAlignment == 0,
+               record_header_keeps_samples_aligned);
+
+// Returns the size of the SharedSamples of |bucket_count| buckets.
+size_t SamplesSize(size_t bucket_count) {
+  return offsetof(Histogram::SharedSamples, counts) +
+         bucket_count * sizeof(subtle::Atomic32);
+}
+
+// Returns the size of the record of a histogram.
+size_t RecordSize(size_t bucket_count,
+                  size_t ranges_count,
+                  size_t name_length) {
+  size_t size = sizeof(RecordHeader) + SamplesSize(bucket_count) +
+                ranges_count * sizeof(Histogram::Sample) + name_length;
+  return (size + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+// Returns the number of bucket ranges stored in the record of a histogram.
+size_t RangesCount(int histogram_type, size_t bucket_count) {
+  return histogram_type == Histogram::CUSTOM_HISTOGRAM ? bucket_count : 0;
+}
+
+}  // namespace
+
+HistogramSharedMemory::Record::Record()
+    : samples_offset(0),
+      histogram_type(Histogram::NOT_VALID_IN_RENDERER),
+      declared_min(0),
+      declared_max(0),
+      bucket_count(0),
+      range_checksum(0),
+      flags(Histogram::kNoFlags),
+      has_merged(false) {
+}
+
+HistogramSharedMemory::Record::~Record() {
+}
+
+HistogramSharedMemory::HistogramSharedMemory(SharedMemory* shared_memory,
+                                             size_t size)
+    : shared_memory_(shared_memory),
+      size_(size),
+      read_offset_(sizeof(ArenaHeader)) {
+  DCHECK(shared_memory_->memory());
+  DCHECK_GE(size_, sizeof(ArenaHeader));
+}
+
+HistogramSharedMemory::~HistogramSharedMemory() {
+}
+
+Histogram::SharedSamples* HistogramSharedMemory::AllocateSamples(
+    const Histogram& histogram) {
+  char* arena = static_cast<char*>(shared_memory_->memory());
+  ArenaHeader* arena_header = reinterpret_cast<ArenaHeader*>(arena);
+  size_t allocated = subtle::NoBarrier_Load(&arena_header->allocated);
+  size_t offset = sizeof(ArenaHeader) + allocated;
+  DCHECK_LE(offset, size_);
+
+  const std::string& name = histogram.histogram_name();
+  size_t bucket_count = histogram.bucket_count();
+  size_t ranges_count = RangesCount(histogram.histogram_type(), bucket_count);
+  size_t record_size = RecordSize(bucket_count, ranges_count, name.size());
+  if (record_size > size_ - offset)
+    return NULL;
+
+  char* record = arena + offset;
+  RecordHeader* record_header = reinterpret_cast<RecordHeader*>(record);
+  record_header->size = record_size;
+  record_header->histogram_type = histogram.histogram_type();
+  record_header->flags = histogram.flags();
+  record_header->declared_min = histogram.declared_min();
+  record_header->declared_max = histogram.declared_max();
+  record_header->bucket_count = bucket_count;
+  record_header->range_checksum = histogram.range_checksum();
+  record_header->name_length = name.size();
+
+  char* data = record + sizeof(RecordHeader);
+  Histogram::SharedSamples* samples =
+      reinterpret_cast<Histogram::SharedSamples*>(data);
+  memset(samples, 0, SamplesSize(bucket_count));
+  data += SamplesSize(bucket_count);
+  Histogram::Sample* ranges = reinterpret_cast<Histogram::Sample*>(data);
+  for (size_t i = 0; i < ranges_count; ++i)
+    ranges[i] = histogram.ranges(i);
+  data += ranges_count * sizeof(Histogram::Sample);
+  memcpy(data, name.data(), name.size());
+
+  // Makes the record visible to the browser.
+  subtle::Release_Store(&arena_header->allocated, allocated + record_size);
+  return samples;
+}
+
+int HistogramSharedMemory::MergeDeltas() {
+  ReadNewRecords();
+
+  const char* arena = static_cast<const char*>(shared_memory_->memory());
+  int merged_count = 0;
+  for (std::vector<Record>::iterator it = records_.begin();
+       it != records_.end(); ++it) {
+    Record& record = *it;
+    const Histogram::SharedSamples* samples =
+        reinterpret_cast<const Histogram::SharedSamples*>(
+            arena + record.samples_offset);
+    Histogram::SampleSet snapshot;
+    snapshot.CopyFrom(*samples, record.bucket_count);
+
+    Histogram::SampleSet delta(snapshot);
+    if (record.has_merged)
+      delta.Subtract(record.merged);
+    if (delta.redundant_count() <= 0)
+      continue;
+
+    if (!Histogram::AddSampleSetFromOtherProcess(
+            record.histogram_name, record.histogram_type, record.declared_min,
+            record.declared_max, record.bucket_count, record.range_checksum,
+            record.flags, record.custom_ranges, delta)) {
+      continue;
+    }
+    record.merged = snapshot;
+    record.has_merged = true;
+    ++merged_count;
+  }
+  return merged_count;
+}
+
+void HistogramSharedMemory::ReadNewRecords() {
+  const char* arena = static_cast<const char*>(shared_memory_->memory());
+  const ArenaHeader* arena_header =
+      reinterpret_cast<const ArenaHeader*>(arena);
+  size_t allocated =
+      static_cast<uint32>(subtle::Acquire_Load(&arena_header->allocated));
+  size_t end = std::min(size_, sizeof(ArenaHeader) + allocated);
+
+  while (read_offset_ < end &&
+         end - read_offset_ >= sizeof(RecordHeader)) {
+    // Copy the header, as the child may still change it.
+    RecordHeader header;
+    memcpy(&header, arena + read_offset_, sizeof(header));
+    if (header.size < sizeof(RecordHeader) ||
+        header.size % kRecordAlignment != 0 ||
+        header.size > end - read_offset_) {
+      DLOG(ERROR) << "Invalid histogram record at " << read_offset_;
+      return;
+    }
+    size_t record_offset = read_offset_;
+    read_offset_ += header.size;
+
+    size_t bucket_count = header.bucket_count;
+    size_t ranges_count = RangesCount(header.histogram_type, bucket_count);
+    if (bucket_count < 2 || bucket_count > Histogram::kBucketCount_MAX ||
+        header.name_length > header.size ||
+        RecordSize(bucket_count, ranges_count, header.name_length) >
+            header.size) {
+      DLOG(ERROR) << "Invalid histogram record at " << record_offset;
+      continue;
+    }
+
+    Record record;
+    record.samples_offset = record_offset + sizeof(RecordHeader);
+    const char* data =
+        arena + record.samples_offset + SamplesSize(bucket_count);
+    record.custom_ranges.resize(ranges_count);
+    if (ranges_count) {
+      memcpy(&record.custom_ranges[0], data,
+             ranges_count * sizeof(Histogram::Sample));
+    }
+    data += ranges_count * sizeof(Histogram::Sample);
+    record.histogram_name.assign(data, header.name_length);
+    record.histogram_type = header.histogram_type;
+    record.declared_min = header.declared_min;
+    record.declared_max = header.declared_max;
+    record.bucket_count = bucket_count;
+    record.range_checksum = header.range_checksum;
+    record.flags = static_cast<Histogram::Flags>(
+        header.flags & ~Histogram::kIPCSerializationSourceFlag);
+    records_.push_back(record);
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,96 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// HistogramSharedMemory is an arena in shared memory, which a child process
+// allocates the samples of its histograms in, and which the browser process
+// reads them from directly.  Unlike sending the histograms pickled over IPC,
+// this costs the child nothing when the histograms are uploaded, and the
+// samples recorded by a child which crashed are not lost.
+//
+// The browser creates the shared memory and hands it to the child, which
+// passes it to StatisticsRecorder::SetSharedMemory() before it records any
+// samples.  The browser then calls MergeDeltas() whenever it wants the
+// samples the child recorded, even after the child exited.
+//
+// The arena starts with the number of bytes allocated, followed by one record
+// per histogram: its description, its SharedSamples, the bucket ranges of
+// custom histograms, and its name.  The child publishes each record by
+// updating the number of bytes allocated once the record is filled in.
+
+#ifndef BASE_METRICS_HISTOGRAM_SHARED_MEMORY_H_
+#define BASE_METRICS_HISTOGRAM_SHARED_MEMORY_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram.h"
+
+namespace base {
+
+class SharedMemory;
+
+class BASE_EXPORT HistogramSharedMemory {
+ public:
+  // Uses the first |size| bytes of |shared_memory|, which must be mapped and
+  // zero filled when first used, and which this takes ownership of.  The
+  // child should map it writable, and the browser may map it read-only.
+  HistogramSharedMemory(SharedMemory* shared_memory, size_t size);
+  ~HistogramSharedMemory();
+
+  // Allocates a record for |histogram| and returns its samples, or NULL if
+  // the arena is full.  Called by StatisticsRecorder in the child, which
+  // serializes the calls.
+  Histogram::SharedSamples* AllocateSamples(const Histogram& histogram);
+
+  // Adds the samples recorded in the arena since the last call to the
+  // histograms of the same names in this process, creating them as needed.
+  // The contents of the arena are not trusted; invalid records are skipped.
+  // Returns the number of histograms which had new samples.
+  int MergeDeltas();
+
+ private:
+  // A record of the arena, as read when it was first seen.  The description
+  // of the histogram is not read again, in case the child changes it.
+  struct Record {
+    Record();
+    ~Record();
+
+    // Where the SharedSamples are, from the start of the arena.
+    size_t samples_offset;
+
+    std::string histogram_name;
+    int histogram_type;
+    Histogram::Sample declared_min;
+    Histogram::Sample declared_max;
+    size_t bucket_count;
+    uint32 range_checksum;
+    Histogram::Flags flags;
+    std::vector<Histogram::Sample> custom_ranges;
+
+    // The samples merged so far, if |has_merged| is set.
+    bool has_merged;
+    Histogram::SampleSet merged;
+  };
+
+  // Reads the records allocated since the last call into |records_|.
+  void ReadNewRecords();
+
+  scoped_ptr<SharedMemory> shared_memory_;
+  const size_t size_;
+
+  std::vector<Record> records_;
+
+  // Where the first record which isn't in |records_| starts.
+  size_t read_offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramSharedMemory);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_HISTOGRAM_SHARED_MEMORY_H_
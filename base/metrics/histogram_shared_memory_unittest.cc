@@ -0,0 +1,183 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/histogram_shared_memory.h"
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram.h"
+#include "base/process_util.h"
+#include "base/shared_memory.h"
+#include "base/test/multiprocess_test.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/multiprocess_func_list.h"
+
+namespace base {
+
+namespace {
+
+const size_t kArenaSize = 64 * 1024;
+const char kSharedMemoryName[] = "HistogramSharedMemoryTest";
+const int kChildSamples = 1000;
+
+class HistogramSharedMemoryTest : public MultiProcessTest {
+ protected:
+  // Returns the registered histogram named |name|, or NULL.
+  static Histogram* Find(const std::string& name) {
+    Histogram* histogram = NULL;
+    StatisticsRecorder::FindHistogram(name, &histogram);
+    return histogram;
+  }
+};
+
+}  // namespace
+
+TEST_F(HistogramSharedMemoryTest, MergeDeltas) {
+  SharedMemory* child_memory = new SharedMemory;
+  ASSERT_TRUE(child_memory->CreateAndMapAnonymous(kArenaSize));
+  SharedMemoryHandle handle;
+  ASSERT_TRUE(child_memory->ShareToProcess(GetCurrentProcessHandle(),
+                                           &handle));
+  HistogramSharedMemory child_arena(child_memory, kArenaSize);
+
+  // Record as a child process would.
+  scoped_ptr<StatisticsRecorder> recorder(new StatisticsRecorder);
+  StatisticsRecorder::SetSharedMemory(&child_arena);
+  Histogram* histogram = Histogram::FactoryGet(
+      "Shared", 1, 1000, 10, Histogram::kNoFlags);
+  std::vector<Histogram::Sample> custom_ranges;
+  custom_ranges.push_back(10);
+  custom_ranges.push_back(20);
+  Histogram* custom_histogram = CustomHistogram::FactoryGet(
+      "SharedCustom", custom_ranges, Histogram::kUmaTargetedHistogramFlag);
+  EXPECT_TRUE(histogram->in_shared_memory());
+  EXPECT_TRUE(custom_histogram->in_shared_memory());
+  histogram->Add(5);
+  histogram->Add(500);
+  custom_histogram->Add(15);
+
+  Histogram::SampleSet sample;
+  histogram->SnapshotSample(&sample);
+  EXPECT_EQ(2, sample.TotalCount());
+  EXPECT_EQ(2, sample.redundant_count());
+  EXPECT_EQ(505, sample.sum());
+  EXPECT_EQ(0, histogram->FindCorruption(sample));
+
+  // Read the samples as the browser process would.
+  recorder.reset();
+  recorder.reset(new StatisticsRecorder);
+  SharedMemory* browser_memory = new SharedMemory(handle, true);
+  ASSERT_TRUE(browser_memory->Map(kArenaSize));
+  HistogramSharedMemory browser_arena(browser_memory, kArenaSize);
+  EXPECT_EQ(2, browser_arena.MergeDeltas());
+
+  Histogram* merged_histogram = Find("Shared");
+  ASSERT_TRUE(merged_histogram);
+  EXPECT_FALSE(merged_histogram->in_shared_memory());
+  merged_histogram->SnapshotSample(&sample);
+  EXPECT_EQ(2, sample.TotalCount());
+  EXPECT_EQ(505, sample.sum());
+  Histogram* merged_custom_histogram = Find("SharedCustom");
+  ASSERT_TRUE(merged_custom_histogram);
+  EXPECT_EQ(Histogram::CUSTOM_HISTOGRAM,
+            merged_custom_histogram->histogram_type());
+  EXPECT_EQ(Histogram::kUmaTargetedHistogramFlag,
+            merged_custom_histogram->flags());
+  EXPECT_TRUE(merged_custom_histogram->cached_ranges()->Equals(
+      custom_histogram->cached_ranges()));
+  merged_custom_histogram->SnapshotSample(&sample);
+  EXPECT_EQ(1, sample.TotalCount());
+
+  // Only what was recorded since is merged next time.
+  histogram->Add(5);
+  EXPECT_EQ(1, browser_arena.MergeDeltas());
+  EXPECT_EQ(0, browser_arena.MergeDeltas());
+  merged_histogram->SnapshotSample(&sample);
+  EXPECT_EQ(3, sample.TotalCount());
+  EXPECT_EQ(510, sample.sum());
+}
+
+TEST_F(HistogramSharedMemoryTest, ArenaFull) {
+  const size_t kSmallArenaSize = 128;
+  SharedMemory* memory = new SharedMemory;
+  ASSERT_TRUE(memory->CreateAndMapAnonymous(kSmallArenaSize));
+  HistogramSharedMemory arena(memory, kSmallArenaSize);
+
+  StatisticsRecorder recorder;
+  StatisticsRecorder::SetSharedMemory(&arena);
+  Histogram* small_histogram = LinearHistogram::FactoryGet(
+      "Small", 1, 3, 4, Histogram::kNoFlags);
+  Histogram* large_histogram = Histogram::FactoryGet(
+      "Large", 1, 1000, 50, Histogram::kNoFlags);
+  EXPECT_TRUE(small_histogram->in_shared_memory());
+  EXPECT_FALSE(large_histogram->in_shared_memory());
+
+  // Histograms which don't fit keep their samples themselves.
+  large_histogram->Add(10);
+  Histogram::SampleSet sample;
+  large_histogram->SnapshotSample(&sample);
+  EXPECT_EQ(1, sample.TotalCount());
+}
+
+// The browser reads the samples of a child process after it exits.
+TEST_F(HistogramSharedMemoryTest, ChildProcess) {
+  SharedMemory* memory = new SharedMemory;
+  memory->Delete(kSharedMemoryName);
+  ASSERT_TRUE(memory->CreateNamed(kSharedMemoryName, false, kArenaSize));
+  ASSERT_TRUE(memory->Map(kArenaSize));
+  HistogramSharedMemory arena(memory, kArenaSize);
+
+  ProcessHandle child = SpawnChild("HistogramSharedMemoryChildMain", false);
+  ASSERT_TRUE(child);
+  int exit_code = -1;
+  EXPECT_TRUE(WaitForExitCode(child, &exit_code));
+  EXPECT_EQ(0, exit_code);
+  memory->Delete(kSharedMemoryName);
+
+  StatisticsRecorder recorder;
+  EXPECT_EQ(2, arena.MergeDeltas());
+
+  Histogram* histogram = Find("Child");
+  ASSERT_TRUE(histogram);
+  Histogram::SampleSet sample;
+  histogram->SnapshotSample(&sample);
+  EXPECT_EQ(kChildSamples, sample.TotalCount());
+  EXPECT_EQ(kChildSamples * (kChildSamples - 1) / 2, sample.sum());
+
+  Histogram* boolean_histogram = Find("ChildBoolean");
+  ASSERT_TRUE(boolean_histogram);
+  EXPECT_EQ(Histogram::BOOLEAN_HISTOGRAM, boolean_histogram->histogram_type());
+  boolean_histogram->SnapshotSample(&sample);
+  EXPECT_EQ(kChildSamples * 3 / 4, sample.counts(0));
+  EXPECT_EQ(kChildSamples / 4, sample.counts(1));
+  EXPECT_EQ(0, arena.MergeDeltas());
+}
+
+// Records samples into the shared memory named kSharedMemoryName, and exits
+// without sending the histograms anywhere.
+MULTIPROCESS_TEST_MAIN(HistogramSharedMemoryChildMain) {
+  SharedMemory* memory = new SharedMemory;
+  if (!memory->Open(kSharedMemoryName, false) || !memory->Map(kArenaSize))
+    return 1;
+  StatisticsRecorder recorder;
+  // Leaked, as the histograms allocated in it are.
+  StatisticsRecorder::SetSharedMemory(
+      new HistogramSharedMemory(memory, kArenaSize));
+
+  Histogram* histogram = Histogram::FactoryGet(
+      "Child", 1, 1000, 10, Histogram::kNoFlags);
+  Histogram* boolean_histogram = BooleanHistogram::FactoryGet(
+      "ChildBoolean", Histogram::kUmaTargetedHistogramFlag);
+  if (!histogram->in_shared_memory() || !boolean_histogram->in_shared_memory())
+    return 2;
+  for (int i = 0; i < kChildSamples; ++i) {
+    histogram->Add(i);
+    boolean_histogram->AddBoolean(i % 4 == 0);
+  }
+  return 0;
+}
+
+}  // namespace base
@@ -5,10 +5,14 @@
 // Test of Histogram class
 
 #include <algorithm>
+#include <string>
 #include <vector>
 
+#include "base/compiler_specific.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/metrics/histogram.h"
+#include "base/threading/simple_thread.h"
 #include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -18,6 +22,25 @@ namespace {
 class HistogramTest : public testing::Test {
 };
 
+// Adds kSamplesPerThread samples to a histogram from its thread.
+class AddSamplesThread : public DelegateSimpleThread::Delegate {
+ public:
+  static const int kSamplesPerThread = 10000;
+
+  explicit AddSamplesThread(Histogram* histogram) : histogram_(histogram) {}
+  virtual ~AddSamplesThread() {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kSamplesPerThread; ++i)
+      histogram_->Add(i % 64);
+  }
+
+ private:
+  Histogram* histogram_;
+
+  DISALLOW_COPY_AND_ASSIGN(AddSamplesThread);
+};
+
 // Check for basic syntax and use.
 TEST(HistogramTest, StartupShutdownTest) {
   // Try basic construction
@@ -347,6 +370,86 @@ TEST(HistogramTest, BucketPlacementTest) {
     EXPECT_EQ(i + 1, sample.counts(i));
 }
 
+// No sample is lost when several threads add to a histogram at once.
+TEST(HistogramTest, ConcurrentAddTest) {
+  StatisticsRecorder recorder;
+  Histogram* histogram(Histogram::FactoryGet(
+      "Concurrent", 1, 64, 8, Histogram::kNoFlags));
+
+  const int kThreadCount = 8;
+  AddSamplesThread delegate(histogram);
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < kThreadCount; ++i)
+    threads.push_back(new DelegateSimpleThread(&delegate, "histogram"));
+  for (int i = 0; i < kThreadCount; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < kThreadCount; ++i)
+    threads[i]->Join();
+
+  Histogram::SampleSet sample;
+  histogram->SnapshotSample(&sample);
+  EXPECT_EQ(kThreadCount * AddSamplesThread::kSamplesPerThread,
+            sample.TotalCount());
+  EXPECT_EQ(kThreadCount * AddSamplesThread::kSamplesPerThread,
+            sample.redundant_count());
+  EXPECT_EQ(0, histogram->FindCorruption(sample));
+}
+
+TEST(HistogramTest, FindHistogramTest) {
+  scoped_ptr<StatisticsRecorder> recorder(new StatisticsRecorder);
+  Histogram* histogram(Histogram::FactoryGet(
+      "Registered", 1, 64, 8, Histogram::kNoFlags));
+  Histogram* linear_histogram(LinearHistogram::FactoryGet(
+      "RegisteredLinear", 1, 64, 8, Histogram::kNoFlags));
+
+  Histogram* found = NULL;
+  EXPECT_TRUE(StatisticsRecorder::FindHistogram("Registered", &found));
+  EXPECT_EQ(histogram, found);
+  EXPECT_TRUE(StatisticsRecorder::FindHistogram("RegisteredLinear", &found));
+  EXPECT_EQ(linear_histogram, found);
+  EXPECT_EQ(histogram, Histogram::FactoryGet(
+      "Registered", 1, 64, 8, Histogram::kNoFlags));
+
+  found = NULL;
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Unregistered", &found));
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Registere", &found));
+  EXPECT_EQ(reinterpret_cast<Histogram*>(NULL), found);
+
+  // The histograms are forgotten along with the recorder.
+  recorder.reset();
+  recorder.reset(new StatisticsRecorder);
+  EXPECT_FALSE(StatisticsRecorder::FindHistogram("Registered", &found));
+  EXPECT_EQ(reinterpret_cast<Histogram*>(NULL), found);
+}
+
+TEST(HistogramTest, SparseHistogramTest) {
+  StatisticsRecorder recorder;
+  SparseHistogram* histogram(SparseHistogram::FactoryGet(
+      "Sparse", Histogram::kNoFlags));
+  EXPECT_EQ(histogram, SparseHistogram::FactoryGet(
+      "Sparse", Histogram::kNoFlags));
+
+  histogram->Add(-5);
+  histogram->Add(1);
+  histogram->Add(1000000);
+  histogram->Add(INT_MAX);
+  HISTOGRAM_SPARSE_SLOWLY("Sparse", 1);
+
+  SparseHistogram::Samples samples;
+  histogram->SnapshotSamples(&samples);
+  ASSERT_EQ(4u, samples.size());
+  EXPECT_EQ(1, samples[-5]);
+  EXPECT_EQ(2, samples[1]);
+  EXPECT_EQ(1, samples[1000000]);
+  EXPECT_EQ(1, samples[INT_MAX]);
+
+  std::string graph;
+  StatisticsRecorder::WriteGraph("Sparse", &graph);
+  EXPECT_NE(std::string::npos,
+            graph.find("Histogram: Sparse recorded 5 samples"));
+  EXPECT_NE(std::string::npos, graph.find("1000000 (1 = 20.0%)"));
+}
+
 }  // namespace
 
 //------------------------------------------------------------------------------
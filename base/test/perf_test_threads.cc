@@ -0,0 +1,34 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/test/perf_test_threads.h"
+
+#include "base/memory/scoped_vector.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+
+namespace base {
+
+void RunOnThreadsAndLogPerf(const char* test_name,
+                            DelegateSimpleThread::Delegate* delegate,
+                            int thread_count,
+                            int operations_per_thread,
+                            const char* units) {
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < thread_count; ++i)
+    threads.push_back(new DelegateSimpleThread(delegate, test_name));
+
+  PerfTimer timer;
+  for (int i = 0; i < thread_count; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < thread_count; ++i)
+    threads[i]->Join();
+  TimeDelta elapsed = timer.Elapsed();
+
+  LogPerfResult(StringPrintf("%s_%d_threads", test_name, thread_count).c_str(),
+                elapsed.InMicroseconds() * 1000.0 / operations_per_thread,
+                units);
+}
+
+}  // namespace base
@@ -0,0 +1,26 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TEST_PERF_TEST_THREADS_H_
+#define BASE_TEST_PERF_TEST_THREADS_H_
+#pragma once
+
+#include "base/threading/simple_thread.h"
+
+namespace base {
+
+// Runs |delegate| on |thread_count| threads started at once, and logs the
+// time they take per operation, in nanoseconds, as seen by each thread, as
+// "<test_name>_<thread_count>_threads". Each run of |delegate| is taken to
+// perform |operations_per_thread| operations; |units| names them in the log,
+// e.g. "ns/event".
+void RunOnThreadsAndLogPerf(const char* test_name,
+                            DelegateSimpleThread::Delegate* delegate,
+                            int thread_count,
+                            int operations_per_thread,
+                            const char* units);
+
+}  // namespace base
+
+#endif  // BASE_TEST_PERF_TEST_THREADS_H_
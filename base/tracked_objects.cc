@@ -48,6 +48,13 @@ const ThreadData::Status kInitialStartupState =
 // problem with its presence).
 static const bool kAllowAlternateTimeSourceHandling = true;
 
+// The average number of births per sampled birth in the PROFILING_SAMPLED
+// status, unless SetSamplingInterval() is called.
+const int kDefaultSamplingInterval = 64;
+
+// The gaps between sampled births are drawn from 16 random bits.
+const int kMaxSamplingInterval = 1 << 15;
+
 }  // namespace
 
 //------------------------------------------------------------------------------
@@ -75,9 +82,17 @@ DeathData::DeathData(int count) {
 void DeathData::RecordDeath(const int32 queue_duration,
                             const int32 run_duration,
                             int32 random_number) {
-  ++count_;
-  queue_duration_sum_ += queue_duration;
-  run_duration_sum_ += run_duration;
+  RecordSampledDeath(queue_duration, run_duration, random_number, 1);
+}
+
+void DeathData::RecordSampledDeath(const int32 queue_duration,
+                                   const int32 run_duration,
+                                   int32 random_number,
+                                   int weight) {
+  DCHECK_GT(weight, 0);
+  count_ += weight;
+  queue_duration_sum_ += queue_duration * weight;
+  run_duration_sum_ += run_duration * weight;
 
   if (queue_duration_max_ < queue_duration)
     queue_duration_max_ = queue_duration;
@@ -85,11 +100,12 @@ void DeathData::RecordDeath(const int32 queue_duration,
     run_duration_max_ = run_duration;
 
   // Take a uniformly distributed sample over all durations ever supplied.
-  // The probability that we (instead) use this new sample is 1/count_.  This
-  // results in a completely uniform selection of the sample.
+  // The probability that we (instead) use this new sample is weight/count_.
+  // This results in a completely uniform selection of the sample.
   // We ignore the fact that we correlated our selection of a sample of run
   // and queue times.
-  if (0 == (random_number % count_)) {
+  if (static_cast<uint32>(random_number) % count_ <
+      static_cast<uint32>(weight)) {
     queue_duration_sample_ = queue_duration;
     run_duration_sample_ = run_duration;
   }
@@ -186,6 +202,8 @@ int Births::birth_count() const { return birth_count_; }
 
 void Births::RecordBirth() { ++birth_count_; }
 
+void Births::RecordBirths(int count) { birth_count_ += count; }
+
 void Births::ForgetBirth() { --birth_count_; }
 
 void Births::Clear() { birth_count_ = 0; }
@@ -229,10 +247,14 @@ base::LazyInstance<base::Lock>::Leaky
 // static
 ThreadData::Status ThreadData::status_ = ThreadData::UNINITIALIZED;
 
+// static
+int ThreadData::sampling_interval_ = kDefaultSamplingInterval;
+
 ThreadData::ThreadData(const std::string& suggested_name)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(0),
+      births_until_sample_(0),
       incarnation_count_for_pool_(-1) {
   DCHECK_GE(suggested_name.size(), 0u);
   thread_name_ = suggested_name;
@@ -243,6 +265,7 @@ ThreadData::ThreadData(int thread_number)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(thread_number),
+      births_until_sample_(0),
       incarnation_count_for_pool_(-1)  {
   CHECK_GT(thread_number, 0);
   base::StringAppendF(&thread_name_, "WorkerThread-%d", thread_number);
@@ -367,13 +390,15 @@ void ThreadData::Snapshot(bool reset_max, ProcessDataSnapshot* process_data) {
 }
 
 Births* ThreadData::TallyABirth(const Location& location) {
+  int weight = SamplingWeight();
   BirthMap::iterator it = birth_map_.find(location);
   Births* child;
   if (it != birth_map_.end()) {
     child =  it->second;
-    child->RecordBirth();
+    child->RecordBirths(weight);
   } else {
     child = new Births(location, *this);  // Leak this.
+    child->RecordBirths(weight - 1);  // Construction counted the first birth.
     // Lock since the map may get relocated now, and other threads sometimes
     // snapshot it (but they lock before copying it).
     base::AutoLock lock(map_lock_);
@@ -418,7 +443,8 @@ void ThreadData::TallyADeath(const Births& birth,
     base::AutoLock lock(map_lock_);  // Lock as the map may get relocated now.
     death_data = &death_map_[&birth];
   }  // Release lock ASAP.
-  death_data->RecordDeath(queue_duration, run_duration, random_number_);
+  death_data->RecordSampledDeath(queue_duration, run_duration, random_number_,
+                                 SamplingWeight());
 
   if (!kTrackParentChildLinks)
     return;
@@ -438,9 +464,30 @@ Births* ThreadData::TallyABirthIfActive(const Location& location) {
   ThreadData* current_thread_data = Get();
   if (!current_thread_data)
     return NULL;
+  // Unsampled births cost no more than the countdown, and as they get no
+  // Births, their runs are neither timed nor tallied.
+  if (status_ == PROFILING_SAMPLED && !current_thread_data->ShouldSampleBirth())
+    return NULL;
   return current_thread_data->TallyABirth(location);
 }
 
+bool ThreadData::ShouldSampleBirth() {
+  if (--births_until_sample_ > 0)
+    return false;
+  // Draw the next gap uniformly from [1, 2 * sampling_interval_ - 1], which
+  // averages sampling_interval_ births.  This thread is the only one to use
+  // random_number_, so a simple linear congruential step will do.
+  uint32 random = static_cast<uint32>(random_number_) * 1103515245u + 12345u;
+  random_number_ = static_cast<int32>(random);
+  births_until_sample_ = 1 + (random >> 16) % (2 * sampling_interval_ - 1);
+  return true;
+}
+
+// static
+int ThreadData::SamplingWeight() {
+  return status_ == PROFILING_SAMPLED ? sampling_interval_ : 1;
+}
+
 // static
 void ThreadData::TallyRunOnNamedThreadIfTracking(
     const base::TrackingInfo& completed_task,
@@ -710,7 +757,7 @@ bool ThreadData::InitializeAndSetTrackingStatus(Status status) {
   if (!Initialize())  // No-op if already initialized.
     return false;  // Not compiled in.
 
-  if (!kTrackParentChildLinks && status > DEACTIVATED)
+  if (!kTrackParentChildLinks && status > PROFILING_ACTIVE)
     status = PROFILING_ACTIVE;
   status_ = status;
   return true;
@@ -721,6 +768,18 @@ ThreadData::Status ThreadData::status() {
   return status_;
 }
 
+// static
+void ThreadData::SetSamplingInterval(int sampling_interval) {
+  DCHECK_GE(sampling_interval, 1);
+  DCHECK_LE(sampling_interval, kMaxSamplingInterval);
+  sampling_interval_ = sampling_interval;
+}
+
+// static
+int ThreadData::sampling_interval() {
+  return sampling_interval_;
+}
+
 // static
 bool ThreadData::TrackingStatus() {
   return status_ > DEACTIVATED;
@@ -733,6 +792,8 @@ bool ThreadData::TrackingParentChildStatus() {
 
 // static
 TrackedTime ThreadData::NowForStartOfRun(const Births* parent) {
+  if (!parent && status_ == PROFILING_SAMPLED)
+    return TrackedTime();  // The run won't be tallied, so don't time it.
   if (kTrackParentChildLinks && parent && status_ > PROFILING_ACTIVE) {
     ThreadData* current_thread_data = Get();
     if (current_thread_data)
@@ -799,6 +860,7 @@ void ThreadData::ShutdownSingleThreadedCleanup(bool leak) {
   // Put most global static back in pristine shape.
   worker_thread_data_creation_count_ = 0;
   cleanup_count_ = 0;
+  sampling_interval_ = kDefaultSamplingInterval;
   tls_index_.Set(NULL);
   status_ = DORMANT_DURING_TESTS;  // Almost UNINITIALIZED.
 
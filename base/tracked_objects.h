@@ -128,6 +128,16 @@
 // be able to run concurrently with ongoing augmentation of the birth and death
 // data.
 //
+// Full profiling still costs a few map lookups and clock reads for every task,
+// which is too much to leave on permanently.  In the PROFILING_SAMPLED status,
+// each thread instead tallies only about one in sampling_interval() of the
+// births it sees, picked by a per-thread countdown that takes no locks.  The
+// remaining tasks get no Births, and hence cost no death tally and no timing
+// either.  Each sampled birth and death is weighted by the sampling interval
+// as it is tallied, so the snapshots gathered from the threads merge just as
+// they do when every task is tracked, with counts and sums that estimate those
+// of all the tasks.
+//
 // This header also exports collection of classes that provide "snapshotted"
 // representations of the core tracked_objects:: classes.  These snapshotted
 // representations are designed for safe transmission of the tracked_objects::
@@ -238,6 +248,9 @@ class BASE_EXPORT Births: public BirthOnThread {
   // When we have a birth we update the count for this birthplace.
   void RecordBirth();
 
+  // When sampling, a sampled birth stands for |count| births.
+  void RecordBirths(int count);
+
   // When a birthplace is changed (updated), we need to decrement the counter
   // for the old instance.
   void ForgetBirth();
@@ -273,6 +286,14 @@ class BASE_EXPORT DeathData {
                    const int32 run_duration,
                    int random_number);
 
+  // Like RecordDeath(), for a sampled death which stands for |weight| deaths.
+  // The durations are added |weight| times, and are that much more likely to
+  // be kept as the samples.
+  void RecordSampledDeath(const int32 queue_duration,
+                          const int32 run_duration,
+                          int random_number,
+                          int weight);
+
   // Metrics accessors, used only for serialization and in tests.
   int count() const;
   int32 run_duration_sum() const;
@@ -353,11 +374,13 @@ struct ProcessDataSnapshot;
 class BASE_EXPORT ThreadData {
  public:
   // Current allowable states of the tracking system.  The states can vary
-  // between ACTIVE and DEACTIVATED, but can never go back to UNINITIALIZED.
+  // between ACTIVE, SAMPLED and DEACTIVATED, but can never go back to
+  // UNINITIALIZED.
   enum Status {
     UNINITIALIZED,              // PRistine, link-time state before running.
     DORMANT_DURING_TESTS,       // Only used during testing.
     DEACTIVATED,                // No longer recording profling.
+    PROFILING_SAMPLED,          // Recording profiles of some of the tasks.
     PROFILING_ACTIVE,           // Recording profiles (no parent-child links).
     PROFILING_CHILDREN_ACTIVE,  // Fully active, recording parent-child links.
   };
@@ -435,10 +458,8 @@ class BASE_EXPORT ThreadData {
   // while we are single threaded). Returns false if unable to initialize.
   static bool Initialize();
 
-  // Sets internal status_.
-  // If |status| is false, then status_ is set to DEACTIVATED.
-  // If |status| is true, then status_ is set to, PROFILING_ACTIVE, or
-  // PROFILING_CHILDREN_ACTIVE.
+  // Sets internal status_ to DEACTIVATED, PROFILING_SAMPLED, PROFILING_ACTIVE,
+  // or PROFILING_CHILDREN_ACTIVE.
   // If tracking is not compiled in, this function will return false.
   // If parent-child tracking is not compiled in, then an attempt to set the
   // status to PROFILING_CHILDREN_ACTIVE will only result in a status of
@@ -449,6 +470,16 @@ class BASE_EXPORT ThreadData {
 
   static Status status();
 
+  // Sets how many births, on average, each sampled birth stands for in the
+  // PROFILING_SAMPLED status.  This should be set before entering that status,
+  // as the deaths of tasks born before the change are weighted differently
+  // from their births (which skews the Still_Alive counts).  Switching between
+  // PROFILING_SAMPLED and the other statuses while tasks are pending skews
+  // the counts in the same way.
+  static void SetSamplingInterval(int sampling_interval);
+
+  static int sampling_interval();
+
   // Indicate if any sort of profiling is being done (i.e., we are more than
   // DEACTIVATED).
   static bool TrackingStatus();
@@ -462,7 +493,8 @@ class BASE_EXPORT ThreadData {
   // side effects when we are tracking, so that we can deduce the amount of time
   // accumulated outside of execution of tracked runs.
   // The task that will be tracked is passed in as |parent| so that parent-child
-  // relationships can be (optionally) calculated.
+  // relationships can be (optionally) calculated.  When sampling, a NULL
+  // |parent| is a task that wasn't sampled, which isn't timed.
   static TrackedTime NowForStartOfRun(const Births* parent);
   static TrackedTime NowForEndOfRun();
 
@@ -519,6 +551,13 @@ class BASE_EXPORT ThreadData {
   // In this thread's data, record a new birth.
   Births* TallyABirth(const Location& location);
 
+  // When sampling, counts down the births seen on this thread, and indicates
+  // if this one should be tallied.
+  bool ShouldSampleBirth();
+
+  // The number of births or deaths that each tallied one stands for.
+  static int SamplingWeight();
+
   // Find a place to record a death on this thread.
   void TallyADeath(const Births& birth, int32 queue_duration, int32 duration);
 
@@ -616,6 +655,10 @@ class BASE_EXPORT ThreadData {
   // We set status_ to SHUTDOWN when we shut down the tracking service.
   static Status status_;
 
+  // The average number of births per sampled birth in the PROFILING_SAMPLED
+  // status.
+  static int sampling_interval_;
+
   // Link to next instance (null terminated list). Used to globally track all
   // registered instances (corresponds to all registered threads where we keep
   // data).
@@ -677,6 +720,11 @@ class BASE_EXPORT ThreadData {
   // we stir in more and more as we go.
   int32 random_number_;
 
+  // The number of births this thread will see before it samples one, when
+  // sampling.  The gaps between sampled births are random, so that tasks which
+  // are posted periodically are not sampled more or less often than others.
+  int births_until_sample_;
+
   // Record of what the incarnation_counter_ was when this instance was created.
   // If the incarnation_counter_ has changed, then we avoid pushing into the
   // pool (this is only critical in tests which go through multiple
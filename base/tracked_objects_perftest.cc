@@ -0,0 +1,77 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/tracked_objects.h"
+
+#include "base/compiler_specific.h"
+#include "base/test/perf_test_threads.h"
+#include "base/tracking_info.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace tracked_objects {
+
+namespace {
+
+const int kTasksPerThread = 200000;
+const int kLocationCount = 16;
+
+// Tracks kTasksPerThread tasks, posted from kLocationCount locations, the way
+// MessageLoop does as it posts and runs them.
+class TrackTasksThread : public base::DelegateSimpleThread::Delegate {
+ public:
+  TrackTasksThread() {}
+  virtual ~TrackTasksThread() {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kTasksPerThread; ++i) {
+      Location location("TrackTasksThread::Run", __FILE__,
+                        i % kLocationCount, NULL);
+      base::TrackingInfo pending_task(location, base::TimeTicks());
+      TrackedTime start_of_run =
+          ThreadData::NowForStartOfRun(pending_task.birth_tally);
+      ThreadData::TallyRunOnNamedThreadIfTracking(
+          pending_task, start_of_run, ThreadData::NowForEndOfRun());
+    }
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TrackTasksThread);
+};
+
+class TrackedObjectsPerfTest : public testing::Test {
+ protected:
+  // Tracks tasks with |status|, if it can be set.
+  void TrackFromThreads(const char* test_name,
+                        ThreadData::Status status,
+                        int thread_count) {
+    if (!ThreadData::InitializeAndSetTrackingStatus(status))
+      return;
+
+    TrackTasksThread delegate;
+    base::RunOnThreadsAndLogPerf(test_name, &delegate, thread_count,
+                                 kTasksPerThread, "ns/task");
+  }
+};
+
+}  // namespace
+
+TEST_F(TrackedObjectsPerfTest, Deactivated) {
+  TrackFromThreads("tracked_objects_deactivated", ThreadData::DEACTIVATED, 1);
+  TrackFromThreads("tracked_objects_deactivated", ThreadData::DEACTIVATED, 4);
+}
+
+// Unsampled tasks only count down on their thread, and aren't timed.
+TEST_F(TrackedObjectsPerfTest, Sampled) {
+  TrackFromThreads("tracked_objects_sampled", ThreadData::PROFILING_SAMPLED,
+                   1);
+  TrackFromThreads("tracked_objects_sampled", ThreadData::PROFILING_SAMPLED,
+                   4);
+}
+
+TEST_F(TrackedObjectsPerfTest, Active) {
+  TrackFromThreads("tracked_objects_active", ThreadData::PROFILING_ACTIVE, 1);
+  TrackFromThreads("tracked_objects_active", ThreadData::PROFILING_ACTIVE, 4);
+}
+
+}  // namespace tracked_objects
@@ -578,4 +578,69 @@ TEST_F(TrackedObjectsTest, DifferentLives) {
   EXPECT_EQ(base::GetCurrentProcId(), process_data.process_id);
 }
 
+TEST_F(TrackedObjectsTest, SampledBirthOnlyToSnapshotMainThread) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+          ThreadData::PROFILING_SAMPLED))
+    return;
+  EXPECT_EQ(ThreadData::PROFILING_SAMPLED, ThreadData::status());
+  EXPECT_TRUE(ThreadData::TrackingStatus());
+
+  // Every birth is sampled with an interval of one.
+  ThreadData::SetSamplingInterval(1);
+  const char kFunction[] = "SampledBirthOnlyToSnapshotMainThread";
+  Location location(kFunction, kFile, kLineNumber, NULL);
+  TallyABirth(location, kMainThreadName);
+
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  ExpectSimpleProcessData(process_data, kFunction, kMainThreadName, kStillAlive,
+                          1, 0, 0);
+}
+
+// Only some of the lives are tallied, but they are weighted so that the counts
+// and sums stand for all of them.
+TEST_F(TrackedObjectsTest, SampledLifeCycles) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+          ThreadData::PROFILING_SAMPLED))
+    return;
+
+  const int kSamplingInterval = 4;
+  const int kLives = 400;
+  ThreadData::SetSamplingInterval(kSamplingInterval);
+  EXPECT_EQ(kSamplingInterval, ThreadData::sampling_interval());
+
+  // Unsampled runs aren't timed.
+  EXPECT_TRUE(ThreadData::NowForStartOfRun(NULL).is_null());
+
+  ThreadData::InitializeThreadContext(kMainThreadName);
+  const char kFunction[] = "SampledLifeCycles";
+  Location location(kFunction, kFile, kLineNumber, NULL);
+  const base::TimeTicks kTimePosted = base::TimeTicks() +
+      base::TimeDelta::FromMilliseconds(1);
+  const base::TimeTicks kDelayedStartTime = base::TimeTicks();
+  const TrackedTime kStartOfRun = TrackedTime() +
+      Duration::FromMilliseconds(5);
+  const TrackedTime kEndOfRun = TrackedTime() + Duration::FromMilliseconds(7);
+  int sampled_lives = 0;
+  for (int i = 0; i < kLives; ++i) {
+    // TrackingInfo will call TallyABirth() during construction.
+    base::TrackingInfo pending_task(location, kDelayedStartTime);
+    pending_task.time_posted = kTimePosted;  // Overwrite implied Now().
+    if (pending_task.birth_tally)
+      ++sampled_lives;
+    ThreadData::TallyRunOnNamedThreadIfTracking(pending_task,
+        kStartOfRun, kEndOfRun);
+  }
+
+  // The gaps between sampled births are at most 2 * kSamplingInterval - 1.
+  EXPECT_GE(sampled_lives, kLives / (2 * kSamplingInterval - 1));
+  EXPECT_LT(sampled_lives, kLives);
+
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  ExpectSimpleProcessData(process_data, kFunction, kMainThreadName,
+                          kMainThreadName, sampled_lives * kSamplingInterval,
+                          2, 4);
+}
+
 }  // namespace tracked_objects
@@ -4,9 +4,19 @@
 
 #include "base/utf_string_conversions.h"
 
+#include <string.h>
+
+#include "base/logging.h"
 #include "base/string_piece.h"
 #include "base/string_util.h"
+#include "base/third_party/icu/icu_utf.h"
 #include "base/utf_string_conversion_utils.h"
+#include "build/build_config.h"
+
+// SSE2 is part of x86-64, but 32-bit x86 builds still support CPUs without it.
+#if defined(ARCH_CPU_X86_64)
+#include <emmintrin.h>
+#endif
 
 using base::PrepareForUTF8Output;
 using base::PrepareForUTF16Or32Output;
@@ -41,11 +51,268 @@ bool ConvertUnicode(const SRC_CHAR* src,
   return success;
 }
 
+// ASCII blocks ----------------------------------------------------------------
+
+// The fast paths below copy runs of ASCII characters a block at a time.
+
+#if defined(ARCH_CPU_X86_64)
+
+const size_t kASCIIBlockSize = 16;
+
+// Returns true if the kASCIIBlockSize bytes at |src| are all ASCII.
+inline bool IsASCIIBlock(const char* src) {
+  __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  return _mm_movemask_epi8(bytes) == 0;
+}
+
+// Returns true if the kASCIIBlockSize characters at |src| are all ASCII.
+template<typename CHAR16>
+inline bool IsASCIIBlock(const CHAR16* src) {
+  const __m128i* chars = reinterpret_cast<const __m128i*>(src);
+  __m128i bits = _mm_or_si128(_mm_loadu_si128(chars),
+                              _mm_loadu_si128(chars + 1));
+  bits = _mm_and_si128(bits, _mm_set1_epi16(static_cast<short>(0xFF80)));
+  return _mm_movemask_epi8(_mm_cmpeq_epi16(bits, _mm_setzero_si128())) ==
+      0xFFFF;
+}
+
+// Widens the kASCIIBlockSize ASCII bytes at |src| into |dest|.
+template<typename CHAR16>
+inline void WidenASCIIBlock(const char* src, CHAR16* dest) {
+  __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  __m128i* chars = reinterpret_cast<__m128i*>(dest);
+  _mm_storeu_si128(chars, _mm_unpacklo_epi8(bytes, _mm_setzero_si128()));
+  _mm_storeu_si128(chars + 1, _mm_unpackhi_epi8(bytes, _mm_setzero_si128()));
+}
+
+// Narrows the kASCIIBlockSize ASCII characters at |src| into |dest|.
+template<typename CHAR16>
+inline void NarrowASCIIBlock(const CHAR16* src, char* dest) {
+  const __m128i* chars = reinterpret_cast<const __m128i*>(src);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                   _mm_packus_epi16(_mm_loadu_si128(chars),
+                                    _mm_loadu_si128(chars + 1)));
+}
+
+#else  // defined(ARCH_CPU_X86_64)
+
+// Elsewhere blocks are a machine word of bytes, and the compiler is left to
+// vectorize the loops over characters.
+typedef uintptr_t MachineWord;
+const size_t kASCIIBlockSize = sizeof(MachineWord);
+const MachineWord kNonASCIIBytesMask =
+    static_cast<MachineWord>(0x8080808080808080ULL);
+
+inline bool IsASCIIBlock(const char* src) {
+  MachineWord word;
+  memcpy(&word, src, sizeof(word));
+  return (word & kNonASCIIBytesMask) == 0;
+}
+
+template<typename CHAR16>
+inline bool IsASCIIBlock(const CHAR16* src) {
+  uint32 bits = 0;
+  for (size_t i = 0; i < kASCIIBlockSize; ++i)
+    bits |= src[i];
+  return bits < 0x80;
+}
+
+template<typename CHAR16>
+inline void WidenASCIIBlock(const char* src, CHAR16* dest) {
+  for (size_t i = 0; i < kASCIIBlockSize; ++i)
+    dest[i] = src[i];
+}
+
+template<typename CHAR16>
+inline void NarrowASCIIBlock(const CHAR16* src, char* dest) {
+  for (size_t i = 0; i < kASCIIBlockSize; ++i)
+    dest[i] = static_cast<char>(src[i]);
+}
+
+#endif  // defined(ARCH_CPU_X86_64)
+
+// UTF-8 <-> UTF-16 fast paths -------------------------------------------------
+
+// These convert valid input in two passes: the first one works out the exact
+// size of the output, so the second one can write it in place.  They return
+// false on invalid input, which is left to ConvertUnicode() to replace the
+// invalid characters of; |output| is then garbage.
+
+// Returns the number of UTF-16 characters the UTF-8 in |src| converts to if
+// it is valid, or at least as many as its valid prefix converts to if not.
+size_t CountUTF16Chars(const char* src, size_t src_len) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(src);
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + kASCIIBlockSize <= src_len; i += kASCIIBlockSize) {
+    if (IsASCIIBlock(src + i)) {
+      count += kASCIIBlockSize;
+      continue;
+    }
+    // Every byte but the trail bytes starts a character, and four byte
+    // sequences convert to surrogate pairs.
+    for (size_t j = i; j < i + kASCIIBlockSize; ++j)
+      count += ((bytes[j] & 0xC0) != 0x80) + (bytes[j] >= 0xF0);
+  }
+  for (; i < src_len; ++i)
+    count += ((bytes[i] & 0xC0) != 0x80) + (bytes[i] >= 0xF0);
+  return count;
+}
+
+template<typename STRING16>
+bool ConvertValidUTF8ToUTF16(const char* src,
+                             size_t src_len,
+                             STRING16* output) {
+  typedef typename STRING16::value_type CHAR16;
+
+  output->resize(CountUTF16Chars(src, src_len));
+  if (output->empty())
+    return src_len == 0;
+  CHAR16* dest = &(*output)[0];
+  const uint8* bytes = reinterpret_cast<const uint8*>(src);
+  size_t i = 0;
+  size_t j = 0;
+  while (i < src_len) {
+    uint32 code_point = bytes[i];
+    if (code_point < 0x80) {
+      if (i + kASCIIBlockSize <= src_len && IsASCIIBlock(src + i)) {
+        WidenASCIIBlock(src + i, dest + j);
+        i += kASCIIBlockSize;
+        j += kASCIIBlockSize;
+      } else {
+        dest[j++] = static_cast<CHAR16>(code_point);
+        ++i;
+      }
+      continue;
+    }
+
+    // Only accept the shortest form of each code point.
+    size_t length;
+    uint32 min_code_point;
+    if (code_point >= 0xC2 && code_point <= 0xDF) {
+      length = 2;
+      code_point &= 0x1F;
+      min_code_point = 0x80;
+    } else if (code_point >= 0xE0 && code_point <= 0xEF) {
+      length = 3;
+      code_point &= 0x0F;
+      min_code_point = 0x800;
+    } else if (code_point >= 0xF0 && code_point <= 0xF4) {
+      length = 4;
+      code_point &= 0x07;
+      min_code_point = 0x10000;
+    } else {
+      return false;
+    }
+    if (length > src_len - i)
+      return false;
+    for (size_t k = i + 1; k < i + length; ++k) {
+      if ((bytes[k] & 0xC0) != 0x80)
+        return false;
+      code_point = (code_point << 6) | (bytes[k] & 0x3F);
+    }
+    if (code_point < min_code_point || !base::IsValidCodepoint(code_point))
+      return false;
+    i += length;
+
+    if (code_point < 0x10000) {
+      dest[j++] = static_cast<CHAR16>(code_point);
+    } else {
+      dest[j++] = static_cast<CHAR16>((code_point >> 10) + 0xD7C0);
+      dest[j++] = static_cast<CHAR16>((code_point & 0x3FF) | 0xDC00);
+    }
+  }
+  DCHECK_EQ(output->size(), j);
+  return true;
+}
+
+// Returns the number of bytes the UTF-16 in |src| converts to, or 0 if it is
+// not valid.
+template<typename CHAR16>
+size_t CountUTF8Bytes(const CHAR16* src, size_t src_len) {
+  size_t count = 0;
+  size_t i = 0;
+  while (i < src_len) {
+    if (i + kASCIIBlockSize <= src_len && IsASCIIBlock(src + i)) {
+      count += kASCIIBlockSize;
+      i += kASCIIBlockSize;
+      continue;
+    }
+    uint32 code_unit = src[i++];
+    if (code_unit < 0x80) {
+      count += 1;
+    } else if (code_unit < 0x800) {
+      count += 2;
+    } else if (!CBU16_IS_SURROGATE(code_unit)) {
+      count += 3;
+    } else if (CBU16_IS_LEAD(code_unit) && i < src_len &&
+               CBU16_IS_TRAIL(src[i])) {
+      count += 4;
+      ++i;
+    } else {
+      return 0;
+    }
+  }
+  return count;
+}
+
+template<typename CHAR16>
+bool ConvertValidUTF16ToUTF8(const CHAR16* src,
+                             size_t src_len,
+                             std::string* output) {
+  if (src_len == 0) {
+    output->clear();
+    return true;
+  }
+  output->resize(CountUTF8Bytes(src, src_len));
+  if (output->empty())
+    return false;
+  uint8* dest = reinterpret_cast<uint8*>(&(*output)[0]);
+  size_t i = 0;
+  size_t j = 0;
+  while (i < src_len) {
+    uint32 code_point = src[i];
+    if (code_point < 0x80) {
+      if (i + kASCIIBlockSize <= src_len && IsASCIIBlock(src + i)) {
+        NarrowASCIIBlock(src + i, reinterpret_cast<char*>(dest + j));
+        i += kASCIIBlockSize;
+        j += kASCIIBlockSize;
+      } else {
+        dest[j++] = static_cast<uint8>(code_point);
+        ++i;
+      }
+    } else if (code_point < 0x800) {
+      dest[j++] = static_cast<uint8>(0xC0 | (code_point >> 6));
+      dest[j++] = static_cast<uint8>(0x80 | (code_point & 0x3F));
+      ++i;
+    } else if (!CBU16_IS_SURROGATE(code_point)) {
+      dest[j++] = static_cast<uint8>(0xE0 | (code_point >> 12));
+      dest[j++] = static_cast<uint8>(0x80 | ((code_point >> 6) & 0x3F));
+      dest[j++] = static_cast<uint8>(0x80 | (code_point & 0x3F));
+      ++i;
+    } else {
+      // CountUTF8Bytes() checked that surrogates come in pairs.
+      code_point = CBU16_GET_SUPPLEMENTARY(code_point, src[i + 1]);
+      dest[j++] = static_cast<uint8>(0xF0 | (code_point >> 18));
+      dest[j++] = static_cast<uint8>(0x80 | ((code_point >> 12) & 0x3F));
+      dest[j++] = static_cast<uint8>(0x80 | ((code_point >> 6) & 0x3F));
+      dest[j++] = static_cast<uint8>(0x80 | (code_point & 0x3F));
+      i += 2;
+    }
+  }
+  DCHECK_EQ(output->size(), j);
+  return true;
+}
+
 }  // namespace
 
 // UTF-8 <-> Wide --------------------------------------------------------------
 
 bool WideToUTF8(const wchar_t* src, size_t src_len, std::string* output) {
+#if defined(WCHAR_T_IS_UTF16)
+  if (ConvertValidUTF16ToUTF8(src, src_len, output))
+    return true;
+#endif
   PrepareForUTF8Output(src, src_len, output);
   return ConvertUnicode(src, src_len, output);
 }
@@ -59,6 +326,10 @@ std::string WideToUTF8(const std::wstring& wide) {
 }
 
 bool UTF8ToWide(const char* src, size_t src_len, std::wstring* output) {
+#if defined(WCHAR_T_IS_UTF16)
+  if (ConvertValidUTF8ToUTF16(src, src_len, output))
+    return true;
+#endif
   PrepareForUTF16Or32Output(src, src_len, output);
   return ConvertUnicode(src, src_len, output);
 }
@@ -129,6 +400,8 @@ std::wstring UTF16ToWide(const string16& utf16) {
 #if defined(WCHAR_T_IS_UTF32)
 
 bool UTF8ToUTF16(const char* src, size_t src_len, string16* output) {
+  if (ConvertValidUTF8ToUTF16(src, src_len, output))
+    return true;
   PrepareForUTF16Or32Output(src, src_len, output);
   return ConvertUnicode(src, src_len, output);
 }
@@ -142,6 +415,8 @@ string16 UTF8ToUTF16(const base::StringPiece& utf8) {
 }
 
 bool UTF16ToUTF8(const char16* src, size_t src_len, std::string* output) {
+  if (ConvertValidUTF16ToUTF8(src, src_len, output))
+    return true;
   PrepareForUTF8Output(src, src_len, output);
   return ConvertUnicode(src, src_len, output);
 }
@@ -0,0 +1,71 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/perftimer.h"
+#include "base/string16.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kIterations = 2000;
+const size_t kTextLength = 16 * 1024;
+
+// Returns about kTextLength bytes of UTF-8, repeating |sample|.
+std::string RepeatText(const char* sample) {
+  std::string text;
+  while (text.length() < kTextLength)
+    text.append(sample);
+  return text;
+}
+
+// Logs the time it takes to convert |utf8| to UTF-16 and back, in
+// nanoseconds per byte of UTF-8.
+void ConvertText(const char* name, const std::string& utf8) {
+  string16 utf16;
+  PerfTimer utf8_timer;
+  for (int i = 0; i < kIterations; ++i)
+    UTF8ToUTF16(utf8.data(), utf8.length(), &utf16);
+  double bytes = static_cast<double>(kIterations) * utf8.length();
+  LogPerfResult(StringPrintf("utf8_to_utf16_%s", name).c_str(),
+                utf8_timer.Elapsed().InMicroseconds() * 1000.0 / bytes,
+                "ns/byte");
+
+  std::string converted_back;
+  PerfTimer utf16_timer;
+  for (int i = 0; i < kIterations; ++i)
+    UTF16ToUTF8(utf16.data(), utf16.length(), &converted_back);
+  LogPerfResult(StringPrintf("utf16_to_utf8_%s", name).c_str(),
+                utf16_timer.Elapsed().InMicroseconds() * 1000.0 / bytes,
+                "ns/byte");
+  EXPECT_EQ(utf8, converted_back);
+}
+
+}  // namespace
+
+TEST(UTFStringConversionsPerfTest, ASCII) {
+  ConvertText("ascii",
+              RepeatText("http://www.example.com/search?q=chromium+utf8 "));
+}
+
+// Mostly ASCII, with some two byte characters: "Prévisions météo à Zürich".
+TEST(UTFStringConversionsPerfTest, Latin) {
+  ConvertText("latin",
+              RepeatText("Pr\xc3\xa9visions m\xc3\xa9t\xc3\xa9o \xc3\xa0 "
+                         "Z\xc3\xbcrich "));
+}
+
+// Three byte characters: "网页 图片 资讯更多".
+TEST(UTFStringConversionsPerfTest, CJK) {
+  ConvertText("cjk",
+              RepeatText("\xe7\xbd\x91\xe9\xa1\xb5 \xe5\x9b\xbe\xe7\x89\x87 "
+                         "\xe8\xb5\x84\xe8\xae\xaf\xe6\x9b\xb4\xe5\xa4\x9a "));
+}
+
+}  // namespace base
@@ -184,6 +184,73 @@ TEST(UTFStringConversionsTest, ConvertUTF32ToUTF8) {
 }
 #endif  // defined(WCHAR_T_IS_UTF32)
 
+// UTF-8 and UTF-16 are converted a block of ASCII characters at a time where
+// possible, so check characters wherever they fall relative to the blocks.
+TEST(UTFStringConversionsTest, ConvertUTF8AndUTF16AmongASCII) {
+  struct UTF8AndWideCase {
+    const char* utf8;
+    const wchar_t* wide;
+    bool success;
+  } convert_cases[] = {
+    {"\xc3\xa9", L"\xe9", true},
+    {"\xe4\xbd\xa0\xe5\xa5\xbd", L"\x4f60\x597d", true},
+#if defined(WCHAR_T_IS_UTF16)
+    {"\xF0\x90\x8C\x80", L"\xd800\xdf00", true},
+#elif defined(WCHAR_T_IS_UTF32)
+    {"\xF0\x90\x8C\x80", L"\x10300", true},
+#endif
+    // Invalid UTF-8 is replaced, as it is on its own.
+    {"\xe4\xa0", L"\xfffd", false},
+    {"\xed\xb0\x80", L"\xfffd", false},
+    {"\x80", L"\xfffd", false},
+  };
+
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(convert_cases); i++) {
+    for (size_t prefix_length = 0; prefix_length < 40; ++prefix_length) {
+      std::string prefix(prefix_length, 'a');
+      std::string suffix(20, 'z');
+      std::string utf8 = prefix + convert_cases[i].utf8 + suffix;
+      string16 expected = ASCIIToUTF16(prefix) +
+                          WideToUTF16(convert_cases[i].wide) +
+                          ASCIIToUTF16(suffix);
+
+      string16 converted;
+      EXPECT_EQ(convert_cases[i].success,
+                UTF8ToUTF16(utf8.data(), utf8.length(), &converted));
+      EXPECT_EQ(expected, converted);
+
+      if (convert_cases[i].success) {
+        std::string converted_back;
+        EXPECT_TRUE(UTF16ToUTF8(converted.data(), converted.length(),
+                                &converted_back));
+        EXPECT_EQ(utf8, converted_back);
+      }
+    }
+  }
+
+  // Long runs of other characters.
+  std::string utf8;
+  string16 utf16;
+  for (int i = 0; i < 40; ++i) {
+    utf8.append("\xe4\xbd\xa0\xc3\xa9");
+    utf16.append(WideToUTF16(L"\x4f60\xe9"));
+  }
+  EXPECT_EQ(utf16, UTF8ToUTF16(utf8));
+  EXPECT_EQ(utf8, UTF16ToUTF8(utf16));
+
+  // An unpaired surrogate among ASCII.
+  for (size_t prefix_length = 0; prefix_length < 40; ++prefix_length) {
+    std::string prefix(prefix_length, 'a');
+    string16 invalid_utf16 = ASCIIToUTF16(prefix);
+    invalid_utf16.push_back(0xd800);
+    invalid_utf16.append(ASCIIToUTF16("zzzzzzzzzzzzzzzzzzzz"));
+    std::string converted;
+    EXPECT_FALSE(UTF16ToUTF8(invalid_utf16.data(), invalid_utf16.length(),
+                             &converted));
+    EXPECT_EQ(prefix + "\xef\xbf\xbdzzzzzzzzzzzzzzzzzzzz", converted);
+  }
+}
+
 TEST(UTFStringConversionsTest, ConvertMultiString) {
   static wchar_t wmulti[] = {
     L'f', L'o', L'o', L'\0',
@@ -60,6 +60,36 @@ Value* CopyWithoutEmptyChildren(Value* node) {
   }
 }
 
+// Orders the entries of a DictionaryValue by key.
+class EntryKeyLess {
+ public:
+  bool operator()(const base::ValueMap::value_type& entry,
+                  const std::string& key) const {
+    return entry.first < key;
+  }
+};
+
+// Orders the positions of entries of a DictionaryValue by their keys.
+class EntryIndexLess {
+ public:
+  explicit EntryIndexLess(const base::ValueMap& entries) : entries_(entries) {}
+
+  bool operator()(size_t left, size_t right) const {
+    return entries_[left].first < entries_[right].first;
+  }
+
+ private:
+  const base::ValueMap& entries_;
+};
+
+// Returns the entry for |key| in the sorted entries [begin, end), or |end| if
+// there is none.
+template <typename Iterator>
+Iterator FindEntry(Iterator begin, Iterator end, const std::string& key) {
+  Iterator entry = std::lower_bound(begin, end, key, EntryKeyLess());
+  return (entry != end && entry->first == key) ? entry : end;
+}
+
 // A small functor for comparing Values for std::find_if and similar.
 class ValueEquals {
  public:
@@ -347,6 +377,9 @@ BinaryValue::BinaryValue(char* buffer, size_t size)
 
 DictionaryValue::DictionaryValue()
     : Value(TYPE_DICTIONARY) {
+#ifndef NDEBUG
+  changes_ = 0;
+#endif
 }
 
 DictionaryValue::~DictionaryValue() {
@@ -367,7 +400,8 @@ bool DictionaryValue::GetAsDictionary(const DictionaryValue** out_value) const {
 
 bool DictionaryValue::HasKey(const std::string& key) const {
   DCHECK(IsStringUTF8(key));
-  ValueMap::const_iterator current_entry = dictionary_.find(key);
+  ValueMap::const_iterator current_entry =
+      FindEntry(dictionary_.begin(), dictionary_.end(), key);
   DCHECK((current_entry == dictionary_.end()) || current_entry->second);
   return current_entry != dictionary_.end();
 }
@@ -380,6 +414,7 @@ void DictionaryValue::Clear() {
   }
 
   dictionary_.clear();
+  EntriesChanged();
 }
 
 void DictionaryValue::Set(const std::string& path, Value* in_value) {
@@ -430,15 +465,65 @@ void DictionaryValue::SetString(const std::string& path,
 
 void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
                                               Value* in_value) {
+  // Keys which sort last, as when copying a dictionary, are appended.
+  if (dictionary_.empty() || dictionary_.back().first < key) {
+    dictionary_.push_back(std::make_pair(key, in_value));
+    EntriesChanged();
+    return;
+  }
+
+  ValueMap::iterator entry = std::lower_bound(
+      dictionary_.begin(), dictionary_.end(), key, EntryKeyLess());
+  if (entry == dictionary_.end() || entry->first != key) {
+    dictionary_.insert(entry, std::make_pair(key, in_value));
+    EntriesChanged();
+    return;
+  }
+
   // If there's an existing value here, we need to delete it, because
   // we own all our children.
-  std::pair<ValueMap::iterator, bool> ins_res =
-      dictionary_.insert(std::make_pair(key, in_value));
-  if (!ins_res.second) {
-    DCHECK_NE(ins_res.first->second, in_value);  // This would be bogus
-    delete ins_res.first->second;
-    ins_res.first->second = in_value;
+  DCHECK_NE(entry->second, in_value);  // This would be bogus
+  delete entry->second;
+  entry->second = in_value;
+}
+
+void DictionaryValue::AppendUnsorted(std::string* key, Value* in_value) {
+  DCHECK(in_value);
+  dictionary_.push_back(std::make_pair(std::string(), in_value));
+  dictionary_.back().first.swap(*key);
+  EntriesChanged();
+}
+
+void DictionaryValue::SortEntries() {
+  // Dictionaries are usually written out, and hence parsed, already sorted.
+  bool in_order = true;
+  for (size_t i = 1; in_order && i < dictionary_.size(); ++i)
+    in_order = dictionary_[i - 1].first < dictionary_[i].first;
+  if (in_order)
+    return;
+
+  // The positions of the entries are sorted rather than the entries, so that
+  // their keys are not copied.  The sort is stable, so the last of the entries
+  // with the same key is the one which was appended last.
+  std::vector<size_t> order(dictionary_.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), EntryIndexLess(dictionary_));
+
+  ValueMap sorted;
+  sorted.reserve(dictionary_.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    ValueMap::value_type& entry = dictionary_[order[i]];
+    if (!sorted.empty() && sorted.back().first == entry.first) {
+      delete sorted.back().second;
+      sorted.back().second = entry.second;
+    } else {
+      sorted.push_back(std::make_pair(std::string(), entry.second));
+      sorted.back().first.swap(entry.first);
+    }
   }
+  dictionary_.swap(sorted);
+  EntriesChanged();
 }
 
 bool DictionaryValue::Get(const std::string& path, Value** out_value) const {
@@ -562,7 +647,8 @@ bool DictionaryValue::GetList(const std::string& path,
 bool DictionaryValue::GetWithoutPathExpansion(const std::string& key,
                                               Value** out_value) const {
   DCHECK(IsStringUTF8(key));
-  ValueMap::const_iterator entry_iterator = dictionary_.find(key);
+  ValueMap::const_iterator entry_iterator =
+      FindEntry(dictionary_.begin(), dictionary_.end(), key);
   if (entry_iterator == dictionary_.end())
     return false;
 
@@ -656,7 +742,8 @@ bool DictionaryValue::Remove(const std::string& path, Value** out_value) {
 bool DictionaryValue::RemoveWithoutPathExpansion(const std::string& key,
                                                  Value** out_value) {
   DCHECK(IsStringUTF8(key));
-  ValueMap::iterator entry_iterator = dictionary_.find(key);
+  ValueMap::iterator entry_iterator =
+      FindEntry(dictionary_.begin(), dictionary_.end(), key);
   if (entry_iterator == dictionary_.end())
     return false;
 
@@ -666,6 +753,7 @@ bool DictionaryValue::RemoveWithoutPathExpansion(const std::string& key,
   else
     delete entry;
   dictionary_.erase(entry_iterator);
+  EntriesChanged();
   return true;
 }
 
@@ -696,20 +784,31 @@ void DictionaryValue::MergeDictionary(const DictionaryValue* dictionary) {
 
 void DictionaryValue::Swap(DictionaryValue* other) {
   dictionary_.swap(other->dictionary_);
+  EntriesChanged();
+  other->EntriesChanged();
 }
 
 DictionaryValue* DictionaryValue::DeepCopy() const {
   DictionaryValue* result = new DictionaryValue;
 
+  // The entries are already sorted, so they're appended in order.
+  result->dictionary_.reserve(dictionary_.size());
   for (ValueMap::const_iterator current_entry(dictionary_.begin());
        current_entry != dictionary_.end(); ++current_entry) {
-    result->SetWithoutPathExpansion(current_entry->first,
-                                    current_entry->second->DeepCopy());
+    result->dictionary_.push_back(std::make_pair(
+        current_entry->first, current_entry->second->DeepCopy()));
   }
 
   return result;
 }
 
+#ifndef NDEBUG
+void DictionaryValue::CheckUnchangedSince(int changes) const {
+  DCHECK_EQ(changes, changes_)
+      << "A key was set or removed while iterating over the dictionary";
+}
+#endif
+
 bool DictionaryValue::Equals(const Value* other) const {
   if (other->GetType() != GetType())
     return false;
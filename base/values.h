@@ -25,6 +25,7 @@
 #include <iterator>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/base_export.h"
@@ -46,8 +47,16 @@ class ListValue;
 class StringValue;
 class Value;
 
+namespace internal {
+class JSONParser;
+}
+
 typedef std::vector<Value*> ValueVector;
-typedef std::map<std::string, Value*> ValueMap;
+
+// The entries of a DictionaryValue, kept sorted by key.  A sorted vector takes
+// an allocation per dictionary rather than one per entry, and is faster to
+// search and to iterate over than a map.
+typedef std::vector<std::pair<std::string, Value*> > ValueMap;
 
 // The Value class is the base class for Values. A Value can be instantiated
 // via the Create*Value() factory methods, or by directly creating instances of
@@ -211,7 +220,11 @@ class BASE_EXPORT BinaryValue: public Value {
 
 // DictionaryValue provides a key-value dictionary with (optional) "path"
 // parsing for recursive access; see the comment at the top of the file. Keys
-// are |std::string|s and should be UTF-8 encoded.
+// are |std::string|s and should be UTF-8 encoded.  Setting a key which sorts
+// after all the others, as when copying or parsing a sorted dictionary, takes
+// constant time; setting or removing any other key moves the entries after it.
+// Setting a new key or removing a key invalidates the iterators over the
+// dictionary; see key_iterator.
 class BASE_EXPORT DictionaryValue : public Value {
  public:
   DictionaryValue();
@@ -327,44 +340,102 @@ class BASE_EXPORT DictionaryValue : public Value {
   // This class provides an iterator for the keys in the dictionary.
   // It can't be used to modify the dictionary.
   //
+  // As the entries are kept in a vector, setting a new key or removing any key
+  // invalidates all the iterators over the dictionary, not just those on the
+  // entry removed.  To remove keys found while iterating, collect them and
+  // remove them once the iteration is done.  Replacing the value of an existing
+  // key leaves the iterators valid.  Debug builds DCHECK that the dictionary
+  // isn't changed under an iterator.
+  //
   // YOU SHOULD ALWAYS USE THE XXXWithoutPathExpansion() APIs WITH THESE, NOT
   // THE NORMAL XXX() APIs.  This makes sure things will work correctly if any
   // keys have '.'s in them.
   class key_iterator
       : private std::iterator<std::input_iterator_tag, const std::string> {
    public:
-    explicit key_iterator(ValueMap::const_iterator itr) { itr_ = itr; }
+    key_iterator(const DictionaryValue* dictionary,
+                 ValueMap::const_iterator itr)
+        : itr_(itr) {
+#ifndef NDEBUG
+      dictionary_ = dictionary;
+      changes_ = dictionary->changes_;
+#endif
+    }
     key_iterator operator++() {
+      CheckUnchanged();
       ++itr_;
       return *this;
     }
-    const std::string& operator*() { return itr_->first; }
+    const std::string& operator*() {
+      CheckUnchanged();
+      return itr_->first;
+    }
     bool operator!=(const key_iterator& other) { return itr_ != other.itr_; }
     bool operator==(const key_iterator& other) { return itr_ == other.itr_; }
 
    private:
+    void CheckUnchanged() const {
+#ifndef NDEBUG
+      dictionary_->CheckUnchangedSince(changes_);
+#endif
+    }
+
     ValueMap::const_iterator itr_;
+#ifndef NDEBUG
+    const DictionaryValue* dictionary_;
+    int changes_;
+#endif
   };
 
-  key_iterator begin_keys() const { return key_iterator(dictionary_.begin()); }
-  key_iterator end_keys() const { return key_iterator(dictionary_.end()); }
+  key_iterator begin_keys() const {
+    return key_iterator(this, dictionary_.begin());
+  }
+  key_iterator end_keys() const {
+    return key_iterator(this, dictionary_.end());
+  }
 
   // This class provides an iterator over both keys and values in the
-  // dictionary.  It can't be used to modify the dictionary.
+  // dictionary.  It can't be used to modify the dictionary, and is invalidated
+  // as a key_iterator is.
   class Iterator {
    public:
     explicit Iterator(const DictionaryValue& target)
-        : target_(target), it_(target.dictionary_.begin()) {}
+        : target_(target), it_(target.dictionary_.begin()) {
+#ifndef NDEBUG
+      changes_ = target.changes_;
+#endif
+    }
 
-    bool HasNext() const { return it_ != target_.dictionary_.end(); }
-    void Advance() { ++it_; }
+    bool HasNext() const {
+      CheckUnchanged();
+      return it_ != target_.dictionary_.end();
+    }
+    void Advance() {
+      CheckUnchanged();
+      ++it_;
+    }
 
-    const std::string& key() const { return it_->first; }
-    const Value& value() const { return *it_->second; }
+    const std::string& key() const {
+      CheckUnchanged();
+      return it_->first;
+    }
+    const Value& value() const {
+      CheckUnchanged();
+      return *it_->second;
+    }
 
    private:
+    void CheckUnchanged() const {
+#ifndef NDEBUG
+      target_.CheckUnchangedSince(changes_);
+#endif
+    }
+
     const DictionaryValue& target_;
     ValueMap::const_iterator it_;
+#ifndef NDEBUG
+    int changes_;
+#endif
   };
 
   // Overridden from Value:
@@ -372,8 +443,39 @@ class BASE_EXPORT DictionaryValue : public Value {
   virtual bool Equals(const Value* other) const OVERRIDE;
 
  private:
+  friend class internal::JSONParser;
+
+  // Appends an entry for |key|, which is swapped with an empty string, without
+  // keeping the entries sorted.  Used by the JSON parser, which calls
+  // SortEntries() once it has appended all the entries of a dictionary.
+  void AppendUnsorted(std::string* key, Value* in_value);
+
+  // Sorts the entries appended by AppendUnsorted().  Of the entries with the
+  // same key, the last one appended is kept, as SetWithoutPathExpansion()
+  // would.
+  void SortEntries();
+
+  // Called whenever an entry is added or removed, which invalidates the
+  // iterators over the dictionary.
+  void EntriesChanged() {
+#ifndef NDEBUG
+    ++changes_;
+#endif
+  }
+
+#ifndef NDEBUG
+  // DCHECKs that no entry was added or removed since EntriesChanged() had been
+  // called |changes| times.
+  void CheckUnchangedSince(int changes) const;
+#endif
+
   ValueMap dictionary_;
 
+#ifndef NDEBUG
+  // The number of times EntriesChanged() has been called.
+  int changes_;
+#endif
+
   DISALLOW_COPY_AND_ASSIGN(DictionaryValue);
 };
 
@@ -334,6 +334,38 @@ TEST(ValuesTest, DictionaryWithoutPathExpansion) {
   EXPECT_EQ(Value::TYPE_NULL, value4->GetType());
 }
 
+TEST(ValuesTest, DictionaryKeysInOrder) {
+  DictionaryValue dict;
+  dict.SetInteger("c", 1);
+  dict.SetInteger("a", 2);
+  dict.SetInteger("d", 3);
+  dict.SetInteger("b", 4);
+  dict.SetInteger("a", 5);
+  EXPECT_EQ(4U, dict.size());
+
+  std::string keys;
+  for (DictionaryValue::key_iterator it = dict.begin_keys();
+       it != dict.end_keys(); ++it) {
+    keys += *it;
+  }
+  EXPECT_EQ("abcd", keys);
+
+  int value = 0;
+  EXPECT_TRUE(dict.GetInteger("a", &value));
+  EXPECT_EQ(5, value);
+  EXPECT_TRUE(dict.GetInteger("d", &value));
+  EXPECT_EQ(3, value);
+  EXPECT_FALSE(dict.HasKey("e"));
+  EXPECT_FALSE(dict.HasKey(""));
+
+  EXPECT_TRUE(dict.RemoveWithoutPathExpansion("b", NULL));
+  EXPECT_FALSE(dict.RemoveWithoutPathExpansion("b", NULL));
+  EXPECT_FALSE(dict.HasKey("b"));
+  EXPECT_TRUE(dict.GetInteger("c", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_EQ(3U, dict.size());
+}
+
 TEST(ValuesTest, DeepCopy) {
   DictionaryValue original_dict;
   Value* original_null = Value::CreateNullValue();
@@ -786,4 +818,42 @@ TEST(ValuesTest, DictionaryIterator) {
   EXPECT_TRUE(seen2);
 }
 
+TEST(ValuesTest, DictionaryReplaceWhileIterating) {
+  DictionaryValue dict;
+  dict.SetInteger("a", 1);
+  dict.SetInteger("b", 2);
+
+  // Replacing the value of an existing key doesn't invalidate the iterators.
+  for (DictionaryValue::key_iterator it = dict.begin_keys();
+       it != dict.end_keys(); ++it) {
+    int value = 0;
+    EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion(*it, &value));
+    dict.SetWithoutPathExpansion(*it, Value::CreateIntegerValue(value * 10));
+  }
+
+  int value = 0;
+  EXPECT_TRUE(dict.GetInteger("a", &value));
+  EXPECT_EQ(10, value);
+  EXPECT_TRUE(dict.GetInteger("b", &value));
+  EXPECT_EQ(20, value);
+}
+
+#if GTEST_HAS_DEATH_TEST && !defined(NDEBUG)
+
+TEST(ValuesTest, DictionaryChangedWhileIterating) {
+  DictionaryValue dict;
+  dict.SetInteger("a", 1);
+  dict.SetInteger("b", 2);
+
+  DictionaryValue::key_iterator key = dict.begin_keys();
+  dict.SetInteger("c", 3);
+  ASSERT_DEATH(++key, "while iterating");
+
+  DictionaryValue::Iterator it(dict);
+  EXPECT_TRUE(dict.RemoveWithoutPathExpansion("a", NULL));
+  ASSERT_DEATH(it.Advance(), "while iterating");
+}
+
+#endif  // GTEST_HAS_DEATH_TEST && !defined(NDEBUG)
+
 }  // namespace base
@@ -1237,7 +1237,9 @@ int ChromeBrowserMainParts::PreCreateThreadsImpl() {
     // Default to basic profiling (no parent child support).
     tracked_objects::ThreadData::Status status =
           tracked_objects::ThreadData::PROFILING_ACTIVE;
-    if (flag.compare("0") != 0)
+    if (flag.compare("sampled") == 0)
+      status = tracked_objects::ThreadData::PROFILING_SAMPLED;
+    else if (flag.compare("0") != 0)
       status = tracked_objects::ThreadData::DEACTIVATED;
     else if (flag.compare("child") != 0)
       status = tracked_objects::ThreadData::PROFILING_CHILDREN_ACTIVE;
@@ -11,6 +11,7 @@
 #include "base/compiler_specific.h"
 #include "base/file_util.h"
 #include "base/message_loop.h"
+#include "base/metrics/histogram.h"
 #include "chrome/browser/bookmarks/bookmark_service.h"
 #include "chrome/browser/history/archived_database.h"
 #include "chrome/browser/history/history_database.h"
@@ -119,14 +120,19 @@ bool ShouldArchiveVisit(const VisitRow& visit) {
   return false;
 }
 
-// The number of visits we will expire very time we check for old items. This
-// Prevents us from doing too much work any given time.
+// The number of visits we will expire in one batch when we check for old
+// items. Each batch is deleted with a few statements per database.
 const int kNumExpirePerIteration = 32;
 
+// The time, in milliseconds, after which we stop expiring batches of visits
+// and wait for the next check. This prevents us from doing too much work at
+// any given time when a lot of history is due for expiration.
+const int kExpirationSliceBudgetMs = 50;
+
 // The number of seconds between checking for items that should be expired when
 // we think there might be more items to expire. This timeout is used when the
-// last expiration found at least kNumExpirePerIteration and we want to check
-// again "soon."
+// last expiration ran out of time before expiring everything and we want to
+// check again "soon."
 const int kExpirationDelaySec = 30;
 
 // The number of minutes between checking, as with kExpirationDelaySec, but
@@ -161,6 +167,11 @@ struct ExpireHistoryBackend::DeleteDependencies {
   // The URLs deleted during this operation.
   URLRows deleted_urls;
 
+  // The URLs whose segments, and the URLs whose rows, are to be deleted by
+  // DeleteURLRows.
+  std::vector<URLID> segment_url_ids;
+  std::vector<URLID> deleted_url_ids;
+
   // The list of all favicon IDs that the affected URLs had. Favicons will be
   // shared between all URLs with the same favicon, so this is the set of IDs
   // that we will need to check when the delete operations are complete.
@@ -180,6 +191,7 @@ ExpireHistoryBackend::ExpireHistoryBackend(
       thumb_db_(NULL),
       text_db_(NULL),
       ALLOW_THIS_IN_INITIALIZER_LIST(weak_factory_(this)),
+      expired_visit_count_(0),
       bookmark_service_(bookmark_service) {
 }
 
@@ -205,10 +217,12 @@ void ExpireHistoryBackend::DeleteURLs(const std::vector<GURL>& urls) {
     return;
 
   DeleteDependencies dependencies;
+  std::set<URLID> deleted_url_ids;
   for (std::vector<GURL>::const_iterator url = urls.begin(); url != urls.end();
        ++url) {
     URLRow url_row;
-    if (!main_db_->GetRowForURL(*url, &url_row))
+    if (!main_db_->GetRowForURL(*url, &url_row) ||
+        !deleted_url_ids.insert(url_row.id()).second)
       continue;  // Nothing to delete.
 
     // Collect all the visits and delete them. Note that we don't give
@@ -231,6 +245,7 @@ void ExpireHistoryBackend::DeleteURLs(const std::vector<GURL>& urls) {
 
     DeleteOneURL(url_row, is_bookmarked, &dependencies);
   }
+  DeleteURLRows(&dependencies);
 
   DeleteFaviconsIfPossible(dependencies.affected_favicons);
 
@@ -369,10 +384,10 @@ void ExpireHistoryBackend::BroadcastDeleteNotifications(
 void ExpireHistoryBackend::DeleteVisitRelatedInfo(
     const VisitVector& visits,
     DeleteDependencies* dependencies) {
-  for (size_t i = 0; i < visits.size(); i++) {
-    // Delete the visit itself.
-    main_db_->DeleteVisit(visits[i]);
+  // Delete the visits themselves.
+  main_db_->DeleteVisits(visits);
 
+  for (size_t i = 0; i < visits.size(); i++) {
     // Add the URL row to the affected URL list.
     std::map<URLID, URLRow>::const_iterator found =
         dependencies->affected_urls.find(visits[i].url_id);
@@ -399,7 +414,7 @@ void ExpireHistoryBackend::DeleteOneURL(
     const URLRow& url_row,
     bool is_bookmarked,
     DeleteDependencies* dependencies) {
-  main_db_->DeleteSegmentForURL(url_row.id());
+  dependencies->segment_url_ids.push_back(url_row.id());
 
   // The URL may be in the text database manager's temporary cache.
   if (text_db_) {
@@ -426,11 +441,18 @@ void ExpireHistoryBackend::DeleteOneURL(
         thumb_db_->DeleteIconMappings(url_row.url());
       }
     }
-    // Last, delete the URL entry.
-    main_db_->DeleteURLRow(url_row.id());
+    // Last, queue the URL entry for deletion.
+    dependencies->deleted_url_ids.push_back(url_row.id());
   }
 }
 
+void ExpireHistoryBackend::DeleteURLRows(DeleteDependencies* dependencies) {
+  main_db_->DeleteSegmentsForURLs(dependencies->segment_url_ids);
+  dependencies->segment_url_ids.clear();
+  main_db_->DeleteURLRows(dependencies->deleted_url_ids);
+  dependencies->deleted_url_ids.clear();
+}
+
 URLID ExpireHistoryBackend::ArchiveOneURL(const URLRow& url_row) {
   if (!archived_db_)
     return 0;
@@ -520,6 +542,7 @@ void ExpireHistoryBackend::ExpireURLsForVisits(
       main_db_->UpdateURLRow(url_row.id(), url_row);
     }
   }
+  DeleteURLRows(dependencies);
 }
 
 void ExpireHistoryBackend::ArchiveURLsAndVisits(
@@ -598,15 +621,30 @@ void ExpireHistoryBackend::ScheduleArchive() {
 void ExpireHistoryBackend::DoArchiveIteration() {
   DCHECK(!work_queue_.empty()) << "queue has to be non-empty";
 
-  const ExpiringVisitsReader* reader = work_queue_.front();
-  bool more_to_expire = ArchiveSomeOldHistory(GetCurrentArchiveTime(), reader,
-                                              kNumExpirePerIteration);
-
-  work_queue_.pop();
-  // If there are more items to expire, add the reader back to the queue, thus
-  // creating a new task for future iterations.
-  if (more_to_expire)
-    work_queue_.push(reader);
+  base::TimeTicks begin_time = base::TimeTicks::Now();
+  base::TimeTicks end_time =
+      begin_time + TimeDelta::FromMilliseconds(kExpirationSliceBudgetMs);
+  expired_visit_count_ = 0;
+  do {
+    const ExpiringVisitsReader* reader = work_queue_.front();
+    bool more_to_expire = ArchiveSomeOldHistory(GetCurrentArchiveTime(),
+                                                reader, kNumExpirePerIteration);
+
+    work_queue_.pop();
+    // If there are more items to expire, add the reader back to the queue,
+    // thus creating a new task for future iterations.
+    if (more_to_expire)
+      work_queue_.push(reader);
+  } while (!work_queue_.empty() && base::TimeTicks::Now() < end_time &&
+           (should_yield_.is_null() || !should_yield_.Run()));
+
+  TimeDelta elapsed = base::TimeTicks::Now() - begin_time;
+  UMA_HISTOGRAM_TIMES("History.ExpireSliceTime", elapsed);
+  if (expired_visit_count_ > 0) {
+    UMA_HISTOGRAM_COUNTS("History.ExpiredVisitsPerSecond",
+        static_cast<int>(expired_visit_count_ /
+                         std::max(elapsed.InSecondsF(), 0.001)));
+  }
 
   ScheduleArchive();
 }
@@ -626,6 +664,7 @@ bool ExpireHistoryBackend::ArchiveSomeOldHistory(
   VisitVector affected_visits;
   bool more_to_expire = reader->Read(effective_end_time, main_db_,
                                      &affected_visits, max_visits);
+  expired_visit_count_ += static_cast<int>(affected_visits.size());
 
   // Some visits we'll delete while others we'll archive.
   VisitVector deleted_visits, archived_visits;
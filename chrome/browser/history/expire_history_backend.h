@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/callback.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
@@ -79,6 +80,15 @@ class ExpireHistoryBackend {
   // will continue until the object is deleted.
   void StartArchivingOldStuff(base::TimeDelta expiration_threshold);
 
+  // Makes periodic expiration run at a low priority: each slice of it stops
+  // as soon as |should_yield| returns true, such as when more urgent work is
+  // waiting on the thread. A slice always expires at least one batch of
+  // visits, so that expiration still makes progress.
+  void set_should_yield_callback(
+      const base::Callback<bool(void)>& should_yield) {
+    should_yield_ = should_yield;
+  }
+
   // Deletes everything associated with a URL.
   void DeleteURL(const GURL& url);
 
@@ -112,6 +122,7 @@ class ExpireHistoryBackend {
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, ArchiveSomeOldHistory);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, ExpiringVisitsReader);
   FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, ArchiveSomeOldHistoryWithSource);
+  FRIEND_TEST_ALL_PREFIXES(ExpireHistoryTest, DoArchiveIterationYields);
   friend class ::TestingProfile;
 
   struct DeleteDependencies;
@@ -146,10 +157,17 @@ class ExpireHistoryBackend {
   // NOTE: If the url is bookmarked only the segments and text db are updated,
   // everything else is unchanged. This is done so that bookmarks retain their
   // favicons and thumbnails.
+  //
+  // The segments and the URL row are only queued in the dependencies, to be
+  // deleted along with those of the other URLs by DeleteURLRows.
   void DeleteOneURL(const URLRow& url_row,
                     bool is_bookmarked,
                     DeleteDependencies* dependencies);
 
+  // Deletes the segments and URL rows which DeleteOneURL has queued in the
+  // dependencies, with a few statements for all of them.
+  void DeleteURLRows(DeleteDependencies* dependencies);
+
   // Adds or merges the given URL row with the archived database, returning the
   // ID of the URL in the archived database, or 0 on failure. The main (source)
   // database will not be affected (the URL will have to be deleted later).
@@ -211,9 +229,10 @@ class ExpireHistoryBackend {
   // Schedules a call to DoArchiveIteration.
   void ScheduleArchive();
 
-  // Calls ArchiveSomeOldHistory to expire some amount of old history, according
-  // to the items in work queue, and schedules another call to happen in the
-  // future.
+  // Calls ArchiveSomeOldHistory to expire batches of old history, according
+  // to the items in work queue, until there is no more to expire, the slice
+  // has used its time budget or |should_yield_| asks it to stop. Then
+  // schedules another call to happen in the future.
   void DoArchiveIteration();
 
   // Tries to expire the oldest |max_visits| visits from history that are older
@@ -276,6 +295,13 @@ class ExpireHistoryBackend {
   // iterations.
   std::queue<const ExpiringVisitsReader*> work_queue_;
 
+  // See set_should_yield_callback. May be null.
+  base::Callback<bool(void)> should_yield_;
+
+  // The number of visits ArchiveSomeOldHistory has expired, which
+  // DoArchiveIteration reports the rate of.
+  int expired_visit_count_;
+
   // Readers for various types of visits.
   // TODO(dglazkov): If you are adding another one, please consider reorganizing
   // into a map.
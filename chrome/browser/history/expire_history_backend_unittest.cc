@@ -7,6 +7,7 @@
 #include <utility>
 
 #include "base/basictypes.h"
+#include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
@@ -957,6 +958,40 @@ TEST_F(ExpireHistoryTest, ArchiveSomeOldHistoryWithSource) {
   EXPECT_EQ(0U, archived_visits.size());
 }
 
+namespace {
+
+bool AlwaysYield() {
+  return true;
+}
+
+}  // namespace
+
+// Tests that a slice of periodic expiration stops after one batch of visits
+// when it is asked to yield, and otherwise expires them all.
+TEST_F(ExpireHistoryTest, DoArchiveIterationYields) {
+  URLID url_id = main_db_->AddURL(URLRow(GURL("http://www.google.com/")));
+  ASSERT_TRUE(url_id);
+  Time visit_time = now_ - TimeDelta::FromDays(100);
+  for (int i = 0; i < 40; i++) {
+    VisitRow visit_row(url_id, visit_time + TimeDelta::FromSeconds(i), 0,
+                       content::PAGE_TRANSITION_LINK, 0);
+    main_db_->AddVisit(&visit_row, SOURCE_BROWSED);
+  }
+  expirer_.StartArchivingOldStuff(TimeDelta::FromDays(90));
+
+  expirer_.set_should_yield_callback(base::Bind(&AlwaysYield));
+  expirer_.DoArchiveIteration();
+  VisitVector visits;
+  main_db_->GetVisitsForURL(url_id, &visits);
+  EXPECT_EQ(8U, visits.size());
+
+  expirer_.set_should_yield_callback(base::Callback<bool(void)>());
+  expirer_.DoArchiveIteration();
+  main_db_->GetVisitsForURL(url_id, &visits);
+  EXPECT_EQ(0U, visits.size());
+  EXPECT_FALSE(main_db_->GetURLRow(url_id, NULL));
+}
+
 // TODO(brettw) add some visits with no URL to make sure everything is updated
 // properly. Have the visits also refer to nonexistent FTS rows.
 //
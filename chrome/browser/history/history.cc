@@ -28,6 +28,7 @@
 #include "base/command_line.h"
 #include "base/memory/ref_counted.h"
 #include "base/message_loop.h"
+#include "base/metrics/histogram.h"
 #include "base/path_service.h"
 #include "base/string_util.h"
 #include "base/threading/thread.h"
@@ -748,8 +749,13 @@ void HistoryService::ScheduleAutocomplete(HistoryURLProvider* provider,
 
 void HistoryService::ScheduleTask(SchedulePriority priority,
                                   const base::Closure& task) {
-  // TODO(brettw): Do prioritization.
-  thread_->message_loop()->PostTask(FROM_HERE, task);
+  bool ui_priority = priority == PRIORITY_UI;
+  UMA_HISTOGRAM_COUNTS_10000("History.ScheduledTaskQueueDepth",
+                             history_backend_->WillScheduleTask(ui_priority));
+  thread_->message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&HistoryBackend::RunScheduledTask, history_backend_.get(),
+                 ui_priority, base::TimeTicks::Now(), task));
 }
 
 // static
@@ -614,8 +614,10 @@ class HistoryService : public CancelableRequestProvider,
  protected:
   virtual ~HistoryService();
 
-  // These are not currently used, hopefully we can do something in the future
-  // to ensure that the most important things happen first.
+  // Tasks run on the history thread in the order they are scheduled, since
+  // many read what earlier ones wrote. The backend holds back its own batched
+  // writes while PRIORITY_UI tasks are waiting; the other priorities are not
+  // currently distinguished.
   enum SchedulePriority {
     PRIORITY_UI,      // The highest priority (must respond to UI events).
     PRIORITY_NORMAL,  // Normal stuff like adding a page.
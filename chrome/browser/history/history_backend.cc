@@ -143,7 +143,7 @@ class CommitLaterTask : public base::RefCounted<CommitLaterTask> {
 
   void RunCommit() {
     if (history_backend_.get())
-      history_backend_->Commit();
+      history_backend_->RunScheduledCommit();
   }
 
  private:
@@ -211,6 +211,9 @@ HistoryBackend::HistoryBackend(const FilePath& history_dir,
       id_(id),
       history_dir_(history_dir),
       ALLOW_THIS_IN_INITIALIZER_LIST(expirer_(this, bookmark_service)),
+      commit_deferred_(false),
+      pending_tasks_(0),
+      pending_ui_tasks_(0),
       recent_redirects_(kMaxRedirectCount),
       backend_destroy_message_loop_(NULL),
       segment_queried_(false),
@@ -284,6 +287,29 @@ void HistoryBackend::NotifyRenderProcessHostDestruction(const void* host) {
   tracker_.NotifyRenderProcessHostDestruction(host);
 }
 
+int HistoryBackend::WillScheduleTask(bool ui_priority) {
+  if (ui_priority)
+    base::subtle::Barrier_AtomicIncrement(&pending_ui_tasks_, 1);
+  return base::subtle::Barrier_AtomicIncrement(&pending_tasks_, 1);
+}
+
+bool HistoryBackend::HasPendingUITasks() const {
+  return base::subtle::Acquire_Load(&pending_ui_tasks_) > 0;
+}
+
+void HistoryBackend::RunScheduledTask(bool ui_priority,
+                                      base::TimeTicks scheduled_time,
+                                      const base::Closure& task) {
+  if (ui_priority) {
+    UMA_HISTOGRAM_TIMES("History.UITaskQueueTime",
+                        base::TimeTicks::Now() - scheduled_time);
+  }
+  task.Run();
+  if (ui_priority)
+    base::subtle::Barrier_AtomicIncrement(&pending_ui_tasks_, -1);
+  base::subtle::Barrier_AtomicIncrement(&pending_tasks_, -1);
+}
+
 FilePath HistoryBackend::GetThumbnailFileName() const {
   return history_dir_.Append(chrome::kThumbnailsFilename);
 }
@@ -718,7 +744,9 @@ void HistoryBackend::InitImpl(const std::string& languages) {
   // Get the first item in our database.
   db_->GetStartDate(&first_recorded_time_);
 
-  // Start expiring old stuff.
+  // Start expiring old stuff, behind the tasks the UI is waiting on.
+  expirer_.set_should_yield_callback(
+      base::Bind(&HistoryBackend::HasPendingUITasks, base::Unretained(this)));
   expirer_.StartArchivingOldStuff(TimeDelta::FromDays(kArchiveDaysThreshold));
 
 #if defined(OS_ANDROID)
@@ -2068,6 +2096,7 @@ void HistoryBackend::Commit() {
   // some cases) but it hasn't been important yet.
   CancelScheduledCommit();
 
+  base::TimeTicks begin_time = base::TimeTicks::Now();
   db_->CommitTransaction();
   DCHECK(db_->transaction_nesting() == 0) << "Somebody left a transaction open";
   db_->BeginTransaction();
@@ -2088,12 +2117,15 @@ void HistoryBackend::Commit() {
     text_database_->CommitTransaction();
     text_database_->BeginTransaction();
   }
+  UMA_HISTOGRAM_TIMES("History.CommitTime",
+                      base::TimeTicks::Now() - begin_time);
 }
 
 void HistoryBackend::ScheduleCommit() {
   if (scheduled_commit_.get())
     return;
   scheduled_commit_ = new CommitLaterTask(this);
+  commit_deferred_ = false;
   MessageLoop::current()->PostDelayedTask(
       FROM_HERE,
       base::Bind(&CommitLaterTask::RunCommit, scheduled_commit_.get()),
@@ -2107,6 +2139,18 @@ void HistoryBackend::CancelScheduledCommit() {
   }
 }
 
+void HistoryBackend::RunScheduledCommit() {
+  if (!commit_deferred_ && HasPendingUITasks()) {
+    commit_deferred_ = true;
+    MessageLoop::current()->PostTask(
+        FROM_HERE,
+        base::Bind(&CommitLaterTask::RunCommit, scheduled_commit_.get()));
+    return;
+  }
+  UMA_HISTOGRAM_BOOLEAN("History.CommitDeferred", commit_deferred_);
+  Commit();
+}
+
 void HistoryBackend::ProcessDBTaskImpl() {
   if (!db_.get()) {
     // db went away, release all the refs.
@@ -2336,8 +2380,11 @@ bool HistoryBackend::ClearAllThumbnailHistory(URLRows* kept_urls) {
     // When we have no reference to the thumbnail database, maybe there was an
     // error opening it. In this case, we just try to blow it away to try to
     // fix the error if it exists. This may fail, in which case either the
-    // file doesn't exist or there's no more we can do.
+    // file doesn't exist or there's no more we can do. Its write-ahead log
+    // goes too, as it would otherwise be replayed into the next database.
     file_util::Delete(GetThumbnailFileName(), false);
+    file_util::Delete(FilePath(GetThumbnailFileName().value() +
+                               FILE_PATH_LITERAL("-wal")), false);
     return true;
   }
 
@@ -9,6 +9,8 @@
 #include <string>
 #include <utility>
 
+#include "base/atomicops.h"
+#include "base/callback_forward.h"
 #include "base/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/mru_cache.h"
@@ -135,6 +137,26 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   // See NotifyRenderProcessHostDestruction.
   void NotifyRenderProcessHostDestruction(const void* host);
 
+  // Scheduling ----------------------------------------------------------------
+
+  // Called by the HistoryService on the main thread for each task it posts to
+  // the history thread, which it wraps in RunScheduledTask. |ui_priority| is
+  // set for the tasks the UI is waiting on. Returns the number of posted tasks
+  // which have not finished running, including this one.
+  int WillScheduleTask(bool ui_priority);
+
+  // Runs |task|, which was counted by WillScheduleTask at |scheduled_time|.
+  // Tasks run in the order they were posted, since many read what earlier
+  // ones wrote, but the backend holds back its own batched work, such as
+  // committing, while tasks for the UI are waiting (see RunScheduledCommit).
+  void RunScheduledTask(bool ui_priority,
+                        base::TimeTicks scheduled_time,
+                        const base::Closure& task);
+
+  // Returns true if tasks for the UI have been posted which have not finished
+  // running. This is called on the history thread.
+  bool HasPendingUITasks() const;
+
   // Navigation ----------------------------------------------------------------
 
   void AddPage(scoped_refptr<HistoryAddPageArgs> request);
@@ -470,6 +492,7 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
                            CloneFaviconIsRestrictedToSameDomain);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, QueryFilteredURLs);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, UpdateVisitDuration);
+  FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, CommitWaitsForUITasks);
 
   friend class ::TestingProfile;
 
@@ -561,6 +584,11 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   // does nothing.
   void CancelScheduledCommit();
 
+  // Called by the scheduled commit when it comes due. If tasks for the UI are
+  // waiting, the commit is posted again behind them, once, so that they are
+  // not held up by the writes. Otherwise this commits.
+  void RunScheduledCommit();
+
   // Segments ------------------------------------------------------------------
 
   // Walks back a segment chain to find the last visit with a non null segment
@@ -696,6 +724,15 @@ class HistoryBackend : public base::RefCountedThreadSafe<HistoryBackend>,
   // scheduled commit at a time (see ScheduleCommit).
   scoped_refptr<CommitLaterTask> scheduled_commit_;
 
+  // Set when |scheduled_commit_| has been put off for tasks for the UI.
+  bool commit_deferred_;
+
+  // The number of tasks posted by the HistoryService which have not finished
+  // running, and how many of those are for the UI. These are updated from both
+  // the main and the history thread.
+  base::subtle::Atomic32 pending_tasks_;
+  base::subtle::Atomic32 pending_ui_tasks_;
+
   // Maps recent redirect destination pages to the chain of redirects that
   // brought us to there. Pages that did not have redirects or were not the
   // final redirect in a chain will not be in this list, as well as pages that
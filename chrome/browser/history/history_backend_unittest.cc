@@ -5,6 +5,7 @@
 #include <set>
 #include <vector>
 
+#include "base/bind.h"
 #include "base/command_line.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
@@ -206,6 +207,11 @@ class HistoryBackendTest : public testing::Test {
       return 0;
   }
 
+  // Sets |commit_scheduled| to whether the backend has a commit pending.
+  void CheckCommitScheduled(bool* commit_scheduled) {
+    *commit_scheduled = !!backend_->scheduled_commit_.get();
+  }
+
   BookmarkModel bookmark_model_;
 
  protected:
@@ -1517,4 +1523,30 @@ TEST_F(HistoryBackendTest, MigrationVisitDuration) {
   EXPECT_EQ(0, s1.ColumnInt(0));
 }
 
+// A commit which comes due while tasks for the UI are waiting runs after them.
+TEST_F(HistoryBackendTest, CommitWaitsForUITasks) {
+  ASSERT_TRUE(backend_.get());
+  backend_->ScheduleCommit();
+  ASSERT_TRUE(backend_->scheduled_commit_.get());
+
+  bool commit_scheduled = false;
+  backend_->WillScheduleTask(true);
+  MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&HistoryBackend::RunScheduledTask, backend_.get(), true,
+                 base::TimeTicks::Now(),
+                 base::Bind(&HistoryBackendTest::CheckCommitScheduled,
+                            base::Unretained(this), &commit_scheduled)));
+  backend_->RunScheduledCommit();
+  EXPECT_TRUE(backend_->scheduled_commit_.get());
+  MessageLoop::current()->RunAllPending();
+  EXPECT_TRUE(commit_scheduled);
+  EXPECT_FALSE(backend_->scheduled_commit_.get());
+
+  // With nothing waiting the commit is not put off.
+  backend_->ScheduleCommit();
+  backend_->RunScheduledCommit();
+  EXPECT_FALSE(backend_->scheduled_commit_.get());
+}
+
 }  // namespace history
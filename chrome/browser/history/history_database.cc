@@ -15,6 +15,7 @@
 #include "base/string_util.h"
 #include "chrome/browser/diagnostics/sqlite_diagnostics.h"
 #include "chrome/browser/history/starred_url_database.h"
+#include "chrome/common/chrome_switches.h"
 #include "sql/transaction.h"
 
 #if defined(OS_MACOSX)
@@ -89,6 +90,15 @@ sql::InitStatus HistoryDatabase::Init(const FilePath& history_name,
   // BeginExclusiveMode below which is called later (we have to be in shared
   // mode to start out for the in-memory backend to read the data).
 
+  // Commit through a write-ahead log. The backend keeps a transaction open
+  // between commits, and with the log the in-memory backend can still read
+  // the last committed data, while each commit appends to the log instead
+  // of syncing both a journal and the database.
+  db_.set_write_ahead_logging();
+
+  db_.set_profiling_enabled(CommandLine::ForCurrentProcess()->HasSwitch(
+      switches::kEnableSQLProfiling));
+
   if (!db_.Open(history_name))
     return sql::INIT_FAILURE;
 
@@ -0,0 +1,42 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/history_database_util.h"
+
+#include <algorithm>
+
+#include "base/string_number_conversions.h"
+#include "sql/connection.h"
+
+namespace history {
+
+namespace {
+
+// The number of ids listed in one statement.
+const size_t kIdBatchSize = 500;
+
+}  // namespace
+
+bool ExecuteForIdsInBatches(sql::Connection* db,
+                            const std::string& sql_prefix,
+                            const std::vector<int64>& ids,
+                            const std::string& sql_suffix) {
+  for (size_t start_index = 0; start_index < ids.size();
+       start_index += kIdBatchSize) {
+    size_t end_index = std::min(start_index + kIdBatchSize, ids.size());
+    std::string sql = sql_prefix + "(";
+    for (size_t i = start_index; i < end_index; ++i) {
+      if (i != start_index)
+        sql.push_back(',');
+      sql.append(base::Int64ToString(ids[i]));
+    }
+    sql.append(")");
+    sql.append(sql_suffix);
+    if (!db->Execute(sql.c_str()))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace history
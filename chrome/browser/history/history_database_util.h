@@ -0,0 +1,32 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_HISTORY_DATABASE_UTIL_H_
+#define CHROME_BROWSER_HISTORY_HISTORY_DATABASE_UTIL_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace sql {
+class Connection;
+}
+
+namespace history {
+
+// Runs |sql_prefix| + "(id,id,...)" + |sql_suffix| on |db| for each batch of
+// up to a few hundred of |ids|, so that a statement like
+// "DELETE FROM urls WHERE id IN " covers many rows at once without hitting
+// SQLite's limits on the length of a statement. Returns false as soon as one
+// of the statements fails.
+bool ExecuteForIdsInBatches(sql::Connection* db,
+                            const std::string& sql_prefix,
+                            const std::vector<int64>& ids,
+                            const std::string& sql_suffix);
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_HISTORY_DATABASE_UTIL_H_
@@ -45,6 +45,7 @@ typedef int64 DownloadID;   // Identifier for a download.
 typedef int64 FaviconID;  // For favicons.
 typedef int64 SegmentID;  // URL segments for the most visited view.
 typedef int64 IconMappingID; // For page url and icon mapping.
+typedef int64 ImageBlobID;  // For the stored data of favicons and thumbnails.
 
 // URLRow ---------------------------------------------------------------------
 
@@ -0,0 +1,112 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/image_blob_table.h"
+
+#include <string>
+
+#include "base/logging.h"
+#include "base/metrics/histogram.h"
+#include "base/sha1.h"
+#include "sql/connection.h"
+#include "sql/statement.h"
+
+namespace history {
+
+ImageBlobTable::ImageBlobTable() : db_(NULL) {
+}
+
+ImageBlobTable::~ImageBlobTable() {
+}
+
+bool ImageBlobTable::Init(sql::Connection* db) {
+  db_ = db;
+  if (!db_->DoesTableExist("image_blobs")) {
+    if (!db_->Execute("CREATE TABLE image_blobs ("
+                      "id INTEGER PRIMARY KEY,"
+                      "hash BLOB NOT NULL,"
+                      "ref_count INTEGER DEFAULT 0,"
+                      "data BLOB)"))
+      return false;
+  }
+  return db_->Execute("CREATE UNIQUE INDEX IF NOT EXISTS image_blobs_hash "
+                      "ON image_blobs(hash)");
+}
+
+ImageBlobID ImageBlobTable::AddBlobReference(const unsigned char* data,
+                                             size_t length) {
+  DCHECK(db_);
+  unsigned char hash[base::kSHA1Length];
+  base::SHA1HashBytes(data, length, hash);
+
+  sql::Statement select_statement(db_->GetCachedStatement(SQL_FROM_HERE,
+      "SELECT id FROM image_blobs WHERE hash=?"));
+  select_statement.BindBlob(0, hash, sizeof(hash));
+  bool shared = select_statement.Step();
+  UMA_HISTOGRAM_BOOLEAN("History.ImageBlobShared", shared);
+
+  if (shared) {
+    // The data is already stored, so neither it nor its pages are written.
+    ImageBlobID blob_id = select_statement.ColumnInt64(0);
+    select_statement.Reset(true);
+    UMA_HISTOGRAM_COUNTS("History.ImageBlobBytesSaved", length);
+
+    sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE,
+        "UPDATE image_blobs SET ref_count=ref_count+1 WHERE id=?"));
+    statement.BindInt64(0, blob_id);
+    return statement.Run() ? blob_id : 0;
+  }
+
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE,
+      "INSERT INTO image_blobs (hash, ref_count, data) VALUES (?, 1, ?)"));
+  statement.BindBlob(0, hash, sizeof(hash));
+  statement.BindBlob(1, data, static_cast<int>(length));
+  if (!statement.Run())
+    return 0;
+  return db_->GetLastInsertRowId();
+}
+
+bool ImageBlobTable::ReleaseBlob(ImageBlobID blob_id) {
+  DCHECK(db_);
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE,
+      "UPDATE image_blobs SET ref_count=ref_count-1 WHERE id=?"));
+  statement.BindInt64(0, blob_id);
+  if (!statement.Run())
+    return false;
+
+  sql::Statement delete_statement(db_->GetCachedStatement(SQL_FROM_HERE,
+      "DELETE FROM image_blobs WHERE id=? AND ref_count<=0"));
+  delete_statement.BindInt64(0, blob_id);
+  return delete_statement.Run();
+}
+
+bool ImageBlobTable::GetBlob(ImageBlobID blob_id,
+                             std::vector<unsigned char>* data) {
+  DCHECK(db_);
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE,
+      "SELECT data FROM image_blobs WHERE id=?"));
+  statement.BindInt64(0, blob_id);
+  if (!statement.Step())
+    return false;
+
+  statement.ColumnBlobAsVector(0, data);
+  return true;
+}
+
+bool ImageBlobTable::RecountReferences(const char* table, const char* column) {
+  DCHECK(db_);
+  std::string sql("UPDATE image_blobs SET ref_count=(SELECT COUNT(*) FROM ");
+  sql.append(table);
+  sql.append(" WHERE ");
+  sql.append(table);
+  sql.append(".");
+  sql.append(column);
+  sql.append("=image_blobs.id)");
+  if (!db_->Execute(sql.c_str()))
+    return false;
+
+  return db_->Execute("DELETE FROM image_blobs WHERE ref_count<=0");
+}
+
+}  // namespace history
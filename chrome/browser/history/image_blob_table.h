@@ -0,0 +1,62 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_IMAGE_BLOB_TABLE_H_
+#define CHROME_BROWSER_HISTORY_IMAGE_BLOB_TABLE_H_
+#pragma once
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "chrome/browser/history/history_types.h"
+
+namespace sql {
+class Connection;
+}
+
+namespace history {
+
+// Stores the encoded images of a database, such as favicons and thumbnails,
+// once per distinct content. Each blob is keyed by the SHA-1 hash of its data
+// and counts the rows referring to it, so that the many pages and icon URLs
+// which share an icon share one copy of its bytes.
+//
+// The rows of the other tables refer to blobs by their ImageBlobID, and must
+// add and release their references as they change.
+class ImageBlobTable {
+ public:
+  ImageBlobTable();
+  ~ImageBlobTable();
+
+  // Creates the table in |db| if it does not exist yet. |db| must outlive
+  // this object. Returns false on failure.
+  bool Init(sql::Connection* db);
+
+  // Adds a reference to the blob holding the |length| bytes of |data|,
+  // storing them if no identical blob is stored yet. Returns the ID of the
+  // blob, or 0 on failure.
+  ImageBlobID AddBlobReference(const unsigned char* data, size_t length);
+
+  // Drops a reference to the blob |blob_id|, deleting the blob once nothing
+  // refers to it. Returns false on failure.
+  bool ReleaseBlob(ImageBlobID blob_id);
+
+  // Reads the data of the blob |blob_id| into |data|. Returns false if there
+  // is no such blob.
+  bool GetBlob(ImageBlobID blob_id, std::vector<unsigned char>* data);
+
+  // Resets the reference count of each blob to the number of rows of |table|
+  // whose |column| refers to it, and deletes the blobs none refer to. Used
+  // when the referring table has been replaced wholesale.
+  bool RecountReferences(const char* table, const char* column);
+
+ private:
+  sql::Connection* db_;
+
+  DISALLOW_COPY_AND_ASSIGN(ImageBlobTable);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_IMAGE_BLOB_TABLE_H_
@@ -0,0 +1,92 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/scoped_temp_dir.h"
+#include "chrome/browser/history/image_blob_table.h"
+#include "sql/connection.h"
+#include "sql/statement.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+namespace {
+
+const unsigned char kBlob1[] = "favicon-one";
+const unsigned char kBlob2[] = "favicon-two";
+
+}  // namespace
+
+class ImageBlobTableTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    ASSERT_TRUE(db_.Open(temp_dir_.path().AppendASCII("TestBlobs.db")));
+    ASSERT_TRUE(blobs_.Init(&db_));
+  }
+
+  // Returns the number of blobs stored.
+  int BlobCount() {
+    sql::Statement statement(db_.GetUniqueStatement(
+        "SELECT COUNT(*) FROM image_blobs"));
+    EXPECT_TRUE(statement.Step());
+    return statement.ColumnInt(0);
+  }
+
+  ScopedTempDir temp_dir_;
+  sql::Connection db_;
+  ImageBlobTable blobs_;
+};
+
+TEST_F(ImageBlobTableTest, SharesIdenticalData) {
+  ImageBlobID id1 = blobs_.AddBlobReference(kBlob1, sizeof(kBlob1));
+  ASSERT_NE(0, id1);
+  EXPECT_EQ(id1, blobs_.AddBlobReference(kBlob1, sizeof(kBlob1)));
+  ImageBlobID id2 = blobs_.AddBlobReference(kBlob2, sizeof(kBlob2));
+  ASSERT_NE(0, id2);
+  EXPECT_NE(id1, id2);
+  EXPECT_EQ(2, BlobCount());
+
+  std::vector<unsigned char> data;
+  ASSERT_TRUE(blobs_.GetBlob(id1, &data));
+  EXPECT_EQ(std::vector<unsigned char>(kBlob1, kBlob1 + sizeof(kBlob1)), data);
+
+  // The blob stays until its last reference is released.
+  EXPECT_TRUE(blobs_.ReleaseBlob(id1));
+  EXPECT_TRUE(blobs_.GetBlob(id1, &data));
+  EXPECT_TRUE(blobs_.ReleaseBlob(id1));
+  EXPECT_FALSE(blobs_.GetBlob(id1, &data));
+  EXPECT_EQ(1, BlobCount());
+
+  // Storing released data again stores a new blob.
+  EXPECT_NE(0, blobs_.AddBlobReference(kBlob1, sizeof(kBlob1)));
+  EXPECT_EQ(2, BlobCount());
+}
+
+TEST_F(ImageBlobTableTest, RecountReferences) {
+  ImageBlobID id1 = blobs_.AddBlobReference(kBlob1, sizeof(kBlob1));
+  ImageBlobID id2 = blobs_.AddBlobReference(kBlob2, sizeof(kBlob2));
+  ASSERT_TRUE(db_.Execute("CREATE TABLE icons (id INTEGER PRIMARY KEY,"
+                          "blob_id INTEGER)"));
+  sql::Statement statement(db_.GetUniqueStatement(
+      "INSERT INTO icons (blob_id) VALUES (?)"));
+  for (int i = 0; i < 2; ++i) {
+    statement.BindInt64(0, id2);
+    ASSERT_TRUE(statement.Run());
+    statement.Reset(true);
+  }
+
+  // Only the blob the table refers to is kept, with one reference per row.
+  ASSERT_TRUE(blobs_.RecountReferences("icons", "blob_id"));
+  std::vector<unsigned char> data;
+  EXPECT_FALSE(blobs_.GetBlob(id1, &data));
+  EXPECT_TRUE(blobs_.ReleaseBlob(id2));
+  EXPECT_TRUE(blobs_.GetBlob(id2, &data));
+  EXPECT_TRUE(blobs_.ReleaseBlob(id2));
+  EXPECT_FALSE(blobs_.GetBlob(id2, &data));
+}
+
+}  // namespace history
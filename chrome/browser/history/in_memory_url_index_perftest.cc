@@ -0,0 +1,165 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <set>
+#include <string>
+
+#include "base/file_path.h"
+#include "base/perftimer.h"
+#include "base/scoped_temp_dir.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/url_index_private_data.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::TimeDelta;
+using base::TimeTicks;
+
+namespace history {
+
+namespace {
+
+// The size of the synthetic history.
+const int kHistoryItemCount = 200000;
+
+// The number of distinct words and hosts in the synthetic history.
+const uint32 kVocabularySize = 20000;
+const uint32 kHostCount = 2000;
+
+// Strings typed into the omnibox, one keystroke at a time, given as indexes
+// into the vocabulary. Low indexes are the most common words.
+const uint32 kTypedWords[][3] = {
+  { 1, 0, 0 },
+  { 17, 0, 0 },
+  { 250, 3, 0 },
+  { 4000, 0, 0 },
+  { 12, 345, 0 },
+  { 7, 52, 911 },
+  { 19999, 0, 0 },
+  { 2, 1500, 0 },
+};
+
+// A deterministic pseudo-random number generator, so that every run indexes
+// the same history.
+class Generator {
+ public:
+  Generator() : state_(12345) {}
+
+  uint32 Next() {
+    state_ = state_ * 1103515245 + 12345;
+    return (state_ >> 16) & 0x7fff;
+  }
+
+  // Returns a number below |limit|, skewed towards the low ones the way word
+  // frequencies are.
+  uint32 NextSkewed(uint32 limit) {
+    uint32 value = (Next() << 15) | Next();
+    double fraction = static_cast<double>(value) / (1 << 30);
+    return static_cast<uint32>(fraction * fraction * fraction * limit);
+  }
+
+ private:
+  uint32 state_;
+};
+
+// Returns the word |index| of the vocabulary.
+std::string Word(uint32 index) {
+  static const char* kSyllables[] = {
+    "ka", "lo", "mi", "ne", "su", "ta", "ri", "po",
+    "ve", "zu", "ba", "de", "go", "hi", "ju", "ax",
+  };
+  std::string word;
+  do {
+    word += kSyllables[index % arraysize(kSyllables)];
+    index /= arraysize(kSyllables);
+  } while (index);
+  return word;
+}
+
+}  // namespace
+
+class InMemoryURLIndexPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    data_ = new URLIndexPrivateData;
+    std::set<std::string> scheme_whitelist;
+    scheme_whitelist.insert("http");
+    Generator generator;
+    base::Time now = base::Time::Now();
+    for (int i = 1; i <= kHistoryItemCount; ++i) {
+      std::string url = base::StringPrintf("http://www.%s.com/%s/%s/%d",
+          Word(generator.NextSkewed(kHostCount)).c_str(),
+          Word(generator.NextSkewed(kVocabularySize)).c_str(),
+          Word(generator.NextSkewed(kVocabularySize)).c_str(), i);
+      std::string title;
+      for (uint32 j = 3 + generator.Next() % 5; j > 0; --j)
+        title += Word(generator.NextSkewed(kVocabularySize)) + " ";
+      URLRow row(GURL(url), i);
+      row.set_title(UTF8ToUTF16(title));
+      row.set_visit_count(1 + generator.Next() % 20);
+      row.set_typed_count(generator.Next() % 3);
+      row.set_last_visit(now - TimeDelta::FromHours(generator.Next() % 2000));
+      data_->IndexRow(row, "en", scheme_whitelist);
+    }
+  }
+
+  // Types each of |kTypedWords| into the omnibox and logs the mean and the
+  // worst time taken to search |data| after a keystroke.
+  void TypeStrings(URLIndexPrivateData* data, const char* name) {
+    TimeDelta total;
+    TimeDelta worst;
+    int keystrokes = 0;
+    for (size_t i = 0; i < arraysize(kTypedWords); ++i) {
+      std::string text(Word(kTypedWords[i][0]));
+      for (size_t j = 1; j < arraysize(kTypedWords[i]) && kTypedWords[i][j];
+           ++j)
+        text += " " + Word(kTypedWords[i][j]);
+      for (size_t length = 1; length <= text.length(); ++length) {
+        string16 typed(UTF8ToUTF16(text.substr(0, length)));
+        TimeTicks beginning_time = TimeTicks::Now();
+        data->HistoryItemsForTerms(typed);
+        TimeDelta elapsed = TimeTicks::Now() - beginning_time;
+        total += elapsed;
+        worst = std::max(worst, elapsed);
+        ++keystrokes;
+      }
+      data->search_term_cache_.clear();
+    }
+    LogPerfResult(base::StringPrintf("%s_mean", name).c_str(),
+                  total.InMillisecondsF() / keystrokes, "ms");
+    LogPerfResult(base::StringPrintf("%s_worst", name).c_str(),
+                  worst.InMillisecondsF(), "ms");
+  }
+
+  // Writes |data_| to a cache file and restores a new index from it.
+  scoped_refptr<URLIndexPrivateData> SaveAndRestore() {
+    ScopedTempDir temp_dir;
+    if (!temp_dir.CreateUniqueTempDir())
+      return NULL;
+    FilePath path(temp_dir.path().AppendASCII("History Provider Cache"));
+    scoped_refptr<URLIndexPrivateData> restored_data(new URLIndexPrivateData);
+    if (!data_->SaveToFile(path) ||
+        !restored_data->RestoreFromFile(path, "en"))
+      return NULL;
+    return restored_data;
+  }
+
+  scoped_refptr<URLIndexPrivateData> data_;
+};
+
+// Searches the history as indexed in memory.
+TEST_F(InMemoryURLIndexPerfTest, Keystrokes) {
+  TypeStrings(data_, "HQP_keystroke");
+}
+
+// Searches the history as restored from a cache file.
+TEST_F(InMemoryURLIndexPerfTest, CacheFileKeystrokes) {
+  scoped_refptr<URLIndexPrivateData> restored_data(SaveAndRestore());
+  ASSERT_TRUE(restored_data.get());
+  TypeStrings(restored_data, "HQP_cache_file_keystroke");
+}
+
+}  // namespace history
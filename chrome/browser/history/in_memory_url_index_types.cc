@@ -148,6 +148,83 @@ Char16Set Char16SetFromString16(const string16& term) {
   return characters;
 }
 
+// HistoryID Intersection ------------------------------------------------------
+
+namespace {
+
+// Below this ratio between the lengths of the lists a linear merge is faster
+// than galloping through the longer one.
+const size_t kGallopingRatio = 8;
+
+// Returns the first position within [|first|, |last|) whose ID is not less
+// than |history_id|, probing positions exponentially further from |first|
+// before searching the last interval probed.
+HistoryIDVector::const_iterator Gallop(HistoryIDVector::const_iterator first,
+                                       HistoryIDVector::const_iterator last,
+                                       HistoryID history_id) {
+  size_t step = 1;
+  while (step < static_cast<size_t>(last - first) &&
+         first[step] < history_id) {
+    first += step;
+    step *= 2;
+  }
+  return std::lower_bound(
+      first, first + std::min(step, static_cast<size_t>(last - first)),
+      history_id);
+}
+
+}  // namespace
+
+void IntersectHistoryIDs(const HistoryIDVector& other,
+                         HistoryIDVector* history_ids) {
+  HistoryIDVector intersection;
+  const HistoryIDVector& shorter =
+      (history_ids->size() < other.size()) ? *history_ids : other;
+  const HistoryIDVector& longer =
+      (history_ids->size() < other.size()) ? other : *history_ids;
+  if (shorter.size() * kGallopingRatio < longer.size()) {
+    intersection.reserve(shorter.size());
+    HistoryIDVector::const_iterator position = longer.begin();
+    for (HistoryIDVector::const_iterator iter = shorter.begin();
+         iter != shorter.end() && position != longer.end(); ++iter) {
+      position = Gallop(position, longer.end(), *iter);
+      if (position != longer.end() && *position == *iter)
+        intersection.push_back(*position++);
+    }
+  } else {
+    std::set_intersection(shorter.begin(), shorter.end(),
+                          longer.begin(), longer.end(),
+                          std::back_inserter(intersection));
+  }
+  history_ids->swap(intersection);
+}
+
+void SortAndUniqueHistoryIDs(HistoryIDVector* history_ids) {
+  if (history_ids->empty())
+    return;
+  HistoryID min_id = *std::min_element(history_ids->begin(),
+                                       history_ids->end());
+  HistoryID max_id = *std::max_element(history_ids->begin(),
+                                       history_ids->end());
+  // The bitmap takes no more memory than the IDs themselves.
+  uint64 range = static_cast<uint64>(max_id - min_id) + 1;
+  if (range / (sizeof(HistoryID) * 8) > history_ids->size()) {
+    std::sort(history_ids->begin(), history_ids->end());
+    history_ids->erase(std::unique(history_ids->begin(), history_ids->end()),
+                       history_ids->end());
+    return;
+  }
+  std::vector<bool> present(static_cast<size_t>(range));
+  for (HistoryIDVector::const_iterator iter = history_ids->begin();
+       iter != history_ids->end(); ++iter)
+    present[*iter - min_id] = true;
+  history_ids->clear();
+  for (size_t i = 0; i < present.size(); ++i) {
+    if (present[i])
+      history_ids->push_back(min_id + i);
+  }
+}
+
 // RowWordStarts ---------------------------------------------------------------
 
 RowWordStarts::RowWordStarts() {}
@@ -139,13 +139,29 @@ typedef std::map<string16, WordID> WordMap;
 typedef std::set<WordID> WordIDSet;  // An index into the WordList.
 typedef std::map<char16, WordIDSet> CharWordIDMap;
 
-// A map from word (by word_id) to history items containing that word.
+// A map from word (by word_id) to history items containing that word. The
+// history IDs of each word are kept sorted, so that they can be united and
+// intersected without building trees.
 typedef history::URLID HistoryID;
 typedef std::set<HistoryID> HistoryIDSet;
 typedef std::vector<HistoryID> HistoryIDVector;
-typedef std::map<WordID, HistoryIDSet> WordIDHistoryMap;
+typedef std::map<WordID, HistoryIDVector> WordIDHistoryMap;
 typedef std::map<HistoryID, WordIDSet> HistoryIDWordMap;
 
+// Intersects the sorted |history_ids| with the sorted |other|, leaving the
+// IDs found in both in |history_ids|. When one list is much shorter than the
+// other, which is the case of a rare word meeting a common one, the longer
+// list is searched with galloping (exponential then binary) searches rather
+// than walked element by element.
+void IntersectHistoryIDs(const HistoryIDVector& other,
+                         HistoryIDVector* history_ids);
+
+// Sorts |history_ids| and removes the duplicates, as when uniting the history
+// IDs of several words. Many IDs from a narrow range, such as those of all of
+// the words containing a common character, are sorted by marking them in a
+// bitmap rather than by comparing them.
+void SortAndUniqueHistoryIDs(HistoryIDVector* history_ids);
+
 // A map from history_id to the history's URL and title.
 typedef std::map<HistoryID, URLRow> HistoryInfoMap;
 
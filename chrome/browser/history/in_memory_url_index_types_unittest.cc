@@ -144,4 +144,38 @@ TEST_F(InMemoryURLIndexTypesTest, OffsetsAndTermMatches) {
     EXPECT_EQ(expected_offsets_b[i], matches_b[i].offset);
 }
 
+TEST_F(InMemoryURLIndexTypesTest, IntersectHistoryIDs) {
+  // Lists of similar lengths are merged.
+  const HistoryID kEvens[] = { 2, 4, 6, 8, 10, 12 };
+  const HistoryID kThrees[] = { 3, 6, 9, 12, 15 };
+  HistoryIDVector history_ids(kEvens, kEvens + arraysize(kEvens));
+  IntersectHistoryIDs(HistoryIDVector(kThrees, kThrees + arraysize(kThrees)),
+                      &history_ids);
+  ASSERT_EQ(2U, history_ids.size());
+  EXPECT_EQ(6, history_ids[0]);
+  EXPECT_EQ(12, history_ids[1]);
+
+  // A short list gallops through a long one, whichever of the two is given
+  // first.
+  HistoryIDVector long_ids;
+  for (HistoryID id = 1; id <= 1000; ++id)
+    long_ids.push_back(id * 3);
+  const HistoryID kShort[] = { 1, 3, 500, 501, 2998, 3000, 3003 };
+  HistoryIDVector short_ids(kShort, kShort + arraysize(kShort));
+  history_ids = long_ids;
+  IntersectHistoryIDs(short_ids, &history_ids);
+  const HistoryID kExpected[] = { 3, 501, 3000 };
+  ASSERT_EQ(arraysize(kExpected), history_ids.size());
+  for (size_t i = 0; i < arraysize(kExpected); ++i)
+    EXPECT_EQ(kExpected[i], history_ids[i]);
+  IntersectHistoryIDs(long_ids, &short_ids);
+  EXPECT_TRUE(short_ids == history_ids);
+
+  // Nothing is left when either list is empty.
+  IntersectHistoryIDs(HistoryIDVector(), &history_ids);
+  EXPECT_TRUE(history_ids.empty());
+  IntersectHistoryIDs(long_ids, &history_ids);
+  EXPECT_TRUE(history_ids.empty());
+}
+
 }  // namespace history
@@ -133,6 +133,7 @@ class InMemoryURLIndexTest : public testing::Test {
   bool GetCacheFilePath(FilePath* file_path) const;
   void PostRestoreFromCacheFileTask();
   void PostSaveToCacheFileTask();
+  void SaveAndRestoreCache();
   void Observe(int notification_type,
                const content::NotificationSource& source,
                const content::NotificationDetails& details);
@@ -193,6 +194,22 @@ void InMemoryURLIndexTest::PostSaveToCacheFileTask() {
   url_index_->PostSaveToCacheFileTask();
 }
 
+void InMemoryURLIndexTest::SaveAndRestoreCache() {
+  CacheFileSaverObserver save_observer(&message_loop_);
+  url_index_->set_save_cache_observer(&save_observer);
+  PostSaveToCacheFileTask();
+  message_loop_.Run();
+  EXPECT_TRUE(save_observer.succeeded_);
+  url_index_->set_save_cache_observer(NULL);
+
+  CacheFileReaderObserver read_observer(&message_loop_);
+  url_index_->set_restore_cache_observer(&read_observer);
+  PostRestoreFromCacheFileTask();
+  message_loop_.Run();
+  EXPECT_TRUE(read_observer.succeeded_);
+  url_index_->set_restore_cache_observer(NULL);
+}
+
 void InMemoryURLIndexTest::Observe(
     int notification_type,
     const content::NotificationSource& source,
@@ -354,78 +371,43 @@ void InMemoryURLIndexTest::ExpectPrivateDataEmpty(
   EXPECT_TRUE(data.history_info_map_.empty());
 }
 
-// Helper function which compares two maps for equivalence. The maps' values
-// are associative containers and their contents are compared as well.
-template<typename T>
-void ExpectMapOfContainersIdentical(const T& expected, const T& actual) {
-  ASSERT_EQ(expected.size(), actual.size());
-  for (typename T::const_iterator expected_iter = expected.begin();
-       expected_iter != expected.end(); ++expected_iter) {
-    typename T::const_iterator actual_iter = actual.find(expected_iter->first);
-    ASSERT_TRUE(actual.end() != actual_iter);
-    typename T::mapped_type const& expected_values(expected_iter->second);
-    typename T::mapped_type const& actual_values(actual_iter->second);
-    ASSERT_EQ(expected_values.size(), actual_values.size());
-    for (typename T::mapped_type::const_iterator set_iter =
-         expected_values.begin(); set_iter != expected_values.end(); ++set_iter)
-      EXPECT_EQ(actual_values.count(*set_iter),
-                expected_values.count(*set_iter));
-  }
-}
-
 void InMemoryURLIndexTest::ExpectPrivateDataEqual(
     const URLIndexPrivateData& expected,
     const URLIndexPrivateData& actual) {
-  EXPECT_EQ(expected.word_list_.size(), actual.word_list_.size());
-  EXPECT_EQ(expected.word_map_.size(), actual.word_map_.size());
-  EXPECT_EQ(expected.char_word_map_.size(), actual.char_word_map_.size());
-  EXPECT_EQ(expected.word_id_history_map_.size(),
-            actual.word_id_history_map_.size());
-  EXPECT_EQ(expected.history_id_word_map_.size(),
-            actual.history_id_word_map_.size());
-  EXPECT_EQ(expected.history_info_map_.size(), actual.history_info_map_.size());
-  EXPECT_EQ(expected.word_starts_map_.size(), actual.word_starts_map_.size());
-  // WordList must be index-by-index equal.
-  size_t count = expected.word_list_.size();
-  for (size_t i = 0; i < count; ++i)
-    EXPECT_EQ(expected.word_list_[i], actual.word_list_[i]);
-
-  ExpectMapOfContainersIdentical(expected.char_word_map_,
-                                 actual.char_word_map_);
-  ExpectMapOfContainersIdentical(expected.word_id_history_map_,
-                                 actual.word_id_history_map_);
-  ExpectMapOfContainersIdentical(expected.history_id_word_map_,
-                                 actual.history_id_word_map_);
-
-  for (HistoryInfoMap::const_iterator expected_info =
-      expected.history_info_map_.begin();
-      expected_info != expected.history_info_map_.end(); ++expected_info) {
-    HistoryInfoMap::const_iterator actual_info =
-        actual.history_info_map_.find(expected_info->first);
+  // The two may hold their data in the maps or in a cache file, so compare
+  // the contents they would write to a cache file.
+  URLIndexCacheFile::WordHistoryMap expected_words;
+  URLIndexCacheFile::ItemContentsVector expected_items;
+  expected.GetCacheFileContents(&expected_words, &expected_items);
+  URLIndexCacheFile::WordHistoryMap actual_words;
+  URLIndexCacheFile::ItemContentsVector actual_items;
+  actual.GetCacheFileContents(&actual_words, &actual_items);
+
+  ASSERT_EQ(expected_words.size(), actual_words.size());
+  for (URLIndexCacheFile::WordHistoryMap::const_iterator expected_word =
+       expected_words.begin(); expected_word != expected_words.end();
+       ++expected_word) {
+    URLIndexCacheFile::WordHistoryMap::const_iterator actual_word =
+        actual_words.find(expected_word->first);
     // NOTE(yfriedman): ASSERT_NE can't be used due to incompatibility between
     // gtest and STLPort in the Android build. See
     // http://code.google.com/p/googletest/issues/detail?id=359
-    ASSERT_TRUE(actual_info != actual.history_info_map_.end());
-    const URLRow& expected_row(expected_info->second);
-    const URLRow& actual_row(actual_info->second);
-    EXPECT_EQ(expected_row.visit_count(), actual_row.visit_count());
-    EXPECT_EQ(expected_row.typed_count(), actual_row.typed_count());
-    EXPECT_EQ(expected_row.last_visit(), actual_row.last_visit());
-    EXPECT_EQ(expected_row.url(), actual_row.url());
+    ASSERT_TRUE(actual_word != actual_words.end());
+    EXPECT_TRUE(expected_word->second == actual_word->second);
   }
 
-  for (WordStartsMap::const_iterator expected_starts =
-      expected.word_starts_map_.begin();
-      expected_starts != expected.word_starts_map_.end();
-      ++expected_starts) {
-    WordStartsMap::const_iterator actual_starts =
-        actual.word_starts_map_.find(expected_starts->first);
-    // NOTE(yfriedman): ASSERT_NE can't be used due to incompatibility between
-    // gtest and STLPort in the Android build. See
-    // http://code.google.com/p/googletest/issues/detail?id=359
-    ASSERT_TRUE(actual_starts != actual.word_starts_map_.end());
-    const RowWordStarts& expected_word_starts(expected_starts->second);
-    const RowWordStarts& actual_word_starts(actual_starts->second);
+  ASSERT_EQ(expected_items.size(), actual_items.size());
+  for (size_t i = 0; i < expected_items.size(); ++i) {
+    const URLIndexCacheFile::ItemContents& expected_item(expected_items[i]);
+    const URLIndexCacheFile::ItemContents& actual_item(actual_items[i]);
+    EXPECT_EQ(expected_item.history_id, actual_item.history_id);
+    EXPECT_EQ(expected_item.visit_count, actual_item.visit_count);
+    EXPECT_EQ(expected_item.typed_count, actual_item.typed_count);
+    EXPECT_EQ(expected_item.last_visit, actual_item.last_visit);
+    EXPECT_EQ(expected_item.url, actual_item.url);
+    EXPECT_EQ(expected_item.title, actual_item.title);
+    const RowWordStarts& expected_word_starts(expected_item.word_starts);
+    const RowWordStarts& actual_word_starts(actual_item.word_starts);
     EXPECT_EQ(expected_word_starts.url_word_starts_.size(),
               actual_word_starts.url_word_starts_.size());
     EXPECT_TRUE(std::equal(expected_word_starts.url_word_starts_.begin(),
@@ -1004,8 +986,162 @@ TEST_F(InMemoryURLIndexTest, CacheSaveRestore) {
 
   URLIndexPrivateData& new_data(*GetPrivateData());
 
+  // The restored data is searched in place, in the cache file.
+  EXPECT_TRUE(new_data.cache_file_.get());
+  EXPECT_TRUE(new_data.history_info_map_.empty());
+
   // Compare the captured and restored for equality.
   ExpectPrivateDataEqual(*old_data, new_data);
+
+  // Both give the same results.
+  const char* kTerms[] = { "DrudgeReport", "lebronomics could", "ne", "w" };
+  for (size_t i = 0; i < arraysize(kTerms); ++i) {
+    ScoredHistoryMatches expected_matches =
+        old_data->HistoryItemsForTerms(ASCIIToUTF16(kTerms[i]));
+    ScoredHistoryMatches actual_matches =
+        new_data.HistoryItemsForTerms(ASCIIToUTF16(kTerms[i]));
+    ASSERT_EQ(expected_matches.size(), actual_matches.size());
+    for (size_t j = 0; j < expected_matches.size(); ++j) {
+      EXPECT_EQ(expected_matches[j].url_info.id(),
+                actual_matches[j].url_info.id());
+      EXPECT_EQ(expected_matches[j].raw_score, actual_matches[j].raw_score);
+    }
+  }
+}
+
+TEST_F(InMemoryURLIndexTest, CacheFileUpdates) {
+  ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  set_history_dir(temp_directory.path());
+  SaveAndRestoreCache();
+  ASSERT_TRUE(GetPrivateData()->cache_file_.get());
+
+  // Update the title of a row of the cache file.
+  string16 original_terms =
+      ASCIIToUTF16("lebronomics could high taxes influence");
+  ScoredHistoryMatches matches =
+      url_index_->HistoryItemsForTerms(original_terms);
+  ASSERT_EQ(1U, matches.size());
+  const URLID expected_id = 3;
+  EXPECT_EQ(expected_id, matches[0].url_info.id());
+  URLRow old_row(matches[0].url_info);
+  old_row.set_title(ASCIIToUTF16("Does eat oats and little lambs eat ivy"));
+  EXPECT_TRUE(UpdateURL(old_row));
+
+  // The row is now found by its new title only.
+  string16 new_terms = ASCIIToUTF16("does eat oats little lambs ivy");
+  matches = url_index_->HistoryItemsForTerms(new_terms);
+  ASSERT_EQ(1U, matches.size());
+  EXPECT_EQ(expected_id, matches[0].url_info.id());
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(original_terms).empty());
+
+  // Delete a row of the cache file.
+  matches = url_index_->HistoryItemsForTerms(ASCIIToUTF16("DrudgeReport"));
+  ASSERT_EQ(1U, matches.size());
+  GURL deleted_url(matches[0].url_info.url());
+  EXPECT_TRUE(DeleteURL(deleted_url));
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("DrudgeReport")).empty());
+  EXPECT_FALSE(DeleteURL(deleted_url));
+
+  // Both changes are kept when the cache is written again.
+  SaveAndRestoreCache();
+  EXPECT_TRUE(GetPrivateData()->removed_cache_file_ids_.empty());
+  EXPECT_TRUE(GetPrivateData()->history_info_map_.empty());
+  matches = url_index_->HistoryItemsForTerms(new_terms);
+  ASSERT_EQ(1U, matches.size());
+  EXPECT_EQ(expected_id, matches[0].url_info.id());
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(original_terms).empty());
+  EXPECT_TRUE(url_index_->HistoryItemsForTerms(
+      ASCIIToUTF16("DrudgeReport")).empty());
+}
+
+TEST_F(InMemoryURLIndexTest, LegacyCacheRestore) {
+  // Build a cache as written by older versions, which holds a single row.
+  const HistoryID kHistoryID = 42;
+  const char* kWords[] = { "example", "lambs" };
+  imui::InMemoryURLIndexCacheItem cache;
+  cache.set_timestamp(base::Time::Now().ToInternalValue());
+  cache.set_history_item_count(0);
+  imui::InMemoryURLIndexCacheItem_WordListItem* word_list =
+      cache.mutable_word_list();
+  word_list->set_word_count(arraysize(kWords));
+  imui::InMemoryURLIndexCacheItem_WordMapItem* word_map =
+      cache.mutable_word_map();
+  word_map->set_item_count(arraysize(kWords));
+  imui::InMemoryURLIndexCacheItem_WordIDHistoryMapItem* word_id_history_map =
+      cache.mutable_word_id_history_map();
+  word_id_history_map->set_item_count(arraysize(kWords));
+  std::map<char16, std::vector<int> > char_words;
+  for (size_t i = 0; i < arraysize(kWords); ++i) {
+    word_list->add_word(kWords[i]);
+    imui::InMemoryURLIndexCacheItem_WordMapItem_WordMapEntry* word_entry =
+        word_map->add_word_map_entry();
+    word_entry->set_word(kWords[i]);
+    word_entry->set_word_id(i);
+    imui::InMemoryURLIndexCacheItem_WordIDHistoryMapItem_WordIDHistoryMapEntry*
+        history_entry = word_id_history_map->add_word_id_history_map_entry();
+    history_entry->set_item_count(1);
+    history_entry->set_word_id(i);
+    history_entry->add_history_id(kHistoryID);
+    Char16Set chars(Char16SetFromString16(ASCIIToUTF16(kWords[i])));
+    for (Char16Set::const_iterator c = chars.begin(); c != chars.end(); ++c)
+      char_words[*c].push_back(i);
+  }
+  imui::InMemoryURLIndexCacheItem_CharWordMapItem* char_word_map =
+      cache.mutable_char_word_map();
+  char_word_map->set_item_count(char_words.size());
+  for (std::map<char16, std::vector<int> >::const_iterator iter =
+       char_words.begin(); iter != char_words.end(); ++iter) {
+    imui::InMemoryURLIndexCacheItem_CharWordMapItem_CharWordMapEntry* entry =
+        char_word_map->add_char_word_map_entry();
+    entry->set_char_16(iter->first);
+    entry->set_item_count(iter->second.size());
+    for (size_t i = 0; i < iter->second.size(); ++i)
+      entry->add_word_id(iter->second[i]);
+  }
+  imui::InMemoryURLIndexCacheItem_HistoryInfoMapItem* history_info_map =
+      cache.mutable_history_info_map();
+  history_info_map->set_item_count(1);
+  imui::InMemoryURLIndexCacheItem_HistoryInfoMapItem_HistoryInfoMapEntry*
+      info_entry = history_info_map->add_history_info_map_entry();
+  info_entry->set_history_id(kHistoryID);
+  info_entry->set_visit_count(3);
+  info_entry->set_typed_count(1);
+  info_entry->set_last_visit(base::Time::Now().ToInternalValue());
+  info_entry->set_url("http://example.com/");
+  info_entry->set_title("Lambs");
+
+  ScopedTempDir temp_directory;
+  ASSERT_TRUE(temp_directory.CreateUniqueTempDir());
+  FilePath path(temp_directory.path().AppendASCII("History Provider Cache"));
+  std::string data;
+  ASSERT_TRUE(cache.SerializeToString(&data));
+  int size = data.size();
+  ASSERT_EQ(size, file_util::WriteFile(path, data.data(), size));
+
+  // The old format is decoded into the maps.
+  scoped_refptr<URLIndexPrivateData> legacy_data(new URLIndexPrivateData);
+  ASSERT_TRUE(legacy_data->RestoreFromFile(path, "en"));
+  EXPECT_FALSE(legacy_data->cache_file_.get());
+  EXPECT_EQ(0, legacy_data->restored_cache_version_);
+  EXPECT_EQ(1U, legacy_data->history_info_map_.size());
+  ScoredHistoryMatches matches =
+      legacy_data->HistoryItemsForTerms(ASCIIToUTF16("lambs"));
+  ASSERT_EQ(1U, matches.size());
+  EXPECT_EQ(kHistoryID, matches[0].url_info.id());
+
+  // Writing it again replaces it with a cache file in the current format.
+  ASSERT_TRUE(legacy_data->SaveToFile(path));
+  scoped_refptr<URLIndexPrivateData> restored_data(new URLIndexPrivateData);
+  ASSERT_TRUE(restored_data->RestoreFromFile(path, "en"));
+  EXPECT_TRUE(restored_data->cache_file_.get());
+  EXPECT_EQ(kCurrentCacheFileVersion, restored_data->restored_cache_version_);
+  EXPECT_TRUE(restored_data->history_info_map_.empty());
+  ExpectPrivateDataEqual(*legacy_data, *restored_data);
+  matches = restored_data->HistoryItemsForTerms(ASCIIToUTF16("lambs"));
+  ASSERT_EQ(1U, matches.size());
+  EXPECT_EQ(kHistoryID, matches[0].url_info.id());
 }
 
 class InMemoryURLIndexCacheTest : public testing::Test {
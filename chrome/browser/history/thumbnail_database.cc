@@ -39,8 +39,8 @@ static void FillIconMapping(const sql::Statement& statement,
 namespace history {
 
 // Version number of the database.
-static const int kCurrentVersionNumber = 5;
-static const int kCompatibleVersionNumber = 5;
+static const int kCurrentVersionNumber = 6;
+static const int kCompatibleVersionNumber = 6;
 
 // Use 90 quality (out of 100) which is pretty high, because we're very
 // sensitive to artifacts for these small sized, highly detailed images.
@@ -98,6 +98,7 @@ sql::InitStatus ThumbnailDatabase::Init(
   if (!meta_table_.Init(&db_, kCurrentVersionNumber,
                         kCompatibleVersionNumber) ||
       !InitThumbnailTable() ||
+      !blobs_.Init(&db_) ||
       !InitFaviconsTable(&db_, false) ||
       !InitFaviconsIndex() ||
       !InitIconMappingTable(&db_, false) ||
@@ -127,10 +128,17 @@ sql::InitStatus ThumbnailDatabase::Init(
   }
 
   if (cur_version == 4) {
+    ++cur_version;
     if (!UpgradeToVersion5())
       return CantUpgradeToVersion(cur_version);
   }
 
+  if (cur_version == 5) {
+    ++cur_version;
+    if (!UpgradeToVersion6())
+      return CantUpgradeToVersion(cur_version);
+  }
+
   LOG_IF(WARNING, cur_version < kCurrentVersionNumber) <<
       "Thumbnail database version " << cur_version << " is too old to handle.";
 
@@ -157,6 +165,10 @@ sql::InitStatus ThumbnailDatabase::OpenDatabase(sql::Connection* db,
   // database while we're running, and this will give somewhat improved perf.
   db->set_exclusive_locking();
 
+  // Favicons are written in bursts as pages load, so commit them by appending
+  // to a write-ahead log rather than syncing a journal and the database.
+  db->set_write_ahead_logging();
+
   if (!db->Open(db_name))
     return sql::INIT_FAILURE;
 
@@ -225,7 +237,10 @@ bool ThumbnailDatabase::InitFaviconsTable(sql::Connection* db,
                // Set the default icon_type as FAVICON to be consistent with
                // table upgrade in UpgradeToVersion4().
                "icon_type INTEGER DEFAULT 1,"
-               "sizes LONGVARCHAR)");
+               "sizes LONGVARCHAR,"
+               // The bitmap is in the image_blobs table, image_data is only
+               // set by versions before 6.
+               "blob_id INTEGER DEFAULT 0)");
     if (!db->Execute(sql.c_str()))
       return false;
   }
@@ -370,18 +385,25 @@ bool ThumbnailDatabase::SetFavicon(
     scoped_refptr<base::RefCountedMemory> icon_data,
     base::Time time) {
   DCHECK(icon_id);
-  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
-      "UPDATE favicons SET image_data=?, last_updated=? WHERE id=?"));
+  // Reference the new bitmap before releasing the old one, so that setting
+  // the same bitmap again does not delete and rewrite it.
+  ImageBlobID old_blob_id = GetFaviconBlobID(icon_id);
+  ImageBlobID blob_id = 0;
   if (icon_data->size()) {
-    statement.BindBlob(0, icon_data->front(),
-                       static_cast<int>(icon_data->size()));
-  } else {
-    statement.BindNull(0);
+    blob_id = blobs_.AddBlobReference(icon_data->front(), icon_data->size());
+    if (!blob_id)
+      return false;
   }
+
+  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
+      "UPDATE favicons SET blob_id=?, last_updated=? WHERE id=?"));
+  statement.BindInt64(0, blob_id);
   statement.BindInt64(1, time.ToTimeT());
   statement.BindInt64(2, icon_id);
+  if (!statement.Run())
+    return false;
 
-  return statement.Run();
+  return !old_blob_id || blobs_.ReleaseBlob(old_blob_id);
 }
 
 bool ThumbnailDatabase::SetFaviconLastUpdateTime(FaviconID icon_id,
@@ -420,7 +442,7 @@ bool ThumbnailDatabase::GetFavicon(
   DCHECK(icon_id);
 
   sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
-      "SELECT last_updated, image_data, url, icon_type "
+      "SELECT last_updated, blob_id, url, icon_type "
       "FROM favicons WHERE id=?"));
   statement.BindInt64(0, icon_id);
 
@@ -429,8 +451,9 @@ bool ThumbnailDatabase::GetFavicon(
 
   if (last_updated)
     *last_updated = base::Time::FromTimeT(statement.ColumnInt64(0));
-  if (statement.ColumnByteLength(1) > 0)
-    statement.ColumnBlobAsVector(1, png_icon_data);
+  ImageBlobID blob_id = statement.ColumnInt64(1);
+  if (blob_id)
+    blobs_.GetBlob(blob_id, png_icon_data);
   if (icon_url)
     *icon_url = GURL(statement.ColumnString(2));
   if (icon_type)
@@ -453,11 +476,14 @@ FaviconID ThumbnailDatabase::AddFavicon(const GURL& icon_url,
 }
 
 bool ThumbnailDatabase::DeleteFavicon(FaviconID id) {
+  ImageBlobID blob_id = GetFaviconBlobID(id);
   sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
       "DELETE FROM favicons WHERE id = ?"));
   statement.BindInt64(0, id);
 
-  return statement.Run();
+  if (!statement.Run())
+    return false;
+  return !blob_id || blobs_.ReleaseBlob(blob_id);
 }
 
 bool ThumbnailDatabase::GetIconMappingForPageURL(const GURL& page_url,
@@ -608,8 +634,8 @@ bool ThumbnailDatabase::CommitTemporaryIconMappingTable() {
 
 FaviconID ThumbnailDatabase::CopyToTemporaryFaviconTable(FaviconID source) {
   sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
-      "INSERT INTO temp_favicons (url, last_updated, image_data, icon_type)"
-      "SELECT url, last_updated, image_data, icon_type "
+      "INSERT INTO temp_favicons (url, last_updated, icon_type, blob_id)"
+      "SELECT url, last_updated, icon_type, blob_id "
       "FROM favicons WHERE id = ?"));
   statement.BindInt64(0, source);
 
@@ -629,6 +655,10 @@ bool ThumbnailDatabase::CommitTemporaryFaviconTable() {
   if (!db_.Execute("ALTER TABLE temp_favicons RENAME TO favicons"))
     return false;
 
+  // Only the copied favicons refer to bitmaps now, drop the others.
+  if (!blobs_.RecountReferences("favicons", "blob_id"))
+    return false;
+
   // The renamed table needs the index (the temporary table doesn't have one).
   return InitFaviconsIndex();
 }
@@ -644,7 +674,9 @@ bool ThumbnailDatabase::RenameAndDropThumbnails(const FilePath& old_db_file,
   if (OpenDatabase(&favicons, new_db_file) != sql::INIT_OK)
     return false;
 
-  if (!InitFaviconsTable(&favicons, false) ||
+  ImageBlobTable new_blobs;
+  if (!new_blobs.Init(&favicons) ||
+      !InitFaviconsTable(&favicons, false) ||
       !InitIconMappingTable(&favicons, false)) {
     favicons.Close();
     return false;
@@ -685,6 +717,12 @@ bool ThumbnailDatabase::RenameAndDropThumbnails(const FilePath& old_db_file,
     BeginTransaction();
     return false;
   }
+  if (!db_.Execute("INSERT OR REPLACE INTO new_favicons.image_blobs "
+                   "SELECT * FROM image_blobs")) {
+    DLOG(FATAL) << "Unable to copy favicon bitmaps.";
+    BeginTransaction();
+    return false;
+  }
 
   if (!db_.Execute("DETACH new_favicons")) {
     DLOG(FATAL) << "Unable to detach database.";
@@ -786,4 +824,58 @@ bool ThumbnailDatabase::UpgradeToVersion5() {
   return true;
 }
 
+bool ThumbnailDatabase::UpgradeToVersion6() {
+  if (!db_.Execute("ALTER TABLE favicons ADD blob_id INTEGER DEFAULT 0"))
+    return false;
+
+  std::vector<FaviconID> icon_ids;
+  {
+    sql::Statement statement(db_.GetUniqueStatement(
+        "SELECT id FROM favicons WHERE image_data IS NOT NULL"));
+    while (statement.Step())
+      icon_ids.push_back(statement.ColumnInt64(0));
+    if (!statement.Succeeded())
+      return false;
+  }
+
+  // Move the bitmaps one at a time, so that they are not all in memory.
+  for (size_t i = 0; i < icon_ids.size(); ++i) {
+    sql::Statement select_statement(db_.GetCachedStatement(SQL_FROM_HERE,
+        "SELECT image_data FROM favicons WHERE id=?"));
+    select_statement.BindInt64(0, icon_ids[i]);
+    std::vector<unsigned char> data;
+    if (!select_statement.Step())
+      return false;
+    select_statement.ColumnBlobAsVector(0, &data);
+    select_statement.Reset(true);
+
+    ImageBlobID blob_id = 0;
+    if (!data.empty()) {
+      blob_id = blobs_.AddBlobReference(&data[0], data.size());
+      if (!blob_id)
+        return false;
+    }
+
+    sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
+        "UPDATE favicons SET blob_id=?, image_data=NULL WHERE id=?"));
+    statement.BindInt64(0, blob_id);
+    statement.BindInt64(1, icon_ids[i]);
+    if (!statement.Run())
+      return false;
+  }
+
+  meta_table_.SetVersionNumber(6);
+  meta_table_.SetCompatibleVersionNumber(std::min(6, kCompatibleVersionNumber));
+  return true;
+}
+
+ImageBlobID ThumbnailDatabase::GetFaviconBlobID(FaviconID icon_id) {
+  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
+      "SELECT blob_id FROM favicons WHERE id=?"));
+  statement.BindInt64(0, icon_id);
+  if (!statement.Step())
+    return 0;
+  return statement.ColumnInt64(0);
+}
+
 }  // namespace history
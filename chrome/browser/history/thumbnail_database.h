@@ -11,6 +11,7 @@
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
 #include "chrome/browser/history/history_types.h"
+#include "chrome/browser/history/image_blob_table.h"
 #include "sql/connection.h"
 #include "sql/init_status.h"
 #include "sql/meta_table.h"
@@ -102,7 +103,7 @@ class ThumbnailDatabase {
 
   // Sets the bits for a favicon. This should be png encoded data.
   // The time indicates the access time, and is used to detect when the favicon
-  // should be refreshed.
+  // should be refreshed. Favicons with identical bits share their storage.
   bool SetFavicon(FaviconID icon_id,
                   scoped_refptr<base::RefCountedMemory> icon_data,
                   base::Time time);
@@ -258,6 +259,8 @@ class ThumbnailDatabase {
                            GetFaviconAfterMigrationToTopSites);
   FRIEND_TEST_ALL_PREFIXES(ThumbnailDatabaseTest, UpgradeToVersion4);
   FRIEND_TEST_ALL_PREFIXES(ThumbnailDatabaseTest, UpgradeToVersion5);
+  FRIEND_TEST_ALL_PREFIXES(ThumbnailDatabaseTest, UpgradeToVersion6);
+  FRIEND_TEST_ALL_PREFIXES(ThumbnailDatabaseTest, SharedFaviconData);
   FRIEND_TEST_ALL_PREFIXES(HistoryBackendTest, MigrationIconMapping);
 
   // Creates the thumbnail table, returning true if the table already exists
@@ -285,6 +288,14 @@ class ThumbnailDatabase {
   // Adds support for sizes in favicon table.
   bool UpgradeToVersion5();
 
+  // Moves the favicon bitmaps into the image_blobs table, storing each
+  // distinct bitmap once.
+  bool UpgradeToVersion6();
+
+  // Returns the ID of the blob holding the bitmap of the favicon |icon_id|,
+  // or 0 if it has none.
+  ImageBlobID GetFaviconBlobID(FaviconID icon_id);
+
   // Migrates the icon mapping data from URL database to Thumbnail database.
   // Return whether the migration succeeds.
   bool MigrateIconMappingData(URLDatabase* url_db);
@@ -319,6 +330,9 @@ class ThumbnailDatabase {
   sql::Connection db_;
   sql::MetaTable meta_table_;
 
+  // The bitmaps of the favicons, shared by the favicons with identical data.
+  ImageBlobTable blobs_;
+
   // This object is created and managed by the history backend. We maintain an
   // opaque pointer to the object for our use.
   // This can be NULL if there are no indexers registered to receive indexing
@@ -318,6 +318,89 @@ TEST_F(ThumbnailDatabaseTest, UpgradeToVersion5) {
   EXPECT_TRUE(db.db_.Execute(sql.c_str()));
 }
 
+TEST_F(ThumbnailDatabaseTest, UpgradeToVersion6) {
+  ThumbnailDatabase db;
+  ASSERT_EQ(sql::INIT_OK, db.Init(file_name_, NULL, NULL));
+  db.BeginTransaction();
+
+  ASSERT_TRUE(db.db_.Execute("DROP TABLE IF EXISTS favicons"));
+  ASSERT_TRUE(db.db_.Execute("CREATE TABLE favicons ("
+                             "id INTEGER PRIMARY KEY,"
+                             "url LONGVARCHAR NOT NULL,"
+                             "last_updated INTEGER DEFAULT 0,"
+                             "image_data BLOB,"
+                             "icon_type INTEGER DEFAULT 1,"
+                             "sizes LONGVARCHAR)"));
+  sql::Statement statement(db.db_.GetUniqueStatement(
+      "INSERT INTO favicons (url, image_data) VALUES (?, ?)"));
+  const char* kIconURLs[] = {
+    "http://google.com/favicon.ico",
+    "http://www.google.com/favicon.ico",
+    "http://yahoo.com/favicon.ico",
+  };
+  for (size_t i = 0; i < arraysize(kIconURLs); ++i) {
+    statement.BindString(0, kIconURLs[i]);
+    if (i < 2)
+      statement.BindBlob(1, blob1, sizeof(blob1));
+    ASSERT_TRUE(statement.Run());
+    statement.Reset(true);
+  }
+
+  ASSERT_TRUE(db.UpgradeToVersion6());
+
+  // The two identical icons share their bitmap, the third has none.
+  sql::Statement count_statement(db.db_.GetUniqueStatement(
+      "SELECT COUNT(*) FROM image_blobs"));
+  ASSERT_TRUE(count_statement.Step());
+  EXPECT_EQ(1, count_statement.ColumnInt(0));
+  EXPECT_EQ(db.GetFaviconBlobID(1), db.GetFaviconBlobID(2));
+  EXPECT_EQ(0, db.GetFaviconBlobID(3));
+
+  std::vector<unsigned char> favicon_out;
+  ASSERT_TRUE(db.GetFavicon(2, NULL, &favicon_out, NULL, NULL));
+  EXPECT_EQ(std::vector<unsigned char>(blob1, blob1 + sizeof(blob1)),
+            favicon_out);
+  favicon_out.clear();
+  ASSERT_TRUE(db.GetFavicon(3, NULL, &favicon_out, NULL, NULL));
+  EXPECT_TRUE(favicon_out.empty());
+}
+
+TEST_F(ThumbnailDatabaseTest, SharedFaviconData) {
+  ThumbnailDatabase db;
+  ASSERT_EQ(sql::INIT_OK, db.Init(file_name_, NULL, NULL));
+  db.BeginTransaction();
+
+  std::vector<unsigned char> data(blob1, blob1 + sizeof(blob1));
+  scoped_refptr<base::RefCountedBytes> favicon(new base::RefCountedBytes(data));
+  std::vector<unsigned char> data2(blob2, blob2 + sizeof(blob2));
+  scoped_refptr<base::RefCountedBytes> favicon2(
+      new base::RefCountedBytes(data2));
+
+  base::Time time = base::Time::Now();
+  FaviconID id1 = db.AddFavicon(GURL("http://google.com/favicon.ico"),
+                                FAVICON);
+  FaviconID id2 = db.AddFavicon(GURL("http://www.google.com/favicon.ico"),
+                                FAVICON);
+  ASSERT_TRUE(db.SetFavicon(id1, favicon, time));
+  ASSERT_TRUE(db.SetFavicon(id2, favicon, time));
+  EXPECT_EQ(db.GetFaviconBlobID(id1), db.GetFaviconBlobID(id2));
+
+  // Changing the bitmap of one icon leaves the other's intact.
+  ASSERT_TRUE(db.SetFavicon(id1, favicon2, time));
+  EXPECT_NE(db.GetFaviconBlobID(id1), db.GetFaviconBlobID(id2));
+  std::vector<unsigned char> favicon_out;
+  ASSERT_TRUE(db.GetFavicon(id2, NULL, &favicon_out, NULL, NULL));
+  EXPECT_EQ(data, favicon_out);
+
+  // Deleting the icons deletes their bitmaps.
+  ASSERT_TRUE(db.DeleteFavicon(id1));
+  ASSERT_TRUE(db.DeleteFavicon(id2));
+  sql::Statement count_statement(db.db_.GetUniqueStatement(
+      "SELECT COUNT(*) FROM image_blobs"));
+  ASSERT_TRUE(count_statement.Step());
+  EXPECT_EQ(0, count_statement.ColumnInt(0));
+}
+
 TEST_F(ThumbnailDatabaseTest, TemporayIconMapping) {
   ThumbnailDatabase db;
 
@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <vector>
+
 #include "base/file_util.h"
 #include "base/memory/ref_counted.h"
 #include "base/string_split.h"
@@ -16,8 +18,9 @@
 namespace history {
 
 // From the version 1 to 2, one column was added. Old versions of Chrome
-// should be able to read version 2 files just fine.
-static const int kVersionNumber = 2;
+// should be able to read version 2 files just fine. Version 3 moved the
+// thumbnails to the image_blobs table.
+static const int kVersionNumber = 3;
 
 TopSitesDatabase::TopSitesDatabase() : may_need_history_migration_(false) {
 }
@@ -62,7 +65,7 @@ bool TopSitesDatabase::Init(const FilePath& db_name) {
   if (!meta_table_.Init(db_.get(), kVersionNumber, kVersionNumber))
     return false;
 
-  if (!InitThumbnailTable())
+  if (!blobs_.Init(db_.get()) || !InitThumbnailTable())
     return false;
 
   if (meta_table_.GetVersionNumber() == 1) {
@@ -72,6 +75,13 @@ bool TopSitesDatabase::Init(const FilePath& db_name) {
     }
   }
 
+  if (meta_table_.GetVersionNumber() == 2) {
+    if (!UpgradeToVersion3()) {
+      LOG(WARNING) << "Unable to upgrade top sites database to version 3.";
+      return false;
+    }
+  }
+
   // Version check.
   if (meta_table_.GetVersionNumber() != kVersionNumber)
     return false;
@@ -95,7 +105,8 @@ bool TopSitesDatabase::InitThumbnailTable() {
                       "good_clipping INTEGER DEFAULT 0, "
                       "at_top INTEGER DEFAULT 0, "
                       "last_updated INTEGER DEFAULT 0, "
-                      "load_completed INTEGER DEFAULT 0) ")) {
+                      "load_completed INTEGER DEFAULT 0, "
+                      "blob_id INTEGER DEFAULT 0) ")) {
       LOG(WARNING) << db_->GetErrorMessage();
       return false;
     }
@@ -114,11 +125,59 @@ bool TopSitesDatabase::UpgradeToVersion2() {
   return true;
 }
 
+bool TopSitesDatabase::UpgradeToVersion3() {
+  if (!db_->Execute("ALTER TABLE thumbnails ADD blob_id INTEGER DEFAULT 0")) {
+    NOTREACHED();
+    return false;
+  }
+
+  std::vector<std::string> urls;
+  {
+    sql::Statement statement(db_->GetUniqueStatement(
+        "SELECT url FROM thumbnails WHERE thumbnail IS NOT NULL"));
+    while (statement.Step())
+      urls.push_back(statement.ColumnString(0));
+    if (!statement.Succeeded())
+      return false;
+  }
+
+  for (size_t i = 0; i < urls.size(); ++i) {
+    sql::Statement select_statement(db_->GetCachedStatement(
+        SQL_FROM_HERE,
+        "SELECT thumbnail FROM thumbnails WHERE url=?"));
+    select_statement.BindString(0, urls[i]);
+    std::vector<unsigned char> data;
+    if (!select_statement.Step())
+      return false;
+    select_statement.ColumnBlobAsVector(0, &data);
+    select_statement.Reset(true);
+
+    ImageBlobID blob_id = 0;
+    if (!data.empty()) {
+      blob_id = blobs_.AddBlobReference(&data[0], data.size());
+      if (!blob_id)
+        return false;
+    }
+
+    sql::Statement statement(db_->GetCachedStatement(
+        SQL_FROM_HERE,
+        "UPDATE thumbnails SET blob_id = ?, thumbnail = NULL WHERE url = ?"));
+    statement.BindInt64(0, blob_id);
+    statement.BindString(1, urls[i]);
+    if (!statement.Run())
+      return false;
+  }
+
+  meta_table_.SetVersionNumber(3);
+  meta_table_.SetCompatibleVersionNumber(3);
+  return true;
+}
+
 void TopSitesDatabase::GetPageThumbnails(MostVisitedURLList* urls,
                                          URLToImagesMap* thumbnails) {
   sql::Statement statement(db_->GetCachedStatement(
       SQL_FROM_HERE,
-      "SELECT url, url_rank, title, thumbnail, redirects, "
+      "SELECT url, url_rank, title, blob_id, redirects, "
       "boring_score, good_clipping, at_top, last_updated, load_completed "
       "FROM thumbnails ORDER BY url_rank "));
 
@@ -141,7 +200,9 @@ void TopSitesDatabase::GetPageThumbnails(MostVisitedURLList* urls,
     urls->push_back(url);
 
     std::vector<unsigned char> data;
-    statement.ColumnBlobAsVector(3, &data);
+    ImageBlobID blob_id = statement.ColumnInt64(3);
+    if (blob_id)
+      blobs_.GetBlob(blob_id, &data);
     Images thumbnail;
     if (!data.empty())
       thumbnail.thumbnail = base::RefCountedBytes::TakeVector(&data);
@@ -192,18 +253,20 @@ void TopSitesDatabase::SetPageThumbnail(const MostVisitedURL& url,
 
 bool TopSitesDatabase::UpdatePageThumbnail(
     const MostVisitedURL& url, const Images& thumbnail) {
+  // Reference the new thumbnail before releasing the old one, so that an
+  // unchanged thumbnail is not deleted and rewritten.
+  ImageBlobID old_blob_id = GetThumbnailBlobID(url.url);
+  ImageBlobID blob_id = AddThumbnailBlob(thumbnail);
+
   sql::Statement statement(db_->GetCachedStatement(
       SQL_FROM_HERE,
       "UPDATE thumbnails SET "
-      "title = ?, thumbnail = ?, redirects = ?, "
+      "title = ?, blob_id = ?, redirects = ?, "
       "boring_score = ?, good_clipping = ?, at_top = ?, last_updated = ?, "
       "load_completed = ? "
       "WHERE url = ? "));
   statement.BindString16(0, url.title);
-  if (thumbnail.thumbnail.get() && thumbnail.thumbnail->front()) {
-    statement.BindBlob(1, thumbnail.thumbnail->front(),
-                       static_cast<int>(thumbnail.thumbnail->size()));
-  }
+  statement.BindInt64(1, blob_id);
   statement.BindString(2, GetRedirects(url));
   const ThumbnailScore& score = thumbnail.thumbnail_score;
   statement.BindDouble(3, score.boring_score);
@@ -213,7 +276,9 @@ bool TopSitesDatabase::UpdatePageThumbnail(
   statement.BindBool(7, score.load_completed);
   statement.BindString(8, url.url.spec());
 
-  return statement.Run();
+  if (!statement.Run())
+    return false;
+  return !old_blob_id || blobs_.ReleaseBlob(old_blob_id);
 }
 
 void TopSitesDatabase::AddPageThumbnail(const MostVisitedURL& url,
@@ -221,19 +286,20 @@ void TopSitesDatabase::AddPageThumbnail(const MostVisitedURL& url,
                                             const Images& thumbnail) {
   int count = GetRowCount();
 
+  // The row replaced, if any, holds a reference to its thumbnail, which is
+  // released once the new row is in.
+  ImageBlobID old_blob_id = GetThumbnailBlobID(url.url);
+
   sql::Statement statement(db_->GetCachedStatement(
       SQL_FROM_HERE,
       "INSERT OR REPLACE INTO thumbnails "
-      "(url, url_rank, title, thumbnail, redirects, "
+      "(url, url_rank, title, blob_id, redirects, "
       "boring_score, good_clipping, at_top, last_updated, load_completed) "
       "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"));
   statement.BindString(0, url.url.spec());
   statement.BindInt(1, count);  // Make it the last url.
   statement.BindString16(2, url.title);
-  if (thumbnail.thumbnail.get() && thumbnail.thumbnail->front()) {
-    statement.BindBlob(3, thumbnail.thumbnail->front(),
-                       static_cast<int>(thumbnail.thumbnail->size()));
-  }
+  statement.BindInt64(3, AddThumbnailBlob(thumbnail));
   statement.BindString(4, GetRedirects(url));
   const ThumbnailScore& score = thumbnail.thumbnail_score;
   statement.BindDouble(5, score.boring_score);
@@ -243,6 +309,8 @@ void TopSitesDatabase::AddPageThumbnail(const MostVisitedURL& url,
   statement.BindBool(9, score.load_completed);
   if (!statement.Run())
     return;
+  if (old_blob_id)
+    blobs_.ReleaseBlob(old_blob_id);
 
   UpdatePageRankNoTransaction(url, new_rank);
 }
@@ -302,14 +370,16 @@ bool TopSitesDatabase::GetPageThumbnail(const GURL& url,
                                             Images* thumbnail) {
   sql::Statement statement(db_->GetCachedStatement(
       SQL_FROM_HERE,
-      "SELECT thumbnail, boring_score, good_clipping, at_top, last_updated "
+      "SELECT blob_id, boring_score, good_clipping, at_top, last_updated "
       "FROM thumbnails WHERE url=?"));
   statement.BindString(0, url.spec());
   if (!statement.Step())
     return false;
 
   std::vector<unsigned char> data;
-  statement.ColumnBlobAsVector(0, &data);
+  ImageBlobID blob_id = statement.ColumnInt64(0);
+  if (blob_id)
+    blobs_.GetBlob(blob_id, &data);
   thumbnail->thumbnail = base::RefCountedBytes::TakeVector(&data);
   thumbnail->thumbnail_score.boring_score = statement.ColumnDouble(1);
   thumbnail->thumbnail_score.good_clipping = statement.ColumnBool(2);
@@ -341,12 +411,31 @@ int TopSitesDatabase::GetURLRank(const MostVisitedURL& url) {
   return -1;
 }
 
+ImageBlobID TopSitesDatabase::GetThumbnailBlobID(const GURL& url) {
+  sql::Statement statement(db_->GetCachedStatement(
+      SQL_FROM_HERE,
+      "SELECT blob_id FROM thumbnails WHERE url=?"));
+  statement.BindString(0, url.spec());
+  if (!statement.Step())
+    return 0;
+  return statement.ColumnInt64(0);
+}
+
+ImageBlobID TopSitesDatabase::AddThumbnailBlob(const Images& thumbnail) {
+  if (!thumbnail.thumbnail.get() || !thumbnail.thumbnail->front())
+    return 0;
+  return blobs_.AddBlobReference(thumbnail.thumbnail->front(),
+                                 thumbnail.thumbnail->size());
+}
+
 // Remove the record for this URL. Returns true iff removed successfully.
 bool TopSitesDatabase::RemoveURL(const MostVisitedURL& url) {
   int old_rank = GetURLRank(url);
   if (old_rank < 0)
     return false;
 
+  ImageBlobID blob_id = GetThumbnailBlobID(url.url);
+
   sql::Transaction transaction(db_.get());
   transaction.Begin();
   // Decrement all following ranks.
@@ -368,6 +457,9 @@ bool TopSitesDatabase::RemoveURL(const MostVisitedURL& url) {
   if (!delete_statement.Run())
     return false;
 
+  if (blob_id && !blobs_.ReleaseBlob(blob_id))
+    return false;
+
   return transaction.Commit();
 }
 
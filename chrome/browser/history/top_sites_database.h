@@ -11,6 +11,7 @@
 
 #include "base/gtest_prod_util.h"
 #include "chrome/browser/history/history_types.h"
+#include "chrome/browser/history/image_blob_table.h"
 #include "chrome/browser/history/url_database.h"  // For DBCloseScoper.
 #include "sql/meta_table.h"
 
@@ -65,6 +66,9 @@ class TopSitesDatabase {
 
  private:
   FRIEND_TEST_ALL_PREFIXES(TopSitesDatabaseTest, UpgradeToVersion2);
+  FRIEND_TEST_ALL_PREFIXES(TopSitesDatabaseTest, UpgradeToVersion3);
+  FRIEND_TEST_ALL_PREFIXES(TopSitesDatabaseTest, SharedThumbnails);
+  FRIEND_TEST_ALL_PREFIXES(TopSitesDatabaseTest, ReplacedThumbnail);
 
   // Creates the thumbnail table, returning true if the table already exists
   // or was successfully created.
@@ -74,6 +78,10 @@ class TopSitesDatabase {
   // upgrade was successful.
   bool UpgradeToVersion2();
 
+  // Moves the thumbnails into the image_blobs table, storing each distinct
+  // thumbnail once. Returns true if the upgrade was successful.
+  bool UpgradeToVersion3();
+
   // Adds a new URL to the database.
   void AddPageThumbnail(const MostVisitedURL& url,
                         int new_rank,
@@ -93,6 +101,14 @@ class TopSitesDatabase {
   // Returns the number of URLs (rows) in the database.
   int GetRowCount();
 
+  // Returns the ID of the blob holding the thumbnail of |url|, or 0 if it has
+  // none.
+  ImageBlobID GetThumbnailBlobID(const GURL& url);
+
+  // Adds a reference to the blob holding |thumbnail|. Returns 0 if there is
+  // no thumbnail or it could not be stored.
+  ImageBlobID AddThumbnailBlob(const Images& thumbnail);
+
   sql::Connection* CreateDB(const FilePath& db_name);
 
   // Encodes redirects into a string.
@@ -104,6 +120,9 @@ class TopSitesDatabase {
   scoped_ptr<sql::Connection> db_;
   sql::MetaTable meta_table_;
 
+  // The thumbnails, shared by the URLs with identical ones.
+  ImageBlobTable blobs_;
+
   // See description above class.
   bool may_need_history_migration_;
 
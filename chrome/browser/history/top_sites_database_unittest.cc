@@ -2,10 +2,17 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "base/file_path.h"
 #include "base/file_util.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/scoped_temp_dir.h"
 #include "chrome/browser/history/top_sites_database.h"
+#include "sql/connection.h"
+#include "sql/statement.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace history {
@@ -18,6 +25,22 @@ class TopSitesDatabaseTest : public testing::Test {
     file_name_ = temp_dir_.path().AppendASCII("TestTopSites.db");
   }
 
+  // Returns the number of thumbnails stored in |db|.
+  static int BlobCount(sql::Connection* db) {
+    sql::Statement statement(db->GetUniqueStatement(
+        "SELECT COUNT(*) FROM image_blobs"));
+    EXPECT_TRUE(statement.Step());
+    return statement.ColumnInt(0);
+  }
+
+  // Returns a thumbnail holding |data|.
+  static Images MakeThumbnail(const std::string& data) {
+    Images thumbnail;
+    thumbnail.thumbnail = new base::RefCountedBytes(
+        std::vector<unsigned char>(data.begin(), data.end()));
+    return thumbnail;
+  }
+
   ScopedTempDir temp_dir_;
   FilePath file_name_;
 };
@@ -53,4 +76,88 @@ TEST_F(TopSitesDatabaseTest, UpgradeToVersion2) {
   ASSERT_TRUE(db.db_->DoesColumnExist("thumbnails", "load_completed"));
 }
 
+TEST_F(TopSitesDatabaseTest, UpgradeToVersion3) {
+  TopSitesDatabase db;
+  ASSERT_TRUE(db.Init(file_name_));
+
+  ASSERT_TRUE(db.db_->Execute("DROP TABLE IF EXISTS thumbnails"));
+  ASSERT_TRUE(db.db_->Execute("CREATE TABLE thumbnails ("
+                              "url LONGVARCHAR PRIMARY KEY,"
+                              "url_rank INTEGER ,"
+                              "title LONGVARCHAR,"
+                              "thumbnail BLOB,"
+                              "redirects LONGVARCHAR,"
+                              "boring_score DOUBLE DEFAULT 1.0, "
+                              "good_clipping INTEGER DEFAULT 0, "
+                              "at_top INTEGER DEFAULT 0, "
+                              "last_updated INTEGER DEFAULT 0, "
+                              "load_completed INTEGER DEFAULT 0)"));
+  ASSERT_TRUE(db.db_->Execute(
+      "INSERT INTO thumbnails (url, url_rank, thumbnail) VALUES "
+      "('http://google.com/', 0, X'0102'), "
+      "('http://www.google.com/', 1, X'0102')"));
+  db.meta_table_.SetVersionNumber(2);
+
+  ASSERT_TRUE(db.UpgradeToVersion3());
+  ASSERT_EQ(3, db.meta_table_.GetVersionNumber());
+  EXPECT_EQ(1, BlobCount(db.db_.get()));
+
+  Images thumbnail;
+  ASSERT_TRUE(db.GetPageThumbnail(GURL("http://www.google.com/"),
+                                  &thumbnail));
+  ASSERT_EQ(2U, thumbnail.thumbnail->size());
+  EXPECT_EQ(2, thumbnail.thumbnail->front()[1]);
+}
+
+TEST_F(TopSitesDatabaseTest, SharedThumbnails) {
+  TopSitesDatabase db;
+  ASSERT_TRUE(db.Init(file_name_));
+
+  MostVisitedURL url1;
+  url1.url = GURL("http://google.com/");
+  MostVisitedURL url2;
+  url2.url = GURL("http://www.google.com/");
+  db.SetPageThumbnail(url1, 0, MakeThumbnail("blank"));
+  db.SetPageThumbnail(url2, 1, MakeThumbnail("blank"));
+  EXPECT_EQ(1, BlobCount(db.db_.get()));
+
+  db.SetPageThumbnail(url1, 0, MakeThumbnail("google"));
+  EXPECT_EQ(2, BlobCount(db.db_.get()));
+
+  MostVisitedURLList urls;
+  std::map<GURL, Images> thumbnails;
+  db.GetPageThumbnails(&urls, &thumbnails);
+  ASSERT_EQ(2U, urls.size());
+  ASSERT_EQ(6U, thumbnails[url1.url].thumbnail->size());
+  ASSERT_EQ(5U, thumbnails[url2.url].thumbnail->size());
+
+  EXPECT_TRUE(db.RemoveURL(url1));
+  EXPECT_TRUE(db.RemoveURL(url2));
+  EXPECT_EQ(0, BlobCount(db.db_.get()));
+}
+
+// A thumbnail replaced by AddPageThumbnail() is released.
+TEST_F(TopSitesDatabaseTest, ReplacedThumbnail) {
+  TopSitesDatabase db;
+  ASSERT_TRUE(db.Init(file_name_));
+
+  MostVisitedURL url;
+  url.url = GURL("http://google.com/");
+  db.SetPageThumbnail(url, 0, MakeThumbnail("old"));
+  EXPECT_EQ(1, BlobCount(db.db_.get()));
+
+  db.AddPageThumbnail(url, 0, MakeThumbnail("new"));
+  EXPECT_EQ(1, BlobCount(db.db_.get()));
+
+  MostVisitedURLList urls;
+  std::map<GURL, Images> thumbnails;
+  db.GetPageThumbnails(&urls, &thumbnails);
+  ASSERT_EQ(1U, urls.size());
+  ASSERT_EQ(3U, thumbnails[url.url].thumbnail->size());
+  EXPECT_EQ('n', thumbnails[url.url].thumbnail->front()[0]);
+
+  EXPECT_TRUE(db.RemoveURL(url));
+  EXPECT_EQ(0, BlobCount(db.db_.get()));
+}
+
 }  // namespace history
@@ -11,6 +11,7 @@
 
 #include "base/i18n/case_conversion.h"
 #include "base/utf_string_conversions.h"
+#include "chrome/browser/history/history_database_util.h"
 #include "chrome/common/url_constants.h"
 #include "googleurl/src/gurl.h"
 #include "sql/statement.h"
@@ -198,6 +199,20 @@ bool URLDatabase::DeleteURLRow(URLID id) {
   return del_keyword_visit.Run();
 }
 
+bool URLDatabase::DeleteURLRows(const std::vector<URLID>& ids) {
+  if (!ExecuteForIdsInBatches(&GetDB(), "DELETE FROM urls WHERE id IN ", ids,
+                              std::string()))
+    return false;
+
+  // And delete any keyword visits.
+  if (!has_keyword_search_terms_)
+    return true;
+
+  return ExecuteForIdsInBatches(
+      &GetDB(), "DELETE FROM keyword_search_terms WHERE url_id IN ", ids,
+      std::string());
+}
+
 bool URLDatabase::CreateTemporaryURLTable() {
   return CreateURLTable(true);
 }
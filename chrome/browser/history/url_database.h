@@ -86,6 +86,10 @@ class URLDatabase {
   // the row existed and was deleted.
   bool DeleteURLRow(URLID id);
 
+  // Deletes the rows of all of |ids|, as DeleteURLRow does, in batches.
+  // Returns false if the database could not be changed.
+  bool DeleteURLRows(const std::vector<URLID>& ids);
+
   // URL mass-deleting ---------------------------------------------------------
 
   // Begins the mass-deleting operation by creating a temporary URL table.
@@ -7,6 +7,7 @@
 #include "base/path_service.h"
 #include "base/scoped_temp_dir.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "chrome/browser/history/url_database.h"
 #include "sql/connection.h"
@@ -184,6 +185,31 @@ TEST_F(URLDatabaseTest, DeleteURLDeletesKeywordSearchTermVisit) {
   ASSERT_EQ(0U, matches.size());
 }
 
+// Make sure deleting URLs in a batch deletes their keyword visits too, and
+// leaves the other URLs.
+TEST_F(URLDatabaseTest, DeleteURLRows) {
+  std::vector<URLID> url_ids;
+  for (int i = 0; i < 3; i++) {
+    URLRow url_info(GURL(base::StringPrintf("http://www.google.com/%d", i)));
+    URLID url_id = AddURL(url_info);
+    ASSERT_TRUE(url_id != 0);
+    ASSERT_TRUE(SetKeywordSearchTermsForURL(url_id, 1, UTF8ToUTF16("visit")));
+    url_ids.push_back(url_id);
+  }
+  URLID kept_url_id = url_ids.back();
+  url_ids.pop_back();
+
+  ASSERT_TRUE(DeleteURLRows(url_ids));
+
+  URLRow row;
+  EXPECT_FALSE(GetURLRow(url_ids[0], &row));
+  EXPECT_FALSE(GetURLRow(url_ids[1], &row));
+  EXPECT_TRUE(GetURLRow(kept_url_id, &row));
+  std::vector<KeywordSearchTermVisit> matches;
+  GetMostRecentKeywordSearchTerms(1, UTF8ToUTF16("visit"), 10, &matches);
+  ASSERT_EQ(1U, matches.size());
+}
+
 TEST_F(URLDatabaseTest, EnumeratorForSignificant) {
   std::set<std::string> good_urls;
   // Add URLs which do and don't meet the criteria.
@@ -0,0 +1,529 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/url_index_cache_file.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/file_path.h"
+#include "base/logging.h"
+#include "googleurl/src/gurl.h"
+
+namespace history {
+
+namespace {
+
+// "HQPI", the first four bytes of the file. Caches of older versions are
+// protobufs, which start with the tag of their first field instead.
+const uint32 kFileSignature = 0x49505148;
+
+// Alignment of the arrays within the file.
+const uint32 kSectionAlignment = 8;
+
+// The arrays of the file, in the order in which they are written.
+enum Section {
+  // uint32[word_count + 1]: where each word starts in the word characters.
+  SECTION_WORD_OFFSETS,
+  // char16[]: the characters of all words, which are sorted.
+  SECTION_WORD_CHARS,
+  // char16[char_count]: each character occurring in the words, sorted.
+  SECTION_CHARS,
+  // uint32[char_count + 1]: where the word list of each character starts.
+  SECTION_CHAR_WORD_OFFSETS,
+  // uint32[]: the sorted IDs of the words containing each character.
+  SECTION_CHAR_WORDS,
+  // uint32[word_count + 1]: where the history ID list of each word starts.
+  SECTION_WORD_HISTORY_OFFSETS,
+  // uint8[]: the sorted IDs of the history items containing each word, as
+  // varints of the differences between consecutive IDs. The first ID of each
+  // list is the difference from zero.
+  SECTION_WORD_HISTORY_IDS,
+  // Item[item_count]: the history items, sorted by HistoryID.
+  SECTION_ITEMS,
+  // char[]: the URLs of the items.
+  SECTION_URL_CHARS,
+  // char16[]: the titles of the items.
+  SECTION_TITLE_CHARS,
+  // uint32[]: the word starts of the items.
+  SECTION_WORD_STARTS,
+  SECTION_COUNT
+};
+
+struct SectionHeader {
+  uint32 offset;
+  uint32 count;  // In elements.
+};
+
+struct FileHeader {
+  uint32 signature;
+  uint32 version;
+  uint32 length;
+  uint32 word_count;
+  uint32 char_count;
+  uint32 item_count;
+  SectionHeader sections[SECTION_COUNT];
+};
+
+// Compares Items with HistoryIDs.
+struct ItemHistoryIDLess {
+  bool operator()(const URLIndexCacheFile::Item& item, HistoryID id) const {
+    return item.history_id < id;
+  }
+};
+
+// Appends |value| to |bytes| as a varint: seven bits per byte, lowest first,
+// with the top bit set on all but the last byte.
+void AppendVarint(uint64 value, std::vector<uint8>* bytes) {
+  while (value >= 0x80) {
+    bytes->push_back(static_cast<uint8>(value) | 0x80);
+    value >>= 7;
+  }
+  bytes->push_back(static_cast<uint8>(value));
+}
+
+// Reads a varint at |*position|, which is advanced past it. Returns false if
+// the varint does not end before |end| or is too long.
+bool ReadVarint(const uint8** position, const uint8* end, uint64* value) {
+  *value = 0;
+  for (int shift = 0; *position < end && shift < 64; shift += 7) {
+    uint8 byte = *(*position)++;
+    *value |= static_cast<uint64>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+// Builds the contents of a file in memory.
+class FileBuilder {
+ public:
+  FileBuilder() : data_(sizeof(FileHeader), 0) {}
+
+  // Appends |count| elements at |elements| as |section|.
+  template <typename T>
+  void AddSection(Section section, const T* elements, size_t count) {
+    data_.resize((data_.size() + kSectionAlignment - 1) &
+                 ~(kSectionAlignment - 1));
+    header()->sections[section].offset = data_.size();
+    header()->sections[section].count = count;
+    const char* bytes = reinterpret_cast<const char*>(elements);
+    data_.insert(data_.end(), bytes, bytes + count * sizeof(T));
+  }
+
+  template <typename T>
+  void AddSection(Section section, const std::vector<T>& elements) {
+    AddSection(section, elements.empty() ? NULL : &elements[0],
+               elements.size());
+  }
+
+  FileHeader* header() { return reinterpret_cast<FileHeader*>(&data_[0]); }
+  const std::vector<char>& data() const { return data_; }
+
+ private:
+  std::vector<char> data_;
+};
+
+}  // namespace
+
+URLIndexCacheFile::ItemContents::ItemContents()
+    : history_id(0),
+      visit_count(0),
+      typed_count(0) {
+}
+
+URLIndexCacheFile::ItemContents::~ItemContents() {}
+
+URLIndexCacheFile::URLIndexCacheFile()
+    : data_(NULL),
+      length_(0),
+      word_offsets_(NULL),
+      word_chars_(NULL),
+      word_chars_count_(0),
+      chars_(NULL),
+      char_word_offsets_(NULL),
+      char_words_(NULL),
+      char_words_count_(0),
+      word_history_offsets_(NULL),
+      word_history_ids_(NULL),
+      word_history_ids_length_(0),
+      items_(NULL),
+      url_chars_(NULL),
+      url_chars_count_(0),
+      title_chars_(NULL),
+      title_chars_count_(0),
+      word_starts_(NULL),
+      word_starts_count_(0),
+      word_count_(0),
+      char_count_(0),
+      item_count_(0) {
+}
+
+URLIndexCacheFile::~URLIndexCacheFile() {}
+
+// static
+scoped_refptr<URLIndexCacheFile> URLIndexCacheFile::Open(
+    const FilePath& path) {
+  scoped_refptr<URLIndexCacheFile> file(new URLIndexCacheFile);
+#if defined(OS_WIN)
+  if (!file_util::ReadFileToString(path, &file->contents_) ||
+      file->contents_.empty())
+    return NULL;
+  file->data_ = reinterpret_cast<const uint8*>(file->contents_.data());
+  file->length_ = file->contents_.size();
+#else
+  if (!file->mapped_file_.Initialize(path))
+    return NULL;
+  file->data_ = file->mapped_file_.data();
+  file->length_ = file->mapped_file_.length();
+#endif
+  if (!file->Init())
+    return NULL;
+  return file;
+}
+
+// static
+bool URLIndexCacheFile::Write(const FilePath& path,
+                              const WordHistoryMap& words,
+                              const ItemContentsVector& items) {
+  std::vector<uint32> word_offsets;
+  string16 word_chars;
+  std::map<char16, std::vector<uint32> > char_words;
+  std::vector<uint32> word_history_offsets;
+  std::vector<uint8> word_history_ids;
+  for (WordHistoryMap::const_iterator iter = words.begin();
+       iter != words.end(); ++iter) {
+    uint32 word_id = word_offsets.size();
+    word_offsets.push_back(word_chars.size());
+    word_chars.append(iter->first);
+    Char16Set chars(Char16SetFromString16(iter->first));
+    for (Char16Set::const_iterator c = chars.begin(); c != chars.end(); ++c)
+      char_words[*c].push_back(word_id);
+    word_history_offsets.push_back(word_history_ids.size());
+    HistoryID previous_id = 0;
+    for (HistoryIDSet::const_iterator id_iter = iter->second.begin();
+         id_iter != iter->second.end(); ++id_iter) {
+      DCHECK_GE(*id_iter, previous_id);
+      AppendVarint(*id_iter - previous_id, &word_history_ids);
+      previous_id = *id_iter;
+    }
+  }
+  word_offsets.push_back(word_chars.size());
+  word_history_offsets.push_back(word_history_ids.size());
+
+  std::vector<char16> chars;
+  std::vector<uint32> char_word_offsets;
+  std::vector<uint32> char_word_ids;
+  for (std::map<char16, std::vector<uint32> >::const_iterator iter =
+       char_words.begin(); iter != char_words.end(); ++iter) {
+    chars.push_back(iter->first);
+    char_word_offsets.push_back(char_word_ids.size());
+    char_word_ids.insert(char_word_ids.end(), iter->second.begin(),
+                         iter->second.end());
+  }
+  char_word_offsets.push_back(char_word_ids.size());
+
+  std::vector<Item> file_items;
+  std::string url_chars;
+  string16 title_chars;
+  std::vector<uint32> word_starts;
+  for (ItemContentsVector::const_iterator iter = items.begin();
+       iter != items.end(); ++iter) {
+    DCHECK(file_items.empty() ||
+           file_items.back().history_id < iter->history_id);
+    Item item;
+    memset(&item, 0, sizeof(item));
+    item.history_id = iter->history_id;
+    item.last_visit = iter->last_visit.ToInternalValue();
+    item.visit_count = iter->visit_count;
+    item.typed_count = iter->typed_count;
+    item.url_offset = url_chars.size();
+    item.url_length = iter->url.size();
+    url_chars.append(iter->url);
+    item.title_offset = title_chars.size();
+    item.title_length = iter->title.size();
+    title_chars.append(iter->title);
+    // Word starts are only collected within the first kMaxSignificantChars.
+    const WordStarts& url_starts(iter->word_starts.url_word_starts_);
+    const WordStarts& title_starts(iter->word_starts.title_word_starts_);
+    DCHECK_LE(url_starts.size(), kuint16max);
+    DCHECK_LE(title_starts.size(), kuint16max);
+    item.word_starts_offset = word_starts.size();
+    item.url_word_starts_count = url_starts.size();
+    item.title_word_starts_count = title_starts.size();
+    word_starts.insert(word_starts.end(), url_starts.begin(),
+                       url_starts.end());
+    word_starts.insert(word_starts.end(), title_starts.begin(),
+                       title_starts.end());
+    file_items.push_back(item);
+  }
+
+  FileBuilder builder;
+  builder.AddSection(SECTION_WORD_OFFSETS, word_offsets);
+  builder.AddSection(SECTION_WORD_CHARS, word_chars.data(), word_chars.size());
+  builder.AddSection(SECTION_CHARS, chars);
+  builder.AddSection(SECTION_CHAR_WORD_OFFSETS, char_word_offsets);
+  builder.AddSection(SECTION_CHAR_WORDS, char_word_ids);
+  builder.AddSection(SECTION_WORD_HISTORY_OFFSETS, word_history_offsets);
+  builder.AddSection(SECTION_WORD_HISTORY_IDS, word_history_ids);
+  builder.AddSection(SECTION_ITEMS, file_items);
+  builder.AddSection(SECTION_URL_CHARS, url_chars.data(), url_chars.size());
+  builder.AddSection(SECTION_TITLE_CHARS, title_chars.data(),
+                     title_chars.size());
+  builder.AddSection(SECTION_WORD_STARTS, word_starts);
+
+  FileHeader* header = builder.header();
+  header->signature = kFileSignature;
+  header->version = kCurrentCacheFileVersion;
+  header->length = builder.data().size();
+  header->word_count = words.size();
+  header->char_count = chars.size();
+  header->item_count = file_items.size();
+
+  const std::vector<char>& data(builder.data());
+  int size = data.size();
+  FilePath temp_path(path.AddExtension(FILE_PATH_LITERAL("tmp")));
+  if (file_util::WriteFile(temp_path, &data[0], size) != size) {
+    file_util::Delete(temp_path, false);
+    return false;
+  }
+  if (!file_util::ReplaceFile(temp_path, path)) {
+    file_util::Delete(temp_path, false);
+    return false;
+  }
+  return true;
+}
+
+bool URLIndexCacheFile::Init() {
+  if (length_ < sizeof(FileHeader))
+    return false;
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(data_);
+  if (header->signature != kFileSignature ||
+      header->version != static_cast<uint32>(kCurrentCacheFileVersion) ||
+      header->length != length_)
+    return false;
+  word_count_ = header->word_count;
+  char_count_ = header->char_count;
+  item_count_ = header->item_count;
+
+  size_t count = 0;
+  word_offsets_ = GetSection<uint32>(SECTION_WORD_OFFSETS, &count);
+  if (!word_offsets_ || count != word_count_ + 1)
+    return false;
+  word_chars_ = GetSection<char16>(SECTION_WORD_CHARS, &word_chars_count_);
+  chars_ = GetSection<char16>(SECTION_CHARS, &count);
+  if (!word_chars_ || !chars_ || count != char_count_)
+    return false;
+  char_word_offsets_ = GetSection<uint32>(SECTION_CHAR_WORD_OFFSETS, &count);
+  if (!char_word_offsets_ || count != char_count_ + 1)
+    return false;
+  char_words_ = GetSection<uint32>(SECTION_CHAR_WORDS, &char_words_count_);
+  word_history_offsets_ =
+      GetSection<uint32>(SECTION_WORD_HISTORY_OFFSETS, &count);
+  if (!char_words_ || !word_history_offsets_ || count != word_count_ + 1)
+    return false;
+  word_history_ids_ = GetSection<uint8>(SECTION_WORD_HISTORY_IDS,
+                                        &word_history_ids_length_);
+  items_ = GetSection<Item>(SECTION_ITEMS, &count);
+  if (!word_history_ids_ || !items_ || count != item_count_)
+    return false;
+  url_chars_ = GetSection<char>(SECTION_URL_CHARS, &url_chars_count_);
+  title_chars_ = GetSection<char16>(SECTION_TITLE_CHARS, &title_chars_count_);
+  word_starts_ = GetSection<uint32>(SECTION_WORD_STARTS, &word_starts_count_);
+  return url_chars_ && title_chars_ && word_starts_;
+}
+
+template <typename T>
+const T* URLIndexCacheFile::GetSection(int section, size_t* count) const {
+  const FileHeader* header = reinterpret_cast<const FileHeader*>(data_);
+  const SectionHeader& section_header(header->sections[section]);
+  size_t offset = section_header.offset;
+  if (offset % kSectionAlignment != 0 || offset > length_ ||
+      section_header.count > (length_ - offset) / sizeof(T))
+    return NULL;
+  *count = section_header.count;
+  return reinterpret_cast<const T*>(data_ + offset);
+}
+
+// static
+bool URLIndexCacheFile::GetRange(const uint32* offsets,
+                                 size_t index,
+                                 size_t length,
+                                 size_t* begin,
+                                 size_t* end) {
+  *begin = offsets[index];
+  *end = offsets[index + 1];
+  if (*begin <= *end && *end <= length)
+    return true;
+  *begin = *end = 0;
+  return false;
+}
+
+const char16* URLIndexCacheFile::GetWordChars(WordID word_id,
+                                              size_t* length) const {
+  DCHECK_LT(word_id, word_count_);
+  size_t begin, end;
+  GetRange(word_offsets_, word_id, word_chars_count_, &begin, &end);
+  *length = end - begin;
+  return word_chars_ + begin;
+}
+
+string16 URLIndexCacheFile::GetWord(WordID word_id) const {
+  size_t length = 0;
+  const char16* chars = GetWordChars(word_id, &length);
+  return string16(chars, length);
+}
+
+bool URLIndexCacheFile::WordContains(WordID word_id,
+                                     const string16& term) const {
+  size_t length = 0;
+  const char16* chars = GetWordChars(word_id, &length);
+  return std::search(chars, chars + length, term.begin(), term.end()) !=
+      chars + length;
+}
+
+bool URLIndexCacheFile::FindWord(const string16& word, WordID* word_id) const {
+  // Binary search on the sorted words.
+  size_t low = 0;
+  size_t high = word_count_;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    size_t length = 0;
+    const char16* chars = GetWordChars(middle, &length);
+    if (std::lexicographical_compare(chars, chars + length,
+                                     word.begin(), word.end()))
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  if (low == word_count_ || GetWord(low) != word)
+    return false;
+  *word_id = low;
+  return true;
+}
+
+WordIDSet URLIndexCacheFile::WordIDSetForTermChars(
+    const Char16Set& term_chars) const {
+  // Look up the word list of each character, then intersect them starting
+  // with the shortest.
+  std::vector<std::pair<size_t, size_t> > ranges;
+  for (Char16Set::const_iterator c_iter = term_chars.begin();
+       c_iter != term_chars.end(); ++c_iter) {
+    const char16* pos = std::lower_bound(chars_, chars_ + char_count_,
+                                         *c_iter);
+    if (pos == chars_ + char_count_ || *pos != *c_iter)
+      return WordIDSet();  // A character was not found: bail.
+    size_t begin, end;
+    if (!GetRange(char_word_offsets_, pos - chars_, char_words_count_,
+                  &begin, &end) || begin == end)
+      return WordIDSet();
+    ranges.push_back(std::make_pair(end - begin, begin));
+  }
+  if (ranges.empty())
+    return WordIDSet();
+  std::sort(ranges.begin(), ranges.end());
+
+  const uint32* first = char_words_ + ranges[0].second;
+  std::vector<uint32> word_ids(first, first + ranges[0].first);
+  for (size_t i = 1; i < ranges.size() && !word_ids.empty(); ++i) {
+    const uint32* words = char_words_ + ranges[i].second;
+    std::vector<uint32>::iterator end =
+        std::set_intersection(word_ids.begin(), word_ids.end(),
+                              words, words + ranges[i].first,
+                              word_ids.begin());
+    word_ids.erase(end, word_ids.end());
+  }
+
+  WordIDSet word_id_set;
+  for (std::vector<uint32>::const_iterator iter = word_ids.begin();
+       iter != word_ids.end(); ++iter) {
+    if (*iter < word_count_)
+      word_id_set.insert(word_id_set.end(), *iter);
+  }
+  return word_id_set;
+}
+
+void URLIndexCacheFile::AppendHistoryIDs(WordID word_id,
+                                         HistoryIDVector* history_ids) const {
+  DCHECK_LT(word_id, word_count_);
+  size_t begin, end;
+  GetRange(word_history_offsets_, word_id, word_history_ids_length_,
+           &begin, &end);
+  const uint8* position = word_history_ids_ + begin;
+  const uint8* list_end = word_history_ids_ + end;
+  HistoryID history_id = 0;
+  uint64 delta = 0;
+  while (position < list_end && ReadVarint(&position, list_end, &delta)) {
+    history_id += delta;
+    history_ids->push_back(history_id);
+  }
+}
+
+const URLIndexCacheFile::Item& URLIndexCacheFile::GetItem(size_t index) const {
+  DCHECK_LT(index, item_count_);
+  return items_[index];
+}
+
+const URLIndexCacheFile::Item* URLIndexCacheFile::FindItem(
+    HistoryID history_id) const {
+  const Item* end = items_ + item_count_;
+  const Item* item = std::lower_bound(items_, end, history_id,
+                                      ItemHistoryIDLess());
+  if (item == end || item->history_id != history_id)
+    return NULL;
+  return item;
+}
+
+std::string URLIndexCacheFile::GetURL(const Item& item) const {
+  if (item.url_offset > url_chars_count_ ||
+      item.url_length > url_chars_count_ - item.url_offset)
+    return std::string();
+  return std::string(url_chars_ + item.url_offset, item.url_length);
+}
+
+string16 URLIndexCacheFile::GetTitle(const Item& item) const {
+  if (item.title_offset > title_chars_count_ ||
+      item.title_length > title_chars_count_ - item.title_offset)
+    return string16();
+  return string16(title_chars_ + item.title_offset, item.title_length);
+}
+
+RowWordStarts URLIndexCacheFile::GetWordStarts(const Item& item) const {
+  RowWordStarts word_starts;
+  size_t count = item.url_word_starts_count + item.title_word_starts_count;
+  if (item.word_starts_offset > word_starts_count_ ||
+      count > word_starts_count_ - item.word_starts_offset)
+    return word_starts;
+  const uint32* url_starts = word_starts_ + item.word_starts_offset;
+  const uint32* title_starts = url_starts + item.url_word_starts_count;
+  word_starts.url_word_starts_.assign(url_starts, title_starts);
+  word_starts.title_word_starts_.assign(
+      title_starts, title_starts + item.title_word_starts_count);
+  return word_starts;
+}
+
+URLRow URLIndexCacheFile::GetRow(const Item& item) const {
+  URLRow row(GURL(GetURL(item)), item.history_id);
+  row.set_visit_count(item.visit_count);
+  row.set_typed_count(item.typed_count);
+  row.set_last_visit(base::Time::FromInternalValue(item.last_visit));
+  row.set_title(GetTitle(item));
+  return row;
+}
+
+URLIndexCacheFile::ItemContents URLIndexCacheFile::GetItemContents(
+    const Item& item) const {
+  ItemContents contents;
+  contents.history_id = item.history_id;
+  contents.visit_count = item.visit_count;
+  contents.typed_count = item.typed_count;
+  contents.last_visit = base::Time::FromInternalValue(item.last_visit);
+  contents.url = GetURL(item);
+  contents.title = GetTitle(item);
+  contents.word_starts = GetWordStarts(item);
+  return contents;
+}
+
+}  // namespace history
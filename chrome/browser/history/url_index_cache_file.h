@@ -0,0 +1,189 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_URL_INDEX_CACHE_FILE_H_
+#define CHROME_BROWSER_HISTORY_URL_INDEX_CACHE_FILE_H_
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/string16.h"
+#include "base/time.h"
+#include "chrome/browser/history/in_memory_url_index_types.h"
+
+class FilePath;
+
+namespace history {
+
+// Current version of the cache file. Older versions were protobufs, which are
+// still read but no longer written.
+static const int kCurrentCacheFileVersion = 3;
+
+// The InMemoryURLIndex cache file, laid out so that it can be searched in
+// place once it has been mapped into memory.
+//
+// The file is a header followed by flat arrays:
+//  - The indexed words, sorted. A word is identified by its position in this
+//    list, which is also the WordID used for it in this file.
+//  - For each character, the sorted IDs of the words containing it.
+//  - For each word, the sorted IDs of the history items containing it, each
+//    stored as a varint of its difference from the previous one.
+//  - The history items, sorted by HistoryID, with their URL, title and word
+//    starts.
+//
+// Nothing is parsed or copied when the file is opened: the data is paged in
+// as searches touch it. The offsets within the file are only checked when
+// they are used, so a corrupt file yields wrong results rather than crashes.
+class URLIndexCacheFile : public base::RefCountedThreadSafe<URLIndexCacheFile> {
+ public:
+  // A history item, as stored in the file.
+  struct Item {
+    HistoryID history_id;
+    int64 last_visit;  // Internal value of the base::Time.
+    int32 visit_count;
+    int32 typed_count;
+    uint32 url_offset;  // Into the URL characters, which are UTF-8.
+    uint32 url_length;
+    uint32 title_offset;  // Into the title characters, which are UTF-16.
+    uint32 title_length;
+    uint32 word_starts_offset;  // The URL word starts then the title's.
+    uint16 url_word_starts_count;
+    uint16 title_word_starts_count;
+  };
+
+  // The contents of a history item to be written to a cache file.
+  struct ItemContents {
+    ItemContents();
+    ~ItemContents();
+
+    HistoryID history_id;
+    int visit_count;
+    int typed_count;
+    base::Time last_visit;
+    std::string url;
+    string16 title;
+    RowWordStarts word_starts;
+  };
+  typedef std::vector<ItemContents> ItemContentsVector;
+
+  // A map from each indexed word to the history items containing it.
+  typedef std::map<string16, HistoryIDSet> WordHistoryMap;
+
+  // Maps the cache file at |path|. Returns NULL if the file can not be read
+  // or is not in this format, such as the caches written by older versions.
+  static scoped_refptr<URLIndexCacheFile> Open(const FilePath& path);
+
+  // Writes a cache file of |words| and |items| to |path|. |items| must be
+  // sorted by HistoryID. The file is written next to |path| and then moved
+  // in place, so that a file which is currently open stays intact.
+  static bool Write(const FilePath& path,
+                    const WordHistoryMap& words,
+                    const ItemContentsVector& items);
+
+  size_t word_count() const { return word_count_; }
+  size_t char_count() const { return char_count_; }
+  size_t item_count() const { return item_count_; }
+  size_t file_length() const { return length_; }
+
+  // Returns the word |word_id|.
+  string16 GetWord(WordID word_id) const;
+
+  // Returns true if the word |word_id| contains |term|.
+  bool WordContains(WordID word_id, const string16& term) const;
+
+  // Finds the ID of |word|. Returns false if it is not indexed.
+  bool FindWord(const string16& word, WordID* word_id) const;
+
+  // Returns the words which contain all of |term_chars|.
+  WordIDSet WordIDSetForTermChars(const Char16Set& term_chars) const;
+
+  // Appends the sorted IDs of the history items which contain the word
+  // |word_id| to |history_ids|.
+  void AppendHistoryIDs(WordID word_id, HistoryIDVector* history_ids) const;
+
+  // Returns the item |index|, in the order of their HistoryIDs.
+  const Item& GetItem(size_t index) const;
+
+  // Finds the item of |history_id|. Returns NULL if there is none.
+  const Item* FindItem(HistoryID history_id) const;
+
+  // Accessors for the variable-length parts of |item|.
+  std::string GetURL(const Item& item) const;
+  string16 GetTitle(const Item& item) const;
+  RowWordStarts GetWordStarts(const Item& item) const;
+
+  // Returns |item| as a URLRow, in the form URLIndexPrivateData indexes them.
+  URLRow GetRow(const Item& item) const;
+
+  // Returns the contents of |item| for writing them to another file.
+  ItemContents GetItemContents(const Item& item) const;
+
+ private:
+  friend class base::RefCountedThreadSafe<URLIndexCacheFile>;
+
+  URLIndexCacheFile();
+  ~URLIndexCacheFile();
+
+  // Checks the header of the mapped file and locates the arrays.
+  bool Init();
+
+  // Returns the array |section| of the file and its length in elements.
+  template <typename T>
+  const T* GetSection(int section, size_t* count) const;
+
+  // Sets |begin| and |end| to the range of |offsets| entry |index| covers
+  // within an array of |length| elements. Returns false if it is corrupt.
+  static bool GetRange(const uint32* offsets,
+                       size_t index,
+                       size_t length,
+                       size_t* begin,
+                       size_t* end);
+
+  // Returns the characters of the word |word_id| and their count.
+  const char16* GetWordChars(WordID word_id, size_t* length) const;
+
+#if defined(OS_WIN)
+  // Windows can not replace a file while it is mapped, and the cache file is
+  // rewritten while the index still uses it, so it is read instead.
+  std::string contents_;
+#else
+  file_util::MemoryMappedFile mapped_file_;
+#endif
+  const uint8* data_;
+  size_t length_;
+
+  // The arrays of the file. See the .cc for their layout.
+  const uint32* word_offsets_;
+  const char16* word_chars_;
+  size_t word_chars_count_;
+  const char16* chars_;
+  const uint32* char_word_offsets_;
+  const uint32* char_words_;
+  size_t char_words_count_;
+  const uint32* word_history_offsets_;
+  const uint8* word_history_ids_;
+  size_t word_history_ids_length_;
+  const Item* items_;
+  const char* url_chars_;
+  size_t url_chars_count_;
+  const char16* title_chars_;
+  size_t title_chars_count_;
+  const uint32* word_starts_;
+  size_t word_starts_count_;
+
+  size_t word_count_;
+  size_t char_count_;
+  size_t item_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(URLIndexCacheFile);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_URL_INDEX_CACHE_FILE_H_
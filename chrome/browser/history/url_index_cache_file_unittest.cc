@@ -0,0 +1,214 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/browser/history/url_index_cache_file.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace history {
+
+class URLIndexCacheFileTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("History Provider Cache");
+  }
+
+  // Adds the history item |history_id| to |items_|, and to the entries of
+  // |words_| for the words given in |words|, separated by spaces.
+  void AddItem(HistoryID history_id,
+               const char* url,
+               const char* title,
+               const char* words) {
+    URLIndexCacheFile::ItemContents item;
+    item.history_id = history_id;
+    item.visit_count = 2;
+    item.typed_count = 1;
+    item.last_visit = base::Time::FromInternalValue(history_id * 1000);
+    item.url = url;
+    item.title = ASCIIToUTF16(title);
+    item.word_starts.url_word_starts_.push_back(0);
+    item.word_starts.url_word_starts_.push_back(7);
+    item.word_starts.title_word_starts_.push_back(0);
+    items_.push_back(item);
+
+    std::string word_string(words);
+    size_t begin = 0;
+    while (begin < word_string.length()) {
+      size_t end = word_string.find(' ', begin);
+      if (end == std::string::npos)
+        end = word_string.length();
+      words_[ASCIIToUTF16(word_string.substr(begin, end - begin))].insert(
+          history_id);
+      begin = end + 1;
+    }
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  URLIndexCacheFile::WordHistoryMap words_;
+  URLIndexCacheFile::ItemContentsVector items_;
+};
+
+TEST_F(URLIndexCacheFileTest, WriteAndSearch) {
+  AddItem(1, "http://example.com/", "Example", "com example http");
+  AddItem(5, "http://google.com/", "Google", "com google http");
+  ASSERT_TRUE(URLIndexCacheFile::Write(path_, words_, items_));
+
+  scoped_refptr<URLIndexCacheFile> file(URLIndexCacheFile::Open(path_));
+  ASSERT_TRUE(file.get());
+  EXPECT_EQ(4U, file->word_count());
+  EXPECT_EQ(2U, file->item_count());
+
+  // The words are sorted, and identified by their position.
+  WordID com_id = 0;
+  ASSERT_TRUE(file->FindWord(ASCIIToUTF16("com"), &com_id));
+  EXPECT_EQ(0U, com_id);
+  EXPECT_EQ(ASCIIToUTF16("com"), file->GetWord(com_id));
+  WordID google_id = 0;
+  ASSERT_TRUE(file->FindWord(ASCIIToUTF16("google"), &google_id));
+  EXPECT_EQ(2U, google_id);
+  WordID word_id = 0;
+  EXPECT_FALSE(file->FindWord(ASCIIToUTF16("goo"), &word_id));
+  EXPECT_FALSE(file->FindWord(ASCIIToUTF16("zebra"), &word_id));
+  EXPECT_TRUE(file->WordContains(google_id, ASCIIToUTF16("ogl")));
+  EXPECT_FALSE(file->WordContains(google_id, ASCIIToUTF16("gog")));
+
+  HistoryIDVector history_ids;
+  file->AppendHistoryIDs(com_id, &history_ids);
+  ASSERT_EQ(2U, history_ids.size());
+  EXPECT_EQ(1, history_ids[0]);
+  EXPECT_EQ(5, history_ids[1]);
+  file->AppendHistoryIDs(google_id, &history_ids);
+  ASSERT_EQ(3U, history_ids.size());
+  EXPECT_EQ(5, history_ids[2]);
+
+  // Look up words by their characters.
+  Char16Set chars;
+  chars.insert('o');
+  WordIDSet word_ids(file->WordIDSetForTermChars(chars));
+  EXPECT_EQ(2U, word_ids.size());
+  EXPECT_TRUE(word_ids.count(com_id));
+  EXPECT_TRUE(word_ids.count(google_id));
+  chars.insert('l');
+  word_ids = file->WordIDSetForTermChars(chars);
+  ASSERT_EQ(1U, word_ids.size());
+  EXPECT_EQ(google_id, *word_ids.begin());
+  chars.insert('z');
+  EXPECT_TRUE(file->WordIDSetForTermChars(chars).empty());
+
+  // Look up items by their IDs.
+  EXPECT_FALSE(file->FindItem(2));
+  EXPECT_FALSE(file->FindItem(6));
+  const URLIndexCacheFile::Item* item = file->FindItem(5);
+  ASSERT_TRUE(item);
+  EXPECT_EQ("http://google.com/", file->GetURL(*item));
+  EXPECT_EQ(ASCIIToUTF16("Google"), file->GetTitle(*item));
+  RowWordStarts word_starts(file->GetWordStarts(*item));
+  ASSERT_EQ(2U, word_starts.url_word_starts_.size());
+  EXPECT_EQ(7U, word_starts.url_word_starts_[1]);
+  ASSERT_EQ(1U, word_starts.title_word_starts_.size());
+  URLRow row(file->GetRow(*item));
+  EXPECT_EQ(5, row.id());
+  EXPECT_EQ(GURL("http://google.com/"), row.url());
+  EXPECT_EQ(2, row.visit_count());
+  EXPECT_EQ(1, row.typed_count());
+  EXPECT_EQ(base::Time::FromInternalValue(5000), row.last_visit());
+  EXPECT_EQ(1, file->GetItem(0).history_id);
+}
+
+TEST_F(URLIndexCacheFileTest, HistoryIDCompression) {
+  // IDs far apart take several bytes each, those close together one.
+  const HistoryID kHistoryIDs[] = {
+    1, 2, 127, 128, 300, 16384, 16385, GG_INT64_C(1) << 40,
+    (GG_INT64_C(1) << 40) + 1, GG_INT64_C(1) << 50
+  };
+  for (size_t i = 0; i < arraysize(kHistoryIDs); ++i)
+    AddItem(kHistoryIDs[i], "http://example.com/", "Example", "example");
+  const HistoryID kGoogleID = (GG_INT64_C(1) << 50) + 200;
+  AddItem(kGoogleID, "http://google.com/", "Google", "google");
+  ASSERT_TRUE(URLIndexCacheFile::Write(path_, words_, items_));
+
+  scoped_refptr<URLIndexCacheFile> file(URLIndexCacheFile::Open(path_));
+  ASSERT_TRUE(file.get());
+  WordID word_id = 0;
+  ASSERT_TRUE(file->FindWord(ASCIIToUTF16("example"), &word_id));
+  HistoryIDVector history_ids;
+  file->AppendHistoryIDs(word_id, &history_ids);
+  ASSERT_EQ(arraysize(kHistoryIDs), history_ids.size());
+  for (size_t i = 0; i < arraysize(kHistoryIDs); ++i)
+    EXPECT_EQ(kHistoryIDs[i], history_ids[i]);
+  ASSERT_TRUE(file->FindWord(ASCIIToUTF16("google"), &word_id));
+  history_ids.clear();
+  file->AppendHistoryIDs(word_id, &history_ids);
+  ASSERT_EQ(1U, history_ids.size());
+  EXPECT_EQ(kGoogleID, history_ids[0]);
+}
+
+TEST_F(URLIndexCacheFileTest, Empty) {
+  ASSERT_TRUE(URLIndexCacheFile::Write(path_, words_, items_));
+  scoped_refptr<URLIndexCacheFile> file(URLIndexCacheFile::Open(path_));
+  ASSERT_TRUE(file.get());
+  EXPECT_EQ(0U, file->word_count());
+  EXPECT_EQ(0U, file->item_count());
+  Char16Set chars;
+  chars.insert('a');
+  EXPECT_TRUE(file->WordIDSetForTermChars(chars).empty());
+  EXPECT_FALSE(file->FindItem(1));
+}
+
+TEST_F(URLIndexCacheFileTest, Rewrite) {
+  AddItem(1, "http://example.com/", "Example", "com example");
+  ASSERT_TRUE(URLIndexCacheFile::Write(path_, words_, items_));
+  scoped_refptr<URLIndexCacheFile> file(URLIndexCacheFile::Open(path_));
+  ASSERT_TRUE(file.get());
+
+  // The file being used stays intact while it is replaced.
+  AddItem(2, "http://google.com/", "Google", "com google");
+  ASSERT_TRUE(URLIndexCacheFile::Write(path_, words_, items_));
+  EXPECT_EQ(2U, file->word_count());
+  const URLIndexCacheFile::Item* item = file->FindItem(1);
+  ASSERT_TRUE(item);
+  EXPECT_EQ("http://example.com/", file->GetURL(*item));
+
+  scoped_refptr<URLIndexCacheFile> new_file(URLIndexCacheFile::Open(path_));
+  ASSERT_TRUE(new_file.get());
+  EXPECT_EQ(3U, new_file->word_count());
+  EXPECT_EQ(2U, new_file->item_count());
+}
+
+TEST_F(URLIndexCacheFileTest, RejectOtherFiles) {
+  // A missing file.
+  EXPECT_FALSE(URLIndexCacheFile::Open(path_).get());
+
+  // A cache of an older version, which starts with a protobuf tag.
+  std::string data("\x08\x01\x10\x01\x18\x00", 6);
+  data.append(256, '\0');
+  ASSERT_EQ(static_cast<int>(data.size()),
+            file_util::WriteFile(path_, data.data(), data.size()));
+  EXPECT_FALSE(URLIndexCacheFile::Open(path_).get());
+
+  // A truncated file.
+  AddItem(1, "http://example.com/", "Example", "com example");
+  ASSERT_TRUE(URLIndexCacheFile::Write(path_, words_, items_));
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &data));
+  ASSERT_EQ(static_cast<int>(data.size() - 8),
+            file_util::WriteFile(path_, data.data(), data.size() - 8));
+  EXPECT_FALSE(URLIndexCacheFile::Open(path_).get());
+
+  // A section which lies beyond the end of the file.
+  data[sizeof(uint32) * 6] = '\xff';
+  data[sizeof(uint32) * 6 + 1] = '\xff';
+  ASSERT_EQ(static_cast<int>(data.size()),
+            file_util::WriteFile(path_, data.data(), data.size()));
+  EXPECT_FALSE(URLIndexCacheFile::Open(path_).get());
+}
+
+}  // namespace history
@@ -65,9 +65,11 @@ const int kScoreRank[] = { 1450, 1200, 900, 400 };
 
 URLIndexPrivateData::SearchTermCacheItem::SearchTermCacheItem(
     const WordIDSet& word_id_set,
-    const HistoryIDSet& history_id_set)
+    const WordIDSet& cache_file_word_id_set,
+    const HistoryIDVector& history_ids)
     : word_id_set_(word_id_set),
-      history_id_set_(history_id_set),
+      cache_file_word_id_set_(cache_file_word_id_set),
+      history_ids_(history_ids),
       used_(true) {}
 
 URLIndexPrivateData::SearchTermCacheItem::SearchTermCacheItem()
@@ -82,6 +84,19 @@ bool LengthGreater(const string16& string_a, const string16& string_b) {
   return string_a.length() > string_b.length();
 }
 
+// Comparison function for ordering the history IDs found for each search term
+// by ascending count.
+bool HistoryIDCountLess(const HistoryIDVector* history_ids_a,
+                        const HistoryIDVector* history_ids_b) {
+  return history_ids_a->size() < history_ids_b->size();
+}
+
+// Comparison function for sorting the items of a cache file by HistoryID.
+bool ItemContentsHistoryIDLess(const URLIndexCacheFile::ItemContents& item_a,
+                               const URLIndexCacheFile::ItemContents& item_b) {
+  return item_a.history_id < item_b.history_id;
+}
+
 // std::accumulate helper function to add up TermMatches' lengths.
 int AccumulateMatchLength(int total, const TermMatch& match) {
   return total + match.length;
@@ -123,7 +138,6 @@ int ScoreForValue(int value, const int* value_ranks) {
 
 URLIndexPrivateData::URLIndexPrivateData()
     : restored_cache_version_(0),
-      saved_cache_version_(kCurrentCacheFileVersion),
       pre_filter_item_count_(0),
       post_filter_item_count_(0),
       post_scoring_item_count_(0) {
@@ -132,6 +146,8 @@ URLIndexPrivateData::URLIndexPrivateData()
 URLIndexPrivateData::~URLIndexPrivateData() {}
 
 void URLIndexPrivateData::Clear() {
+  cache_file_ = NULL;
+  removed_cache_file_ids_.clear();
   word_list_.clear();
   available_words_.clear();
   word_map_.clear();
@@ -143,11 +159,15 @@ void URLIndexPrivateData::Clear() {
 }
 
 bool URLIndexPrivateData::Empty() const {
-  return history_info_map_.empty();
+  // Only items of the cache file are ever added to |removed_cache_file_ids_|.
+  return history_info_map_.empty() && (!cache_file_ ||
+      cache_file_->item_count() == removed_cache_file_ids_.size());
 }
 
 scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::Duplicate() const {
   scoped_refptr<URLIndexPrivateData> data_copy = new URLIndexPrivateData;
+  data_copy->cache_file_ = cache_file_;
+  data_copy->removed_cache_file_ids_ = removed_cache_file_ids_;
   data_copy->word_list_ = word_list_;
   data_copy->available_words_ = available_words_;
   data_copy->word_map_ = word_map_;
@@ -240,8 +260,17 @@ void URLIndexPrivateData::UpdateWordHistory(WordID word_id,
                                             HistoryID history_id) {
   WordIDHistoryMap::iterator history_pos = word_id_history_map_.find(word_id);
   DCHECK(history_pos != word_id_history_map_.end());
-  HistoryIDSet& history_id_set(history_pos->second);
-  history_id_set.insert(history_id);
+  HistoryIDVector& history_ids(history_pos->second);
+  // Items are mostly indexed in the order of their IDs, so the ID usually
+  // goes at the end.
+  if (history_ids.empty() || history_ids.back() < history_id) {
+    history_ids.push_back(history_id);
+  } else {
+    HistoryIDVector::iterator position =
+        std::lower_bound(history_ids.begin(), history_ids.end(), history_id);
+    if (*position != history_id)
+      history_ids.insert(position, history_id);
+  }
   AddToHistoryIDWordMap(history_id, word_id);
 }
 
@@ -257,9 +286,7 @@ void URLIndexPrivateData::AddWordHistory(const string16& term,
   }
   word_map_[term] = word_id;
 
-  HistoryIDSet history_id_set;
-  history_id_set.insert(history_id);
-  word_id_history_map_[word_id] = history_id_set;
+  word_id_history_map_[word_id] = HistoryIDVector(1, history_id);
   AddToHistoryIDWordMap(history_id, word_id);
 
   // For each character in the newly added word (i.e. a word that is not
@@ -300,8 +327,12 @@ void URLIndexPrivateData::RemoveRowWordsFromIndex(const URLRow& row) {
   for (WordIDSet::iterator word_id_iter = word_id_set.begin();
        word_id_iter != word_id_set.end(); ++word_id_iter) {
     WordID word_id = *word_id_iter;
-    word_id_history_map_[word_id].erase(history_id);
-    if (!word_id_history_map_[word_id].empty())
+    HistoryIDVector& history_ids(word_id_history_map_[word_id]);
+    HistoryIDVector::iterator position =
+        std::lower_bound(history_ids.begin(), history_ids.end(), history_id);
+    if (position != history_ids.end() && *position == history_id)
+      history_ids.erase(position);
+    if (!history_ids.empty())
       continue;  // The word is still in use.
 
     // The word is no longer in use. Reconcile any changes to character usage.
@@ -347,7 +378,23 @@ bool URLIndexPrivateData::UpdateURL(
   bool row_was_updated = false;
   URLID row_id = row.id();
   HistoryInfoMap::iterator row_pos = history_info_map_.find(row_id);
-  if (row_pos == history_info_map_.end()) {
+  const URLIndexCacheFile::Item* item = NULL;
+  if (row_pos == history_info_map_.end() &&
+      (item = FindCacheFileItem(row_id)) != NULL) {
+    // The row is indexed in the cache file, which can not be updated. If the
+    // row changed then it is removed from there, and re-indexed in the maps if
+    // it still qualifies.
+    if (!RowQualifiesAsSignificant(row, base::Time()) ||
+        item->visit_count != row.visit_count() ||
+        item->typed_count != row.typed_count() ||
+        item->last_visit != row.last_visit().ToInternalValue() ||
+        cache_file_->GetTitle(*item) != row.title()) {
+      removed_cache_file_ids_.insert(row_id);
+      if (RowQualifiesAsSignificant(row, base::Time()))
+        IndexRow(row, languages, scheme_whitelist);
+      row_was_updated = true;
+    }
+  } else if (row_pos == history_info_map_.end()) {
     // This new row should be indexed if it qualifies.
     URLRow new_row(row);
     new_row.set_id(row_id);
@@ -408,42 +455,44 @@ bool URLIndexPrivateData::DeleteURL(const GURL& url) {
       history_info_map_.begin(),
       history_info_map_.end(),
       HistoryInfoMapItemHasURL(url));
-  if (pos == history_info_map_.end())
-    return false;
-  RemoveRowFromIndex(pos->second);
-  search_term_cache_.clear();  // This invalidates the cache.
-  return true;
-}
-
-// URLIndexPrivateData::HistoryItemFactorGreater -------------------------------
+  if (pos != history_info_map_.end()) {
+    RemoveRowFromIndex(pos->second);
+    search_term_cache_.clear();  // This invalidates the cache.
+    return true;
+  }
 
-URLIndexPrivateData::HistoryItemFactorGreater::HistoryItemFactorGreater(
-    const HistoryInfoMap& history_info_map)
-    : history_info_map_(history_info_map) {
+  // Otherwise look for the URL in the cache file.
+  if (!cache_file_)
+    return false;
+  const std::string& spec(url.spec());
+  for (size_t i = 0; i < cache_file_->item_count(); ++i) {
+    const URLIndexCacheFile::Item& item(cache_file_->GetItem(i));
+    if (item.url_length == spec.length() &&
+        !removed_cache_file_ids_.count(item.history_id) &&
+        cache_file_->GetURL(item) == spec) {
+      removed_cache_file_ids_.insert(item.history_id);
+      search_term_cache_.clear();  // This invalidates the cache.
+      return true;
+    }
+  }
+  return false;
 }
 
-URLIndexPrivateData::HistoryItemFactorGreater::~HistoryItemFactorGreater() {}
+// URLIndexPrivateData::HistoryItemFactors ------------------------------------
 
-bool URLIndexPrivateData::HistoryItemFactorGreater::operator()(
-    const HistoryID h1,
-    const HistoryID h2) {
-  HistoryInfoMap::const_iterator entry1(history_info_map_.find(h1));
-  if (entry1 == history_info_map_.end())
-    return false;
-  HistoryInfoMap::const_iterator entry2(history_info_map_.find(h2));
-  if (entry2 == history_info_map_.end())
-    return true;
-  const URLRow& r1(entry1->second);
-  const URLRow& r2(entry2->second);
+// static
+bool URLIndexPrivateData::HistoryItemFactorsGreater(
+    const HistoryItemFactors& factors1,
+    const HistoryItemFactors& factors2) {
   // First cut: typed count, visit count, recency.
   // TODO(mrossetti): This is too simplistic. Consider an approach which ranks
   // recently visited (within the last 12/24 hours) as highly important. Get
   // input from mpearson.
-  if (r1.typed_count() != r2.typed_count())
-    return (r1.typed_count() > r2.typed_count());
-  if (r1.visit_count() != r2.visit_count())
-    return (r1.visit_count() > r2.visit_count());
-  return (r1.last_visit() > r2.last_visit());
+  if (factors1.typed_count != factors2.typed_count)
+    return (factors1.typed_count > factors2.typed_count);
+  if (factors1.visit_count != factors2.visit_count)
+    return (factors1.visit_count > factors2.visit_count);
+  return (factors1.last_visit > factors2.last_visit);
 }
 
 // Cache Searching -------------------------------------------------------------
@@ -471,7 +520,7 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
 
   // Do nothing if we have indexed no words (probably because we've not been
   // initialized yet) or the search string has no words.
-  if (word_list_.empty() || lower_words.empty()) {
+  if ((word_list_.empty() && !cache_file_) || lower_words.empty()) {
     search_term_cache_.clear();  // Invalidate the term cache.
     return scored_items;
   }
@@ -480,34 +529,38 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   // approach.
   ResetSearchTermCache();
 
-  HistoryIDSet history_id_set = HistoryIDSetFromWords(lower_words);
+  HistoryIDVector history_ids = HistoryIDsFromWords(lower_words);
 
   // Trim the candidate pool if it is large. Note that we do not filter out
   // items that do not contain the search terms as proper substrings -- doing
   // so is the performance-costly operation we are trying to avoid in order
   // to maintain omnibox responsiveness.
   const size_t kItemsToScoreLimit = 500;
-  pre_filter_item_count_ = history_id_set.size();
-  // If we trim the results set we do not want to cache the results for next
-  // time as the user's ultimately desired result could easily be eliminated
-  // in this early rough filter.
-  bool was_trimmed = (pre_filter_item_count_ > kItemsToScoreLimit);
-  if (was_trimmed) {
-    HistoryIDVector history_ids;
-    std::copy(history_id_set.begin(), history_id_set.end(),
-              std::back_inserter(history_ids));
+  pre_filter_item_count_ = history_ids.size();
+  // The search term cache holds the candidates of each term from before this
+  // rough filter, so it remains valid when the results set is trimmed and
+  // the user's ultimately desired result is still found by the next search.
+  if (pre_filter_item_count_ > kItemsToScoreLimit) {
     // Trim down the set by sorting by typed-count, visit-count, and last
-    // visit.
-    HistoryItemFactorGreater
-        item_factor_functor(history_info_map_);
-    std::partial_sort(history_ids.begin(),
-                      history_ids.begin() + kItemsToScoreLimit,
-                      history_ids.end(),
-                      item_factor_functor);
-    history_id_set.clear();
-    std::copy(history_ids.begin(), history_ids.begin() + kItemsToScoreLimit,
-              std::inserter(history_id_set, history_id_set.end()));
-    post_filter_item_count_ = history_id_set.size();
+    // visit. Items which are no longer indexed are dropped here.
+    HistoryItemFactorsVector item_factors;
+    item_factors.reserve(history_ids.size());
+    HistoryItemFactors factors;
+    for (HistoryIDVector::const_iterator iter = history_ids.begin();
+         iter != history_ids.end(); ++iter) {
+      if (GetHistoryItemFactors(*iter, &factors))
+        item_factors.push_back(factors);
+    }
+    size_t item_count = std::min(kItemsToScoreLimit, item_factors.size());
+    std::partial_sort(item_factors.begin(),
+                      item_factors.begin() + item_count,
+                      item_factors.end(),
+                      HistoryItemFactorsGreater);
+    history_ids.clear();
+    for (size_t i = 0; i < item_count; ++i)
+      history_ids.push_back(item_factors[i].history_id);
+    std::sort(history_ids.begin(), history_ids.end());
+    post_filter_item_count_ = history_ids.size();
   }
 
   // Pass over all of the candidates filtering out any without a proper
@@ -523,7 +576,7 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   // get two 'terms': "colspec=id%20mstone" and "release".
   history::String16Vector lower_raw_terms;
   Tokenize(lower_raw_string, kWhitespaceUTF16, &lower_raw_terms);
-  scored_items = std::for_each(history_id_set.begin(), history_id_set.end(),
+  scored_items = std::for_each(history_ids.begin(), history_ids.end(),
       AddHistoryMatch(*this, lower_raw_string,
                       lower_raw_terms)).ScoredMatches();
 
@@ -541,17 +594,13 @@ ScoredHistoryMatches URLIndexPrivateData::HistoryItemsForTerms(
   }
   post_scoring_item_count_ = scored_items.size();
 
-  if (was_trimmed) {
-    search_term_cache_.clear();  // Invalidate the term cache.
-  } else {
-    // Remove any stale SearchTermCacheItems.
-    for (SearchTermCacheMap::iterator cache_iter = search_term_cache_.begin();
-         cache_iter != search_term_cache_.end(); ) {
-      if (!cache_iter->second.used_)
-        search_term_cache_.erase(cache_iter++);
-      else
-        ++cache_iter;
-    }
+  // Remove any stale SearchTermCacheItems.
+  for (SearchTermCacheMap::iterator cache_iter = search_term_cache_.begin();
+       cache_iter != search_term_cache_.end(); ) {
+    if (!cache_iter->second.used_)
+      search_term_cache_.erase(cache_iter++);
+    else
+      ++cache_iter;
   }
 
   return scored_items;
@@ -586,6 +635,19 @@ void URLIndexPrivateData::AddHistoryMatch::operator()(
                                                starts_pos->second));
     if (match.raw_score > 0)
       scored_matches_.push_back(match);
+    return;
+  }
+
+  // Otherwise the item may be in the cache file.
+  const URLIndexCacheFile::Item* item =
+      private_data_.FindCacheFileItem(history_id);
+  if (item) {
+    const URLIndexCacheFile& cache_file(*private_data_.cache_file_);
+    ScoredHistoryMatch match(
+        ScoredMatchForURL(cache_file.GetRow(*item), lower_string_,
+                          lower_terms_, cache_file.GetWordStarts(*item)));
+    if (match.raw_score > 0)
+      scored_matches_.push_back(match);
   }
 }
 
@@ -750,45 +812,42 @@ void URLIndexPrivateData::ResetSearchTermCache() {
     iter->second.used_ = false;
 }
 
-HistoryIDSet URLIndexPrivateData::HistoryIDSetFromWords(
+HistoryIDVector URLIndexPrivateData::HistoryIDsFromWords(
     const String16Vector& unsorted_words) {
-  // Break the terms down into individual terms (words), get the candidate
-  // set for each term, and intersect each to get a final candidate list.
+  // Break the terms down into individual terms (words), get the candidates
+  // for each term, and intersect each to get a final candidate list.
   // Note that a single 'term' from the user's perspective might be
   // a string like "http://www.somewebsite.com" which, from our perspective,
   // is four words: 'http', 'www', 'somewebsite', and 'com'.
-  HistoryIDSet history_id_set;
   String16Vector words(unsorted_words);
-  // Sort the words into the longest first as such are likely to narrow down
-  // the results quicker. Also, single character words are the most expensive
+  // Sort the words into the longest first as such are the most likely to have
+  // no results at all. Also, single character words are the most expensive
   // to process so save them for last.
   std::sort(words.begin(), words.end(), LengthGreater);
-  for (String16Vector::iterator iter = words.begin(); iter != words.end();
-       ++iter) {
-    string16 uni_word = *iter;
-    HistoryIDSet term_history_set = HistoryIDsForTerm(uni_word);
-    if (term_history_set.empty()) {
-      history_id_set.clear();
-      break;
-    }
-    if (iter == words.begin()) {
-      history_id_set.swap(term_history_set);
-    } else {
-      HistoryIDSet new_history_id_set;
-      std::set_intersection(history_id_set.begin(), history_id_set.end(),
-                            term_history_set.begin(), term_history_set.end(),
-                            std::inserter(new_history_id_set,
-                                          new_history_id_set.begin()));
-      history_id_set.swap(new_history_id_set);
-    }
+  std::vector<HistoryIDVector> term_history_ids(words.size());
+  std::vector<const HistoryIDVector*> sorted_term_history_ids;
+  for (size_t i = 0; i < words.size(); ++i) {
+    term_history_ids[i] = HistoryIDsForTerm(words[i]);
+    if (term_history_ids[i].empty())
+      return HistoryIDVector();
+    sorted_term_history_ids.push_back(&term_history_ids[i]);
   }
-  return history_id_set;
+
+  // Intersect starting with the fewest candidates, which keeps the
+  // intersection small and lets it gallop through the longer lists.
+  std::sort(sorted_term_history_ids.begin(), sorted_term_history_ids.end(),
+            HistoryIDCountLess);
+  HistoryIDVector history_ids(*sorted_term_history_ids.front());
+  for (size_t i = 1; i < sorted_term_history_ids.size() &&
+       !history_ids.empty(); ++i)
+    IntersectHistoryIDs(*sorted_term_history_ids[i], &history_ids);
+  return history_ids;
 }
 
-HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
+HistoryIDVector URLIndexPrivateData::HistoryIDsForTerm(
     const string16& term) {
   if (term.empty())
-    return HistoryIDSet();
+    return HistoryIDVector();
 
   // TODO(mrossetti): Consider optimizing for very common terms such as
   // 'http[s]', 'www', 'com', etc. Or collect the top 100 more frequently
@@ -796,16 +855,16 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
 
   size_t term_length = term.length();
   WordIDSet word_id_set;
+  WordIDSet cache_file_word_id_set;
   if (term_length > 1) {
-    // See if this term or a prefix thereof is present in the cache.
+    // See if this term or a prefix thereof is present in the cache. Only
+    // terms of more than one character are cached, so try the prefixes from
+    // the whole term down to two characters.
     SearchTermCacheMap::iterator best_prefix(search_term_cache_.end());
-    for (SearchTermCacheMap::iterator cache_iter = search_term_cache_.begin();
-         cache_iter != search_term_cache_.end(); ++cache_iter) {
-      if (StartsWith(term, cache_iter->first, false) &&
-          (best_prefix == search_term_cache_.end() ||
-           cache_iter->first.length() > best_prefix->first.length()))
-        best_prefix = cache_iter;
-    }
+    for (size_t prefix_length = term_length;
+         prefix_length > 1 && best_prefix == search_term_cache_.end();
+         --prefix_length)
+      best_prefix = search_term_cache_.find(term.substr(0, prefix_length));
 
     // If a prefix was found then determine the leftover characters to be used
     // for further refining the results from that prefix.
@@ -817,19 +876,23 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
       size_t prefix_length = best_prefix->first.length();
       if (prefix_length == term_length) {
         best_prefix->second.used_ = true;
-        return best_prefix->second.history_id_set_;
+        return best_prefix->second.history_ids_;
       }
 
       // Otherwise we have a handy starting point.
       // If there are no history results for this prefix then we can bail early
       // as there will be no history results for the full term.
-      if (best_prefix->second.history_id_set_.empty()) {
+      if (best_prefix->second.history_ids_.empty()) {
         search_term_cache_[term] = SearchTermCacheItem();
-        return HistoryIDSet();
+        return HistoryIDVector();
       }
       word_id_set = best_prefix->second.word_id_set_;
+      cache_file_word_id_set = best_prefix->second.cache_file_word_id_set_;
       prefix_chars = Char16SetFromString16(best_prefix->first);
       leftovers = term.substr(prefix_length);
+    } else if (cache_file_) {
+      cache_file_word_id_set =
+          cache_file_->WordIDSetForTermChars(Char16SetFromString16(term));
     }
 
     // Filter for each remaining, unique character in the term.
@@ -843,9 +906,9 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
     if (!unique_chars.empty()) {
       WordIDSet leftover_set(WordIDSetForTermChars(unique_chars));
       // We might come up empty on the leftovers.
-      if (leftover_set.empty()) {
+      if (leftover_set.empty() && cache_file_word_id_set.empty()) {
         search_term_cache_[term] = SearchTermCacheItem();
-        return HistoryIDSet();
+        return HistoryIDVector();
       }
       // Or there may not have been a prefix from which to start.
       if (prefix_chars.empty()) {
@@ -869,32 +932,46 @@ HistoryIDSet URLIndexPrivateData::HistoryIDsForTerm(
       else
         ++word_set_iter;
     }
+    // Likewise for the words of the cache file, which start out as those
+    // containing the prefix or all of the characters of the term.
+    for (WordIDSet::iterator word_set_iter = cache_file_word_id_set.begin();
+         word_set_iter != cache_file_word_id_set.end(); ) {
+      if (!cache_file_->WordContains(*word_set_iter, term))
+        cache_file_word_id_set.erase(word_set_iter++);
+      else
+        ++word_set_iter;
+    }
   } else {
-    word_id_set = WordIDSetForTermChars(Char16SetFromString16(term));
+    Char16Set term_chars(Char16SetFromString16(term));
+    word_id_set = WordIDSetForTermChars(term_chars);
+    if (cache_file_)
+      cache_file_word_id_set = cache_file_->WordIDSetForTermChars(term_chars);
   }
 
-  // If any words resulted then we can compose a set of history IDs by unioning
-  // the sets from each word.
-  HistoryIDSet history_id_set;
-  if (!word_id_set.empty()) {
-    for (WordIDSet::iterator word_id_iter = word_id_set.begin();
-         word_id_iter != word_id_set.end(); ++word_id_iter) {
-      WordID word_id = *word_id_iter;
-      WordIDHistoryMap::iterator word_iter = word_id_history_map_.find(word_id);
-      if (word_iter != word_id_history_map_.end()) {
-        HistoryIDSet& word_history_id_set(word_iter->second);
-        history_id_set.insert(word_history_id_set.begin(),
-                              word_history_id_set.end());
-      }
+  // If any words resulted then we can compose the history IDs by unioning
+  // those of each word: they are gathered, then sorted and made unique once.
+  HistoryIDVector history_ids;
+  for (WordIDSet::iterator word_id_iter = word_id_set.begin();
+       word_id_iter != word_id_set.end(); ++word_id_iter) {
+    WordID word_id = *word_id_iter;
+    WordIDHistoryMap::iterator word_iter = word_id_history_map_.find(word_id);
+    if (word_iter != word_id_history_map_.end()) {
+      const HistoryIDVector& word_history_ids(word_iter->second);
+      history_ids.insert(history_ids.end(), word_history_ids.begin(),
+                         word_history_ids.end());
     }
   }
+  AddCacheFileHistoryIDs(cache_file_word_id_set, &history_ids);
+  SortAndUniqueHistoryIDs(&history_ids);
 
   // Record a new cache entry for this word if the term is longer than
   // a single character.
-  if (term_length > 1)
-    search_term_cache_[term] = SearchTermCacheItem(word_id_set, history_id_set);
+  if (term_length > 1) {
+    search_term_cache_[term] = SearchTermCacheItem(
+        word_id_set, cache_file_word_id_set, history_ids);
+  }
 
-  return history_id_set;
+  return history_ids;
 }
 
 WordIDSet URLIndexPrivateData::WordIDSetForTermChars(
@@ -932,6 +1009,54 @@ WordIDSet URLIndexPrivateData::WordIDSetForTermChars(
   return word_id_set;
 }
 
+const URLIndexCacheFile::Item* URLIndexPrivateData::FindCacheFileItem(
+    HistoryID history_id) const {
+  if (!cache_file_ || removed_cache_file_ids_.count(history_id))
+    return NULL;
+  return cache_file_->FindItem(history_id);
+}
+
+void URLIndexPrivateData::AddCacheFileHistoryIDs(
+    const WordIDSet& word_id_set,
+    HistoryIDVector* history_ids) const {
+  size_t first_added = history_ids->size();
+  for (WordIDSet::const_iterator word_id_iter = word_id_set.begin();
+       word_id_iter != word_id_set.end(); ++word_id_iter)
+    cache_file_->AppendHistoryIDs(*word_id_iter, history_ids);
+  if (removed_cache_file_ids_.empty())
+    return;
+  // Drop the items which have been removed from the index since the file was
+  // written. Items indexed in the maps under the same ID are kept.
+  HistoryIDVector::iterator kept = history_ids->begin() + first_added;
+  for (HistoryIDVector::iterator iter = kept; iter != history_ids->end();
+       ++iter) {
+    if (!removed_cache_file_ids_.count(*iter))
+      *kept++ = *iter;
+  }
+  history_ids->erase(kept, history_ids->end());
+}
+
+bool URLIndexPrivateData::GetHistoryItemFactors(
+    HistoryID history_id,
+    HistoryItemFactors* factors) const {
+  factors->history_id = history_id;
+  HistoryInfoMap::const_iterator entry(history_info_map_.find(history_id));
+  if (entry != history_info_map_.end()) {
+    const URLRow& row(entry->second);
+    factors->typed_count = row.typed_count();
+    factors->visit_count = row.visit_count();
+    factors->last_visit = row.last_visit();
+    return true;
+  }
+  const URLIndexCacheFile::Item* item = FindCacheFileItem(history_id);
+  if (!item)
+    return false;
+  factors->typed_count = item->typed_count;
+  factors->visit_count = item->visit_count;
+  factors->last_visit = base::Time::FromInternalValue(item->last_visit);
+  return true;
+}
+
 // Cache Saving ----------------------------------------------------------------
 
 // static
@@ -946,16 +1071,10 @@ void URLIndexPrivateData::WritePrivateDataToCacheFileTask(
 
 bool URLIndexPrivateData::SaveToFile(const FilePath& file_path) {
   base::TimeTicks beginning_time = base::TimeTicks::Now();
-  InMemoryURLIndexCacheItem index_cache;
-  SavePrivateData(&index_cache);
-  std::string data;
-  if (!index_cache.SerializeToString(&data)) {
-    LOG(WARNING) << "Failed to serialize the InMemoryURLIndex cache.";
-    return false;
-  }
-
-  int size = data.size();
-  if (file_util::WriteFile(file_path, data.c_str(), size) != size) {
+  URLIndexCacheFile::WordHistoryMap words;
+  URLIndexCacheFile::ItemContentsVector items;
+  GetCacheFileContents(&words, &items);
+  if (!URLIndexCacheFile::Write(file_path, words, items)) {
     LOG(WARNING) << "Failed to write " << file_path.value();
     return false;
   }
@@ -964,129 +1083,55 @@ bool URLIndexPrivateData::SaveToFile(const FilePath& file_path) {
   return true;
 }
 
-void URLIndexPrivateData::SavePrivateData(
-    InMemoryURLIndexCacheItem* cache) const {
-  DCHECK(cache);
-  cache->set_timestamp(base::Time::Now().ToInternalValue());
-  cache->set_version(saved_cache_version_);
-  // history_item_count_ is no longer used but rather than change the protobuf
-  // definition use a placeholder. This will go away with the switch to SQLite.
-  cache->set_history_item_count(0);
-  SaveWordList(cache);
-  SaveWordMap(cache);
-  SaveCharWordMap(cache);
-  SaveWordIDHistoryMap(cache);
-  SaveHistoryInfoMap(cache);
-  SaveWordStartsMap(cache);
-}
-
-void URLIndexPrivateData::SaveWordList(InMemoryURLIndexCacheItem* cache) const {
-  if (word_list_.empty())
-    return;
-  WordListItem* list_item = cache->mutable_word_list();
-  list_item->set_word_count(word_list_.size());
-  for (String16Vector::const_iterator iter = word_list_.begin();
-       iter != word_list_.end(); ++iter)
-    list_item->add_word(UTF16ToUTF8(*iter));
-}
-
-void URLIndexPrivateData::SaveWordMap(InMemoryURLIndexCacheItem* cache) const {
-  if (word_map_.empty())
-    return;
-  WordMapItem* map_item = cache->mutable_word_map();
-  map_item->set_item_count(word_map_.size());
-  for (WordMap::const_iterator iter = word_map_.begin();
-       iter != word_map_.end(); ++iter) {
-    WordMapEntry* map_entry = map_item->add_word_map_entry();
-    map_entry->set_word(UTF16ToUTF8(iter->first));
-    map_entry->set_word_id(iter->second);
-  }
-}
-
-void URLIndexPrivateData::SaveCharWordMap(
-    InMemoryURLIndexCacheItem* cache) const {
-  if (char_word_map_.empty())
-    return;
-  CharWordMapItem* map_item = cache->mutable_char_word_map();
-  map_item->set_item_count(char_word_map_.size());
-  for (CharWordIDMap::const_iterator iter = char_word_map_.begin();
-       iter != char_word_map_.end(); ++iter) {
-    CharWordMapEntry* map_entry = map_item->add_char_word_map_entry();
-    map_entry->set_char_16(iter->first);
-    const WordIDSet& word_id_set(iter->second);
-    map_entry->set_item_count(word_id_set.size());
-    for (WordIDSet::const_iterator set_iter = word_id_set.begin();
-         set_iter != word_id_set.end(); ++set_iter)
-      map_entry->add_word_id(*set_iter);
-  }
-}
-
-void URLIndexPrivateData::SaveWordIDHistoryMap(
-    InMemoryURLIndexCacheItem* cache) const {
-  if (word_id_history_map_.empty())
-    return;
-  WordIDHistoryMapItem* map_item = cache->mutable_word_id_history_map();
-  map_item->set_item_count(word_id_history_map_.size());
+void URLIndexPrivateData::GetCacheFileContents(
+    URLIndexCacheFile::WordHistoryMap* words,
+    URLIndexCacheFile::ItemContentsVector* items) const {
+  DCHECK(words);
+  DCHECK(items);
   for (WordIDHistoryMap::const_iterator iter = word_id_history_map_.begin();
        iter != word_id_history_map_.end(); ++iter) {
-    WordIDHistoryMapEntry* map_entry =
-        map_item->add_word_id_history_map_entry();
-    map_entry->set_word_id(iter->first);
-    const HistoryIDSet& history_id_set(iter->second);
-    map_entry->set_item_count(history_id_set.size());
-    for (HistoryIDSet::const_iterator set_iter = history_id_set.begin();
-         set_iter != history_id_set.end(); ++set_iter)
-      map_entry->add_history_id(*set_iter);
+    HistoryIDSet& history_id_set((*words)[word_list_[iter->first]]);
+    history_id_set.insert(iter->second.begin(), iter->second.end());
   }
-}
-
-void URLIndexPrivateData::SaveHistoryInfoMap(
-    InMemoryURLIndexCacheItem* cache) const {
-  if (history_info_map_.empty())
-    return;
-  HistoryInfoMapItem* map_item = cache->mutable_history_info_map();
-  map_item->set_item_count(history_info_map_.size());
   for (HistoryInfoMap::const_iterator iter = history_info_map_.begin();
        iter != history_info_map_.end(); ++iter) {
-    HistoryInfoMapEntry* map_entry = map_item->add_history_info_map_entry();
-    map_entry->set_history_id(iter->first);
-    const URLRow& url_row(iter->second);
-    // Note: We only save information that contributes to the index so there
-    // is no need to save search_term_cache_ (not persistent).
-    map_entry->set_visit_count(url_row.visit_count());
-    map_entry->set_typed_count(url_row.typed_count());
-    map_entry->set_last_visit(url_row.last_visit().ToInternalValue());
-    map_entry->set_url(url_row.url().spec());
-    map_entry->set_title(UTF16ToUTF8(url_row.title()));
+    const URLRow& row(iter->second);
+    URLIndexCacheFile::ItemContents item;
+    item.history_id = iter->first;
+    item.visit_count = row.visit_count();
+    item.typed_count = row.typed_count();
+    item.last_visit = row.last_visit();
+    item.url = row.url().spec();
+    item.title = row.title();
+    WordStartsMap::const_iterator word_starts =
+        word_starts_map_.find(iter->first);
+    if (word_starts != word_starts_map_.end())
+      item.word_starts = word_starts->second;
+    items->push_back(item);
   }
-}
 
-void URLIndexPrivateData::SaveWordStartsMap(
-    InMemoryURLIndexCacheItem* cache) const {
-  if (word_starts_map_.empty())
-    return;
-  // For unit testing: Enable saving of the cache as an earlier version to
-  // allow testing of cache file upgrading in ReadFromFile().
-  // TODO(mrossetti): Instead of intruding on production code with this kind of
-  // test harness, save a copy of an older version cache with known results.
-  // Implement this when switching the caching over to SQLite.
-  if (saved_cache_version_ < 1)
-    return;
-
-  WordStartsMapItem* map_item = cache->mutable_word_starts_map();
-  map_item->set_item_count(word_starts_map_.size());
-  for (WordStartsMap::const_iterator iter = word_starts_map_.begin();
-       iter != word_starts_map_.end(); ++iter) {
-    WordStartsMapEntry* map_entry = map_item->add_word_starts_map_entry();
-    map_entry->set_history_id(iter->first);
-    const RowWordStarts& word_starts(iter->second);
-    for (WordStarts::const_iterator i = word_starts.url_word_starts_.begin();
-         i != word_starts.url_word_starts_.end(); ++i)
-      map_entry->add_url_word_starts(*i);
-    for (WordStarts::const_iterator i = word_starts.title_word_starts_.begin();
-         i != word_starts.title_word_starts_.end(); ++i)
-      map_entry->add_title_word_starts(*i);
+  if (cache_file_) {
+    HistoryIDVector history_ids;
+    for (WordID word_id = 0; word_id < cache_file_->word_count(); ++word_id) {
+      history_ids.clear();
+      cache_file_->AppendHistoryIDs(word_id, &history_ids);
+      HistoryIDSet* history_id_set = NULL;
+      for (HistoryIDVector::const_iterator id = history_ids.begin();
+           id != history_ids.end(); ++id) {
+        if (removed_cache_file_ids_.count(*id))
+          continue;
+        if (!history_id_set)
+          history_id_set = &(*words)[cache_file_->GetWord(word_id)];
+        history_id_set->insert(*id);
+      }
+    }
+    for (size_t i = 0; i < cache_file_->item_count(); ++i) {
+      const URLIndexCacheFile::Item& item(cache_file_->GetItem(i));
+      if (!removed_cache_file_ids_.count(item.history_id))
+        items->push_back(cache_file_->GetItemContents(item));
+    }
   }
+  std::sort(items->begin(), items->end(), ItemContentsHistoryIDLess);
 }
 
 // Cache Restoring -------------------------------------------------------------
@@ -1096,45 +1141,60 @@ void URLIndexPrivateData::RestoreFromFileTask(
     const FilePath& file_path,
     scoped_refptr<URLIndexPrivateData> private_data,
     const std::string& languages) {
-  private_data = URLIndexPrivateData::RestoreFromFile(file_path, languages);
+  private_data->RestoreFromFile(file_path, languages);
 }
 
-// static
-scoped_refptr<URLIndexPrivateData> URLIndexPrivateData::RestoreFromFile(
-    const FilePath& file_path,
-    const std::string& languages) {
+bool URLIndexPrivateData::RestoreFromFile(const FilePath& file_path,
+                                          const std::string& languages) {
+  DCHECK(Empty());
   base::TimeTicks beginning_time = base::TimeTicks::Now();
-  if (!file_util::PathExists(file_path))
-    return NULL;
-  std::string data;
   // If there is no cache file then simply give up. This will cause us to
   // attempt to rebuild from the history database.
-  if (!file_util::ReadFileToString(file_path, &data))
-    return NULL;
+  if (!file_util::PathExists(file_path))
+    return false;
 
-  scoped_refptr<URLIndexPrivateData> restored_data(new URLIndexPrivateData);
-  InMemoryURLIndexCacheItem index_cache;
-  if (!index_cache.ParseFromArray(data.c_str(), data.size())) {
-    LOG(WARNING) << "Failed to parse URLIndexPrivateData cache data read from "
-                 << file_path.value();
-    return restored_data;
+  size_t file_size = 0;
+  cache_file_ = URLIndexCacheFile::Open(file_path);
+  if (cache_file_) {
+    restored_cache_version_ = kCurrentCacheFileVersion;
+    file_size = cache_file_->file_length();
+  } else {
+    // Caches written by older versions are decoded into the maps. They are
+    // replaced by a cache file in the current format when the index is next
+    // saved.
+    std::string data;
+    if (!file_util::ReadFileToString(file_path, &data))
+      return false;
+    InMemoryURLIndexCacheItem index_cache;
+    if (!index_cache.ParseFromArray(data.c_str(), data.size())) {
+      LOG(WARNING) << "Failed to parse URLIndexPrivateData cache data read "
+                   << "from " << file_path.value();
+      return false;
+    }
+    if (!RestorePrivateData(index_cache, languages)) {
+      Clear();
+      return false;
+    }
+    file_size = data.size();
   }
 
-  if (!restored_data->RestorePrivateData(index_cache, languages))
-    return NULL;
-
   UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexRestoreCacheTime",
                       base::TimeTicks::Now() - beginning_time);
   UMA_HISTOGRAM_COUNTS("History.InMemoryURLHistoryItems",
-                       restored_data->history_id_word_map_.size());
-  UMA_HISTOGRAM_COUNTS("History.InMemoryURLCacheSize", data.size());
+                       cache_file_ ? cache_file_->item_count() :
+                                     history_id_word_map_.size());
+  UMA_HISTOGRAM_COUNTS("History.InMemoryURLCacheSize", file_size);
   UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords",
-                             restored_data->word_map_.size());
+                             cache_file_ ? cache_file_->word_count() :
+                                           word_map_.size());
   UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLChars",
-                             restored_data->char_word_map_.size());
-  if (restored_data->Empty())
-    return NULL;  // 'No data' is the same as a failed reload.
-  return restored_data;
+                             cache_file_ ? cache_file_->char_count() :
+                                           char_word_map_.size());
+  if (Empty()) {
+    Clear();
+    return false;  // 'No data' is the same as a failed reload.
+  }
+  return true;
 }
 
 // static
@@ -1253,14 +1313,14 @@ bool URLIndexPrivateData::RestoreWordIDHistoryMap(
     if (actual_item_count == 0 || actual_item_count != expected_item_count)
       return false;
     WordID word_id = iter->word_id();
-    HistoryIDSet history_id_set;
+    HistoryIDVector& word_history_ids(word_id_history_map_[word_id]);
     const RepeatedField<int64>& history_ids(iter->history_id());
     for (RepeatedField<int64>::const_iterator jiter = history_ids.begin();
          jiter != history_ids.end(); ++jiter) {
-      history_id_set.insert(*jiter);
+      word_history_ids.push_back(*jiter);
       AddToHistoryIDWordMap(*jiter, word_id);
     }
-    word_id_history_map_[word_id] = history_id_set;
+    SortAndUniqueHistoryIDs(&word_history_ids);
   }
   return true;
 }
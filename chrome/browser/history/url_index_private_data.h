@@ -8,12 +8,14 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/file_path.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
 #include "chrome/browser/history/in_memory_url_index_types.h"
 #include "chrome/browser/history/in_memory_url_index_cache.pb.h"
+#include "chrome/browser/history/url_index_cache_file.h"
 #include "content/public/browser/notification_details.h"
 
 class HistoryQuickProviderTest;
@@ -30,11 +32,12 @@ class HistoryDatabase;
 class InMemoryURLIndex;
 class RefCountedBool;
 
-// Current version of the cache file.
-static const int kCurrentCacheFileVersion = 1;
-
 // A structure describing the InMemoryURLIndex's internal data and providing for
 // restoring, rebuilding and updating that internal data.
+//
+// When restored from a cache file the index is searched in place, in the
+// mapped file. The maps below then only hold the rows indexed since, and the
+// rows of the file which have been updated or deleted are skipped.
 class URLIndexPrivateData
     : public base::RefCountedThreadSafe<URLIndexPrivateData> {
  public:
@@ -47,8 +50,11 @@ class URLIndexPrivateData
   friend class AddHistoryMatch;
   friend class ::HistoryQuickProviderTest;
   friend class InMemoryURLIndex;
+  friend class InMemoryURLIndexPerfTest;
   friend class InMemoryURLIndexTest;
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheSaveRestore);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheFileUpdates);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, LegacyCacheRestore);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, HugeResultSet);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Scoring);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, TitleSearch);
@@ -67,22 +73,27 @@ class URLIndexPrivateData
   // no longer needed.
   //
   // Items stored in the search term cache. If a search term exactly matches one
-  // in the cache then we can quickly supply the proper |history_id_set_| (and
+  // in the cache then we can quickly supply the proper |history_ids_| (and
   // marking the cache item as being |used_|. If we find a prefix for a search
   // term in the cache (which is very likely to occur as the user types each
   // term into the omnibox) then we can short-circuit the index search for those
   // characters in the prefix by returning the |word_id_set|. In that case we do
-  // not mark the item as being |used_|.
+  // not mark the item as being |used_|. The words of the cache file the index
+  // was restored from are kept apart in |cache_file_word_id_set_|. The cache
+  // is keyed by term, so the prefixes of a term are looked up directly,
+  // longest first.
   struct SearchTermCacheItem {
     SearchTermCacheItem(const WordIDSet& word_id_set,
-                        const HistoryIDSet& history_id_set);
+                        const WordIDSet& cache_file_word_id_set,
+                        const HistoryIDVector& history_ids);
     // Creates a cache item for a term which has no results.
     SearchTermCacheItem();
 
     ~SearchTermCacheItem();
 
     WordIDSet word_id_set_;
-    HistoryIDSet history_id_set_;
+    WordIDSet cache_file_word_id_set_;
+    HistoryIDVector history_ids_;  // Sorted.
     bool used_;  // True if this item has been used for the current term search.
   };
   typedef std::map<string16, SearchTermCacheItem> SearchTermCacheMap;
@@ -108,19 +119,20 @@ class URLIndexPrivateData
     const String16Vector& lower_terms_;
   };
 
-  // A helper predicate class used to filter excess history items when the
-  // candidate results set is too large.
-  class HistoryItemFactorGreater
-      : public std::binary_function<HistoryID, HistoryID, void> {
-   public:
-    explicit HistoryItemFactorGreater(const HistoryInfoMap& history_info_map);
-    ~HistoryItemFactorGreater();
-
-    bool operator()(const HistoryID h1, const HistoryID h2);
-
-   private:
-    const history::HistoryInfoMap& history_info_map_;
+  // The metrics of a history item by which excess history items are filtered
+  // when the candidate results set is too large. They are looked up once per
+  // candidate rather than on every comparison.
+  struct HistoryItemFactors {
+    HistoryID history_id;
+    int typed_count;
+    int visit_count;
+    base::Time last_visit;
   };
+  typedef std::vector<HistoryItemFactors> HistoryItemFactorsVector;
+
+  // Orders history items by descending typed count, visit count and recency.
+  static bool HistoryItemFactorsGreater(const HistoryItemFactors& factors1,
+                                        const HistoryItemFactors& factors2);
 
   // Given a string16 in |term_string|, scans the history index and returns a
   // vector with all scored, matching history items. The |term_string| is
@@ -139,21 +151,20 @@ class URLIndexPrivateData
   // to this function.
   ScoredHistoryMatches HistoryItemsForTerms(const string16& term_string);
 
-  // Creates a new URLIndexPrivateData object, populates it from the contents
-  // of the cache file stored in |file_path|, and assigns it to |private_data|.
-  // |languages| will be used to break URLs and page titles into words.
+  // Populates the empty |private_data| from the contents of the cache file
+  // stored in |file_path|. |languages| will be used to break URLs and page
+  // titles into words.
   static void RestoreFromFileTask(
       const FilePath& file_path,
       scoped_refptr<URLIndexPrivateData> private_data,
       const std::string& languages);
 
-  // Constructs a new object by restoring its contents from the file at |path|.
-  // Returns the new URLIndexPrivateData which on success will contain the
-  // restored data but upon failure will be empty.  |languages| will be used to
-  // break URLs and page titles into words
-  static scoped_refptr<URLIndexPrivateData> RestoreFromFile(
-      const FilePath& path,
-      const std::string& languages);
+  // Restores the contents of this empty object from the file at |path|. A
+  // cache file in the current format is used in place, while older caches are
+  // decoded into the maps. Returns false, leaving the object empty, upon
+  // failure. |languages| will be used to break URLs and page titles into
+  // words.
+  bool RestoreFromFile(const FilePath& path, const std::string& languages);
 
   // Constructs a new object by rebuilding its contents from the history
   // database in |history_db|. Returns the new URLIndexPrivateData which on
@@ -176,6 +187,11 @@ class URLIndexPrivateData
   // directory.  Called by WritePrivateDataToCacheFileTask.
   bool SaveToFile(const FilePath& file_path);
 
+  // Collects the words and history items of the index, wherever they are
+  // held, for writing them to a cache file.
+  void GetCacheFileContents(URLIndexCacheFile::WordHistoryMap* words,
+                            URLIndexCacheFile::ItemContentsVector* items) const;
+
   // Initializes all index data members in preparation for restoring the index
   // from the cache or a complete rebuild from the history database.
   void Clear();
@@ -193,6 +209,20 @@ class URLIndexPrivateData
   // Given a set of Char16s, finds words containing those characters.
   WordIDSet WordIDSetForTermChars(const Char16Set& term_chars);
 
+  // Returns the item of |history_id| in |cache_file_|, or NULL if there is
+  // none or it has been removed from the index since the file was written.
+  const URLIndexCacheFile::Item* FindCacheFileItem(HistoryID history_id) const;
+
+  // Appends the items of |cache_file_| in which any of the words |word_id_set|
+  // of the file occur to |history_ids|, unsorted.
+  void AddCacheFileHistoryIDs(const WordIDSet& word_id_set,
+                              HistoryIDVector* history_ids) const;
+
+  // Gets the metrics by which HistoryItemFactorsGreater orders the history
+  // item |history_id| into |factors|. Returns false if the item is not indexed.
+  bool GetHistoryItemFactors(HistoryID history_id,
+                             HistoryItemFactors* factors) const;
+
   // URL History indexing support functions.
 
   // Indexes one URL history item as described by |row|. Returns true if the
@@ -249,13 +279,13 @@ class URLIndexPrivateData
   // Clears |used_| for each item in the search term cache.
   void ResetSearchTermCache();
 
-  // Composes a set of history item IDs by intersecting the set for each word
-  // in |unsorted_words|.
-  HistoryIDSet HistoryIDSetFromWords(const String16Vector& unsorted_words);
+  // Composes the sorted history item IDs which contain all of the words in
+  // |unsorted_words| by intersecting the IDs for each word.
+  HistoryIDVector HistoryIDsFromWords(const String16Vector& unsorted_words);
 
-  // Helper function to HistoryIDSetFromWords which composes a set of history
-  // ids for the given term given in |term|.
-  HistoryIDSet HistoryIDsForTerm(const string16& term);
+  // Helper function to HistoryIDsFromWords which composes the sorted history
+  // IDs for the given term given in |term|.
+  HistoryIDVector HistoryIDsForTerm(const string16& term);
 
   // Calculates a raw score for this history item by first determining
   // if all of the terms in |terms_vector| occur in |row| and, if so,
@@ -279,18 +309,9 @@ class URLIndexPrivateData
   static int ScoreComponentForMatches(const TermMatches& matches,
                                       size_t max_length);
 
-  // Encode a data structure into the protobuf |cache|.
-  void SavePrivateData(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordList(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveCharWordMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordIDHistoryMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveHistoryInfoMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordStartsMap(imui::InMemoryURLIndexCacheItem* cache) const;
-
-  // Decode a data structure from the protobuf |cache|. Return false if there
-  // is any kind of failure. |languages| will be used to break URLs and page
-  // titles into words
+  // Decode a data structure from the protobuf |cache| written by older
+  // versions. Return false if there is any kind of failure. |languages| will be
+  // used to break URLs and page titles into words
   bool RestorePrivateData(const imui::InMemoryURLIndexCacheItem& cache,
                           const std::string& languages);
   bool RestoreWordList(const imui::InMemoryURLIndexCacheItem& cache);
@@ -308,6 +329,14 @@ class URLIndexPrivateData
   // Cache of search terms.
   SearchTermCacheMap search_term_cache_;
 
+  // The cache file the index was restored from, if any. It is shared with the
+  // duplicates of this object and never modified.
+  scoped_refptr<URLIndexCacheFile> cache_file_;
+
+  // The items of |cache_file_| which have since been deleted, or re-indexed in
+  // the maps below.
+  HistoryIDSet removed_cache_file_ids_;
+
   // Start of data members that are cached -------------------------------------
 
   // The version of the cache file most recently used to restore this instance
@@ -357,11 +386,6 @@ class URLIndexPrivateData
 
   // End of data members that are cached ---------------------------------------
 
-  // For unit testing only. Specifies the version of the cache file to be saved.
-  // Used only for testing upgrading of an older version of the cache upon
-  // restore.
-  int saved_cache_version_;
-
   // Used for unit testing only. Records the number of candidate history items
   // at three stages in the index searching process.
   size_t pre_filter_item_count_;    // After word index is queried.
@@ -11,6 +11,7 @@
 
 #include "base/logging.h"
 #include "base/string_number_conversions.h"
+#include "chrome/browser/history/history_database_util.h"
 #include "chrome/browser/history/url_database.h"
 #include "chrome/browser/history/visit_filter.h"
 #include "chrome/common/url_constants.h"
@@ -187,6 +188,29 @@ void VisitDatabase::DeleteVisit(const VisitRow& visit) {
   del.Run();
 }
 
+void VisitDatabase::DeleteVisits(const VisitVector& visits) {
+  // Patch around the visits first, in order, as DeleteVisit would.
+  for (size_t i = 0; i < visits.size(); ++i) {
+    sql::Statement update_chain(GetDB().GetCachedStatement(SQL_FROM_HERE,
+        "UPDATE visits SET from_visit=? WHERE from_visit=?"));
+    update_chain.BindInt64(0, visits[i].referring_visit);
+    update_chain.BindInt64(1, visits[i].visit_id);
+    if (!update_chain.Run())
+      return;
+  }
+
+  // Then delete the visits and their sources in batches.
+  std::vector<int64> ids;
+  ids.reserve(visits.size());
+  for (size_t i = 0; i < visits.size(); ++i)
+    ids.push_back(visits[i].visit_id);
+  if (!ExecuteForIdsInBatches(&GetDB(), "DELETE FROM visits WHERE id IN ",
+                              ids, std::string()))
+    return;
+  ExecuteForIdsInBatches(&GetDB(), "DELETE FROM visit_source WHERE id IN ",
+                         ids, std::string());
+}
+
 bool VisitDatabase::GetRowForVisit(VisitID visit_id, VisitRow* out_visit) {
   sql::Statement statement(GetDB().GetCachedStatement(SQL_FROM_HERE,
       "SELECT" HISTORY_VISIT_ROW_FIELDS "FROM visits WHERE id=?"));
@@ -44,6 +44,10 @@ class VisitDatabase {
   // doesn't exist, it will not do anything.
   void DeleteVisit(const VisitRow& visit);
 
+  // Deletes the given visits, as DeleteVisit does for each of them in turn,
+  // but removing the rows with a few statements for the whole list.
+  void DeleteVisits(const VisitVector& visits);
+
   // Query a VisitInfo giving an visit id, filling the given VisitRow.
   // Returns true on success.
   bool GetRowForVisit(VisitID visit_id, VisitRow* out_visit);
@@ -134,6 +134,41 @@ TEST_F(VisitDatabaseTest, Delete) {
               IsVisitInfoEqual(matches[1], visit_info3));
 }
 
+TEST_F(VisitDatabaseTest, DeleteVisits) {
+  // Add a chain of four visits, the second of which has a source, and delete
+  // the middle two. The outer two should be left, linked to each other.
+  VisitRow visit_info1(1, Time::FromInternalValue(1000), 0,
+                       content::PAGE_TRANSITION_LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info1, SOURCE_BROWSED));
+  VisitRow visit_info2(1, Time::FromInternalValue(1001),
+                       visit_info1.visit_id, content::PAGE_TRANSITION_LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info2, SOURCE_SYNCED));
+  VisitRow visit_info3(1, Time::FromInternalValue(1002),
+                       visit_info2.visit_id, content::PAGE_TRANSITION_LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info3, SOURCE_BROWSED));
+  VisitRow visit_info4(1, Time::FromInternalValue(1003),
+                       visit_info3.visit_id, content::PAGE_TRANSITION_LINK, 0);
+  EXPECT_TRUE(AddVisit(&visit_info4, SOURCE_BROWSED));
+
+  VisitVector deleted_visits;
+  deleted_visits.push_back(visit_info2);
+  visit_info3.referring_visit = visit_info1.visit_id;
+  deleted_visits.push_back(visit_info3);
+  DeleteVisits(deleted_visits);
+
+  visit_info4.referring_visit = visit_info1.visit_id;
+  std::vector<VisitRow> matches;
+  EXPECT_TRUE(GetVisitsForURL(visit_info1.url_id, &matches));
+  ASSERT_EQ(2U, matches.size());
+  EXPECT_TRUE(IsVisitInfoEqual(matches[0], visit_info1) &&
+              IsVisitInfoEqual(matches[1], visit_info4));
+
+  // The source of the deleted visit went with it.
+  VisitSourceMap sources;
+  GetVisitsSource(deleted_visits, &sources);
+  EXPECT_TRUE(sources.empty());
+}
+
 TEST_F(VisitDatabaseTest, Update) {
   // Make something in the database.
   VisitRow original(1, Time::Now(), 23, content::PageTransitionFromInt(0), 19);
@@ -14,6 +14,7 @@
 #include "base/stl_util.h"
 #include "base/string_util.h"
 #include "base/utf_string_conversions.h"
+#include "chrome/browser/history/history_database_util.h"
 #include "chrome/browser/history/page_usage_data.h"
 #include "sql/statement.h"
 
@@ -338,4 +339,18 @@ bool VisitSegmentDatabase::DeleteSegmentForURL(URLID url_id) {
   return delete_seg.Run();
 }
 
+bool VisitSegmentDatabase::DeleteSegmentsForURLs(
+    const std::vector<URLID>& url_ids) {
+  if (!ExecuteForIdsInBatches(
+          &GetDB(),
+          "DELETE FROM segment_usage WHERE segment_id IN "
+          "(SELECT id FROM segments WHERE url_id IN ",
+          url_ids, ")"))
+    return false;
+
+  return ExecuteForIdsInBatches(
+      &GetDB(), "DELETE FROM segments WHERE url_id IN ", url_ids,
+      std::string());
+}
+
 }  // namespace history
@@ -69,6 +69,10 @@ class VisitSegmentDatabase {
   // This will also delete any associated segment usage data.
   bool DeleteSegmentForURL(URLID url_id);
 
+  // Deletes the segments of all of |url_ids|, as DeleteSegmentForURL does, in
+  // batches.
+  bool DeleteSegmentsForURLs(const std::vector<URLID>& url_ids);
+
  protected:
   // Returns the database for the functions in this interface.
   virtual sql::Connection& GetDB() = 0;
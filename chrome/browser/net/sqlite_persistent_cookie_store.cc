@@ -12,6 +12,7 @@
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/callback.h"
+#include "base/command_line.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/logging.h"
@@ -25,6 +26,7 @@
 #include "base/time.h"
 #include "chrome/browser/diagnostics/sqlite_diagnostics.h"
 #include "chrome/browser/net/clear_on_exit_policy.h"
+#include "chrome/common/chrome_switches.h"
 #include "content/public/browser/browser_thread.h"
 #include "googleurl/src/gurl.h"
 #include "net/base/registry_controlled_domain.h"
@@ -501,6 +503,8 @@ bool SQLitePersistentCookieStore::Backend::InitializeDatabase() {
   }
 
   db_->set_error_delegate(GetErrorHandlerForCookieDb());
+  db_->set_profiling_enabled(CommandLine::ForCurrentProcess()->HasSwitch(
+      switches::kEnableSQLProfiling));
 
   if (!EnsureDatabaseVersion() || !InitTable(db_.get())) {
     NOTREACHED() << "Unable to open cookie DB.";
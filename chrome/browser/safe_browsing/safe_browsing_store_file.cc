@@ -4,30 +4,69 @@
 
 #include "chrome/browser/safe_browsing/safe_browsing_store_file.h"
 
+#include <algorithm>
+
 #include "base/md5.h"
 #include "base/metrics/histogram.h"
+#include "base/time.h"
 
 namespace {
 
 // NOTE(shess): kFileMagic should not be a byte-wise palindrome, so
 // that byte-order changes force corruption.
 const int32 kFileMagic = 0x600D71FE;
-const int32 kFileVersion = 7;  // SQLite storage was 6...
+const int32 kFileVersion = 8;  // SQLite storage was 6...
+
+// The unsharded format, which is converted on the next update.
+const int32 kLegacyFileVersion = 7;
+
+// Shards are chosen by the top bits of the add prefix.
+const int kShardShift = 28;
+COMPILE_ASSERT(SafeBrowsingStoreFile::kShardCount == 1 << (32 - kShardShift),
+               shard_shift_does_not_match_shard_count);
 
 // Header at the front of the main database file.
 struct FileHeader {
   int32 magic, version;
   uint32 add_chunk_count, sub_chunk_count;
-  uint32 add_prefix_count, sub_prefix_count;
-  uint32 add_hash_count, sub_hash_count;
 };
 
-// Header for each chunk in the chunk-accumulation file.
+// Header for each chunk in the chunk-accumulation file.  In the
+// legacy format, also follows the FileHeader to give the counts of
+// the data in the main file.
 struct ChunkHeader {
   uint32 add_prefix_count, sub_prefix_count;
   uint32 add_hash_count, sub_hash_count;
 };
 
+// Entry for each shard in the index of the main file.
+struct ShardHeader {
+  ChunkHeader counts;
+  base::MD5Digest digest;
+};
+
+// The data of one shard.
+struct ShardData {
+  SBAddPrefixes add_prefixes;
+  std::vector<SBSubPrefix> sub_prefixes;
+  std::vector<SBAddFullHash> add_full_hashes;
+  std::vector<SBSubFullHash> sub_full_hashes;
+};
+
+// Returns the shard holding the items for |prefix|.
+size_t ShardForPrefix(SBPrefix prefix) {
+  return static_cast<uint32>(prefix) >> kShardShift;
+}
+
+// Returns the size of data described by |counts|.
+int64 DataSize(const ChunkHeader& counts) {
+  int64 size = counts.add_prefix_count * sizeof(SBAddPrefix);
+  size += counts.sub_prefix_count * sizeof(SBSubPrefix);
+  size += counts.add_hash_count * sizeof(SBAddFullHash);
+  size += counts.sub_hash_count * sizeof(SBSubFullHash);
+  return size;
+}
+
 // Rewind the file.  Using fseek(2) because rewind(3) errors are
 // weird.
 bool FileRewind(FILE* fp) {
@@ -118,6 +157,47 @@ bool WriteContainer(const CT& values, FILE* fp,
   return true;
 }
 
+// Append each item in |items| to the |member| container of the shard
+// for its add prefix, and mark that shard in |touched|.
+template <typename CT>
+void DistributeToShards(const CT& items,
+                        CT ShardData::* member,
+                        std::vector<ShardData>* shards,
+                        std::vector<bool>* touched) {
+  for (typename CT::const_iterator iter = items.begin();
+       iter != items.end(); ++iter) {
+    const size_t shard = ShardForPrefix(iter->GetAddPrefix());
+    ((*shards)[shard].*member).push_back(*iter);
+    (*touched)[shard] = true;
+  }
+}
+
+// Returns true if any of |items| is from a chunk in |deleted|.
+template <typename CT>
+bool ContainsDeletedChunk(const CT& items,
+                          const base::hash_set<int32>& deleted) {
+  if (deleted.empty())
+    return false;
+
+  for (typename CT::const_iterator iter = items.begin();
+       iter != items.end(); ++iter) {
+    if (deleted.count(iter->chunk_id) > 0)
+      return true;
+  }
+  return false;
+}
+
+// Merge the sorted |more| into the sorted |values|.  Shards are
+// merged this way so that the results come out in the order
+// SBProcessSubs() sorted them, as they did before sharding.
+template <typename CT, typename LessT>
+void MergeSorted(const CT& more, LessT less, CT* values) {
+  const size_t size = values->size();
+  values->insert(values->end(), more.begin(), more.end());
+  std::inplace_merge(values->begin(), values->begin() + size, values->end(),
+                     less);
+}
+
 // Delete the chunks in |deleted| from |chunks|.
 void DeleteChunksFromSet(const base::hash_set<int32>& deleted,
                          std::set<int32>* chunks) {
@@ -132,8 +212,10 @@ void DeleteChunksFromSet(const base::hash_set<int32>& deleted,
 // Sanity-check the header against the file's size to make sure our
 // vectors aren't gigantic.  This doubles as a cheap way to detect
 // corruption without having to checksum the entire file.
+// |legacy_counts| is only used for the legacy format.
 bool FileHeaderSanityCheck(const FilePath& filename,
-                           const FileHeader& header) {
+                           const FileHeader& header,
+                           const ChunkHeader& legacy_counts) {
   int64 size = 0;
   if (!file_util::GetFileSize(filename, &size))
     return false;
@@ -141,10 +223,12 @@ bool FileHeaderSanityCheck(const FilePath& filename,
   int64 expected_size = sizeof(FileHeader);
   expected_size += header.add_chunk_count * sizeof(int32);
   expected_size += header.sub_chunk_count * sizeof(int32);
-  expected_size += header.add_prefix_count * sizeof(SBAddPrefix);
-  expected_size += header.sub_prefix_count * sizeof(SBSubPrefix);
-  expected_size += header.add_hash_count * sizeof(SBAddFullHash);
-  expected_size += header.sub_hash_count * sizeof(SBSubFullHash);
+  if (header.version == kLegacyFileVersion) {
+    expected_size += sizeof(ChunkHeader);
+    expected_size += DataSize(legacy_counts);
+  } else {
+    expected_size += SafeBrowsingStoreFile::kShardCount * sizeof(ShardHeader);
+  }
   expected_size += sizeof(base::MD5Digest);
   if (size != expected_size)
     return false;
@@ -152,21 +236,135 @@ bool FileHeaderSanityCheck(const FilePath& filename,
   return true;
 }
 
-// This a helper function that reads header to |header|. Returns true if the
-// magic number is correct and santiy check passes.
+// This a helper function that reads header to |header|, and for the
+// legacy format the counts which follow it to |legacy_counts|.
+// Returns true if the magic number is correct and santiy check
+// passes.
 bool ReadAndVerifyHeader(const FilePath& filename,
                          FILE* fp,
                          FileHeader* header,
+                         ChunkHeader* legacy_counts,
                          base::MD5Context* context) {
   if (!ReadItem(header, fp, context))
     return false;
-  if (header->magic != kFileMagic || header->version != kFileVersion)
+  if (header->magic != kFileMagic)
     return false;
-  if (!FileHeaderSanityCheck(filename, *header))
+  if (header->version == kLegacyFileVersion) {
+    if (!ReadItem(legacy_counts, fp, context))
+      return false;
+  } else if (header->version != kFileVersion) {
+    return false;
+  }
+  if (!FileHeaderSanityCheck(filename, *header, *legacy_counts))
     return false;
   return true;
 }
 
+// Opens the file of the shard described by |header| for reading,
+// after checking that its size matches.  Returns NULL on failure.
+FILE* OpenShardFile(const FilePath& filename, const ShardHeader& header) {
+  int64 size = 0;
+  if (!file_util::GetFileSize(filename, &size) ||
+      size != DataSize(header.counts))
+    return NULL;
+
+  return file_util::OpenFile(filename, "rb");
+}
+
+// Fold the next |bytes| of |fp| into the checksum in |context|.
+// Returns false if the file ends first.
+bool FoldFileIntoChecksum(size_t bytes, FILE* fp, base::MD5Context* context) {
+  while (bytes > 0) {
+    char buf[4096];
+    const size_t c = std::min(sizeof(buf), bytes);
+    const size_t ret = fread(buf, 1, c, fp);
+
+    // The file's size changed while reading, give up.
+    if (ret != c)
+      return false;
+    base::MD5Update(context, base::StringPiece(buf, c));
+    bytes -= c;
+  }
+  return true;
+}
+
+// Checks the file of the shard described by |header| against its
+// checksum, without parsing its items.
+bool VerifyShard(const FilePath& filename, const ShardHeader& header) {
+  if (!DataSize(header.counts))
+    return true;
+
+  file_util::ScopedFILE file(OpenShardFile(filename, header));
+  if (file.get() == NULL)
+    return false;
+
+  base::MD5Context context;
+  base::MD5Init(&context);
+  if (!FoldFileIntoChecksum(static_cast<size_t>(DataSize(header.counts)),
+                            file.get(), &context))
+    return false;
+
+  base::MD5Digest digest;
+  base::MD5Final(&digest, &context);
+  return 0 == memcmp(&digest, &header.digest, sizeof(digest));
+}
+
+// Read the shard described by |header| from |filename|, appending its
+// items to |shard|.  Returns false if the file does not match its
+// checksum.
+bool ReadShard(const FilePath& filename,
+               const ShardHeader& header,
+               ShardData* shard) {
+  // Nothing was written for shards which never held data.
+  if (!DataSize(header.counts))
+    return true;
+
+  file_util::ScopedFILE file(OpenShardFile(filename, header));
+  if (file.get() == NULL)
+    return false;
+
+  base::MD5Context context;
+  base::MD5Init(&context);
+  if (!ReadToContainer(&shard->add_prefixes, header.counts.add_prefix_count,
+                       file.get(), &context) ||
+      !ReadToContainer(&shard->sub_prefixes, header.counts.sub_prefix_count,
+                       file.get(), &context) ||
+      !ReadToContainer(&shard->add_full_hashes, header.counts.add_hash_count,
+                       file.get(), &context) ||
+      !ReadToContainer(&shard->sub_full_hashes, header.counts.sub_hash_count,
+                       file.get(), &context))
+    return false;
+
+  base::MD5Digest digest;
+  base::MD5Final(&digest, &context);
+  return 0 == memcmp(&digest, &header.digest, sizeof(digest));
+}
+
+// Write |shard| to |filename|, and describe it in |header|.  Returns
+// true on success.
+bool WriteShard(const FilePath& filename,
+                const ShardData& shard,
+                ShardHeader* header) {
+  file_util::ScopedFILE file(file_util::OpenFile(filename, "wb"));
+  if (file.get() == NULL)
+    return false;
+
+  base::MD5Context context;
+  base::MD5Init(&context);
+  if (!WriteContainer(shard.add_prefixes, file.get(), &context) ||
+      !WriteContainer(shard.sub_prefixes, file.get(), &context) ||
+      !WriteContainer(shard.add_full_hashes, file.get(), &context) ||
+      !WriteContainer(shard.sub_full_hashes, file.get(), &context))
+    return false;
+
+  header->counts.add_prefix_count = shard.add_prefixes.size();
+  header->counts.sub_prefix_count = shard.sub_prefixes.size();
+  header->counts.add_hash_count = shard.add_full_hashes.size();
+  header->counts.sub_hash_count = shard.sub_full_hashes.size();
+  base::MD5Final(&header->digest, &context);
+  return true;
+}
+
 }  // namespace
 
 // static
@@ -200,6 +398,18 @@ void SafeBrowsingStoreFile::CheckForOriginalAndDelete(
   }
 }
 
+// static
+const size_t SafeBrowsingStoreFile::kShardCount;
+
+// static
+const FilePath SafeBrowsingStoreFile::ShardFileForFilename(
+    const FilePath& filename, size_t shard) {
+  DCHECK_LT(shard, kShardCount);
+  FilePath::StringType suffix(FILE_PATH_LITERAL("_shard_"));
+  suffix.push_back(static_cast<FilePath::CharType>("0123456789abcdef"[shard]));
+  return FilePath(filename.value() + suffix);
+}
+
 SafeBrowsingStoreFile::SafeBrowsingStoreFile()
     : chunks_written_(0),
       file_(NULL),
@@ -232,6 +442,19 @@ bool SafeBrowsingStoreFile::Delete() {
     return false;
   }
 
+  for (size_t i = 0; i < kShardCount; ++i) {
+    const FilePath shard_filename = ShardFileForFilename(filename_, i);
+    const FilePath new_shard_filename =
+        TemporaryFileForFilename(shard_filename);
+    if ((!file_util::Delete(shard_filename, false) &&
+         file_util::PathExists(shard_filename)) ||
+        (!file_util::Delete(new_shard_filename, false) &&
+         file_util::PathExists(new_shard_filename))) {
+      NOTREACHED();
+      return false;
+    }
+  }
+
   // With SQLite support gone, one way to get to this code is if the
   // existing file is a SQLite file.  Make sure the journal file is
   // also removed.
@@ -269,17 +492,8 @@ bool SafeBrowsingStoreFile::CheckValidity() {
   bytes_left -= sizeof(base::MD5Digest);
 
   // Fold the contents of the file into the checksum.
-  while (bytes_left > 0) {
-    char buf[4096];
-    const size_t c = std::min(sizeof(buf), bytes_left);
-    const size_t ret = fread(buf, 1, c, file_.get());
-
-    // The file's size changed while reading, give up.
-    if (ret != c)
-      return OnCorruptDatabase();
-    base::MD5Update(&context, base::StringPiece(buf, c));
-    bytes_left -= c;
-  }
+  if (!FoldFileIntoChecksum(bytes_left, file_.get(), &context))
+    return OnCorruptDatabase();
 
   // Calculate the digest to this point.
   base::MD5Digest calculated_digest;
@@ -294,6 +508,34 @@ bool SafeBrowsingStoreFile::CheckValidity() {
     return OnCorruptDatabase();
   }
 
+  // The main file only holds the checksums of the shards, so check
+  // each shard file against its own.
+  if (!FileRewind(file_.get()))
+    return OnCorruptDatabase();
+
+  FileHeader header;
+  ChunkHeader legacy_counts = { 0, 0, 0, 0 };
+  if (!ReadAndVerifyHeader(filename_, file_.get(), &header, &legacy_counts,
+                           NULL))
+    return OnCorruptDatabase();
+  if (header.version == kLegacyFileVersion)
+    return true;
+
+  if (!FileSkip(header.add_chunk_count * sizeof(int32) +
+                header.sub_chunk_count * sizeof(int32), file_.get()))
+    return OnCorruptDatabase();
+
+  std::vector<ShardHeader> shard_headers;
+  if (!ReadToContainer(&shard_headers, kShardCount, file_.get(), NULL))
+    return OnCorruptDatabase();
+
+  for (size_t i = 0; i < kShardCount; ++i) {
+    if (!VerifyShard(ShardFileForFilename(filename_, i), shard_headers[i])) {
+      RecordFormatEvent(FORMAT_EVENT_VALIDITY_CHECKSUM_FAILURE);
+      return OnCorruptDatabase();
+    }
+  }
+
   return true;
 }
 
@@ -321,7 +563,9 @@ bool SafeBrowsingStoreFile::GetAddPrefixes(SBAddPrefixes* add_prefixes) {
   if (file.get() == NULL) return false;
 
   FileHeader header;
-  if (!ReadAndVerifyHeader(filename_, file.get(), &header, NULL))
+  ChunkHeader legacy_counts = { 0, 0, 0, 0 };
+  if (!ReadAndVerifyHeader(filename_, file.get(), &header, &legacy_counts,
+                           NULL))
     return OnCorruptDatabase();
 
   size_t add_prefix_offset = header.add_chunk_count * sizeof(int32) +
@@ -329,9 +573,29 @@ bool SafeBrowsingStoreFile::GetAddPrefixes(SBAddPrefixes* add_prefixes) {
   if (!FileSkip(add_prefix_offset, file.get()))
     return false;
 
-  if (!ReadToContainer(add_prefixes, header.add_prefix_count, file.get(), NULL))
+  if (header.version == kLegacyFileVersion) {
+    return ReadToContainer(add_prefixes, legacy_counts.add_prefix_count,
+                           file.get(), NULL);
+  }
+
+  std::vector<ShardHeader> shard_headers;
+  if (!ReadToContainer(&shard_headers, kShardCount, file.get(), NULL))
     return false;
 
+  // The whole shard is read so that it can be checked against its
+  // checksum.
+  for (size_t i = 0; i < kShardCount; ++i) {
+    if (!shard_headers[i].counts.add_prefix_count)
+      continue;
+
+    ShardData shard;
+    if (!ReadShard(ShardFileForFilename(filename_, i), shard_headers[i],
+                   &shard))
+      return OnCorruptDatabase();
+    MergeSorted(shard.add_prefixes, SBAddPrefixLess<SBAddPrefix,SBAddPrefix>,
+                add_prefixes);
+  }
+
   return true;
 }
 
@@ -343,21 +607,50 @@ bool SafeBrowsingStoreFile::GetAddFullHashes(
   if (file.get() == NULL) return false;
 
   FileHeader header;
-  if (!ReadAndVerifyHeader(filename_, file.get(), &header, NULL))
+  ChunkHeader legacy_counts = { 0, 0, 0, 0 };
+  if (!ReadAndVerifyHeader(filename_, file.get(), &header, &legacy_counts,
+                           NULL))
     return OnCorruptDatabase();
 
   size_t offset =
       header.add_chunk_count * sizeof(int32) +
-      header.sub_chunk_count * sizeof(int32) +
-      header.add_prefix_count * sizeof(SBAddPrefix) +
-      header.sub_prefix_count * sizeof(SBSubPrefix);
+      header.sub_chunk_count * sizeof(int32);
+
+  if (header.version == kLegacyFileVersion) {
+    offset += legacy_counts.add_prefix_count * sizeof(SBAddPrefix) +
+        legacy_counts.sub_prefix_count * sizeof(SBSubPrefix);
+    if (!FileSkip(offset, file.get()))
+      return false;
+
+    return ReadToContainer(add_full_hashes,
+                           legacy_counts.add_hash_count,
+                           file.get(),
+                           NULL);
+  }
+
   if (!FileSkip(offset, file.get()))
     return false;
 
-  return ReadToContainer(add_full_hashes,
-                         header.add_hash_count,
-                         file.get(),
-                         NULL);
+  std::vector<ShardHeader> shard_headers;
+  if (!ReadToContainer(&shard_headers, kShardCount, file.get(), NULL))
+    return false;
+
+  // The whole shard is read so that it can be checked against its
+  // checksum.
+  for (size_t i = 0; i < kShardCount; ++i) {
+    if (!shard_headers[i].counts.add_hash_count)
+      continue;
+
+    ShardData shard;
+    if (!ReadShard(ShardFileForFilename(filename_, i), shard_headers[i],
+                   &shard))
+      return OnCorruptDatabase();
+    MergeSorted(shard.add_full_hashes,
+                SBAddPrefixHashLess<SBAddFullHash,SBAddFullHash>,
+                add_full_hashes);
+  }
+
+  return true;
 }
 
 bool SafeBrowsingStoreFile::WriteAddHash(int32 chunk_id,
@@ -442,7 +735,9 @@ bool SafeBrowsingStoreFile::BeginUpdate() {
   if (!ReadItem(&header, file.get(), NULL))
       return OnCorruptDatabase();
 
-  if (header.magic != kFileMagic || header.version != kFileVersion) {
+  if (header.magic != kFileMagic ||
+      (header.version != kFileVersion &&
+       header.version != kLegacyFileVersion)) {
     if (!strcmp(reinterpret_cast<char*>(&header.magic), "SQLite format 3")) {
       RecordFormatEvent(FORMAT_EVENT_FOUND_SQLITE);
     } else {
@@ -455,9 +750,14 @@ bool SafeBrowsingStoreFile::BeginUpdate() {
     return OnCorruptDatabase();
   }
 
+  ChunkHeader legacy_counts = { 0, 0, 0, 0 };
+  if (header.version == kLegacyFileVersion &&
+      !ReadItem(&legacy_counts, file.get(), NULL))
+    return OnCorruptDatabase();
+
   // TODO(shess): Under POSIX it is possible that this could size a
   // file different from the file which was opened.
-  if (!FileHeaderSanityCheck(filename_, header))
+  if (!FileHeaderSanityCheck(filename_, header, legacy_counts))
     return OnCorruptDatabase();
 
   // Pull in the chunks-seen data for purposes of implementing
@@ -509,12 +809,15 @@ bool SafeBrowsingStoreFile::DoUpdate(
   CHECK(add_prefixes_result);
   CHECK(add_full_hashes_result);
 
-  SBAddPrefixes add_prefixes;
-  std::vector<SBSubPrefix> sub_prefixes;
-  std::vector<SBAddFullHash> add_full_hashes;
-  std::vector<SBSubFullHash> sub_full_hashes;
+  const base::TimeTicks before = base::TimeTicks::Now();
+
+  // The new data for each shard, and the index of the shards as
+  // stored.  Shards touched by the update are marked in |dirty|.
+  std::vector<ShardData> shards(kShardCount);
+  std::vector<ShardHeader> shard_headers(kShardCount);
+  std::vector<bool> dirty(kShardCount, false);
 
-  // Read original data into the vectors.
+  // Read the chunks-seen data and the shard index of the original file.
   if (!empty_) {
     DCHECK(file_.get());
 
@@ -526,7 +829,9 @@ bool SafeBrowsingStoreFile::DoUpdate(
 
     // Read the file header and make sure it looks right.
     FileHeader header;
-    if (!ReadAndVerifyHeader(filename_, file_.get(), &header, &context))
+    ChunkHeader legacy_counts = { 0, 0, 0, 0 };
+    if (!ReadAndVerifyHeader(filename_, file_.get(), &header, &legacy_counts,
+                             &context))
       return OnCorruptDatabase();
 
     // Re-read the chunks-seen data to get to the later data in the
@@ -538,15 +843,38 @@ bool SafeBrowsingStoreFile::DoUpdate(
                          file_.get(), &context))
       return OnCorruptDatabase();
 
-    if (!ReadToContainer(&add_prefixes, header.add_prefix_count,
-                         file_.get(), &context) ||
-        !ReadToContainer(&sub_prefixes, header.sub_prefix_count,
-                         file_.get(), &context) ||
-        !ReadToContainer(&add_full_hashes, header.add_hash_count,
-                         file_.get(), &context) ||
-        !ReadToContainer(&sub_full_hashes, header.sub_hash_count,
-                         file_.get(), &context))
-      return OnCorruptDatabase();
+    if (header.version == kLegacyFileVersion) {
+      // Sort the unsharded data into the shards, which are then
+      // written out.
+      ShardData legacy_data;
+      if (!ReadToContainer(&legacy_data.add_prefixes,
+                           legacy_counts.add_prefix_count,
+                           file_.get(), &context) ||
+          !ReadToContainer(&legacy_data.sub_prefixes,
+                           legacy_counts.sub_prefix_count,
+                           file_.get(), &context) ||
+          !ReadToContainer(&legacy_data.add_full_hashes,
+                           legacy_counts.add_hash_count,
+                           file_.get(), &context) ||
+          !ReadToContainer(&legacy_data.sub_full_hashes,
+                           legacy_counts.sub_hash_count,
+                           file_.get(), &context))
+        return OnCorruptDatabase();
+
+      DistributeToShards(legacy_data.add_prefixes, &ShardData::add_prefixes,
+                         &shards, &dirty);
+      DistributeToShards(legacy_data.sub_prefixes, &ShardData::sub_prefixes,
+                         &shards, &dirty);
+      DistributeToShards(legacy_data.add_full_hashes,
+                         &ShardData::add_full_hashes, &shards, &dirty);
+      DistributeToShards(legacy_data.sub_full_hashes,
+                         &ShardData::sub_full_hashes, &shards, &dirty);
+    } else {
+      shard_headers.clear();
+      if (!ReadToContainer(&shard_headers, kShardCount, file_.get(),
+                           &context))
+        return OnCorruptDatabase();
+    }
 
     // Calculate the digest to this point.
     base::MD5Digest calculated_digest;
@@ -582,7 +910,7 @@ bool SafeBrowsingStoreFile::DoUpdate(
   UMA_HISTOGRAM_COUNTS("SB2.DatabaseUpdateKilobytes",
                        std::max(static_cast<int>(size / 1024), 1));
 
-  // Append the accumulated chunks onto the vectors read from |file_|.
+  // Sort the accumulated chunks into the shards they touch.
   for (int i = 0; i < chunks_written_; ++i) {
     ChunkHeader header;
 
@@ -595,50 +923,97 @@ bool SafeBrowsingStoreFile::DoUpdate(
 
     // As a safety measure, make sure that the header describes a sane
     // chunk, given the remaining file size.
-    int64 expected_size = ofs + sizeof(ChunkHeader);
-    expected_size += header.add_prefix_count * sizeof(SBAddPrefix);
-    expected_size += header.sub_prefix_count * sizeof(SBSubPrefix);
-    expected_size += header.add_hash_count * sizeof(SBAddFullHash);
-    expected_size += header.sub_hash_count * sizeof(SBSubFullHash);
+    int64 expected_size = ofs + sizeof(ChunkHeader) + DataSize(header);
     if (expected_size > size)
       return false;
 
-    // TODO(shess): If the vectors were kept sorted, then this code
-    // could use std::inplace_merge() to merge everything together in
-    // sorted order.  That might still be slower than just sorting at
-    // the end if there were a large number of chunks.  In that case
-    // some sort of recursive binary merge might be in order (merge
-    // chunks pairwise, merge those chunks pairwise, and so on, then
-    // merge the result with the main list).
-    if (!ReadToContainer(&add_prefixes, header.add_prefix_count,
+    ShardData chunk;
+    if (!ReadToContainer(&chunk.add_prefixes, header.add_prefix_count,
                          new_file_.get(), NULL) ||
-        !ReadToContainer(&sub_prefixes, header.sub_prefix_count,
+        !ReadToContainer(&chunk.sub_prefixes, header.sub_prefix_count,
                          new_file_.get(), NULL) ||
-        !ReadToContainer(&add_full_hashes, header.add_hash_count,
+        !ReadToContainer(&chunk.add_full_hashes, header.add_hash_count,
                          new_file_.get(), NULL) ||
-        !ReadToContainer(&sub_full_hashes, header.sub_hash_count,
+        !ReadToContainer(&chunk.sub_full_hashes, header.sub_hash_count,
                          new_file_.get(), NULL))
       return false;
+
+    DistributeToShards(chunk.add_prefixes, &ShardData::add_prefixes,
+                       &shards, &dirty);
+    DistributeToShards(chunk.sub_prefixes, &ShardData::sub_prefixes,
+                       &shards, &dirty);
+    DistributeToShards(chunk.add_full_hashes, &ShardData::add_full_hashes,
+                       &shards, &dirty);
+    DistributeToShards(chunk.sub_full_hashes, &ShardData::sub_full_hashes,
+                       &shards, &dirty);
   }
 
-  // Append items from |pending_adds|.
-  add_full_hashes.insert(add_full_hashes.end(),
-                         pending_adds.begin(), pending_adds.end());
+  // Add items from |pending_adds|.
+  DistributeToShards(pending_adds, &ShardData::add_full_hashes,
+                     &shards, &dirty);
+
+  // Bring each shard up to date, one at a time.  Shards which neither
+  // new data nor deleted chunks touch were already processed when they
+  // were written, and are only read to return their contents.
+  SBAddPrefixes add_prefixes;
+  std::vector<SBAddFullHash> add_full_hashes;
+  size_t sub_prefix_count = 0;
+  size_t shards_written = 0;
+  int64 bytes_written = 0;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    ShardData& shard = shards[i];
+    const FilePath shard_filename = ShardFileForFilename(filename_, i);
+    if (!ReadShard(shard_filename, shard_headers[i], &shard)) {
+      RecordFormatEvent(FORMAT_EVENT_UPDATE_CHECKSUM_FAILURE);
+      return OnCorruptDatabase();
+    }
+
+    if (!dirty[i]) {
+      dirty[i] =
+          ContainsDeletedChunk(shard.add_prefixes, add_del_cache_) ||
+          ContainsDeletedChunk(shard.sub_prefixes, sub_del_cache_) ||
+          ContainsDeletedChunk(shard.add_full_hashes, add_del_cache_) ||
+          ContainsDeletedChunk(shard.sub_full_hashes, sub_del_cache_);
+    }
+
+    if (dirty[i]) {
+      // Knock the subs from the adds and process deleted chunks.  Since
+      // a sub is in the shard of the add it refers to, this gives the
+      // same result as processing the whole store at once.
+      SBProcessSubs(&shard.add_prefixes, &shard.sub_prefixes,
+                    &shard.add_full_hashes, &shard.sub_full_hashes,
+                    add_del_cache_, sub_del_cache_);
+
+      if (!WriteShard(TemporaryFileForFilename(shard_filename), shard,
+                      &shard_headers[i]))
+        return false;
+      ++shards_written;
+      bytes_written += DataSize(shard_headers[i].counts);
+    }
+
+    sub_prefix_count += shard.sub_prefixes.size();
+    MergeSorted(shard.add_prefixes, SBAddPrefixLess<SBAddPrefix,SBAddPrefix>,
+                &add_prefixes);
+    MergeSorted(shard.add_full_hashes,
+                SBAddPrefixHashLess<SBAddFullHash,SBAddFullHash>,
+                &add_full_hashes);
+
+    // Release the memory of the shard before loading the next one.
+    SBAddPrefixes().swap(shard.add_prefixes);
+    std::vector<SBSubPrefix>().swap(shard.sub_prefixes);
+    std::vector<SBAddFullHash>().swap(shard.add_full_hashes);
+    std::vector<SBSubFullHash>().swap(shard.sub_full_hashes);
+  }
 
   // Check how often a prefix was checked which wasn't in the
   // database.
   SBCheckPrefixMisses(add_prefixes, prefix_misses);
 
-  // Knock the subs from the adds and process deleted chunks.
-  SBProcessSubs(&add_prefixes, &sub_prefixes,
-                &add_full_hashes, &sub_full_hashes,
-                add_del_cache_, sub_del_cache_);
-
   // We no longer need to track deleted chunks.
   DeleteChunksFromSet(add_del_cache_, &add_chunks_cache_);
   DeleteChunksFromSet(sub_del_cache_, &sub_chunks_cache_);
 
-  // Write the new data to new_file_.
+  // Write the new chunks-seen data and shard index to new_file_.
   if (!FileRewind(new_file_.get()))
     return false;
 
@@ -651,20 +1026,12 @@ bool SafeBrowsingStoreFile::DoUpdate(
   header.version = kFileVersion;
   header.add_chunk_count = add_chunks_cache_.size();
   header.sub_chunk_count = sub_chunks_cache_.size();
-  header.add_prefix_count = add_prefixes.size();
-  header.sub_prefix_count = sub_prefixes.size();
-  header.add_hash_count = add_full_hashes.size();
-  header.sub_hash_count = sub_full_hashes.size();
   if (!WriteItem(header, new_file_.get(), &context))
     return false;
 
-  // Write all the chunk data.
   if (!WriteContainer(add_chunks_cache_, new_file_.get(), &context) ||
       !WriteContainer(sub_chunks_cache_, new_file_.get(), &context) ||
-      !WriteContainer(add_prefixes, new_file_.get(), &context) ||
-      !WriteContainer(sub_prefixes, new_file_.get(), &context) ||
-      !WriteContainer(add_full_hashes, new_file_.get(), &context) ||
-      !WriteContainer(sub_full_hashes, new_file_.get(), &context))
+      !WriteContainer(shard_headers, new_file_.get(), &context))
     return false;
 
   // Write the checksum at the end.
@@ -677,8 +1044,28 @@ bool SafeBrowsingStoreFile::DoUpdate(
   if (!file_util::TruncateFile(new_file_.get()))
     return false;
 
-  // Close the file handle and swizzle the file into place.
+  int64 index_size = ftell(new_file_.get());
+  if (index_size > 0)
+    bytes_written += index_size;
+
+  // Close the file handle and swizzle the files into place.  The shards
+  // go first.  If the main file is not replaced after them, their
+  // checksums will not match and the store will be reset.
   new_file_.reset();
+  for (size_t i = 0; i < kShardCount; ++i) {
+    if (!dirty[i])
+      continue;
+
+    const FilePath shard_filename = ShardFileForFilename(filename_, i);
+    if (!file_util::Delete(shard_filename, false) &&
+        file_util::PathExists(shard_filename))
+      return false;
+
+    if (!file_util::Move(TemporaryFileForFilename(shard_filename),
+                         shard_filename))
+      return false;
+  }
+
   if (!file_util::Delete(filename_, false) &&
       file_util::PathExists(filename_))
     return false;
@@ -689,7 +1076,12 @@ bool SafeBrowsingStoreFile::DoUpdate(
 
   // Record counts before swapping to caller.
   UMA_HISTOGRAM_COUNTS("SB2.AddPrefixes", add_prefixes.size());
-  UMA_HISTOGRAM_COUNTS("SB2.SubPrefixes", sub_prefixes.size());
+  UMA_HISTOGRAM_COUNTS("SB2.SubPrefixes", sub_prefix_count);
+  UMA_HISTOGRAM_COUNTS_100("SB2.ShardsWritten", shards_written);
+  UMA_HISTOGRAM_COUNTS("SB2.UpdateKilobytesWritten",
+                       static_cast<int>(bytes_written / 1024));
+  UMA_HISTOGRAM_TIMES("SB2.StoreUpdateTime",
+                      base::TimeTicks::Now() - before);
 
   // Pass the resulting data off to the caller.
   add_prefixes_result->swap(add_prefixes);
@@ -14,19 +14,20 @@
 #include "base/callback.h"
 #include "base/file_util.h"
 
-// Implement SafeBrowsingStore in terms of a flat file.  The file
-// format is pretty literal:
+// Implement SafeBrowsingStore in terms of flat files.  The data is
+// split into shards by the top bits of the add prefix each item
+// refers to, so that subs always land in the same shard as the adds
+// they knock out.  Each shard is kept in its own file, and an update
+// only rewrites the shards which its chunks or deletions touch.
+//
+// The main file holds the chunks seen and an index of the shards:
 //
 // int32 magic;             // magic number "validating" file
 // int32 version;           // format version
 //
-// // Counts for the various data which follows the header.
+// // Counts for the chunks-seen data which follows the header.
 // uint32 add_chunk_count;   // Chunks seen, including empties.
 // uint32 sub_chunk_count;   // Ditto.
-// uint32 add_prefix_count;
-// uint32 sub_prefix_count;
-// uint32 add_hash_count;
-// uint32 sub_hash_count;
 //
 // array[add_chunk_count] {
 //   int32 chunk_id;
@@ -34,6 +35,18 @@
 // array[sub_chunk_count] {
 //   int32 chunk_id;
 // }
+// array[kShardCount] {
+//   uint32 add_prefix_count;
+//   uint32 sub_prefix_count;
+//   uint32 add_hash_count;
+//   uint32 sub_hash_count;
+//   MD5Digest shard_checksum;  // Checksum over the shard file.
+// }
+// MD5Digest checksum;      // Checksum over preceeding data.
+//
+// Each shard file (see ShardFileForFilename()) holds the data of the
+// shard, sorted as SBProcessSubs() leaves it:
+//
 // array[add_prefix_count] {
 //   int32 chunk_id;
 //   int32 prefix;
@@ -52,13 +65,16 @@
 //   int32 add_chunk_id;
 //   char[32] add_full_hash;
 // }
-// MD5Digest checksum;      // Checksum over preceeding data.
+//
+// Version 7 of the format kept all of the data in the main file,
+// following the chunks-seen data, with its counts in the header.  It
+// is read, and converted on the next update.
 //
 // During the course of an update, uncommitted data is stored in a
 // temporary file (which is later re-used to commit).  This is an
 // array of chunks, with the count kept in memory until the end of the
-// transaction.  The format of this file is like the main file, with
-// the list of chunks seen omitted, as that data is tracked in-memory:
+// transaction.  The format of this file is like a shard file, with a
+// header giving the counts of each chunk:
 //
 // array[] {
 //   uint32 add_prefix_count;
@@ -87,16 +103,19 @@
 // }
 //
 // The overall transaction works like this:
-// - Open the original file to get the chunks-seen data.
+// - Open the main file to get the chunks-seen data.
 // - Open a temp file for storing new chunk info.
 // - Write new chunks to the temp file.
 // - When the transaction is finished:
-//   - Read the rest of the original file's data into buffers.
-//   - Rewind the temp file and merge the new data into buffers.
-//   - Process buffers for deletions and apply subs.
-//   - Rewind and write the buffers out to temp file.
-//   - Delete original file.
-//   - Rename temp file to original filename.
+//   - Read the shard index from the main file.
+//   - Rewind the temp file and sort the new data into the shards.
+//   - For each shard, read its file, and if new data or deleted
+//     chunks touch it, process it for deletions and apply subs, then
+//     write it out to the shard's temp file.
+//   - Rewind and write the chunks seen and shard index out to the
+//     temp file.
+//   - Rename the temp files of the rewritten shards, then the main
+//     temp file, over the original files.
 
 // TODO(shess): By using a checksum, this code can avoid doing an
 // fsync(), at the possible cost of more frequently retrieving the
@@ -157,12 +176,20 @@ class SafeBrowsingStoreFile : public SafeBrowsingStore {
   // does not check out.  Empty input is considered valid.
   virtual bool CheckValidity() OVERRIDE;
 
+  // The number of shards the data is split into.
+  static const size_t kShardCount = 16;
+
   // Returns the name of the temporary file used to buffer data for
   // |filename|.  Exported for unit tests.
   static const FilePath TemporaryFileForFilename(const FilePath& filename) {
     return FilePath(filename.value() + FILE_PATH_LITERAL("_new"));
   }
 
+  // Returns the name of the file holding shard |shard| of the store
+  // whose main file is |filename|.  Exported for unit tests.
+  static const FilePath ShardFileForFilename(const FilePath& filename,
+                                             size_t shard);
+
  private:
   // Update store file with pending full hashes.
   virtual bool DoUpdate(const std::vector<SBAddFullHash>& pending_adds,
@@ -94,9 +94,17 @@ TEST_F(SafeBrowsingStoreFileTest, DetectsCorruption) {
   EXPECT_GT(orig_hashes.size(), 0U);
   EXPECT_FALSE(corruption_detected_);
 
-  // Corrupt the store.
-  file_util::ScopedFILE file(file_util::OpenFile(filename_, "rb+"));
-  const long kOffset = 60;
+  // Corrupt the first shard holding data.
+  FilePath shard_filename;
+  for (size_t i = 0; i < SafeBrowsingStoreFile::kShardCount; ++i) {
+    int64 size = 0;
+    shard_filename = SafeBrowsingStoreFile::ShardFileForFilename(filename_, i);
+    if (file_util::GetFileSize(shard_filename, &size) && size > 0)
+      break;
+  }
+  file_util::ScopedFILE file(file_util::OpenFile(shard_filename, "rb+"));
+  ASSERT_TRUE(file.get());
+  const long kOffset = 0;
   EXPECT_EQ(fseek(file.get(), kOffset, SEEK_SET), 0);
   const int32 kZero = 0;
   int32 previous = kZero;
@@ -193,4 +201,176 @@ TEST_F(SafeBrowsingStoreFileTest, CheckValidityChecksum) {
   EXPECT_TRUE(store_->CancelUpdate());
 }
 
+// Flips a byte in each of the shard files of the store at |filename|
+// which hold data.
+void CorruptShards(const FilePath& filename) {
+  for (size_t i = 0; i < SafeBrowsingStoreFile::kShardCount; ++i) {
+    const FilePath shard_filename =
+        SafeBrowsingStoreFile::ShardFileForFilename(filename, i);
+    int64 size = 0;
+    if (!file_util::GetFileSize(shard_filename, &size) || size == 0)
+      continue;
+
+    file_util::ScopedFILE file(file_util::OpenFile(shard_filename, "rb+"));
+    ASSERT_TRUE(file.get());
+    EXPECT_EQ(0, fseek(file.get(), -1, SEEK_END));
+    const int c = fgetc(file.get());
+    EXPECT_NE(EOF, c);
+    EXPECT_EQ(0, fseek(file.get(), -1, SEEK_END));
+    EXPECT_NE(EOF, fputc(c ^ 0xff, file.get()));
+  }
+}
+
+// Corrupt the shards, which only their checksums in the main file
+// cover.
+TEST_F(SafeBrowsingStoreFileTest, CheckValidityShards) {
+  SafeBrowsingStoreTestStorePrefix(store_.get());
+  CorruptShards(filename_);
+
+  SBAddPrefixes add_prefixes;
+  EXPECT_FALSE(store_->GetAddPrefixes(&add_prefixes));
+  EXPECT_TRUE(corruption_detected_);
+
+  corruption_detected_ = false;
+  std::vector<SBAddFullHash> add_hashes;
+  EXPECT_FALSE(store_->GetAddFullHashes(&add_hashes));
+  EXPECT_TRUE(corruption_detected_);
+
+  corruption_detected_ = false;
+  ASSERT_TRUE(store_->BeginUpdate());
+  EXPECT_FALSE(corruption_detected_);
+  EXPECT_FALSE(store_->CheckValidity());
+  EXPECT_TRUE(corruption_detected_);
+  EXPECT_TRUE(store_->CancelUpdate());
+}
+
+// Adds a chunk to |store| holding the prefix |prefix|.
+void AddPrefixChunk(SafeBrowsingStoreFile* store,
+                    int32 chunk_id,
+                    SBPrefix prefix) {
+  EXPECT_TRUE(store->BeginChunk());
+  store->SetAddChunk(chunk_id);
+  EXPECT_TRUE(store->WriteAddPrefix(chunk_id, prefix));
+  EXPECT_TRUE(store->FinishChunk());
+}
+
+// Returns the modification time of |filename|.
+base::Time LastModified(const FilePath& filename) {
+  base::PlatformFileInfo info;
+  EXPECT_TRUE(file_util::GetFileInfo(filename, &info));
+  return info.last_modified;
+}
+
+// Only the shards touched by an update are rewritten.
+TEST_F(SafeBrowsingStoreFileTest, UpdatesTouchedShards) {
+  // Prefixes in shards 1 and 7.
+  const SBPrefix kPrefix1 = 0x10000001;
+  const SBPrefix kPrefix2 = 0x10000002;
+  const SBPrefix kPrefix7 = 0x70000007;
+  const FilePath shard1 = SafeBrowsingStoreFile::ShardFileForFilename(
+      filename_, 1);
+  const FilePath shard7 = SafeBrowsingStoreFile::ShardFileForFilename(
+      filename_, 7);
+
+  std::vector<SBAddFullHash> pending_adds;
+  std::set<SBPrefix> prefix_misses;
+  SBAddPrefixes add_prefixes;
+  std::vector<SBAddFullHash> add_hashes;
+  EXPECT_TRUE(store_->BeginUpdate());
+  AddPrefixChunk(store_.get(), 1, kPrefix1);
+  AddPrefixChunk(store_.get(), 2, kPrefix7);
+  EXPECT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+  EXPECT_TRUE(file_util::PathExists(shard1));
+  EXPECT_TRUE(file_util::PathExists(shard7));
+  EXPECT_FALSE(file_util::PathExists(
+      SafeBrowsingStoreFile::ShardFileForFilename(filename_, 2)));
+
+  const base::Time kLastWeek = base::Time::Now() - base::TimeDelta::FromDays(7);
+  ASSERT_TRUE(file_util::SetLastModifiedTime(shard1, kLastWeek));
+  ASSERT_TRUE(file_util::SetLastModifiedTime(shard7, kLastWeek));
+
+  // A new chunk in shard 1 leaves shard 7 alone.
+  EXPECT_TRUE(store_->BeginUpdate());
+  AddPrefixChunk(store_.get(), 3, kPrefix2);
+  EXPECT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+  EXPECT_NE(kLastWeek, LastModified(shard1));
+  EXPECT_EQ(kLastWeek.ToTimeT(), LastModified(shard7).ToTimeT());
+
+  // The result still holds every shard, in the order of the chunks.
+  ASSERT_EQ(3U, add_prefixes.size());
+  EXPECT_EQ(kPrefix1, add_prefixes[0].prefix);
+  EXPECT_EQ(kPrefix7, add_prefixes[1].prefix);
+  EXPECT_EQ(kPrefix2, add_prefixes[2].prefix);
+  SBAddPrefixes read_prefixes;
+  EXPECT_TRUE(store_->GetAddPrefixes(&read_prefixes));
+  ASSERT_EQ(3U, read_prefixes.size());
+  EXPECT_EQ(kPrefix7, read_prefixes[1].prefix);
+
+  // Deleting a chunk rewrites the shards holding its data.
+  ASSERT_TRUE(file_util::SetLastModifiedTime(shard1, kLastWeek));
+  EXPECT_TRUE(store_->BeginUpdate());
+  store_->DeleteAddChunk(2);
+  EXPECT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+  EXPECT_EQ(kLastWeek.ToTimeT(), LastModified(shard1).ToTimeT());
+  EXPECT_NE(kLastWeek, LastModified(shard7));
+  ASSERT_EQ(2U, add_prefixes.size());
+  EXPECT_EQ(kPrefix1, add_prefixes[0].prefix);
+  EXPECT_EQ(kPrefix2, add_prefixes[1].prefix);
+  EXPECT_FALSE(corruption_detected_);
+}
+
+// A store in the unsharded format of version 7 is read, and converted
+// on the next update.
+TEST_F(SafeBrowsingStoreFileTest, ConvertsLegacyFormat) {
+  const int32 kLegacyHeader[] = {
+    0x600D71FE,  // Magic.
+    7,           // Version.
+    1, 0,        // Add and sub chunks seen.
+    2, 0, 0, 0,  // Add prefixes, sub prefixes, add and sub hashes.
+  };
+  const int32 kLegacyData[] = {
+    1,                        // Add chunk seen.
+    1, 0x10000001,            // Add prefixes.
+    1, 0x70000007,
+  };
+  std::string contents(reinterpret_cast<const char*>(kLegacyHeader),
+                       sizeof(kLegacyHeader));
+  contents.append(reinterpret_cast<const char*>(kLegacyData),
+                  sizeof(kLegacyData));
+  base::MD5Digest digest;
+  base::MD5Sum(contents.data(), contents.size(), &digest);
+  contents.append(reinterpret_cast<const char*>(&digest), sizeof(digest));
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            file_util::WriteFile(filename_, contents.data(), contents.size()));
+
+  SBAddPrefixes read_prefixes;
+  EXPECT_TRUE(store_->GetAddPrefixes(&read_prefixes));
+  EXPECT_EQ(2U, read_prefixes.size());
+
+  std::vector<SBAddFullHash> pending_adds;
+  std::set<SBPrefix> prefix_misses;
+  SBAddPrefixes add_prefixes;
+  std::vector<SBAddFullHash> add_hashes;
+  EXPECT_TRUE(store_->BeginUpdate());
+  EXPECT_TRUE(store_->CheckAddChunk(1));
+  EXPECT_TRUE(store_->FinishUpdate(pending_adds, prefix_misses,
+                                   &add_prefixes, &add_hashes));
+  EXPECT_FALSE(corruption_detected_);
+  ASSERT_EQ(2U, add_prefixes.size());
+  EXPECT_EQ(0x10000001, add_prefixes[0].prefix);
+  EXPECT_EQ(0x70000007, add_prefixes[1].prefix);
+  EXPECT_TRUE(file_util::PathExists(
+      SafeBrowsingStoreFile::ShardFileForFilename(filename_, 1)));
+  EXPECT_TRUE(file_util::PathExists(
+      SafeBrowsingStoreFile::ShardFileForFilename(filename_, 7)));
+
+  // The converted store reads back the same.
+  EXPECT_TRUE(store_->GetAddPrefixes(&read_prefixes));
+  ASSERT_EQ(2U, read_prefixes.size());
+  EXPECT_EQ(0x10000001, read_prefixes[0].prefix);
+}
+
 }  // namespace
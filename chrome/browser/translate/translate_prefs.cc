@@ -4,6 +4,8 @@
 
 #include "chrome/browser/translate/translate_prefs.h"
 
+#include <vector>
+
 #include "base/string_util.h"
 #include "chrome/browser/prefs/pref_service.h"
 #include "chrome/browser/prefs/scoped_user_pref_update.h"
@@ -191,6 +193,9 @@ void TranslatePrefs::MigrateTranslateWhitelists(PrefService* user_prefs) {
   DictionaryValue* dict = update.Get();
   if (!dict || dict->empty())
     return;
+  // Removing a key invalidates |iter|, so the keys to remove are collected and
+  // removed once the iteration is done.
+  std::vector<std::string> keys_to_remove;
   for (DictionaryValue::key_iterator iter(dict->begin_keys());
        iter != dict->end_keys(); ++iter) {
     ListValue* list = NULL;
@@ -199,10 +204,12 @@ void TranslatePrefs::MigrateTranslateWhitelists(PrefService* user_prefs) {
     std::string target_lang;
     if (list->empty() || !list->GetString(list->GetSize() - 1, &target_lang) ||
         target_lang.empty())
-      dict->Remove(*iter, NULL);
+      keys_to_remove.push_back(*iter);
      else
       dict->SetString(*iter, target_lang);
   }
+  for (size_t i = 0; i < keys_to_remove.size(); ++i)
+    dict->Remove(keys_to_remove[i], NULL);
 }
 
 // TranslatePrefs: private: ----------------------------------------------------
@@ -25,6 +25,11 @@ static const int kCommitIntervalMs = 100;
 // and the overall update should be used instead.
 static const unsigned kVisitedLinkBufferThreshold = 50;
 
+// The most table segments sent in one message. POSIX messages carry at most
+// five file descriptors, and the two halves of a split segment must arrive
+// together.
+static const size_t kMaxSegmentsPerMessage = 4;
+
 }  // namespace
 
 // This class manages buffering and sending visited link hashes (fingerprints)
@@ -41,17 +46,25 @@ class VisitedLinkUpdater {
       : reset_needed_(false), render_process_id_(render_process_id) {
   }
 
-  // Informs the renderer about a new visited link table.
-  void SendVisitedLinkTable(base::SharedMemory* table_memory) {
+  // Informs the renderer about new segments of the visited link table.
+  void SendVisitedLinkTable(const std::vector<base::SharedMemory*>& segments) {
     content::RenderProcessHost* process =
         content::RenderProcessHost::FromID(render_process_id_);
     if (!process)
       return;  // Happens in tests
-    base::SharedMemoryHandle handle_for_process;
-    table_memory->ShareToProcess(process->GetHandle(), &handle_for_process);
-    if (base::SharedMemory::IsHandleValid(handle_for_process))
-      process->Send(new ChromeViewMsg_VisitedLink_NewTable(
-          handle_for_process));
+    std::vector<base::SharedMemoryHandle> handles;
+    for (size_t i = 0; i < segments.size(); ++i) {
+      base::SharedMemoryHandle handle_for_process;
+      segments[i]->ShareToProcess(process->GetHandle(), &handle_for_process);
+      if (base::SharedMemory::IsHandleValid(handle_for_process))
+        handles.push_back(handle_for_process);
+      if (handles.size() == kMaxSegmentsPerMessage) {
+        process->Send(new ChromeViewMsg_VisitedLink_NewSegments(handles));
+        handles.clear();
+      }
+    }
+    if (!handles.empty())
+      process->Send(new ChromeViewMsg_VisitedLink_NewSegments(handles));
   }
 
   // Buffers |links| to update, but doesn't actually relay them.
@@ -120,8 +133,9 @@ VisitedLinkEventListener::VisitedLinkEventListener(Profile* profile)
 VisitedLinkEventListener::~VisitedLinkEventListener() {
 }
 
-void VisitedLinkEventListener::NewTable(base::SharedMemory* table_memory) {
-  if (!table_memory)
+void VisitedLinkEventListener::NewSegments(
+    const std::vector<base::SharedMemory*>& segments) {
+  if (segments.empty())
     return;
 
   // Send to all RenderProcessHosts.
@@ -133,9 +147,8 @@ void VisitedLinkEventListener::NewTable(base::SharedMemory* table_memory) {
       continue;
     Profile* profile = Profile::FromBrowserContext(
         process->GetBrowserContext());
-    VisitedLinkMaster* master = profile->GetVisitedLinkMaster();
-    if (master && master->shared_memory() == table_memory)
-      i->second->SendVisitedLinkTable(table_memory);
+    if (profile->GetVisitedLinkMaster())
+      i->second->SendVisitedLinkTable(segments);
   }
 }
 
@@ -190,8 +203,9 @@ void VisitedLinkEventListener::Observe(
       if (!master)
         return;
 
-      updaters_[process->GetID()]->SendVisitedLinkTable(
-          master->shared_memory());
+      std::vector<base::SharedMemory*> segments;
+      master->GetSharedMemorySegments(&segments);
+      updaters_[process->GetID()]->SendVisitedLinkTable(segments);
       break;
     }
     case content::NOTIFICATION_RENDERER_PROCESS_TERMINATED: {
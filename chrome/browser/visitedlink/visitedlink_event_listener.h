@@ -11,6 +11,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "base/memory/linked_ptr.h"
 #include "base/timer.h"
@@ -31,7 +32,8 @@ class VisitedLinkEventListener : public VisitedLinkMaster::Listener,
   explicit VisitedLinkEventListener(Profile* profile);
   virtual ~VisitedLinkEventListener();
 
-  virtual void NewTable(base::SharedMemory* table_memory) OVERRIDE;
+  virtual void NewSegments(
+      const std::vector<base::SharedMemory*>& segments) OVERRIDE;
   virtual void Add(VisitedLinkMaster::Fingerprint fingerprint) OVERRIDE;
   virtual void Reset() OVERRIDE;
 
@@ -35,21 +35,30 @@ using file_util::TruncateFile;
 
 const int32 VisitedLinkMaster::kFileHeaderSignatureOffset = 0;
 const int32 VisitedLinkMaster::kFileHeaderVersionOffset = 4;
-const int32 VisitedLinkMaster::kFileHeaderLengthOffset = 8;
+const int32 VisitedLinkMaster::kFileHeaderSegmentsOffset = 8;
 const int32 VisitedLinkMaster::kFileHeaderUsedOffset = 12;
 const int32 VisitedLinkMaster::kFileHeaderSaltOffset = 16;
 
-const int32 VisitedLinkMaster::kFileCurrentVersion = 3;
+// Version 4 stores the table as a sequence of segments. Segments that replace
+// others are appended, and the later of two segments that hold the same
+// fingerprints wins.
+const int32 VisitedLinkMaster::kFileCurrentVersion = 4;
 
 // the signature at the beginning of the URL table = "VLnk" (visited links)
 const int32 VisitedLinkMaster::kFileSignature = 0x6b6e4c56;
 const size_t VisitedLinkMaster::kFileHeaderSize =
     kFileHeaderSaltOffset + LINK_SALT_LENGTH;
+const size_t VisitedLinkMaster::kFileSegmentHeaderSize = 3 * sizeof(int32);
 
 // This value should also be the same as the smallest size in the lookup
 // table in NewTableSizeForCount (prime number).
 const unsigned VisitedLinkMaster::kDefaultTableSize = 16381;
 
+// This value should be the largest size in the lookup table in
+// NewTableSizeForCount. Rehashing a full segment of this size takes a few
+// milliseconds.
+const int32 VisitedLinkMaster::kMaxSegmentSize = 524269;
+
 const size_t VisitedLinkMaster::kBigDeleteThreshold = 64;
 
 namespace {
@@ -184,9 +193,11 @@ void VisitedLinkMaster::InitMembers(Listener* listener, Profile* profile) {
 
   listener_ = listener;
   file_ = NULL;
-  shared_memory_ = NULL;
+  file_length_ = 0;
+  file_segment_count_ = 0;
   shared_memory_serial_ = 0;
   used_items_ = 0;
+  max_segment_size_ = kMaxSegmentSize;
   table_size_override_ = 0;
   history_service_override_ = NULL;
   suppress_rebuild_ = false;
@@ -208,7 +219,14 @@ bool VisitedLinkMaster::Init() {
   return true;
 }
 
-VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url) {
+void VisitedLinkMaster::GetSharedMemorySegments(
+    std::vector<base::SharedMemory*>* segments) const {
+  for (size_t i = 0; i < segments_.size(); i++)
+    segments->push_back(segments_[i].shared_memory);
+}
+
+VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url,
+                                                       int* segment) {
   // Extra check that we are not incognito. This should not happen.
   if (profile_ && profile_->IsOffTheRecord()) {
     NOTREACHED();
@@ -233,12 +251,19 @@ VisitedLinkMaster::Hash VisitedLinkMaster::TryToAddURL(const GURL& url) {
     added_since_rebuild_.insert(fingerprint);
   }
 
-  // If the table is "full", we don't add URLs and just drop them on the floor.
-  // This can happen if we get thousands of new URLs and something causes
+  *segment = SegmentIndexForFingerprint(fingerprint);
+  if (*segment < 0) {
+    NOTREACHED();  // Not initialized.
+    return null_hash_;
+  }
+
+  // If the segment is "full", we don't add URLs and just drop them on the
+  // floor. This can happen if we get thousands of new URLs and something causes
   // the table resizing to fail. This check prevents a hang in that case. Note
   // that this is *not* the resize limit, this is just a sanity check.
-  if (used_items_ / 8 > table_length_ / 10)
-    return null_hash_;  // Table is more than 80% full.
+  const Segment& cur_segment = segments_[*segment];
+  if (cur_segment.used_items / 8 > cur_segment.table_length / 10)
+    return null_hash_;  // Segment is more than 80% full.
 
   return AddFingerprint(fingerprint, true);
 }
@@ -250,21 +275,23 @@ void VisitedLinkMaster::PostIOTask(const tracked_objects::Location& from_here,
 }
 
 void VisitedLinkMaster::AddURL(const GURL& url) {
-  Hash index = TryToAddURL(url);
+  int segment = -1;
+  Hash index = TryToAddURL(url, &segment);
   if (!table_builder_ && index != null_hash_) {
     // Not rebuilding, so we want to keep the file on disk up-to-date.
     WriteUsedItemCountToFile();
-    WriteHashRangeToFile(index, index);
-    ResizeTableIfNecessary();
+    WriteHashRangeToFile(segment, index, index);
+    ResizeSegmentIfNecessary(segment);
   }
 }
 
 void VisitedLinkMaster::AddURLs(const std::vector<GURL>& url) {
   for (std::vector<GURL>::const_iterator i = url.begin();
        i != url.end(); ++i) {
-    Hash index = TryToAddURL(*i);
+    int segment = -1;
+    Hash index = TryToAddURL(*i, &segment);
     if (!table_builder_ && index != null_hash_)
-      ResizeTableIfNecessary();
+      ResizeSegmentIfNecessary(segment);
   }
 
   // Keeps the file on disk up-to-date.
@@ -277,14 +304,12 @@ void VisitedLinkMaster::DeleteAllURLs() {
   added_since_rebuild_.clear();
   deleted_since_rebuild_.clear();
 
-  // Clear the hash table.
-  used_items_ = 0;
-  memset(hash_table_, 0, this->table_length_ * sizeof(Fingerprint));
-
-  // Resize it if it is now too empty. Resize may write the new table out for
-  // us, otherwise, schedule writing the new table to disk ourselves.
-  if (!ResizeTableIfNecessary())
+  // Replace the hash table with an empty one of the default size, and write
+  // it to disk.
+  if (BeginReplaceURLTable(0, 0)) {
+    NotifyNewSegments(segments_);
     WriteFullTable();
+  }
 
   listener_->Reset();
 }
@@ -341,30 +366,43 @@ void VisitedLinkMaster::DeleteURLs(const history::URLRows& rows) {
 VisitedLinkMaster::Hash VisitedLinkMaster::AddFingerprint(
     Fingerprint fingerprint,
     bool send_notifications) {
-  if (!hash_table_ || table_length_ == 0) {
+  int segment = SegmentIndexForFingerprint(fingerprint);
+  if (segment < 0) {
     NOTREACHED();  // Not initialized.
     return null_hash_;
   }
 
-  Hash cur_hash = HashFingerprint(fingerprint);
+  Hash hash = AddFingerprintToSegment(fingerprint, &segments_[segment]);
+  if (hash != null_hash_) {
+    used_items_++;
+    // If allowed, notify listener that a new visited link was added.
+    if (send_notifications)
+      listener_->Add(fingerprint);
+  }
+  return hash;
+}
+
+VisitedLinkMaster::Hash VisitedLinkMaster::AddFingerprintToSegment(
+    Fingerprint fingerprint,
+    Segment* segment) {
+  DCHECK_EQ(segment->prefix, FingerprintPrefix(fingerprint, segment->depth));
+
+  Hash cur_hash = HashFingerprint(fingerprint, segment->table_length);
   Hash first_hash = cur_hash;
   while (true) {
-    Fingerprint cur_fingerprint = FingerprintAt(cur_hash);
+    Fingerprint cur_fingerprint = FingerprintAt(*segment, cur_hash);
     if (cur_fingerprint == fingerprint)
       return null_hash_;  // This fingerprint is already in there, do nothing.
 
     if (cur_fingerprint == null_fingerprint_) {
       // End of probe sequence found, insert here.
-      hash_table_[cur_hash] = fingerprint;
-      used_items_++;
-      // If allowed, notify listener that a new visited link was added.
-      if (send_notifications)
-        listener_->Add(fingerprint);
+      segment->hash_table[cur_hash] = fingerprint;
+      segment->used_items++;
       return cur_hash;
     }
 
     // Advance in the probe sequence.
-    cur_hash = IncrementHash(cur_hash);
+    cur_hash = IncrementHash(cur_hash, segment->table_length);
     if (cur_hash == first_hash) {
       // This means that we've wrapped around and are about to go into an
       // infinite loop. Something was wrong with the hashtable resizing
@@ -384,18 +422,17 @@ void VisitedLinkMaster::DeleteFingerprintsFromCurrentTable(
        i != fingerprints.end(); ++i)
     DeleteFingerprint(*i, !bulk_write);
 
-  // These deleted fingerprints may make us shrink the table.
-  if (ResizeTableIfNecessary())
-    return;  // The resize function wrote the new table to disk for us.
-
-  // Nobody wrote this out for us, write the full file to disk.
+  // These deleted fingerprints may make us shrink some segments. The resize
+  // writes those segments to disk, but not the deletions in the others.
+  ResizeTableIfNecessary();
   if (bulk_write)
     WriteFullTable();
 }
 
 bool VisitedLinkMaster::DeleteFingerprint(Fingerprint fingerprint,
                                           bool update_file) {
-  if (!hash_table_ || table_length_ == 0) {
+  int segment_index = SegmentIndexForFingerprint(fingerprint);
+  if (segment_index < 0) {
     NOTREACHED();  // Not initialized.
     return false;
   }
@@ -403,11 +440,15 @@ bool VisitedLinkMaster::DeleteFingerprint(Fingerprint fingerprint,
     return false;  // Not in the database to delete.
 
   // First update the header used count.
+  Segment* segment = &segments_[segment_index];
   used_items_--;
+  segment->used_items--;
   if (update_file)
     WriteUsedItemCountToFile();
 
-  Hash deleted_hash = HashFingerprint(fingerprint);
+  Fingerprint* hash_table = segment->hash_table;
+  int32 table_length = segment->table_length;
+  Hash deleted_hash = HashFingerprint(fingerprint, table_length);
 
   // Find the range of "stuff" in the hash table that is adjacent to this
   // fingerprint. These are things that could be affected by the change in
@@ -415,10 +456,10 @@ bool VisitedLinkMaster::DeleteFingerprint(Fingerprint fingerprint,
   // item up until an empty item could be affected.
   Hash end_range = deleted_hash;
   while (true) {
-    Hash next_hash = IncrementHash(end_range);
+    Hash next_hash = IncrementHash(end_range, table_length);
     if (next_hash == deleted_hash)
       break;  // We wrapped around and the whole table is full.
-    if (!hash_table_[next_hash])
+    if (!hash_table[next_hash])
       break;  // Found the last spot.
     end_range = next_hash;
   }
@@ -428,17 +469,20 @@ bool VisitedLinkMaster::DeleteFingerprint(Fingerprint fingerprint,
   // This will mean there's a small window of time where the affected links
   // won't be marked visited.
   StackVector<Fingerprint, 32> shuffled_fingerprints;
-  Hash stop_loop = IncrementHash(end_range);  // The end range is inclusive.
-  for (Hash i = deleted_hash; i != stop_loop; i = IncrementHash(i)) {
-    if (hash_table_[i] != fingerprint) {
+  // The end range is inclusive.
+  Hash stop_loop = IncrementHash(end_range, table_length);
+  for (Hash i = deleted_hash; i != stop_loop;
+       i = IncrementHash(i, table_length)) {
+    if (hash_table[i] != fingerprint) {
       // Don't save the one we're deleting!
-      shuffled_fingerprints->push_back(hash_table_[i]);
+      shuffled_fingerprints->push_back(hash_table[i]);
 
-      // This will balance the increment of this value in AddFingerprint below
-      // so there is no net change.
+      // This will balance the increment of these values in AddFingerprint
+      // below so there is no net change.
       used_items_--;
+      segment->used_items--;
     }
-    hash_table_[i] = null_fingerprint_;
+    hash_table[i] = null_fingerprint_;
   }
 
   if (!shuffled_fingerprints->empty()) {
@@ -449,7 +493,7 @@ bool VisitedLinkMaster::DeleteFingerprint(Fingerprint fingerprint,
 
   // Write the affected range to disk [deleted_hash, end_range].
   if (update_file)
-    WriteHashRangeToFile(deleted_hash, end_range);
+    WriteHashRangeToFile(segment_index, deleted_hash, end_range);
 
   return true;
 }
@@ -478,23 +522,82 @@ bool VisitedLinkMaster::WriteFullTable() {
   }
 
   // Write the new header.
+  file_segment_count_ = static_cast<int32>(segments_.size());
   int32 header[4];
   header[0] = kFileSignature;
   header[1] = kFileCurrentVersion;
-  header[2] = table_length_;
+  header[2] = file_segment_count_;
   header[3] = used_items_;
   WriteToFile(file_, 0, header, sizeof(header));
   WriteToFile(file_, sizeof(header), salt_, LINK_SALT_LENGTH);
 
-  // Write the hash data.
-  WriteToFile(file_, kFileHeaderSize,
-              hash_table_, table_length_ * sizeof(Fingerprint));
+  // Write the segments one after the other.
+  int32 offset = kFileHeaderSize;
+  for (size_t i = 0; i < segments_.size(); i++)
+    offset = WriteSegmentToFile(static_cast<int>(i), offset);
+  file_length_ = offset;
 
   // The hash table may have shrunk, so make sure this is the end.
   PostIOTask(FROM_HERE, base::Bind(base::IgnoreResult(&TruncateFile), file_));
   return true;
 }
 
+void VisitedLinkMaster::WriteNewSegmentsToFile(const Segments& new_segments,
+                                               const Segments& removed) {
+  if (!file_)
+    return;  // See comment on the file_ variable for why this might happen.
+
+  // The replaced segments stay in the file until it is rewritten. Do that once
+  // they take more room than the live table, so the file is at most twice as
+  // big as the table.
+  int32 live_length = kFileHeaderSize;
+  for (size_t i = 0; i < segments_.size(); i++) {
+    live_length += kFileSegmentHeaderSize +
+                   segments_[i].table_length * sizeof(Fingerprint);
+  }
+  int32 new_length = 0;
+  for (size_t i = 0; i < new_segments.size(); i++) {
+    new_length += kFileSegmentHeaderSize +
+                  new_segments[i].table_length * sizeof(Fingerprint);
+  }
+  if (file_length_ + new_length - live_length > live_length) {
+    WriteFullTable();
+    return;
+  }
+
+  // Append the new segments. A segment that follows another one holding the
+  // same fingerprints replaces it when the file is read.
+  for (size_t i = 0; i < new_segments.size(); i++) {
+    for (size_t j = 0; j < segments_.size(); j++) {
+      if (segments_[j].shared_memory == new_segments[i].shared_memory) {
+        file_length_ = WriteSegmentToFile(static_cast<int>(j), file_length_);
+        break;
+      }
+    }
+  }
+
+  // Only count the new segments once their contents have been written.
+  file_segment_count_ += static_cast<int32>(new_segments.size());
+  WriteToFile(file_, kFileHeaderSegmentsOffset, &file_segment_count_,
+              sizeof(file_segment_count_));
+}
+
+int32 VisitedLinkMaster::WriteSegmentToFile(int segment_index, int32 offset) {
+  Segment* segment = &segments_[segment_index];
+  segment->file_offset = offset;
+
+  int32 header[3];
+  header[0] = segment->depth;
+  header[1] = static_cast<int32>(segment->prefix);
+  header[2] = segment->table_length;
+  WriteToFile(file_, offset, header, sizeof(header));
+  offset += kFileSegmentHeaderSize;
+
+  int32 table_size = segment->table_length * sizeof(Fingerprint);
+  WriteToFile(file_, offset, segment->hash_table, table_size);
+  return offset + table_size;
+}
+
 bool VisitedLinkMaster::InitFromFile() {
   DCHECK(file_ == NULL);
 
@@ -504,19 +607,91 @@ bool VisitedLinkMaster::InitFromFile() {
   if (!file_closer.get())
     return false;
 
-  int32 num_entries, used_count;
-  if (!ReadFileHeader(file_closer.get(), &num_entries, &used_count, salt_))
+  int32 num_segments, used_count, file_size;
+  if (!ReadFileHeader(file_closer.get(), &num_segments, &used_count, salt_,
+                      &file_size))
     return false;  // Header isn't valid.
 
-  // Allocate and read the table.
-  if (!CreateURLTable(num_entries, false))
-    return false;
-  if (!ReadFromFile(file_closer.get(), kFileHeaderSize,
-                    hash_table_, num_entries * sizeof(Fingerprint))) {
-    FreeURLTable();
+  // Read the headers of the segments. Later segments replace the earlier ones
+  // that hold the same fingerprints, so only read the contents of the
+  // segments that are still live at the end.
+  Segments live_segments;
+  int32 offset = kFileHeaderSize;
+  for (int32 i = 0; i < num_segments; i++) {
+    int32 header[3];
+    if (offset > file_size - static_cast<int32>(kFileSegmentHeaderSize) ||
+        !ReadFromFile(file_closer.get(), offset, header, sizeof(header)))
+      return false;
+
+    Segment segment;
+    segment.depth = header[0];
+    segment.prefix = static_cast<uint32>(header[1]);
+    segment.table_length = header[2];
+    segment.file_offset = offset;
+    if (segment.depth < 0 || segment.depth > kMaxSegmentDepth ||
+        (segment.prefix >> segment.depth) != 0 ||
+        segment.table_length <= 0 ||
+        segment.table_length > (file_size - offset) /
+                                static_cast<int32>(sizeof(Fingerprint)))
+      return false;  // Bad segment.
+    offset += kFileSegmentHeaderSize +
+              segment.table_length * sizeof(Fingerprint);
+    if (offset > file_size)
+      return false;  // Bad size.
+
+    for (Segments::iterator j = live_segments.begin();
+         j != live_segments.end();) {
+      if (SegmentsOverlap(*j, segment))
+        j = live_segments.erase(j);
+      else
+        ++j;
+    }
+    live_segments.push_back(segment);
+  }
+  if (offset != file_size)
+    return false;  // Bad size.
+
+  // The live segments must hold every fingerprint.
+  uint64 covered = 0;
+  for (size_t i = 0; i < live_segments.size(); i++)
+    covered += GG_UINT64_C(1) << (32 - live_segments[i].depth);
+  if (covered != GG_UINT64_C(1) << 32)
     return false;
+
+  // Allocate and read the segments.
+  int32 used_items = 0;
+  for (size_t i = 0; i < live_segments.size(); i++) {
+    Segment* segment = &live_segments[i];
+    int32 file_offset = segment->file_offset;
+    if (!CreateSegment(segment->table_length, segment->depth, segment->prefix,
+                       false, segment) ||
+        !ReadFromFile(file_closer.get(),
+                      file_offset + kFileSegmentHeaderSize,
+                      segment->hash_table,
+                      segment->table_length * sizeof(Fingerprint))) {
+      FreeSegments(Segments(live_segments.begin(), live_segments.begin() + i));
+      return false;
+    }
+    segment->file_offset = file_offset;
+
+    // The used count of each segment is not stored, count them.
+    for (int32 j = 0; j < segment->table_length; j++) {
+      if (segment->hash_table[j])
+        segment->used_items++;
+    }
+    used_items += segment->used_items;
+  }
+  if (used_items != used_count) {
+    FreeSegments(live_segments);
+    return false;  // Bad used item count.
   }
-  used_items_ = used_count;
+
+  Segments replaced_segments;
+  ReplaceSegments(live_segments, &replaced_segments);
+  DCHECK(replaced_segments.empty());
+  used_items_ = used_items;
+  file_length_ = file_size;
+  file_segment_count_ = num_segments;
 
 #ifndef NDEBUG
   DebugValidate();
@@ -534,7 +709,7 @@ bool VisitedLinkMaster::InitFromScratch(bool suppress_rebuild) {
   // The salt must be generated before the table so that it can be copied to
   // the shared memory.
   GenerateSalt(salt_);
-  if (!CreateURLTable(table_size, true))
+  if (!BeginReplaceURLTable(0, table_size))
     return false;
 
 #ifndef NDEBUG
@@ -556,19 +731,21 @@ bool VisitedLinkMaster::InitFromScratch(bool suppress_rebuild) {
 }
 
 bool VisitedLinkMaster::ReadFileHeader(FILE* file,
-                                       int32* num_entries,
+                                       int32* num_segments,
                                        int32* used_count,
-                                       uint8 salt[LINK_SALT_LENGTH]) {
+                                       uint8 salt[LINK_SALT_LENGTH],
+                                       int32* file_size) {
   // Get file size.
   // Note that there is no need to seek back to the original location in the
   // file since ReadFromFile() [which is the next call accessing the file]
   // seeks before reading.
   if (fseek(file, 0, SEEK_END) == -1)
     return false;
-  size_t file_size = ftell(file);
+  long size = ftell(file);
 
-  if (file_size <= kFileHeaderSize)
+  if (size <= static_cast<long>(kFileHeaderSize) || size > kint32max)
     return false;
+  *file_size = static_cast<int32>(size);
 
   uint8 header[kFileHeaderSize];
   if (!ReadFromFile(file, 0, &header, kFileHeaderSize))
@@ -588,14 +765,16 @@ bool VisitedLinkMaster::ReadFileHeader(FILE* file,
   if (version != kFileCurrentVersion)
     return false;  // Bad version.
 
-  // Read the table size and make sure it matches the file size.
-  memcpy(num_entries, &header[kFileHeaderLengthOffset], sizeof(*num_entries));
-  if (*num_entries * sizeof(Fingerprint) + kFileHeaderSize != file_size)
-    return false;  // Bad size.
+  // Read the number of segments. Their sizes are checked against the file
+  // size as they are read.
+  memcpy(num_segments, &header[kFileHeaderSegmentsOffset],
+         sizeof(*num_segments));
+  if (*num_segments <= 0)
+    return false;  // Bad segment count.
 
   // Read the used item count.
   memcpy(used_count, &header[kFileHeaderUsedOffset], sizeof(*used_count));
-  if (*used_count > *num_entries)
+  if (*used_count < 0)
     return false;  // Bad used item count;
 
   // Read the salt.
@@ -622,51 +801,80 @@ bool VisitedLinkMaster::GetDatabaseFileName(FilePath* filename) {
 
 // Initializes the shared memory structure. The salt should already be filled
 // in so that it can be written to the shared memory
-bool VisitedLinkMaster::CreateURLTable(int32 num_entries, bool init_to_empty) {
-  // The table is the size of the table followed by the entries.
+bool VisitedLinkMaster::CreateSegment(int32 num_entries,
+                                      int32 depth,
+                                      uint32 prefix,
+                                      bool init_to_empty,
+                                      Segment* segment) {
+  // The segment is the header followed by the entries.
   uint32 alloc_size = num_entries * sizeof(Fingerprint) + sizeof(SharedHeader);
 
   // Create the shared memory object.
-  shared_memory_ = new base::SharedMemory();
-  if (!shared_memory_)
+  base::SharedMemory* shared_memory = new base::SharedMemory();
+  if (!shared_memory)
     return false;
 
-  if (!shared_memory_->CreateAndMapAnonymous(alloc_size)) {
-    delete shared_memory_;
-    shared_memory_ = NULL;
+  if (!shared_memory->CreateAndMapAnonymous(alloc_size)) {
+    delete shared_memory;
     return false;
   }
 
-  if (init_to_empty) {
-    memset(shared_memory_->memory(), 0, alloc_size);
-    used_items_ = 0;
-  }
-  table_length_ = num_entries;
+  if (init_to_empty)
+    memset(shared_memory->memory(), 0, alloc_size);
 
   // Save the header for other processes to read.
-  SharedHeader* header = static_cast<SharedHeader*>(shared_memory_->memory());
-  header->length = table_length_;
+  SharedHeader* header = static_cast<SharedHeader*>(shared_memory->memory());
+  header->length = num_entries;
   memcpy(header->salt, salt_, LINK_SALT_LENGTH);
-
-  // Our table pointer is just the data immediately following the size.
-  hash_table_ = reinterpret_cast<Fingerprint*>(
-      static_cast<char*>(shared_memory_->memory()) + sizeof(SharedHeader));
-
+  header->depth = depth;
+  header->prefix = prefix;
+
+  // Our table pointer is just the data immediately following the header.
+  *segment = Segment();
+  segment->shared_memory = shared_memory;
+  segment->hash_table = reinterpret_cast<Fingerprint*>(
+      static_cast<char*>(shared_memory->memory()) + sizeof(SharedHeader));
+  segment->table_length = num_entries;
+  segment->depth = depth;
+  segment->prefix = prefix;
   return true;
 }
 
-bool VisitedLinkMaster::BeginReplaceURLTable(int32 num_entries) {
-  base::SharedMemory *old_shared_memory = shared_memory_;
-  Fingerprint* old_hash_table = hash_table_;
-  int32 old_table_length = table_length_;
-  if (!CreateURLTable(num_entries, true)) {
-    // Try to put back the old state.
-    shared_memory_ = old_shared_memory;
-    hash_table_ = old_hash_table;
-    table_length_ = old_table_length;
-    return false;
+// static
+void VisitedLinkMaster::FreeSegments(const Segments& segments) {
+  // On error unmapping, just forget about it since we can't do anything
+  // else to release it.
+  for (size_t i = 0; i < segments.size(); i++)
+    delete segments[i].shared_memory;
+}
+
+bool VisitedLinkMaster::BeginReplaceURLTable(int32 item_count,
+                                             int32 segment_size) {
+  // Split the table deep enough for each segment to start out at most a third
+  // full.
+  int32 depth = 0;
+  if (!segment_size) {
+    while (depth < kMaxSegmentDepth &&
+           (item_count >> depth) >= max_segment_size_ / 3)
+      depth++;
+    segment_size = NewTableSizeForCount(item_count >> depth);
+  }
+
+  Segments new_segments(1 << depth);
+  for (size_t i = 0; i < new_segments.size(); i++) {
+    if (!CreateSegment(segment_size, depth, static_cast<uint32>(i), true,
+                       &new_segments[i])) {
+      FreeSegments(Segments(new_segments.begin(), new_segments.begin() + i));
+      return false;
+    }
   }
 
+  shared_memory_serial_++;
+  Segments old_segments;
+  ReplaceSegments(new_segments, &old_segments);
+  FreeSegments(old_segments);
+  used_items_ = 0;
+
 #ifndef NDEBUG
   DebugValidate();
 #endif
@@ -675,17 +883,53 @@ bool VisitedLinkMaster::BeginReplaceURLTable(int32 num_entries) {
 }
 
 void VisitedLinkMaster::FreeURLTable() {
-  if (shared_memory_) {
-    delete shared_memory_;
-    shared_memory_ = NULL;
-  }
+  FreeSegments(segments_);
+  segments_.clear();
+  RebuildDirectory();
   if (!file_)
     return;
   PostIOTask(FROM_HERE, base::Bind(base::IgnoreResult(&fclose), file_));
 }
 
+void VisitedLinkMaster::CommitSegments(const Segments& new_segments) {
+  shared_memory_serial_++;
+
+  Segments removed;
+  ReplaceSegments(new_segments, &removed);
+
+  // Send the new segments to all child processes. They keep using the rest
+  // of their table.
+  NotifyNewSegments(new_segments);
+
+  WriteNewSegmentsToFile(new_segments, removed);
+  FreeSegments(removed);
+}
+
+void VisitedLinkMaster::NotifyNewSegments(const Segments& segments) {
+  std::vector<base::SharedMemory*> shared_memory;
+  for (size_t i = 0; i < segments.size(); i++)
+    shared_memory.push_back(segments[i].shared_memory);
+  listener_->NewSegments(shared_memory);
+}
+
 bool VisitedLinkMaster::ResizeTableIfNecessary() {
-  DCHECK(table_length_ > 0) << "Must have a table";
+  DCHECK(!segments_.empty()) << "Must have a table";
+
+  // A segment that was resized or split is checked again, the others are
+  // left alone.
+  bool resized = false;
+  size_t i = 0;
+  while (i < segments_.size()) {
+    if (ResizeSegmentIfNecessary(static_cast<int>(i)))
+      resized = true;
+    else
+      i++;
+  }
+  return resized;
+}
+
+bool VisitedLinkMaster::ResizeSegmentIfNecessary(int segment_index) {
+  const Segment& segment = segments_[segment_index];
 
   // Load limits for good performance/space. We are pretty conservative about
   // keeping the table not very full. This is because we use linear probing
@@ -694,59 +938,81 @@ bool VisitedLinkMaster::ResizeTableIfNecessary() {
   const float max_table_load = 0.5f;  // Grow when we're > this full.
   const float min_table_load = 0.2f;  // Shrink when we're < this full.
 
-  float load = ComputeTableLoad();
+  float load = ComputeSegmentLoad(segment);
   if (load < max_table_load &&
-      (table_length_ <= static_cast<float>(kDefaultTableSize) ||
+      (segment.table_length <= static_cast<float>(kDefaultTableSize) ||
        load > min_table_load))
     return false;
 
-  // Table needs to grow or shrink.
-  int new_size = NewTableSizeForCount(used_items_);
-  DCHECK(new_size > used_items_);
-  DCHECK(load <= min_table_load || new_size > table_length_);
-  ResizeTable(new_size);
-  return true;
+  // Segment needs to grow or shrink. When it can not grow any further, split
+  // it in two instead.
+  int32 new_size = NewTableSizeForCount(segment.used_items);
+  if (load >= max_table_load && new_size <= segment.table_length) {
+    if (segment.depth >= kMaxSegmentDepth)
+      return false;
+    return SplitSegment(segment_index);
+  }
+  if (new_size == segment.table_length)
+    return false;
+  DCHECK(new_size > segment.used_items);
+  return ResizeSegment(segment_index, new_size);
 }
 
-void VisitedLinkMaster::ResizeTable(int32 new_size) {
-  DCHECK(shared_memory_ && shared_memory_->memory() && hash_table_);
-  shared_memory_serial_++;
+bool VisitedLinkMaster::ResizeSegment(int segment_index, int32 new_size) {
+  const Segment& old_segment = segments_[segment_index];
+  Segments new_segments(1);
+  if (!CreateSegment(new_size, old_segment.depth, old_segment.prefix, true,
+                     &new_segments[0]))
+    return false;
 
-#ifndef NDEBUG
-  DebugValidate();
-#endif
+  RehashSegment(old_segment, &new_segments);
+  CommitSegments(new_segments);
+  return true;
+}
 
-  base::SharedMemory* old_shared_memory = shared_memory_;
-  Fingerprint* old_hash_table = hash_table_;
-  int32 old_table_length = table_length_;
-  if (!BeginReplaceURLTable(new_size))
-    return;
+bool VisitedLinkMaster::SplitSegment(int segment_index) {
+  const Segment& old_segment = segments_[segment_index];
 
-  // Now we have two tables, our local copy which is the old one, and the new
-  // one loaded into this object where we need to copy the data.
-  for (int32 i = 0; i < old_table_length; i++) {
-    Fingerprint cur = old_hash_table[i];
+  // Size each half for the fingerprints it gets.
+  int32 depth = old_segment.depth + 1;
+  int32 counts[2] = { 0, 0 };
+  for (int32 i = 0; i < old_segment.table_length; i++) {
+    Fingerprint cur = old_segment.hash_table[i];
     if (cur)
-      AddFingerprint(cur, false);
+      counts[FingerprintPrefix(cur, depth) & 1]++;
   }
 
-  // On error unmapping, just forget about it since we can't do anything
-  // else to release it.
-  delete old_shared_memory;
-
-  // Send an update notification to all child processes so they read the new
-  // table.
-  listener_->NewTable(shared_memory_);
+  Segments new_segments(2);
+  for (int i = 0; i < 2; i++) {
+    if (!CreateSegment(NewTableSizeForCount(counts[i]), depth,
+                       (old_segment.prefix << 1) | i, true,
+                       &new_segments[i])) {
+      FreeSegments(Segments(new_segments.begin(), new_segments.begin() + i));
+      return false;
+    }
+  }
 
-#ifndef NDEBUG
-  DebugValidate();
-#endif
+  RehashSegment(old_segment, &new_segments);
+  CommitSegments(new_segments);
+  return true;
+}
 
-  // The new table needs to be written to disk.
-  WriteFullTable();
+void VisitedLinkMaster::RehashSegment(const Segment& from, Segments* to) {
+  for (int32 i = 0; i < from.table_length; i++) {
+    Fingerprint cur = from.hash_table[i];
+    if (!cur)
+      continue;
+    for (size_t j = 0; j < to->size(); j++) {
+      Segment* segment = &(*to)[j];
+      if (FingerprintPrefix(cur, segment->depth) == segment->prefix) {
+        AddFingerprintToSegment(cur, segment);
+        break;
+      }
+    }
+  }
 }
 
-uint32 VisitedLinkMaster::NewTableSizeForCount(int32 item_count) const {
+int32 VisitedLinkMaster::NewTableSizeForCount(int32 item_count) const {
   // These table sizes are selected to be the maximum prime number less than
   // a "convenient" multiple of 1K.
   static const int table_sizes[] = {
@@ -756,26 +1022,20 @@ uint32 VisitedLinkMaster::NewTableSizeForCount(int32 item_count) const {
       65521,    // 64K  = 65536
       130051,   // 128K = 131072
       262127,   // 256K = 262144
-      524269,   // 512K = 524288
-      1048549,  // 1M   = 1048576
-      2097143,  // 2M   = 2097152
-      4194301,  // 4M   = 4194304
-      8388571,  // 8M   = 8388608
-      16777199,  // 16M  = 16777216
-      33554347};  // 32M  = 33554432
-
-  // Try to leave the table 33% full.
+      524269};  // 512K = 524288  <- segments split instead of growing beyond
+                //                   this size (should be == kMaxSegmentSize)
+
+  // Try to leave the segment 33% full.
   int desired = item_count * 3;
 
   // Find the closest prime.
   for (size_t i = 0; i < arraysize(table_sizes); i ++) {
     if (table_sizes[i] > desired)
-      return table_sizes[i];
+      return std::min(table_sizes[i], max_segment_size_);
   }
 
-  // Growing very big, just approximate a "good" number, not growing as much
-  // as normal.
-  return item_count * 2 - 1;
+  // The segment is as big as it gets, it should be split.
+  return max_segment_size_;
 }
 
 // See the TableBuilder definition in the header file for how this works.
@@ -811,18 +1071,9 @@ void VisitedLinkMaster::OnTableRebuildComplete(
     const std::vector<Fingerprint>& fingerprints) {
   if (success) {
     // Replace the old table with a new blank one.
-    shared_memory_serial_++;
-
-    // We are responsible for freeing it AFTER it has been replaced if
-    // replacement succeeds.
-    base::SharedMemory* old_shared_memory = shared_memory_;
-
-    int new_table_size = NewTableSizeForCount(
-        static_cast<int>(fingerprints.size() + added_since_rebuild_.size()));
-    if (BeginReplaceURLTable(new_table_size)) {
-      // Free the old table.
-      delete old_shared_memory;
-
+    int item_count =
+        static_cast<int>(fingerprints.size() + added_since_rebuild_.size());
+    if (BeginReplaceURLTable(item_count, 0)) {
       // Add the stored fingerprints to the hash table.
       for (size_t i = 0; i < fingerprints.size(); i++)
         AddFingerprint(fingerprints[i], false);
@@ -843,7 +1094,7 @@ void VisitedLinkMaster::OnTableRebuildComplete(
       deleted_since_rebuild_.clear();
 
       // Send an update notification to all child processes.
-      listener_->NewTable(shared_memory_);
+      NotifyNewSegments(segments_);
 
       WriteFullTable();
     }
@@ -875,22 +1126,27 @@ void VisitedLinkMaster::WriteUsedItemCountToFile() {
   WriteToFile(file_, kFileHeaderUsedOffset, &used_items_, sizeof(used_items_));
 }
 
-void VisitedLinkMaster::WriteHashRangeToFile(Hash first_hash, Hash last_hash) {
+void VisitedLinkMaster::WriteHashRangeToFile(int segment_index,
+                                             Hash first_hash,
+                                             Hash last_hash) {
   if (!file_)
     return;  // See comment on the file_ variable for why this might happen.
+  const Segment& segment = segments_[segment_index];
+  DCHECK_GT(segment.file_offset, 0);
+  int32 table_offset = segment.file_offset + kFileSegmentHeaderSize;
   if (last_hash < first_hash) {
-    // Handle wraparound at 0. This first write is first_hash->EOF
-    WriteToFile(file_, first_hash * sizeof(Fingerprint) + kFileHeaderSize,
-                &hash_table_[first_hash],
-                (table_length_ - first_hash + 1) * sizeof(Fingerprint));
+    // Handle wraparound at 0. This first write is first_hash->end of segment.
+    WriteToFile(file_, first_hash * sizeof(Fingerprint) + table_offset,
+                &segment.hash_table[first_hash],
+                (segment.table_length - first_hash) * sizeof(Fingerprint));
 
     // Now do 0->last_lash.
-    WriteToFile(file_, kFileHeaderSize, hash_table_,
+    WriteToFile(file_, table_offset, segment.hash_table,
                 (last_hash + 1) * sizeof(Fingerprint));
   } else {
     // Normal case, just write the range.
-    WriteToFile(file_, first_hash * sizeof(Fingerprint) + kFileHeaderSize,
-                &hash_table_[first_hash],
+    WriteToFile(file_, first_hash * sizeof(Fingerprint) + table_offset,
+                &segment.hash_table[first_hash],
                 (last_hash - first_hash + 1) * sizeof(Fingerprint));
   }
 }
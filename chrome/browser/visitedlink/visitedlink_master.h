@@ -39,9 +39,12 @@ class VisitedLinkMaster : public VisitedLinkCommon {
    public:
     virtual ~Listener() {}
 
-    // Called when link coloring database has been created or replaced. The
-    // argument is the new table handle.
-    virtual void NewTable(base::SharedMemory*) = 0;
+    // Called when segments of the link coloring database have been created or
+    // replaced. Each new segment replaces the segments that held any of its
+    // fingerprints; the other segments stay valid. A segment that was split
+    // is replaced by both halves in one call.
+    virtual void NewSegments(
+        const std::vector<base::SharedMemory*>& segments) = 0;
 
     // Called when new link has been added. The argument is the fingerprint
     // (hash) of the link.
@@ -82,7 +85,9 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // object won't work.
   bool Init();
 
-  base::SharedMemory* shared_memory() { return shared_memory_; }
+  // Fills |segments| with the shared memory of every segment of the table.
+  void GetSharedMemorySegments(
+      std::vector<base::SharedMemory*>* segments) const;
 
   // Adds a URL to the table.
   void AddURL(const GURL& url);
@@ -120,12 +125,28 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   bool RewriteFile() {
     return WriteFullTable();
   }
+
+  // Limits the size of a segment, so that tests can make the table split
+  // without adding hundreds of thousands of URLs. Must be called before
+  // Init().
+  void set_max_segment_size(int32 max_segment_size) {
+    max_segment_size_ = max_segment_size;
+  }
+
+  // Adds the fingerprint like AddURL does, but only writes to disk when the
+  // table is resized. Used by the performance tester to fill big tables.
+  void AddFingerprintForTesting(Fingerprint fingerprint) {
+    int segment = SegmentIndexForFingerprint(fingerprint);
+    if (AddFingerprint(fingerprint, false) != null_hash_)
+      ResizeSegmentIfNecessary(segment);
+  }
 #endif
 
  private:
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, Delete);
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, BigDelete);
   FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, BigImport);
+  FRIEND_TEST_ALL_PREFIXES(VisitedLinkTest, SplitSegments);
 
   // Object to rebuild the table on the history thread (see the .cc file).
   class TableBuilder;
@@ -133,7 +154,7 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // Byte offsets of values in the header.
   static const int32 kFileHeaderSignatureOffset;
   static const int32 kFileHeaderVersionOffset;
-  static const int32 kFileHeaderLengthOffset;
+  static const int32 kFileHeaderSegmentsOffset;
   static const int32 kFileHeaderUsedOffset;
   static const int32 kFileHeaderSaltOffset;
 
@@ -146,9 +167,16 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // Bytes in the file header, including the salt.
   static const size_t kFileHeaderSize;
 
+  // Bytes in the header of each segment in the file: the depth, the prefix
+  // and the length of the segment.
+  static const size_t kFileSegmentHeaderSize;
+
   // When creating a fresh new table, we use this many entries.
   static const unsigned kDefaultTableSize;
 
+  // Segments never grow larger than this many entries, they split instead.
+  static const int32 kMaxSegmentSize;
+
   // When the user is deleting a boatload of URLs, we don't really want to do
   // individual writes for each of them. When the count exceeds this threshold,
   // we will write the whole table to disk at once instead of individual items.
@@ -159,8 +187,8 @@ class VisitedLinkMaster : public VisitedLinkCommon {
 
   // If a rebuild is in progress, we save the URL in the temporary list.
   // Otherwise, we add this to the table. Returns the index of the
-  // inserted fingerprint or null_hash_ on failure.
-  Hash TryToAddURL(const GURL& url);
+  // inserted fingerprint in the segment |segment| or null_hash_ on failure.
+  Hash TryToAddURL(const GURL& url, int* segment);
 
   // File I/O functions
   // ------------------
@@ -173,6 +201,17 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // the table file open and the handle to it in file_
   bool WriteFullTable();
 
+  // Appends the segments that replaced others to the file, or rewrites the
+  // whole file when the replaced ones take more room than the live table.
+  // |removed| are the segments that were replaced.
+  void WriteNewSegmentsToFile(const Segments& new_segments,
+                              const Segments& removed);
+
+  // Schedules writing the segment with the given index at |offset| in the
+  // file, and records the offset in the segment. Returns the offset past the
+  // end of the segment.
+  int32 WriteSegmentToFile(int segment, int32 offset);
+
   // Try to load the table from the database file. If the file doesn't exist or
   // is corrupt, this will return failure.
   bool InitFromFile();
@@ -181,11 +220,12 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // file pointer is at the beginning of the file and that there are no pending
   // asynchronous I/O operations.
   //
-  // Returns true on success and places the size of the table in num_entries
-  // and the number of nonzero fingerprints in used_count. This will fail if
-  // the version of the file is not the current version of the database.
-  bool ReadFileHeader(FILE* hfile, int32* num_entries, int32* used_count,
-                      uint8 salt[LINK_SALT_LENGTH]);
+  // Returns true on success and places the number of segments in the file in
+  // num_segments, the number of nonzero fingerprints in used_count and the
+  // file size in file_size. This will fail if the version of the file is not
+  // the current version of the database.
+  bool ReadFileHeader(FILE* hfile, int32* num_segments, int32* used_count,
+                      uint8 salt[LINK_SALT_LENGTH], int32* file_size);
 
   // Fills *filename with the name of the link database filename
   bool GetDatabaseFileName(FilePath* filename);
@@ -199,9 +239,9 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   void WriteUsedItemCountToFile();
 
   // Helper function to schedule an asynchronous write of the given range of
-  // hash functions to disk. The range is inclusive on both ends. The range can
-  // wrap around at 0 and this function will handle it.
-  void WriteHashRangeToFile(Hash first_hash, Hash last_hash);
+  // hash functions of a segment to disk. The range is inclusive on both ends.
+  // The range can wrap around at 0 and this function will handle it.
+  void WriteHashRangeToFile(int segment, Hash first_hash, Hash last_hash);
 
   // Synchronous read from the file. Assumes there are no pending asynchronous
   // I/O functions. Returns true if the entire buffer was successfully filled.
@@ -216,6 +256,11 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // duplicate and this item was skippped.
   Hash AddFingerprint(Fingerprint fingerprint, bool send_notifications);
 
+  // Adds a fingerprint to the given segment, which must be the one for its
+  // prefix, and updates the used count of the segment. Returns the index of
+  // the inserted fingerprint or null_hash_ if it was already there.
+  Hash AddFingerprintToSegment(Fingerprint fingerprint, Segment* segment);
+
   // Deletes all fingerprints from the given vector from the current hash table
   // and syncs it to disk if there are changes. This does not update the
   // deleted_since_rebuild_ list, the caller must update this itself if there
@@ -235,43 +280,60 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // database and for unit tests.
   bool InitFromScratch(bool suppress_rebuild);
 
-  // Allocates the Fingerprint structure and length. When init_to_empty is set,
-  // the table will be filled with 0s and used_items_ will be set to 0 as well.
-  // If the flag is not set, these things are untouched and it is the
-  // responsibility of the caller to fill them (like when we are reading from
-  // a file).
-  bool CreateURLTable(int32 num_entries, bool init_to_empty);
-
-  // A wrapper for CreateURLTable, this will allocate a new table, initialized
-  // to empty. The caller is responsible for saving the shared memory pointer
-  // and handles before this call (they will be replaced with new ones) and
-  // releasing them later. This is designed for callers that make a new table
-  // and then copy values from the old table to the new one, then release the
-  // old table.
+  // Allocates the shared memory of a segment with the given length that holds
+  // the fingerprints whose top |depth| bits are |prefix|. When init_to_empty
+  // is set, the table will be filled with 0s. If the flag is not set, it is
+  // the responsibility of the caller to fill it (like when we are reading
+  // from a file).
+  bool CreateSegment(int32 num_entries, int32 depth, uint32 prefix,
+                     bool init_to_empty, Segment* segment);
+
+  // Unallocates the shared memory of the given segments.
+  static void FreeSegments(const Segments& segments);
+
+  // Replaces the table with a new empty one, whose segments are sized for
+  // |item_count| fingerprints. When |segment_size| is nonzero the table is a
+  // single segment of that size instead. The caller is responsible for
+  // filling it and sending the new segments to the listener.
   //
-  // Returns true on success. On failure, the old table will be restored. The
-  // caller should not attemp to release the pointer/handle in this case.
-  bool BeginReplaceURLTable(int32 num_entries);
+  // Returns true on success. On failure, the old table is kept.
+  bool BeginReplaceURLTable(int32 item_count, int32 segment_size);
 
   // unallocates the Fingerprint table
   void FreeURLTable();
 
-  // For growing the table. ResizeTableIfNecessary will check to see if the
-  // table should be resized and calls ResizeTable if needed. Returns true if
-  // we decided to resize the table.
+  // Installs the given segments in place of the ones they cover, sends them
+  // to the listener and writes them to disk.
+  void CommitSegments(const Segments& new_segments);
+
+  // Calls Listener::NewSegments with the shared memory of the given segments.
+  void NotifyNewSegments(const Segments& segments);
+
+  // For growing the table. ResizeTableIfNecessary will check every segment
+  // and ResizeSegmentIfNecessary a single one, and resize or split them if
+  // needed. Returns true if we decided to resize the table.
   bool ResizeTableIfNecessary();
+  bool ResizeSegmentIfNecessary(int segment);
 
-  // Resizes the table (growing or shrinking) as necessary to accomodate the
-  // current count.
-  void ResizeTable(int32 new_size);
+  // Replaces the given segment with a new one of |new_size| entries (growing
+  // or shrinking) that holds the same fingerprints. Returns true on success.
+  bool ResizeSegment(int segment, int32 new_size);
 
-  // Returns the desired table size for |item_count| URLs.
-  uint32 NewTableSizeForCount(int32 item_count) const;
+  // Replaces the given segment, which has reached the maximum size, with two
+  // segments that each hold half of its fingerprints. Returns true on success.
+  bool SplitSegment(int segment);
 
-  // Computes the table load as fraction. For example, if 1/4 of the entries are
-  // full, this value will be 0.25
-  float ComputeTableLoad() const {
-    return static_cast<float>(used_items_) / static_cast<float>(table_length_);
+  // Adds the fingerprints of |from| to the segment in |to| that holds them.
+  void RehashSegment(const Segment& from, Segments* to);
+
+  // Returns the desired segment size for |item_count| URLs.
+  int32 NewTableSizeForCount(int32 item_count) const;
+
+  // Computes the segment load as fraction. For example, if 1/4 of the entries
+  // are full, this value will be 0.25
+  static float ComputeSegmentLoad(const Segment& segment) {
+    return static_cast<float>(segment.used_items) /
+           static_cast<float>(segment.table_length);
   }
 
   // Initializes a rebuild of the visited link database based on the browser
@@ -290,16 +352,16 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   void OnTableRebuildComplete(bool success,
                               const std::vector<Fingerprint>& fingerprints);
 
-  // Increases or decreases the given hash value by one, wrapping around as
-  // necessary. Used for probing.
-  inline Hash IncrementHash(Hash hash) {
-    if (hash >= table_length_ - 1)
+  // Increases or decreases the given hash value by one, wrapping around the
+  // table length as necessary. Used for probing.
+  static inline Hash IncrementHash(Hash hash, int32 table_length) {
+    if (hash >= table_length - 1)
       return 0;  // Wrap around.
     return hash + 1;
   }
-  inline Hash DecrementHash(Hash hash) {
+  static inline Hash DecrementHash(Hash hash, int32 table_length) {
     if (hash <= 0)
-      return table_length_ - 1;  // Wrap around.
+      return table_length - 1;  // Wrap around.
     return hash - 1;
   }
 
@@ -341,16 +403,22 @@ class VisitedLinkMaster : public VisitedLinkCommon {
   // be safely ignored in this case.
   FILE* file_;
 
-  // Shared memory consists of a SharedHeader followed by the table.
-  base::SharedMemory *shared_memory_;
+  // Size of the file and number of segments in it, including the segments
+  // that were replaced since the file was last written in full.
+  int32 file_length_;
+  int32 file_segment_count_;
 
   // When we generate new tables, we increment the serial number of the
   // shared memory object.
   int32 shared_memory_serial_;
 
-  // Number of non-empty items in the table, used to compute fullness.
+  // Number of non-empty items in the table.
   int32 used_items_;
 
+  // Segments split instead of growing beyond this many entries. This is
+  // kMaxSegmentSize except in tests.
+  int32 max_segment_size_;
+
   // Testing values -----------------------------------------------------------
   //
   // The following fields exist for testing purposes. They are not used in
@@ -387,9 +455,18 @@ class VisitedLinkMaster : public VisitedLinkCommon {
 #if defined(UNIT_TEST) || defined(PERF_TEST) || !defined(NDEBUG)
 inline void VisitedLinkMaster::DebugValidate() {
   int32 used_count = 0;
-  for (int32 i = 0; i < table_length_; i++) {
-    if (hash_table_[i])
-      used_count++;
+  for (size_t i = 0; i < segments_.size(); i++) {
+    const Segment& segment = segments_[i];
+    int32 segment_used_count = 0;
+    for (int32 j = 0; j < segment.table_length; j++) {
+      if (segment.hash_table[j]) {
+        DCHECK_EQ(segment.prefix,
+                  FingerprintPrefix(segment.hash_table[j], segment.depth));
+        segment_used_count++;
+      }
+    }
+    DCHECK_EQ(segment_used_count, segment.used_items);
+    used_count += segment_used_count;
   }
   DCHECK_EQ(used_count, used_items_);
 }
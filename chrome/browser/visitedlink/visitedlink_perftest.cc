@@ -22,6 +22,7 @@ namespace {
 // how we generate URLs, note that the two strings should be the same length
 const int add_count = 10000;
 const int load_test_add_count = 250000;
+const int resize_test_add_count = 10000000;
 const char added_prefix[] = "http://www.google.com/stuff/something/foo?session=85025602345625&id=1345142319023&seq=";
 const char unadded_prefix[] = "http://www.google.org/stuff/something/foo?session=39586739476365&id=2347624314402&seq=";
 
@@ -34,7 +35,7 @@ GURL TestURL(const char* prefix, int i) {
 class DummyVisitedLinkEventListener : public VisitedLinkMaster::Listener {
  public:
   DummyVisitedLinkEventListener() {}
-  virtual void NewTable(base::SharedMemory* table) {}
+  virtual void NewSegments(const std::vector<base::SharedMemory*>& segments) {}
   virtual void Add(VisitedLinkCommon::Fingerprint) {}
   virtual void Reset() {}
 
@@ -195,3 +196,32 @@ TEST_F(VisitedLink, TestLoad) {
   LogPerfResult("Visited_link_hot_load_time",
                 hot_sum / hot_load_times.size(), "ms");
 }
+
+// Tests the worst latency of adding a link while the table grows to 10M links.
+// The slowest additions are the ones that resize the table. Fingerprints are
+// generated directly since computing 10M URL fingerprints would dominate the
+// run time.
+TEST_F(VisitedLink, TestResizeLatency) {
+  VisitedLinkMaster master(DummyVisitedLinkEventListener::GetInstance(),
+                           NULL, true, db_path_, 0);
+  ASSERT_TRUE(master.Init());
+
+  PerfTimeLogger fill_timer("Visited_link_resize_fill");
+  TimeDelta max_add_time;
+  for (int i = 1; i <= resize_test_add_count; i++) {
+    // Multiplying by an odd constant spreads the fingerprints over all of the
+    // segments without repeating any.
+    VisitedLinkCommon::Fingerprint fingerprint =
+        static_cast<VisitedLinkCommon::Fingerprint>(i) *
+        GG_UINT64_C(0x9e3779b97f4a7c15);
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    master.AddFingerprintForTesting(fingerprint);
+    max_add_time = std::max(max_add_time,
+                            base::TimeTicks::HighResNow() - start);
+  }
+  fill_timer.Done();
+  ASSERT_EQ(resize_test_add_count, master.GetUsedCount());
+
+  LogPerfResult("Visited_link_max_add_time", max_add_time.InMillisecondsF(),
+                "ms");
+}
@@ -44,6 +44,25 @@ GURL TestURL(int i) {
 
 std::vector<VisitedLinkSlave*> g_slaves;
 
+// Hands the given segments of a master's table to |slave|.
+void SendSegmentsToSlave(const std::vector<base::SharedMemory*>& segments,
+                         VisitedLinkSlave* slave) {
+  std::vector<base::SharedMemoryHandle> handles;
+  for (size_t i = 0; i < segments.size(); i++) {
+    base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
+    segments[i]->ShareToProcess(base::GetCurrentProcessHandle(), &new_handle);
+    handles.push_back(new_handle);
+  }
+  slave->OnUpdateVisitedLinks(handles);
+}
+
+// Hands the whole table of |master| to |slave|.
+void SendTableToSlave(VisitedLinkMaster* master, VisitedLinkSlave* slave) {
+  std::vector<base::SharedMemory*> segments;
+  master->GetSharedMemorySegments(&segments);
+  SendSegmentsToSlave(segments, slave);
+}
+
 }  // namespace
 
 class TrackingVisitedLinkEventListener : public VisitedLinkMaster::Listener {
@@ -52,15 +71,10 @@ class TrackingVisitedLinkEventListener : public VisitedLinkMaster::Listener {
       : reset_count_(0),
         add_count_(0) {}
 
-  virtual void NewTable(base::SharedMemory* table) {
-    if (table) {
-      for (std::vector<VisitedLinkSlave>::size_type i = 0;
-           i < g_slaves.size(); i++) {
-        base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
-        table->ShareToProcess(base::GetCurrentProcessHandle(), &new_handle);
-        g_slaves[i]->OnUpdateVisitedLinks(new_handle);
-      }
-    }
+  virtual void NewSegments(const std::vector<base::SharedMemory*>& segments) {
+    for (std::vector<VisitedLinkSlave>::size_type i = 0;
+         i < g_slaves.size(); i++)
+      SendSegmentsToSlave(segments, g_slaves[i]);
   }
   virtual void Add(VisitedLinkCommon::Fingerprint) { add_count_++; }
   virtual void Reset() { reset_count_++; }
@@ -141,10 +155,7 @@ class VisitedLinkTest : public testing::Test {
 
     // Create a slave database.
     VisitedLinkSlave slave;
-    base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
-    master_->shared_memory()->ShareToProcess(
-        base::GetCurrentProcessHandle(), &new_handle);
-    slave.OnUpdateVisitedLinks(new_handle);
+    SendTableToSlave(master_.get(), &slave);
     g_slaves.push_back(&slave);
 
     bool found;
@@ -232,11 +243,13 @@ TEST_F(VisitedLinkTest, Delete) {
 
   // Deleting 14 should move the next value up one slot (we do not specify an
   // order).
-  EXPECT_EQ(kFingerprint3, master_->hash_table_[0]);
+  ASSERT_EQ(1U, master_->segments_.size());
+  VisitedLinkCommon::Fingerprint* hash_table = master_->segments_[0].hash_table;
+  EXPECT_EQ(kFingerprint3, hash_table[0]);
   master_->DeleteFingerprint(kFingerprint3, false);
   VisitedLinkCommon::Fingerprint zero_fingerprint = 0;
-  EXPECT_EQ(zero_fingerprint, master_->hash_table_[1]);
-  EXPECT_NE(zero_fingerprint, master_->hash_table_[0]);
+  EXPECT_EQ(zero_fingerprint, hash_table[1]);
+  EXPECT_NE(zero_fingerprint, hash_table[0]);
 
   // Deleting the other four should leave the table empty.
   master_->DeleteFingerprint(kFingerprint0, false);
@@ -246,7 +259,7 @@ TEST_F(VisitedLinkTest, Delete) {
 
   EXPECT_EQ(0, master_->used_items_);
   for (int i = 0; i < kInitialSize; i++)
-    EXPECT_EQ(zero_fingerprint, master_->hash_table_[i]) <<
+    EXPECT_EQ(zero_fingerprint, hash_table[i]) <<
         "Hash table has values in it.";
 }
 
@@ -282,10 +295,7 @@ TEST_F(VisitedLinkTest, DeleteAll) {
 
   {
     VisitedLinkSlave slave;
-    base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
-    master_->shared_memory()->ShareToProcess(
-        base::GetCurrentProcessHandle(), &new_handle);
-    slave.OnUpdateVisitedLinks(new_handle);
+    SendTableToSlave(master_.get(), &slave);
     g_slaves.push_back(&slave);
 
     // Add the test URLs.
@@ -331,10 +341,7 @@ TEST_F(VisitedLinkTest, Resizing) {
 
   // ...and a slave
   VisitedLinkSlave slave;
-  base::SharedMemoryHandle new_handle = base::SharedMemory::NULLHandle();
-  master_->shared_memory()->ShareToProcess(
-      base::GetCurrentProcessHandle(), &new_handle);
-  slave.OnUpdateVisitedLinks(new_handle);
+  SendTableToSlave(master_.get(), &slave);
   g_slaves.push_back(&slave);
 
   int32 used_count = master_->GetUsedCount();
@@ -347,22 +354,32 @@ TEST_F(VisitedLinkTest, Resizing) {
   }
 
   // Verify that the table got resized sufficiently.
-  int32 table_size;
-  VisitedLinkCommon::Fingerprint* table;
-  master_->GetUsageStatistics(&table_size, &table);
+  int32 total_size = 0;
+  for (int i = 0; i < master_->GetSegmentCount(); i++) {
+    int32 table_size;
+    VisitedLinkCommon::Fingerprint* table;
+    master_->GetUsageStatistics(i, &table_size, &table);
+    total_size += table_size;
+  }
   used_count = master_->GetUsedCount();
-  ASSERT_GT(table_size, used_count);
+  ASSERT_GT(total_size, used_count);
   ASSERT_EQ(used_count, g_test_count) <<
                 "table count doesn't match the # of things we added";
 
   // Verify that the slave got the resize message and has the same
   // table information.
-  int32 child_table_size;
-  VisitedLinkCommon::Fingerprint* child_table;
-  slave.GetUsageStatistics(&child_table_size, &child_table);
-  ASSERT_EQ(table_size, child_table_size);
-  for (int32 i = 0; i < table_size; i++) {
-    ASSERT_EQ(table[i], child_table[i]);
+  ASSERT_EQ(master_->GetSegmentCount(), slave.GetSegmentCount());
+  for (int i = 0; i < master_->GetSegmentCount(); i++) {
+    int32 table_size;
+    VisitedLinkCommon::Fingerprint* table;
+    master_->GetUsageStatistics(i, &table_size, &table);
+    int32 child_table_size;
+    VisitedLinkCommon::Fingerprint* child_table;
+    slave.GetUsageStatistics(i, &child_table_size, &child_table);
+    ASSERT_EQ(table_size, child_table_size);
+    for (int32 j = 0; j < table_size; j++) {
+      ASSERT_EQ(table[j], child_table[j]);
+    }
   }
 
   master_->DebugValidate();
@@ -437,6 +454,43 @@ TEST_F(VisitedLinkTest, BigImport) {
   ASSERT_EQ(used_count, total_count);
 }
 
+// Tests that a full segment is split in two, that the slaves replace only that
+// segment, and that the segments appended to the file are read back.
+TEST_F(VisitedLinkTest, SplitSegments) {
+  ASSERT_TRUE(InitHistory());
+  master_.reset(new VisitedLinkMaster(&listener_, history_service_, true,
+                                      visited_file_, 0));
+  master_->set_max_segment_size(VisitedLinkMaster::kDefaultTableSize);
+  ASSERT_TRUE(master_->Init());
+
+  VisitedLinkSlave slave;
+  SendTableToSlave(master_.get(), &slave);
+  g_slaves.push_back(&slave);
+
+  // A segment splits when it is half full, so this splits a few times.
+  const int url_count = VisitedLinkMaster::kDefaultTableSize;
+  for (int i = 0; i < url_count; i++)
+    master_->AddURL(TestURL(i));
+  EXPECT_GT(master_->GetSegmentCount(), 2);
+  EXPECT_EQ(url_count, master_->GetUsedCount());
+  master_->DebugValidate();
+
+  ASSERT_EQ(master_->GetSegmentCount(), slave.GetSegmentCount());
+  for (int i = 0; i < url_count; i++)
+    EXPECT_TRUE(slave.IsVisited(TestURL(i))) << "URL " << i;
+  EXPECT_FALSE(slave.IsVisited(GURL("http://unfound.site/")));
+  g_slaves.clear();
+
+  // Read the file back with the default segment size.
+  ClearDB();
+  ASSERT_TRUE(InitHistory());
+  ASSERT_TRUE(InitVisited(0, true));
+  master_->DebugValidate();
+  EXPECT_EQ(url_count, master_->GetUsedCount());
+  for (int i = 0; i < url_count; i++)
+    EXPECT_TRUE(master_->IsVisited(TestURL(i))) << "URL " << i;
+}
+
 TEST_F(VisitedLinkTest, Listener) {
   ASSERT_TRUE(InitHistory());
   ASSERT_TRUE(InitVisited(0, true));
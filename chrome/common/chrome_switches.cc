@@ -588,9 +588,15 @@ const char kEnablePnacl[]                   = "enable-pnacl";
 // To predominantly disable tracking (profiling), use the command line switch:
 // --enable-profiling=0
 // Some tracking will still take place at startup, but it will be turned off
-// during chrome_browser_main.
+// during chrome_browser_main.  To only track a sample of the tasks, which is
+// cheap enough to leave on, use --enable-profiling=sampled
 const char kEnableProfiling[]               = "enable-profiling";
 
+// Profiles the statements run on the history and cookie databases, and logs
+// where the time went when they are closed. See
+// sql::Connection::set_profiling_enabled().
+const char kEnableSQLProfiling[]            = "enable-sql-profiling";
+
 // Controls the support for SDCH filtering (dictionary based expansion of
 // content). By default SDCH filtering is enabled. To disable SDCH filtering,
 // use "--enable-sdch=0" as command line argument. SDCH is currently only
@@ -168,6 +168,7 @@ extern const char kEnablePlatformApps[];
 extern const char kEnablePnacl[];
 extern const char kEnableProfiling[];
 extern const char kEnableResourceContentSettings[];
+extern const char kEnableSQLProfiling[];
 extern const char kEnableSdch[];
 extern const char kEnableSpdy3[];
 extern const char kEnableSpdyFlowControl[];
@@ -86,6 +86,22 @@ void WriteToDiskTask(const FilePath& path, const std::string& data) {
   }
 }
 
+void SerializeAndWriteToDiskTask(
+    const FilePath& path,
+    const ImportantFileWriter::SerializeCallback& serialize_callback) {
+  std::string data;
+  if (!serialize_callback.Run(&data)) {
+    DLOG(WARNING) << "failed to serialize data to be saved in "
+                  << path.value();
+    return;
+  }
+  if (data.length() > static_cast<size_t>(kint32max)) {
+    NOTREACHED();
+    return;
+  }
+  WriteToDiskTask(path, data);
+}
+
 }  // namespace
 
 ImportantFileWriter::ImportantFileWriter(
@@ -132,6 +148,24 @@ void ImportantFileWriter::WriteNow(const std::string& data) {
   }
 }
 
+void ImportantFileWriter::WriteNowInBackground(
+    const SerializeCallback& serialize_callback) {
+  DCHECK(CalledOnValidThread());
+  DCHECK(!serialize_callback.is_null());
+
+  if (HasPendingWrite())
+    timer_.Stop();
+
+  if (!file_message_loop_proxy_->PostTask(
+      FROM_HERE,
+      base::Bind(&SerializeAndWriteToDiskTask, path_, serialize_callback))) {
+    // As in WriteNow(), avoid losing data if the file thread is gone.
+    NOTREACHED();
+
+    SerializeAndWriteToDiskTask(path_, serialize_callback);
+  }
+}
+
 void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
   DCHECK(CalledOnValidThread());
 
@@ -146,8 +180,12 @@ void ImportantFileWriter::ScheduleWrite(DataSerializer* serializer) {
 
 void ImportantFileWriter::DoScheduledWrite() {
   DCHECK(serializer_);
+  SerializeCallback serialize_callback =
+      serializer_->GetBackgroundSerializer();
   std::string data;
-  if (serializer_->SerializeData(&data)) {
+  if (!serialize_callback.is_null()) {
+    WriteNowInBackground(serialize_callback);
+  } else if (serializer_->SerializeData(&data)) {
     WriteNow(data);
   } else {
     DLOG(WARNING) << "failed to serialize data to be saved in "
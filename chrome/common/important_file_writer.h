@@ -9,6 +9,7 @@
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/callback.h"
 #include "base/file_path.h"
 #include "base/memory/ref_counted.h"
 #include "base/threading/non_thread_safe.h"
@@ -38,6 +39,10 @@ class Thread;
 // http://valhenson.livejournal.com/37921.html
 class ImportantFileWriter : public base::NonThreadSafe {
  public:
+  // Puts serialized data in its argument and returns true on success. Run on
+  // the file thread, so it must only use data it owns.
+  typedef base::Callback<bool(std::string*)> SerializeCallback;
+
   // Used by ScheduleSave to lazily provide the data to be saved. Allows us
   // to also batch data serializations.
   class DataSerializer {
@@ -48,6 +53,14 @@ class ImportantFileWriter : public base::NonThreadSafe {
     // serialization. Will be called on the same thread on which
     // ImportantFileWriter has been created.
     virtual bool SerializeData(std::string* data) = 0;
+
+    // Serializers whose data is cheaper to take a snapshot of than to
+    // serialize can return a callback which serializes the snapshot on the
+    // file thread, and is run instead of SerializeData(). Will be called on
+    // the same thread on which ImportantFileWriter has been created.
+    virtual SerializeCallback GetBackgroundSerializer() {
+      return SerializeCallback();
+    }
   };
 
   // Initialize the writer.
@@ -72,6 +85,10 @@ class ImportantFileWriter : public base::NonThreadSafe {
   // scheduled by ScheduleWrite, it is cancelled.
   void WriteNow(const std::string& data);
 
+  // Like WriteNow(), but runs |serialize_callback| on the file thread to get
+  // the data to save.
+  void WriteNowInBackground(const SerializeCallback& serialize_callback);
+
   // Schedule a save to target filename. Data will be serialized and saved
   // to disk after the commit interval. If another ScheduleWrite is issued
   // before that, only one serialization and write to disk will happen, and
@@ -4,6 +4,7 @@
 
 #include "chrome/common/important_file_writer.h"
 
+#include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
@@ -38,6 +39,32 @@ class DataSerializer : public ImportantFileWriter::DataSerializer {
   const std::string data_;
 };
 
+bool SerializeInBackground(const std::string& data, std::string* output) {
+  output->assign(data);
+  return true;
+}
+
+// Serializes its data through a callback, and fails if asked to serialize it
+// on the current thread.
+class BackgroundDataSerializer : public ImportantFileWriter::DataSerializer {
+ public:
+  explicit BackgroundDataSerializer(const std::string& data) : data_(data) {
+  }
+
+  virtual bool SerializeData(std::string* output) OVERRIDE {
+    ADD_FAILURE();
+    return false;
+  }
+
+  virtual ImportantFileWriter::SerializeCallback
+      GetBackgroundSerializer() OVERRIDE {
+    return base::Bind(&SerializeInBackground, data_);
+  }
+
+ private:
+  const std::string data_;
+};
+
 }  // namespace
 
 class ImportantFileWriterTest : public testing::Test {
@@ -103,6 +130,20 @@ TEST_F(ImportantFileWriterTest, DoScheduledWrite) {
   EXPECT_EQ("foo", GetFileContent(writer.path()));
 }
 
+TEST_F(ImportantFileWriterTest, DoScheduledWriteInBackground) {
+  base::Thread file_thread("test-file-thread");
+  ASSERT_TRUE(file_thread.Start());
+  ImportantFileWriter writer(file_, file_thread.message_loop_proxy());
+  BackgroundDataSerializer serializer("foo");
+  writer.ScheduleWrite(&serializer);
+  EXPECT_TRUE(writer.HasPendingWrite());
+  writer.DoScheduledWrite();
+  EXPECT_FALSE(writer.HasPendingWrite());
+  file_thread.Stop();
+  ASSERT_TRUE(file_util::PathExists(writer.path()));
+  EXPECT_EQ("foo", GetFileContent(writer.path()));
+}
+
 // Flaky - http://crbug.com/109292
 TEST_F(ImportantFileWriterTest, DISABLED_BatchingWrites) {
   ImportantFileWriter writer(file_,
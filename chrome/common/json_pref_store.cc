@@ -13,6 +13,7 @@
 #include "base/json/json_string_value_serializer.h"
 #include "base/memory/ref_counted.h"
 #include "base/message_loop_proxy.h"
+#include "base/stl_util.h"
 #include "base/values.h"
 
 namespace {
@@ -135,8 +136,98 @@ void FileThreadDeserializer::HandleErrors(
   }
 }
 
+// Serializes |prefs| into |output|, leaving out empty lists and dictionaries
+// but for the prefs in |keys_need_empty_value|.
+bool SerializePrefs(const DictionaryValue& prefs,
+                    const std::set<std::string>& keys_need_empty_value,
+                    std::string* output) {
+  // TODO(tc): Do we want to prune webkit preferences that match the default
+  // value?
+  JSONStringValueSerializer serializer(output);
+  serializer.set_pretty_print(true);
+  scoped_ptr<DictionaryValue> copy(prefs.DeepCopyWithoutEmptyChildren());
+
+  // Iterates |keys_need_empty_value| and if the key exists in |prefs|,
+  // ensure its empty ListValue or DictonaryValue is preserved.
+  for (std::set<std::string>::const_iterator
+       it = keys_need_empty_value.begin();
+       it != keys_need_empty_value.end();
+       ++it) {
+    const std::string& key = *it;
+
+    base::Value* value = NULL;
+    if (!prefs.Get(key, &value))
+      continue;
+
+    if (value->IsType(base::Value::TYPE_LIST)) {
+      const base::ListValue* list = NULL;
+      if (value->GetAsList(&list) && list->empty())
+        copy->Set(key, new base::ListValue);
+    } else if (value->IsType(base::Value::TYPE_DICTIONARY)) {
+      const base::DictionaryValue* dict = NULL;
+      if (value->GetAsDictionary(&dict) && dict->empty())
+        copy->Set(key, new base::DictionaryValue);
+    }
+  }
+
+  return serializer.Serialize(*(copy.get()));
+}
+
 }  // namespace
 
+// The prefs as of the last write, kept up to date and serialized on the file
+// thread.
+class JsonPrefStore::Snapshot
+    : public base::RefCountedThreadSafe<JsonPrefStore::Snapshot> {
+ public:
+  // The changes to the prefs since the previous write.
+  struct Changes {
+    Changes() {}
+    ~Changes() {
+      STLDeleteContainerPairSecondPointers(changed_prefs.begin(),
+                                           changed_prefs.end());
+    }
+
+    // All the prefs, if they are all to be replaced.
+    scoped_ptr<DictionaryValue> all_prefs;
+
+    // The keys of the prefs which changed, with copies of their values, or
+    // NULL for the prefs which were removed.
+    std::vector<std::pair<std::string, Value*> > changed_prefs;
+
+    std::set<std::string> keys_need_empty_value;
+  };
+
+  Snapshot() : prefs_(new DictionaryValue) {}
+
+  // Applies |changes| to the snapshot, and serializes it into |output|.
+  bool ApplyAndSerialize(Changes* changes, std::string* output) {
+    if (changes->all_prefs.get())
+      prefs_.swap(changes->all_prefs);
+
+    for (size_t i = 0; i < changes->changed_prefs.size(); ++i) {
+      std::pair<std::string, Value*>& changed_pref =
+          changes->changed_prefs[i];
+      if (changed_pref.second)
+        prefs_->Set(changed_pref.first, changed_pref.second);
+      else
+        prefs_->Remove(changed_pref.first, NULL);
+      // Ownership was passed to |prefs_|.
+      changed_pref.second = NULL;
+    }
+
+    return SerializePrefs(*prefs_, changes->keys_need_empty_value, output);
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<Snapshot>;
+  ~Snapshot() {}
+
+  scoped_ptr<DictionaryValue> prefs_;
+
+  DISALLOW_COPY_AND_ASSIGN(Snapshot);
+};
+
 JsonPrefStore::JsonPrefStore(const FilePath& filename,
                              base::MessageLoopProxy* file_message_loop_proxy)
     : path_(filename),
@@ -146,7 +237,9 @@ JsonPrefStore::JsonPrefStore(const FilePath& filename,
       writer_(filename, file_message_loop_proxy),
       error_delegate_(NULL),
       initialized_(false),
-      read_error_(PREF_READ_ERROR_OTHER) {
+      read_error_(PREF_READ_ERROR_OTHER),
+      snapshot_(new Snapshot),
+      all_changed_(true) {
 }
 
 PrefStore::ReadResult JsonPrefStore::GetValue(const std::string& key,
@@ -199,8 +292,10 @@ void JsonPrefStore::SetValueSilently(const std::string& key, Value* value) {
   prefs_->Get(key, &old_value);
   if (!old_value || !value->Equals(old_value)) {
     prefs_->Set(key, new_value.release());
-    if (!read_only_)
+    if (!read_only_) {
+      MarkChanged(key);
       writer_.ScheduleWrite(this);
+    }
   }
 }
 
@@ -256,8 +351,10 @@ void JsonPrefStore::CommitPendingWrite() {
 
 void JsonPrefStore::ReportValueChanged(const std::string& key) {
   FOR_EACH_OBSERVER(PrefStore::Observer, observers_, OnPrefValueChanged(key));
-  if (!read_only_)
+  if (!read_only_) {
+    MarkChanged(key);
     writer_.ScheduleWrite(this);
+  }
 }
 
 void JsonPrefStore::OnFileRead(Value* value_owned,
@@ -286,6 +383,7 @@ void JsonPrefStore::OnFileRead(Value* value_owned,
     case PREF_READ_ERROR_NONE:
       DCHECK(value.get());
       prefs_.reset(static_cast<DictionaryValue*>(value.release()));
+      all_changed_ = true;
       break;
     case PREF_READ_ERROR_NO_FILE:
       // If the file just doesn't exist, maybe this is first run.  In any case
@@ -311,34 +409,32 @@ JsonPrefStore::~JsonPrefStore() {
 }
 
 bool JsonPrefStore::SerializeData(std::string* output) {
-  // TODO(tc): Do we want to prune webkit preferences that match the default
-  // value?
-  JSONStringValueSerializer serializer(output);
-  serializer.set_pretty_print(true);
-  scoped_ptr<DictionaryValue> copy(prefs_->DeepCopyWithoutEmptyChildren());
-
-  // Iterates |keys_need_empty_value_| and if the key exists in |prefs_|,
-  // ensure its empty ListValue or DictonaryValue is preserved.
-  for (std::set<std::string>::const_iterator
-       it = keys_need_empty_value_.begin();
-       it != keys_need_empty_value_.end();
-       ++it) {
-    const std::string& key = *it;
-
-    base::Value* value = NULL;
-    if (!prefs_->Get(key, &value))
-      continue;
+  return SerializePrefs(*prefs_, keys_need_empty_value_, output);
+}
 
-    if (value->IsType(base::Value::TYPE_LIST)) {
-      const base::ListValue* list = NULL;
-      if (value->GetAsList(&list) && list->empty())
-        copy->Set(key, new base::ListValue);
-    } else if (value->IsType(base::Value::TYPE_DICTIONARY)) {
-      const base::DictionaryValue* dict = NULL;
-      if (value->GetAsDictionary(&dict) && dict->empty())
-        copy->Set(key, new base::DictionaryValue);
+ImportantFileWriter::SerializeCallback
+JsonPrefStore::GetBackgroundSerializer() {
+  Snapshot::Changes* changes = new Snapshot::Changes;
+  if (all_changed_) {
+    changes->all_prefs.reset(prefs_->DeepCopy());
+  } else {
+    changes->changed_prefs.reserve(changed_keys_.size());
+    for (std::set<std::string>::const_iterator it = changed_keys_.begin();
+         it != changed_keys_.end(); ++it) {
+      Value* value = NULL;
+      changes->changed_prefs.push_back(std::make_pair(
+          *it, prefs_->Get(*it, &value) ? value->DeepCopy() : NULL));
     }
   }
+  changes->keys_need_empty_value = keys_need_empty_value_;
+  all_changed_ = false;
+  changed_keys_.clear();
 
-  return serializer.Serialize(*(copy.get()));
+  return base::Bind(&Snapshot::ApplyAndSerialize, snapshot_,
+                    base::Owned(changes));
+}
+
+void JsonPrefStore::MarkChanged(const std::string& key) {
+  if (!all_changed_)
+    changed_keys_.insert(key);
 }
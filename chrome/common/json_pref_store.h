@@ -26,6 +26,11 @@ class Value;
 class FilePath;
 
 // A writable PrefStore implementation that is used for user preferences.
+//
+// The prefs are serialized on the file thread, from a snapshot of them kept
+// there.  Each write only copies the prefs which changed since the previous
+// one over to the snapshot, so that writing a change to a big preferences
+// file costs the thread the store lives on little more than the change does.
 class JsonPrefStore : public PersistentPrefStore,
                       public ImportantFileWriter::DataSerializer {
  public:
@@ -66,8 +71,15 @@ class JsonPrefStore : public PersistentPrefStore,
  private:
   virtual ~JsonPrefStore();
 
+  class Snapshot;
+
   // ImportantFileWriter::DataSerializer overrides:
   virtual bool SerializeData(std::string* output) OVERRIDE;
+  virtual ImportantFileWriter::SerializeCallback GetBackgroundSerializer()
+      OVERRIDE;
+
+  // Records that the pref |key| changed, for the next write.
+  void MarkChanged(const std::string& key);
 
   FilePath path_;
   scoped_refptr<base::MessageLoopProxy> file_message_loop_proxy_;
@@ -88,6 +100,14 @@ class JsonPrefStore : public PersistentPrefStore,
 
   std::set<std::string> keys_need_empty_value_;
 
+  // The prefs as of the last write, which only the file thread uses.
+  scoped_refptr<Snapshot> snapshot_;
+
+  // The keys of the prefs which changed since the last write, unless all of
+  // them are to be copied to |snapshot_|, as when they were read.
+  std::set<std::string> changed_keys_;
+  bool all_changed_;
+
   DISALLOW_COPY_AND_ASSIGN(JsonPrefStore);
 };
 
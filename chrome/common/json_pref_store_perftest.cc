@@ -0,0 +1,55 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/memory/ref_counted.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/scoped_temp_dir.h"
+#include "base/stringprintf.h"
+#include "base/threading/thread.h"
+#include "base/values.h"
+#include "chrome/common/json_pref_store.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kPrefCount = 10000;
+const int kChangeCount = 1000;
+
+}  // namespace
+
+// Logs the time a change to one pref of a big preferences file costs the
+// thread the store lives on, with the file written on its own thread.
+TEST(JsonPrefStorePerfTest, WriteChange) {
+  MessageLoop message_loop;
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  base::Thread file_thread("file");
+  ASSERT_TRUE(file_thread.Start());
+
+  scoped_refptr<JsonPrefStore> pref_store = new JsonPrefStore(
+      temp_dir.path().AppendASCII("Preferences"),
+      file_thread.message_loop_proxy());
+  EXPECT_EQ(PersistentPrefStore::PREF_READ_ERROR_NO_FILE,
+            pref_store->ReadPrefs());
+  for (int i = 0; i < kPrefCount; ++i) {
+    pref_store->SetValue(
+        base::StringPrintf("section%d.pref%d", i % 100, i),
+        Value::CreateStringValue(base::StringPrintf("value of pref %d", i)));
+  }
+  pref_store->CommitPendingWrite();
+
+  PerfTimer timer;
+  for (int i = 0; i < kChangeCount; ++i) {
+    pref_store->SetValue(base::StringPrintf("section%d.pref%d", i % 100, i),
+                         Value::CreateIntegerValue(i));
+    pref_store->CommitPendingWrite();
+  }
+  base::TimeDelta elapsed = timer.Elapsed();
+  LogPerfResult("json_pref_store_write_change",
+                elapsed.InMicroseconds() / static_cast<double>(kChangeCount),
+                "us/change");
+
+  file_thread.Stop();
+}
@@ -291,3 +291,57 @@ TEST_F(JsonPrefStoreTest, NeedsEmptyValue) {
   ASSERT_TRUE(file_util::PathExists(golden_output_file));
   EXPECT_TRUE(file_util::TextContentsEqual(golden_output_file, pref_file));
 }
+
+// Tests that writes after the first one, which only copy the prefs which
+// changed to the file thread, still write all the prefs.
+TEST_F(JsonPrefStoreTest, IncrementalWrites) {
+  FilePath pref_file = temp_dir_.path().AppendASCII("write.json");
+  ASSERT_TRUE(file_util::CopyFile(data_dir_.AppendASCII("read.json"),
+                                  pref_file));
+  scoped_refptr<JsonPrefStore> pref_store =
+      new JsonPrefStore(pref_file, message_loop_proxy_.get());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE, pref_store->ReadPrefs());
+
+  pref_store->SetValue("tabs.max_tabs", Value::CreateIntegerValue(10));
+  pref_store->CommitPendingWrite();
+  MessageLoop::current()->RunAllPending();
+
+  pref_store->SetValue("tabs.max_tabs", Value::CreateIntegerValue(5));
+  pref_store->RemoveValue("some_directory");
+  pref_store->SetValue("new.pref", Value::CreateStringValue("new"));
+  Value* list = NULL;
+  pref_store->SetValue("list", new base::ListValue);
+  ASSERT_EQ(PrefStore::READ_OK, pref_store->GetMutableValue("list", &list));
+  static_cast<base::ListValue*>(list)->Append(Value::CreateIntegerValue(1));
+  pref_store->ReportValueChanged("list");
+  pref_store->CommitPendingWrite();
+  MessageLoop::current()->RunAllPending();
+
+  scoped_refptr<JsonPrefStore> written_store =
+      new JsonPrefStore(pref_file, message_loop_proxy_.get());
+  ASSERT_EQ(PersistentPrefStore::PREF_READ_ERROR_NONE,
+            written_store->ReadPrefs());
+  const Value* actual = NULL;
+  int integer = 0;
+  ASSERT_EQ(PrefStore::READ_OK,
+            written_store->GetValue("tabs.max_tabs", &actual));
+  EXPECT_TRUE(actual->GetAsInteger(&integer));
+  EXPECT_EQ(5, integer);
+  bool boolean = false;
+  ASSERT_EQ(PrefStore::READ_OK,
+            written_store->GetValue("tabs.new_windows_in_tabs", &actual));
+  EXPECT_TRUE(actual->GetAsBoolean(&boolean));
+  EXPECT_TRUE(boolean);
+  std::string string_value;
+  ASSERT_EQ(PrefStore::READ_OK,
+            written_store->GetValue(prefs::kHomePage, &actual));
+  EXPECT_TRUE(actual->GetAsString(&string_value));
+  EXPECT_EQ("http://www.cnn.com", string_value);
+  ASSERT_EQ(PrefStore::READ_OK, written_store->GetValue("new.pref", &actual));
+  EXPECT_TRUE(actual->GetAsString(&string_value));
+  EXPECT_EQ("new", string_value);
+  EXPECT_EQ(PrefStore::READ_NO_VALUE,
+            written_store->GetValue("some_directory", &actual));
+  ASSERT_EQ(PrefStore::READ_OK, written_store->GetValue("list", &actual));
+  EXPECT_TRUE(actual->Equals(list));
+}
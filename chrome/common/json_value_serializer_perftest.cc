@@ -6,15 +6,40 @@
 
 #include "base/file_util.h"
 #include "base/json/json_string_value_serializer.h"
+#include "base/json/json_value_converter.h"
+#include "base/memory/scoped_vector.h"
 #include "base/path_service.h"
 #include "base/perftimer.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
 #include "base/values.h"
 #include "chrome/common/chrome_paths.h"
 #include "chrome/common/logging_chrome.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace {
+
+// The fields of the test cases, less "null", and the nested "dict", which is
+// skipped.
+struct TestCase {
+  bool bool_value;
+  int int_value;
+  ScopedVector<int> list;
+  double real;
+  std::string string_value;
+
+  TestCase() : bool_value(false), int_value(0), real(0) {}
+
+  static void RegisterJSONConverter(
+      base::JSONValueConverter<TestCase>* converter) {
+    converter->RegisterBoolField("bool", &TestCase::bool_value);
+    converter->RegisterIntField("int", &TestCase::int_value);
+    converter->RegisterRepeatedInt("list", &TestCase::list);
+    converter->RegisterDoubleField("real", &TestCase::real);
+    converter->RegisterStringField("string", &TestCase::string_value);
+  }
+};
+
 class JSONValueSerializerTests : public testing::Test {
  protected:
   virtual void SetUp() {
@@ -60,6 +85,55 @@ TEST_F(JSONValueSerializerTests, Reading) {
   chrome_timer.Done();
 }
 
+// Test reading a dictionary of many entries, whose keys are out of order.
+TEST_F(JSONValueSerializerTests, ReadingLargeDictionary) {
+  printf("\n");
+  const int kIterations = 1000;
+  const int kEntries = 1000;
+
+  std::string json("{");
+  for (int i = kEntries - 1; i >= 0; --i) {
+    base::StringAppendF(&json, "\"key%d\": {\"value\": %d, \"list\": [%d]}%s",
+                        i, i, i, i ? ", " : "}");
+  }
+
+  PerfTimeLogger chrome_timer("chrome");
+  for (int i = 0; i < kIterations; ++i) {
+    JSONStringValueSerializer reader(json);
+    scoped_ptr<Value> root(reader.Deserialize(NULL, NULL));
+    ASSERT_TRUE(root.get());
+  }
+  chrome_timer.Done();
+}
+
+// Test converting the test cases into structs, first through a Value, then
+// while reading them.
+TEST_F(JSONValueSerializerTests, Converting) {
+  printf("\n");
+  const int kIterations = 100000;
+  base::JSONValueConverter<TestCase> converter;
+
+  PerfTimeLogger value_timer("through_value");
+  for (int i = 0; i < kIterations; ++i) {
+    for (size_t j = 0; j < test_cases_.size(); ++j) {
+      JSONStringValueSerializer reader(test_cases_[j]);
+      scoped_ptr<Value> root(reader.Deserialize(NULL, NULL));
+      TestCase test_case;
+      ASSERT_TRUE(root.get() && converter.Convert(*root, &test_case));
+    }
+  }
+  value_timer.Done();
+
+  PerfTimeLogger stream_timer("while_reading");
+  for (int i = 0; i < kIterations; ++i) {
+    for (size_t j = 0; j < test_cases_.size(); ++j) {
+      TestCase test_case;
+      ASSERT_TRUE(converter.ConvertFromJSON(test_cases_[j], &test_case));
+    }
+  }
+  stream_timer.Done();
+}
+
 TEST_F(JSONValueSerializerTests, CompactWriting) {
   printf("\n");
   const int kIterations = 100000;
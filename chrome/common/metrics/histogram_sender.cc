@@ -18,6 +18,9 @@ void HistogramSender::TransmitAllHistograms(Histogram::Flags flag_to_set,
   for (StatisticsRecorder::Histograms::const_iterator it = histograms.begin();
        histograms.end() != it;
        ++it) {
+    // The browser reads the samples of these from the shared memory.
+    if ((*it)->in_shared_memory())
+      continue;
     (*it)->SetFlags(flag_to_set);
     if (send_only_uma &&
         0 == ((*it)->flags() & Histogram::kUmaTargetedHistogramFlag))
@@ -210,11 +210,12 @@ IPC_MESSAGE_ROUTED4(ChromeViewMsg_WebUIJavaScript,
 // render view responds with a ChromeViewHostMsg_Snapshot.
 IPC_MESSAGE_ROUTED0(ChromeViewMsg_CaptureSnapshot)
 
-// History system notification that the visited link database has been
-// replaced. It has one SharedMemoryHandle argument consisting of the table
-// handle. This handle is valid in the context of the renderer
-IPC_MESSAGE_CONTROL1(ChromeViewMsg_VisitedLink_NewTable,
-                     base::SharedMemoryHandle)
+// History system notification that segments of the visited link database have
+// been created or replaced. Each segment replaces the ones that held any of its
+// fingerprints, the others stay valid. The handles are valid in the context of
+// the renderer
+IPC_MESSAGE_CONTROL1(ChromeViewMsg_VisitedLink_NewSegments,
+                     std::vector<base::SharedMemoryHandle>)
 
 // History system notification that a link has been added and the link
 // coloring state for the given hash must be re-calculated.
@@ -6,6 +6,8 @@
 
 #include <string.h>  // for memset()
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/md5.h"
 #include "googleurl/src/gurl.h"
@@ -13,22 +15,101 @@
 const VisitedLinkCommon::Fingerprint VisitedLinkCommon::null_fingerprint_ = 0;
 const VisitedLinkCommon::Hash VisitedLinkCommon::null_hash_ = -1;
 
+const int32 VisitedLinkCommon::kMaxSegmentDepth = 16;
+
+namespace {
+
+// Returns the first and one past the last of the 32-bit fingerprint prefixes
+// that the segment with the given depth and prefix holds.
+uint64 SegmentRangeBegin(int32 depth, uint32 prefix) {
+  return static_cast<uint64>(prefix) << (32 - depth);
+}
+
+uint64 SegmentRangeEnd(int32 depth, uint32 prefix) {
+  return SegmentRangeBegin(depth, prefix) + (GG_UINT64_C(1) << (32 - depth));
+}
+
+}  // namespace
+
+VisitedLinkCommon::Segment::Segment()
+    : shared_memory(NULL),
+      hash_table(NULL),
+      table_length(0),
+      depth(0),
+      prefix(0),
+      used_items(0),
+      file_offset(0) {
+}
+
 VisitedLinkCommon::VisitedLinkCommon()
-    : hash_table_(NULL),
-      table_length_(0) {
+    : directory_depth_(0) {
   memset(salt_, 0, sizeof(salt_));
 }
 
 VisitedLinkCommon::~VisitedLinkCommon() {
 }
 
+// static
+bool VisitedLinkCommon::SegmentsOverlap(const Segment& a, const Segment& b) {
+  return SegmentRangeBegin(a.depth, a.prefix) <
+             SegmentRangeEnd(b.depth, b.prefix) &&
+         SegmentRangeBegin(b.depth, b.prefix) <
+             SegmentRangeEnd(a.depth, a.prefix);
+}
+
+void VisitedLinkCommon::ReplaceSegments(const Segments& new_segments,
+                                        Segments* removed) {
+  for (Segments::const_iterator i = new_segments.begin();
+       i != new_segments.end(); ++i) {
+    for (Segments::iterator j = segments_.begin(); j != segments_.end();) {
+      if (SegmentsOverlap(*i, *j)) {
+        removed->push_back(*j);
+        j = segments_.erase(j);
+      } else {
+        ++j;
+      }
+    }
+  }
+  segments_.insert(segments_.end(), new_segments.begin(), new_segments.end());
+
+  // Keep the segments ordered by their fingerprints. There are few of them,
+  // and they only change when the table is resized.
+  for (size_t i = 1; i < segments_.size(); i++) {
+    for (size_t j = i; j > 0; j--) {
+      const Segment& a = segments_[j - 1];
+      const Segment& b = segments_[j];
+      if (SegmentRangeBegin(a.depth, a.prefix) <=
+          SegmentRangeBegin(b.depth, b.prefix))
+        break;
+      std::swap(segments_[j - 1], segments_[j]);
+    }
+  }
+  RebuildDirectory();
+}
+
+void VisitedLinkCommon::RebuildDirectory() {
+  directory_depth_ = 0;
+  for (size_t i = 0; i < segments_.size(); i++)
+    directory_depth_ = std::max(directory_depth_, segments_[i].depth);
+
+  directory_.assign(segments_.empty() ? 0 : 1 << directory_depth_, -1);
+  for (size_t i = 0; i < segments_.size(); i++) {
+    // A segment that is shallower than the directory covers several of its
+    // entries.
+    int32 shift = directory_depth_ - segments_[i].depth;
+    uint32 first = segments_[i].prefix << shift;
+    for (uint32 entry = first; entry < first + (1 << shift); entry++)
+      directory_[entry] = static_cast<int>(i);
+  }
+}
+
 // FIXME: this uses linear probing, it should be replaced with quadratic
 // probing or something better. See VisitedLinkMaster::AddFingerprint
 bool VisitedLinkCommon::IsVisited(const char* canonical_url,
                                   size_t url_len) const {
   if (url_len == 0)
     return false;
-  if (!hash_table_ || table_length_ == 0)
+  if (segments_.empty())
     return false;
   return IsVisited(ComputeURLFingerprint(canonical_url, url_len));
 }
@@ -41,10 +122,15 @@ bool VisitedLinkCommon::IsVisited(Fingerprint fingerprint) const {
   // Go through the table until we find the item or an empty spot (meaning it
   // wasn't found). This loop will terminate as long as the table isn't full,
   // which should be enforced by AddFingerprint.
-  Hash first_hash = HashFingerprint(fingerprint);
+  int index = SegmentIndexForFingerprint(fingerprint);
+  if (index < 0)
+    return false;
+  const Segment& segment = segments_[index];
+
+  Hash first_hash = HashFingerprint(fingerprint, segment.table_length);
   Hash cur_hash = first_hash;
   while (true) {
-    Fingerprint cur_fingerprint = FingerprintAt(cur_hash);
+    Fingerprint cur_fingerprint = FingerprintAt(segment, cur_hash);
     if (cur_fingerprint == null_fingerprint_)
       return false;  // End of probe sequence found.
     if (cur_fingerprint == fingerprint)
@@ -53,7 +139,7 @@ bool VisitedLinkCommon::IsVisited(Fingerprint fingerprint) const {
     // This spot was taken, but not by the item we're looking for, search in
     // the next position.
     cur_hash++;
-    if (cur_hash == table_length_)
+    if (cur_hash == segment.table_length)
       cur_hash = 0;
     if (cur_hash == first_hash) {
       // Wrapped around and didn't find an empty space, this means we're in an
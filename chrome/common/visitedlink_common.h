@@ -12,6 +12,10 @@
 
 class GURL;
 
+namespace base {
+class SharedMemory;
+}
+
 // number of bytes in the salt
 #define LINK_SALT_LENGTH 8
 
@@ -20,7 +24,7 @@ class GURL;
 // VisitedLinkMaster), while all other processes should be read-only
 // (implemented by VisitedLinkSlave). These other processes add links by calling
 // the writer process to add them for it. The writer may also notify the readers
-// to replace their table when the table is resized.
+// to replace parts of their table when the table is resized.
 //
 // IPC is not implemented in these classes. This is done through callback
 // functions supplied by the creator of these objects to allow more flexibility,
@@ -34,6 +38,13 @@ class GURL;
 // master does a lot of work to manage the table, reading and writing it to and
 // from disk, and resizing it when it gets too full.
 //
+// The table is split into segments using extendible hashing. Each segment is
+// a separate hash table in its own shared memory, and holds the fingerprints
+// whose top |depth| bits equal the segment's |prefix|. A directory indexed by
+// the top bits of a fingerprint finds its segment. Growing the table replaces
+// or splits a single segment, so only that segment is rehashed and sent to
+// the readers.
+//
 // To ask whether a page is in history, we compute a 64-bit fingerprint of the
 // URL. This URL is hashed and we see if it is in the URL hashtable. If it is,
 // we consider it visited. Otherwise, it is unvisited. Note that it is possible
@@ -71,34 +82,103 @@ class VisitedLinkCommon {
   bool IsVisited(Fingerprint fingerprint) const;
 
 #ifdef UNIT_TEST
-  // Returns statistics about DB usage
-  void GetUsageStatistics(int32* table_size,
+  // Returns the number of segments in the table.
+  int GetSegmentCount() const {
+    return static_cast<int>(segments_.size());
+  }
+
+  // Returns statistics about DB usage of the given segment. Segments are
+  // ordered by the fingerprints they hold, so the master and the slaves
+  // number the same segments the same way.
+  void GetUsageStatistics(int segment,
+                          int32* table_size,
                           VisitedLinkCommon::Fingerprint** fingerprints) {
-    *table_size = table_length_;
-    *fingerprints = hash_table_;
+    *table_size = segments_[segment].table_length;
+    *fingerprints = segments_[segment].hash_table;
   }
 #endif
 
  protected:
-  // This structure is at the beginning of the shared memory so that the slaves
-  // can get stats on the table
+  // This structure is at the beginning of the shared memory of each segment so
+  // that the slaves can get stats on the segment
   struct SharedHeader {
-    // see goes into table_length_
+    // goes into Segment::table_length
     uint32 length;
 
     // goes into salt_
     uint8 salt[LINK_SALT_LENGTH];
+
+    // go into Segment::depth and Segment::prefix
+    uint32 depth;
+    uint32 prefix;
   };
 
-  // Returns the fingerprint at the given index into the URL table. This
+  // One segment of the table.
+  struct Segment {
+    Segment();
+
+    // Shared memory consists of a SharedHeader followed by the table. Owned by
+    // the subclass.
+    base::SharedMemory* shared_memory;
+
+    // pointer to the first item
+    Fingerprint* hash_table;
+
+    // the number of items in the hash table
+    int32 table_length;
+
+    // The segment holds the fingerprints whose top |depth| bits are |prefix|.
+    int32 depth;
+    uint32 prefix;
+
+    // Number of non-empty items and the offset of the segment in the database
+    // file. Only maintained by the master.
+    int32 used_items;
+    int32 file_offset;
+  };
+  typedef std::vector<Segment> Segments;
+
+  // The deepest a segment may be split. Bounds the size of the directory.
+  static const int32 kMaxSegmentDepth;
+
+  // Returns the fingerprint at the given index into the segment. This
   // function should be called instead of accessing the table directly to
   // contain endian issues.
-  Fingerprint FingerprintAt(int32 table_offset) const {
-    if (!hash_table_)
+  static Fingerprint FingerprintAt(const Segment& segment,
+                                   int32 table_offset) {
+    if (!segment.hash_table)
       return null_fingerprint_;
-    return hash_table_[table_offset];
+    return segment.hash_table[table_offset];
+  }
+
+  // Returns the top |depth| bits of the fingerprint, which select the segment
+  // holding it.
+  static uint32 FingerprintPrefix(Fingerprint fingerprint, int32 depth) {
+    if (depth == 0)
+      return 0;
+    return static_cast<uint32>(fingerprint >> (64 - depth));
+  }
+
+  // Returns the index into segments_ of the segment for the given
+  // fingerprint, or -1 if there is no such segment.
+  int SegmentIndexForFingerprint(Fingerprint fingerprint) const {
+    if (directory_.empty())
+      return -1;
+    return directory_[FingerprintPrefix(fingerprint, directory_depth_)];
   }
 
+  // Returns true if the two segments hold some of the same fingerprints.
+  static bool SegmentsOverlap(const Segment& a, const Segment& b);
+
+  // Replaces the segments that hold any of the fingerprints of
+  // |new_segments| with them, and updates the directory. The replaced
+  // segments are appended to |removed| so the caller can free them. The new
+  // segments must not overlap each other.
+  void ReplaceSegments(const Segments& new_segments, Segments* removed);
+
+  // Rebuilds the directory from segments_.
+  void RebuildDirectory();
+
   // Computes the fingerprint of the given canonical URL. It is static so the
   // same algorithm can be re-used by the table rebuilder, so you will have to
   // pass the salt as a parameter. See the non-static version above if you
@@ -114,16 +194,14 @@ class VisitedLinkCommon {
       return null_hash_;
     return static_cast<Hash>(fingerprint % table_length);
   }
-  // Uses the current hashtable.
-  Hash HashFingerprint(Fingerprint fingerprint) const {
-    return HashFingerprint(fingerprint, table_length_);
-  }
 
-  // pointer to the first item
-  VisitedLinkCommon::Fingerprint* hash_table_;
+  // The segments of the table, ordered by the fingerprints they hold.
+  Segments segments_;
 
-  // the number of items in the hash table
-  int32 table_length_;
+  // Maps the top |directory_depth_| bits of a fingerprint to the index of its
+  // segment in segments_, or -1 when no segment holds those fingerprints.
+  std::vector<int> directory_;
+  int32 directory_depth_;
 
   // salt used for each URL when computing the fingerprint
   uint8 salt_[LINK_SALT_LENGTH];
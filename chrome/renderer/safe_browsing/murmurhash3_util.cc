@@ -7,7 +7,7 @@
 
 namespace safe_browsing {
 
-uint32 MurmurHash3String(const std::string& str, uint32 seed) {
+uint32 MurmurHash3String(const base::StringPiece& str, uint32 seed) {
   uint32 output;
   MurmurHash3_x86_32(str.data(), str.size(), seed, &output);
   return output;
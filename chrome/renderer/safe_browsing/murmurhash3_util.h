@@ -5,14 +5,14 @@
 #ifndef CHROME_RENDERER_SAFE_BROWSING_MURMURHASH3_UTIL_H_
 #define CHROME_RENDERER_SAFE_BROWSING_MURMURHASH3_UTIL_H_
 
-#include <string>
 #include "base/basictypes.h"
+#include "base/string_piece.h"
 
 namespace safe_browsing {
 
 // Runs the 32-bit murmurhash3 function on the given string and returns the
 // output as a uint32.
-uint32 MurmurHash3String(const std::string& str, uint32 seed);
+uint32 MurmurHash3String(const base::StringPiece& str, uint32 seed);
 
 }  // namespace safe_browsing
 
@@ -4,8 +4,7 @@
 
 #include "chrome/renderer/safe_browsing/phishing_term_feature_extractor.h"
 
-#include <list>
-#include <map>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/compiler_specific.h"
@@ -13,6 +12,7 @@
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/metrics/histogram.h"
+#include "base/string_util.h"
 #include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "crypto/sha2.h"
@@ -40,15 +40,35 @@ const int PhishingTermFeatureExtractor::kMaxTotalTimeMs = 500;
 // The maximum size of the negative word cache.
 const int PhishingTermFeatureExtractor::kMaxNegativeWordCacheSize = 1000;
 
+// An odd 64-bit constant, used to combine word hashes into n-gram
+// fingerprints.
+const uint64 PhishingTermFeatureExtractor::kNgramFingerprintMultiplier =
+    GG_UINT64_C(0x9e3779b97f4a7c15);
+
 // All of the state pertaining to the current feature extraction.
 struct PhishingTermFeatureExtractor::ExtractionState {
-  // Stores up to max_words_per_term_ previous words separated by spaces.
+  // Stores up to max_words_per_term_ - 1 previous words, lowercased and
+  // UTF-8 encoded, each followed by a space.  The current word is appended to
+  // it while it is handled, so that every n-gram ending with the current word
+  // is a suffix of this string.
   std::string previous_words;
 
-  // Stores the sizes of the words in previous_words.  Note: the size includes
-  // the space after each word.  In other words, the sum of all sizes in this
-  // list is equal to the length of previous_words.
-  std::list<size_t> previous_word_sizes;
+  // The offset in previous_words at which each of the previous words starts.
+  std::vector<size_t> previous_word_starts;
+
+  // The murmur3 hash of each of the previous words.
+  std::vector<uint32> previous_word_hashes;
+
+  // Fingerprints of the n-grams whose SHA-256 hash has already been looked up
+  // in page_term_hashes_.  The fingerprint of an n-gram is computed from the
+  // murmur3 hashes of its words, so that we only hash and look up each
+  // distinct n-gram of the page once.
+  base::hash_set<uint64> checked_ngrams;
+
+  // Used to lowercase words which can't be lowercased one character at a
+  // time.
+  string16 lowercase_buffer;
+  std::string utf8_buffer;
 
   // An iterator for word breaking.
   UBreakIterator* iterator;
@@ -216,64 +236,106 @@ void PhishingTermFeatureExtractor::HandleWord(
   if (negative_word_cache_.Get(word) != negative_word_cache_.end()) {
     // We know we're no longer in a possible n-gram, so clear the previous word
     // state.
-    state_->previous_words.clear();
-    state_->previous_word_sizes.clear();
+    ClearPreviousWords();
     return;
   }
 
-  std::string word_lower = UTF16ToUTF8(base::i18n::ToLower(word));
+  // The word is lowercased and converted straight into previous_words, so
+  // that every n-gram ending with it can be hashed in place.
+  std::string& words = state_->previous_words;
+  const size_t word_start = words.size();
+  AppendLowercaseUTF8(word, &words);
+  const base::StringPiece word_lower(words.data() + word_start,
+                                     words.size() - word_start);
   uint32 word_hash = MurmurHash3String(word_lower, murmurhash3_seed_);
 
   // Quick out if the word is not part of any term, which is the common case.
   if (page_word_hashes_->find(word_hash) == page_word_hashes_->end()) {
     // Word doesn't exist in our terms so we can clear the n-gram state.
-    state_->previous_words.clear();
-    state_->previous_word_sizes.clear();
+    ClearPreviousWords();
     // Insert into negative cache so that we don't try this again.
     negative_word_cache_.Put(word, true);
     return;
   }
 
-  // Find all of the n-grams that we need to check and compute their SHA-256
-  // hashes.
-  std::map<std::string /* hash */, std::string /* plaintext */>
-      hashes_to_check;
-  hashes_to_check[crypto::SHA256HashString(word_lower)] = word_lower;
-
-  // Combine the new word with the previous words to find additional n-grams.
-  // Note that we don't yet add the new word length to previous_word_sizes,
-  // since we don't want to compute the hash for the word by itself again.
-  //
-  state_->previous_words.append(word_lower);
-  std::string current_term = state_->previous_words;
-  for (std::list<size_t>::iterator it = state_->previous_word_sizes.begin();
-       it != state_->previous_word_sizes.end(); ++it) {
-    hashes_to_check[crypto::SHA256HashString(current_term)] = current_term;
-    current_term.erase(0, *it);
-  }
-
-  // Add features for any hashes that match page_term_hashes_.
-  for (std::map<std::string, std::string>::iterator it =
-           hashes_to_check.begin();
-       it != hashes_to_check.end(); ++it) {
-    if (page_term_hashes_->find(it->first) != page_term_hashes_->end()) {
-      features_->AddBooleanFeature(features::kPageTerm + it->second);
+  // Check the current word by itself, then combined with each of the previous
+  // words, from the most recent one back.  The fingerprint of each n-gram is
+  // rolled from the one before by mixing in the hash of the word it adds.
+  uint64 fingerprint = word_hash;
+  size_t ngram_start = word_start;
+  size_t i = state_->previous_word_starts.size();
+  while (true) {
+    // Only n-grams which we have not seen yet on this page need their SHA-256
+    // hash computed.  A fingerprint collision could hide a term, but with
+    // 64-bit fingerprints and the few n-grams that get this far that is very
+    // unlikely.
+    if (state_->checked_ngrams.insert(fingerprint).second) {
+      base::StringPiece ngram(words.data() + ngram_start,
+                              words.size() - ngram_start);
+      if (page_term_hashes_->find(crypto::SHA256HashString(ngram)) !=
+          page_term_hashes_->end()) {
+        features_->AddBooleanFeature(features::kPageTerm + ngram.as_string());
+      }
     }
+    if (i == 0)
+      break;
+    --i;
+    ngram_start = state_->previous_word_starts[i];
+    fingerprint = fingerprint * kNgramFingerprintMultiplier +
+        state_->previous_word_hashes[i];
   }
 
   // Now that we have handled the current word, we have to add a space at the
-  // end of it, and add the new word's size (including the space) to
-  // previous_word_sizes.  Note: it's possible that the document language
-  // doesn't use ASCII spaces to separate words.  That's fine though, we just
-  // need to be consistent with how the model is generated.
-  state_->previous_words.append(" ");
-  state_->previous_word_sizes.push_back(word_lower.size() + 1);
-
-  // Cap the number of previous words.
-  if (state_->previous_word_sizes.size() >= max_words_per_term_) {
-    state_->previous_words.erase(0, state_->previous_word_sizes.front());
-    state_->previous_word_sizes.pop_front();
+  // end of it, and remember where it starts.  Note: it's possible that the
+  // document language doesn't use ASCII spaces to separate words.  That's fine
+  // though, we just need to be consistent with how the model is generated.
+  words.push_back(' ');
+  state_->previous_word_starts.push_back(word_start);
+  state_->previous_word_hashes.push_back(word_hash);
+
+  // Cap the number of previous words.  There are only a few of them, so
+  // shifting them down is cheap.
+  if (state_->previous_word_starts.size() >= max_words_per_term_) {
+    size_t removed_size = state_->previous_word_starts.size() > 1 ?
+        state_->previous_word_starts[1] : words.size();
+    words.erase(0, removed_size);
+    state_->previous_word_starts.erase(state_->previous_word_starts.begin());
+    state_->previous_word_hashes.erase(state_->previous_word_hashes.begin());
+    for (size_t j = 0; j < state_->previous_word_starts.size(); ++j)
+      state_->previous_word_starts[j] -= removed_size;
+  }
+}
+
+void PhishingTermFeatureExtractor::AppendLowercaseUTF8(
+    const base::StringPiece16& word,
+    std::string* output) {
+  // Most words are ASCII, which we can lowercase and convert one character at
+  // a time.  'I' is left to ICU, since it does not lowercase to 'i' in every
+  // locale.
+  bool simple = true;
+  for (size_t i = 0; i < word.size(); ++i) {
+    if (word[i] >= 0x80 || word[i] == 'I') {
+      simple = false;
+      break;
+    }
+  }
+  if (simple) {
+    for (size_t i = 0; i < word.size(); ++i)
+      output->push_back(static_cast<char>(base::ToLowerASCII(word[i])));
+    return;
   }
+
+  state_->lowercase_buffer = base::i18n::ToLower(word);
+  UTF16ToUTF8(state_->lowercase_buffer.data(),
+              state_->lowercase_buffer.size(),
+              &state_->utf8_buffer);
+  output->append(state_->utf8_buffer);
+}
+
+void PhishingTermFeatureExtractor::ClearPreviousWords() {
+  state_->previous_words.clear();
+  state_->previous_word_starts.clear();
+  state_->previous_word_hashes.clear();
 }
 
 void PhishingTermFeatureExtractor::CheckNoPendingExtraction() {
@@ -99,6 +99,10 @@ class PhishingTermFeatureExtractor {
   // casing, hashing, and UTF conversion.
   static const int kMaxNegativeWordCacheSize;
 
+  // The multiplier used to roll the fingerprint of an n-gram from the hashes
+  // of its words.
+  static const uint64 kNgramFingerprintMultiplier;
+
   // Does the actual work of ExtractFeatures.  ExtractFeaturesWithTimeout runs
   // until a predefined maximum amount of time has elapsed, then posts a task
   // to the current MessageLoop to continue extraction.  When extraction
@@ -108,6 +112,13 @@ class PhishingTermFeatureExtractor {
   // Handles a single word in the page text.
   void HandleWord(const base::StringPiece16& word);
 
+  // Appends |word|, lowercased and converted to UTF-8, to |output|.
+  void AppendLowercaseUTF8(const base::StringPiece16& word,
+                           std::string* output);
+
+  // Clears the previous words of the current n-gram.
+  void ClearPreviousWords();
+
   // Helper to verify that there is no pending feature extraction.  Dies in
   // debug builds if the state is not as expected.  This is a no-op in release
   // builds.
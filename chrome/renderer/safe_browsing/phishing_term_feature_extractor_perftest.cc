@@ -0,0 +1,135 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/compiler_specific.h"
+#include "base/hash_tables.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/string16.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "base/utf_string_conversions.h"
+#include "chrome/renderer/safe_browsing/feature_extractor_clock.h"
+#include "chrome/renderer/safe_browsing/features.h"
+#include "chrome/renderer/safe_browsing/murmurhash3_util.h"
+#include "chrome/renderer/safe_browsing/phishing_term_feature_extractor.h"
+#include "crypto/sha2.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace safe_browsing {
+
+namespace {
+
+const uint32 kMurmurHash3Seed = 2777808611U;
+
+// The size of the text of the pages, in characters.
+const size_t kPageSize = 1024 * 1024;
+
+// Words which make up the terms of the model.
+const char* const kTermWords[] = {
+  "account", "bank", "confirm", "login", "password", "sign", "verify",
+};
+
+// A clock which does not move, so that the extractor handles the whole page
+// in one chunk and never gives up on it.
+class FrozenClock : public FeatureExtractorClock {
+ public:
+  FrozenClock() : now_(base::TimeTicks::Now()) {}
+  virtual ~FrozenClock() {}
+
+  virtual base::TimeTicks Now() OVERRIDE { return now_; }
+
+ private:
+  base::TimeTicks now_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrozenClock);
+};
+
+class PhishingTermFeatureExtractorPerfTest : public testing::Test {
+ protected:
+  PhishingTermFeatureExtractorPerfTest() : success_(false) {}
+
+  virtual void SetUp() {
+    // All of the words, and the pairs of words, are terms.
+    for (size_t i = 0; i < arraysize(kTermWords); ++i) {
+      word_hashes_.insert(MurmurHash3String(kTermWords[i], kMurmurHash3Seed));
+      term_hashes_.insert(crypto::SHA256HashString(kTermWords[i]));
+      for (size_t j = 0; j < arraysize(kTermWords); ++j) {
+        term_hashes_.insert(crypto::SHA256HashString(
+            std::string(kTermWords[i]) + " " + kTermWords[j]));
+      }
+    }
+    extractor_.reset(new PhishingTermFeatureExtractor(
+        &term_hashes_, &word_hashes_, 3 /* max_words_per_term */,
+        kMurmurHash3Seed, &clock_));
+  }
+
+  // Returns kPageSize characters of ASCII text in which one word out of
+  // |term_word_ratio| is a term word.  Every |upper_case_ratio|th word is in
+  // upper case.
+  static string16 MakePage(int term_word_ratio, int upper_case_ratio) {
+    std::string page;
+    for (int i = 0; page.size() < kPageSize; ++i) {
+      std::string word;
+      if (i % term_word_ratio == 0)
+        word = kTermWords[(i / term_word_ratio) % arraysize(kTermWords)];
+      else
+        word = base::StringPrintf("word%d", i % 5000);
+      if (i % upper_case_ratio == 0)
+        StringToUpperASCII(&word);
+      page.append(word);
+      page.append(i % 12 == 11 ? ". " : " ");
+    }
+    page.resize(kPageSize);
+    return ASCIIToUTF16(page);
+  }
+
+  // Extracts the features of |page_text| and logs how long it took, in
+  // milliseconds per megabyte of ASCII text.
+  void ExtractAndLog(const std::string& name, const string16& page_text) {
+    FeatureMap features;
+    PerfTimer timer;
+    extractor_->ExtractFeatures(
+        &page_text, &features,
+        base::Bind(&PhishingTermFeatureExtractorPerfTest::ExtractionDone,
+                   base::Unretained(this)));
+    MessageLoop::current()->Run();
+    base::TimeDelta elapsed = timer.Elapsed();
+    EXPECT_TRUE(success_);
+    EXPECT_FALSE(features.features().empty());
+
+    double megabytes = page_text.size() / (1024.0 * 1024.0);
+    LogPerfResult(name.c_str(), elapsed.InMillisecondsF() / megabytes,
+                  "ms/MB");
+  }
+
+  void ExtractionDone(bool success) {
+    success_ = success;
+    MessageLoop::current()->Quit();
+  }
+
+  FrozenClock clock_;
+  base::hash_set<std::string> term_hashes_;
+  base::hash_set<uint32> word_hashes_;
+  scoped_ptr<PhishingTermFeatureExtractor> extractor_;
+  bool success_;
+};
+
+}  // namespace
+
+TEST_F(PhishingTermFeatureExtractorPerfTest, LargePages) {
+  // Most words on a page are not part of any term.
+  ExtractAndLog("term_extraction_sparse_terms", MakePage(50, 20));
+  // A page stuffed with terms, most of them repeated.
+  ExtractAndLog("term_extraction_dense_terms", MakePage(2, 20));
+  // Upper case words with an I in them are lowercased by ICU.
+  ExtractAndLog("term_extraction_upper_case", MakePage(2, 1));
+}
+
+}  // namespace safe_browsing
@@ -198,6 +198,42 @@ TEST_F(PhishingTermFeatureExtractorTest, ExtractFeatures) {
   EXPECT_THAT(features.features(), ContainerEq(expected_features.features()));
 }
 
+TEST_F(PhishingTermFeatureExtractorTest, RepeatedTerms) {
+  // This test doesn't exercise the extraction timing.
+  EXPECT_CALL(clock_, Now()).WillRepeatedly(Return(base::TimeTicks::Now()));
+
+  // Each n-gram is only checked once per page, but the terms are found
+  // wherever they first appear, including across the n-gram window.
+  string16 page_text = ASCIIToUTF16("multi word multi word test one two one "
+                                    "one bla multi word test");
+  FeatureMap expected_features;
+  expected_features.AddBooleanFeature(features::kPageTerm +
+                                      std::string("multi word test"));
+  expected_features.AddBooleanFeature(features::kPageTerm +
+                                      std::string("one"));
+  expected_features.AddBooleanFeature(features::kPageTerm +
+                                      std::string("one one"));
+  expected_features.AddBooleanFeature(features::kPageTerm +
+                                      std::string("two"));
+
+  FeatureMap features;
+  ASSERT_TRUE(ExtractFeatures(&page_text, &features));
+  EXPECT_THAT(features.features(), ContainerEq(expected_features.features()));
+
+  // Words which are not lowercased one character at a time match the same
+  // terms.
+  page_text = ASCIIToUTF16("MULTI WORD TEST CAPITALIZATION");
+  expected_features.Clear();
+  expected_features.AddBooleanFeature(features::kPageTerm +
+                                      std::string("multi word test"));
+  expected_features.AddBooleanFeature(features::kPageTerm +
+                                      std::string("capitalization"));
+
+  features.Clear();
+  ASSERT_TRUE(ExtractFeatures(&page_text, &features));
+  EXPECT_THAT(features.features(), ContainerEq(expected_features.features()));
+}
+
 TEST_F(PhishingTermFeatureExtractorTest, Continuation) {
   // For this test, we'll cause the feature extraction to run multiple
   // iterations by incrementing the clock.
@@ -6,6 +6,8 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
@@ -72,15 +74,40 @@ Scorer* Scorer::Create(const base::StringPiece& model_str) {
   for (int i = 0; i < model.page_word_size(); ++i) {
     scorer->page_words_.insert(model.page_word(i));
   }
+  for (int i = 0; i < model.hashes_size(); ++i) {
+    scorer->hash_indices_[model.hashes(i)] = i;
+  }
+  // Index the rules by feature so that scoring only looks at the rules of the
+  // features which are present.  A rule whose feature index is out of range
+  // can never apply.
+  scorer->feature_rules_.resize(model.hashes_size());
+  scorer->rule_feature_counts_.resize(model.rule_size());
+  for (int i = 0; i < model.rule_size(); ++i) {
+    const ClientSideModel::Rule& rule = model.rule(i);
+    if (rule.feature_size() == 0) {
+      scorer->empty_rules_.push_back(i);
+      continue;
+    }
+    for (int j = 0; j < rule.feature_size(); ++j) {
+      int feature = rule.feature(j);
+      if (feature < 0 || feature >= model.hashes_size()) {
+        scorer->rule_feature_counts_[i] = -1;
+        break;
+      }
+      std::vector<int>& rules = scorer->feature_rules_[feature];
+      if (!rules.empty() && rules.back() == i)
+        continue;  // The rule repeats this feature.
+      rules.push_back(i);
+      ++scorer->rule_feature_counts_[i];
+    }
+  }
   return scorer.release();
 }
 
 double Scorer::ComputeScore(const FeatureMap& features) const {
-  double logodds = 0.0;
-  for (int i = 0; i < model_.rule_size(); ++i) {
-    logodds += ComputeRuleScore(model_.rule(i), features);
-  }
-  return LogOdds2Prob(logodds);
+  FeatureVector vector;
+  GetFeatureVector(features, &vector);
+  return LogOdds2Prob(ComputeLogOdds(vector));
 }
 
 int Scorer::model_version() const {
@@ -103,19 +130,57 @@ uint32 Scorer::murmurhash3_seed() const {
   return model_.murmur_hash_seed();
 }
 
-double Scorer::ComputeRuleScore(const ClientSideModel::Rule& rule,
-                                const FeatureMap& features) const {
+void Scorer::GetFeatureVector(const FeatureMap& features,
+                              FeatureVector* vector) const {
+  vector->clear();
   const base::hash_map<std::string, double>& feature_map = features.features();
+  for (base::hash_map<std::string, double>::const_iterator it =
+           feature_map.begin();
+       it != feature_map.end(); ++it) {
+    if (it->second == 0.0) {
+      // A feature with a zero weight gives any rule it is in a score of zero,
+      // the same as if it were missing.
+      continue;
+    }
+    base::hash_map<std::string, int>::const_iterator index =
+        hash_indices_.find(it->first);
+    if (index != hash_indices_.end())
+      vector->push_back(std::make_pair(index->second, it->second));
+  }
+  std::sort(vector->begin(), vector->end());
+}
+
+double Scorer::ComputeLogOdds(const FeatureVector& vector) const {
+  // A rule applies once all of its features have been seen.  The features of
+  // a vector are distinct, so counting them is enough.
+  std::vector<int> applied_rules(empty_rules_);
+  base::hash_map<int, int> seen_counts;
+  for (FeatureVector::const_iterator it = vector.begin(); it != vector.end();
+       ++it) {
+    const std::vector<int>& rules = feature_rules_[it->first];
+    for (size_t i = 0; i < rules.size(); ++i) {
+      if (++seen_counts[rules[i]] == rule_feature_counts_[rules[i]])
+        applied_rules.push_back(rules[i]);
+    }
+  }
+
+  // Sum in the order of the rules so that the score does not depend on the
+  // order in which the features were seen.
+  std::sort(applied_rules.begin(), applied_rules.end());
+  double logodds = 0.0;
+  for (size_t i = 0; i < applied_rules.size(); ++i) {
+    logodds += ComputeRuleScore(model_.rule(applied_rules[i]), vector);
+  }
+  return logodds;
+}
+
+double Scorer::ComputeRuleScore(const ClientSideModel::Rule& rule,
+                                const FeatureVector& vector) const {
   double rule_score = 1.0;
   for (int i = 0; i < rule.feature_size(); ++i) {
-    base::hash_map<std::string, double>::const_iterator it = feature_map.find(
-        model_.hashes(rule.feature(i)));
-    if (it == feature_map.end() || it->second == 0.0) {
-      // If the feature of the rule does not exist in the given feature map the
-      // feature weight is considered to be zero.  If the feature weight is zero
-      // we leave early since we know that the rule score will be zero.
-      return 0.0;
-    }
+    FeatureVector::const_iterator it = std::lower_bound(
+        vector.begin(), vector.end(), std::make_pair(rule.feature(i), 0.0));
+    DCHECK(it != vector.end() && it->first == rule.feature(i));
     rule_score *= it->second;
   }
   return rule_score * rule.weight();
@@ -16,6 +16,8 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/hash_tables.h"
@@ -66,18 +68,43 @@ class Scorer {
  private:
   friend class PhishingScorerTest;
 
-  // Computes the score for a given rule and feature map.  The score is computed
-  // by multiplying the rule weight with the product of feature weights for the
-  // given rule.  The feature weights are stored in the feature map.  If a
-  // particular feature does not exist in the feature map we set its weight to
-  // zero.
+  // A sparse feature vector: the index in the model hashes of each feature
+  // that appears in the model with a non-zero weight, and its weight, sorted
+  // by index.
+  typedef std::vector<std::pair<int, double> > FeatureVector;
+
+  // Fills |vector| with the features of |features| which appear in the model.
+  void GetFeatureVector(const FeatureMap& features,
+                        FeatureVector* vector) const;
+
+  // Computes the log odds for the given feature vector.  Only the rules which
+  // contain one of the features of |vector|, and the rules without any
+  // feature, are looked at.
+  double ComputeLogOdds(const FeatureVector& vector) const;
+
+  // Computes the score for a given rule and feature vector.  The score is
+  // computed by multiplying the rule weight with the product of feature
+  // weights for the given rule.  The rule must only contain features of
+  // |vector|.
   double ComputeRuleScore(const ClientSideModel::Rule& rule,
-                          const FeatureMap& features) const;
+                          const FeatureVector& vector) const;
 
   ClientSideModel model_;
   base::hash_set<std::string> page_terms_;
   base::hash_set<uint32> page_words_;
 
+  // Maps each of the model hashes to its index.
+  base::hash_map<std::string, int> hash_indices_;
+
+  // For each of the model hashes, the indices of the rules which contain it.
+  std::vector<std::vector<int> > feature_rules_;
+
+  // The number of distinct features in each rule.
+  std::vector<int> rule_feature_counts_;
+
+  // The indices of the rules without any feature, which always apply.
+  std::vector<int> empty_rules_;
+
   DISALLOW_COPY_AND_ASSIGN(Scorer);
 };
 }  // namepsace safe_browsing
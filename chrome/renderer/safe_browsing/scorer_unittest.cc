@@ -4,6 +4,9 @@
 
 #include "chrome/renderer/safe_browsing/scorer.h"
 
+#include <utility>
+#include <vector>
+
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/format_macros.h"
@@ -58,6 +61,15 @@ class PhishingScorerTest : public ::testing::Test {
     model_.set_murmur_hash_seed(12345U);
   }
 
+  // Returns the feature vector that |scorer| computes the score of for
+  // |features|.
+  static std::vector<std::pair<int, double> > GetFeatureVector(
+      const Scorer& scorer, const FeatureMap& features) {
+    Scorer::FeatureVector vector;
+    scorer.GetFeatureVector(features, &vector);
+    return vector;
+  }
+
   ClientSideModel model_;
 };
 
@@ -125,4 +137,41 @@ TEST_F(PhishingScorerTest, ComputeScore) {
   EXPECT_TRUE(features.AddBooleanFeature("feature2"));
   EXPECT_DOUBLE_EQ(0.77729986117469119, scorer->ComputeScore(features));
 }
+
+TEST_F(PhishingScorerTest, ComputeScoreSparseRules) {
+  ClientSideModel::Rule* rule;
+  // A rule which repeats a feature uses its weight twice.
+  rule = model_.add_rule();
+  rule->add_feature(2);  // feature3
+  rule->add_feature(2);  // feature3
+  rule->set_weight(4.0);
+  // A rule with a feature which is not in the model never applies.
+  rule = model_.add_rule();
+  rule->add_feature(2);  // feature3
+  rule->add_feature(100);
+  rule->set_weight(10.0);
+  scoped_ptr<Scorer> scorer(Scorer::Create(model_.SerializeAsString()));
+  ASSERT_TRUE(scorer.get());
+
+  // The expected logodds is 0.5 (empty rule) + 4.0 * 0.5 * 0.5 = 1.5
+  // => p = 0.8175744761936437
+  FeatureMap features;
+  EXPECT_TRUE(features.AddRealFeature("feature3", 0.5));
+  EXPECT_DOUBLE_EQ(0.8175744761936437, scorer->ComputeScore(features));
+
+  // A feature with a zero weight is the same as a missing feature.
+  EXPECT_TRUE(features.AddRealFeature("feature1", 0.0));
+  EXPECT_TRUE(features.AddBooleanFeature("feature2"));
+  EXPECT_DOUBLE_EQ(0.8175744761936437, scorer->ComputeScore(features));
+
+  // Only the features in the model are kept in the feature vector, sorted by
+  // their index in the model.
+  std::vector<std::pair<int, double> > vector =
+      GetFeatureVector(*scorer, features);
+  ASSERT_EQ(2U, vector.size());
+  EXPECT_EQ(1, vector[0].first);
+  EXPECT_DOUBLE_EQ(1.0, vector[0].second);
+  EXPECT_EQ(2, vector[1].first);
+  EXPECT_DOUBLE_EQ(0.5, vector[1].second);
+}
 }  // namespace safe_browsing
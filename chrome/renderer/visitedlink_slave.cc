@@ -5,13 +5,14 @@
 #include "chrome/renderer/visitedlink_slave.h"
 
 #include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/shared_memory.h"
 #include "chrome/common/render_messages.h"
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebView.h"
 
 using WebKit::WebView;
 
-VisitedLinkSlave::VisitedLinkSlave() : shared_memory_(NULL) {
+VisitedLinkSlave::VisitedLinkSlave() {
 }
 
 VisitedLinkSlave::~VisitedLinkSlave() {
@@ -21,7 +22,7 @@ VisitedLinkSlave::~VisitedLinkSlave() {
 bool VisitedLinkSlave::OnControlMessageReceived(const IPC::Message& message) {
   bool handled = true;
   IPC_BEGIN_MESSAGE_MAP(VisitedLinkSlave, message)
-    IPC_MESSAGE_HANDLER(ChromeViewMsg_VisitedLink_NewTable,
+    IPC_MESSAGE_HANDLER(ChromeViewMsg_VisitedLink_NewSegments,
                         OnUpdateVisitedLinks)
     IPC_MESSAGE_HANDLER(ChromeViewMsg_VisitedLink_Add, OnAddVisitedLinks)
     IPC_MESSAGE_HANDLER(ChromeViewMsg_VisitedLink_Reset, OnResetVisitedLinks)
@@ -30,60 +31,84 @@ bool VisitedLinkSlave::OnControlMessageReceived(const IPC::Message& message) {
   return handled;
 }
 
-// This function's job is to initialize the table with the given
-// shared memory handle. This memory is mapped into the process.
-void VisitedLinkSlave::OnUpdateVisitedLinks(base::SharedMemoryHandle table) {
-  DCHECK(base::SharedMemory::IsHandleValid(table)) << "Bad table handle";
-  // since this function may be called again to change the table, we may need
-  // to free old objects
-  FreeTable();
-  DCHECK(shared_memory_ == NULL && hash_table_ == NULL);
+// This function's job is to put the segments with the given shared memory
+// handles in the table. This memory is mapped into the process. The segments
+// they replace are unmapped, the others are kept.
+void VisitedLinkSlave::OnUpdateVisitedLinks(
+    const std::vector<base::SharedMemoryHandle>& segments) {
+  Segments new_segments;
+  for (size_t i = 0; i < segments.size(); i++) {
+    DCHECK(base::SharedMemory::IsHandleValid(segments[i]))
+        << "Bad table handle";
+    Segment segment;
+    if (MapSegment(segments[i], &segment))
+      new_segments.push_back(segment);
+  }
+
+  Segments removed;
+  ReplaceSegments(new_segments, &removed);
+  FreeSegments(removed);
+}
+
+void VisitedLinkSlave::OnAddVisitedLinks(
+    const VisitedLinkSlave::Fingerprints& fingerprints) {
+  for (size_t i = 0; i < fingerprints.size(); ++i)
+    WebView::updateVisitedLinkState(fingerprints[i]);
+}
+
+void VisitedLinkSlave::OnResetVisitedLinks() {
+  WebView::resetVisitedLinkState();
+}
 
+bool VisitedLinkSlave::MapSegment(base::SharedMemoryHandle handle,
+                                  Segment* segment) {
   // create the shared memory object
-  shared_memory_ = new base::SharedMemory(table, true);
-  if (!shared_memory_)
-    return;
+  scoped_ptr<base::SharedMemory> shared_memory(
+      new base::SharedMemory(handle, true));
 
   // map the header into our process so we can see how long the rest is,
   // and set the salt
-  if (!shared_memory_->Map(sizeof(SharedHeader)))
-    return;
+  if (!shared_memory->Map(sizeof(SharedHeader)))
+    return false;
   SharedHeader* header =
-    static_cast<SharedHeader*>(shared_memory_->memory());
+    static_cast<SharedHeader*>(shared_memory->memory());
   DCHECK(header);
   int32 table_len = header->length;
+  int32 depth = header->depth;
+  uint32 prefix = header->prefix;
   memcpy(salt_, header->salt, sizeof(salt_));
-  shared_memory_->Unmap();
+  shared_memory->Unmap();
 
-  // now do the whole table because we know the length
-  if (!shared_memory_->Map(sizeof(SharedHeader) +
-                          table_len * sizeof(Fingerprint))) {
-    shared_memory_->Close();
-    return;
+  if (table_len <= 0 || depth < 0 || depth > kMaxSegmentDepth ||
+      (prefix >> depth) != 0) {
+    NOTREACHED() << "Bad segment header";
+    return false;
   }
 
-  // commit the data
-  DCHECK(shared_memory_->memory());
-  hash_table_ = reinterpret_cast<Fingerprint*>(
-      static_cast<char*>(shared_memory_->memory()) + sizeof(SharedHeader));
-  table_length_ = table_len;
-}
+  // now do the whole segment because we know the length
+  if (!shared_memory->Map(sizeof(SharedHeader) +
+                          table_len * sizeof(Fingerprint)))
+    return false;
 
-void VisitedLinkSlave::OnAddVisitedLinks(
-    const VisitedLinkSlave::Fingerprints& fingerprints) {
-  for (size_t i = 0; i < fingerprints.size(); ++i)
-    WebView::updateVisitedLinkState(fingerprints[i]);
+  // commit the data
+  DCHECK(shared_memory->memory());
+  segment->hash_table = reinterpret_cast<Fingerprint*>(
+      static_cast<char*>(shared_memory->memory()) + sizeof(SharedHeader));
+  segment->table_length = table_len;
+  segment->depth = depth;
+  segment->prefix = prefix;
+  segment->shared_memory = shared_memory.release();
+  return true;
 }
 
-void VisitedLinkSlave::OnResetVisitedLinks() {
-  WebView::resetVisitedLinkState();
+// static
+void VisitedLinkSlave::FreeSegments(const Segments& segments) {
+  for (size_t i = 0; i < segments.size(); i++)
+    delete segments[i].shared_memory;
 }
 
 void VisitedLinkSlave::FreeTable() {
-  if (shared_memory_) {
-    delete shared_memory_;
-    shared_memory_ = NULL;
-  }
-  hash_table_ = NULL;
-  table_length_ = 0;
+  FreeSegments(segments_);
+  segments_.clear();
+  RebuildDirectory();
 }
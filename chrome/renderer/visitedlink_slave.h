@@ -6,6 +6,8 @@
 #define CHROME_RENDERER_VISITEDLINK_SLAVE_H_
 #pragma once
 
+#include <vector>
+
 #include "base/compiler_specific.h"
 #include "base/shared_memory.h"
 #include "chrome/common/visitedlink_common.h"
@@ -23,14 +25,19 @@ class VisitedLinkSlave : public VisitedLinkCommon,
   virtual bool OnControlMessageReceived(const IPC::Message& message) OVERRIDE;
 
   // Message handlers.
-  void OnUpdateVisitedLinks(base::SharedMemoryHandle table);
+  void OnUpdateVisitedLinks(
+      const std::vector<base::SharedMemoryHandle>& segments);
   void OnAddVisitedLinks(const VisitedLinkSlave::Fingerprints& fingerprints);
   void OnResetVisitedLinks();
  private:
-  void FreeTable();
+  // Maps the segment with the given handle into |segment|. Returns true on
+  // success.
+  bool MapSegment(base::SharedMemoryHandle handle, Segment* segment);
 
-  // shared memory consists of a SharedHeader followed by the table
-  base::SharedMemory* shared_memory_;
+  // Unmaps the given segments.
+  static void FreeSegments(const Segments& segments);
+
+  void FreeTable();
 
   DISALLOW_COPY_AND_ASSIGN(VisitedLinkSlave);
 };
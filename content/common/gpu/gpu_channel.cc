@@ -32,6 +32,10 @@ namespace {
 // allow a pattern of alternating fast and slow frames to occur.
 const int64 kHandleMoreWorkPeriodMs = 2;
 const int64 kHandleMoreWorkPeriodBusyMs = 1;
+
+// The time a command buffer of normal priority may process commands before it
+// yields the thread to other tasks.
+const int64 kSchedulerSliceMs = 4;
 }
 
 GpuChannel::GpuChannel(GpuChannelManager* gpu_channel_manager,
@@ -43,6 +47,8 @@ GpuChannel::GpuChannel(GpuChannelManager* gpu_channel_manager,
       client_id_(client_id),
       share_group_(share_group ? share_group : new gfx::GLShareGroup),
       mailbox_manager_(new gpu::gles2::MailboxManager),
+      multi_context_scheduler_(new gpu::MultiContextScheduler(
+          base::TimeDelta::FromMilliseconds(kSchedulerSliceMs))),
       watchdog_(watchdog),
       software_(software),
       handle_messages_scheduled_(false),
@@ -102,11 +108,17 @@ bool GpuChannel::OnMessageReceived(const IPC::Message& message) {
     return OnControlMessageReceived(message);
 
   if (message.type() == GpuCommandBufferMsg_GetStateFast::ID) {
+    // Commands which a command buffer yielded in the middle of are processed
+    // before anything else, so that the state returned includes them.
+    std::deque<IPC::Message*>::iterator point = deferred_messages_.begin();
+    while (point != deferred_messages_.end() &&
+           (*point)->type() == GpuCommandBufferMsg_Rescheduled::ID) {
+      ++point;
+    }
+
     if (processed_get_state_fast_) {
       // Require a non-GetStateFast message in between two GetStateFast
       // messages, to ensure progress is made.
-      std::deque<IPC::Message*>::iterator point = deferred_messages_.begin();
-
       while (point != deferred_messages_.end() &&
              (*point)->type() == GpuCommandBufferMsg_GetStateFast::ID) {
         ++point;
@@ -120,7 +132,7 @@ bool GpuChannel::OnMessageReceived(const IPC::Message& message) {
     } else {
       // Move GetStateFast commands to the head of the queue, so the renderer
       // doesn't have to wait any longer than necessary.
-      deferred_messages_.push_front(new IPC::Message(message));
+      deferred_messages_.insert(point, new IPC::Message(message));
     }
   } else {
     deferred_messages_.push_back(new IPC::Message(message));
@@ -297,9 +309,10 @@ void GpuChannel::HandleMessage() {
         Send(reply);
       }
     } else {
-      // If the command buffer becomes unscheduled as a result of handling the
-      // message but still has more commands to process, synthesize an IPC
-      // message to flush that command buffer.
+      // If the command buffer becomes unscheduled, or its slice runs out, as
+      // a result of handling the message but still has more commands to
+      // process, synthesize an IPC message to flush that command buffer
+      // before any later message.
       if (stub) {
         if (stub->HasUnprocessedCommands()) {
           deferred_messages_.push_front(new GpuCommandBufferMsg_Rescheduled(
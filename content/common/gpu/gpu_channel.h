@@ -18,6 +18,7 @@
 #include "content/common/gpu/gpu_command_buffer_stub.h"
 #include "content/common/gpu/gpu_memory_manager.h"
 #include "content/common/message_router.h"
+#include "gpu/command_buffer/service/multi_context_scheduler.h"
 #include "ipc/ipc_sync_channel.h"
 #include "ui/gfx/native_widget_types.h"
 #include "ui/gfx/size.h"
@@ -87,6 +88,12 @@ class GpuChannel : public IPC::Channel::Listener,
 
   gfx::GLShareGroup* share_group() const { return share_group_.get(); }
 
+  // Bounds the time the command buffers of the channel process commands
+  // before they yield the thread.
+  gpu::MultiContextScheduler* multi_context_scheduler() const {
+    return multi_context_scheduler_.get();
+  }
+
   GpuCommandBufferStub* LookupCommandBuffer(int32 route_id);
 
   void LoseAllContexts();
@@ -158,6 +165,10 @@ class GpuChannel : public IPC::Channel::Listener,
 
   scoped_refptr<gpu::gles2::MailboxManager> mailbox_manager_;
 
+  // Declared before |stubs_| so that it outlives the stubs, which remove
+  // their contexts from it when they are destroyed.
+  scoped_ptr<gpu::MultiContextScheduler> multi_context_scheduler_;
+
 #if defined(ENABLE_GPU)
   typedef IDMap<GpuCommandBufferStub, IDMapOwnPointer> StubMap;
   StubMap stubs_;
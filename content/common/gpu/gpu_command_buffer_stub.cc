@@ -84,16 +84,8 @@ bool GpuCommandBufferStub::OnMessageReceived(const IPC::Message& message) {
   // Ensure the appropriate GL context is current before handling any IPC
   // messages directed at the command buffer. This ensures that the message
   // handler can assume that the context is current.
-  if (decoder_.get()) {
-    if (!decoder_->MakeCurrent()) {
-      DLOG(ERROR) << "Context lost because MakeCurrent failed.";
-      command_buffer_->SetContextLostReason(decoder_->GetContextLostReason());
-      command_buffer_->SetParseError(gpu::error::kLostContext);
-      if (gfx::GLContext::LosesAllContextsOnContextLost())
-        channel_->LoseAllContexts();
-      return false;
-    }
-  }
+  if (!MakeCurrent())
+    return false;
 
   // Always use IPC_MESSAGE_HANDLER_DELAY_REPLY for synchronous message handlers
   // here. This is so the reply can be delayed if the scheduler is unscheduled.
@@ -154,16 +146,8 @@ bool GpuCommandBufferStub::HasMoreWork() {
 }
 
 void GpuCommandBufferStub::PollWork() {
-  if (decoder_.get()) {
-    if (!decoder_->MakeCurrent()) {
-      DLOG(ERROR) << "Context lost because MakeCurrent failed.";
-      command_buffer_->SetContextLostReason(decoder_->GetContextLostReason());
-      command_buffer_->SetParseError(gpu::error::kLostContext);
-      if (gfx::GLContext::LosesAllContextsOnContextLost())
-        channel_->LoseAllContexts();
-      return;
-    }
-  }
+  if (!MakeCurrent())
+    return;
   if (scheduler_.get())
     scheduler_->PollUnscheduleFences();
 }
@@ -199,9 +183,37 @@ void GpuCommandBufferStub::OnReschedule() {
   channel_->OnScheduled();
 }
 
+bool GpuCommandBufferStub::MakeCurrent() {
+  if (!decoder_.get() || decoder_->MakeCurrent())
+    return true;
+  DLOG(ERROR) << "Context lost because MakeCurrent failed.";
+  command_buffer_->SetContextLostReason(decoder_->GetContextLostReason());
+  command_buffer_->SetParseError(gpu::error::kLostContext);
+  if (gfx::GLContext::LosesAllContextsOnContextLost())
+    channel_->LoseAllContexts();
+  return false;
+}
+
+gpu::MultiContextScheduler::Priority
+GpuCommandBufferStub::GetSchedulingPriority() const {
+  // Contexts drawing to a hidden surface get a smaller share of the channel.
+  if (surface_state_.get() && !surface_state_->visible)
+    return gpu::MultiContextScheduler::PRIORITY_LOW;
+  return gpu::MultiContextScheduler::PRIORITY_NORMAL;
+}
+
+void GpuCommandBufferStub::OnPutOffsetChanged() {
+  // The commands are processed right away, in order with the other messages
+  // of the stub, but only for a slice. If the slice runs out the channel
+  // resumes them before any later message of the stub.
+  channel_->multi_context_scheduler()->RunSlice(scheduler_.get());
+}
+
 void GpuCommandBufferStub::Destroy() {
   // The scheduler has raw references to the decoder and the command buffer so
   // destroy it before those.
+  if (scheduler_.get())
+    channel_->multi_context_scheduler()->RemoveContext(scheduler_.get());
   scheduler_.reset();
 
   while (!delayed_echos_.empty()) {
@@ -256,6 +268,9 @@ void GpuCommandBufferStub::OnInitialize(
 
   decoder_->set_engine(scheduler_.get());
 
+  channel_->multi_context_scheduler()->AddContext(scheduler_.get(),
+                                                  GetSchedulingPriority());
+
   if (!handle_.is_null()) {
 #if defined(OS_MACOSX) || defined(UI_COMPOSITOR_IMAGE_TRANSPORT)
     if (software_) {
@@ -329,8 +344,8 @@ void GpuCommandBufferStub::OnInitialize(
                  base::Unretained(this)));
 
   command_buffer_->SetPutOffsetChangeCallback(
-      base::Bind(&gpu::GpuScheduler::PutChanged,
-                 base::Unretained(scheduler_.get())));
+      base::Bind(&GpuCommandBufferStub::OnPutOffsetChanged,
+                 base::Unretained(this)));
   command_buffer_->SetGetBufferChangeCallback(
       base::Bind(&gpu::GpuScheduler::SetGetBuffer,
                  base::Unretained(scheduler_.get())));
@@ -591,6 +606,10 @@ void GpuCommandBufferStub::OnSetSurfaceVisible(bool visible) {
   DCHECK(surface_state_.get());
   surface_state_->visible = visible;
   surface_state_->last_used_time = base::TimeTicks::Now();
+  if (scheduler_.get()) {
+    channel_->multi_context_scheduler()->SetPriority(scheduler_.get(),
+                                                     GetSchedulingPriority());
+  }
   channel_->gpu_channel_manager()->gpu_memory_manager()->ScheduleManage();
 }
 
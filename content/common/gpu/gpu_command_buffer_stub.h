@@ -22,6 +22,7 @@
 #include "gpu/command_buffer/service/command_buffer_service.h"
 #include "gpu/command_buffer/service/context_group.h"
 #include "gpu/command_buffer/service/gpu_scheduler.h"
+#include "gpu/command_buffer/service/multi_context_scheduler.h"
 #include "ipc/ipc_channel.h"
 #include "ipc/ipc_message.h"
 #include "ui/gfx/native_widget_types.h"
@@ -170,6 +171,16 @@ class GpuCommandBufferStub
  private:
   void Destroy();
 
+  // Makes the context current, and loses it if that fails. Returns whether
+  // the context is current.
+  bool MakeCurrent();
+
+  gpu::MultiContextScheduler::Priority GetSchedulingPriority() const;
+
+  // Processes the flushed commands for at most a slice of the channel's
+  // MultiContextScheduler.
+  void OnPutOffsetChanged();
+
   // Cleans up and sends reply if OnInitialize failed.
   void OnInitializeFailed(IPC::Message* reply_message);
 
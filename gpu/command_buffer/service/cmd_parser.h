@@ -53,6 +53,9 @@ class GPU_EXPORT CommandParser {
   // Checks whether there are commands to process.
   bool IsEmpty() const { return put_ == get_; }
 
+  // Gets the size of the buffer in CommandBufferEntry units.
+  int32 entry_count() const { return entry_count_; }
+
   // Processes one command, updating the get pointer. This will return an error
   // if there are no commands in the buffer.
   error::Error ProcessCommand();
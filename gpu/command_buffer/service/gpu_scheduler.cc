@@ -32,7 +32,8 @@ GpuScheduler::GpuScheduler(
       parser_(NULL),
       unscheduled_count_(0),
       rescheduled_count_(0),
-      reschedule_task_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)) {
+      reschedule_task_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)),
+      was_preempted_(false) {
 }
 
 GpuScheduler::~GpuScheduler() {
@@ -41,6 +42,8 @@ GpuScheduler::~GpuScheduler() {
 void GpuScheduler::PutChanged() {
   TRACE_EVENT1("gpu", "GpuScheduler:PutChanged", "this", this);
 
+  was_preempted_ = false;
+
   CommandBuffer::State state = command_buffer_->GetState();
 
   // If there is no parser, exit.
@@ -86,6 +89,13 @@ void GpuScheduler::PutChanged() {
 
     if (unscheduled_count_ > 0)
       return;
+
+    if (!preemption_callback_.is_null() && preemption_callback_.Run() &&
+        !parser_->IsEmpty()) {
+      TRACE_EVENT_INSTANT1("gpu", "GpuScheduler:Preempted", "this", this);
+      was_preempted_ = true;
+      return;
+    }
   }
 }
 
@@ -194,6 +204,22 @@ void GpuScheduler::SetCommandProcessedCallback(
   command_processed_callback_ = callback;
 }
 
+void GpuScheduler::SetPreemptionCallback(
+    const base::Callback<bool(void)>& callback) {
+  preemption_callback_ = callback;
+}
+
+int32 GpuScheduler::GetPendingEntryCount() {
+  if (!parser_.get())
+    return 0;
+
+  CommandBuffer::State state = command_buffer_->GetState();
+  int32 pending = state.put_offset - parser_->get();
+  if (pending < 0)
+    pending += parser_->entry_count();
+  return pending;
+}
+
 void GpuScheduler::DeferToFence(base::Closure task) {
   unschedule_fences_.push(make_linked_ptr(
        new UnscheduleFence(gfx::GLFence::Create(), task)));
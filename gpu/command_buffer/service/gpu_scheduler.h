@@ -65,6 +65,19 @@ class GPU_EXPORT GpuScheduler
 
   void SetCommandProcessedCallback(const base::Closure& callback);
 
+  // Sets a callback that is polled after each processed command. If it
+  // returns true while commands remain, PutChanged returns at that command
+  // boundary and leaves the rest of the buffer for a later call.
+  void SetPreemptionCallback(const base::Callback<bool(void)>& callback);
+
+  // Returns whether the last call to PutChanged yielded because of the
+  // preemption callback rather than running out of commands.
+  bool was_preempted() const { return was_preempted_; }
+
+  // Returns the number of command buffer entries that have been flushed but
+  // not yet processed.
+  int32 GetPendingEntryCount();
+
   void DeferToFence(base::Closure task);
 
   // Polls the fences, invoking callbacks that were waiting to be triggered
@@ -122,6 +135,11 @@ class GPU_EXPORT GpuScheduler
 
   base::Closure scheduled_callback_;
   base::Closure command_processed_callback_;
+  base::Callback<bool(void)> preemption_callback_;
+
+  // Whether the last call to PutChanged was cut short by
+  // |preemption_callback_|.
+  bool was_preempted_;
 
   DISALLOW_COPY_AND_ASSIGN(GpuScheduler);
 };
@@ -0,0 +1,284 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gpu/command_buffer/service/multi_context_scheduler.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/debug/trace_event.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "gpu/command_buffer/service/gpu_scheduler.h"
+
+namespace gpu {
+
+MultiContextScheduler::ContextStats::ContextStats()
+    : queue_depth(0),
+      commands_processed(0),
+      slices(0),
+      preemptions(0) {
+}
+
+MultiContextScheduler::ContextState::ContextState()
+    : priority(PRIORITY_NORMAL),
+      runnable(false),
+      virtual_time(0) {
+}
+
+MultiContextScheduler::MultiContextScheduler(base::TimeDelta slice)
+    : slice_(slice),
+      now_callback_(base::Bind(&base::TimeTicks::Now)),
+      current_(NULL),
+      current_state_(NULL),
+      run_task_pending_(false),
+      preemption_requested_(0) {
+}
+
+MultiContextScheduler::~MultiContextScheduler() {
+  DCHECK(contexts_.empty());
+}
+
+void MultiContextScheduler::SetNowCallbackForTesting(
+    const NowCallback& now_callback) {
+  now_callback_ = now_callback;
+}
+
+void MultiContextScheduler::AddContext(GpuScheduler* scheduler,
+                                       Priority priority) {
+  DCHECK(contexts_.find(scheduler) == contexts_.end());
+  ContextState& state = contexts_[scheduler];
+  state.priority = priority;
+  scheduler->SetPreemptionCallback(
+      base::Bind(&MultiContextScheduler::ShouldPreempt,
+                 base::Unretained(this),
+                 scheduler));
+}
+
+void MultiContextScheduler::RemoveContext(GpuScheduler* scheduler) {
+  ContextMap::iterator it = contexts_.find(scheduler);
+  DCHECK(it != contexts_.end());
+  if (it == contexts_.end())
+    return;
+
+  scheduler->SetPreemptionCallback(base::Callback<bool(void)>());
+  if (current_ == scheduler) {
+    current_ = NULL;
+    current_state_ = NULL;
+  }
+  contexts_.erase(it);
+}
+
+void MultiContextScheduler::SetPriority(GpuScheduler* scheduler,
+                                        Priority priority) {
+  ContextMap::iterator it = contexts_.find(scheduler);
+  DCHECK(it != contexts_.end());
+  if (it != contexts_.end())
+    it->second.priority = priority;
+}
+
+void MultiContextScheduler::ContextFlushed(GpuScheduler* scheduler) {
+  ContextMap::iterator it = contexts_.find(scheduler);
+  DCHECK(it != contexts_.end());
+  if (it == contexts_.end())
+    return;
+
+  ContextState& state = it->second;
+  if (!state.runnable) {
+    // A context must not bank run time while it is idle, otherwise it could
+    // monopolize the thread when it wakes up. Start it no earlier than the
+    // context that is furthest behind.
+    bool found_runnable = false;
+    int64 min_virtual_time = 0;
+    for (ContextMap::const_iterator other = contexts_.begin();
+         other != contexts_.end(); ++other) {
+      if (!other->second.runnable)
+        continue;
+      if (!found_runnable || other->second.virtual_time < min_virtual_time)
+        min_virtual_time = other->second.virtual_time;
+      found_runnable = true;
+    }
+    if (found_runnable)
+      state.virtual_time = std::max(state.virtual_time, min_virtual_time);
+
+    state.runnable = true;
+    state.runnable_since = now_callback_.Run();
+  }
+
+  state.stats.queue_depth = scheduler->GetPendingEntryCount();
+  TRACE_COUNTER_ID1("gpu", "MultiContextScheduler::QueueDepth", scheduler,
+                    state.stats.queue_depth);
+
+  PostRunTask();
+}
+
+bool MultiContextScheduler::RunNextSlice() {
+  ContextMap::iterator next = contexts_.end();
+  for (ContextMap::iterator it = contexts_.begin();
+       it != contexts_.end(); ++it) {
+    ContextState& state = it->second;
+    if (!state.runnable)
+      continue;
+
+    // Descheduled contexts are flushed again when they are rescheduled.
+    if (!it->first->IsScheduled()) {
+      state.runnable = false;
+      continue;
+    }
+
+    if (next == contexts_.end() ||
+        state.virtual_time < next->second.virtual_time ||
+        (state.virtual_time == next->second.virtual_time &&
+         state.priority > next->second.priority)) {
+      next = it;
+    }
+  }
+
+  if (next == contexts_.end())
+    return false;
+
+  RunSliceOf(next);
+  return HasRunnableContexts();
+}
+
+void MultiContextScheduler::RunSlice(GpuScheduler* scheduler) {
+  ContextMap::iterator it = contexts_.find(scheduler);
+  DCHECK(it != contexts_.end());
+  if (it == contexts_.end()) {
+    scheduler->PutChanged();
+    return;
+  }
+
+  ContextState& state = it->second;
+  if (!state.runnable) {
+    state.runnable = true;
+    state.runnable_since = now_callback_.Run();
+  }
+  if (RunSliceOf(it)) {
+    // The caller resumes a preempted context, not the posted slices.
+    state.runnable = false;
+  }
+}
+
+bool MultiContextScheduler::RunSliceOf(ContextMap::iterator it) {
+  GpuScheduler* scheduler = it->first;
+  ContextState& state = it->second;
+  int weight = PriorityWeight(state.priority);
+
+  base::TimeTicks start = now_callback_.Run();
+  base::TimeDelta latency = start - state.runnable_since;
+  state.stats.last_latency = latency;
+  state.stats.max_latency = std::max(state.stats.max_latency, latency);
+  state.stats.total_latency += latency;
+  ++state.stats.slices;
+
+  TRACE_EVENT2("gpu", "MultiContextScheduler::RunNextSlice",
+               "scheduler", scheduler,
+               "latency_us", static_cast<int>(latency.InMicroseconds()));
+
+  base::subtle::NoBarrier_Store(&preemption_requested_, 0);
+  current_ = scheduler;
+  current_state_ = &state;
+  slice_deadline_ = start + slice_ * weight / PriorityWeight(PRIORITY_NORMAL);
+
+  scheduler->PutChanged();
+
+  // The context may have been removed while it was running.
+  bool removed = current_ == NULL;
+  current_ = NULL;
+  current_state_ = NULL;
+  if (removed)
+    return false;
+
+  base::TimeTicks end = now_callback_.Run();
+
+  // Charge at least a microsecond so that contexts whose commands are cheaper
+  // than the clock resolution still take turns.
+  int64 run_time = std::max<int64>((end - start).InMicroseconds(), 1);
+  state.virtual_time += run_time * PriorityWeight(PRIORITY_NORMAL) / weight;
+
+  if (scheduler->was_preempted()) {
+    ++state.stats.preemptions;
+    state.runnable_since = end;
+  } else {
+    state.runnable = false;
+  }
+
+  state.stats.queue_depth = scheduler->GetPendingEntryCount();
+  TRACE_COUNTER_ID1("gpu", "MultiContextScheduler::QueueDepth", scheduler,
+                    state.stats.queue_depth);
+  return true;
+}
+
+void MultiContextScheduler::RequestPreemption() {
+  base::subtle::NoBarrier_Store(&preemption_requested_, 1);
+}
+
+bool MultiContextScheduler::GetContextStats(GpuScheduler* scheduler,
+                                            ContextStats* stats) const {
+  ContextMap::const_iterator it = contexts_.find(scheduler);
+  if (it == contexts_.end())
+    return false;
+
+  *stats = it->second.stats;
+  return true;
+}
+
+bool MultiContextScheduler::HasRunnableContexts() const {
+  for (ContextMap::const_iterator it = contexts_.begin();
+       it != contexts_.end(); ++it) {
+    if (it->second.runnable)
+      return true;
+  }
+  return false;
+}
+
+// static
+int MultiContextScheduler::PriorityWeight(Priority priority) {
+  switch (priority) {
+    case PRIORITY_LOW:
+      return 1;
+    case PRIORITY_NORMAL:
+      return 2;
+    case PRIORITY_HIGH:
+      return 4;
+  }
+  NOTREACHED();
+  return 1;
+}
+
+bool MultiContextScheduler::ShouldPreempt(GpuScheduler* scheduler) {
+  // PutChanged may still be called directly, outside of a slice. Never
+  // preempt in that case since nothing would resume the context.
+  if (scheduler != current_)
+    return false;
+
+  ++current_state_->stats.commands_processed;
+
+  if (base::subtle::NoBarrier_Load(&preemption_requested_))
+    return true;
+
+  return now_callback_.Run() >= slice_deadline_;
+}
+
+void MultiContextScheduler::RunPendingSlices() {
+  run_task_pending_ = false;
+
+  // Run one slice per task so that IPC messages, including flushes of other
+  // contexts, are handled between slices.
+  if (RunNextSlice())
+    PostRunTask();
+}
+
+void MultiContextScheduler::PostRunTask() {
+  if (run_task_pending_)
+    return;
+
+  run_task_pending_ = true;
+  MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&MultiContextScheduler::RunPendingSlices, AsWeakPtr()));
+}
+
+}  // namespace gpu
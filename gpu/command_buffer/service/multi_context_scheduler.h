@@ -0,0 +1,140 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_COMMAND_BUFFER_SERVICE_MULTI_CONTEXT_SCHEDULER_H_
+#define GPU_COMMAND_BUFFER_SERVICE_MULTI_CONTEXT_SCHEDULER_H_
+
+#include <map>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time.h"
+#include "gpu/gpu_export.h"
+
+namespace gpu {
+
+class GpuScheduler;
+
+// Shares command processing time between the GpuSchedulers of several
+// contexts that live on the same thread. Instead of calling
+// GpuScheduler::PutChanged directly when a context is flushed, the owner calls
+// ContextFlushed and the MultiContextScheduler runs the context for a time
+// slice whose length depends on its priority. A context that is still busy
+// when its slice expires is preempted at the next command boundary and queued
+// again behind the other runnable contexts.
+//
+// Contexts are picked in order of least weighted run time, so a heavy low
+// priority context cannot starve a latency sensitive one, and a lone context
+// still gets the whole thread.
+class GPU_EXPORT MultiContextScheduler
+    : public base::SupportsWeakPtr<MultiContextScheduler> {
+ public:
+  enum Priority {
+    PRIORITY_LOW,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH,
+  };
+
+  // Per-context counters. Latencies are measured from the time a context
+  // became runnable until it started a slice.
+  struct GPU_EXPORT ContextStats {
+    ContextStats();
+
+    // Entries flushed but not yet processed.
+    int32 queue_depth;
+    int64 commands_processed;
+    int64 slices;
+    int64 preemptions;
+    base::TimeDelta last_latency;
+    base::TimeDelta max_latency;
+    base::TimeDelta total_latency;
+  };
+
+  typedef base::Callback<base::TimeTicks(void)> NowCallback;
+
+  // |slice| is the time slice granted to a PRIORITY_NORMAL context. Low and
+  // high priority contexts get half and twice as much respectively.
+  explicit MultiContextScheduler(base::TimeDelta slice);
+  ~MultiContextScheduler();
+
+  // Overrides the clock used to measure slices and latencies. For testing.
+  void SetNowCallbackForTesting(const NowCallback& now_callback);
+
+  // Registers a context. The MultiContextScheduler installs a preemption
+  // callback on |scheduler|, which must be removed with RemoveContext before
+  // it is destroyed.
+  void AddContext(GpuScheduler* scheduler, Priority priority);
+  void RemoveContext(GpuScheduler* scheduler);
+  void SetPriority(GpuScheduler* scheduler, Priority priority);
+
+  // Marks |scheduler| as having commands to process and posts a task to run
+  // the next slice if one is not already pending. Call this whenever the put
+  // offset changes or the context is rescheduled.
+  void ContextFlushed(GpuScheduler* scheduler);
+
+  // Runs a single slice of the runnable context with the least weighted run
+  // time. Returns whether any context is still runnable afterwards.
+  bool RunNextSlice();
+
+  // Processes the commands of |scheduler| right away, for at most a slice,
+  // rather than in a posted task, so that they run in order with the other
+  // messages of the context. If the slice runs out, |scheduler| is left
+  // preempted and it is up to the caller to run it again.
+  void RunSlice(GpuScheduler* scheduler);
+
+  // Makes the running context yield at its next command boundary. Safe to call
+  // from any thread, e.g. from the IO thread when a high priority message
+  // arrives.
+  void RequestPreemption();
+
+  // Returns false if |scheduler| is not registered.
+  bool GetContextStats(GpuScheduler* scheduler, ContextStats* stats) const;
+
+  bool HasRunnableContexts() const;
+
+ private:
+  struct ContextState {
+    ContextState();
+
+    Priority priority;
+    bool runnable;
+    base::TimeTicks runnable_since;
+    // Run time scaled by the inverse of the priority weight, in microseconds.
+    int64 virtual_time;
+    ContextStats stats;
+  };
+  typedef std::map<GpuScheduler*, ContextState> ContextMap;
+
+  static int PriorityWeight(Priority priority);
+
+  // Runs a slice of the context at |it|, which must be runnable. Returns
+  // false if the context was removed while it ran.
+  bool RunSliceOf(ContextMap::iterator it);
+
+  // Preemption callback installed on every registered GpuScheduler.
+  bool ShouldPreempt(GpuScheduler* scheduler);
+
+  void RunPendingSlices();
+  void PostRunTask();
+
+  base::TimeDelta slice_;
+  NowCallback now_callback_;
+  ContextMap contexts_;
+
+  // The context currently being run, and when its slice ends.
+  GpuScheduler* current_;
+  ContextState* current_state_;
+  base::TimeTicks slice_deadline_;
+
+  bool run_task_pending_;
+  base::subtle::Atomic32 preemption_requested_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiContextScheduler);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_COMMAND_BUFFER_SERVICE_MULTI_CONTEXT_SCHEDULER_H_
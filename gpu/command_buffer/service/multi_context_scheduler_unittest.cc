@@ -0,0 +1,304 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/bind.h"
+#include "base/memory/linked_ptr.h"
+#include "base/message_loop.h"
+#include "gpu/command_buffer/common/command_buffer_mock.h"
+#include "gpu/command_buffer/service/gles2_cmd_decoder_mock.h"
+#include "gpu/command_buffer/service/gpu_scheduler.h"
+#include "gpu/command_buffer/service/multi_context_scheduler.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/gmock/include/gmock/gmock.h"
+
+#if defined(OS_MACOSX)
+#include "base/mac/scoped_nsautorelease_pool.h"
+#endif
+
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+
+namespace gpu {
+
+namespace {
+
+const size_t kRingBufferSize = 1024;
+const size_t kRingBufferEntries = kRingBufferSize / sizeof(CommandBufferEntry);
+const int32 kTransferBufferId = 123;
+const unsigned int kCommand = 7;
+
+}  // namespace
+
+class MultiContextSchedulerTest : public testing::Test {
+ protected:
+  // A GpuScheduler with its own ring buffer and mock decoder.
+  struct Context {
+    scoped_ptr<base::SharedMemory> shared_memory;
+    Buffer buffer;
+    scoped_ptr<NiceMock<MockCommandBuffer> > command_buffer;
+    scoped_ptr<NiceMock<gles2::MockGLES2Decoder> > decoder;
+    scoped_ptr<GpuScheduler> scheduler;
+  };
+
+  MultiContextSchedulerTest()
+      : multi_scheduler_(base::TimeDelta::FromMilliseconds(3)),
+        preempt_after_command_(false) {
+  }
+
+  virtual void SetUp() {
+    multi_scheduler_.SetNowCallbackForTesting(
+        base::Bind(&MultiContextSchedulerTest::Now, base::Unretained(this)));
+  }
+
+  virtual void TearDown() {
+    for (size_t i = 0; i < contexts_.size(); ++i)
+      multi_scheduler_.RemoveContext(contexts_[i]->scheduler.get());
+    MessageLoop::current()->RunAllPending();
+  }
+
+  GpuScheduler* CreateContext(MultiContextScheduler::Priority priority) {
+    linked_ptr<Context> context(new Context);
+    context->shared_memory.reset(new base::SharedMemory);
+    context->shared_memory->CreateAndMapAnonymous(kRingBufferSize);
+    context->buffer.ptr = context->shared_memory->memory();
+    context->buffer.size = kRingBufferSize;
+    memset(context->buffer.ptr, 0, kRingBufferSize);
+
+    context->command_buffer.reset(new NiceMock<MockCommandBuffer>);
+    CommandBuffer::State state;
+    state.num_entries = kRingBufferEntries;
+    ON_CALL(*context->command_buffer, GetState())
+        .WillByDefault(Return(state));
+    ON_CALL(*context->command_buffer, GetTransferBuffer(kTransferBufferId))
+        .WillByDefault(Return(context->buffer));
+
+    context->decoder.reset(new NiceMock<gles2::MockGLES2Decoder>);
+    ON_CALL(*context->decoder, DoCommand(kCommand, _, _))
+        .WillByDefault(Invoke(this, &MultiContextSchedulerTest::DoCommand));
+
+    context->scheduler.reset(new GpuScheduler(context->command_buffer.get(),
+                                              context->decoder.get(),
+                                              context->decoder.get()));
+    EXPECT_TRUE(context->scheduler->SetGetBuffer(kTransferBufferId));
+
+    multi_scheduler_.AddContext(context->scheduler.get(), priority);
+    contexts_.push_back(context);
+    return context->scheduler.get();
+  }
+
+  // Writes |count| single entry commands to the ring buffer of |scheduler|.
+  void WriteCommands(GpuScheduler* scheduler, int32 count) {
+    Context* context = FindContext(scheduler);
+    CommandHeader* header =
+        reinterpret_cast<CommandHeader*>(context->buffer.ptr);
+    for (int32 i = 0; i < count; ++i) {
+      header[i].command = kCommand;
+      header[i].size = 1;
+    }
+
+    CommandBuffer::State state;
+    state.num_entries = kRingBufferEntries;
+    state.put_offset = count;
+    ON_CALL(*context->command_buffer, GetState())
+        .WillByDefault(Return(state));
+  }
+
+  // Writes |count| commands to the ring buffer of |scheduler| and flushes
+  // them.
+  void Flush(GpuScheduler* scheduler, int32 count) {
+    WriteCommands(scheduler, count);
+    multi_scheduler_.ContextFlushed(scheduler);
+  }
+
+  MultiContextScheduler::ContextStats GetStats(GpuScheduler* scheduler) {
+    MultiContextScheduler::ContextStats stats;
+    EXPECT_TRUE(multi_scheduler_.GetContextStats(scheduler, &stats));
+    return stats;
+  }
+
+  Context* FindContext(GpuScheduler* scheduler) {
+    for (size_t i = 0; i < contexts_.size(); ++i) {
+      if (contexts_[i]->scheduler.get() == scheduler)
+        return contexts_[i].get();
+    }
+    return NULL;
+  }
+
+  base::TimeTicks Now() {
+    return now_;
+  }
+
+  // Every command takes a millisecond.
+  error::Error DoCommand(unsigned int command,
+                         unsigned int arg_count,
+                         const void* cmd_data) {
+    now_ += base::TimeDelta::FromMilliseconds(1);
+    if (preempt_after_command_)
+      multi_scheduler_.RequestPreemption();
+    return error::kNoError;
+  }
+
+#if defined(OS_MACOSX)
+  base::mac::ScopedNSAutoreleasePool autorelease_pool_;
+#endif
+  MessageLoop message_loop_;
+  MultiContextScheduler multi_scheduler_;
+  std::vector<linked_ptr<Context> > contexts_;
+  base::TimeTicks now_;
+  bool preempt_after_command_;
+};
+
+TEST_F(MultiContextSchedulerTest, PreemptsAtEndOfSlice) {
+  GpuScheduler* scheduler = CreateContext(
+      MultiContextScheduler::PRIORITY_NORMAL);
+  Flush(scheduler, 10);
+  EXPECT_EQ(10, GetStats(scheduler).queue_depth);
+
+  EXPECT_TRUE(multi_scheduler_.RunNextSlice());
+  EXPECT_TRUE(scheduler->was_preempted());
+
+  MultiContextScheduler::ContextStats stats = GetStats(scheduler);
+  EXPECT_EQ(3, stats.commands_processed);
+  EXPECT_EQ(7, stats.queue_depth);
+  EXPECT_EQ(1, stats.slices);
+  EXPECT_EQ(1, stats.preemptions);
+
+  while (multi_scheduler_.RunNextSlice()) {}
+
+  stats = GetStats(scheduler);
+  EXPECT_EQ(10, stats.commands_processed);
+  EXPECT_EQ(0, stats.queue_depth);
+  EXPECT_EQ(4, stats.slices);
+  EXPECT_EQ(3, stats.preemptions);
+  EXPECT_FALSE(multi_scheduler_.HasRunnableContexts());
+}
+
+TEST_F(MultiContextSchedulerTest, RunsWholeBufferWithinSlice) {
+  GpuScheduler* scheduler = CreateContext(
+      MultiContextScheduler::PRIORITY_NORMAL);
+  Flush(scheduler, 2);
+
+  EXPECT_FALSE(multi_scheduler_.RunNextSlice());
+  EXPECT_FALSE(scheduler->was_preempted());
+
+  MultiContextScheduler::ContextStats stats = GetStats(scheduler);
+  EXPECT_EQ(2, stats.commands_processed);
+  EXPECT_EQ(0, stats.queue_depth);
+  EXPECT_EQ(0, stats.preemptions);
+}
+
+TEST_F(MultiContextSchedulerTest, HeavyContextDoesNotStarveOthers) {
+  GpuScheduler* heavy = CreateContext(MultiContextScheduler::PRIORITY_LOW);
+  GpuScheduler* light = CreateContext(MultiContextScheduler::PRIORITY_HIGH);
+
+  Flush(heavy, 20);
+  EXPECT_TRUE(multi_scheduler_.RunNextSlice());
+  EXPECT_EQ(2, GetStats(heavy).commands_processed);
+
+  // The light context is flushed while the heavy one still has work queued. It
+  // must run next rather than waiting for the heavy buffer to drain.
+  Flush(light, 2);
+  EXPECT_TRUE(multi_scheduler_.RunNextSlice());
+  EXPECT_EQ(2, GetStats(light).commands_processed);
+  EXPECT_EQ(0, GetStats(light).queue_depth);
+  EXPECT_EQ(2, GetStats(heavy).commands_processed);
+}
+
+TEST_F(MultiContextSchedulerTest, SharesTimeByPriority) {
+  GpuScheduler* normal = CreateContext(MultiContextScheduler::PRIORITY_NORMAL);
+  GpuScheduler* high = CreateContext(MultiContextScheduler::PRIORITY_HIGH);
+
+  Flush(normal, 100);
+  Flush(high, 100);
+
+  for (int i = 0; i < 4; ++i)
+    EXPECT_TRUE(multi_scheduler_.RunNextSlice());
+
+  EXPECT_EQ(2, GetStats(normal).slices);
+  EXPECT_EQ(2, GetStats(high).slices);
+  EXPECT_EQ(6, GetStats(normal).commands_processed);
+  EXPECT_EQ(12, GetStats(high).commands_processed);
+}
+
+TEST_F(MultiContextSchedulerTest, RecordsLatency) {
+  GpuScheduler* scheduler = CreateContext(
+      MultiContextScheduler::PRIORITY_NORMAL);
+  Flush(scheduler, 1);
+
+  now_ += base::TimeDelta::FromMilliseconds(5);
+  multi_scheduler_.RunNextSlice();
+
+  MultiContextScheduler::ContextStats stats = GetStats(scheduler);
+  EXPECT_EQ(5, stats.last_latency.InMilliseconds());
+  EXPECT_EQ(5, stats.max_latency.InMilliseconds());
+
+  Flush(scheduler, 2);
+  now_ += base::TimeDelta::FromMilliseconds(2);
+  multi_scheduler_.RunNextSlice();
+
+  stats = GetStats(scheduler);
+  EXPECT_EQ(2, stats.last_latency.InMilliseconds());
+  EXPECT_EQ(5, stats.max_latency.InMilliseconds());
+  EXPECT_EQ(7, stats.total_latency.InMilliseconds());
+}
+
+TEST_F(MultiContextSchedulerTest, YieldsOnPreemptionRequest) {
+  GpuScheduler* scheduler = CreateContext(
+      MultiContextScheduler::PRIORITY_HIGH);
+  Flush(scheduler, 10);
+
+  preempt_after_command_ = true;
+  EXPECT_TRUE(multi_scheduler_.RunNextSlice());
+  EXPECT_EQ(1, GetStats(scheduler).commands_processed);
+  EXPECT_EQ(1, GetStats(scheduler).preemptions);
+}
+
+TEST_F(MultiContextSchedulerTest, DrivesContextsFromMessageLoop) {
+  GpuScheduler* first = CreateContext(MultiContextScheduler::PRIORITY_NORMAL);
+  GpuScheduler* second = CreateContext(MultiContextScheduler::PRIORITY_LOW);
+
+  Flush(first, 10);
+  Flush(second, 10);
+  MessageLoop::current()->RunAllPending();
+
+  EXPECT_EQ(10, GetStats(first).commands_processed);
+  EXPECT_EQ(10, GetStats(second).commands_processed);
+  EXPECT_FALSE(multi_scheduler_.HasRunnableContexts());
+}
+
+TEST_F(MultiContextSchedulerTest, RunSliceProcessesCommandsRightAway) {
+  GpuScheduler* scheduler = CreateContext(
+      MultiContextScheduler::PRIORITY_NORMAL);
+  WriteCommands(scheduler, 2);
+
+  multi_scheduler_.RunSlice(scheduler);
+  EXPECT_FALSE(scheduler->was_preempted());
+  EXPECT_EQ(2, GetStats(scheduler).commands_processed);
+  EXPECT_FALSE(multi_scheduler_.HasRunnableContexts());
+}
+
+TEST_F(MultiContextSchedulerTest, RunSliceLeavesResumingToCaller) {
+  GpuScheduler* scheduler = CreateContext(
+      MultiContextScheduler::PRIORITY_NORMAL);
+  WriteCommands(scheduler, 5);
+
+  multi_scheduler_.RunSlice(scheduler);
+  EXPECT_TRUE(scheduler->was_preempted());
+  MultiContextScheduler::ContextStats stats = GetStats(scheduler);
+  EXPECT_EQ(3, stats.commands_processed);
+  EXPECT_EQ(1, stats.preemptions);
+
+  // No slice is posted for the rest of the commands.
+  EXPECT_FALSE(multi_scheduler_.HasRunnableContexts());
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(3, GetStats(scheduler).commands_processed);
+
+  multi_scheduler_.RunSlice(scheduler);
+  EXPECT_FALSE(scheduler->was_preempted());
+  EXPECT_EQ(5, GetStats(scheduler).commands_processed);
+}
+
+}  // namespace gpu
@@ -0,0 +1,52 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/base/byte_queue.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const uint8 kData[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+static const int kDataSize = arraysize(kData);
+
+TEST(ByteQueueTest, PushPeekPop) {
+  ByteQueue queue;
+  const uint8* data = NULL;
+  int size = -1;
+
+  queue.Peek(&data, &size);
+  EXPECT_EQ(0, size);
+
+  queue.Push(kData, kDataSize);
+  queue.Push(kData, kDataSize);
+  queue.Peek(&data, &size);
+  ASSERT_EQ(2 * kDataSize, size);
+  EXPECT_EQ(0, memcmp(kData, data, kDataSize));
+  EXPECT_EQ(0, memcmp(kData, data + kDataSize, kDataSize));
+
+  queue.Pop(kDataSize + 3);
+  queue.Peek(&data, &size);
+  ASSERT_EQ(kDataSize - 3, size);
+  EXPECT_EQ(0, memcmp(kData + 3, data, size));
+
+  queue.Reset();
+  queue.Peek(&data, &size);
+  EXPECT_EQ(0, size);
+}
+
+TEST(ByteQueueTest, Grow) {
+  ByteQueue queue;
+  const int kPushes = 1000;
+  for (int i = 0; i < kPushes; ++i)
+    queue.Push(kData, kDataSize);
+
+  const uint8* data = NULL;
+  int size = 0;
+  queue.Peek(&data, &size);
+  ASSERT_EQ(kPushes * kDataSize, size);
+  for (int i = 0; i < kPushes; ++i)
+    ASSERT_EQ(0, memcmp(kData, data + i * kDataSize, kDataSize));
+}
+
+}  // namespace media
@@ -89,6 +89,12 @@ void ConvertYUVToRGB32Row_SSE(const uint8* yplane,
                               uint8* rgbframe,
                               int width);
 
+void ConvertYUVToRGB32Row_SSE2(const uint8* yplane,
+                               const uint8* uplane,
+                               const uint8* vplane,
+                               uint8* rgbframe,
+                               int width);
+
 void ScaleYUVToRGB32Row_C(const uint8* y_buf,
                           const uint8* u_buf,
                           const uint8* v_buf,
@@ -146,6 +152,13 @@ void LinearScaleYUVToRGB32Row_SSE(const uint8* y_buf,
                                   int width,
                                   int source_dx);
 
+void LinearScaleYUVToRGB32Row_SSE2(const uint8* y_buf,
+                                   const uint8* u_buf,
+                                   const uint8* v_buf,
+                                   uint8* rgb_buf,
+                                   int width,
+                                   int source_dx);
+
 void LinearScaleYUVToRGB32Row_MMX_X64(const uint8* y_buf,
                                       const uint8* u_buf,
                                       const uint8* v_buf,
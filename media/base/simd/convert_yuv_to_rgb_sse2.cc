@@ -0,0 +1,145 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// SSE2 versions of the YUV to RGB row converters. These use the same lookup
+// table as the C versions, but combine the table entries of four pixels at a
+// time in XMM registers and write the result with a single 16 byte store. They
+// do not touch the MMX registers, so EmptyRegisterState() is not needed
+// afterwards.
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+#include "media/base/simd/convert_yuv_to_rgb.h"
+#include "media/base/simd/yuv_to_rgb_table.h"
+
+// Returns the four 16-bit coefficients of table entry |index| in the low half
+// of an XMM register.
+static inline __m128i LoadCoefficients(int index) {
+  return _mm_loadl_epi64(
+      reinterpret_cast<const __m128i*>(kCoefficientsRgbY[index]));
+}
+
+// Converts two pixels that share chroma values and returns their B, G, R and
+// A components as eight signed 16-bit values, ready to be packed.
+static inline __m128i ConvertPair(int y0, int y1, int u, int v) {
+  __m128i uv = _mm_adds_epi16(LoadCoefficients(256 + u),
+                              LoadCoefficients(512 + v));
+  uv = _mm_unpacklo_epi64(uv, uv);
+  __m128i y = _mm_unpacklo_epi64(LoadCoefficients(y0), LoadCoefficients(y1));
+  return _mm_srai_epi16(_mm_adds_epi16(y, uv), 6);
+}
+
+// Stores the last |pixels| pixels of a row, where |pixels| is 1, 2 or 3.
+static inline void StoreTail(__m128i pixel01, __m128i pixel23, int pixels,
+                             uint8* rgb_buf) {
+  __m128i rgb = _mm_packus_epi16(pixel01, pixel23);
+  if (pixels >= 2) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb_buf), rgb);
+    rgb = _mm_srli_si128(rgb, 8);
+    rgb_buf += 8;
+    pixels -= 2;
+  }
+  if (pixels)
+    *reinterpret_cast<int*>(rgb_buf) = _mm_cvtsi128_si32(rgb);
+}
+
+// Interpolates the pixel at 16.16 position |x| the same way as
+// LinearScaleYUVToRGB32RowWithRange_C().
+static inline int Interpolate(const uint8* buf, int x) {
+  int frac = x & 65535;
+  return (frac * buf[(x >> 16) + 1] + (frac ^ 65535) * buf[x >> 16]) >> 16;
+}
+
+// Computes the next pair of linearly scaled pixels starting at |*x| and
+// advances |*x| past them. The second pixel is only computed when
+// |has_second| is true so that nothing past the end of the row is read.
+static inline __m128i LinearScalePair(const uint8* y_buf,
+                                      const uint8* u_buf,
+                                      const uint8* v_buf,
+                                      bool has_second,
+                                      int* x,
+                                      int source_dx) {
+  int y0 = Interpolate(y_buf, *x);
+  int u = Interpolate(u_buf, *x >> 1);
+  int v = Interpolate(v_buf, *x >> 1);
+  *x += source_dx;
+  int y1 = 0;
+  if (has_second) {
+    y1 = Interpolate(y_buf, *x);
+    *x += source_dx;
+  }
+  return ConvertPair(y0, y1, u, v);
+}
+
+extern "C" {
+
+void ConvertYUVToRGB32Row_SSE2(const uint8* y_buf,
+                               const uint8* u_buf,
+                               const uint8* v_buf,
+                               uint8* rgb_buf,
+                               int width) {
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    int uv = x >> 1;
+    __m128i pixel01 = ConvertPair(y_buf[x], y_buf[x + 1],
+                                  u_buf[uv], v_buf[uv]);
+    __m128i pixel23 = ConvertPair(y_buf[x + 2], y_buf[x + 3],
+                                  u_buf[uv + 1], v_buf[uv + 1]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb_buf),
+                     _mm_packus_epi16(pixel01, pixel23));
+    rgb_buf += 16;
+  }
+
+  int pixels = width - x;
+  if (pixels <= 0)
+    return;
+
+  int uv = x >> 1;
+  __m128i pixel01 = ConvertPair(y_buf[x], pixels > 1 ? y_buf[x + 1] : 0,
+                                u_buf[uv], v_buf[uv]);
+  __m128i pixel23 = _mm_setzero_si128();
+  if (pixels > 2)
+    pixel23 = ConvertPair(y_buf[x + 2], 0, u_buf[uv + 1], v_buf[uv + 1]);
+  StoreTail(pixel01, pixel23, pixels, rgb_buf);
+}
+
+void LinearScaleYUVToRGB32Row_SSE2(const uint8* y_buf,
+                                   const uint8* u_buf,
+                                   const uint8* v_buf,
+                                   uint8* rgb_buf,
+                                   int width,
+                                   int source_dx) {
+  // Avoid point-sampling for down-scaling by > 2:1.
+  int x = 0;
+  if (source_dx >= 0x20000)
+    x += 0x8000;
+
+  int i = 0;
+  for (; i + 4 <= width; i += 4) {
+    __m128i pixel01 =
+        LinearScalePair(y_buf, u_buf, v_buf, true, &x, source_dx);
+    __m128i pixel23 =
+        LinearScalePair(y_buf, u_buf, v_buf, true, &x, source_dx);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb_buf),
+                     _mm_packus_epi16(pixel01, pixel23));
+    rgb_buf += 16;
+  }
+
+  int pixels = width - i;
+  if (pixels <= 0)
+    return;
+
+  __m128i pixel01 =
+      LinearScalePair(y_buf, u_buf, v_buf, pixels > 1, &x, source_dx);
+  __m128i pixel23 = _mm_setzero_si128();
+  if (pixels > 2)
+    pixel23 = LinearScalePair(y_buf, u_buf, v_buf, false, &x, source_dx);
+  StoreTail(pixel01, pixel23, pixels, rgb_buf);
+}
+
+}  // extern "C"
@@ -0,0 +1,44 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Sample kernels used by AudioRendererAlgorithm to time-stretch interleaved
+// audio. All buffers are interleaved and |length| counts samples, not frames.
+
+#ifndef MEDIA_BASE_SIMD_TIME_STRETCH_H_
+#define MEDIA_BASE_SIMD_TIME_STRETCH_H_
+
+#include "base/basictypes.h"
+
+namespace media {
+
+// Returns the sum of |a[i] * b[i]|.
+typedef float (*DotProductProc)(const float* a, const float* b, int length);
+
+float DotProduct_C(const float* a, const float* b, int length);
+float DotProduct_SSE2(const float* a, const float* b, int length);
+
+// Converts |length| samples from |source| to floats in |dest|.
+typedef void (*ConvertInt16ToFloatProc)(const int16* source,
+                                        float* dest,
+                                        int length);
+
+void ConvertInt16ToFloat_C(const int16* source, float* dest, int length);
+void ConvertInt16ToFloat_SSE2(const int16* source, float* dest, int length);
+
+// Writes |outtro[i] + (intro[i] - outtro[i]) * ramp[i]| to |dest[i]|. |dest|
+// may alias either input.
+typedef void (*CrossfadeInt16Proc)(const int16* outtro,
+                                   const int16* intro,
+                                   const float* ramp,
+                                   int16* dest,
+                                   int length);
+
+void CrossfadeInt16_C(const int16* outtro, const int16* intro,
+                      const float* ramp, int16* dest, int length);
+void CrossfadeInt16_SSE2(const int16* outtro, const int16* intro,
+                         const float* ramp, int16* dest, int length);
+
+}  // namespace media
+
+#endif  // MEDIA_BASE_SIMD_TIME_STRETCH_H_
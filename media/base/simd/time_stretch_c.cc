@@ -0,0 +1,30 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "media/base/simd/time_stretch.h"
+
+namespace media {
+
+float DotProduct_C(const float* a, const float* b, int length) {
+  float sum = 0.0f;
+  for (int i = 0; i < length; ++i)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+void ConvertInt16ToFloat_C(const int16* source, float* dest, int length) {
+  for (int i = 0; i < length; ++i)
+    dest[i] = source[i];
+}
+
+void CrossfadeInt16_C(const int16* outtro, const int16* intro,
+                      const float* ramp, int16* dest, int length) {
+  for (int i = 0; i < length; ++i) {
+    float outtro_sample = outtro[i];
+    dest[i] = static_cast<int16>(
+        outtro_sample + (intro[i] - outtro_sample) * ramp[i]);
+  }
+}
+
+}  // namespace media
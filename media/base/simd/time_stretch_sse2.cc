@@ -0,0 +1,86 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+#include "media/base/simd/time_stretch.h"
+
+namespace media {
+
+float DotProduct_SSE2(const float* a, const float* b, int length) {
+  __m128 sum = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= length; i += 4)
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+  float partial_sums[4];
+  _mm_storeu_ps(partial_sums, sum);
+  float result = partial_sums[0] + partial_sums[1] +
+                 partial_sums[2] + partial_sums[3];
+
+  for (; i < length; ++i)
+    result += a[i] * b[i];
+  return result;
+}
+
+// Sign extends the low and high halves of |samples| to two vectors of floats.
+static inline void UnpackInt16(__m128i samples, __m128* low, __m128* high) {
+  *low = _mm_cvtepi32_ps(
+      _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16));
+  *high = _mm_cvtepi32_ps(
+      _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16));
+}
+
+void ConvertInt16ToFloat_SSE2(const int16* source, float* dest, int length) {
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    __m128 low;
+    __m128 high;
+    UnpackInt16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)),
+                &low, &high);
+    _mm_storeu_ps(dest + i, low);
+    _mm_storeu_ps(dest + i + 4, high);
+  }
+
+  for (; i < length; ++i)
+    dest[i] = source[i];
+}
+
+void CrossfadeInt16_SSE2(const int16* outtro, const int16* intro,
+                         const float* ramp, int16* dest, int length) {
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    __m128 outtro_low;
+    __m128 outtro_high;
+    UnpackInt16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(outtro + i)),
+                &outtro_low, &outtro_high);
+    __m128 intro_low;
+    __m128 intro_high;
+    UnpackInt16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(intro + i)),
+                &intro_low, &intro_high);
+
+    __m128 low = _mm_add_ps(outtro_low, _mm_mul_ps(
+        _mm_sub_ps(intro_low, outtro_low), _mm_loadu_ps(ramp + i)));
+    __m128 high = _mm_add_ps(outtro_high, _mm_mul_ps(
+        _mm_sub_ps(intro_high, outtro_high), _mm_loadu_ps(ramp + i + 4)));
+
+    // Truncate like the C version. The result lies between the two inputs, so
+    // the saturating pack never clips.
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_packs_epi32(_mm_cvttps_epi32(low),
+                                     _mm_cvttps_epi32(high)));
+  }
+
+  for (; i < length; ++i) {
+    float outtro_sample = outtro[i];
+    dest[i] = static_cast<int16>(
+        outtro_sample + (intro[i] - outtro_sample) * ramp[i]);
+  }
+}
+
+}  // namespace media
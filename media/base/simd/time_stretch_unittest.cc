@@ -0,0 +1,99 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cmath>
+
+#include "base/memory/scoped_ptr.h"
+#include "media/base/cpu_features.h"
+#include "media/base/simd/time_stretch.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+// Odd so that the scalar tails of the SSE2 kernels are exercised.
+static const int kSamples = 1027;
+
+static void FillSamples(int16* samples, int length, int seed) {
+  for (int i = 0; i < length; ++i)
+    samples[i] = static_cast<int16>(32767 * sin(0.01 * seed * (i + 1)));
+}
+
+TEST(TimeStretchTest, SideBySideDotProduct) {
+  if (!hasSSE2())
+    return;
+
+  scoped_array<float> a(new float[kSamples]);
+  scoped_array<float> b(new float[kSamples]);
+  for (int i = 0; i < kSamples; ++i) {
+    a[i] = sin(0.1 * i);
+    b[i] = cos(0.07 * i);
+  }
+
+  // Unaligned inputs as well as every tail length.
+  for (int offset = 0; offset < 4; ++offset) {
+    for (int length = kSamples - 8; length <= kSamples - offset; ++length) {
+      float expected = DotProduct_C(a.get() + offset, b.get(), length);
+      float actual = DotProduct_SSE2(a.get() + offset, b.get(), length);
+      EXPECT_NEAR(expected, actual, 1e-3);
+    }
+  }
+}
+
+TEST(TimeStretchTest, SideBySideConvertInt16ToFloat) {
+  if (!hasSSE2())
+    return;
+
+  scoped_array<int16> source(new int16[kSamples]);
+  FillSamples(source.get(), kSamples, 3);
+  scoped_array<float> expected(new float[kSamples]);
+  scoped_array<float> actual(new float[kSamples]);
+
+  ConvertInt16ToFloat_C(source.get() + 1, expected.get(), kSamples - 1);
+  ConvertInt16ToFloat_SSE2(source.get() + 1, actual.get(), kSamples - 1);
+  for (int i = 0; i < kSamples - 1; ++i)
+    EXPECT_EQ(expected[i], actual[i]);
+}
+
+TEST(TimeStretchTest, SideBySideCrossfadeInt16) {
+  if (!hasSSE2())
+    return;
+
+  scoped_array<int16> outtro(new int16[kSamples]);
+  scoped_array<int16> intro(new int16[kSamples]);
+  scoped_array<float> ramp(new float[kSamples]);
+  FillSamples(outtro.get(), kSamples, 5);
+  FillSamples(intro.get(), kSamples, 7);
+  for (int i = 0; i < kSamples; ++i)
+    ramp[i] = static_cast<float>(i) / kSamples;
+
+  scoped_array<int16> expected(new int16[kSamples]);
+  scoped_array<int16> actual(new int16[kSamples]);
+  CrossfadeInt16_C(outtro.get(), intro.get(), ramp.get(), expected.get(),
+                   kSamples);
+  CrossfadeInt16_SSE2(outtro.get(), intro.get(), ramp.get(), actual.get(),
+                      kSamples);
+  for (int i = 0; i < kSamples; ++i)
+    EXPECT_EQ(expected[i], actual[i]) << i;
+
+  // The output may alias the intro.
+  CrossfadeInt16_SSE2(outtro.get(), intro.get(), ramp.get(), intro.get(),
+                      kSamples);
+  for (int i = 0; i < kSamples; ++i)
+    EXPECT_EQ(expected[i], intro[i]) << i;
+}
+
+TEST(TimeStretchTest, CrossfadeEndpoints) {
+  int16 outtro[] = { 1000, -1000, 1000, -1000 };
+  int16 intro[] = { -2000, 2000, -2000, 2000 };
+  float ramp[] = { 0.0f, 0.0f, 0.5f, 0.5f };
+  int16 dest[4];
+
+  CrossfadeInt16_C(outtro, intro, ramp, dest, 4);
+  EXPECT_EQ(1000, dest[0]);
+  EXPECT_EQ(-1000, dest[1]);
+  EXPECT_EQ(-500, dest[2]);
+  EXPECT_EQ(500, dest[3]);
+}
+
+}  // namespace media
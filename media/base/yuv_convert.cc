@@ -17,8 +17,16 @@
 
 #include "media/base/yuv_convert.h"
 
+#include <algorithm>
+
+#include "base/atomic_ref_count.h"
+#include "base/bind.h"
+#include "base/location.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/worker_pool.h"
 #include "build/build_config.h"
 #include "media/base/cpu_features.h"
 #include "media/base/simd/convert_rgb_to_yuv.h"
@@ -47,6 +55,8 @@ static FilterYUVRowsProc ChooseFilterYUVRowsProc() {
 
 static ConvertYUVToRGB32RowProc ChooseConvertYUVToRGB32RowProc() {
 #if defined(ARCH_CPU_X86_FAMILY)
+  if (hasSSE2())
+    return &ConvertYUVToRGB32Row_SSE2;
   if (hasSSE())
     return &ConvertYUVToRGB32Row_SSE;
   if (hasMMX())
@@ -71,10 +81,12 @@ static ScaleYUVToRGB32RowProc ChooseScaleYUVToRGB32RowProc() {
 
 static ScaleYUVToRGB32RowProc ChooseLinearScaleYUVToRGB32RowProc() {
 #if defined(ARCH_CPU_X86_64)
-  // Use 64-bits version if possible.
-  return &LinearScaleYUVToRGB32Row_MMX_X64;
+  // SSE2 is always available on 64-bits systems.
+  return &LinearScaleYUVToRGB32Row_SSE2;
 #elif defined(ARCH_CPU_X86_FAMILY)
   // 32-bits system.
+  if (hasSSE2())
+    return &LinearScaleYUVToRGB32Row_SSE2;
   if (hasSSE())
     return &LinearScaleYUVToRGB32Row_SSE;
   if (hasMMX())
@@ -102,21 +114,53 @@ const int kFractionBits = 16;
 const int kFractionMax = 1 << kFractionBits;
 const int kFractionMask = ((1 << kFractionBits) - 1);
 
-// Scale a frame of YUV to 32 bit ARGB.
-void ScaleYUVToRGB32(const uint8* y_buf,
-                     const uint8* u_buf,
-                     const uint8* v_buf,
-                     uint8* rgb_buf,
-                     int source_width,
-                     int source_height,
-                     int width,
-                     int height,
-                     int y_pitch,
-                     int uv_pitch,
-                     int rgb_pitch,
-                     YUVType yuv_type,
-                     Rotate view_rotate,
-                     ScaleFilter filter) {
+// ScaleYUVToRGB32() arguments after rotation and mirroring have been folded
+// into the source pointers, pitches and steps. Any range of destination rows
+// can be produced from them independently of the others.
+struct ScaleParams {
+  const uint8* y_buf;
+  const uint8* u_buf;
+  const uint8* v_buf;
+  uint8* rgb_buf;
+  int source_width;
+  int source_height;
+  int width;
+  int height;
+  int y_pitch;
+  int uv_pitch;
+  int rgb_pitch;
+  unsigned int y_shift;
+  int source_dx;
+  int yscale_fixed;
+  ScaleFilter filter;
+  FilterYUVRowsProc filter_proc;
+  ConvertYUVToRGB32RowProc convert_proc;
+  ScaleYUVToRGB32RowProc scale_proc;
+  ScaleYUVToRGB32RowProc linear_scale_proc;
+};
+
+// 4096 allows 3 buffers to fit in 12k.
+// Helps performance on CPU with 16K L1 cache.
+// Large enough for 3830x2160 and 30" displays which are 2560x1600.
+static const int kFilterBufferSize = 4096;
+
+// Fills in |params| for ScaleYUVToRGB32(). Returns false if there is nothing
+// to draw.
+static bool PrepareScaleYUVToRGB32(const uint8* y_buf,
+                                   const uint8* u_buf,
+                                   const uint8* v_buf,
+                                   uint8* rgb_buf,
+                                   int source_width,
+                                   int source_height,
+                                   int width,
+                                   int height,
+                                   int y_pitch,
+                                   int uv_pitch,
+                                   int rgb_pitch,
+                                   YUVType yuv_type,
+                                   Rotate view_rotate,
+                                   ScaleFilter filter,
+                                   ScaleParams* params) {
   static FilterYUVRowsProc filter_proc = NULL;
   static ConvertYUVToRGB32RowProc convert_proc = NULL;
   static ScaleYUVToRGB32RowProc scale_proc = NULL;
@@ -135,12 +179,8 @@ void ScaleYUVToRGB32(const uint8* y_buf,
   if ((yuv_type == YV12 && (source_width < 2 || source_height < 2)) ||
       (yuv_type == YV16 && (source_width < 2 || source_height < 1)) ||
       width == 0 || height == 0)
-    return;
+    return false;
 
-  // 4096 allows 3 buffers to fit in 12k.
-  // Helps performance on CPU with 16K L1 cache.
-  // Large enough for 3830x2160 and 30" displays which are 2560x1600.
-  const int kFilterBufferSize = 4096;
   // Disable filtering if the screen is too big (to avoid buffer overflows).
   // This should never happen to regular users: they don't have monitors
   // wider than 4096 pixels.
@@ -198,6 +238,47 @@ void ScaleYUVToRGB32(const uint8* y_buf,
     }
   }
 
+  params->y_buf = y_buf;
+  params->u_buf = u_buf;
+  params->v_buf = v_buf;
+  params->rgb_buf = rgb_buf;
+  params->source_width = source_width;
+  params->source_height = source_height;
+  params->width = width;
+  params->height = height;
+  params->y_pitch = y_pitch;
+  params->uv_pitch = uv_pitch;
+  params->rgb_pitch = rgb_pitch;
+  params->y_shift = y_shift;
+  params->source_dx = source_dx;
+  // TODO(fbarchard): Fixed point math is off by 1 on negatives.
+  params->yscale_fixed = (source_height << kFractionBits) / height;
+  params->filter = filter;
+  params->filter_proc = filter_proc;
+  params->convert_proc = convert_proc;
+  params->scale_proc = scale_proc;
+  params->linear_scale_proc = linear_scale_proc;
+  return true;
+}
+
+// Produces destination rows [|dest_row_begin|, |dest_row_end|) described by
+// |params|. Safe to call concurrently for disjoint row ranges.
+static void ScaleYUVToRGB32Rows(const ScaleParams& params,
+                                int dest_row_begin,
+                                int dest_row_end) {
+  const uint8* y_buf = params.y_buf;
+  const uint8* u_buf = params.u_buf;
+  const uint8* v_buf = params.v_buf;
+  int source_width = params.source_width;
+  int source_height = params.source_height;
+  int width = params.width;
+  int y_pitch = params.y_pitch;
+  int uv_pitch = params.uv_pitch;
+  unsigned int y_shift = params.y_shift;
+  int source_dx = params.source_dx;
+  int yscale_fixed = params.yscale_fixed;
+  ScaleFilter filter = params.filter;
+
   // Need padding because FilterRows() will write 1 to 16 extra pixels
   // after the end for SSE2 version.
   uint8 yuvbuf[16 + kFilterBufferSize * 3 + 16];
@@ -205,12 +286,10 @@ void ScaleYUVToRGB32(const uint8* y_buf,
       reinterpret_cast<uint8*>(reinterpret_cast<uintptr_t>(yuvbuf + 15) & ~15);
   uint8* ubuf = ybuf + kFilterBufferSize;
   uint8* vbuf = ubuf + kFilterBufferSize;
-  // TODO(fbarchard): Fixed point math is off by 1 on negatives.
-  int yscale_fixed = (source_height << kFractionBits) / height;
 
   // TODO(fbarchard): Split this into separate function for better efficiency.
-  for (int y = 0; y < height; ++y) {
-    uint8* dest_pixel = rgb_buf + y * rgb_pitch;
+  for (int y = dest_row_begin; y < dest_row_end; ++y) {
+    uint8* dest_pixel = params.rgb_buf + y * params.rgb_pitch;
     int source_y_subpixel = (y * yscale_fixed);
     if (yscale_fixed >= (kFractionMax * 2)) {
       source_y_subpixel += kFractionMax / 2;  // For 1/2 or less, center filter.
@@ -238,7 +317,8 @@ void ScaleYUVToRGB32(const uint8* y_buf,
     if (filter & media::FILTER_BILINEAR_V) {
       if (yscale_fixed != kFractionMax &&
           source_y_fraction && ((source_y + 1) < source_height)) {
-        filter_proc(ybuf, y0_ptr, y1_ptr, source_width, source_y_fraction);
+        params.filter_proc(ybuf, y0_ptr, y1_ptr, source_width,
+                           source_y_fraction);
       } else {
         memcpy(ybuf, y0_ptr, source_width);
       }
@@ -248,8 +328,10 @@ void ScaleYUVToRGB32(const uint8* y_buf,
       if (yscale_fixed != kFractionMax &&
           source_uv_fraction &&
           (((source_y >> y_shift) + 1) < (source_height >> y_shift))) {
-        filter_proc(ubuf, u0_ptr, u1_ptr, uv_source_width, source_uv_fraction);
-        filter_proc(vbuf, v0_ptr, v1_ptr, uv_source_width, source_uv_fraction);
+        params.filter_proc(ubuf, u0_ptr, u1_ptr, uv_source_width,
+                           source_uv_fraction);
+        params.filter_proc(vbuf, v0_ptr, v1_ptr, uv_source_width,
+                           source_uv_fraction);
       } else {
         memcpy(ubuf, u0_ptr, uv_source_width);
         memcpy(vbuf, v0_ptr, uv_source_width);
@@ -260,12 +342,13 @@ void ScaleYUVToRGB32(const uint8* y_buf,
       vbuf[uv_source_width] = vbuf[uv_source_width - 1];
     }
     if (source_dx == kFractionMax) {  // Not scaled
-      convert_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width);
+      params.convert_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width);
     } else {
       if (filter & FILTER_BILINEAR_H) {
-        linear_scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width, source_dx);
+        params.linear_scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width,
+                                 source_dx);
       } else {
-        scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width, source_dx);
+        params.scale_proc(y_ptr, u_ptr, v_ptr, dest_pixel, width, source_dx);
       }
     }
   }
@@ -273,6 +356,113 @@ void ScaleYUVToRGB32(const uint8* y_buf,
   EmptyRegisterState();
 }
 
+// Scale a frame of YUV to 32 bit ARGB.
+void ScaleYUVToRGB32(const uint8* y_buf,
+                     const uint8* u_buf,
+                     const uint8* v_buf,
+                     uint8* rgb_buf,
+                     int source_width,
+                     int source_height,
+                     int width,
+                     int height,
+                     int y_pitch,
+                     int uv_pitch,
+                     int rgb_pitch,
+                     YUVType yuv_type,
+                     Rotate view_rotate,
+                     ScaleFilter filter) {
+  ScaleParams params;
+  if (!PrepareScaleYUVToRGB32(y_buf, u_buf, v_buf, rgb_buf,
+                              source_width, source_height, width, height,
+                              y_pitch, uv_pitch, rgb_pitch,
+                              yuv_type, view_rotate, filter, &params)) {
+    return;
+  }
+  ScaleYUVToRGB32Rows(params, 0, params.height);
+}
+
+// Counts down the bands of a ScaleYUVToRGB32Sliced() call that run on the
+// worker pool. Each band holds a reference so that the event is still alive
+// when the last band signals it, even if the caller has already returned.
+class ScaleBandTracker : public base::RefCountedThreadSafe<ScaleBandTracker> {
+ public:
+  explicit ScaleBandTracker(int bands)
+      : remaining_bands_(bands),
+        done_(false, false) {
+  }
+
+  void BandDone() {
+    if (!base::AtomicRefCountDec(&remaining_bands_))
+      done_.Signal();
+  }
+
+  void Wait() {
+    done_.Wait();
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<ScaleBandTracker>;
+  ~ScaleBandTracker() {}
+
+  base::AtomicRefCount remaining_bands_;
+  base::WaitableEvent done_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScaleBandTracker);
+};
+
+static void ScaleYUVToRGB32Band(const ScaleParams& params,
+                                int dest_row_begin,
+                                int dest_row_end,
+                                const scoped_refptr<ScaleBandTracker>& tracker) {
+  ScaleYUVToRGB32Rows(params, dest_row_begin, dest_row_end);
+  tracker->BandDone();
+}
+
+void ScaleYUVToRGB32Sliced(const uint8* y_buf,
+                           const uint8* u_buf,
+                           const uint8* v_buf,
+                           uint8* rgb_buf,
+                           int source_width,
+                           int source_height,
+                           int width,
+                           int height,
+                           int y_pitch,
+                           int uv_pitch,
+                           int rgb_pitch,
+                           YUVType yuv_type,
+                           Rotate view_rotate,
+                           ScaleFilter filter,
+                           int num_bands) {
+  ScaleParams params;
+  if (!PrepareScaleYUVToRGB32(y_buf, u_buf, v_buf, rgb_buf,
+                              source_width, source_height, width, height,
+                              y_pitch, uv_pitch, rgb_pitch,
+                              yuv_type, view_rotate, filter, &params)) {
+    return;
+  }
+
+  num_bands = std::min(num_bands, params.height);
+  if (num_bands <= 1) {
+    ScaleYUVToRGB32Rows(params, 0, params.height);
+    return;
+  }
+
+  // The calling thread converts the first band itself rather than sitting
+  // idle, so only the remaining ones go to the worker pool.
+  scoped_refptr<ScaleBandTracker> tracker(
+      new ScaleBandTracker(num_bands - 1));
+  for (int band = 1; band < num_bands; ++band) {
+    int begin = params.height * band / num_bands;
+    int end = params.height * (band + 1) / num_bands;
+    base::Closure task = base::Bind(&ScaleYUVToRGB32Band, params,
+                                    begin, end, tracker);
+    if (!base::WorkerPool::PostTask(FROM_HERE, task, false))
+      task.Run();
+  }
+  ScaleYUVToRGB32Rows(params, 0, params.height / num_bands);
+  tracker->Wait();
+}
+
 // Scale a frame of YV12 to 32 bit ARGB for a specific rectangle.
 void ScaleYUVToRGB32WithRect(const uint8* y_buf,
                              const uint8* u_buf,
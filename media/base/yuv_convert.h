@@ -67,6 +67,26 @@ void ScaleYUVToRGB32(const uint8* yplane,
                      Rotate view_rotate,
                      ScaleFilter filter);
 
+// Same as ScaleYUVToRGB32(), but splits the destination into |num_bands|
+// bands of rows that are scaled concurrently on the worker pool. The calling
+// thread scales one of the bands and blocks until all of them are done, so
+// the buffers only need to stay valid for the duration of the call.
+void ScaleYUVToRGB32Sliced(const uint8* yplane,
+                           const uint8* uplane,
+                           const uint8* vplane,
+                           uint8* rgbframe,
+                           int source_width,
+                           int source_height,
+                           int width,
+                           int height,
+                           int ystride,
+                           int uvstride,
+                           int rgbstride,
+                           YUVType yuv_type,
+                           Rotate view_rotate,
+                           ScaleFilter filter,
+                           int num_bands);
+
 // Biliner Scale a frame of YV12 to 32 bits ARGB on a specified rectangle.
 // |yplane|, etc and |rgbframe| should point to the top-left pixels of the
 // source and destination buffers.
@@ -237,6 +237,26 @@ TEST_P(YUVScaleTest, OddWidthAndHeightNotCrash) {
                          GetParam().scale_filter);
 }
 
+TEST_P(YUVScaleTest, Sliced) {
+  // Bands of uneven height must produce the same image as a single pass.
+  media::ScaleYUVToRGB32Sliced(y_plane(),                    // Y
+                               u_plane(),                    // U
+                               v_plane(),                    // V
+                               rgb_bytes_.get(),             // RGB output
+                               kSourceWidth, kSourceHeight,  // Dimensions
+                               kScaledWidth, kScaledHeight,  // Dimensions
+                               kSourceWidth,                 // YStride
+                               kSourceWidth / 2,             // UvStride
+                               kScaledWidth * kBpp,          // RgbStride
+                               GetParam().yuv_type,
+                               media::ROTATE_0,
+                               GetParam().scale_filter,
+                               5);                           // Bands
+
+  uint32 rgb_hash = DJB2Hash(rgb_bytes_.get(), kRGBSizeScaled, kDJB2HashSeed);
+  EXPECT_EQ(GetParam().rgb_hash, rgb_hash);
+}
+
 INSTANTIATE_TEST_CASE_P(
     YUVScaleFormats, YUVScaleTest,
     ::testing::Values(
@@ -722,6 +742,70 @@ TEST(YUVConvertTest, LinearScaleYUVToRGB32Row_SSE) {
                       kWidth * kBpp));
 }
 
+TEST(YUVConvertTest, ConvertYUVToRGB32Row_SSE2) {
+  if (!media::hasSSE2()) {
+    LOG(WARNING) << "System not supported. Test skipped.";
+    return;
+  }
+
+  scoped_array<uint8> yuv_bytes(new uint8[kYUV12Size]);
+  scoped_array<uint8> rgb_bytes_reference(new uint8[kRGBSize]);
+  scoped_array<uint8> rgb_bytes_converted(new uint8[kRGBSize]);
+  ReadYV12Data(&yuv_bytes);
+
+  const int kWidth = 167;
+  ConvertYUVToRGB32Row_C(yuv_bytes.get(),
+                         yuv_bytes.get() + kSourceUOffset,
+                         yuv_bytes.get() + kSourceVOffset,
+                         rgb_bytes_reference.get(),
+                         kWidth);
+  ConvertYUVToRGB32Row_SSE2(yuv_bytes.get(),
+                            yuv_bytes.get() + kSourceUOffset,
+                            yuv_bytes.get() + kSourceVOffset,
+                            rgb_bytes_converted.get(),
+                            kWidth);
+  EXPECT_EQ(0, memcmp(rgb_bytes_reference.get(),
+                      rgb_bytes_converted.get(),
+                      kWidth * kBpp));
+}
+
+TEST(YUVConvertTest, LinearScaleYUVToRGB32Row_SSE2) {
+  if (!media::hasSSE2()) {
+    LOG(WARNING) << "System not supported. Test skipped.";
+    return;
+  }
+
+  scoped_array<uint8> yuv_bytes(new uint8[kYUV12Size]);
+  scoped_array<uint8> rgb_bytes_reference(new uint8[kRGBSize]);
+  scoped_array<uint8> rgb_bytes_converted(new uint8[kRGBSize]);
+  ReadYV12Data(&yuv_bytes);
+
+  // Cover scaling up, down and by more than 2:1, which changes the start
+  // position, with widths that leave 1 to 3 pixels for the tail.
+  const int kWidths[] = { 165, 166, 167, 168 };
+  const int kSourceDxs[] = { 40000, 80000, 140000 };
+  for (size_t i = 0; i < arraysize(kWidths); ++i) {
+    for (size_t j = 0; j < arraysize(kSourceDxs); ++j) {
+      LinearScaleYUVToRGB32Row_C(yuv_bytes.get(),
+                                 yuv_bytes.get() + kSourceUOffset,
+                                 yuv_bytes.get() + kSourceVOffset,
+                                 rgb_bytes_reference.get(),
+                                 kWidths[i],
+                                 kSourceDxs[j]);
+      LinearScaleYUVToRGB32Row_SSE2(yuv_bytes.get(),
+                                    yuv_bytes.get() + kSourceUOffset,
+                                    yuv_bytes.get() + kSourceVOffset,
+                                    rgb_bytes_converted.get(),
+                                    kWidths[i],
+                                    kSourceDxs[j]);
+      EXPECT_EQ(0, memcmp(rgb_bytes_reference.get(),
+                          rgb_bytes_converted.get(),
+                          kWidths[i] * kBpp))
+          << "width " << kWidths[i] << ", source_dx " << kSourceDxs[j];
+    }
+  }
+}
+
 TEST(YUVConvertTest, FilterYUVRows_C_OutOfBounds) {
   scoped_array<uint8> src(new uint8[16]);
   scoped_array<uint8> dst(new uint8[16]);
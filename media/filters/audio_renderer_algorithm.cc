@@ -9,8 +9,10 @@
 
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
+#include "build/build_config.h"
 #include "media/audio/audio_util.h"
 #include "media/base/buffers.h"
+#include "media/base/cpu_features.h"
 
 namespace media {
 
@@ -29,6 +31,10 @@ static const double kWindowDuration = 0.08;
 // Duration of crossfade between audio segments (in seconds).
 static const double kCrossfadeDuration = 0.008;
 
+// How far the splice point between audio segments may move in either
+// direction to line up similar waveforms (in seconds).
+static const double kSearchDuration = 0.005;
+
 // Max/min supported playback rates for fast/slow audio. Audio outside of these
 // ranges are muted.
 // Audio at these speeds would sound better under a frequency domain algorithm.
@@ -44,10 +50,24 @@ AudioRendererAlgorithm::AudioRendererAlgorithm()
       bytes_in_crossfade_(0),
       bytes_per_frame_(0),
       index_into_window_(0),
-      crossfade_frame_number_(0),
       muted_(false),
       needs_more_data_(false),
-      window_size_(0) {
+      end_of_stream_(false),
+      window_size_(0),
+      bytes_in_ramp_(0),
+      bytes_in_search_(0),
+      wsola_drift_(0),
+      wsola_offset_(-1),
+      dot_product_proc_(&DotProduct_C),
+      convert_int16_to_float_proc_(&ConvertInt16ToFloat_C),
+      crossfade_int16_proc_(&CrossfadeInt16_C) {
+#if defined(ARCH_CPU_X86_FAMILY)
+  if (hasSSE2()) {
+    dot_product_proc_ = &DotProduct_SSE2;
+    convert_int16_to_float_proc_ = &ConvertInt16ToFloat_SSE2;
+    crossfade_int16_proc_ = &CrossfadeInt16_SSE2;
+  }
+#endif
 }
 
 AudioRendererAlgorithm::~AudioRendererAlgorithm() {}
@@ -102,6 +122,27 @@ void AudioRendererAlgorithm::Initialize(
   AlignToFrameBoundary(&bytes_in_crossfade_);
 
   crossfade_buffer_.reset(new uint8[bytes_in_crossfade_]);
+
+  int samples_in_crossfade = bytes_in_crossfade_ / bytes_per_channel_;
+  crossfade_ramp_.reset(new float[samples_in_crossfade]);
+  bytes_in_ramp_ = 0;
+
+  bytes_in_search_ =
+      samples_per_second_ * bytes_per_channel_ * channels_ * kSearchDuration;
+  AlignToFrameBoundary(&bytes_in_search_);
+
+  int bytes_in_search_region = bytes_in_crossfade_ + 2 * bytes_in_search_;
+  search_buffer_.reset(new uint8[bytes_in_search_region]);
+  search_samples_.reset(
+      new float[bytes_in_search_region / bytes_per_channel_]);
+  target_samples_.reset(new float[samples_in_crossfade]);
+
+  // Make sure the queue can hold the lookahead of a whole window, otherwise
+  // CanFillBuffer() could wait for data that is never read.
+  if (QueueCapacity() < BytesNeededForWindow()) {
+    audio_buffer_.set_forward_capacity(
+        std::min(BytesNeededForWindow(), kMaxBufferSizeInBytes));
+  }
 }
 
 int AudioRendererAlgorithm::FillBuffer(
@@ -117,21 +158,35 @@ int AudioRendererAlgorithm::FillBuffer(
     if (index_into_window_ == window_size_)
       ResetWindow();
 
-    bool rendered_frame = true;
-    if (playback_rate_ > 1.0)
-      rendered_frame = OutputFasterPlayback(output_ptr);
-    else if (playback_rate_ < 1.0)
-      rendered_frame = OutputSlowerPlayback(output_ptr);
-    else
-      rendered_frame = OutputNormalPlayback(output_ptr);
+    // There is no more data to complete the last window with once the stream
+    // has ended, so what is left is output as is.
+    bool play_out = end_of_stream_ &&
+        audio_buffer_.forward_bytes() < BytesNeededForWindow();
+
+    int frames_left = requested_frames - total_frames_rendered;
+    int frames_rendered = 0;
+    bool has_data = true;
+    if (play_out) {
+      has_data = OutputNormalPlayback(output_ptr, frames_left,
+                                      &frames_rendered);
+    } else if (playback_rate_ > 1.0) {
+      has_data = OutputFasterPlayback(output_ptr, frames_left,
+                                      &frames_rendered);
+    } else if (playback_rate_ < 1.0) {
+      has_data = OutputSlowerPlayback(output_ptr, frames_left,
+                                      &frames_rendered);
+    } else {
+      has_data = OutputNormalPlayback(output_ptr, frames_left,
+                                      &frames_rendered);
+    }
+
+    output_ptr += frames_rendered * bytes_per_frame_;
+    total_frames_rendered += frames_rendered;
 
-    if (!rendered_frame) {
+    if (!has_data) {
       needs_more_data_ = true;
       break;
     }
-
-    output_ptr += bytes_per_frame_;
-    total_frames_rendered++;
   }
   return total_frames_rendered;
 }
@@ -139,14 +194,17 @@ int AudioRendererAlgorithm::FillBuffer(
 void AudioRendererAlgorithm::ResetWindow() {
   DCHECK_LE(index_into_window_, window_size_);
   index_into_window_ = 0;
-  crossfade_frame_number_ = 0;
+  wsola_offset_ = -1;
 }
 
-bool AudioRendererAlgorithm::OutputFasterPlayback(uint8* dest) {
+bool AudioRendererAlgorithm::OutputFasterPlayback(uint8* dest,
+                                                  int requested_frames,
+                                                  int* frames_written) {
   DCHECK_LT(index_into_window_, window_size_);
   DCHECK_GT(playback_rate_, 1.0);
+  *frames_written = 0;
 
-  if (audio_buffer_.forward_bytes() < bytes_per_frame_)
+  if (FramesBuffered() == 0)
     return false;
 
   // The audio data is output in a series of windows. For sped-up playback,
@@ -154,8 +212,10 @@ bool AudioRendererAlgorithm::OutputFasterPlayback(uint8* dest) {
   //
   //  a) Output raw data.
   //  b) Save bytes for crossfade in |crossfade_buffer_|.
-  //  c) Drop data.
-  //  d) Output crossfaded audio leading up to the next window.
+  //  c) Drop data up to the start of the search region.
+  //  d) Find the intro within the search region that best matches the saved
+  //     outtro and drop data up to it.
+  //  e) Output crossfaded audio leading up to the next window.
   //
   // The duration of each phase is computed below based on the |window_size_|
   // and |playback_rate_|.
@@ -168,86 +228,130 @@ bool AudioRendererAlgorithm::OutputFasterPlayback(uint8* dest) {
   if (muted_ || bytes_to_crossfade > output_step)
     bytes_to_crossfade = 0;
 
+  // The intro cannot start before the end of the outtro, which limits the
+  // crossfade for playback rates close to 1.0.
+  bytes_to_crossfade = std::min(bytes_to_crossfade, input_step - output_step);
+  PrepareCrossfadeRamp(bytes_to_crossfade);
+
   // This is the index of the end of phase a, beginning of phase b.
   int outtro_crossfade_begin = output_step - bytes_to_crossfade;
 
   // This is the index of the end of phase b, beginning of phase c.
   int outtro_crossfade_end = output_step;
 
-  // This is the index of the end of phase c, beginning of phase d.
+  // This is the index of the end of phase d, beginning of phase e.
   // This phase continues until |index_into_window_| reaches |window_size_|, at
   // which point the window restarts.
   int intro_crossfade_begin = input_step - bytes_to_crossfade;
 
-  // a) Output a raw frame if we haven't reached the crossfade section.
+  // This is the index of the end of phase c, beginning of phase d. The search
+  // cannot reach back into data that was already saved for the outtro.
+  int search_bytes = 0;
+  if (bytes_to_crossfade > 0) {
+    search_bytes = std::min(bytes_in_search_,
+                            intro_crossfade_begin - outtro_crossfade_end);
+  }
+  int search_begin = intro_crossfade_begin - search_bytes;
+
+  // a) Output raw frames if we haven't reached the crossfade section.
   if (index_into_window_ < outtro_crossfade_begin) {
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
+    int frames = std::min(
+        requested_frames,
+        (outtro_crossfade_begin - index_into_window_) / bytes_per_frame_);
+    frames = std::min(frames, FramesBuffered());
+    CopyWithAdvance(dest, frames);
+    index_into_window_ += frames * bytes_per_frame_;
+    *frames_written = frames;
     return true;
   }
 
   // b) Save outtro crossfade frames into intermediate buffer, but do not output
   //    anything to |dest|.
-  while (index_into_window_ < outtro_crossfade_end) {
-    if (audio_buffer_.forward_bytes() < bytes_per_frame_)
-      return false;
-
+  if (index_into_window_ < outtro_crossfade_end) {
     // This phase only applies if there are bytes to crossfade.
     DCHECK_GT(bytes_to_crossfade, 0);
+    int frames = std::min(
+        (outtro_crossfade_end - index_into_window_) / bytes_per_frame_,
+        FramesBuffered());
     uint8* place_to_copy = crossfade_buffer_.get() +
         (index_into_window_ - outtro_crossfade_begin);
-    CopyWithAdvance(place_to_copy);
-    index_into_window_ += bytes_per_frame_;
+    CopyWithAdvance(place_to_copy, frames);
+    index_into_window_ += frames * bytes_per_frame_;
+    if (index_into_window_ < outtro_crossfade_end)
+      return false;
+  }
+
+  // c) Drop frames until we reach the search region.
+  if (index_into_window_ < search_begin) {
+    int frames = std::min(
+        (search_begin - index_into_window_) / bytes_per_frame_,
+        FramesBuffered());
+    DropFrames(frames);
+    index_into_window_ += frames * bytes_per_frame_;
+    if (index_into_window_ < search_begin)
+      return false;
   }
 
-  // c) Drop frames until we reach the intro crossfade section.
-  while (index_into_window_ < intro_crossfade_begin) {
-    if (audio_buffer_.forward_bytes() < bytes_per_frame_)
+  // d) Drop frames up to the best matching intro. This happens in one step
+  //    since the whole search region must be buffered.
+  if (index_into_window_ < intro_crossfade_begin) {
+    int frames_in_crossfade = bytes_to_crossfade / bytes_per_frame_;
+    int frames_in_search = search_bytes / bytes_per_frame_;
+    if (FramesBuffered() < frames_in_crossfade + 2 * frames_in_search)
       return false;
 
-    DropFrame();
-    index_into_window_ += bytes_per_frame_;
+    DropFrames(FindBestMatch(crossfade_buffer_.get(), frames_in_crossfade,
+                             2 * frames_in_search, frames_in_search));
+    index_into_window_ = intro_crossfade_begin;
   }
 
-  // Return if we have run out of data after Phase c).
-  if (audio_buffer_.forward_bytes() < bytes_per_frame_)
-    return false;
+  // Phase e) doesn't apply if there are no bytes to crossfade.
+  if (index_into_window_ == window_size_) {
+    DCHECK_EQ(bytes_to_crossfade, 0);
+    return true;
+  }
 
-  // Phase d) doesn't apply if there are no bytes to crossfade.
-  if (bytes_to_crossfade == 0) {
-    DCHECK_EQ(index_into_window_, window_size_);
+  // Return if we have run out of data after phase d).
+  if (FramesBuffered() == 0)
     return false;
-  }
 
-  // d) Crossfade and output a frame.
+  // e) Crossfade and output frames.
   DCHECK_LT(index_into_window_, window_size_);
   int offset_into_buffer = index_into_window_ - intro_crossfade_begin;
-  memcpy(dest, crossfade_buffer_.get() + offset_into_buffer,
-         bytes_per_frame_);
-  scoped_array<uint8> intro_frame_ptr(new uint8[bytes_per_frame_]);
-  audio_buffer_.Read(intro_frame_ptr.get(), bytes_per_frame_);
-  OutputCrossfadedFrame(dest, intro_frame_ptr.get());
-  index_into_window_ += bytes_per_frame_;
+  int frames = std::min(
+      requested_frames,
+      (window_size_ - index_into_window_) / bytes_per_frame_);
+  frames = std::min(frames, FramesBuffered());
+  CopyWithAdvance(dest, frames);
+  CrossfadeFrames(crossfade_buffer_.get() + offset_into_buffer, dest, dest,
+                  offset_into_buffer, frames);
+  index_into_window_ += frames * bytes_per_frame_;
+  *frames_written = frames;
   return true;
 }
 
-bool AudioRendererAlgorithm::OutputSlowerPlayback(uint8* dest) {
+bool AudioRendererAlgorithm::OutputSlowerPlayback(uint8* dest,
+                                                  int requested_frames,
+                                                  int* frames_written) {
   DCHECK_LT(index_into_window_, window_size_);
   DCHECK_LT(playback_rate_, 1.0);
   DCHECK_NE(playback_rate_, 0.0);
+  *frames_written = 0;
 
-  if (audio_buffer_.forward_bytes() < bytes_per_frame_)
+  if (FramesBuffered() == 0)
     return false;
 
   // The audio data is output in a series of windows. For slowed down playback,
   // the window is comprised of the following phases:
   //
   //  a) Output raw data.
-  //  b) Output and save bytes for crossfade in |crossfade_buffer_|.
-  //  c) Output* raw data.
-  //  d) Output* crossfaded audio leading up to the next window.
+  //  b) Output* raw data.
+  //  c) Find the intro of the next window that best matches the data output
+  //     during phase d) and save it in |crossfade_buffer_|.
+  //  d) Output* crossfaded audio leading up to the next window, then drop
+  //     data up to the end of the intro.
   //
-  // * Phases c) and d) do not progress |audio_buffer_|'s cursor so that the
+  // * Phases b) and d) do not progress |audio_buffer_|'s cursor so that the
   // |audio_buffer_|'s cursor is in the correct place for the next window.
   //
   // The duration of each phase is computed below based on the |window_size_|
@@ -260,129 +364,279 @@ bool AudioRendererAlgorithm::OutputSlowerPlayback(uint8* dest) {
   int bytes_to_crossfade = bytes_in_crossfade_;
   if (muted_ || bytes_to_crossfade > input_step)
     bytes_to_crossfade = 0;
+  PrepareCrossfadeRamp(bytes_to_crossfade);
 
-  // This is the index of the end of phase a, beginning of phase b.
-  int intro_crossfade_begin = input_step - bytes_to_crossfade;
+  int search_bytes = 0;
+  if (bytes_to_crossfade > 0)
+    search_bytes = std::min(bytes_in_search_, input_step - bytes_to_crossfade);
 
-  // This is the index of the end of phase b, beginning of phase c.
-  int intro_crossfade_end = input_step;
+  // This is the index of the end of phase a, beginning of phase b. The rest of
+  // the input step is consumed at the end of the window, once the intro has
+  // been chosen from the |2 * search_bytes| candidates following it.
+  int intro_search_begin = input_step - bytes_to_crossfade - search_bytes;
 
-  // This is the index of the end of phase c,  beginning of phase d.
+  // This is the index of the end of phase b, beginning of phase d.
   // This phase continues until |index_into_window_| reaches |window_size_|, at
   // which point the window restarts.
   int outtro_crossfade_begin = output_step - bytes_to_crossfade;
 
-  // a) Output a raw frame.
-  if (index_into_window_ < intro_crossfade_begin) {
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
+  // a) Output raw frames.
+  if (index_into_window_ < intro_search_begin) {
+    int frames = std::min(
+        requested_frames,
+        (intro_search_begin - index_into_window_) / bytes_per_frame_);
+    frames = std::min(frames, FramesBuffered());
+    CopyWithAdvance(dest, frames);
+    index_into_window_ += frames * bytes_per_frame_;
+    *frames_written = frames;
     return true;
   }
 
-  // b) Save the raw frame for the intro crossfade section, then output the
-  //    frame to |dest|.
-  if (index_into_window_ < intro_crossfade_end) {
-    int offset = index_into_window_ - intro_crossfade_begin;
-    uint8* place_to_copy = crossfade_buffer_.get() + offset;
-    CopyWithoutAdvance(place_to_copy);
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
+  int audio_buffer_offset = index_into_window_ - intro_search_begin;
+  int frames_available =
+      FramesBuffered() - audio_buffer_offset / bytes_per_frame_;
+
+  // b) Output raw frames into |dest| without advancing the |audio_buffer_|
+  //    cursor. See function-level comment.
+  if (index_into_window_ < outtro_crossfade_begin) {
+    int frames = std::min(
+        requested_frames,
+        (outtro_crossfade_begin - index_into_window_) / bytes_per_frame_);
+    frames = std::min(frames, frames_available);
+    if (frames <= 0)
+      return false;
+
+    CopyWithoutAdvance(dest, audio_buffer_offset, frames);
+    index_into_window_ += frames * bytes_per_frame_;
+    *frames_written = frames;
     return true;
   }
 
-  int audio_buffer_offset = index_into_window_ - intro_crossfade_end;
+  // Phase b) lasts the whole window when there are no bytes to crossfade.
+  DCHECK_GT(bytes_to_crossfade, 0);
+  int frames_in_crossfade = bytes_to_crossfade / bytes_per_frame_;
+  int frames_in_search = search_bytes / bytes_per_frame_;
+
+  // c) Save the intro for the crossfade section. The outtro is the data that
+  //    phase d) outputs.
+  if (wsola_offset_ < 0) {
+    int frames_needed = std::max(
+        (outtro_crossfade_begin - intro_search_begin) / bytes_per_frame_ +
+            frames_in_crossfade,
+        frames_in_crossfade + 2 * frames_in_search);
+    if (FramesBuffered() < frames_needed)
+      return false;
 
-  if (audio_buffer_.forward_bytes() < audio_buffer_offset + bytes_per_frame_)
+    CopyWithoutAdvance(crossfade_buffer_.get(), audio_buffer_offset,
+                       frames_in_crossfade);
+    wsola_offset_ = bytes_per_frame_ * FindBestMatch(
+        crossfade_buffer_.get(), frames_in_crossfade, 2 * frames_in_search,
+        frames_in_search);
+    CopyWithoutAdvance(crossfade_buffer_.get(), wsola_offset_,
+                       frames_in_crossfade);
+  }
+
+  // d) Crossfade the raw frames that follow into the saved intro.
+  int offset_into_crossfade_buffer =
+      index_into_window_ - outtro_crossfade_begin;
+  int frames = std::min(
+      requested_frames,
+      (window_size_ - index_into_window_) / bytes_per_frame_);
+  frames = std::min(frames, frames_available);
+  if (frames <= 0)
     return false;
 
-  // c) Output a raw frame into |dest| without advancing the |audio_buffer_|
-  //    cursor. See function-level comment.
-  DCHECK_GE(index_into_window_, intro_crossfade_end);
-  CopyWithoutAdvance(dest, audio_buffer_offset);
-
-  // d) Crossfade the next frame of |crossfade_buffer_| into |dest| if we've
-  //    reached the outtro crossfade section of the window.
-  if (index_into_window_ >= outtro_crossfade_begin) {
-    int offset_into_crossfade_buffer =
-        index_into_window_ - outtro_crossfade_begin;
-    uint8* intro_frame_ptr =
-        crossfade_buffer_.get() + offset_into_crossfade_buffer;
-    OutputCrossfadedFrame(dest, intro_frame_ptr);
-  }
+  CopyWithoutAdvance(dest, audio_buffer_offset, frames);
+  CrossfadeFrames(dest,
+                  crossfade_buffer_.get() + offset_into_crossfade_buffer,
+                  dest, offset_into_crossfade_buffer, frames);
+  index_into_window_ += frames * bytes_per_frame_;
+  *frames_written = frames;
 
-  index_into_window_ += bytes_per_frame_;
+  // The next window starts right after the intro.
+  if (index_into_window_ == window_size_)
+    DropFrames(wsola_offset_ / bytes_per_frame_ + frames_in_crossfade);
   return true;
 }
 
-bool AudioRendererAlgorithm::OutputNormalPlayback(uint8* dest) {
-  if (audio_buffer_.forward_bytes() >= bytes_per_frame_) {
-    CopyWithAdvance(dest);
-    index_into_window_ += bytes_per_frame_;
-    return true;
-  }
-  return false;
-}
-
-void AudioRendererAlgorithm::CopyWithAdvance(uint8* dest) {
-  CopyWithoutAdvance(dest);
-  DropFrame();
+bool AudioRendererAlgorithm::OutputNormalPlayback(uint8* dest,
+                                                  int requested_frames,
+                                                  int* frames_written) {
+  int frames = std::min(requested_frames, FramesBuffered());
+  frames = std::min(
+      frames, (window_size_ - index_into_window_) / bytes_per_frame_);
+  CopyWithAdvance(dest, frames);
+  index_into_window_ += frames * bytes_per_frame_;
+  *frames_written = frames;
+  return frames > 0;
 }
 
-void AudioRendererAlgorithm::CopyWithoutAdvance(uint8* dest) {
-  CopyWithoutAdvance(dest, 0);
+void AudioRendererAlgorithm::CopyWithAdvance(uint8* dest, int frames) {
+  CopyWithoutAdvance(dest, 0, frames);
+  DropFrames(frames);
 }
 
 void AudioRendererAlgorithm::CopyWithoutAdvance(
-    uint8* dest, int offset) {
+    uint8* dest, int offset, int frames) {
+  int bytes = frames * bytes_per_frame_;
   if (muted_) {
-    memset(dest, 0, bytes_per_frame_);
+    memset(dest, 0, bytes);
     return;
   }
-  int copied = audio_buffer_.Peek(dest, bytes_per_frame_, offset);
-  DCHECK_EQ(bytes_per_frame_, copied);
+  int copied = audio_buffer_.Peek(dest, bytes, offset);
+  DCHECK_EQ(bytes, copied);
 }
 
-void AudioRendererAlgorithm::DropFrame() {
-  audio_buffer_.Seek(bytes_per_frame_);
+void AudioRendererAlgorithm::DropFrames(int frames) {
+  if (frames == 0)
+    return;
+
+  audio_buffer_.Seek(frames * bytes_per_frame_);
 
   if (!IsQueueFull())
     request_read_cb_.Run();
 }
 
-void AudioRendererAlgorithm::OutputCrossfadedFrame(
-    uint8* outtro, const uint8* intro) {
+int AudioRendererAlgorithm::FramesBuffered() {
+  return audio_buffer_.forward_bytes() / bytes_per_frame_;
+}
+
+int AudioRendererAlgorithm::FindBestMatch(
+    const uint8* target, int target_frames, int max_offset,
+    int nominal_offset) {
+  DCHECK(!muted_);
+  DCHECK_GE(FramesBuffered(), target_frames + max_offset);
+
+  // Steer the search back towards the nominal offset by the amount of input
+  // previous searches consumed too much or too little.
+  int center = nominal_offset - wsola_drift_ / bytes_per_frame_;
+  int min_offset = std::max(0, center - nominal_offset);
+  int max_candidate = std::min(max_offset, center + nominal_offset);
+  if (min_offset > max_candidate) {
+    min_offset = std::min(std::max(center, 0), max_offset);
+    max_candidate = min_offset;
+  }
+
+  int region_frames = target_frames + max_candidate;
+  int copied = audio_buffer_.Peek(search_buffer_.get(),
+                                  region_frames * bytes_per_frame_);
+  DCHECK_EQ(region_frames * bytes_per_frame_, copied);
+
+  int target_length = target_frames * channels_;
+  ConvertToFloat(target, target_samples_.get(), target_length);
+  ConvertToFloat(search_buffer_.get(), search_samples_.get(),
+                 region_frames * channels_);
+
+  // Candidates are ranked by their correlation with the target normalized by
+  // their energy, which is updated incrementally as the candidate slides.
+  const float* target_samples = target_samples_.get();
+  const float* candidate = search_samples_.get() + min_offset * channels_;
+  float energy = dot_product_proc_(candidate, candidate, target_length);
+
+  int best_offset = min_offset;
+  float best_score = 0.0f;
+  for (int offset = min_offset; offset <= max_candidate; ++offset) {
+    if (offset > min_offset) {
+      const float* removed = candidate - channels_;
+      const float* added = candidate + target_length - channels_;
+      for (int channel = 0; channel < channels_; ++channel) {
+        energy -= removed[channel] * removed[channel];
+        energy += added[channel] * added[channel];
+      }
+      energy = std::max(energy, 0.0f);
+    }
+
+    float correlation =
+        dot_product_proc_(target_samples, candidate, target_length);
+    float score = correlation / sqrt(energy + 1.0f);
+    if (offset == min_offset || score > best_score) {
+      best_score = score;
+      best_offset = offset;
+    }
+    candidate += channels_;
+  }
+
+  wsola_drift_ += (best_offset - nominal_offset) * bytes_per_frame_;
+  return best_offset;
+}
+
+void AudioRendererAlgorithm::ConvertToFloat(
+    const uint8* source, float* dest, int samples) {
+  switch (bytes_per_channel_) {
+    case 4: {
+      const int32* source_samples = reinterpret_cast<const int32*>(source);
+      for (int i = 0; i < samples; ++i)
+        dest[i] = source_samples[i];
+      break;
+    }
+    case 2:
+      convert_int16_to_float_proc_(reinterpret_cast<const int16*>(source),
+                                   dest, samples);
+      break;
+    case 1:
+      // Unsigned samples are centered around 128.
+      for (int i = 0; i < samples; ++i)
+        dest[i] = static_cast<int>(source[i]) - 128;
+      break;
+    default:
+      NOTREACHED() << "Unsupported audio bit depth in crossfade.";
+  }
+}
+
+void AudioRendererAlgorithm::CrossfadeFrames(
+    const uint8* outtro, const uint8* intro, uint8* dest,
+    int crossfade_offset, int frames) {
   DCHECK_LE(index_into_window_, window_size_);
+  DCHECK_LE(crossfade_offset + frames * bytes_per_frame_, bytes_in_ramp_);
   DCHECK(!muted_);
 
+  const float* ramp =
+      crossfade_ramp_.get() + crossfade_offset / bytes_per_channel_;
+  int samples = frames * channels_;
   switch (bytes_per_channel_) {
     case 4:
-      CrossfadeFrame<int32>(outtro, intro);
+      CrossfadeSamples(reinterpret_cast<const int32*>(outtro),
+                       reinterpret_cast<const int32*>(intro),
+                       reinterpret_cast<int32*>(dest), ramp, samples);
       break;
     case 2:
-      CrossfadeFrame<int16>(outtro, intro);
+      crossfade_int16_proc_(reinterpret_cast<const int16*>(outtro),
+                            reinterpret_cast<const int16*>(intro), ramp,
+                            reinterpret_cast<int16*>(dest), samples);
       break;
     case 1:
-      CrossfadeFrame<uint8>(outtro, intro);
+      CrossfadeSamples(outtro, intro, dest, ramp, samples);
       break;
     default:
       NOTREACHED() << "Unsupported audio bit depth in crossfade.";
   }
 }
 
+void AudioRendererAlgorithm::PrepareCrossfadeRamp(int bytes_to_crossfade) {
+  DCHECK_LE(bytes_to_crossfade, bytes_in_crossfade_);
+  if (bytes_to_crossfade == bytes_in_ramp_)
+    return;
+
+  // The crossfade weight of the intro ramps up linearly over the frames of the
+  // crossfade and is the same for every channel of a frame.
+  int frames_in_crossfade = bytes_to_crossfade / bytes_per_frame_;
+  int samples_in_crossfade = frames_in_crossfade * channels_;
+  for (int i = 0; i < samples_in_crossfade; ++i) {
+    crossfade_ramp_[i] =
+        static_cast<float>(i / channels_) / frames_in_crossfade;
+  }
+  bytes_in_ramp_ = bytes_to_crossfade;
+}
+
 template <class Type>
-void AudioRendererAlgorithm::CrossfadeFrame(
-    uint8* outtro_bytes, const uint8* intro_bytes) {
-  Type* outtro = reinterpret_cast<Type*>(outtro_bytes);
-  const Type* intro = reinterpret_cast<const Type*>(intro_bytes);
-
-  int frames_in_crossfade = bytes_in_crossfade_ / bytes_per_frame_;
-  float crossfade_ratio =
-      static_cast<float>(crossfade_frame_number_) / frames_in_crossfade;
-  for (int channel = 0; channel < channels_; ++channel) {
-    *outtro *= 1.0 - crossfade_ratio;
-    *outtro++ += (*intro++) * crossfade_ratio;
+void AudioRendererAlgorithm::CrossfadeSamples(
+    const Type* outtro, const Type* intro, Type* dest, const float* ramp,
+    int samples) {
+  for (int i = 0; i < samples; ++i) {
+    double outtro_sample = outtro[i];
+    dest[i] = static_cast<Type>(
+        outtro_sample + (intro[i] - outtro_sample) * ramp[i]);
   }
-  crossfade_frame_number_++;
 }
 
 void AudioRendererAlgorithm::SetPlaybackRate(float new_rate) {
@@ -400,6 +654,8 @@ void AudioRendererAlgorithm::AlignToFrameBoundary(int* value) {
 
 void AudioRendererAlgorithm::FlushBuffers() {
   ResetWindow();
+  wsola_drift_ = 0;
+  end_of_stream_ = false;
 
   // Clear the queue of decoded packets (releasing the buffers).
   audio_buffer_.Clear();
@@ -412,6 +668,7 @@ base::TimeDelta AudioRendererAlgorithm::GetTime() {
 
 void AudioRendererAlgorithm::EnqueueBuffer(Buffer* buffer_in) {
   DCHECK(!buffer_in->IsEndOfStream());
+  DCHECK(!end_of_stream_);
   audio_buffer_.Append(buffer_in);
   needs_more_data_ = false;
 
@@ -420,8 +677,35 @@ void AudioRendererAlgorithm::EnqueueBuffer(Buffer* buffer_in) {
     request_read_cb_.Run();
 }
 
+void AudioRendererAlgorithm::MarkEndOfStream() {
+  end_of_stream_ = true;
+  needs_more_data_ = false;
+}
+
 bool AudioRendererAlgorithm::CanFillBuffer() {
-  return audio_buffer_.forward_bytes() > 0 && !needs_more_data_;
+  if (audio_buffer_.forward_bytes() == 0)
+    return false;
+
+  // Whatever is left is output once the stream has ended.
+  if (end_of_stream_)
+    return true;
+
+  if (needs_more_data_)
+    return false;
+
+  // Normal playback outputs whatever is buffered.
+  if (playback_rate_ == 1.0f)
+    return true;
+
+  // WSOLA may need to buffer up to a whole window and its search region
+  // before it outputs the next frame. Never wait for more than the queue
+  // holds, as no more is read once it is full.
+  return audio_buffer_.forward_bytes() >=
+      std::min(BytesNeededForWindow(), QueueCapacity());
+}
+
+int AudioRendererAlgorithm::BytesNeededForWindow() {
+  return window_size_ + bytes_in_search_;
 }
 
 bool AudioRendererAlgorithm::IsQueueFull() {
@@ -13,7 +13,7 @@
 // This class is *not* thread-safe. Calls to enqueue and retrieve data must be
 // locked if called from multiple threads.
 //
-// AudioRendererAlgorithm uses a simple pitch-preservation algorithm to
+// AudioRendererAlgorithm uses WSOLA (waveform similarity overlap-add) to
 // stretch and compress audio data to meet playback speeds less than and
 // greater than the natural playback of the audio stream.
 //
@@ -25,6 +25,7 @@
 #include "base/callback.h"
 #include "base/gtest_prod_util.h"
 #include "media/base/seekable_buffer.h"
+#include "media/base/simd/time_stretch.h"
 
 namespace media {
 
@@ -53,7 +54,7 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
 
   // Tries to fill |requested_frames| frames into |dest| with possibly scaled
   // data from our |audio_buffer_|. Data is scaled based on the playback rate,
-  // using a variation of the Overlap-Add method to combine sample windows.
+  // using a variation of the WSOLA method to combine sample windows.
   //
   // Data from |audio_buffer_| is consumed in proportion to the playback rate.
   //
@@ -72,6 +73,11 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
   // read completes.
   void EnqueueBuffer(Buffer* buffer_in);
 
+  // Tells the algorithm that no more buffers will be enqueued until
+  // FlushBuffers(). The data left once it is too short for a whole window is
+  // then output at normal speed rather than dropped.
+  void MarkEndOfStream();
+
   float playback_rate() const { return playback_rate_; }
   void SetPlaybackRate(float new_rate);
 
@@ -100,52 +106,76 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
   bool is_muted() { return muted_; }
 
  private:
-  // Fills |dest| with one frame of audio data at normal speed. Returns true if
-  // a frame was rendered, false otherwise.
-  bool OutputNormalPlayback(uint8* dest);
-
-  // Fills |dest| with one frame of audio data at faster than normal speed.
-  // Returns true if a frame was rendered, false otherwise.
-  //
-  // When the audio playback is > 1.0, we use a variant of Overlap-Add to squish
+  // Each of the Output*Playback() methods renders up to |requested_frames|
+  // frames into |dest| and stores the number of frames written in
+  // |frames_written|, which may be zero if the call only consumed input to
+  // finish the current window. Returns false if more data is needed.
+  bool OutputNormalPlayback(uint8* dest, int requested_frames,
+                            int* frames_written);
+
+  // When the audio playback is > 1.0, we use a variant of WSOLA to squish
   // audio output while preserving pitch. Essentially, we play a bit of audio
   // data at normal speed, then we "fast forward" by dropping the next bit of
   // audio data, and then we stich the pieces together by crossfading from one
-  // audio chunk to the next.
-  bool OutputFasterPlayback(uint8* dest);
-
-  // Fills |dest| with one frame of audio data at slower than normal speed.
-  // Returns true if a frame was rendered, false otherwise.
-  //
-  // When the audio playback is < 1.0, we use a variant of Overlap-Add to
-  // stretch audio output while preserving pitch. This works by outputting a
-  // segment of audio data at normal speed. The next audio segment then starts
-  // by repeating some of the audio data from the previous audio segment.
-  // Segments are stiched together by crossfading from one audio chunk to the
-  // next.
-  bool OutputSlowerPlayback(uint8* dest);
+  // audio chunk to the next. The exact amount of data dropped is picked so
+  // that the chunks are as similar as possible where they overlap.
+  bool OutputFasterPlayback(uint8* dest, int requested_frames,
+                            int* frames_written);
+
+  // When the audio playback is < 1.0, we use a variant of WSOLA to stretch
+  // audio output while preserving pitch. This works by outputting a segment of
+  // audio data at normal speed. The next audio segment then starts by
+  // repeating some of the audio data from the previous audio segment, picked
+  // so that the segments are as similar as possible where they are
+  // crossfaded.
+  bool OutputSlowerPlayback(uint8* dest, int requested_frames,
+                            int* frames_written);
 
   // Resets the window state to the start of a new window.
   void ResetWindow();
 
-  // Copies a raw frame from |audio_buffer_| into |dest| without progressing
-  // |audio_buffer_|'s internal "current" cursor. Optionally peeks at a forward
-  // byte |offset|.
-  void CopyWithoutAdvance(uint8* dest);
-  void CopyWithoutAdvance(uint8* dest, int offset);
-
-  // Copies a raw frame from |audio_buffer_| into |dest| and progresses the
-  // |audio_buffer_| forward.
-  void CopyWithAdvance(uint8* dest);
-
-  // Moves the |audio_buffer_| forward by one frame.
-  void DropFrame();
-
-  // Does a linear crossfade from |intro| into |outtro| for one frame.
-  // Assumes pointers are valid and are at least size of |bytes_per_frame_|.
-  void OutputCrossfadedFrame(uint8* outtro, const uint8* intro);
+  // Copies |frames| raw frames from |audio_buffer_| into |dest| without
+  // progressing |audio_buffer_|'s internal "current" cursor. Optionally peeks
+  // at a forward byte |offset|.
+  void CopyWithoutAdvance(uint8* dest, int offset, int frames);
+
+  // Copies |frames| raw frames from |audio_buffer_| into |dest| and progresses
+  // the |audio_buffer_| forward.
+  void CopyWithAdvance(uint8* dest, int frames);
+
+  // Moves the |audio_buffer_| forward by |frames| frames.
+  void DropFrames(int frames);
+
+  // Returns the number of whole frames in |audio_buffer_|.
+  int FramesBuffered();
+
+  // Returns the number of bytes of input a window may look at before it is
+  // done, which is at most a window plus the similarity search after it.
+  int BytesNeededForWindow();
+
+  // Returns the frame offset, between 0 and |max_offset|, at which the data in
+  // |audio_buffer_| best matches the |target_frames| frames in |target|.
+  // Offsets close to |nominal_offset| minus the accumulated |wsola_drift_| are
+  // preferred so that the playback rate stays accurate over time, and
+  // |wsola_drift_| is updated with the deviation of the chosen offset.
+  // |audio_buffer_| must hold at least |target_frames + max_offset| frames.
+  int FindBestMatch(const uint8* target, int target_frames, int max_offset,
+                    int nominal_offset);
+
+  // Converts |samples| interleaved samples of the stream's format to floats.
+  void ConvertToFloat(const uint8* source, float* dest, int samples);
+
+  // Fills |crossfade_ramp_| for a crossfade of |bytes_to_crossfade| bytes.
+  void PrepareCrossfadeRamp(int bytes_to_crossfade);
+
+  // Crossfades |frames| frames from |outtro| into |intro|, writing the result
+  // into |dest|, which may alias either input. |crossfade_offset| is the byte
+  // offset of the first frame within the crossfade.
+  void CrossfadeFrames(const uint8* outtro, const uint8* intro, uint8* dest,
+                       int crossfade_offset, int frames);
   template <class Type>
-  void CrossfadeFrame(uint8* outtro, const uint8* intro);
+  void CrossfadeSamples(const Type* outtro, const Type* intro, Type* dest,
+                        const float* ramp, int samples);
 
   // Rounds |*value| down to the nearest frame boundary.
   void AlignToFrameBoundary(int* value);
@@ -179,17 +209,45 @@ class MEDIA_EXPORT AudioRendererAlgorithm {
   // Indexed by byte.
   int index_into_window_;
 
-  // The frame number in the crossfade.
-  int crossfade_frame_number_;
-
   // True if the audio should be muted.
   bool muted_;
 
   bool needs_more_data_;
 
+  // True once MarkEndOfStream() has been called.
+  bool end_of_stream_;
+
   // Temporary buffer to hold crossfade data.
   scoped_array<uint8> crossfade_buffer_;
 
+  // Crossfade weight of |intro| for every sample of the crossfade, and the
+  // length in bytes of the crossfade it was computed for.
+  scoped_array<float> crossfade_ramp_;
+  int bytes_in_ramp_;
+
+  // Length of the similarity search on either side of the nominal splice
+  // point, in bytes.
+  int bytes_in_search_;
+
+  // Scratch buffers for the similarity search.
+  scoped_array<uint8> search_buffer_;
+  scoped_array<float> search_samples_;
+  scoped_array<float> target_samples_;
+
+  // Bytes of input consumed beyond the nominal amount because of the
+  // similarity search. Kept close to zero so that the playback rate does not
+  // drift.
+  int wsola_drift_;
+
+  // Offset of the intro chosen for the current window when playing slower
+  // than normal, in bytes past the window's input step, or -1 if it has not
+  // been chosen yet.
+  int wsola_offset_;
+
+  DotProductProc dot_product_proc_;
+  ConvertInt16ToFloatProc convert_int16_to_float_proc_;
+  CrossfadeInt16Proc crossfade_int16_proc_;
+
   // Window size, in bytes (calculated from audio properties).
   int window_size_;
 
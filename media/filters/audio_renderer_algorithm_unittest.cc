@@ -26,7 +26,8 @@ namespace media {
 class AudioRendererAlgorithmTest : public testing::Test {
  public:
   AudioRendererAlgorithmTest()
-      : bytes_enqueued_(0) {
+      : bytes_enqueued_(0),
+        enqueue_on_read_(true) {
   }
 
   ~AudioRendererAlgorithmTest() {}
@@ -38,11 +39,16 @@ class AudioRendererAlgorithmTest : public testing::Test {
   void Initialize(int channels, int bits_per_channel) {
     algorithm_.Initialize(
         channels, kSamplesPerSecond, bits_per_channel, 1.0f,
-        base::Bind(&AudioRendererAlgorithmTest::EnqueueData,
+        base::Bind(&AudioRendererAlgorithmTest::OnReadRequested,
                    base::Unretained(this)));
     EnqueueData();
   }
 
+  void OnReadRequested() {
+    if (enqueue_on_read_)
+      EnqueueData();
+  }
+
   void EnqueueData() {
     scoped_array<uint8> audio_data(new uint8[kRawDataSize]);
     CHECK_EQ(kRawDataSize % algorithm_.bytes_per_channel(), 0u);
@@ -178,9 +184,72 @@ class AudioRendererAlgorithmTest : public testing::Test {
     EXPECT_LE(delta, kMaxAcceptableDelta);
   }
 
+  // Plays at |playback_rate| the way AudioRendererImpl does, filling the
+  // queue only up to its capacity and calling FillBuffer() only while
+  // CanFillBuffer() returns true, which must then always output something.
+  void TestFillBufferFromQueue(double playback_rate) {
+    static const int kBufferSizeInFrames = 512;
+    static const int kRefills = 20;
+
+    enqueue_on_read_ = false;
+    algorithm_.SetPlaybackRate(static_cast<float>(playback_rate));
+    scoped_array<uint8> buffer(
+        new uint8[kBufferSizeInFrames * algorithm_.bytes_per_frame()]);
+    int initial_bytes_enqueued = bytes_enqueued_;
+    int initial_bytes_buffered = algorithm_.bytes_buffered();
+
+    int total_frames_written = 0;
+    for (int i = 0; i < kRefills; ++i) {
+      while (!algorithm_.IsQueueFull())
+        EnqueueData();
+      ASSERT_TRUE(algorithm_.CanFillBuffer());
+
+      while (algorithm_.CanFillBuffer()) {
+        int frames_written =
+            algorithm_.FillBuffer(buffer.get(), kBufferSizeInFrames);
+        ASSERT_GT(frames_written, 0);
+        CheckFakeData(buffer.get(), frames_written, playback_rate);
+        total_frames_written += frames_written;
+      }
+    }
+
+    // Everything enqueued but the lookahead left in the queue was played.
+    int bytes_played = (bytes_enqueued_ - initial_bytes_enqueued) -
+        (algorithm_.bytes_buffered() - initial_bytes_buffered);
+    double expected_frames =
+        bytes_played / algorithm_.bytes_per_frame() / playback_rate;
+    EXPECT_NEAR(1.0, total_frames_written / expected_frames, 0.05);
+  }
+
+  // Plays the queue out after the end of the stream, and checks that every
+  // frame enqueued was consumed.
+  void TestPlayOutAtEndOfStream(double playback_rate) {
+    static const int kBufferSizeInFrames = 512;
+
+    enqueue_on_read_ = false;
+    algorithm_.SetPlaybackRate(static_cast<float>(playback_rate));
+    while (!algorithm_.IsQueueFull())
+      EnqueueData();
+    algorithm_.MarkEndOfStream();
+
+    scoped_array<uint8> buffer(
+        new uint8[kBufferSizeInFrames * algorithm_.bytes_per_frame()]);
+    while (algorithm_.CanFillBuffer()) {
+      int frames_written =
+          algorithm_.FillBuffer(buffer.get(), kBufferSizeInFrames);
+      ASSERT_GT(frames_written, 0);
+    }
+    EXPECT_EQ(0, algorithm_.bytes_buffered());
+
+    algorithm_.FlushBuffers();
+  }
+
  protected:
   AudioRendererAlgorithm algorithm_;
   int bytes_enqueued_;
+
+  // Whether read requests from |algorithm_| are fulfilled right away.
+  bool enqueue_on_read_;
 };
 
 TEST_F(AudioRendererAlgorithmTest, FillBuffer_NormalRate) {
@@ -284,4 +353,41 @@ TEST_F(AudioRendererAlgorithmTest, FillBuffer_HigherQualityAudio) {
   TestPlaybackRate(1.5);
 }
 
+TEST_F(AudioRendererAlgorithmTest, FillBuffer_FasterFromQueue) {
+  Initialize();
+  TestFillBufferFromQueue(1.25);
+  TestFillBufferFromQueue(2.0);
+  TestFillBufferFromQueue(3.5);
+}
+
+TEST_F(AudioRendererAlgorithmTest, FillBuffer_SlowerFromQueue) {
+  Initialize();
+  TestFillBufferFromQueue(0.9);
+  TestFillBufferFromQueue(0.5);
+}
+
+TEST_F(AudioRendererAlgorithmTest, FillBuffer_MutedFromQueue) {
+  Initialize();
+  TestFillBufferFromQueue(8.0);
+  TestFillBufferFromQueue(0.25);
+}
+
+// A window of 8 channel, 32 bit audio is bigger than the starting capacity of
+// the queue.
+TEST_F(AudioRendererAlgorithmTest, FillBuffer_WindowLargerThanQueue) {
+  static const int kChannels = 8;
+  static const int kSampleBits = 32;
+  Initialize(kChannels, kSampleBits);
+  TestFillBufferFromQueue(2.0);
+  TestFillBufferFromQueue(0.5);
+}
+
+TEST_F(AudioRendererAlgorithmTest, FillBuffer_PlaysOutAtEndOfStream) {
+  Initialize();
+  TestPlayOutAtEndOfStream(1.0);
+  TestPlayOutAtEndOfStream(2.0);
+  TestPlayOutAtEndOfStream(0.5);
+  TestPlayOutAtEndOfStream(8.0);
+}
+
 }  // namespace media
@@ -237,6 +237,8 @@ void AudioRendererImpl::DecodedAudioReady(scoped_refptr<Buffer> buffer) {
 
   if (buffer && buffer->IsEndOfStream()) {
     received_end_of_stream_ = true;
+    if (algorithm_.get())
+      algorithm_->MarkEndOfStream();
 
     // Transition to kPlaying if we are currently handling an underflow since
     // no more data will be arriving.
@@ -17,6 +17,7 @@ namespace media {
 class SourceBufferRange {
  public:
   typedef std::deque<scoped_refptr<StreamParserBuffer> > BufferQueue;
+  typedef std::map<base::TimeDelta, int> KeyframeMap;
 
   SourceBufferRange();
 
@@ -46,13 +47,13 @@ class SourceBufferRange {
   // Returns the Timespan of buffered time in this range.
   SourceBufferStream::Timespan GetBufferedTime() const;
 
-  // Appends the buffers from |range| into this range.
+  // Moves the buffers from |range| into this range, leaving |range| empty.
   // The first buffer in |range| must come directly after the last buffer
-  // in this range.
+  // in this range. The cost is proportional to the size of the smaller of
+  // the two ranges.
   // If |transfer_current_position| is true, |range|'s |next_buffer_position_|
   // is transfered to this SourceBufferRange.
-  void AppendToEnd(const SourceBufferRange& range,
-                   bool transfer_current_position);
+  void AppendToEnd(SourceBufferRange* range, bool transfer_current_position);
   bool CanAppendToEnd(const SourceBufferRange& range) const;
   bool CanAppendToEnd(const BufferQueue& buffers) const;
 
@@ -88,6 +89,14 @@ class SourceBufferRange {
   // range.
   void AppendToEnd(const BufferQueue& buffers);
 
+  // Adds |buffers| in front of the first buffer of the range and updates
+  // |keyframe_map_|. Assumes the last buffer of |buffers| directly precedes
+  // the range.
+  void PrependToStart(const BufferQueue& buffers);
+
+  // Returns the index in |buffers_| of the keyframe pointed to by |itr|.
+  int GetKeyframeIndex(const KeyframeMap::const_iterator& itr) const;
+
   // Returns the start timestamp of the range, or kNoTimestamp if the range is
   // empty.
   base::TimeDelta BufferedStart() const;
@@ -100,9 +109,12 @@ class SourceBufferRange {
   // An ordered list of buffers in this range.
   BufferQueue buffers_;
 
-  // Maps keyframe timestamps to its index position in |buffers_|.
-  typedef std::map<base::TimeDelta, size_t> KeyframeMap;
+  // Maps keyframe timestamps to their position in |buffers_|. The index of a
+  // keyframe in |buffers_| is its position minus |keyframe_map_index_base_|,
+  // so buffers can be added to the front of the range without renumbering
+  // every keyframe.
   KeyframeMap keyframe_map_;
+  int keyframe_map_index_base_;
 
   // Index into |buffers_| for the next buffer to be returned by
   // GetBufferedTime(), set to -1 before Seek().
@@ -113,14 +125,17 @@ class SourceBufferRange {
 
 }  // namespace media
 
-// Helper method that returns true if |ranges| is sorted in increasing order,
-// false otherwise.
-static bool IsRangeListSorted(
-    const std::list<media::SourceBufferRange*>& ranges) {
+// Helper method that returns true if |ranges| do not overlap and each range is
+// keyed by its start timestamp, false otherwise.
+static bool IsRangeMapValid(
+    const std::map<base::TimeDelta, media::SourceBufferRange*>& ranges) {
   base::TimeDelta prev = media::kNoTimestamp();
-  for (std::list<media::SourceBufferRange*>::const_iterator itr =
-       ranges.begin(); itr != ranges.end(); itr++) {
-    media::SourceBufferStream::Timespan buffered = (*itr)->GetBufferedTime();
+  for (std::map<base::TimeDelta, media::SourceBufferRange*>::const_iterator
+       itr = ranges.begin(); itr != ranges.end(); itr++) {
+    media::SourceBufferStream::Timespan buffered =
+        itr->second->GetBufferedTime();
+    if (itr->first != buffered.first)
+      return false;
     if (prev != media::kNoTimestamp() && prev >= buffered.first)
       return false;
     prev = buffered.second;
@@ -183,10 +198,8 @@ SourceBufferStream::SourceBufferStream(const VideoDecoderConfig& video_config)
 }
 
 SourceBufferStream::~SourceBufferStream() {
-  while (!ranges_.empty()) {
-    delete ranges_.front();
-    ranges_.pop_front();
-  }
+  for (RangeMap::iterator itr = ranges_.begin(); itr != ranges_.end(); itr++)
+    delete itr->second;
 }
 
 bool SourceBufferStream::Append(
@@ -202,71 +215,73 @@ bool SourceBufferStream::Append(
     return false;
   }
 
-  SourceBufferRange* range = NULL;
-  RangeList::iterator itr = ranges_.end();
   base::TimeDelta start_timestamp = buffers.front()->GetTimestamp();
-  for (itr = ranges_.begin(); itr != ranges_.end(); itr++) {
-    int range_value = (*itr)->BelongsToRange(start_timestamp);
-
-    // |start_timestamp| is before the current range in this loop. Because
-    // |ranges_| is sorted, this means that we need to create a new range and it
-    // should be placed before |itr|.
-    // TODO(vrk): We also break out of the loop if |buffers| completely overlaps
-    // the current range. This is to cover the case when |buffers| belongs to
-    // the current range, but also completely overlaps it. This should be
-    // removed when start overlap is handled properly.
-    if (range_value < 0 || (*itr)->IsCompletelyOverlappedBy(buffers))
-      break;
-
-    if (range_value == 0) {
-      // Found an existing range into which we can append buffers.
-      range = *itr;
-
-      if (range->CanAppendToEnd(buffers) && waiting_for_keyframe_) {
-        // Currently we do not support the case where the next buffer after the
-        // buffers in the track buffer is not a keyframe.
-        if (!buffers.front()->IsKeyframe())
-          return false;
-        waiting_for_keyframe_ = false;
+
+  // |itr| is the first range that starts after |start_timestamp|. The only
+  // range |buffers| can belong to is the one before it.
+  RangeMap::iterator itr = ranges_.upper_bound(start_timestamp);
+  SourceBufferRange* range = NULL;
+  if (itr != ranges_.begin()) {
+    RangeMap::iterator prev_itr = itr;
+    prev_itr--;
+    if (prev_itr->second->BelongsToRange(start_timestamp) == 0) {
+      // TODO(vrk): If |buffers| completely overlaps the range it belongs to, a
+      // new range is created in its place. This is to cover the case when
+      // |buffers| belongs to the range, but also completely overlaps it. This
+      // should be removed when start overlap is handled properly.
+      if (prev_itr->second->IsCompletelyOverlappedBy(buffers)) {
+        itr = prev_itr;
+      } else {
+        // Found an existing range into which we can append buffers.
+        range = prev_itr->second;
+
+        if (range->CanAppendToEnd(buffers) && waiting_for_keyframe_) {
+          // Currently we do not support the case where the next buffer after
+          // the buffers in the track buffer is not a keyframe.
+          if (!buffers.front()->IsKeyframe())
+            return false;
+          waiting_for_keyframe_ = false;
+        }
       }
-      break;
     }
   }
 
-  if (!range) {
+  bool is_new_range = !range;
+  if (is_new_range) {
     // Ranges must begin with a keyframe.
     if (!buffers.front()->IsKeyframe())
       return false;
 
     range = new SourceBufferRange();
-    itr = ranges_.insert(itr, range);
   }
 
-  // Append buffers to the appropriate range.
+  // Append buffers to the appropriate range. This does not change the start
+  // timestamp of an existing range, so its key in |ranges_| stays valid.
   range->Append(buffers);
 
-  // Increment |itr| to be the range after |range|.
-  itr++;
-
-  // Resolve overlaps.
+  // Resolve overlaps. |itr| is the range after |range|. A new range is only
+  // added to |ranges_| afterwards because it may replace a range that starts
+  // at the same timestamp.
   itr = ResolveCompleteOverlaps(itr, range);
   itr = ResolveEndOverlaps(itr, range);
+  if (is_new_range)
+    ranges_.insert(itr, std::make_pair(start_timestamp, range));
   MergeWithAdjacentRangeIfNecessary(itr, range);
 
   // Finally, try to complete pending seek if one exists.
   if (seek_pending_)
     Seek(seek_buffer_timestamp_);
 
-  DCHECK(IsRangeListSorted(ranges_));
+  DCHECK(IsRangeMapValid(ranges_));
   return true;
 }
 
-SourceBufferStream::RangeList::iterator
+SourceBufferStream::RangeMap::iterator
 SourceBufferStream::ResolveCompleteOverlaps(
-    const RangeList::iterator& range_itr, SourceBufferRange* new_range) {
-  RangeList::iterator itr = range_itr;
-  while (itr != ranges_.end() && new_range->CompletelyOverlaps(**itr)) {
-    if (*itr == selected_range_) {
+    const RangeMap::iterator& range_itr, SourceBufferRange* new_range) {
+  RangeMap::iterator itr = range_itr;
+  while (itr != ranges_.end() && new_range->CompletelyOverlaps(*itr->second)) {
+    if (itr->second == selected_range_) {
       // Get the timestamp for the next buffer in the sequence.
       base::TimeDelta next_timestamp = selected_range_->GetNextTimestamp();
       // Then seek to the next keyframe after (or equal to) |next_timestamp|.
@@ -292,35 +307,35 @@ SourceBufferStream::ResolveCompleteOverlaps(
 
       selected_range_ = new_range;
     }
-    delete *itr;
-    itr = ranges_.erase(itr);
+    delete itr->second;
+    ranges_.erase(itr++);
   }
   return itr;
 }
 
-SourceBufferStream::RangeList::iterator
+SourceBufferStream::RangeMap::iterator
 SourceBufferStream::ResolveEndOverlaps(
-    const RangeList::iterator& range_itr, SourceBufferRange* new_range) {
-  RangeList::iterator itr = range_itr;
-  while (itr != ranges_.end() && new_range->EndOverlaps(**itr)) {
-    DCHECK_NE(*itr, selected_range_);
-    delete *itr;
-    itr = ranges_.erase(itr);
+    const RangeMap::iterator& range_itr, SourceBufferRange* new_range) {
+  RangeMap::iterator itr = range_itr;
+  while (itr != ranges_.end() && new_range->EndOverlaps(*itr->second)) {
+    DCHECK_NE(itr->second, selected_range_);
+    delete itr->second;
+    ranges_.erase(itr++);
   }
   return itr;
 }
 
 void SourceBufferStream::MergeWithAdjacentRangeIfNecessary(
-    const RangeList::iterator& itr, SourceBufferRange* new_range) {
-  if (itr != ranges_.end() && new_range->CanAppendToEnd(**itr)) {
-    bool transfer_current_position = selected_range_ == *itr;
-    new_range->AppendToEnd(**itr, transfer_current_position);
+    const RangeMap::iterator& itr, SourceBufferRange* new_range) {
+  if (itr != ranges_.end() && new_range->CanAppendToEnd(*itr->second)) {
+    bool transfer_current_position = selected_range_ == itr->second;
+    new_range->AppendToEnd(itr->second, transfer_current_position);
     // Update |selected_range_| pointer if |range| has become selected after
     // merges.
     if (transfer_current_position)
       selected_range_ = new_range;
 
-    delete *itr;
+    delete itr->second;
     ranges_.erase(itr);
   }
 }
@@ -333,16 +348,16 @@ void SourceBufferStream::Seek(base::TimeDelta timestamp) {
   seek_buffer_timestamp_ = timestamp;
   seek_pending_ = true;
 
-  RangeList::iterator itr = ranges_.end();
-  for (itr = ranges_.begin(); itr != ranges_.end(); itr++) {
-    if ((*itr)->CanSeekTo(timestamp))
-      break;
-  }
+  // Only the last range that starts at or before |timestamp| can contain it.
+  RangeMap::iterator itr = ranges_.upper_bound(timestamp);
+  if (itr == ranges_.begin())
+    return;
+  itr--;
 
-  if (itr == ranges_.end())
+  if (!itr->second->CanSeekTo(timestamp))
     return;
 
-  selected_range_ = *itr;
+  selected_range_ = itr->second;
   selected_range_->Seek(timestamp);
   seek_pending_ = false;
   end_of_stream_ = false;
@@ -372,9 +387,9 @@ bool SourceBufferStream::GetNextBuffer(
 std::list<SourceBufferStream::Timespan>
 SourceBufferStream::GetBufferedTime() const {
   std::list<Timespan> timespans;
-  for (RangeList::const_iterator itr = ranges_.begin();
+  for (RangeMap::const_iterator itr = ranges_.begin();
        itr != ranges_.end(); itr++) {
-    timespans.push_back((*itr)->GetBufferedTime());
+    timespans.push_back(itr->second->GetBufferedTime());
   }
   return timespans;
 }
@@ -385,11 +400,12 @@ void SourceBufferStream::EndOfStream() {
 }
 
 bool SourceBufferStream::CanEndOfStream() const {
-  return ranges_.empty() || selected_range_ == ranges_.back();
+  return ranges_.empty() || selected_range_ == ranges_.rbegin()->second;
 }
 
 SourceBufferRange::SourceBufferRange()
-    : next_buffer_index_(-1) {
+    : keyframe_map_index_base_(0),
+      next_buffer_index_(-1) {
 }
 
 void SourceBufferRange::Append(const BufferQueue& new_buffers) {
@@ -403,8 +419,11 @@ void SourceBufferRange::Append(const BufferQueue& new_buffers) {
                          new_buffers.front(),
                          BufferComparator);
 
-    // Remove everything from |starting_point| onward.
+    // Remove everything from |starting_point| onward, along with the
+    // keyframes that pointed into the removed buffers.
     buffers_.erase(starting_point, buffers_.end());
+    keyframe_map_.erase(keyframe_map_.lower_bound(start_timestamp),
+                        keyframe_map_.end());
   }
 
   // Append data.
@@ -417,13 +436,34 @@ void SourceBufferRange::AppendToEnd(const BufferQueue& new_buffers) {
     DCHECK((*itr)->GetDuration() > base::TimeDelta());
     DCHECK((*itr)->GetTimestamp() != kNoTimestamp());
     buffers_.push_back(*itr);
+    if ((*itr)->IsKeyframe()) {
+      keyframe_map_.insert(std::make_pair(
+          (*itr)->GetTimestamp(),
+          static_cast<int>(buffers_.size()) - 1 + keyframe_map_index_base_));
+    }
+  }
+}
+
+void SourceBufferRange::PrependToStart(const BufferQueue& new_buffers) {
+  for (BufferQueue::const_reverse_iterator itr = new_buffers.rbegin();
+       itr != new_buffers.rend(); itr++) {
+    DCHECK((*itr)->GetDuration() > base::TimeDelta());
+    DCHECK((*itr)->GetTimestamp() != kNoTimestamp());
+    buffers_.push_front(*itr);
+    // Every index goes up by one, which is the same as lowering the base.
+    keyframe_map_index_base_--;
     if ((*itr)->IsKeyframe()) {
       keyframe_map_.insert(
-          std::make_pair((*itr)->GetTimestamp(), buffers_.size() - 1));
+          std::make_pair((*itr)->GetTimestamp(), keyframe_map_index_base_));
     }
   }
 }
 
+int SourceBufferRange::GetKeyframeIndex(
+    const KeyframeMap::const_iterator& itr) const {
+  return itr->second - keyframe_map_index_base_;
+}
+
 void SourceBufferRange::Seek(base::TimeDelta timestamp) {
   DCHECK(CanSeekTo(timestamp));
   DCHECK(!keyframe_map_.empty());
@@ -436,7 +476,7 @@ void SourceBufferRange::Seek(base::TimeDelta timestamp) {
     DCHECK(result != keyframe_map_.begin());
     result--;
   }
-  next_buffer_index_ = result->second;
+  next_buffer_index_ = GetKeyframeIndex(result);
   DCHECK_LT(next_buffer_index_, static_cast<int>(buffers_.size()));
 }
 
@@ -455,7 +495,7 @@ base::TimeDelta SourceBufferRange::SeekAfter(base::TimeDelta timestamp) {
     return kNoTimestamp();
   }
 
-  next_buffer_index_ = result->second;
+  next_buffer_index_ = GetKeyframeIndex(result);
   DCHECK_LT(next_buffer_index_, static_cast<int>(buffers_.size()));
   return result->first;
 }
@@ -491,15 +531,30 @@ SourceBufferRange::GetBufferedTime() const {
   return std::make_pair(BufferedStart(), BufferedEnd());
 }
 
-void SourceBufferRange::AppendToEnd(const SourceBufferRange& range,
+void SourceBufferRange::AppendToEnd(SourceBufferRange* range,
                                     bool transfer_current_position) {
-  DCHECK(CanAppendToEnd(range));
+  DCHECK(CanAppendToEnd(*range));
   DCHECK(!buffers_.empty());
 
   if (transfer_current_position)
-    next_buffer_index_ = range.next_buffer_index_ + buffers_.size();
+    next_buffer_index_ = range->next_buffer_index_ + buffers_.size();
+
+  if (buffers_.size() >= range->buffers_.size()) {
+    AppendToEnd(range->buffers_);
+  } else {
+    // Filling the gap in front of a long range is common when media is
+    // appended out of order. Take over the buffers of |range| and add ours
+    // in front of them instead of copying the long range.
+    buffers_.swap(range->buffers_);
+    keyframe_map_.swap(range->keyframe_map_);
+    std::swap(keyframe_map_index_base_, range->keyframe_map_index_base_);
+    PrependToStart(range->buffers_);
+  }
 
-  AppendToEnd(range.buffers_);
+  range->buffers_.clear();
+  range->keyframe_map_.clear();
+  range->keyframe_map_index_base_ = 0;
+  range->next_buffer_index_ = -1;
 }
 
 bool SourceBufferRange::CanAppendToEnd(const SourceBufferRange& range) const {
@@ -7,6 +7,7 @@
 
 #include <deque>
 #include <list>
+#include <map>
 #include <utility>
 
 #include "base/memory/ref_counted.h"
@@ -82,25 +83,31 @@ class MEDIA_EXPORT SourceBufferStream {
   }
 
  private:
-  typedef std::list<SourceBufferRange*> RangeList;
+  // Maps the start timestamp of each range to the range. Ranges never
+  // overlap, so they are ordered by their end timestamps as well and the only
+  // range that can contain a given timestamp is the last one that starts at
+  // or before it. This makes finding the range for an Append() or a Seek()
+  // logarithmic in the number of ranges.
+  typedef std::map<base::TimeDelta, SourceBufferRange*> RangeMap;
 
   // Resolve overlapping ranges such that no ranges overlap anymore.
   // |range_itr| points to the iterator in |ranges_| immediately after
   // |new_range|. Returns the iterator in |ranges_| immediately after
   // |new_range|, which may be different from the original |range_itr|.
-  RangeList::iterator ResolveCompleteOverlaps(
-      const RangeList::iterator& range_itr, SourceBufferRange* new_range);
-  RangeList::iterator ResolveEndOverlaps(
-      const RangeList::iterator& range_itr, SourceBufferRange* new_range);
+  // |new_range| itself may not have been added to |ranges_| yet.
+  RangeMap::iterator ResolveCompleteOverlaps(
+      const RangeMap::iterator& range_itr, SourceBufferRange* new_range);
+  RangeMap::iterator ResolveEndOverlaps(
+      const RangeMap::iterator& range_itr, SourceBufferRange* new_range);
 
   // Checks to see if the range pointed to by |range_itr| can be appended to the
   // end of |new_range|, and if so, appends the range and updates |ranges_| to
   // reflect this.
   void MergeWithAdjacentRangeIfNecessary(
-      const RangeList::iterator& range_itr, SourceBufferRange* new_range);
+      const RangeMap::iterator& range_itr, SourceBufferRange* new_range);
 
-  // List of disjoint buffered ranges, ordered by start time.
-  RangeList ranges_;
+  // Disjoint buffered ranges, ordered by start time.
+  RangeMap ranges_;
 
   AudioDecoderConfig audio_config_;
   VideoDecoderConfig video_config_;
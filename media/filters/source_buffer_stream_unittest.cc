@@ -218,6 +218,53 @@ TEST_F(SourceBufferStreamTest, Append_AdjacentRanges) {
   CheckExpectedBuffers(0, 25);
 }
 
+TEST_F(SourceBufferStreamTest, Append_AdjacentRanges_ReverseOrder) {
+  // Append 10 buffers at a time from position 90 down to position 0. Each
+  // append fills the gap in front of the existing range, so the short new
+  // range takes over the buffers of the long one.
+  for (int position = 90; position >= 0; position -= 10)
+    AppendBuffers(position, 10);
+
+  SourceBufferStream::TimespanList expected;
+  expected.push_back(CreateTimespan(0, 99));
+  CheckExpectedTimespans(expected);
+
+  // Seeks must find the keyframes of both the prepended and original buffers.
+  Seek(0);
+  CheckExpectedBuffers(0, 99, true);
+  Seek(47);
+  CheckExpectedBuffers(45, 99, true);
+  Seek(93);
+  CheckExpectedBuffers(90, 99, true);
+}
+
+TEST_F(SourceBufferStreamTest, Append_ManyDisjointRanges) {
+  // Append 5 buffers every 10 positions to create 50 separate ranges.
+  const int kRanges = 50;
+  for (int i = 0; i < kRanges; i++)
+    AppendBuffers(i * 10, 5);
+
+  SourceBufferStream::TimespanList expected;
+  for (int i = 0; i < kRanges; i++)
+    expected.push_back(CreateTimespan(i * 10, i * 10 + 4));
+  CheckExpectedTimespans(expected);
+
+  // Seek into a range in the middle.
+  Seek(252);
+  CheckExpectedBuffers(250, 254, true);
+
+  // Seeking into a gap waits for data, and appending the gap merges the
+  // neighboring ranges.
+  Seek(257);
+  EXPECT_TRUE(stream_.IsSeekPending());
+  AppendBuffers(255, 5);
+  EXPECT_FALSE(stream_.IsSeekPending());
+  CheckExpectedBuffers(255, 264, true);
+
+  EXPECT_EQ(static_cast<size_t>(kRanges - 1),
+            stream_.GetBufferedTime().size());
+}
+
 TEST_F(SourceBufferStreamTest, Append_DoesNotBeginWithKeyframe) {
   // Append fails because the range doesn't begin with a keyframe.
   AppendBuffers_ExpectFailure(3, 5);
@@ -15,6 +15,8 @@
       'target_name': 'media',
       'type': '<(component)',
       'dependencies': [
+        'cpu_features',
+        'time_stretch_simd',
         'yuv_convert',
         '../base/base.gyp:base',
         '../base/third_party/dynamic_annotations/dynamic_annotations.gyp:dynamic_annotations',
@@ -473,6 +475,7 @@
       ],
       'dependencies': [
         'cpu_features',
+        '../base/base.gyp:base',
       ],
       'conditions': [
         ['order_profiling != 0', {
@@ -515,6 +518,7 @@
         'base/simd/convert_yuv_to_rgb_mmx.asm',
         'base/simd/convert_yuv_to_rgb_mmx.inc',
         'base/simd/convert_yuv_to_rgb_sse.asm',
+        'base/simd/convert_yuv_to_rgb_sse2.cc',
         'base/simd/filter_yuv.h',
         'base/simd/filter_yuv_c.cc',
         'base/simd/filter_yuv_mmx.cc',
@@ -611,6 +615,31 @@
         '../third_party/yasm/yasm_compile.gypi',
       ],
     },
+    {
+      'target_name': 'time_stretch_simd',
+      'type': 'static_library',
+      'include_dirs': [
+        '..',
+      ],
+      'sources': [
+        'base/simd/time_stretch.h',
+        'base/simd/time_stretch_c.cc',
+      ],
+      'conditions': [
+        [ 'target_arch == "ia32" or target_arch == "x64"', {
+          'sources': [
+            'base/simd/time_stretch_sse2.cc',
+          ],
+          'conditions': [
+            [ 'os_posix == 1 and OS != "mac" and OS != "android"', {
+              'cflags': [
+                '-msse2',
+              ],
+            }],
+          ],
+        }],
+      ],
+    },
     {
       'target_name': 'yuv_convert_simd_arm',
       'type': 'static_library',
@@ -661,6 +690,7 @@
         'audio/win/audio_low_latency_output_win_unittest.cc',
         'audio/win/audio_output_win_unittest.cc',
         'base/buffers_unittest.cc',
+        'base/byte_queue_unittest.cc',
         'base/clock_unittest.cc',
         'base/composite_filter_unittest.cc',
         'base/data_buffer_unittest.cc',
@@ -751,6 +781,7 @@
         [ 'target_arch=="ia32" or target_arch=="x64"', {
           'sources': [
             'base/simd/convert_rgb_to_yuv_unittest.cc',
+            'base/simd/time_stretch_unittest.cc',
           ],
         }],
       ],
@@ -792,6 +823,39 @@
         'tools/scaler_bench/scaler_bench.cc',
       ],
     },
+    {
+      'target_name': 'time_stretch_bench',
+      'type': 'executable',
+      'dependencies': [
+        'media',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'tools/time_stretch_bench/time_stretch_bench.cc',
+      ],
+    },
+    {
+      'target_name': 'source_buffer_stream_bench',
+      'type': 'executable',
+      'dependencies': [
+        'media',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'tools/source_buffer_stream_bench/source_buffer_stream_bench.cc',
+      ],
+    },
+    {
+      'target_name': 'webm_parse_bench',
+      'type': 'executable',
+      'dependencies': [
+        'media',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'tools/webm_parse_bench/webm_parse_bench.cc',
+      ],
+    },
     {
       'target_name': 'qt_faststart',
       'type': 'executable',
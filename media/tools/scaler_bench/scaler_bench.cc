@@ -4,7 +4,8 @@
 
 // This tool can be used to measure performace of video frame scaling
 // code. It times performance of the scaler with and without filtering.
-// It also measures performance of the Skia scaler for comparison.
+// It also measures performance of the Skia scaler for comparison, and how
+// sliced scaling scales with the number of threads.
 
 #include <iostream>
 #include <vector>
@@ -13,6 +14,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
 #include "base/string_number_conversions.h"
+#include "base/sys_info.h"
 #include "base/time.h"
 #include "media/base/video_frame.h"
 #include "media/base/yuv_convert.h"
@@ -28,6 +30,7 @@ static int dest_width = 1366;
 static int dest_height = 768;
 static int num_frames = 500;
 static int num_buffers = 50;
+static int max_threads = 0;
 
 static double BenchmarkSkia() {
   std::vector<scoped_refptr<VideoFrame> > source_frames;
@@ -152,6 +155,49 @@ static double BenchmarkFilter(media::ScaleFilter filter) {
   return static_cast<double>((end - start).InMilliseconds()) / num_frames;
 }
 
+// Returns frames per second for bilinear scaling split into |num_bands| bands,
+// one per thread.
+static double BenchmarkSliced(int num_bands) {
+  std::vector<scoped_refptr<VideoFrame> > source_frames;
+  std::vector<scoped_refptr<VideoFrame> > dest_frames;
+
+  for (int i = 0; i < num_buffers; i++) {
+    source_frames.push_back(
+        VideoFrame::CreateBlackFrame(source_width, source_height));
+
+    dest_frames.push_back(
+        VideoFrame::CreateFrame(VideoFrame::RGB32,
+                                dest_width,
+                                dest_height,
+                                TimeDelta::FromSeconds(0),
+                                TimeDelta::FromSeconds(0)));
+  }
+
+  TimeTicks start = TimeTicks::HighResNow();
+  for (int i = 0; i < num_frames; i++) {
+    scoped_refptr<VideoFrame> source_frame = source_frames[i % num_buffers];
+    scoped_refptr<VideoFrame> dest_frame = dest_frames[i % num_buffers];
+
+    media::ScaleYUVToRGB32Sliced(source_frame->data(VideoFrame::kYPlane),
+                                 source_frame->data(VideoFrame::kUPlane),
+                                 source_frame->data(VideoFrame::kVPlane),
+                                 dest_frame->data(0),
+                                 source_width,
+                                 source_height,
+                                 dest_width,
+                                 dest_height,
+                                 source_frame->stride(VideoFrame::kYPlane),
+                                 source_frame->stride(VideoFrame::kUPlane),
+                                 dest_frame->stride(0),
+                                 media::YV12,
+                                 media::ROTATE_0,
+                                 media::FILTER_BILINEAR,
+                                 num_bands);
+  }
+  TimeTicks end = TimeTicks::HighResNow();
+  return num_frames / (end - start).InSecondsF();
+}
+
 static double BenchmarkScaleWithRect() {
   std::vector<scoped_refptr<VideoFrame> > source_frames;
   std::vector<scoped_refptr<VideoFrame> > dest_frames;
@@ -211,6 +257,8 @@ int main(int argc, const char** argv) {
               << "Width of the destination image\n"
               << "  --dest-h=N                      "
               << "Height of the destination image\n"
+              << "  --threads=N                     "
+              << "Maximum number of threads for sliced scaling\n"
               << std::endl;
     return 1;
   }
@@ -251,6 +299,12 @@ int main(int argc, const char** argv) {
     num_buffers = 0;
   }
 
+  std::string threads_param(cmd_line->GetSwitchValueASCII("threads"));
+  if (threads_param.empty() ||
+      !base::StringToInt(threads_param, &max_threads)) {
+    max_threads = base::SysInfo::NumberOfProcessors();
+  }
+
   std::cout << "Source image size: " << source_width
             << "x" << source_height << std::endl;
   std::cout << "Destination image size: " << dest_width
@@ -274,6 +328,10 @@ int main(int argc, const char** argv) {
             << "ms/frame" << std::endl;
   std::cout << "Bilinear with rect: " << BenchmarkScaleWithRect()
             << "ms/frame" << std::endl;
+  for (int threads = 1; threads <= max_threads; ++threads) {
+    std::cout << "Bilinear sliced, " << threads << " thread(s): "
+              << BenchmarkSliced(threads) << " frames/s" << std::endl;
+  }
 
   return 0;
 }
@@ -0,0 +1,196 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This tool measures the performance of SourceBufferStream over long media
+// source sessions. It appends hours of synthetic video in small segments, in
+// order, in reverse order and with gaps that are filled in later, and times
+// appends and seeks.
+
+#include <iostream>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/rand_util.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "media/filters/source_buffer_stream.h"
+
+using base::TimeDelta;
+using base::TimeTicks;
+using media::SourceBufferStream;
+
+static int hours = 2;
+static int frames_per_second = 30;
+static int frames_per_keyframe = 15;
+static int frames_per_append = 15;
+static int num_seeks = 10000;
+
+// Returns the segments to append, in presentation order. The buffers are
+// created up front so that allocating them is not measured.
+static std::vector<SourceBufferStream::BufferQueue> CreateSegments() {
+  TimeDelta frame_duration = TimeDelta::FromMicroseconds(
+      base::Time::kMicrosecondsPerSecond / frames_per_second);
+  int total_frames = hours * 3600 * frames_per_second;
+  uint8 data = 0;
+
+  std::vector<SourceBufferStream::BufferQueue> segments;
+  for (int frame = 0; frame < total_frames; frame += frames_per_append) {
+    segments.push_back(SourceBufferStream::BufferQueue());
+    for (int i = frame;
+         i < frame + frames_per_append && i < total_frames; ++i) {
+      scoped_refptr<media::StreamParserBuffer> buffer =
+          media::StreamParserBuffer::CopyFrom(
+              &data, 1, i % frames_per_keyframe == 0);
+      buffer->SetTimestamp(frame_duration * i);
+      buffer->SetDuration(frame_duration);
+      segments.back().push_back(buffer);
+    }
+  }
+  return segments;
+}
+
+// Appends |segments| in the order given by |order| and returns the time taken
+// in milliseconds. Returns a negative value if an append is rejected.
+static double AppendSegments(
+    SourceBufferStream* stream,
+    const std::vector<SourceBufferStream::BufferQueue>& segments,
+    const std::vector<size_t>& order) {
+  TimeTicks start = TimeTicks::HighResNow();
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (!stream->Append(segments[order[i]]))
+      return -1;
+  }
+  return (TimeTicks::HighResNow() - start).InMillisecondsF();
+}
+
+// Seeks to random positions, reading one buffer after each seek, and returns
+// the average time per seek in microseconds.
+static double BenchmarkSeeks(SourceBufferStream* stream) {
+  int64 duration_us = static_cast<int64>(hours) * 3600 *
+      base::Time::kMicrosecondsPerSecond;
+  std::vector<TimeDelta> targets;
+  for (int i = 0; i < num_seeks; ++i) {
+    targets.push_back(TimeDelta::FromMicroseconds(
+        base::RandGenerator(duration_us)));
+  }
+
+  TimeTicks start = TimeTicks::HighResNow();
+  for (size_t i = 0; i < targets.size(); ++i) {
+    stream->Seek(targets[i]);
+    scoped_refptr<media::StreamParserBuffer> buffer;
+    stream->GetNextBuffer(&buffer);
+  }
+  return (TimeTicks::HighResNow() - start).InMicroseconds() /
+      static_cast<double>(num_seeks);
+}
+
+int main(int argc, const char** argv) {
+  CommandLine::Init(argc, argv);
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+
+  if (!cmd_line->GetArgs().empty()) {
+    std::cerr << "Usage: " << argv[0] << " [OPTIONS]\n"
+              << "  --hours=N                       "
+              << "Hours of media to append\n"
+              << "  --fps=N                         "
+              << "Frames per second\n"
+              << "  --keyframe-interval=N           "
+              << "Frames per keyframe\n"
+              << "  --append-frames=N               "
+              << "Frames per append, a multiple of the keyframe interval\n"
+              << "  --seeks=N                       "
+              << "Number of seeks to time\n"
+              << std::endl;
+    return 1;
+  }
+
+  std::string hours_param(cmd_line->GetSwitchValueASCII("hours"));
+  if (!hours_param.empty() && !base::StringToInt(hours_param, &hours))
+    hours = 0;
+
+  std::string fps_param(cmd_line->GetSwitchValueASCII("fps"));
+  if (!fps_param.empty() &&
+      !base::StringToInt(fps_param, &frames_per_second)) {
+    frames_per_second = 0;
+  }
+
+  std::string keyframe_param(
+      cmd_line->GetSwitchValueASCII("keyframe-interval"));
+  if (!keyframe_param.empty() &&
+      !base::StringToInt(keyframe_param, &frames_per_keyframe)) {
+    frames_per_keyframe = 0;
+  }
+
+  std::string append_param(cmd_line->GetSwitchValueASCII("append-frames"));
+  if (!append_param.empty() &&
+      !base::StringToInt(append_param, &frames_per_append)) {
+    frames_per_append = 0;
+  }
+
+  std::string seeks_param(cmd_line->GetSwitchValueASCII("seeks"));
+  if (!seeks_param.empty() && !base::StringToInt(seeks_param, &num_seeks))
+    num_seeks = 0;
+
+  // Every append must start with a keyframe so that segments can be appended
+  // out of order.
+  if (hours <= 0 || frames_per_second <= 0 || frames_per_keyframe <= 0 ||
+      frames_per_append <= 0 || num_seeks <= 0 ||
+      frames_per_append % frames_per_keyframe != 0) {
+    std::cerr << "Invalid configuration." << std::endl;
+    return 1;
+  }
+
+  std::cout << "Hours: " << hours << std::endl;
+  std::cout << "Frames per second: " << frames_per_second << std::endl;
+  std::cout << "Frames per keyframe: " << frames_per_keyframe << std::endl;
+  std::cout << "Frames per append: " << frames_per_append << std::endl;
+
+  std::vector<SourceBufferStream::BufferQueue> segments = CreateSegments();
+  size_t num_segments = segments.size();
+  std::cout << "Appends: " << num_segments << std::endl;
+
+  // In order.
+  std::vector<size_t> order;
+  for (size_t i = 0; i < num_segments; ++i)
+    order.push_back(i);
+  {
+    SourceBufferStream stream;
+    std::cout << "In order: " << AppendSegments(&stream, segments, order)
+              << "ms" << std::endl;
+    std::cout << "Seek in one range: " << BenchmarkSeeks(&stream)
+              << "us/seek" << std::endl;
+  }
+
+  // Reverse order, so that every append is merged with the range after it.
+  order.clear();
+  for (size_t i = num_segments; i > 0; --i)
+    order.push_back(i - 1);
+  {
+    SourceBufferStream stream;
+    std::cout << "Reverse order: " << AppendSegments(&stream, segments, order)
+              << "ms" << std::endl;
+  }
+
+  // Every other segment, which leaves a range per segment, then the gaps.
+  order.clear();
+  for (size_t i = 0; i < num_segments; i += 2)
+    order.push_back(i);
+  {
+    SourceBufferStream stream;
+    std::cout << "Every other segment: "
+              << AppendSegments(&stream, segments, order) << "ms, "
+              << stream.GetBufferedTime().size() << " ranges" << std::endl;
+    std::cout << "Seek across ranges: " << BenchmarkSeeks(&stream)
+              << "us/seek" << std::endl;
+
+    std::vector<size_t> gaps;
+    for (size_t i = 1; i < num_segments; i += 2)
+      gaps.push_back(i);
+    std::cout << "Fill gaps: " << AppendSegments(&stream, segments, gaps)
+              << "ms, " << stream.GetBufferedTime().size() << " ranges"
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This tool measures the performance of AudioRendererAlgorithm when playing
+// back at rates other than 1.0. It feeds synthetic audio through the algorithm
+// and reports the time spent per second of rendered audio.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "media/base/data_buffer.h"
+#include "media/filters/audio_renderer_algorithm.h"
+
+using base::TimeTicks;
+
+static int channels = 2;
+static int sample_rate = 44100;
+static int bits_per_channel = 16;
+static int seconds = 60;
+
+// Size of the buffers handed to the algorithm and of each FillBuffer() call,
+// roughly what the audio renderer uses.
+static const int kInputBufferBytes = 8192;
+static const int kFramesPerFill = 2048;
+
+static const double kTwoPi = 2 * 3.14159265358979323846;
+
+// Hands out a looping chord of sine tones so that the similarity search has
+// something realistic to work on. The audio is generated up front so that
+// producing it does not count towards the measured time.
+class AudioSource {
+ public:
+  explicit AudioSource(media::AudioRendererAlgorithm* algorithm)
+      : algorithm_(algorithm),
+        bytes_per_frame_(bits_per_channel / 8 * channels),
+        position_(0) {
+    int bytes_per_channel = bits_per_channel / 8;
+    frames_ = sample_rate;
+    data_.reset(new uint8[frames_ * bytes_per_frame_]);
+
+    for (int i = 0; i < frames_; ++i) {
+      double t = static_cast<double>(i) / sample_rate;
+      double value = 0.3 * sin(kTwoPi * 220 * t) +
+                     0.2 * sin(kTwoPi * 275 * t) +
+                     0.1 * sin(kTwoPi * 330 * t);
+      for (int channel = 0; channel < channels; ++channel) {
+        int index = i * channels + channel;
+        switch (bytes_per_channel) {
+          case 4:
+            reinterpret_cast<int32*>(data_.get())[index] =
+                static_cast<int32>(value * kint32max);
+            break;
+          case 2:
+            reinterpret_cast<int16*>(data_.get())[index] =
+                static_cast<int16>(value * kint16max);
+            break;
+          case 1:
+            data_[index] = static_cast<uint8>(128 + value * 127);
+            break;
+        }
+      }
+    }
+  }
+
+  // Enqueues the next chunk of audio. Used as the read callback.
+  void Read() {
+    int frames = std::min(kInputBufferBytes / bytes_per_frame_,
+                          frames_ - position_);
+    int bytes = frames * bytes_per_frame_;
+    scoped_array<uint8> buffer(new uint8[bytes]);
+    memcpy(buffer.get(), data_.get() + position_ * bytes_per_frame_, bytes);
+    position_ = (position_ + frames) % frames_;
+
+    algorithm_->EnqueueBuffer(new media::DataBuffer(buffer.Pass(), bytes));
+  }
+
+ private:
+  media::AudioRendererAlgorithm* algorithm_;
+  int bytes_per_frame_;
+
+  // One second of audio, which loops seamlessly since all the tones have a
+  // whole number of periods per second.
+  scoped_array<uint8> data_;
+  int frames_;
+  int position_;
+};
+
+// Returns the time in milliseconds spent rendering one second of audio at
+// |playback_rate|.
+static double BenchmarkPlaybackRate(float playback_rate) {
+  media::AudioRendererAlgorithm algorithm;
+  AudioSource source(&algorithm);
+  algorithm.Initialize(channels, sample_rate, bits_per_channel, playback_rate,
+                       base::Bind(&AudioSource::Read,
+                                  base::Unretained(&source)));
+  source.Read();
+
+  scoped_array<uint8> output(
+      new uint8[kFramesPerFill * algorithm.bytes_per_frame()]);
+  int64 frames_to_render = static_cast<int64>(seconds) * sample_rate;
+  int64 frames_rendered = 0;
+
+  TimeTicks start = TimeTicks::HighResNow();
+  while (frames_rendered < frames_to_render) {
+    int frames = algorithm.FillBuffer(output.get(), kFramesPerFill);
+    if (frames == 0) {
+      // The algorithm asks for more data through the read callback, but may
+      // need a bigger queue to hold a whole window.
+      algorithm.IncreaseQueueCapacity();
+      source.Read();
+      continue;
+    }
+    frames_rendered += frames;
+  }
+  TimeTicks end = TimeTicks::HighResNow();
+
+  return (end - start).InMillisecondsF() / seconds;
+}
+
+int main(int argc, const char** argv) {
+  CommandLine::Init(argc, argv);
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+
+  if (!cmd_line->GetArgs().empty()) {
+    std::cerr << "Usage: " << argv[0] << " [OPTIONS]\n"
+              << "  --channels=N                    "
+              << "Number of channels\n"
+              << "  --sample-rate=N                 "
+              << "Sample rate in Hz\n"
+              << "  --bits=N                        "
+              << "Bits per channel (8, 16 or 32)\n"
+              << "  --seconds=N                     "
+              << "Seconds of audio to render per playback rate\n"
+              << std::endl;
+    return 1;
+  }
+
+  std::string channels_param(cmd_line->GetSwitchValueASCII("channels"));
+  if (!channels_param.empty() &&
+      !base::StringToInt(channels_param, &channels)) {
+    channels = 0;
+  }
+
+  std::string sample_rate_param(cmd_line->GetSwitchValueASCII("sample-rate"));
+  if (!sample_rate_param.empty() &&
+      !base::StringToInt(sample_rate_param, &sample_rate)) {
+    sample_rate = 0;
+  }
+
+  std::string bits_param(cmd_line->GetSwitchValueASCII("bits"));
+  if (!bits_param.empty() &&
+      !base::StringToInt(bits_param, &bits_per_channel)) {
+    bits_per_channel = 0;
+  }
+
+  std::string seconds_param(cmd_line->GetSwitchValueASCII("seconds"));
+  if (!seconds_param.empty() &&
+      !base::StringToInt(seconds_param, &seconds)) {
+    seconds = 0;
+  }
+
+  if (seconds <= 0 ||
+      !media::AudioRendererAlgorithm::ValidateConfig(
+          channels, sample_rate, bits_per_channel)) {
+    std::cerr << "Invalid configuration." << std::endl;
+    return 1;
+  }
+
+  std::cout << "Channels: " << channels << std::endl;
+  std::cout << "Sample rate: " << sample_rate << std::endl;
+  std::cout << "Bits per channel: " << bits_per_channel << std::endl;
+  std::cout << "Seconds rendered per rate: " << seconds << std::endl;
+
+  static const float kPlaybackRates[] = { 0.5f, 1.0f, 1.5f, 2.0f };
+  for (size_t i = 0; i < arraysize(kPlaybackRates); ++i) {
+    std::cout << kPlaybackRates[i] << "x: "
+              << BenchmarkPlaybackRate(kPlaybackRates[i])
+              << "ms per second of audio" << std::endl;
+  }
+
+  return 0;
+}
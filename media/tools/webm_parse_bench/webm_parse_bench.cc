@@ -0,0 +1,146 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This tool measures the throughput of WebMStreamParser when a WebM file is
+// appended in small chunks, the way media source appends usually arrive. The
+// parsed buffers are kept until the whole file has been parsed, like
+// SourceBufferStream would, so the peak memory includes them.
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/process_util.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "media/base/media.h"
+#include "media/webm/webm_stream_parser.h"
+
+using base::TimeTicks;
+using media::StreamParser;
+
+static int chunk_size = 4096;
+static int iterations = 20;
+
+static void OnInit(bool success, base::TimeDelta duration) {
+  CHECK(success);
+}
+
+static bool OnNewConfig(const media::AudioDecoderConfig& audio_config,
+                        const media::VideoDecoderConfig& video_config) {
+  return true;
+}
+
+static bool OnNewBuffers(StreamParser::BufferQueue* queue,
+                         const StreamParser::BufferQueue& buffers) {
+  queue->insert(queue->end(), buffers.begin(), buffers.end());
+  return true;
+}
+
+static bool OnKeyNeeded(scoped_array<uint8> init_data, int init_data_size) {
+  return true;
+}
+
+// Parses |data| in chunks of |chunk_size| bytes. Returns the number of
+// buffers parsed, or -1 on error.
+static int ParseInChunks(const std::string& data) {
+  StreamParser::BufferQueue buffers;
+  media::WebMStreamParser parser;
+  parser.Init(base::Bind(&OnInit), base::Bind(&OnNewConfig),
+              base::Bind(&OnNewBuffers, &buffers),
+              base::Bind(&OnNewBuffers, &buffers),
+              base::Bind(&OnKeyNeeded));
+
+  const uint8* cur = reinterpret_cast<const uint8*>(data.data());
+  int remaining = data.size();
+  while (remaining > 0) {
+    int size = std::min(chunk_size, remaining);
+    if (!parser.Parse(cur, size))
+      return -1;
+    cur += size;
+    remaining -= size;
+  }
+  return buffers.size();
+}
+
+int main(int argc, const char** argv) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+  const CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+
+  if (cmd_line->GetArgs().size() != 1) {
+    std::cerr << "Usage: " << argv[0] << " [OPTIONS] FILE\n"
+              << "  --chunk-size=N                  "
+              << "Bytes per append\n"
+              << "  --iterations=N                  "
+              << "Number of times to parse the file\n"
+              << std::endl;
+    return 1;
+  }
+
+  std::string chunk_size_param(cmd_line->GetSwitchValueASCII("chunk-size"));
+  if (!chunk_size_param.empty() &&
+      !base::StringToInt(chunk_size_param, &chunk_size)) {
+    chunk_size = 0;
+  }
+
+  std::string iterations_param(cmd_line->GetSwitchValueASCII("iterations"));
+  if (!iterations_param.empty() &&
+      !base::StringToInt(iterations_param, &iterations)) {
+    iterations = 0;
+  }
+
+  if (chunk_size <= 0 || iterations <= 0) {
+    std::cerr << "Invalid configuration." << std::endl;
+    return 1;
+  }
+
+  std::string data;
+  FilePath path(cmd_line->GetArgs()[0]);
+  if (!file_util::ReadFileToString(path, &data) || data.empty()) {
+    std::cerr << "Unable to read " << path.value() << std::endl;
+    return 1;
+  }
+
+  media::InitializeMediaLibraryForTesting();
+
+  std::cout << "File size: " << data.size() << " bytes" << std::endl;
+  std::cout << "Chunk size: " << chunk_size << std::endl;
+
+  TimeTicks start = TimeTicks::HighResNow();
+  int buffers = 0;
+  for (int i = 0; i < iterations; ++i) {
+    buffers = ParseInChunks(data);
+    if (buffers < 0) {
+      std::cerr << "Parse error." << std::endl;
+      return 1;
+    }
+  }
+  double seconds = (TimeTicks::HighResNow() - start).InSecondsF();
+
+#if defined(OS_MACOSX)
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle(), NULL));
+#else
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(
+          base::GetCurrentProcessHandle()));
+#endif
+
+  std::cout << "Buffers per file: " << buffers << std::endl;
+  std::cout << "Throughput: "
+            << data.size() * iterations / seconds / (1024 * 1024)
+            << " MB/s" << std::endl;
+  std::cout << "Peak working set: "
+            << metrics->GetPeakWorkingSetSize() / 1024 << " KB" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sql/async_connection.h"
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/sequenced_task_runner.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "sql/connection.h"
+#include "sql/statement.h"
+
+namespace sql {
+
+AsyncConnection::AsyncConnection(base::SequencedWorkerPool* pool,
+                                 size_t reader_count)
+    : writer_(new Connection),
+      writer_runner_(pool->GetSequencedTaskRunner(pool->GetSequenceToken())),
+      next_reader_(0),
+      writer_open_attempted_(true, false),
+      writer_opened_(false),
+      closed_(false) {
+  DCHECK_GT(reader_count, 0U);
+  writer_->set_write_ahead_logging();
+  for (size_t i = 0; i < reader_count; ++i) {
+    Connection* reader = new Connection;
+    // A reader opened in another journal mode would take the database out
+    // of write-ahead logging mode.
+    reader->set_write_ahead_logging();
+    readers_.push_back(reader);
+    reader_runners_.push_back(
+        pool->GetSequencedTaskRunner(pool->GetSequenceToken()));
+  }
+}
+
+AsyncConnection::~AsyncConnection() {
+  DCHECK(closed_) << "Close() was not called";
+}
+
+void AsyncConnection::Open(const FilePath& path,
+                           const StatusCallback& callback) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(!closed_);
+  DCHECK(path_.empty()) << "Open() called twice";
+  path_ = path;
+
+  bool* succeeded = new bool(false);
+  writer_runner_->PostTaskAndReply(
+      FROM_HERE,
+      base::Bind(&AsyncConnection::OpenWriter, this, succeeded),
+      base::Bind(&ReplyWithStatus, callback, base::Owned(succeeded)));
+}
+
+void AsyncConnection::Close() {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(!closed_);
+  closed_ = true;
+
+  // The connections are deleted on their sequences, after the tasks posted
+  // to them.
+  writer_runner_->PostTask(FROM_HERE,
+                           base::Bind(&base::DeletePointer<Connection>,
+                                      writer_));
+  writer_ = NULL;
+  for (size_t i = 0; i < readers_.size(); ++i) {
+    reader_runners_[i]->PostTask(FROM_HERE,
+                                 base::Bind(&base::DeletePointer<Connection>,
+                                            readers_[i]));
+    readers_[i] = NULL;
+  }
+}
+
+void AsyncConnection::PostWriteTask(const tracked_objects::Location& from_here,
+                                    const Task& task,
+                                    const base::Closure& reply) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(!closed_);
+  DCHECK(!path_.empty()) << "Open() was not called";
+  writer_runner_->PostTaskAndReply(from_here, base::Bind(task, writer_),
+                                   reply);
+}
+
+void AsyncConnection::PostReadTask(const tracked_objects::Location& from_here,
+                                   const Task& task,
+                                   const base::Closure& reply) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  DCHECK(!closed_);
+  DCHECK(!path_.empty()) << "Open() was not called";
+  size_t reader = next_reader_;
+  next_reader_ = (next_reader_ + 1) % readers_.size();
+  reader_runners_[reader]->PostTaskAndReply(
+      from_here,
+      base::Bind(&AsyncConnection::RunReadTask, this, readers_[reader], task),
+      reply);
+}
+
+void AsyncConnection::Execute(const std::string& sql,
+                              const StatusCallback& callback) {
+  bool* succeeded = new bool(false);
+  PostWriteTask(FROM_HERE,
+                base::Bind(&ExecuteOnConnection, sql, succeeded),
+                base::Bind(&ReplyWithStatus, callback, base::Owned(succeeded)));
+}
+
+void AsyncConnection::Query(const std::string& sql,
+                            const QueryCallback& callback) {
+  bool* succeeded = new bool(false);
+  Rows* rows = new Rows;
+  PostReadTask(FROM_HERE,
+               base::Bind(&QueryOnConnection, sql, succeeded, rows),
+               base::Bind(&ReplyWithRows, callback, base::Owned(succeeded),
+                          base::Owned(rows)));
+}
+
+void AsyncConnection::OpenWriter(bool* succeeded) {
+  writer_opened_ = writer_->Open(path_);
+  writer_open_attempted_.Signal();
+  *succeeded = writer_opened_;
+}
+
+void AsyncConnection::RunReadTask(Connection* reader, const Task& task) {
+  // Each reader opens the database on its first task, once the writer has
+  // created it and put it in write-ahead logging mode.
+  if (!reader->is_open()) {
+    writer_open_attempted_.Wait();
+    if (!writer_opened_ || !reader->Open(path_))
+      DLOG(WARNING) << "Reader could not open the database";
+  }
+  task.Run(reader);
+}
+
+// static
+void AsyncConnection::ExecuteOnConnection(const std::string& sql,
+                                          bool* succeeded,
+                                          Connection* db) {
+  // Execute() reports success on a connection which is not open.
+  *succeeded = db->is_open() && db->Execute(sql.c_str());
+}
+
+// static
+void AsyncConnection::QueryOnConnection(const std::string& sql,
+                                        bool* succeeded,
+                                        Rows* rows,
+                                        Connection* db) {
+  Statement statement(db->GetUniqueStatement(sql.c_str()));
+  if (!statement.is_valid()) {
+    *succeeded = false;
+    return;
+  }
+  while (statement.Step()) {
+    rows->push_back(std::vector<std::string>());
+    std::vector<std::string>& row = rows->back();
+    for (int i = 0; i < statement.ColumnCount(); ++i)
+      row.push_back(statement.ColumnString(i));
+  }
+  *succeeded = statement.Succeeded();
+}
+
+// static
+void AsyncConnection::ReplyWithStatus(const StatusCallback& callback,
+                                      bool* succeeded) {
+  callback.Run(*succeeded);
+}
+
+// static
+void AsyncConnection::ReplyWithRows(const QueryCallback& callback,
+                                    bool* succeeded,
+                                    Rows* rows) {
+  callback.Run(*succeeded, *rows);
+}
+
+}  // namespace sql
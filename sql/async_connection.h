@@ -0,0 +1,156 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SQL_ASYNC_CONNECTION_H_
+#define SQL_ASYNC_CONNECTION_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread_checker.h"
+#include "sql/sql_export.h"
+
+namespace base {
+class SequencedTaskRunner;
+class SequencedWorkerPool;
+}
+
+namespace tracked_objects {
+class Location;
+}
+
+namespace sql {
+
+class Connection;
+
+// Runs a database on a SequencedWorkerPool, with one connection for writing
+// and several for reading. The database is put in write-ahead logging mode,
+// so that each reader sees the last committed state of the database without
+// waiting for the writer or for the other readers.
+//
+// Writes run in the order they were posted. Reads are spread over the
+// readers and may run in any order, concurrently with each other and with
+// the writes; a read posted after a write has replied sees that write once
+// it is committed.
+//
+// All methods must be called on the thread which created the object, and
+// the callbacks run on it. Close() must be called before the last reference
+// is released.
+//
+// Example:
+//   scoped_refptr<sql::AsyncConnection> db(
+//       new sql::AsyncConnection(BrowserThread::GetBlockingPool(), 4));
+//   db->Open(path, base::Bind(&OnOpened));
+//   db->Query("SELECT url FROM urls", base::Bind(&OnURLs));
+class SQL_EXPORT AsyncConnection
+    : public base::RefCountedThreadSafe<AsyncConnection> {
+ public:
+  // The rows returned by Query(), with the value of each column as text.
+  typedef std::vector<std::vector<std::string> > Rows;
+
+  // A task run on a worker thread with the connection to use. If the
+  // database could not be opened, the connection is not open, and its
+  // statements fail.
+  typedef base::Callback<void(Connection*)> Task;
+
+  typedef base::Callback<void(bool)> StatusCallback;
+  typedef base::Callback<void(bool, const Rows&)> QueryCallback;
+
+  // Creates the connections, which are opened by Open(). |reader_count| is
+  // the number of reads which may run at once, and must be at least one.
+  AsyncConnection(base::SequencedWorkerPool* pool, size_t reader_count);
+
+  // Opens the database at |path|, creating it if it does not exist, and runs
+  // |callback| with whether the writer could open it. The readers are opened
+  // when they first run a task, after the writer. Must be called before any
+  // task is posted.
+  void Open(const FilePath& path, const StatusCallback& callback);
+
+  // Closes the connections once the tasks posted before have run. No other
+  // method may be called afterwards.
+  void Close();
+
+  // Runs |task| with the writer connection, then |reply| on this thread.
+  void PostWriteTask(const tracked_objects::Location& from_here,
+                     const Task& task,
+                     const base::Closure& reply);
+
+  // Runs |task| with one of the reader connections, then |reply| on this
+  // thread. The task must not change the database.
+  void PostReadTask(const tracked_objects::Location& from_here,
+                    const Task& task,
+                    const base::Closure& reply);
+
+  // Executes |sql| with the writer, and runs |callback| with whether it
+  // succeeded.
+  void Execute(const std::string& sql, const StatusCallback& callback);
+
+  // Runs the query |sql| with a reader, and runs |callback| with whether it
+  // succeeded and the rows it returned.
+  void Query(const std::string& sql, const QueryCallback& callback);
+
+  size_t reader_count() const { return readers_.size(); }
+
+ private:
+  friend class base::RefCountedThreadSafe<AsyncConnection>;
+
+  ~AsyncConnection();
+
+  // Opens the writer on its sequence, setting |succeeded| to whether it
+  // could open the database.
+  void OpenWriter(bool* succeeded);
+
+  // Runs |task| with |reader| on the sequence of |reader|, opening it first
+  // if needed.
+  void RunReadTask(Connection* reader, const Task& task);
+
+  static void ExecuteOnConnection(const std::string& sql,
+                                  bool* succeeded,
+                                  Connection* db);
+  static void QueryOnConnection(const std::string& sql,
+                                bool* succeeded,
+                                Rows* rows,
+                                Connection* db);
+
+  // Runs |callback| with the results of Execute() or Query().
+  static void ReplyWithStatus(const StatusCallback& callback,
+                              bool* succeeded);
+  static void ReplyWithRows(const QueryCallback& callback,
+                            bool* succeeded,
+                            Rows* rows);
+
+  FilePath path_;
+
+  // Each connection is only used on its own sequence of the pool.
+  Connection* writer_;
+  scoped_refptr<base::SequencedTaskRunner> writer_runner_;
+  std::vector<Connection*> readers_;
+  std::vector<scoped_refptr<base::SequencedTaskRunner> > reader_runners_;
+
+  // The reader the next read is posted to. The reads are spread over the
+  // readers in turn.
+  size_t next_reader_;
+
+  // Signaled once the writer has tried to open the database, which the
+  // readers wait for before they open it, so that they find it in
+  // write-ahead logging mode. |writer_opened_| is only read after that.
+  base::WaitableEvent writer_open_attempted_;
+  bool writer_opened_;
+
+  bool closed_;
+
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncConnection);
+};
+
+}  // namespace sql
+
+#endif  // SQL_ASYNC_CONNECTION_H_
@@ -0,0 +1,139 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/scoped_temp_dir.h"
+#include "base/stringprintf.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "sql/async_connection.h"
+#include "sql/connection.h"
+#include "sql/statement.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kRowCount = 20000;
+const int kQueryCount = 200;
+
+// Each query scans the whole table, as history and cookie lookups on
+// unindexed columns do.
+const char kQuery[] = "SELECT COUNT(*) FROM foo WHERE b LIKE '%77%'";
+
+void Populate(sql::Connection* db) {
+  ASSERT_TRUE(db->Execute("CREATE TABLE foo (a INTEGER, b TEXT)"));
+  ASSERT_TRUE(db->BeginTransaction());
+  sql::Statement statement(db->GetUniqueStatement(
+      "INSERT INTO foo (a, b) VALUES (?, ?)"));
+  for (int i = 0; i < kRowCount; ++i) {
+    statement.BindInt(0, i);
+    statement.BindString(1, base::StringPrintf("http://www.%d.com/", i));
+    ASSERT_TRUE(statement.Run());
+    statement.Reset(true);
+  }
+  ASSERT_TRUE(db->CommitTransaction());
+}
+
+void QuitMessageLoop() {
+  MessageLoop::current()->Quit();
+}
+
+class SQLAsyncConnectionPerfTest : public testing::Test {
+ public:
+  SQLAsyncConnectionPerfTest() : pending_queries_(0) {}
+
+  void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("SQLAsyncConnectionPerfTest.db");
+    pool_ = new base::SequencedWorkerPool(8, "SQLAsyncConnectionPerfTest");
+  }
+
+  void TearDown() {
+    pool_->Shutdown();
+  }
+
+  void OnOpened(bool succeeded) {
+    EXPECT_TRUE(succeeded);
+    MessageLoop::current()->Quit();
+  }
+
+  void OnRows(bool succeeded, const sql::AsyncConnection::Rows& rows) {
+    EXPECT_TRUE(succeeded);
+    if (--pending_queries_ == 0)
+      MessageLoop::current()->Quit();
+  }
+
+  // Runs kQueryCount queries at once with |reader_count| readers, and logs
+  // how long they took and the number of queries per second.
+  void RunQueries(size_t reader_count) {
+    scoped_refptr<sql::AsyncConnection> db(
+        new sql::AsyncConnection(pool_.get(), reader_count));
+    db->Open(path_, base::Bind(&SQLAsyncConnectionPerfTest::OnOpened,
+                               base::Unretained(this)));
+    MessageLoop::current()->Run();
+
+    // Opens each reader before timing.
+    for (size_t i = 0; i < reader_count; ++i) {
+      db->PostReadTask(FROM_HERE, base::Bind(&Populated),
+                       base::Bind(&QuitMessageLoop));
+      MessageLoop::current()->Run();
+    }
+
+    std::string name(base::StringPrintf("%d_readers",
+                                        static_cast<int>(reader_count)));
+    PerfTimer timer;
+    {
+      PerfTimeLogger logger(name.c_str());
+      pending_queries_ = kQueryCount;
+      for (int i = 0; i < kQueryCount; ++i) {
+        db->Query(kQuery, base::Bind(&SQLAsyncConnectionPerfTest::OnRows,
+                                     base::Unretained(this)));
+      }
+      MessageLoop::current()->Run();
+    }
+    LogPerfResult((name + "_throughput").c_str(),
+                  kQueryCount / timer.Elapsed().InSecondsF(), "queries/s");
+    db->Close();
+  }
+
+ protected:
+  // Checks that a reader sees the populated table.
+  static void Populated(sql::Connection* db) {
+    sql::Statement statement(db->GetUniqueStatement(
+        "SELECT COUNT(*) FROM foo"));
+    ASSERT_TRUE(statement.Step());
+    EXPECT_EQ(kRowCount, statement.ColumnInt(0));
+  }
+
+  MessageLoop message_loop_;
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+  scoped_refptr<base::SequencedWorkerPool> pool_;
+  int pending_queries_;
+};
+
+}  // namespace
+
+// Compares the throughput of concurrent reads with one reader, as when all
+// queries go through the thread of a single connection, against several.
+TEST_F(SQLAsyncConnectionPerfTest, ConcurrentReads) {
+  {
+    scoped_refptr<sql::AsyncConnection> db(
+        new sql::AsyncConnection(pool_.get(), 1));
+    db->Open(path_, base::Bind(&SQLAsyncConnectionPerfTest::OnOpened,
+                               base::Unretained(this)));
+    MessageLoop::current()->Run();
+    db->PostWriteTask(FROM_HERE, base::Bind(&Populate),
+                      base::Bind(&QuitMessageLoop));
+    MessageLoop::current()->Run();
+    db->Close();
+  }
+
+  RunQueries(1);
+  RunQueries(4);
+}
@@ -0,0 +1,138 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop.h"
+#include "base/scoped_temp_dir.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "sql/async_connection.h"
+#include "sql/connection.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+class SQLAsyncConnectionTest : public testing::Test {
+ public:
+  SQLAsyncConnectionTest() : succeeded_(false) {}
+
+  void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    pool_ = new base::SequencedWorkerPool(3, "SQLAsyncConnectionTest");
+    db_ = new sql::AsyncConnection(pool_.get(), 2);
+    db_->Open(temp_dir_.path().AppendASCII("SQLAsyncConnectionTest.db"),
+              base::Bind(&SQLAsyncConnectionTest::OnStatus,
+                         base::Unretained(this)));
+    MessageLoop::current()->Run();
+    ASSERT_TRUE(succeeded_);
+  }
+
+  void TearDown() {
+    db_->Close();
+    db_ = NULL;
+    pool_->Shutdown();
+  }
+
+  // Executes |sql| with the writer and waits for the result.
+  bool Execute(const char* sql) {
+    succeeded_ = false;
+    db_->Execute(sql, base::Bind(&SQLAsyncConnectionTest::OnStatus,
+                                 base::Unretained(this)));
+    MessageLoop::current()->Run();
+    return succeeded_;
+  }
+
+  // Runs the query |sql| with a reader and waits for the rows.
+  bool Query(const char* sql) {
+    succeeded_ = false;
+    rows_.clear();
+    db_->Query(sql, base::Bind(&SQLAsyncConnectionTest::OnRows,
+                               base::Unretained(this)));
+    MessageLoop::current()->Run();
+    return succeeded_;
+  }
+
+  // Runs "SELECT COUNT(*) FROM foo" with a reader.
+  std::string CountFoo() {
+    if (!Query("SELECT COUNT(*) FROM foo") || rows_.size() != 1)
+      return std::string();
+    return rows_[0][0];
+  }
+
+  void OnStatus(bool succeeded) {
+    succeeded_ = succeeded;
+    MessageLoop::current()->Quit();
+  }
+
+  void OnRows(bool succeeded, const sql::AsyncConnection::Rows& rows) {
+    succeeded_ = succeeded;
+    rows_ = rows;
+    MessageLoop::current()->Quit();
+  }
+
+ protected:
+  MessageLoop message_loop_;
+  ScopedTempDir temp_dir_;
+  scoped_refptr<base::SequencedWorkerPool> pool_;
+  scoped_refptr<sql::AsyncConnection> db_;
+
+  bool succeeded_;
+  sql::AsyncConnection::Rows rows_;
+};
+
+void Begin(sql::Connection* db) {
+  EXPECT_TRUE(db->BeginTransaction());
+  EXPECT_TRUE(db->Execute("INSERT INTO foo (a, b) VALUES (3, 'three')"));
+}
+
+void Commit(sql::Connection* db) {
+  EXPECT_TRUE(db->CommitTransaction());
+}
+
+void QuitMessageLoop() {
+  MessageLoop::current()->Quit();
+}
+
+}  // namespace
+
+TEST_F(SQLAsyncConnectionTest, ExecuteAndQuery) {
+  ASSERT_TRUE(Execute("CREATE TABLE foo (a INTEGER, b TEXT)"));
+  ASSERT_TRUE(Execute("INSERT INTO foo (a, b) VALUES (1, 'one')"));
+  ASSERT_TRUE(Execute("INSERT INTO foo (a, b) VALUES (2, 'two')"));
+
+  // Each query goes to the next reader, so both readers see the rows.
+  for (size_t i = 0; i < db_->reader_count(); ++i) {
+    ASSERT_TRUE(Query("SELECT a, b FROM foo ORDER BY a"));
+    ASSERT_EQ(2U, rows_.size());
+    ASSERT_EQ(2U, rows_[0].size());
+    EXPECT_EQ("1", rows_[0][0]);
+    EXPECT_EQ("one", rows_[0][1]);
+    EXPECT_EQ("2", rows_[1][0]);
+    EXPECT_EQ("two", rows_[1][1]);
+  }
+
+  ASSERT_TRUE(Query("SELECT a FROM foo WHERE a > 5"));
+  EXPECT_TRUE(rows_.empty());
+}
+
+// The readers see the last committed state while the writer is in the middle
+// of a transaction, rather than waiting for it.
+TEST_F(SQLAsyncConnectionTest, ReadDuringWrite) {
+  ASSERT_TRUE(Execute("CREATE TABLE foo (a INTEGER, b TEXT)"));
+  ASSERT_TRUE(Execute("INSERT INTO foo (a, b) VALUES (1, 'one')"));
+
+  db_->PostWriteTask(FROM_HERE, base::Bind(&Begin),
+                     base::Bind(&QuitMessageLoop));
+  MessageLoop::current()->Run();
+  for (size_t i = 0; i < db_->reader_count(); ++i)
+    EXPECT_EQ("1", CountFoo());
+
+  db_->PostWriteTask(FROM_HERE, base::Bind(&Commit),
+                     base::Bind(&QuitMessageLoop));
+  MessageLoop::current()->Run();
+  for (size_t i = 0; i < db_->reader_count(); ++i)
+    EXPECT_EQ("2", CountFoo());
+}
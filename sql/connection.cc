@@ -6,6 +6,9 @@
 
 #include <string.h>
 
+#include <algorithm>
+
+#include "base/debug/trace_event.h"
 #include "base/file_path.h"
 #include "base/logging.h"
 #include "base/string_util.h"
@@ -21,6 +24,10 @@ namespace {
 // TODO(shess): Better story on this.  http://crbug.com/56559
 const int kBusyTimeoutSeconds = 1;
 
+// The number of compiled statements kept by default. This is more than any
+// single database currently uses, so that only unusual load evicts them.
+const size_t kDefaultStatementCacheSize = 128;
+
 class ScopedBusyTimeout {
  public:
   explicit ScopedBusyTimeout(sqlite3* db)
@@ -40,6 +47,12 @@ class ScopedBusyTimeout {
   sqlite3* db_;
 };
 
+// Orders statement profiles by the time spent in them, most first.
+bool ProfileTakesLonger(const sql::StatementProfile& a,
+                        const sql::StatementProfile& b) {
+  return a.time > b.time;
+}
+
 }  // namespace
 
 namespace sql {
@@ -50,6 +63,23 @@ bool StatementID::operator<(const StatementID& other) const {
   return strcmp(str_, other.str_) < 0;
 }
 
+std::string StatementID::ToString() const {
+  if (number_ < 0)
+    return str_;
+  return base::StringPrintf("%s:%d", str_, number_);
+}
+
+StatementProfile::StatementProfile()
+    : compiles(0),
+      steps(0),
+      rows(0),
+      full_scan_steps(0),
+      sorts(0) {
+}
+
+StatementProfile::~StatementProfile() {
+}
+
 ErrorDelegate::ErrorDelegate() {
 }
 
@@ -87,6 +117,10 @@ Connection::Connection()
       page_size_(0),
       cache_size_(0),
       exclusive_locking_(false),
+      write_ahead_logging_(false),
+      statement_cache_(CachedStatementMap::NO_AUTO_EVICT),
+      statement_cache_size_(kDefaultStatementCacheSize),
+      profiling_enabled_(false),
       transaction_nesting_(0),
       needs_rollback_(false) {
 }
@@ -113,10 +147,13 @@ void Connection::Close() {
   // embedded systems, this is probably not appropriate, whereas on
   // desktop it might make some sense.
 
+  if (profiling_enabled_ && !statement_profiles_.empty())
+    LOG(INFO) << "SQL statement profiles:\n" << GetProfileReport();
+
   // sqlite3_close() needs all prepared statements to be finalized.
   // Release all cached statements, then assert that the client has
   // released all statements.
-  statement_cache_.clear();
+  statement_cache_.Clear();
   DCHECK(open_statements_.empty());
 
   // Additionally clear the prepared statements, because they contain
@@ -316,14 +353,23 @@ bool Connection::ExecuteWithTimeout(const char* sql, base::TimeDelta timeout) {
   return Execute(sql);
 }
 
+void Connection::set_statement_cache_size(size_t size) {
+  statement_cache_size_ = size;
+  if (statement_cache_size_)
+    statement_cache_.ShrinkToSize(statement_cache_size_);
+}
+
 bool Connection::HasCachedStatement(const StatementID& id) const {
-  return statement_cache_.find(id) != statement_cache_.end();
+  // Peek() does not change the cache, it is only missing a const version.
+  CachedStatementMap& cache =
+      const_cast<CachedStatementMap&>(statement_cache_);
+  return cache.Peek(id) != cache.end();
 }
 
 scoped_refptr<Connection::StatementRef> Connection::GetCachedStatement(
     const StatementID& id,
     const char* sql) {
-  CachedStatementMap::iterator i = statement_cache_.find(id);
+  CachedStatementMap::iterator i = statement_cache_.Get(id);
   if (i != statement_cache_.end()) {
     // Statement is in the cache. It should still be active (we're the only
     // one invalidating cached statements, and we'll remove it from the cache
@@ -335,8 +381,15 @@ scoped_refptr<Connection::StatementRef> Connection::GetCachedStatement(
   }
 
   scoped_refptr<StatementRef> statement = GetUniqueStatement(sql);
-  if (statement->is_valid())
-    statement_cache_[id] = statement;  // Only cache valid statements.
+  if (statement->is_valid()) {
+    // Only cache valid statements. Statements evicted here stay valid for
+    // whoever still uses them, and are finalized when released.
+    statement_cache_.Put(id, statement);
+    if (statement_cache_size_)
+      statement_cache_.ShrinkToSize(statement_cache_size_);
+    if (profiling_enabled_)
+      statement_profiles_[sql].location = id.ToString();
+  }
   return statement;
 }
 
@@ -351,6 +404,8 @@ scoped_refptr<Connection::StatementRef> Connection::GetUniqueStatement(
     DLOG(FATAL) << "SQL compile error " << GetErrorMessage();
     return new StatementRef(this, NULL);
   }
+  if (profiling_enabled_)
+    ++statement_profiles_[sql].compiles;
   return new StatementRef(this, stmt);
 }
 
@@ -363,6 +418,34 @@ bool Connection::IsSQLValid(const char* sql) {
   return true;
 }
 
+void Connection::GetStatementProfiles(
+    std::vector<StatementProfile>* profiles) const {
+  profiles->clear();
+  for (StatementProfileMap::const_iterator i = statement_profiles_.begin();
+       i != statement_profiles_.end(); ++i) {
+    profiles->push_back(i->second);
+    profiles->back().sql = i->first;
+  }
+  std::sort(profiles->begin(), profiles->end(), &ProfileTakesLonger);
+}
+
+std::string Connection::GetProfileReport() const {
+  std::vector<StatementProfile> profiles;
+  GetStatementProfiles(&profiles);
+  std::string report;
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    const StatementProfile& profile = profiles[i];
+    base::StringAppendF(&report,
+        "%.3fms steps=%d rows=%d full_scan_steps=%d sorts=%d compiles=%d "
+        "%s %s\n",
+        profile.time.InMillisecondsF(), profile.steps, profile.rows,
+        profile.full_scan_steps, profile.sorts, profile.compiles,
+        profile.location.empty() ? "-" : profile.location.c_str(),
+        profile.sql.c_str());
+  }
+  return report;
+}
+
 bool Connection::DoesTableExist(const char* table_name) const {
   return DoesTableOrIndexExist(table_name, "table");
 }
@@ -481,11 +564,14 @@ bool Connection::OpenInternal(const std::string& file_name) {
   // DELETE (default) - delete -journal file to commit.
   // TRUNCATE - truncate -journal file to commit.
   // PERSIST - zero out header of -journal file to commit.
-  // journal_size_limit provides size to trim to in PERSIST.
+  // WAL - append to -wal file to commit, see |write_ahead_logging_|.
+  // journal_size_limit provides size to trim to in PERSIST, and to
+  // truncate the -wal file to after a checkpoint.
   // TODO(shess): Figure out if PERSIST and journal_size_limit really
   // matter.  In theory, it keeps pages pre-allocated, so if
   // transactions usually fit, it should be faster.
-  ignore_result(Execute("PRAGMA journal_mode = PERSIST"));
+  if (!write_ahead_logging_)
+    ignore_result(Execute("PRAGMA journal_mode = PERSIST"));
   ignore_result(Execute("PRAGMA journal_size_limit = 16384"));
 
   const base::TimeDelta kBusyTimeout =
@@ -508,6 +594,13 @@ bool Connection::OpenInternal(const std::string& file_name) {
       DLOG(FATAL) << "Could not set cache size: " << GetErrorMessage();
   }
 
+  // The page size of a database can not be changed once it is in WAL
+  // mode, so this must come after setting it.
+  if (write_ahead_logging_) {
+    if (!ExecuteWithTimeout("PRAGMA journal_mode = WAL", kBusyTimeout))
+      DLOG(FATAL) << "Could not set journal mode: " << GetErrorMessage();
+  }
+
   if (!ExecuteWithTimeout("PRAGMA secure_delete=ON", kBusyTimeout)) {
     DLOG(FATAL) << "Could not enable secure_delete: " << GetErrorMessage();
     Close();
@@ -517,6 +610,28 @@ bool Connection::OpenInternal(const std::string& file_name) {
   return true;
 }
 
+void Connection::RecordStep(sqlite3_stmt* stmt,
+                            int result,
+                            base::TimeDelta elapsed) {
+  StatementProfile& profile = statement_profiles_[sqlite3_sql(stmt)];
+  ++profile.steps;
+  if (result == SQLITE_ROW)
+    ++profile.rows;
+  profile.time += elapsed;
+
+  // Read and reset the counters, so that each step adds its own.
+  int full_scan_steps =
+      sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+  profile.full_scan_steps += full_scan_steps;
+  profile.sorts += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+
+  if (full_scan_steps) {
+    TRACE_EVENT_INSTANT2("sql", "Connection::FullScan",
+                         "sql", TRACE_STR_COPY(sqlite3_sql(stmt)),
+                         "steps", full_scan_steps);
+  }
+}
+
 void Connection::DoRollback() {
   Statement rollback(GetCachedStatement(SQL_FROM_HERE, "ROLLBACK"));
   rollback.Run();
@@ -537,7 +652,7 @@ void Connection::StatementRefDeleted(StatementRef* ref) {
 }
 
 void Connection::ClearCache() {
-  statement_cache_.clear();
+  statement_cache_.Clear();
 
   // The cache clear will get most statements. There may be still be references
   // to some statements that are held by others (including one-shot statements).
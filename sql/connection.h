@@ -9,9 +9,11 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/memory/mru_cache.h"
 #include "base/memory/ref_counted.h"
 #include "base/time.h"
 #include "sql/sql_export.h"
@@ -63,6 +65,9 @@ class StatementID {
   // We need this to insert into our map.
   bool operator<(const StatementID& other) const;
 
+  // Returns "file:line", or the unique name for custom statements.
+  std::string ToString() const;
+
  private:
   int number_;
   const char* str_;
@@ -70,6 +75,36 @@ class StatementID {
 
 #define SQL_FROM_HERE sql::StatementID(__FILE__, __LINE__)
 
+// The execution statistics of one SQL statement, gathered while profiling is
+// enabled on its connection. See Connection::set_profiling_enabled().
+struct SQL_EXPORT StatementProfile {
+  StatementProfile();
+  ~StatementProfile();
+
+  std::string sql;
+
+  // Where the statement was cached from, see StatementID::ToString(). Empty
+  // for statements which were never cached.
+  std::string location;
+
+  // The number of times the statement was compiled. A cached statement
+  // compiled several times was evicted from the statement cache.
+  int compiles;
+
+  // The calls to sqlite3_step(), and the rows they returned.
+  int steps;
+  int rows;
+
+  // The rows sqlite stepped through in full table scans, and the sorts it
+  // did, as counted by sqlite3_stmt_status(). Either of these suggests a
+  // missing index.
+  int full_scan_steps;
+  int sorts;
+
+  // The wall time spent in sqlite3_step().
+  base::TimeDelta time;
+};
+
 class Connection;
 
 // ErrorDelegate defines the interface to implement error handling and recovery
@@ -139,6 +174,16 @@ class SQL_EXPORT Connection {
   // This must be called before Open() to have an effect.
   void set_exclusive_locking() { exclusive_locking_ = true; }
 
+  // Call to use a write-ahead log instead of a rollback journal. Readers in
+  // other connections then see the last committed state of the database and
+  // neither block nor are blocked by a writer, and a commit only appends to
+  // the log rather than rewriting pages in place. The log is checkpointed
+  // into the database as it grows and when the last connection closes.
+  //
+  // This must be called before Open() to have an effect. It has no effect on
+  // in-memory databases.
+  void set_write_ahead_logging() { write_ahead_logging_ = true; }
+
   // Sets the object that will handle errors. Recomended that it should be set
   // before calling Open(). If not set, the default is to ignore errors on
   // release and assert on debug builds.
@@ -146,6 +191,18 @@ class SQL_EXPORT Connection {
     error_delegate_ = delegate;
   }
 
+  // Sets the number of compiled statements GetCachedStatement() keeps. Once
+  // it is reached, the least recently used statement is dropped from the
+  // cache, to be compiled again when it is next used. Zero means no limit.
+  void set_statement_cache_size(size_t size);
+
+  // Call to record a StatementProfile for each statement run, and trace
+  // events in the "sql" category for each step and full table scan. This has
+  // a cost for every step, so is off by default. It can be changed at any
+  // time. When the connection is closed, the profiles are written to the log.
+  void set_profiling_enabled(bool enabled) { profiling_enabled_ = enabled; }
+  bool profiling_enabled() const { return profiling_enabled_; }
+
   // Initialization ------------------------------------------------------------
 
   // Initializes the SQL connection for the given file, returning true if the
@@ -278,6 +335,15 @@ class SQL_EXPORT Connection {
   // See GetCachedStatement above for examples and error information.
   scoped_refptr<StatementRef> GetUniqueStatement(const char* sql);
 
+  // Profiling -----------------------------------------------------------------
+
+  // Fills |profiles| with the statements run since profiling was enabled,
+  // those which took the most time first.
+  void GetStatementProfiles(std::vector<StatementProfile>* profiles) const;
+
+  // Returns a report of GetStatementProfiles(), one statement per line.
+  std::string GetProfileReport() const;
+
   // Info querying -------------------------------------------------------------
 
   // Returns true if the given table exists.
@@ -388,6 +454,11 @@ class SQL_EXPORT Connection {
   bool ExecuteWithTimeout(const char* sql, base::TimeDelta ms_timeout)
       WARN_UNUSED_RESULT;
 
+  // Called by Statement objects after each sqlite3_step() of |stmt| when
+  // profiling is enabled. |result| is what it returned, and |elapsed| the
+  // time it took.
+  void RecordStep(sqlite3_stmt* stmt, int result, base::TimeDelta elapsed);
+
   // The actual sqlite database. Will be NULL before Init has been called or if
   // Init resulted in an error.
   sqlite3* db_;
@@ -397,12 +468,20 @@ class SQL_EXPORT Connection {
   int page_size_;
   int cache_size_;
   bool exclusive_locking_;
+  bool write_ahead_logging_;
 
-  // All cached statements. Keeping a reference to these statements means that
-  // they'll remain active.
-  typedef std::map<StatementID, scoped_refptr<StatementRef> >
+  // Cached statements, most recently used first. Keeping a reference to these
+  // statements means that they'll remain active. The cache is trimmed to
+  // |statement_cache_size_| by GetCachedStatement().
+  typedef base::MRUCache<StatementID, scoped_refptr<StatementRef> >
       CachedStatementMap;
   CachedStatementMap statement_cache_;
+  size_t statement_cache_size_;
+
+  // See set_profiling_enabled(). The profiles are keyed by their SQL.
+  bool profiling_enabled_;
+  typedef std::map<std::string, StatementProfile> StatementProfileMap;
+  StatementProfileMap statement_profiles_;
 
   // A list of all StatementRefs we've given out. Each ref must register with
   // us when it's created or destroyed. This allows us to potentially close
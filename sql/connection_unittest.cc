@@ -86,6 +86,98 @@ TEST_F(SQLConnectionTest, CachedStatement) {
   EXPECT_FALSE(db().HasCachedStatement(SQL_FROM_HERE));
 }
 
+TEST_F(SQLConnectionTest, StatementCacheEvictsLeastRecentlyUsed) {
+  sql::StatementID id1("foo", 1);
+  sql::StatementID id2("foo", 2);
+  sql::StatementID id3("foo", 3);
+  db().set_statement_cache_size(2);
+  ASSERT_TRUE(db().Execute("CREATE TABLE foo (a, b)"));
+
+  sql::Statement s1(db().GetCachedStatement(id1, "SELECT a FROM foo"));
+  ASSERT_TRUE(s1.is_valid());
+  {
+    sql::Statement s(db().GetCachedStatement(id2, "SELECT b FROM foo"));
+  }
+  {
+    // Using the first statement makes the second the least recently used.
+    sql::Statement s(db().GetCachedStatement(id1, "SELECT a FROM foo"));
+  }
+  {
+    sql::Statement s(db().GetCachedStatement(id3, "SELECT a, b FROM foo"));
+  }
+  EXPECT_TRUE(db().HasCachedStatement(id1));
+  EXPECT_FALSE(db().HasCachedStatement(id2));
+  EXPECT_TRUE(db().HasCachedStatement(id3));
+
+  // An evicted statement still works for whoever holds it.
+  db().set_statement_cache_size(1);
+  EXPECT_FALSE(db().HasCachedStatement(id1));
+  EXPECT_TRUE(s1.is_valid());
+  EXPECT_FALSE(s1.Step());
+  EXPECT_TRUE(s1.Succeeded());
+}
+
+TEST_F(SQLConnectionTest, StatementProfiles) {
+  ASSERT_TRUE(db().Execute("CREATE TABLE foo (a, b)"));
+  ASSERT_TRUE(db().Execute("CREATE INDEX foo_a ON foo(a)"));
+  db().set_profiling_enabled(true);
+  for (int i = 0; i < 10; ++i) {
+    sql::Statement s(db().GetCachedStatement(
+        SQL_FROM_HERE, "INSERT INTO foo (a, b) VALUES (?, ?)"));
+    s.BindInt(0, i);
+    s.BindInt(1, i % 2);
+    ASSERT_TRUE(s.Run());
+  }
+
+  // Looking up |a| uses its index, while looking up |b| scans the table.
+  {
+    sql::Statement s(db().GetUniqueStatement("SELECT b FROM foo WHERE a=3"));
+    ASSERT_TRUE(s.Step());
+    EXPECT_FALSE(s.Step());
+  }
+  {
+    sql::Statement s(db().GetUniqueStatement("SELECT a FROM foo WHERE b=1"));
+    while (s.Step()) {
+    }
+  }
+
+  std::vector<sql::StatementProfile> profiles;
+  db().GetStatementProfiles(&profiles);
+  ASSERT_EQ(3U, profiles.size());
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    const sql::StatementProfile& profile = profiles[i];
+    if (profile.sql == "INSERT INTO foo (a, b) VALUES (?, ?)") {
+      EXPECT_EQ(1, profile.compiles);
+      EXPECT_EQ(10, profile.steps);
+      EXPECT_EQ(0, profile.rows);
+      EXPECT_NE(std::string::npos,
+                profile.location.find("connection_unittest.cc"));
+    } else if (profile.sql == "SELECT b FROM foo WHERE a=3") {
+      EXPECT_EQ(2, profile.steps);
+      EXPECT_EQ(1, profile.rows);
+      EXPECT_EQ(0, profile.full_scan_steps);
+      EXPECT_TRUE(profile.location.empty());
+    } else {
+      EXPECT_EQ("SELECT a FROM foo WHERE b=1", profile.sql);
+      EXPECT_EQ(6, profile.steps);
+      EXPECT_EQ(5, profile.rows);
+      EXPECT_LT(0, profile.full_scan_steps);
+    }
+  }
+  EXPECT_NE(std::string::npos,
+            db().GetProfileReport().find("SELECT a FROM foo WHERE b=1"));
+
+  // Nothing is recorded once profiling is disabled.
+  db().set_profiling_enabled(false);
+  ASSERT_TRUE(db().Execute("DELETE FROM foo"));
+  {
+    sql::Statement s(db().GetUniqueStatement("SELECT a FROM foo"));
+    EXPECT_FALSE(s.Step());
+  }
+  db().GetStatementProfiles(&profiles);
+  EXPECT_EQ(3U, profiles.size());
+}
+
 TEST_F(SQLConnectionTest, IsSQLValidTest) {
   ASSERT_TRUE(db().Execute("CREATE TABLE foo (a, b)"));
   ASSERT_TRUE(db().IsSQLValid("SELECT a FROM foo"));
@@ -258,6 +350,45 @@ TEST_F(SQLConnectionTest, RazeLocked) {
   ASSERT_TRUE(db().Raze());
 }
 
+TEST_F(SQLConnectionTest, WriteAheadLogging) {
+  db().Close();
+  sql::Connection wal_db;
+  wal_db.set_page_size(2048);
+  wal_db.set_write_ahead_logging();
+  ASSERT_TRUE(wal_db.Open(db_path()));
+  {
+    sql::Statement s(wal_db.GetUniqueStatement("PRAGMA journal_mode"));
+    ASSERT_TRUE(s.Step());
+    EXPECT_EQ("wal", s.ColumnString(0));
+  }
+  {
+    // The page size was set before the log was enabled.
+    sql::Statement s(wal_db.GetUniqueStatement("PRAGMA page_size"));
+    ASSERT_TRUE(s.Step());
+    EXPECT_EQ(2048, s.ColumnInt(0));
+  }
+  ASSERT_TRUE(wal_db.Execute("CREATE TABLE foo (a, b)"));
+  ASSERT_TRUE(wal_db.Execute("INSERT INTO foo VALUES (1, 2)"));
+
+  // A reader in another connection is not blocked by a write transaction,
+  // and sees the state of the database before it.
+  ASSERT_TRUE(wal_db.BeginTransaction());
+  ASSERT_TRUE(wal_db.Execute("INSERT INTO foo VALUES (3, 4)"));
+  sql::Connection other_db;
+  other_db.set_write_ahead_logging();
+  ASSERT_TRUE(other_db.Open(db_path()));
+  const char* kQuery = "SELECT COUNT(*) FROM foo";
+  sql::Statement s(other_db.GetUniqueStatement(kQuery));
+  ASSERT_TRUE(s.Step());
+  EXPECT_EQ(1, s.ColumnInt(0));
+  s.Reset(true);
+
+  // The reader sees the write once it is committed.
+  ASSERT_TRUE(wal_db.CommitTransaction());
+  ASSERT_TRUE(s.Step());
+  EXPECT_EQ(2, s.ColumnInt(0));
+}
+
 // TODO(shess): Spin up a background thread to hold other_db, to more
 // closely match real life.  That would also allow testing
 // RazeWithTimeout().
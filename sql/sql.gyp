@@ -16,6 +16,8 @@
       ],
       'defines': [ 'SQL_IMPLEMENTATION' ],
       'sources': [
+        'async_connection.cc',
+        'async_connection.h',
         'connection.cc',
         'connection.h',
         'diagnostic_error_delegate.h',
@@ -38,6 +40,7 @@
       ],
       'sources': [
         'run_all_unittests.cc',
+        'async_connection_unittest.cc',
         'connection_unittest.cc',
         'sqlite_features_unittest.cc',
         'statement_unittest.cc',
@@ -63,6 +66,22 @@
         }],
       ],
     },
+    {
+      'target_name': 'sql_perftests',
+      'type': 'executable',
+      'dependencies': [
+        'sql',
+        '../base/base.gyp:base',
+        '../base/base.gyp:test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'sources': [
+        'async_connection_perftest.cc',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+    },
   ],
   'conditions': [
     # Special target to wrap a gtest_target_type==shared_library
@@ -4,8 +4,10 @@
 
 #include "sql/statement.h"
 
+#include "base/debug/trace_event.h"
 #include "base/logging.h"
 #include "base/string_util.h"
+#include "base/time.h"
 #include "base/utf_string_conversions.h"
 #include "third_party/sqlite/sqlite3.h"
 
@@ -51,14 +53,27 @@ bool Statement::Run() {
   if (!CheckValid())
     return false;
 
-  return CheckError(sqlite3_step(ref_->stmt())) == SQLITE_DONE;
+  return CheckError(StepInternal()) == SQLITE_DONE;
 }
 
 bool Statement::Step() {
   if (!CheckValid())
     return false;
 
-  return CheckError(sqlite3_step(ref_->stmt())) == SQLITE_ROW;
+  return CheckError(StepInternal()) == SQLITE_ROW;
+}
+
+int Statement::StepInternal() {
+  Connection* connection = ref_->connection();
+  if (!connection->profiling_enabled())
+    return sqlite3_step(ref_->stmt());
+
+  TRACE_EVENT1("sql", "Statement::Step",
+               "sql", TRACE_STR_COPY(sqlite3_sql(ref_->stmt())));
+  base::TimeTicks start = base::TimeTicks::Now();
+  int result = sqlite3_step(ref_->stmt());
+  connection->RecordStep(ref_->stmt(), result, base::TimeTicks::Now() - start);
+  return result;
 }
 
 void Statement::Reset(bool clear_bound_vars) {
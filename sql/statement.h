@@ -160,6 +160,10 @@ class SQL_EXPORT Statement {
   // succeeded flag.
   bool CheckOk(int err) const;
 
+  // Runs sqlite3_step() on the statement, profiling it if the connection
+  // asks for it. Returns the sqlite result code.
+  int StepInternal();
+
   // Should be called by all mutating methods to check that the statement is
   // valid. Returns true if the statement is valid. DCHECKS and returns false
   // if it is not.
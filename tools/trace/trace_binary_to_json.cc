@@ -0,0 +1,48 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Converts a binary trace, as written by base::debug::TraceBinaryWriter, to
+// the JSON trace format which about:tracing and trace.html load.
+//
+// Usage: trace_binary_to_json <binary trace> <JSON output>
+
+#include <stdio.h>
+
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/debug/trace_event_binary.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+
+int main(int argc, const char* argv[]) {
+  base::AtExitManager at_exit;
+  CommandLine::Init(argc, argv);
+  const CommandLine::StringVector& args =
+      CommandLine::ForCurrentProcess()->GetArgs();
+  if (args.size() != 2) {
+    fprintf(stderr, "Usage: %s <binary trace> <JSON output>\n", argv[0]);
+    return 1;
+  }
+
+  std::string binary_trace;
+  if (!file_util::ReadFileToString(FilePath(args[0]), &binary_trace)) {
+    fprintf(stderr, "Could not read the binary trace\n");
+    return 1;
+  }
+
+  std::string json;
+  if (!base::debug::ConvertBinaryTraceToJSON(binary_trace, &json)) {
+    fprintf(stderr, "Not a valid binary trace\n");
+    return 1;
+  }
+
+  int size = static_cast<int>(json.size());
+  if (file_util::WriteFile(FilePath(args[1]), json.data(), size) != size) {
+    fprintf(stderr, "Could not write the JSON trace\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,21 @@
+# Copyright (c) 2012 The Chromium Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'variables': {
+    'chromium_code': 1,
+  },
+  'targets' : [
+    {
+      'target_name': 'trace_binary_to_json',
+      'type': 'executable',
+      'dependencies': [
+        '../../base/base.gyp:base',
+      ],
+      'sources': [
+        'trace_binary_to_json.cc',
+      ],
+    },
+  ],
+}
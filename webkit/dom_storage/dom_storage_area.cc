@@ -24,11 +24,29 @@ namespace dom_storage {
 
 static const int kCommitTimerSeconds = 1;
 
+// Changes are committed without waiting for the timer once they take up more
+// than this, so pages writing in a tight loop don't pile them up in memory.
+static const size_t kCommitBatchBudget = 1024 * 1024;
+
 DomStorageArea::CommitBatch::CommitBatch()
-  : clear_all_first(false) {
+  : clear_all_first(false),
+    changed_bytes(0) {
 }
 DomStorageArea::CommitBatch::~CommitBatch() {}
 
+void DomStorageArea::CommitBatch::AddChange(const string16& key,
+                                            const NullableString16& value) {
+  std::pair<ValuesMap::iterator, bool> inserted =
+      changed_values.insert(std::make_pair(key, value));
+  if (inserted.second) {
+    changed_bytes += key.size() * sizeof(char16);
+  } else {
+    changed_bytes -= inserted.first->second.string().size() * sizeof(char16);
+    inserted.first->second = value;
+  }
+  changed_bytes += value.string().size() * sizeof(char16);
+}
+
 
 // static
 const FilePath::CharType DomStorageArea::kDatabaseFileExtension[] =
@@ -69,6 +87,19 @@ DomStorageArea::DomStorageArea(
   }
 }
 
+DomStorageArea::DomStorageArea(
+    const GURL& origin, DomStorageLogDatabase* log_database,
+    DomStorageTaskRunner* task_runner)
+    : namespace_id_(kLocalStorageNamespaceId), origin_(origin),
+      directory_(log_database->file_path().DirName()),
+      task_runner_(task_runner),
+      map_(new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance)),
+      log_database_(log_database),
+      is_initial_import_done_(false),
+      is_shutdown_(false),
+      commit_batches_in_flight_(0) {
+}
+
 DomStorageArea::~DomStorageArea() {
 }
 
@@ -109,9 +140,10 @@ bool DomStorageArea::SetItem(const string16& key,
   if (!map_->HasOneRef())
     map_ = map_->DeepCopy();
   bool success = map_->SetItem(key, value, old_value);
-  if (success && backing_.get()) {
+  if (success && HasBacking()) {
     CommitBatch* commit_batch = CreateCommitBatchIfNeeded();
-    commit_batch->changed_values[key] = NullableString16(value, false);
+    commit_batch->AddChange(key, NullableString16(value, false));
+    CommitIfOverBudget();
   }
   return success;
 }
@@ -123,9 +155,10 @@ bool DomStorageArea::RemoveItem(const string16& key, string16* old_value) {
   if (!map_->HasOneRef())
     map_ = map_->DeepCopy();
   bool success = map_->RemoveItem(key, old_value);
-  if (success && backing_.get()) {
+  if (success && HasBacking()) {
     CommitBatch* commit_batch = CreateCommitBatchIfNeeded();
-    commit_batch->changed_values[key] = NullableString16(true);
+    commit_batch->AddChange(key, NullableString16(true));
+    CommitIfOverBudget();
   }
   return success;
 }
@@ -139,10 +172,11 @@ bool DomStorageArea::Clear() {
 
   map_ = new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance);
 
-  if (backing_.get()) {
+  if (HasBacking()) {
     CommitBatch* commit_batch = CreateCommitBatchIfNeeded();
     commit_batch->clear_all_first = true;
     commit_batch->changed_values.clear();
+    commit_batch->changed_bytes = 0;
   }
 
   return true;
@@ -151,7 +185,7 @@ bool DomStorageArea::Clear() {
 DomStorageArea* DomStorageArea::ShallowCopy(int64 destination_namespace_id) {
   DCHECK_NE(kLocalStorageNamespaceId, namespace_id_);
   DCHECK_NE(kLocalStorageNamespaceId, destination_namespace_id);
-  DCHECK(!backing_.get());  // SessionNamespaces aren't stored on disk.
+  DCHECK(!HasBacking());  // SessionNamespaces aren't stored on disk.
 
   DomStorageArea* copy = new DomStorageArea(destination_namespace_id, origin_,
                                             FilePath(), task_runner_);
@@ -177,7 +211,15 @@ void DomStorageArea::DeleteOrigin() {
     return;
   }
   map_ = new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance);
-  if (backing_.get()) {
+  if (log_database_.get()) {
+    // The data lingers in the log until it is compacted, see
+    // DomStorageContext::DeleteOrigin().
+    is_initial_import_done_ = false;
+    log_database_->DeleteArea(origin_);
+    FilePath path = directory_.Append(DatabaseFileNameFromOrigin(origin_));
+    file_util::Delete(path, false);
+    file_util::Delete(DomStorageDatabase::GetJournalFilePath(path), false);
+  } else if (backing_.get()) {
     is_initial_import_done_ = false;
     backing_.reset(new DomStorageDatabase(backing_->file_path()));
     file_util::Delete(backing_->file_path(), false);
@@ -189,7 +231,7 @@ void DomStorageArea::DeleteOrigin() {
 void DomStorageArea::PurgeMemory() {
   DCHECK(!is_shutdown_);
   if (!is_initial_import_done_ ||  // We're not using any memory.
-      !backing_.get() ||  // We can't purge anything.
+      !HasBacking() ||  // We can't purge anything.
       HasUncommittedChanges())  // We leave things alone with changes pending.
     return;
 
@@ -198,15 +240,16 @@ void DomStorageArea::PurgeMemory() {
   map_ = new DomStorageMap(kPerAreaQuota + kPerAreaOverQuotaAllowance);
 
   // Recreate the database object, this frees up the open sqlite connection
-  // and its page cache.
-  backing_.reset(new DomStorageDatabase(backing_->file_path()));
+  // and its page cache. The log only keeps where values are in memory.
+  if (backing_.get())
+    backing_.reset(new DomStorageDatabase(backing_->file_path()));
 }
 
 void DomStorageArea::Shutdown() {
   DCHECK(!is_shutdown_);
   is_shutdown_ = true;
   map_ = NULL;
-  if (!backing_.get())
+  if (!HasBacking())
     return;
 
   bool success = task_runner_->PostShutdownBlockingTask(
@@ -221,14 +264,34 @@ void DomStorageArea::InitialImportIfNeeded() {
     return;
 
   DCHECK_EQ(kLocalStorageNamespaceId, namespace_id_);
-  DCHECK(backing_.get());
+  DCHECK(HasBacking());
 
   ValuesMap initial_values;
-  backing_->ReadAllValues(&initial_values);
+  if (log_database_.get()) {
+    log_database_->ReadAreaValues(origin_, &initial_values);
+    if (initial_values.empty())
+      MoveDatabaseFileToLog(&initial_values);
+  } else {
+    backing_->ReadAllValues(&initial_values);
+  }
   map_->SwapValues(&initial_values);
   is_initial_import_done_ = true;
 }
 
+void DomStorageArea::MoveDatabaseFileToLog(ValuesMap* values) {
+  FilePath path = directory_.Append(DatabaseFileNameFromOrigin(origin_));
+  if (!file_util::PathExists(path))
+    return;
+  DomStorageDatabase database(path);
+  database.ReadAllValues(values);
+  if (!values->empty() &&
+      !log_database_->CommitAreaChanges(origin_, false, *values)) {
+    return;  // Leave the file for the next time the area is read.
+  }
+  file_util::Delete(path, false);
+  file_util::Delete(DomStorageDatabase::GetJournalFilePath(path), false);
+}
+
 DomStorageArea::CommitBatch* DomStorageArea::CreateCommitBatchIfNeeded() {
   DCHECK(!is_shutdown_);
   if (!commit_batch_.get()) {
@@ -247,14 +310,24 @@ DomStorageArea::CommitBatch* DomStorageArea::CreateCommitBatchIfNeeded() {
   return commit_batch_.get();
 }
 
+void DomStorageArea::CommitIfOverBudget() {
+  // If a commit is in flight, this is checked again once it completes.
+  if (commit_batch_->changed_bytes > kCommitBatchBudget &&
+      !commit_batches_in_flight_) {
+    OnCommitTimer();
+  }
+}
+
 void DomStorageArea::OnCommitTimer() {
   DCHECK_EQ(kLocalStorageNamespaceId, namespace_id_);
   if (is_shutdown_)
     return;
 
-  DCHECK(backing_.get());
-  DCHECK(commit_batch_.get());
-  DCHECK(!commit_batches_in_flight_);
+  // The timer of a batch which went over budget may still fire after the
+  // batch was committed.
+  if (!commit_batch_.get() || commit_batches_in_flight_)
+    return;
+  DCHECK(HasBacking());
 
   // This method executes on the primary sequence, we schedule
   // a task for immediate execution on the commit sequence.
@@ -271,8 +344,7 @@ void DomStorageArea::OnCommitTimer() {
 void DomStorageArea::CommitChanges(const CommitBatch* commit_batch) {
   // This method executes on the commit sequence.
   DCHECK(task_runner_->IsRunningOnCommitSequence());
-  bool success = backing_->CommitChanges(commit_batch->clear_all_first,
-                                         commit_batch->changed_values);
+  bool success = WriteCommitBatch(commit_batch);
   DCHECK(success);  // TODO(michaeln): what if it fails?
   task_runner_->PostTask(
       FROM_HERE,
@@ -286,6 +358,10 @@ void DomStorageArea::OnCommitComplete() {
     return;
   --commit_batches_in_flight_;
   if (commit_batch_.get() && !commit_batches_in_flight_) {
+    if (commit_batch_->changed_bytes > kCommitBatchBudget) {
+      OnCommitTimer();
+      return;
+    }
     // More changes have accrued, restart the timer.
     task_runner_->PostDelayedTask(
         FROM_HERE,
@@ -297,16 +373,25 @@ void DomStorageArea::OnCommitComplete() {
 void DomStorageArea::ShutdownInCommitSequence() {
   // This method executes on the commit sequence.
   DCHECK(task_runner_->IsRunningOnCommitSequence());
-  DCHECK(backing_.get());
+  DCHECK(HasBacking());
   if (commit_batch_.get()) {
     // Commit any changes that accrued prior to the timer firing.
-    bool success = backing_->CommitChanges(
-        commit_batch_->clear_all_first,
-        commit_batch_->changed_values);
+    bool success = WriteCommitBatch(commit_batch_.get());
     DCHECK(success);
   }
   commit_batch_.reset();
   backing_.reset();
+  log_database_ = NULL;
+}
+
+bool DomStorageArea::WriteCommitBatch(const CommitBatch* commit_batch) {
+  if (log_database_.get()) {
+    return log_database_->CommitAreaChanges(origin_,
+                                            commit_batch->clear_all_first,
+                                            commit_batch->changed_values);
+  }
+  return backing_->CommitChanges(commit_batch->clear_all_first,
+                                 commit_batch->changed_values);
 }
 
 }  // namespace dom_storage
@@ -13,6 +13,7 @@
 #include "base/string16.h"
 #include "googleurl/src/gurl.h"
 #include "webkit/dom_storage/dom_storage_database.h"
+#include "webkit/dom_storage/dom_storage_log_database.h"
 #include "webkit/dom_storage/dom_storage_types.h"
 
 namespace dom_storage {
@@ -36,6 +37,13 @@ class DomStorageArea
                  const FilePath& directory,
                  DomStorageTaskRunner* task_runner);
 
+  // Constructor for a local storage area backed by the log shared by all
+  // origins. The values in the database file of |origin| in the directory
+  // of the log, if there is one, are moved into the log when first read.
+  DomStorageArea(const GURL& origin,
+                 DomStorageLogDatabase* log_database,
+                 DomStorageTaskRunner* task_runner);
+
   const GURL& origin() const { return origin_; }
   int64 namespace_id() const { return namespace_id_; }
 
@@ -77,13 +85,19 @@ class DomStorageArea
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, CommitChangesAtShutdown);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, DeleteOrigin);
   FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, PurgeMemory);
+  FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, LogDatabaseBacking);
+  FRIEND_TEST_ALL_PREFIXES(DomStorageAreaTest, CommitBatchOverBudget);
   friend class base::RefCountedThreadSafe<DomStorageArea>;
 
   struct CommitBatch {
     bool clear_all_first;
     ValuesMap changed_values;
+    // The size of the keys and values in |changed_values|, in bytes.
+    size_t changed_bytes;
     CommitBatch();
     ~CommitBatch();
+
+    void AddChange(const string16& key, const NullableString16& value);
   };
 
   ~DomStorageArea();
@@ -93,12 +107,24 @@ class DomStorageArea
   // stored on disk.
   void InitialImportIfNeeded();
 
+  // Moves the values in the database file of this origin into the log,
+  // adding them to |values|.
+  void MoveDatabaseFileToLog(ValuesMap* values);
+
+  bool HasBacking() const {
+    return backing_.get() || log_database_.get();
+  }
+
   // Post tasks to defer writing a batch of changed values to
   // disk on the commit sequence, and to call back on the primary
   // task sequence when complete.
   CommitBatch* CreateCommitBatchIfNeeded();
+  // Commits the batch without waiting for the timer if it holds more than
+  // its share of memory.
+  void CommitIfOverBudget();
   void OnCommitTimer();
   void CommitChanges(const CommitBatch* commit_batch);
+  bool WriteCommitBatch(const CommitBatch* commit_batch);
   void OnCommitComplete();
 
   void ShutdownInCommitSequence();
@@ -109,6 +135,7 @@ class DomStorageArea
   scoped_refptr<DomStorageTaskRunner> task_runner_;
   scoped_refptr<DomStorageMap> map_;
   scoped_ptr<DomStorageDatabase> backing_;
+  scoped_refptr<DomStorageLogDatabase> log_database_;
   bool is_initial_import_done_;
   bool is_shutdown_;
   scoped_ptr<CommitBatch> commit_batch_;
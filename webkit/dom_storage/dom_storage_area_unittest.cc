@@ -12,6 +12,7 @@
 #include "base/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "webkit/dom_storage/dom_storage_area.h"
+#include "webkit/dom_storage/dom_storage_log_database.h"
 #include "webkit/dom_storage/dom_storage_task_runner.h"
 #include "webkit/dom_storage/dom_storage_types.h"
 
@@ -403,6 +404,118 @@ TEST_F(DomStorageAreaTest, PurgeMemory) {
   EXPECT_NE(original_map, area->map_.get());
 }
 
+TEST_F(DomStorageAreaTest, LogDatabaseBacking) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  scoped_refptr<DomStorageTaskRunner> task_runner(
+      new MockDomStorageTaskRunner(base::MessageLoopProxy::current()));
+  scoped_refptr<DomStorageLogDatabase> log_database(
+      new DomStorageLogDatabase(
+          temp_dir.path().Append(DomStorageLogDatabase::kLogFileName)));
+
+  // Put a value in the database file of the origin, as an area which does
+  // not use the log would have.
+  FilePath db_file_path = temp_dir.path().Append(
+      DomStorageArea::DatabaseFileNameFromOrigin(kOrigin));
+  {
+    DomStorageDatabase database(db_file_path);
+    ValuesMap changes;
+    changes[kKey] = NullableString16(kValue, false);
+    EXPECT_TRUE(database.CommitChanges(false, changes));
+  }
+
+  // The value is moved to the log when the area is first read.
+  scoped_refptr<DomStorageArea> area(
+      new DomStorageArea(kOrigin, log_database, task_runner));
+  EXPECT_FALSE(area->backing_.get());
+  EXPECT_FALSE(area->is_initial_import_done_);
+  EXPECT_EQ(kValue, area->GetItem(kKey).string());
+  EXPECT_FALSE(file_util::PathExists(db_file_path));
+  ValuesMap values;
+  log_database->ReadAreaValues(kOrigin, &values);
+  EXPECT_EQ(1u, values.size());
+
+  // Changes are committed to the log.
+  NullableString16 old_value;
+  EXPECT_TRUE(area->SetItem(kKey2, kValue2, &old_value));
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(area->HasUncommittedChanges());
+  values.clear();
+  log_database->ReadAreaValues(kOrigin, &values);
+  EXPECT_EQ(2u, values.size());
+  EXPECT_EQ(kValue2, values[kKey2].string());
+
+  // Purging memory leaves the log to read the values from again.
+  area->PurgeMemory();
+  EXPECT_FALSE(area->is_initial_import_done_);
+  EXPECT_EQ(2u, area->Length());
+
+  area->DeleteOrigin();
+  EXPECT_EQ(0u, area->Length());
+  values.clear();
+  log_database->ReadAreaValues(kOrigin, &values);
+  EXPECT_TRUE(values.empty());
+
+  // Changes accrued before shutdown are committed.
+  EXPECT_TRUE(area->SetItem(kKey, kValue, &old_value));
+  area->Shutdown();
+  MessageLoop::current()->RunAllPending();
+  EXPECT_TRUE(area->HasOneRef());
+  EXPECT_FALSE(area->log_database_.get());
+  values.clear();
+  log_database->ReadAreaValues(kOrigin, &values);
+  EXPECT_EQ(1u, values.size());
+}
+
+TEST_F(DomStorageAreaTest, CommitBatchOverBudget) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  scoped_refptr<DomStorageArea> area(
+      new DomStorageArea(kLocalStorageNamespaceId, kOrigin,
+          temp_dir.path(),
+          new MockDomStorageTaskRunner(base::MessageLoopProxy::current())));
+  area->backing_.reset(new DomStorageDatabase());
+
+  // Overwriting a value doesn't add up.
+  const string16 kBigValue(256 * 1024, 'a');
+  NullableString16 old_value;
+  for (int i = 0; i < 8; ++i)
+    EXPECT_TRUE(area->SetItem(kKey, kBigValue, &old_value));
+  EXPECT_TRUE(area->commit_batch_.get());
+  EXPECT_EQ(0, area->commit_batches_in_flight_);
+  EXPECT_EQ((kKey.size() + kBigValue.size()) * sizeof(char16),
+            area->commit_batch_->changed_bytes);
+
+  // Going over budget commits the batch without waiting for the timer.
+  EXPECT_TRUE(area->SetItem(kKey2, kBigValue, &old_value));
+  EXPECT_FALSE(area->commit_batch_.get());
+  EXPECT_EQ(1, area->commit_batches_in_flight_);
+
+  // Changes which go over budget while a commit is in flight are committed
+  // once it completes.
+  EXPECT_TRUE(area->SetItem(kKey, kValue, &old_value));
+  EXPECT_TRUE(area->SetItem(kKey2, string16(), &old_value));
+  string16 removed_value;
+  EXPECT_TRUE(area->RemoveItem(kKey2, &removed_value));
+  EXPECT_EQ(kKey.size() * sizeof(char16) + kValue.size() * sizeof(char16) +
+                kKey2.size() * sizeof(char16),
+            area->commit_batch_->changed_bytes);
+  const string16 kKey3(ASCIIToUTF16("key3"));
+  const string16 kKey4(ASCIIToUTF16("key4"));
+  EXPECT_TRUE(area->SetItem(kKey3, kBigValue, &old_value));
+  EXPECT_TRUE(area->SetItem(kKey4, kBigValue, &old_value));
+  EXPECT_TRUE(area->commit_batch_.get());
+  EXPECT_EQ(1, area->commit_batches_in_flight_);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(area->HasUncommittedChanges());
+
+  ValuesMap values;
+  area->backing_->ReadAllValues(&values);
+  EXPECT_EQ(3u, values.size());
+  EXPECT_EQ(kValue, values[kKey].string());
+  EXPECT_EQ(kBigValue, values[kKey4].string());
+}
+
 TEST_F(DomStorageAreaTest, DatabaseFileNames) {
   struct {
     const char* origin;
@@ -4,12 +4,15 @@
 
 #include "webkit/dom_storage/dom_storage_context.h"
 
+#include <set>
+
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/file_util.h"
 #include "base/location.h"
 #include "base/time.h"
 #include "webkit/dom_storage/dom_storage_area.h"
+#include "webkit/dom_storage/dom_storage_log_database.h"
 #include "webkit/dom_storage/dom_storage_namespace.h"
 #include "webkit/dom_storage/dom_storage_task_runner.h"
 #include "webkit/dom_storage/dom_storage_types.h"
@@ -38,6 +41,10 @@ DomStorageContext::DomStorageContext(
   // namespace ids at one since zero is reserved for the
   // kLocalStorageNamespaceId.
   session_id_sequence_.GetNext();
+  if (!localstorage_directory_.empty()) {
+    log_database_ = new DomStorageLogDatabase(
+        localstorage_directory_.Append(DomStorageLogDatabase::kLogFileName));
+  }
 }
 
 DomStorageContext::~DomStorageContext() {
@@ -55,10 +62,11 @@ DomStorageNamespace* DomStorageContext::GetStorageNamespace(
           LOG(ERROR) << "Failed to create 'Local Storage' directory,"
                         " falling back to in-memory only.";
           localstorage_directory_ = FilePath();
+          log_database_ = NULL;
         }
       }
       DomStorageNamespace* local =
-          new DomStorageNamespace(localstorage_directory_, task_runner_);
+          new DomStorageNamespace(log_database_, task_runner_);
       namespaces_[kLocalStorageNamespaceId] = local;
       return local;
     }
@@ -71,6 +79,22 @@ void DomStorageContext::GetUsageInfo(std::vector<UsageInfo>* infos,
                                      bool include_file_info) {
   if (localstorage_directory_.empty())
     return;
+  std::vector<DomStorageLogDatabase::OriginInfo> log_infos;
+  log_database_->GetOrigins(&log_infos);
+  std::set<GURL> logged_origins;
+  for (size_t i = 0; i < log_infos.size(); ++i) {
+    UsageInfo info;
+    info.origin = log_infos[i].origin;
+    if (include_file_info) {
+      info.data_size = log_infos[i].data_size;
+      info.last_modified = log_infos[i].last_modified;
+    }
+    infos->push_back(info);
+    logged_origins.insert(info.origin);
+  }
+
+  // Also list the database files of origins which haven't been read since
+  // their data moved to the log.
   FileEnumerator enumerator(localstorage_directory_, false,
                             FileEnumerator::FILES);
   for (FilePath path = enumerator.Next(); !path.empty();
@@ -78,6 +102,8 @@ void DomStorageContext::GetUsageInfo(std::vector<UsageInfo>* infos,
     if (path.MatchesExtension(DomStorageArea::kDatabaseFileExtension)) {
       UsageInfo info;
       info.origin = DomStorageArea::OriginFromDatabaseFileName(path);
+      if (logged_origins.count(info.origin))
+        continue;
       if (include_file_info) {
         FileEnumerator::FindInfo find_info;
         enumerator.GetFindInfo(&find_info);
@@ -93,20 +119,27 @@ void DomStorageContext::DeleteOrigin(const GURL& origin) {
   DCHECK(!is_shutdown_);
   DomStorageNamespace* local = GetStorageNamespace(kLocalStorageNamespaceId);
   local->DeleteOrigin(origin);
+  CompactLogDatabase();
 }
 
 void DomStorageContext::DeleteDataModifiedSince(const base::Time& cutoff) {
   std::vector<UsageInfo> infos;
   const bool kIncludeFileInfo = true;
   GetUsageInfo(&infos, kIncludeFileInfo);
+  DomStorageNamespace* local = GetStorageNamespace(kLocalStorageNamespaceId);
+  bool deleted_any = false;
   for (size_t i = 0; i < infos.size(); ++i) {
     if (infos[i].last_modified > cutoff) {
       if (!special_storage_policy_ ||
           !special_storage_policy_->IsStorageProtected(infos[i].origin)) {
-        DeleteOrigin(infos[i].origin);
+        local->DeleteOrigin(infos[i].origin);
+        deleted_any = true;
       }
     }
   }
+  // Compact once for all of the origins.
+  if (deleted_any)
+    CompactLogDatabase();
 }
 
 void DomStorageContext::PurgeMemory() {
@@ -227,6 +260,7 @@ void DomStorageContext::ClearLocalStateInCommitSequence() {
         !special_storage_policy_->IsStorageSessionOnly(origin))
       continue;
 
+    log_database_->DeleteArea(origin);
     const bool kNotRecursive = false;
     FilePath database_file_path = localstorage_directory_.Append(
         DomStorageArea::DatabaseFileNameFromOrigin(origin));
@@ -235,6 +269,18 @@ void DomStorageContext::ClearLocalStateInCommitSequence() {
         DomStorageDatabase::GetJournalFilePath(database_file_path),
         kNotRecursive);
   }
+  log_database_->Compact();
+}
+
+void DomStorageContext::CompactLogDatabase() {
+  if (!log_database_.get())
+    return;
+  bool success = task_runner_->PostShutdownBlockingTask(
+      FROM_HERE,
+      DomStorageTaskRunner::COMMIT_SEQUENCE,
+      base::Bind(base::IgnoreResult(&DomStorageLogDatabase::Compact),
+                 log_database_));
+  DCHECK(success);
 }
 
 }  // namespace dom_storage
@@ -32,6 +32,7 @@ class SpecialStoragePolicy;
 namespace dom_storage {
 
 class DomStorageArea;
+class DomStorageLogDatabase;
 class DomStorageNamespace;
 class DomStorageSession;
 class DomStorageTaskRunner;
@@ -169,12 +170,21 @@ class DomStorageContext
 
   void ClearLocalStateInCommitSequence();
 
+  // Rewrites the log without the data of deleted origins, rather than leave
+  // it on disk until enough commits have happened for the log to compact
+  // itself.
+  void CompactLogDatabase();
+
   // Collection of namespaces keyed by id.
   StorageNamespaceMap namespaces_;
 
   // Where localstorage data is stored, maybe empty for the incognito use case.
   FilePath localstorage_directory_;
 
+  // The log in |localstorage_directory_| which holds the localstorage data
+  // of all origins, NULL if the directory is empty.
+  scoped_refptr<DomStorageLogDatabase> log_database_;
+
   // Where sessionstorage data is stored, maybe empty for the incognito use
   // case. Always empty until the file-backed session storage feature is
   // implemented.
@@ -0,0 +1,628 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "webkit/dom_storage/dom_storage_log_database.h"
+
+#include <algorithm>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+
+// Layout of the log:
+// | header  | "DSLOG001"                                                 |
+// | batch   | uint32 size of the records | record | record | ...         |
+// | record  | uint32 size of the pickle  | pickle | padding to 4 bytes    |
+// | pickle  | int type | origin spec | int64 time | key | value (SET_ITEM) |
+//
+// Each commit appends one batch, which is ignored along with everything
+// after it when the log is read if it was not written in full. Compaction
+// writes one batch per origin, starting with a CLEAR_AREA record which holds
+// the time the origin was last modified.
+
+namespace dom_storage {
+
+namespace {
+
+const char kLogHeader[] = "DSLOG001";
+const int kLogHeaderSize = sizeof(kLogHeader) - 1;
+const int kSizeFieldSize = sizeof(uint32);
+
+// The size of the chunks the log is read in.
+const int kReadChunkSize = 64 * 1024;
+
+// Logs smaller than this are never compacted.
+const int64 kMinCompactionSize = 1024 * 1024;
+
+const FilePath::CharType kCompactionSuffix[] = FILE_PATH_LITERAL("-compact");
+
+void AppendSize(uint32 size, std::string* data) {
+  data->append(reinterpret_cast<const char*>(&size), sizeof(size));
+}
+
+uint32 ReadSize(const char* data) {
+  uint32 size;
+  memcpy(&size, data, sizeof(size));
+  return size;
+}
+
+// Records are padded so that the pickles are aligned in memory when the log
+// is.
+int64 GetRecordSize(int64 pickle_size) {
+  return kSizeFieldSize + (pickle_size + 3) / 4 * 4;
+}
+
+// Keeps the bytes of a log file which are being read in order, some of them
+// ahead of time to read it kReadChunkSize bytes at a time.
+class LogReader {
+ public:
+  LogReader(base::PlatformFile file, int64 file_size)
+      : file_(file), file_size_(file_size), buffer_offset_(0) {}
+
+  // Returns the |length| bytes at |offset|, or NULL if the log is too short.
+  // Reads are cheapest in the order of their offsets.
+  const char* Read(int64 offset, int length) {
+    if (offset < buffer_offset_) {
+      buffer_.clear();
+      buffer_offset_ = offset;
+    }
+    int64 buffer_end = buffer_offset_ + static_cast<int64>(buffer_.size());
+    if (offset + length <= buffer_end)
+      return buffer_.data() + (offset - buffer_offset_);
+
+    if (offset < buffer_end)
+      buffer_.erase(0, static_cast<size_t>(offset - buffer_offset_));
+    else
+      buffer_.clear();
+    buffer_offset_ = offset;
+
+    int buffered = static_cast<int>(buffer_.size());
+    int64 to_read = std::min<int64>(
+        std::max(length - buffered, kReadChunkSize),
+        file_size_ - offset - buffered);
+    if (buffered + to_read < length)
+      return NULL;
+    buffer_.resize(buffered + static_cast<size_t>(to_read));
+    int read = base::ReadPlatformFile(file_, offset + buffered,
+                                      &buffer_[buffered],
+                                      static_cast<int>(to_read));
+    if (read != to_read) {
+      buffer_.resize(buffered);
+      return NULL;
+    }
+    return buffer_.data();
+  }
+
+ private:
+  base::PlatformFile file_;
+  int64 file_size_;
+  std::string buffer_;
+  // The offset in the file of |buffer_|.
+  int64 buffer_offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogReader);
+};
+
+}  // namespace
+
+// A live record, for reading the live records of an origin in the order they
+// are in the file.
+struct DomStorageLogDatabase::LocationAndKey {
+  const RecordLocation* location;
+  const string16* key;
+
+  static bool IsBefore(const LocationAndKey& a, const LocationAndKey& b) {
+    return a.location->offset < b.location->offset;
+  }
+};
+
+// static
+void DomStorageLogDatabase::GetSortedLocations(
+    const KeyMap& keys, std::vector<LocationAndKey>* locations) {
+  locations->reserve(keys.size());
+  for (KeyMap::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+    LocationAndKey location = { &it->second, &it->first };
+    locations->push_back(location);
+  }
+  std::sort(locations->begin(), locations->end(), LocationAndKey::IsBefore);
+}
+
+DomStorageLogDatabase::OriginInfo::OriginInfo() : data_size(0) {}
+DomStorageLogDatabase::OriginInfo::~OriginInfo() {}
+
+DomStorageLogDatabase::OriginEntry::OriginEntry()
+    : record_bytes(0), data_size(0), compaction_overhead(0) {}
+DomStorageLogDatabase::OriginEntry::~OriginEntry() {}
+
+// static
+const FilePath::CharType DomStorageLogDatabase::kLogFileName[] =
+    FILE_PATH_LITERAL("localstorage.log");
+
+DomStorageLogDatabase::DomStorageLogDatabase(const FilePath& file_path)
+    : file_path_(file_path),
+      file_(base::kInvalidPlatformFileValue),
+      file_size_(0),
+      live_bytes_(0),
+      failed_to_open_(false) {
+}
+
+DomStorageLogDatabase::~DomStorageLogDatabase() {
+  Close();
+}
+
+void DomStorageLogDatabase::ReadAreaValues(const GURL& origin,
+                                           ValuesMap* result) {
+  base::AutoLock auto_lock(lock_);
+  // We don't create a log if it doesn't exist. In that case, there is
+  // nothing to be added to the result.
+  if (!LazyOpen(false))
+    return;
+  OriginMap::const_iterator found = origins_.find(origin.spec());
+  if (found == origins_.end())
+    return;
+
+  // Read the values in the order they are in the file, so records written
+  // together are read together.
+  std::vector<LocationAndKey> locations;
+  GetSortedLocations(found->second.keys, &locations);
+
+  LogReader reader(file_, file_size_);
+  for (size_t i = 0; i < locations.size(); ++i) {
+    const RecordLocation& location = *locations[i].location;
+    const char* data = reader.Read(location.offset, location.size);
+    Record record;
+    if (!data || !ParseRecord(data, location.size, &record) ||
+        record.type != SET_ITEM || record.key != *locations[i].key) {
+      NOTREACHED() << "The log changed under us.";
+      continue;
+    }
+    (*result)[record.key] = NullableString16(record.value, false);
+  }
+}
+
+bool DomStorageLogDatabase::CommitAreaChanges(const GURL& origin,
+                                              bool clear_all_first,
+                                              const ValuesMap& changes) {
+  base::AutoLock auto_lock(lock_);
+  if (!LazyOpen(true))
+    return false;
+
+  const std::string spec = origin.spec();
+  const base::Time now = base::Time::Now();
+  std::vector<Record> records;
+  records.reserve(changes.size() + 1);
+  if (clear_all_first)
+    records.push_back(Record(CLEAR_AREA, spec, now));
+  for (ValuesMap::const_iterator it = changes.begin(); it != changes.end();
+       ++it) {
+    Record record(it->second.is_null() ? REMOVE_ITEM : SET_ITEM, spec, now);
+    record.key = it->first;
+    record.value = it->second.string();
+    records.push_back(record);
+  }
+  if (records.empty())
+    return true;
+
+  if (!WriteBatch(records))
+    return false;
+  if (ShouldCompact())
+    CompactLocked();
+  return true;
+}
+
+bool DomStorageLogDatabase::DeleteArea(const GURL& origin) {
+  base::AutoLock auto_lock(lock_);
+  // If there is no log there is nothing to delete.
+  if (!LazyOpen(false))
+    return true;
+  const std::string spec = origin.spec();
+  if (origins_.find(spec) == origins_.end())
+    return true;
+
+  std::vector<Record> records(
+      1, Record(CLEAR_AREA, spec, base::Time::Now()));
+  if (!WriteBatch(records))
+    return false;
+  origins_.erase(spec);
+  return true;
+}
+
+void DomStorageLogDatabase::GetOrigins(std::vector<OriginInfo>* infos) {
+  base::AutoLock auto_lock(lock_);
+  if (!LazyOpen(false))
+    return;
+  for (OriginMap::const_iterator it = origins_.begin(); it != origins_.end();
+       ++it) {
+    if (it->second.keys.empty())
+      continue;
+    OriginInfo info;
+    info.origin = GURL(it->first);
+    info.data_size = it->second.data_size;
+    info.last_modified = it->second.last_modified;
+    infos->push_back(info);
+  }
+}
+
+bool DomStorageLogDatabase::Compact() {
+  base::AutoLock auto_lock(lock_);
+  if (!LazyOpen(false))
+    return true;
+  if (!GetDeadBytes())
+    return true;
+  return CompactLocked();
+}
+
+DomStorageLogDatabase::Record::Record() : type(SET_ITEM) {}
+
+DomStorageLogDatabase::Record::Record(RecordType type,
+                                      const std::string& origin,
+                                      const base::Time& time)
+    : type(type), origin(origin), time(time) {
+}
+
+DomStorageLogDatabase::Record::~Record() {}
+
+bool DomStorageLogDatabase::LazyOpen(bool create_if_needed) {
+  lock_.AssertAcquired();
+  if (failed_to_open_) {
+    // Don't try to open a log that we know has failed already.
+    return false;
+  }
+  if (file_ != base::kInvalidPlatformFileValue)
+    return true;
+
+  if (!create_if_needed && !file_util::PathExists(file_path_)) {
+    // If the file doesn't exist already and we haven't been asked to create
+    // a file on disk, then we don't bother opening the log. This means we
+    // wait until we absolutely need to put something onto disk before we do
+    // so.
+    return false;
+  }
+
+  if (!OpenFile(base::PLATFORM_FILE_OPEN_ALWAYS) || !ReadIndex()) {
+    // The log is unusable, start over with an empty one.
+    LOG(ERROR) << "Local storage log " << file_path_.value()
+               << " is corrupt, deleting it.";
+    Close();
+    if (!OpenFile(base::PLATFORM_FILE_CREATE_ALWAYS) || !ReadIndex()) {
+      Close();
+      failed_to_open_ = true;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DomStorageLogDatabase::OpenFile(int create_flag) {
+  base::PlatformFileError error;
+  file_ = base::CreatePlatformFile(
+      file_path_,
+      create_flag | base::PLATFORM_FILE_READ | base::PLATFORM_FILE_WRITE,
+      NULL, &error);
+  return file_ != base::kInvalidPlatformFileValue;
+}
+
+bool DomStorageLogDatabase::ReadIndex() {
+  origins_.clear();
+  live_bytes_ = 0;
+  base::PlatformFileInfo info;
+  if (!base::GetPlatformFileInfo(file_, &info))
+    return false;
+  file_size_ = info.size;
+
+  if (file_size_ == 0) {
+    // A new log.
+    if (base::WritePlatformFile(file_, 0, kLogHeader, kLogHeaderSize) !=
+        kLogHeaderSize) {
+      return false;
+    }
+    file_size_ = kLogHeaderSize;
+    return true;
+  }
+
+  LogReader reader(file_, file_size_);
+  const char* header = reader.Read(0, kLogHeaderSize);
+  if (!header || memcmp(header, kLogHeader, kLogHeaderSize) != 0)
+    return false;
+
+  int64 offset = kLogHeaderSize;
+  while (offset < file_size_) {
+    const char* data = reader.Read(offset, kSizeFieldSize);
+    if (!data)
+      break;
+    uint32 batch_size = ReadSize(data);
+    int64 batch_end = offset + kSizeFieldSize + batch_size;
+    // Check the whole batch was written before applying any of it.
+    if (batch_end > file_size_)
+      break;
+
+    std::vector<std::pair<Record, RecordLocation> > batch;
+    int64 record_offset = offset + kSizeFieldSize;
+    while (record_offset < batch_end) {
+      data = reader.Read(record_offset, kSizeFieldSize);
+      if (!data)
+        break;
+      int64 record_size = GetRecordSize(ReadSize(data));
+      if (record_offset + record_size > batch_end)
+        break;
+      RecordLocation location;
+      location.offset = record_offset;
+      location.size = static_cast<int>(record_size);
+      data = reader.Read(record_offset, location.size);
+      Record record;
+      if (!data || !ParseRecord(data, location.size, &record))
+        break;
+      batch.push_back(std::make_pair(record, location));
+      record_offset += location.size;
+    }
+    if (record_offset != batch_end)
+      break;
+
+    for (size_t i = 0; i < batch.size(); ++i)
+      IndexRecord(batch[i].first, batch[i].second);
+    offset = batch_end;
+  }
+
+  if (offset < file_size_) {
+    // The last commit did not make it to disk in full, drop what there is of
+    // it.
+    LOG(WARNING) << "Dropping " << (file_size_ - offset)
+                 << " bytes from the end of " << file_path_.value();
+    if (!base::TruncatePlatformFile(file_, offset))
+      return false;
+    file_size_ = offset;
+  }
+  return true;
+}
+
+// static
+int DomStorageLogDatabase::AppendRecord(const Record& record,
+                                        std::string* data) {
+  Pickle pickle;
+  pickle.WriteInt(record.type);
+  pickle.WriteString(record.origin);
+  pickle.WriteInt64(record.time.ToInternalValue());
+  pickle.WriteString16(record.key);
+  if (record.type == SET_ITEM)
+    pickle.WriteString16(record.value);
+
+  int record_size = GetRecordSize(pickle.size());
+  AppendSize(pickle.size(), data);
+  data->append(static_cast<const char*>(pickle.data()), pickle.size());
+  data->append(record_size - kSizeFieldSize - pickle.size(), '\0');
+  return record_size;
+}
+
+// static
+bool DomStorageLogDatabase::ParseRecord(const char* data,
+                                        int size,
+                                        Record* record) {
+  if (size < kSizeFieldSize)
+    return false;
+  uint32 pickle_size = ReadSize(data);
+  if (GetRecordSize(pickle_size) != size)
+    return false;
+  Pickle pickle(data + kSizeFieldSize, pickle_size);
+  if (!pickle.data())
+    return false;
+  PickleIterator iter(pickle);
+  int type;
+  int64 time;
+  if (!pickle.ReadInt(&iter, &type) ||
+      !pickle.ReadString(&iter, &record->origin) ||
+      !pickle.ReadInt64(&iter, &time) ||
+      !pickle.ReadString16(&iter, &record->key)) {
+    return false;
+  }
+  record->time = base::Time::FromInternalValue(time);
+  switch (type) {
+    case SET_ITEM:
+      if (!pickle.ReadString16(&iter, &record->value))
+        return false;
+      break;
+    case REMOVE_ITEM:
+    case CLEAR_AREA:
+      record->value.clear();
+      break;
+    default:
+      return false;
+  }
+  record->type = static_cast<RecordType>(type);
+  return true;
+}
+
+void DomStorageLogDatabase::IndexRecord(const Record& record,
+                                        const RecordLocation& location) {
+  OriginEntry& entry = origins_[record.origin];
+  if (!entry.compaction_overhead) {
+    std::string clear_record;
+    entry.compaction_overhead = kSizeFieldSize + AppendRecord(
+        Record(CLEAR_AREA, record.origin, base::Time()), &clear_record);
+  }
+  entry.last_modified = std::max(entry.last_modified, record.time);
+
+  if (record.type == CLEAR_AREA) {
+    live_bytes_ -= entry.record_bytes;
+    entry.keys.clear();
+    entry.record_bytes = 0;
+    entry.data_size = 0;
+    return;
+  }
+
+  KeyMap::iterator found = entry.keys.find(record.key);
+  if (found != entry.keys.end()) {
+    live_bytes_ -= found->second.size;
+    entry.record_bytes -= found->second.size;
+    entry.data_size -= found->first.size() * sizeof(char16) +
+                       found->second.value_size;
+    entry.keys.erase(found);
+  }
+  if (record.type == SET_ITEM) {
+    RecordLocation& new_location = entry.keys[record.key];
+    new_location = location;
+    new_location.value_size = record.value.size() * sizeof(char16);
+    live_bytes_ += location.size;
+    entry.record_bytes += location.size;
+    entry.data_size += record.key.size() * sizeof(char16) +
+                       new_location.value_size;
+  }
+}
+
+bool DomStorageLogDatabase::WriteBatch(const std::vector<Record>& records) {
+  std::string data;
+  AppendSize(0, &data);
+  std::vector<int> record_sizes(records.size());
+  for (size_t i = 0; i < records.size(); ++i)
+    record_sizes[i] = AppendRecord(records[i], &data);
+  uint32 batch_size = data.size() - kSizeFieldSize;
+  memcpy(&data[0], &batch_size, sizeof(batch_size));
+
+  int written = base::WritePlatformFile(file_, file_size_, data.data(),
+                                        data.size());
+  if (written != static_cast<int>(data.size())) {
+    // Don't leave part of a batch for the next one to be appended after.
+    base::TruncatePlatformFile(file_, file_size_);
+    return false;
+  }
+
+  RecordLocation location;
+  location.offset = file_size_ + kSizeFieldSize;
+  for (size_t i = 0; i < records.size(); ++i) {
+    location.size = record_sizes[i];
+    IndexRecord(records[i], location);
+    location.offset += location.size;
+  }
+  file_size_ += data.size();
+  return true;
+}
+
+int64 DomStorageLogDatabase::GetDeadBytes() const {
+  // A compacted log has a batch for each origin, holding a CLEAR_AREA record
+  // and the live records of the origin.
+  int64 compacted_size = kLogHeaderSize + live_bytes_;
+  for (OriginMap::const_iterator it = origins_.begin(); it != origins_.end();
+       ++it) {
+    if (!it->second.keys.empty())
+      compacted_size += it->second.compaction_overhead;
+  }
+  return file_size_ - compacted_size;
+}
+
+bool DomStorageLogDatabase::ShouldCompact() const {
+  if (file_size_ < kMinCompactionSize)
+    return false;
+  // Skip counting the overhead of each origin when the log is mostly live
+  // records anyway.
+  if (file_size_ - kLogHeaderSize - live_bytes_ <= live_bytes_)
+    return false;
+  return GetDeadBytes() > live_bytes_;
+}
+
+bool DomStorageLogDatabase::CompactLocked() {
+  lock_.AssertAcquired();
+  DCHECK_NE(base::kInvalidPlatformFileValue, file_);
+
+  FilePath compaction_path(file_path_.value() + kCompactionSuffix);
+  base::PlatformFileError error;
+  base::PlatformFile compacted = base::CreatePlatformFile(
+      compaction_path,
+      base::PLATFORM_FILE_CREATE_ALWAYS | base::PLATFORM_FILE_WRITE,
+      NULL, &error);
+  if (compacted == base::kInvalidPlatformFileValue)
+    return false;
+
+  // Copy the live records, an origin at a time, and note where they end up.
+  OriginMap compacted_origins;
+  int64 compacted_size = 0;
+  std::string data(kLogHeader, kLogHeaderSize);
+  LogReader reader(file_, file_size_);
+  bool success = true;
+  for (OriginMap::const_iterator it = origins_.begin();
+       success && it != origins_.end(); ++it) {
+    const OriginEntry& entry = it->second;
+    if (entry.keys.empty())
+      continue;
+
+    std::vector<LocationAndKey> locations;
+    GetSortedLocations(entry.keys, &locations);
+
+    size_t batch_start = data.size();
+    AppendSize(0, &data);
+    AppendRecord(Record(CLEAR_AREA, it->first, entry.last_modified), &data);
+    OriginEntry& compacted_entry = compacted_origins[it->first];
+    compacted_entry.last_modified = entry.last_modified;
+    compacted_entry.record_bytes = entry.record_bytes;
+    compacted_entry.data_size = entry.data_size;
+    compacted_entry.compaction_overhead = entry.compaction_overhead;
+    for (size_t i = 0; i < locations.size(); ++i) {
+      const RecordLocation& old_location = *locations[i].location;
+      const char* record = reader.Read(old_location.offset, old_location.size);
+      if (!record) {
+        success = false;
+        break;
+      }
+      RecordLocation& location = compacted_entry.keys[*locations[i].key];
+      location = old_location;
+      location.offset = compacted_size + data.size();
+      data.append(record, old_location.size);
+    }
+    uint32 batch_size = data.size() - batch_start - kSizeFieldSize;
+    memcpy(&data[batch_start], &batch_size, sizeof(batch_size));
+
+    // Write what we have once the batch is complete, so only the batch size
+    // has to be patched in |data|.
+    if (data.size() >= static_cast<size_t>(kReadChunkSize)) {
+      if (base::WritePlatformFile(compacted, compacted_size, data.data(),
+                                  data.size()) !=
+          static_cast<int>(data.size())) {
+        success = false;
+      }
+      compacted_size += data.size();
+      data.clear();
+    }
+  }
+  if (success && !data.empty()) {
+    if (base::WritePlatformFile(compacted, compacted_size, data.data(),
+                                data.size()) !=
+        static_cast<int>(data.size())) {
+      success = false;
+    }
+    compacted_size += data.size();
+  }
+  success = success && base::FlushPlatformFile(compacted);
+  base::ClosePlatformFile(compacted);
+  if (!success) {
+    file_util::Delete(compaction_path, false);
+    return false;
+  }
+
+  // The log has to be closed for it to be replaced on Windows.
+  Close();
+  if (!file_util::ReplaceFile(compaction_path, file_path_)) {
+    file_util::Delete(compaction_path, false);
+    if (!OpenFile(base::PLATFORM_FILE_OPEN)) {
+      failed_to_open_ = true;
+      origins_.clear();
+      live_bytes_ = 0;
+    }
+    return false;
+  }
+  if (!OpenFile(base::PLATFORM_FILE_OPEN)) {
+    failed_to_open_ = true;
+    origins_.clear();
+    live_bytes_ = 0;
+    return false;
+  }
+  origins_.swap(compacted_origins);
+  file_size_ = compacted_size;
+  return true;
+}
+
+void DomStorageLogDatabase::Close() {
+  if (file_ != base::kInvalidPlatformFileValue)
+    base::ClosePlatformFile(file_);
+  file_ = base::kInvalidPlatformFileValue;
+}
+
+}  // namespace dom_storage
@@ -0,0 +1,195 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef WEBKIT_DOM_STORAGE_DOM_STORAGE_LOG_DATABASE_H_
+#define WEBKIT_DOM_STORAGE_DOM_STORAGE_LOG_DATABASE_H_
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/gtest_prod_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/platform_file.h"
+#include "base/string16.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+#include "googleurl/src/gurl.h"
+#include "webkit/dom_storage/dom_storage_types.h"
+
+namespace dom_storage {
+
+// DomStorageLogDatabase holds the local storage data of all origins in a
+// single log file. A commit appends a record for each key it changes, so its
+// cost depends on the size of the changes rather than on the size of the
+// area, and the file is compacted once it holds more overwritten records than
+// live ones. Only the location of the live records is kept in memory, the
+// values are read back from the file when an area is loaded.
+//
+// All local storage DomStorageAreas share the same DomStorageLogDatabase.
+class DomStorageLogDatabase
+    : public base::RefCountedThreadSafe<DomStorageLogDatabase> {
+ public:
+  struct OriginInfo {
+    GURL origin;
+    // The size of the keys and values stored for the origin.
+    size_t data_size;
+    base::Time last_modified;
+
+    OriginInfo();
+    ~OriginInfo();
+  };
+
+  // The name of the log file in the local storage directory.
+  static const FilePath::CharType kLogFileName[];
+
+  explicit DomStorageLogDatabase(const FilePath& file_path);
+
+  // Reads the (key, value) pairs for |origin|. |result| is assumed to be
+  // empty and any duplicate keys will be overwritten. If the log does not
+  // exist on disk then it will not be created and |result| will be
+  // unmodified.
+  void ReadAreaValues(const GURL& origin, ValuesMap* result);
+
+  // Updates the data for |origin|. Will remove all keys before updating the
+  // data if |clear_all_first| is set. Then all entries in |changes| will be
+  // examined - keys mapped to a null NullableString16 will be removed and all
+  // others will be inserted/updated as appropriate. May compact the log.
+  bool CommitAreaChanges(const GURL& origin,
+                         bool clear_all_first,
+                         const ValuesMap& changes);
+
+  // Deletes the data for |origin|. The data lingers in the file until the
+  // next compaction.
+  bool DeleteArea(const GURL& origin);
+
+  // Returns the origins which have data in the log.
+  void GetOrigins(std::vector<OriginInfo>* infos);
+
+  // Rewrites the log without the records which were overwritten or deleted,
+  // if it has any.
+  bool Compact();
+
+  const FilePath& file_path() const { return file_path_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<DomStorageLogDatabase>;
+  friend class DomStorageLogDatabaseTest;
+  FRIEND_TEST_ALL_PREFIXES(DomStorageLogDatabaseTest, CompactAfterCommits);
+
+  enum RecordType {
+    SET_ITEM = 1,
+    REMOVE_ITEM,
+    CLEAR_AREA,
+  };
+
+  struct Record {
+    Record();
+    Record(RecordType type, const std::string& origin, const base::Time& time);
+    ~Record();
+
+    RecordType type;
+    std::string origin;
+    base::Time time;
+    // Empty for CLEAR_AREA records.
+    string16 key;
+    // Empty for all but SET_ITEM records.
+    string16 value;
+  };
+
+  // Where the record holding the current value of a key is in the file.
+  struct RecordLocation {
+    int64 offset;
+    int size;
+    // The size of the value, in bytes.
+    int value_size;
+  };
+
+  typedef std::map<string16, RecordLocation> KeyMap;
+
+  struct OriginEntry {
+    OriginEntry();
+    ~OriginEntry();
+
+    KeyMap keys;
+    // The total size of the records in |keys|.
+    int64 record_bytes;
+    // The total size of the keys and values in |keys|.
+    size_t data_size;
+    // The size Compact() adds to the records of the origin.
+    int compaction_overhead;
+    base::Time last_modified;
+  };
+
+  // Keyed by origin spec.
+  typedef std::map<std::string, OriginEntry> OriginMap;
+
+  struct LocationAndKey;
+
+  // Returns the locations of |keys| in the order they are in the file, so
+  // records written together are read together.
+  static void GetSortedLocations(const KeyMap& keys,
+                                 std::vector<LocationAndKey>* locations);
+
+  ~DomStorageLogDatabase();
+
+  // Opens the log at |file_path_| and reads its index if it exists already,
+  // and creates it if |create_if_needed| is true. A log which can't be read
+  // is replaced by an empty one. Returns false if the log could not be
+  // opened or does not exist.
+  bool LazyOpen(bool create_if_needed);
+
+  bool OpenFile(int create_flag);
+
+  // Reads all the records of the log to build |origins_|, and truncates the
+  // log after the last batch which was written in full.
+  bool ReadIndex();
+
+  // Appends |record| to |data| and returns the number of bytes appended.
+  static int AppendRecord(const Record& record, std::string* data);
+
+  // Parses the |size| bytes at |data| into |record|.
+  static bool ParseRecord(const char* data, int size, Record* record);
+
+  // Updates |origins_| for |record|, which is at |location|.
+  void IndexRecord(const Record& record, const RecordLocation& location);
+
+  // Appends |records| to the log as a single batch and indexes them.
+  bool WriteBatch(const std::vector<Record>& records);
+
+  // Returns the number of bytes Compact() would save.
+  int64 GetDeadBytes() const;
+
+  // Whether the overwritten and deleted records outweigh the live ones for
+  // a log which is big enough to be worth compacting.
+  bool ShouldCompact() const;
+
+  bool CompactLocked();
+
+  void Close();
+
+  const FilePath file_path_;
+
+  // Protects all of the below, as the log is used from both the primary and
+  // the commit sequences.
+  base::Lock lock_;
+
+  base::PlatformFile file_;
+  int64 file_size_;
+
+  // The total size of the records in |origins_|.
+  int64 live_bytes_;
+
+  OriginMap origins_;
+
+  bool failed_to_open_;
+
+  DISALLOW_COPY_AND_ASSIGN(DomStorageLogDatabase);
+};
+
+}  // namespace dom_storage
+
+#endif  // WEBKIT_DOM_STORAGE_DOM_STORAGE_LOG_DATABASE_H_
@@ -0,0 +1,127 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/perftimer.h"
+#include "base/scoped_temp_dir.h"
+#include "base/stringprintf.h"
+#include "base/utf_string_conversions.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/dom_storage/dom_storage_area.h"
+#include "webkit/dom_storage/dom_storage_database.h"
+#include "webkit/dom_storage/dom_storage_log_database.h"
+
+namespace dom_storage {
+
+namespace {
+
+const int kOriginCount = 500;
+const int kKeysPerOrigin = 20;
+const int kCommitCount = 2000;
+const int kChangesPerCommit = 10;
+
+GURL OriginForIndex(int index) {
+  return GURL(base::StringPrintf("http://www.origin%d.com/", index));
+}
+
+// The changes a page writing to a few keys in a loop accrues between two
+// commits.
+ValuesMap MakeChanges(int commit) {
+  ValuesMap changes;
+  for (int i = 0; i < kChangesPerCommit; ++i) {
+    changes[ASCIIToUTF16(base::StringPrintf("key%d", i))] = NullableString16(
+        ASCIIToUTF16(base::StringPrintf("value %d of commit %d", i, commit)),
+        false);
+  }
+  return changes;
+}
+
+ValuesMap MakeOriginValues() {
+  ValuesMap values;
+  for (int i = 0; i < kKeysPerOrigin; ++i) {
+    values[ASCIIToUTF16(base::StringPrintf("key%d", i))] = NullableString16(
+        ASCIIToUTF16(std::string(200, 'a' + i)), false);
+  }
+  return values;
+}
+
+}  // namespace
+
+class DomStorageLogDatabasePerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  FilePath LogPath() const {
+    return temp_dir_.path().Append(DomStorageLogDatabase::kLogFileName);
+  }
+
+  FilePath DatabasePath(int origin_index) const {
+    return temp_dir_.path().Append(
+        DomStorageArea::DatabaseFileNameFromOrigin(
+            OriginForIndex(origin_index)));
+  }
+
+  ScopedTempDir temp_dir_;
+};
+
+TEST_F(DomStorageLogDatabasePerfTest, SetItemCommits) {
+  const GURL origin = OriginForIndex(0);
+  scoped_refptr<DomStorageLogDatabase> log(
+      new DomStorageLogDatabase(LogPath()));
+  PerfTimer log_timer;
+  for (int i = 0; i < kCommitCount; ++i)
+    ASSERT_TRUE(log->CommitAreaChanges(origin, false, MakeChanges(i)));
+  LogPerfResult("dom_storage_log_set_item",
+                log_timer.Elapsed().InMicroseconds() /
+                    static_cast<double>(kCommitCount * kChangesPerCommit),
+                "us/item");
+
+  DomStorageDatabase database(DatabasePath(0));
+  PerfTimer database_timer;
+  for (int i = 0; i < kCommitCount; ++i)
+    ASSERT_TRUE(database.CommitChanges(false, MakeChanges(i)));
+  LogPerfResult("dom_storage_database_set_item",
+                database_timer.Elapsed().InMicroseconds() /
+                    static_cast<double>(kCommitCount * kChangesPerCommit),
+                "us/item");
+}
+
+TEST_F(DomStorageLogDatabasePerfTest, LoadAllOrigins) {
+  const ValuesMap values = MakeOriginValues();
+  {
+    scoped_refptr<DomStorageLogDatabase> log(
+        new DomStorageLogDatabase(LogPath()));
+    for (int i = 0; i < kOriginCount; ++i) {
+      ASSERT_TRUE(log->CommitAreaChanges(OriginForIndex(i), false, values));
+      DomStorageDatabase database(DatabasePath(i));
+      ASSERT_TRUE(database.CommitChanges(false, values));
+    }
+  }
+
+  // A restart, which reads the data of every origin.
+  PerfTimer log_timer;
+  scoped_refptr<DomStorageLogDatabase> log(
+      new DomStorageLogDatabase(LogPath()));
+  for (int i = 0; i < kOriginCount; ++i) {
+    ValuesMap read_values;
+    log->ReadAreaValues(OriginForIndex(i), &read_values);
+    ASSERT_EQ(values.size(), read_values.size());
+  }
+  LogPerfResult("dom_storage_log_load", log_timer.Elapsed().InMillisecondsF(),
+                "ms");
+
+  PerfTimer database_timer;
+  for (int i = 0; i < kOriginCount; ++i) {
+    DomStorageDatabase database(DatabasePath(i));
+    ValuesMap read_values;
+    database.ReadAllValues(&read_values);
+    ASSERT_EQ(values.size(), read_values.size());
+  }
+  LogPerfResult("dom_storage_database_load",
+                database_timer.Elapsed().InMillisecondsF(), "ms");
+}
+
+}  // namespace dom_storage
@@ -0,0 +1,253 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "webkit/dom_storage/dom_storage_log_database.h"
+
+#include <string>
+
+#include "base/file_util.h"
+#include "base/scoped_temp_dir.h"
+#include "base/utf_string_conversions.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace dom_storage {
+
+class DomStorageLogDatabaseTest : public testing::Test {
+ public:
+  DomStorageLogDatabaseTest()
+      : kOrigin1("http://www.example.com/"),
+        kOrigin2("https://www.example.org/") {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    file_path_ = temp_dir_.path().Append(DomStorageLogDatabase::kLogFileName);
+    ReopenDatabase();
+  }
+
+ protected:
+  // Drops |db_| and reads the log from disk again.
+  void ReopenDatabase() {
+    db_ = new DomStorageLogDatabase(file_path_);
+  }
+
+  void CheckAreaData(const GURL& origin, const ValuesMap& expected) {
+    ValuesMap values;
+    db_->ReadAreaValues(origin, &values);
+    EXPECT_EQ(expected.size(), values.size());
+    for (ValuesMap::const_iterator it = expected.begin(); it != expected.end();
+         ++it) {
+      ValuesMap::const_iterator found = values.find(it->first);
+      ASSERT_TRUE(found != values.end());
+      EXPECT_EQ(it->second.string(), found->second.string());
+    }
+  }
+
+  int64 GetFileSize() {
+    int64 size = 0;
+    EXPECT_TRUE(file_util::GetFileSize(file_path_, &size));
+    return size;
+  }
+
+  const GURL kOrigin1;
+  const GURL kOrigin2;
+  ScopedTempDir temp_dir_;
+  FilePath file_path_;
+  scoped_refptr<DomStorageLogDatabase> db_;
+};
+
+TEST_F(DomStorageLogDatabaseTest, LazyOpenIsLazy) {
+  ValuesMap values;
+  db_->ReadAreaValues(kOrigin1, &values);
+  EXPECT_TRUE(values.empty());
+  std::vector<DomStorageLogDatabase::OriginInfo> infos;
+  db_->GetOrigins(&infos);
+  EXPECT_TRUE(infos.empty());
+  EXPECT_TRUE(db_->DeleteArea(kOrigin1));
+  EXPECT_TRUE(db_->Compact());
+  EXPECT_FALSE(file_util::PathExists(file_path_));
+
+  ValuesMap changes;
+  changes[ASCIIToUTF16("key")] = NullableString16(ASCIIToUTF16("value"),
+                                                  false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes));
+  EXPECT_TRUE(file_util::PathExists(file_path_));
+}
+
+TEST_F(DomStorageLogDatabaseTest, WriteAndReadBack) {
+  ValuesMap changes1;
+  changes1[ASCIIToUTF16("foo")] = NullableString16(ASCIIToUTF16("bar"),
+                                                   false);
+  changes1[ASCIIToUTF16("empty")] = NullableString16(string16(), false);
+  ValuesMap changes2;
+  changes2[ASCIIToUTF16("foo")] = NullableString16(ASCIIToUTF16("baz"),
+                                                   false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes1));
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin2, false, changes2));
+  CheckAreaData(kOrigin1, changes1);
+  CheckAreaData(kOrigin2, changes2);
+
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, changes1);
+  CheckAreaData(kOrigin2, changes2);
+}
+
+TEST_F(DomStorageLogDatabaseTest, RemoveAndClear) {
+  ValuesMap changes;
+  changes[ASCIIToUTF16("a")] = NullableString16(ASCIIToUTF16("1"), false);
+  changes[ASCIIToUTF16("b")] = NullableString16(ASCIIToUTF16("2"), false);
+  changes[ASCIIToUTF16("c")] = NullableString16(ASCIIToUTF16("3"), false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes));
+
+  ValuesMap removal;
+  removal[ASCIIToUTF16("b")] = NullableString16(true);
+  removal[ASCIIToUTF16("d")] = NullableString16(ASCIIToUTF16("4"), false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, removal));
+  ValuesMap expected;
+  expected[ASCIIToUTF16("a")] = NullableString16(ASCIIToUTF16("1"), false);
+  expected[ASCIIToUTF16("c")] = NullableString16(ASCIIToUTF16("3"), false);
+  expected[ASCIIToUTF16("d")] = NullableString16(ASCIIToUTF16("4"), false);
+  CheckAreaData(kOrigin1, expected);
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, expected);
+
+  // Values after the clear are kept.
+  ValuesMap after_clear;
+  after_clear[ASCIIToUTF16("e")] = NullableString16(ASCIIToUTF16("5"), false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, true, after_clear));
+  CheckAreaData(kOrigin1, after_clear);
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, after_clear);
+}
+
+TEST_F(DomStorageLogDatabaseTest, GetOriginsAndDeleteArea) {
+  base::Time before = base::Time::Now();
+  ValuesMap changes;
+  changes[ASCIIToUTF16("key")] = NullableString16(ASCIIToUTF16("value"),
+                                                  false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes));
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin2, false, changes));
+
+  ReopenDatabase();
+  std::vector<DomStorageLogDatabase::OriginInfo> infos;
+  db_->GetOrigins(&infos);
+  ASSERT_EQ(2u, infos.size());
+  EXPECT_EQ(kOrigin1, infos[0].origin);
+  EXPECT_EQ(kOrigin2, infos[1].origin);
+  EXPECT_EQ(8 * sizeof(char16), infos[0].data_size);
+  EXPECT_LE(before, infos[0].last_modified);
+
+  EXPECT_TRUE(db_->DeleteArea(kOrigin1));
+  CheckAreaData(kOrigin1, ValuesMap());
+  CheckAreaData(kOrigin2, changes);
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, ValuesMap());
+  CheckAreaData(kOrigin2, changes);
+  infos.clear();
+  db_->GetOrigins(&infos);
+  ASSERT_EQ(1u, infos.size());
+  EXPECT_EQ(kOrigin2, infos[0].origin);
+
+  // An origin with all its keys removed is not listed.
+  ValuesMap removal;
+  removal[ASCIIToUTF16("key")] = NullableString16(true);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin2, false, removal));
+  infos.clear();
+  db_->GetOrigins(&infos);
+  EXPECT_TRUE(infos.empty());
+}
+
+TEST_F(DomStorageLogDatabaseTest, CompactAfterCommits) {
+  // Overwrite the same value until the log is mostly overwritten records,
+  // which has the log compact itself.
+  const string16 kKey = ASCIIToUTF16("key");
+  ValuesMap changes;
+  for (int i = 0; i < 100; ++i) {
+    changes[kKey] = NullableString16(
+        string16(16 * 1024, static_cast<char16>('a' + i % 26)), false);
+    EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes));
+    EXPECT_GE(db_->file_size_ - db_->live_bytes_, 0);
+  }
+  EXPECT_LT(GetFileSize(), 2 * 1024 * 1024);
+  EXPECT_EQ(GetFileSize(), db_->file_size_);
+  CheckAreaData(kOrigin1, changes);
+
+  ValuesMap other_changes;
+  other_changes[kKey] = NullableString16(ASCIIToUTF16("other"), false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin2, false, other_changes));
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, changes);
+  CheckAreaData(kOrigin2, other_changes);
+
+  // Compacting removes deleted data from the file, and the log stays usable.
+  EXPECT_TRUE(db_->DeleteArea(kOrigin1));
+  EXPECT_TRUE(db_->Compact());
+  EXPECT_EQ(0, db_->GetDeadBytes());
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(file_path_, &contents));
+  // The last value written was all 'v's.
+  EXPECT_EQ(std::string::npos, contents.find("v\0v\0v\0v\0", 0, 8));
+  EXPECT_FALSE(file_util::PathExists(
+      FilePath(file_path_.value() + FILE_PATH_LITERAL("-compact"))));
+  CheckAreaData(kOrigin1, ValuesMap());
+  CheckAreaData(kOrigin2, other_changes);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes));
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, changes);
+  CheckAreaData(kOrigin2, other_changes);
+
+  // A compacted log stays as it is.
+  EXPECT_TRUE(db_->Compact());
+  int64 compacted_size = GetFileSize();
+  EXPECT_TRUE(db_->Compact());
+  EXPECT_EQ(compacted_size, GetFileSize());
+}
+
+TEST_F(DomStorageLogDatabaseTest, IncompleteBatch) {
+  ValuesMap changes;
+  changes[ASCIIToUTF16("key")] = NullableString16(ASCIIToUTF16("value"),
+                                                  false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes));
+  int64 complete_size = GetFileSize();
+  ValuesMap more_changes;
+  more_changes[ASCIIToUTF16("key2")] = NullableString16(
+      ASCIIToUTF16("value2"), false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, more_changes));
+
+  // Cut the last batch short, as a crash while writing it would.
+  db_ = NULL;
+  int64 full_size = GetFileSize();
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(file_path_, &contents));
+  contents.resize(full_size - 3);
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            file_util::WriteFile(file_path_, contents.data(),
+                                 contents.size()));
+
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, changes);
+  EXPECT_EQ(complete_size, GetFileSize());
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, more_changes));
+  ReopenDatabase();
+  ValuesMap expected(changes);
+  expected.insert(more_changes.begin(), more_changes.end());
+  CheckAreaData(kOrigin1, expected);
+}
+
+TEST_F(DomStorageLogDatabaseTest, FileThatIsNotALog) {
+  const char kData[] = "Not a log file";
+  ASSERT_EQ(static_cast<int>(sizeof(kData)),
+            file_util::WriteFile(file_path_, kData, sizeof(kData)));
+  CheckAreaData(kOrigin1, ValuesMap());
+
+  // The file is replaced by an empty log.
+  ValuesMap changes;
+  changes[ASCIIToUTF16("key")] = NullableString16(ASCIIToUTF16("value"),
+                                                  false);
+  EXPECT_TRUE(db_->CommitAreaChanges(kOrigin1, false, changes));
+  ReopenDatabase();
+  CheckAreaData(kOrigin1, changes);
+}
+
+}  // namespace dom_storage
@@ -7,16 +7,17 @@
 #include "base/basictypes.h"
 #include "base/logging.h"
 #include "webkit/dom_storage/dom_storage_area.h"
+#include "webkit/dom_storage/dom_storage_log_database.h"
 #include "webkit/dom_storage/dom_storage_task_runner.h"
 #include "webkit/dom_storage/dom_storage_types.h"
 
 namespace dom_storage {
 
 DomStorageNamespace::DomStorageNamespace(
-    const FilePath& directory,
+    DomStorageLogDatabase* log_database,
     DomStorageTaskRunner* task_runner)
     : namespace_id_(kLocalStorageNamespaceId),
-      directory_(directory),
+      log_database_(log_database),
       task_runner_(task_runner) {
 }
 
@@ -36,8 +37,9 @@ DomStorageArea* DomStorageNamespace::OpenStorageArea(const GURL& origin) {
     ++(holder->open_count_);
     return holder->area_;
   }
-  DomStorageArea* area = new DomStorageArea(namespace_id_, origin,
-                                            directory_, task_runner_);
+  DomStorageArea* area = log_database_.get() ?
+      new DomStorageArea(origin, log_database_, task_runner_) :
+      new DomStorageArea(namespace_id_, origin, FilePath(), task_runner_);
   areas_[origin] = AreaHolder(area, 1);
   return area;
 }
@@ -70,15 +72,15 @@ void DomStorageNamespace::DeleteOrigin(const GURL& origin) {
     holder->area_->DeleteOrigin();
     return;
   }
-  if (!directory_.empty()) {
+  if (log_database_.get()) {
     scoped_refptr<DomStorageArea> area =
-        new DomStorageArea(namespace_id_, origin, directory_, task_runner_);
+        new DomStorageArea(origin, log_database_, task_runner_);
     area->DeleteOrigin();
   }
 }
 
 void DomStorageNamespace::PurgeMemory() {
-  if (directory_.empty())
+  if (!log_database_.get())
     return;  // We can't purge w/o backing on disk.
   AreaMap::iterator it = areas_.begin();
   while (it != areas_.end()) {
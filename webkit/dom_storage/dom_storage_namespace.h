@@ -9,7 +9,6 @@
 #include <map>
 
 #include "base/basictypes.h"
-#include "base/file_path.h"
 #include "base/memory/ref_counted.h"
 
 class GURL;
@@ -17,6 +16,7 @@ class GURL;
 namespace dom_storage {
 
 class DomStorageArea;
+class DomStorageLogDatabase;
 class DomStorageTaskRunner;
 
 // Container for the set of per-origin Areas.
@@ -25,8 +25,8 @@ class DomStorageNamespace
     : public base::RefCountedThreadSafe<DomStorageNamespace> {
  public:
   // Constructor for a LocalStorage namespace with id of 0
-  // and an optional backing directory on disk.
-  DomStorageNamespace(const FilePath& directory,  // may be empty
+  // and an optional backing log on disk.
+  DomStorageNamespace(DomStorageLogDatabase* log_database,  // may be NULL
                       DomStorageTaskRunner* task_runner);
 
   // Constructor for a SessionStorage namespace with a non-zero id
@@ -71,7 +71,7 @@ class DomStorageNamespace
   AreaHolder* GetAreaHolder(const GURL& origin);
 
   int64 namespace_id_;
-  FilePath directory_;
+  scoped_refptr<DomStorageLogDatabase> log_database_;
   AreaMap areas_;
   scoped_refptr<DomStorageTaskRunner> task_runner_;
 };
@@ -23,12 +23,14 @@ namespace {
 
 // Definitions for database schema.
 
-const int kCurrentVersion = 4;
+const int kCurrentVersion = 5;
 const int kCompatibleVersion = 2;
 
 const char kHostQuotaTable[] = "HostQuotaTable";
 const char kOriginInfoTable[] = "OriginInfoTable";
+const char kOriginUsageTable[] = "OriginUsageTable";
 const char kIsOriginTableBootstrapped[] = "IsOriginTableBootstrapped";
+const char kIsUsageTableBootstrapped[] = "IsUsageTableBootstrapped";
 
 class HistogramUniquifier {
  public:
@@ -67,6 +69,12 @@ const QuotaDatabase::TableSchema QuotaDatabase::kTables[] = {
     " last_access_time INTEGER DEFAULT 0,"
     " last_modified_time INTEGER DEFAULT 0,"
     " UNIQUE(origin, type))" },
+  { kOriginUsageTable,
+    "(origin TEXT NOT NULL,"
+    " type INTEGER NOT NULL,"
+    " client_id INTEGER NOT NULL,"
+    " usage INTEGER DEFAULT 0,"
+    " UNIQUE(origin, type, client_id))" },
 };
 
 // static
@@ -130,6 +138,23 @@ QuotaDatabase::OriginInfoTableEntry::OriginInfoTableEntry(
       last_modified_time(last_modified_time) {
 }
 
+QuotaDatabase::OriginUsageTableEntry::OriginUsageTableEntry()
+    : type(kStorageTypeUnknown),
+      client_id(QuotaClient::kUnknown),
+      usage(0) {
+}
+
+QuotaDatabase::OriginUsageTableEntry::OriginUsageTableEntry(
+    const GURL& origin,
+    StorageType type,
+    QuotaClient::ID client_id,
+    int64 usage)
+    : origin(origin),
+      type(type),
+      client_id(client_id),
+      usage(usage) {
+}
+
 // QuotaDatabase ------------------------------------------------------------
 QuotaDatabase::QuotaDatabase(const FilePath& path)
     : db_file_path_(path),
@@ -400,6 +425,77 @@ bool QuotaDatabase::SetOriginDatabaseBootstrapped(bool bootstrap_flag) {
   return meta_table_->SetValue(kIsOriginTableBootstrapped, bootstrap_flag);
 }
 
+bool QuotaDatabase::SetOriginUsage(
+    const GURL& origin, StorageType type, QuotaClient::ID client_id,
+    int64 usage) {
+  DCHECK_GE(usage, 0);
+  if (!LazyOpen(true))
+    return false;
+
+  sql::Statement statement;
+  if (usage > 0) {
+    const char* kSql =
+        "INSERT OR REPLACE INTO OriginUsageTable"
+        " (usage, origin, type, client_id)"
+        " VALUES (?, ?, ?, ?)";
+    statement.Assign(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+    statement.BindInt64(0, usage);
+    statement.BindString(1, origin.spec());
+    statement.BindInt(2, static_cast<int>(type));
+    statement.BindInt(3, static_cast<int>(client_id));
+  } else {
+    const char* kSql =
+        "DELETE FROM OriginUsageTable"
+        " WHERE origin = ? AND type = ? AND client_id = ?";
+    statement.Assign(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+    statement.BindString(0, origin.spec());
+    statement.BindInt(1, static_cast<int>(type));
+    statement.BindInt(2, static_cast<int>(client_id));
+  }
+
+  if (!statement.Run())
+    return false;
+
+  ScheduleCommit();
+  return true;
+}
+
+bool QuotaDatabase::GetOriginUsageTable(OriginUsageTableEntries* entries) {
+  DCHECK(entries);
+  if (!LazyOpen(false))
+    return false;
+
+  const char* kSql =
+      "SELECT origin, type, client_id, usage FROM OriginUsageTable";
+  sql::Statement statement(db_->GetCachedStatement(SQL_FROM_HERE, kSql));
+
+  entries->clear();
+  while (statement.Step()) {
+    entries->push_back(OriginUsageTableEntry(
+        GURL(statement.ColumnString(0)),
+        static_cast<StorageType>(statement.ColumnInt(1)),
+        static_cast<QuotaClient::ID>(statement.ColumnInt(2)),
+        statement.ColumnInt64(3)));
+  }
+
+  return statement.Succeeded();
+}
+
+bool QuotaDatabase::IsUsageLedgerBootstrapped() {
+  if (!LazyOpen(false))
+    return false;
+
+  int flag = 0;
+  return meta_table_->GetValue(kIsUsageTableBootstrapped, &flag) && flag;
+}
+
+bool QuotaDatabase::SetUsageLedgerBootstrapped(bool bootstrap_flag) {
+  if (!LazyOpen(true))
+    return false;
+
+  return meta_table_->SetValue(kIsUsageTableBootstrapped, bootstrap_flag);
+}
+
 void QuotaDatabase::Commit() {
   if (!db_.get())
     return;
@@ -599,6 +695,24 @@ bool QuotaDatabase::UpgradeSchema(int current_version) {
     Commit();
     return true;
   }
+  if (current_version == 4) {
+    // Version 5 adds the usage ledger, which is bootstrapped again from the
+    // quota clients.
+    sql::Transaction transaction(db_.get());
+    if (!transaction.Begin())
+      return false;
+    for (size_t i = 0; i < ARRAYSIZE_UNSAFE(kTables); ++i) {
+      if (db_->DoesTableExist(kTables[i].table_name))
+        continue;
+      std::string sql("CREATE TABLE ");
+      sql += kTables[i].table_name;
+      sql += kTables[i].columns;
+      if (!db_->Execute(sql.c_str()))
+        return false;
+    }
+    meta_table_->SetVersionNumber(kCurrentVersion);
+    return transaction.Commit();
+  }
   return false;
 }
 
@@ -668,4 +782,15 @@ bool operator<(const QuotaDatabase::OriginInfoTableEntry& lhs,
   return lhs.last_access_time < rhs.last_access_time;
 }
 
+bool operator<(const QuotaDatabase::OriginUsageTableEntry& lhs,
+               const QuotaDatabase::OriginUsageTableEntry& rhs) {
+  if (lhs.origin < rhs.origin) return true;
+  if (rhs.origin < lhs.origin) return false;
+  if (lhs.type < rhs.type) return true;
+  if (rhs.type < lhs.type) return false;
+  if (lhs.client_id < rhs.client_id) return true;
+  if (rhs.client_id < lhs.client_id) return false;
+  return lhs.usage < rhs.usage;
+}
+
 }  // quota namespace
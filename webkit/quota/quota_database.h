@@ -7,6 +7,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/callback.h"
@@ -16,6 +17,7 @@
 #include "base/time.h"
 #include "base/timer.h"
 #include "googleurl/src/gurl.h"
+#include "webkit/quota/quota_client.h"
 #include "webkit/quota/quota_types.h"
 
 namespace sql {
@@ -36,6 +38,22 @@ class QuotaDatabase {
   static const char kDesiredAvailableSpaceKey[];
   static const char kTemporaryQuotaOverrideKey[];
 
+  // The usage a quota client has for an origin, as recorded in the usage
+  // ledger.
+  struct OriginUsageTableEntry {
+    OriginUsageTableEntry();
+    OriginUsageTableEntry(
+        const GURL& origin,
+        StorageType type,
+        QuotaClient::ID client_id,
+        int64 usage);
+    GURL origin;
+    StorageType type;
+    QuotaClient::ID client_id;
+    int64 usage;
+  };
+  typedef std::vector<OriginUsageTableEntry> OriginUsageTableEntries;
+
   // If 'path' is empty, an in memory database will be used.
   explicit QuotaDatabase(const FilePath& path);
   ~QuotaDatabase();
@@ -86,6 +104,20 @@ class QuotaDatabase {
   bool IsOriginDatabaseBootstrapped();
   bool SetOriginDatabaseBootstrapped(bool bootstrap_flag);
 
+  // The usage ledger keeps the usage of each origin per quota client, so
+  // that it does not have to be gathered from the clients at startup.
+  // Setting the usage to 0 removes the entry.
+  bool SetOriginUsage(const GURL& origin,
+                      StorageType type,
+                      QuotaClient::ID client_id,
+                      int64 usage);
+  bool GetOriginUsageTable(OriginUsageTableEntries* entries);
+
+  // Returns false until SetUsageLedgerBootstrapped(true) is called, which
+  // is done once the usage of all the existing origins has been recorded.
+  bool IsUsageLedgerBootstrapped();
+  bool SetUsageLedgerBootstrapped(bool bootstrap_flag);
+
  private:
   struct QuotaTableEntry {
     QuotaTableEntry();
@@ -116,6 +148,8 @@ class QuotaDatabase {
   };
   friend bool operator <(const OriginInfoTableEntry& lhs,
                          const OriginInfoTableEntry& rhs);
+  friend bool operator <(const OriginUsageTableEntry& lhs,
+                         const OriginUsageTableEntry& rhs);
 
   // Structures used for CreateSchema.
   struct TableSchema {
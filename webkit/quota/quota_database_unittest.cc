@@ -315,6 +315,52 @@ class QuotaDatabaseTest : public testing::Test {
     EXPECT_EQ(1, used_count);
   }
 
+  void OriginUsage(const FilePath& kDbFile) {
+    typedef QuotaDatabase::OriginUsageTableEntry Entry;
+    const GURL kOrigin1("http://a/");
+    const GURL kOrigin2("http://b/");
+
+    QuotaDatabase db(kDbFile);
+    QuotaDatabase::OriginUsageTableEntries entries;
+    EXPECT_FALSE(db.IsUsageLedgerBootstrapped());
+    EXPECT_FALSE(db.GetOriginUsageTable(&entries));
+
+    EXPECT_TRUE(db.SetOriginUsage(kOrigin1, kStorageTypeTemporary,
+                                  QuotaClient::kFileSystem, 10));
+    EXPECT_TRUE(db.SetOriginUsage(kOrigin1, kStorageTypeTemporary,
+                                  QuotaClient::kDatabase, 20));
+    EXPECT_TRUE(db.SetOriginUsage(kOrigin1, kStorageTypePersistent,
+                                  QuotaClient::kFileSystem, 30));
+    EXPECT_TRUE(db.SetOriginUsage(kOrigin2, kStorageTypeTemporary,
+                                  QuotaClient::kFileSystem, 40));
+    // Overwrites the earlier usage.
+    EXPECT_TRUE(db.SetOriginUsage(kOrigin1, kStorageTypeTemporary,
+                                  QuotaClient::kFileSystem, 50));
+    // Removes the entry.
+    EXPECT_TRUE(db.SetOriginUsage(kOrigin2, kStorageTypeTemporary,
+                                  QuotaClient::kFileSystem, 0));
+
+    const Entry kExpected[] = {
+      Entry(kOrigin1, kStorageTypeTemporary, QuotaClient::kFileSystem, 50),
+      Entry(kOrigin1, kStorageTypeTemporary, QuotaClient::kDatabase, 20),
+      Entry(kOrigin1, kStorageTypePersistent, QuotaClient::kFileSystem, 30),
+    };
+    EXPECT_TRUE(db.GetOriginUsageTable(&entries));
+    EXPECT_EQ(ARRAYSIZE_UNSAFE(kExpected), entries.size());
+    typedef EntryVerifier<Entry> Verifier;
+    Verifier verifier(kExpected, kExpected + ARRAYSIZE_UNSAFE(kExpected));
+    for (QuotaDatabase::OriginUsageTableEntries::const_iterator iter =
+             entries.begin();
+         iter != entries.end(); ++iter) {
+      verifier.Run(*iter);
+    }
+    EXPECT_TRUE(verifier.table.empty());
+
+    EXPECT_FALSE(db.IsUsageLedgerBootstrapped());
+    EXPECT_TRUE(db.SetUsageLedgerBootstrapped(true));
+    EXPECT_TRUE(db.IsUsageLedgerBootstrapped());
+  }
+
   template <typename EntryType>
   struct EntryVerifier {
     std::set<EntryType> table;
@@ -543,6 +589,14 @@ TEST_F(QuotaDatabaseTest, BootstrapFlag) {
   EXPECT_FALSE(db.IsOriginDatabaseBootstrapped());
 }
 
+TEST_F(QuotaDatabaseTest, OriginUsage) {
+  ScopedTempDir data_dir;
+  ASSERT_TRUE(data_dir.CreateUniqueTempDir());
+  const FilePath kDbFile = data_dir.path().AppendASCII("quota_manager.db");
+  OriginUsage(kDbFile);
+  OriginUsage(FilePath());
+}
+
 TEST_F(QuotaDatabaseTest, RegisterInitialOriginInfo) {
   ScopedTempDir data_dir;
   ASSERT_TRUE(data_dir.CreateUniqueTempDir());
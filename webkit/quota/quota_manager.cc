@@ -60,6 +60,18 @@ void CountOriginType(const std::set<GURL>& origins,
   }
 }
 
+bool UpdateOriginUsage(QuotaDatabase* database,
+                       const QuotaDatabase::OriginUsageTableEntries& entries) {
+  for (QuotaDatabase::OriginUsageTableEntries::const_iterator iter =
+           entries.begin();
+       iter != entries.end(); ++iter) {
+    if (!database->SetOriginUsage(
+            iter->origin, iter->type, iter->client_id, iter->usage))
+      return false;
+  }
+  return true;
+}
+
 }  // anonymous namespace
 
 const int64 QuotaManager::kNoLimit = kint64max;
@@ -73,6 +85,9 @@ const int QuotaManager::kThresholdOfErrorsToBeBlacklisted = 3;
 const int QuotaManager::kEvictionIntervalInMilliSeconds =
     30 * kMinutesInMilliSeconds;
 
+const int QuotaManager::kReconcileUsageDelayInMilliSeconds =
+    5 * kMinutesInMilliSeconds;
+
 // Callback translators.
 void CallGetUsageAndQuotaCallback(
     const QuotaManager::GetUsageAndQuotaCallback& callback,
@@ -677,7 +692,8 @@ class QuotaManager::InitializeTask : public QuotaManager::DatabaseTaskBase {
   explicit InitializeTask(QuotaManager* manager)
       : DatabaseTaskBase(manager),
         temporary_quota_override_(-1),
-        desired_available_space_(-1) {
+        desired_available_space_(-1),
+        usage_ledger_bootstrapped_(false) {
   }
 
  protected:
@@ -690,12 +706,20 @@ class QuotaManager::InitializeTask : public QuotaManager::DatabaseTaskBase {
                                     &temporary_quota_override_);
     database()->GetQuotaConfigValue(QuotaDatabase::kDesiredAvailableSpaceKey,
                                     &desired_available_space_);
+    // Load the usage ledger, unless it has not got all the origins yet.
+    usage_ledger_bootstrapped_ =
+        database()->IsUsageLedgerBootstrapped() &&
+        database()->GetOriginUsageTable(&origin_usage_entries_);
+    if (!usage_ledger_bootstrapped_)
+      origin_usage_entries_.clear();
   }
 
   // DatabaseTaskBase:
   virtual void DatabaseTaskCompleted() OVERRIDE {
     manager()->temporary_quota_override_ = temporary_quota_override_;
     manager()->desired_available_space_ = desired_available_space_;
+    manager()->DidLoadUsageLedger(usage_ledger_bootstrapped_,
+                                  origin_usage_entries_);
     manager()->temporary_quota_initialized_ = true;
     manager()->DidRunInitializeTask();
   }
@@ -703,6 +727,8 @@ class QuotaManager::InitializeTask : public QuotaManager::DatabaseTaskBase {
  private:
   int64 temporary_quota_override_;
   int64 desired_available_space_;
+  bool usage_ledger_bootstrapped_;
+  OriginUsageTableEntries origin_usage_entries_;
 };
 
 class QuotaManager::UpdateTemporaryQuotaOverrideTask
@@ -1087,6 +1113,53 @@ class QuotaManager::GetModifiedSinceTask
   GetOriginsCallback callback_;
 };
 
+class QuotaManager::UpdateOriginUsageTask
+    : public QuotaManager::DatabaseTaskBase {
+ public:
+  UpdateOriginUsageTask(
+      QuotaManager* manager,
+      const OriginUsageTableEntries& entries)
+      : DatabaseTaskBase(manager),
+        entries_(entries) {}
+
+ protected:
+  virtual ~UpdateOriginUsageTask() {}
+
+  // QuotaThreadTask:
+  virtual void RunOnTargetThread() OVERRIDE {
+    if (!UpdateOriginUsage(database(), entries_))
+      set_db_disabled(true);
+  }
+
+  // DatabaseTaskBase:
+  virtual void DatabaseTaskCompleted() OVERRIDE {}
+
+ private:
+  OriginUsageTableEntries entries_;
+};
+
+class QuotaManager::BootstrapUsageLedgerTask
+    : public QuotaManager::DatabaseTaskBase {
+ public:
+  explicit BootstrapUsageLedgerTask(QuotaManager* manager)
+      : DatabaseTaskBase(manager) {}
+
+ protected:
+  virtual ~BootstrapUsageLedgerTask() {}
+
+  // QuotaThreadTask:
+  virtual void RunOnTargetThread() OVERRIDE {
+    if (!database()->SetUsageLedgerBootstrapped(true))
+      set_db_disabled(true);
+  }
+
+  // DatabaseTaskBase:
+  virtual void DatabaseTaskCompleted() OVERRIDE {
+    if (!db_disabled())
+      manager()->usage_ledger_bootstrapped_ = true;
+  }
+};
+
 class QuotaManager::DumpQuotaTableTask
     : public QuotaManager::DatabaseTaskBase {
  private:
@@ -1196,6 +1269,7 @@ QuotaManager::QuotaManager(bool is_incognito,
     eviction_disabled_(false),
     io_thread_(io_thread),
     db_thread_(db_thread),
+    usage_ledger_bootstrapped_(false),
     temporary_quota_initialized_(false),
     temporary_quota_override_(-1),
     desired_available_space_(-1),
@@ -1337,8 +1411,17 @@ QuotaManager::~QuotaManager() {
   proxy_->manager_ = NULL;
   std::for_each(clients_.begin(), clients_.end(),
                 std::mem_fun(&QuotaClient::OnQuotaManagerDestroyed));
-  if (database_.get())
+  if (database_.get()) {
+    // Usage changes not written yet are written before the database goes.
+    if (!pending_origin_usage_.empty()) {
+      db_thread_->PostTask(
+          FROM_HERE,
+          base::Bind(base::IgnoreResult(&UpdateOriginUsage),
+                     base::Unretained(database_.get()),
+                     pending_origin_usage_));
+    }
     db_thread_->DeleteSoon(FROM_HERE, database_.release());
+  }
 }
 
 void QuotaManager::LazyInitialize() {
@@ -1352,12 +1435,12 @@ void QuotaManager::LazyInitialize() {
   database_.reset(new QuotaDatabase(is_incognito_ ? FilePath() :
       profile_path_.AppendASCII(kDatabaseName)));
 
-  temporary_usage_tracker_.reset(
-      new UsageTracker(clients_, kStorageTypeTemporary,
-                       special_storage_policy_));
+  temporary_usage_tracker_.reset(CreateUsageTracker(kStorageTypeTemporary));
   persistent_usage_tracker_.reset(
-      new UsageTracker(clients_, kStorageTypePersistent,
-                       special_storage_policy_));
+      CreateUsageTracker(kStorageTypePersistent));
+  // Temporary usage requests wait until the tracker is seeded from the usage
+  // ledger by the InitializeTask.
+  temporary_usage_tracker_->BeginSeeding();
 
   make_scoped_refptr(new InitializeTask(this))->Start();
 }
@@ -1430,15 +1513,13 @@ bool QuotaManager::ResetUsageTracker(StorageType type) {
       if (temporary_usage_tracker_->IsWorking())
         return false;
       temporary_usage_tracker_.reset(
-          new UsageTracker(clients_, kStorageTypeTemporary,
-                           special_storage_policy_));
+          CreateUsageTracker(kStorageTypeTemporary));
       return true;
     case kStorageTypePersistent:
       if (persistent_usage_tracker_->IsWorking())
         return false;
       persistent_usage_tracker_.reset(
-          new UsageTracker(clients_, kStorageTypePersistent,
-                           special_storage_policy_));
+          CreateUsageTracker(kStorageTypePersistent));
       return true;
     default:
       NOTREACHED();
@@ -1446,6 +1527,19 @@ bool QuotaManager::ResetUsageTracker(StorageType type) {
   return true;
 }
 
+UsageTracker* QuotaManager::CreateUsageTracker(StorageType type) {
+  UsageTracker* tracker =
+      new UsageTracker(clients_, type, special_storage_policy_);
+  // Only the temporary usage is kept in the ledger, as it is the one the
+  // eviction needs for all the origins at startup.
+  if (type == kStorageTypeTemporary) {
+    tracker->set_origin_usage_changed_callback(
+        base::Bind(&QuotaManager::DidChangeOriginUsage,
+                   weak_factory_.GetWeakPtr()));
+  }
+  return tracker;
+}
+
 UsageTracker* QuotaManager::GetUsageTracker(StorageType type) const {
   switch (type) {
     case kStorageTypeTemporary:
@@ -1688,6 +1782,71 @@ void QuotaManager::DidGetPersistentGlobalUsageForHistogram(
                        unlimited_origins);
 }
 
+void QuotaManager::DidLoadUsageLedger(
+    bool bootstrapped, const OriginUsageTableEntries& entries) {
+  usage_ledger_bootstrapped_ = bootstrapped;
+  for (OriginUsageTableEntries::const_iterator iter = entries.begin();
+       iter != entries.end(); ++iter) {
+    if (iter->type != kStorageTypeTemporary)
+      continue;
+    temporary_usage_tracker_->SeedUsageCache(
+        iter->client_id, iter->origin, iter->usage);
+  }
+  temporary_usage_tracker_->EndSeeding(bootstrapped);
+}
+
+void QuotaManager::DidChangeOriginUsage(
+    StorageType type, QuotaClient::ID client_id,
+    const GURL& origin, int64 usage) {
+  // Nothing outlives an incognito session.
+  if (is_incognito_ || db_disabled_)
+    return;
+  // Defend against confusing inputs from clients.
+  if (usage < 0)
+    usage = 0;
+  if (pending_origin_usage_.empty()) {
+    // Changes made in a row, such as by a usage gathering task, are
+    // written together.
+    io_thread_->PostTask(
+        FROM_HERE,
+        base::Bind(&QuotaManager::FlushOriginUsage,
+                   weak_factory_.GetWeakPtr()));
+  }
+  pending_origin_usage_.push_back(
+      OriginUsageTableEntry(origin, type, client_id, usage));
+}
+
+void QuotaManager::FlushOriginUsage() {
+  if (pending_origin_usage_.empty())
+    return;
+  if (!db_disabled_) {
+    make_scoped_refptr(new UpdateOriginUsageTask(
+        this, pending_origin_usage_))->Start();
+  }
+  pending_origin_usage_.clear();
+}
+
+void QuotaManager::BootstrapUsageLedger() {
+  // Gathering the global usage adds all the origins of the clients to the
+  // ledger.
+  temporary_usage_tracker_->GetGlobalUsage(
+      base::Bind(&QuotaManager::DidGetGlobalUsageForUsageLedger,
+                 weak_factory_.GetWeakPtr()));
+}
+
+void QuotaManager::DidGetGlobalUsageForUsageLedger(
+    StorageType type, int64 usage, int64 unlimited_usage) {
+  DCHECK_EQ(kStorageTypeTemporary, type);
+  FlushOriginUsage();
+  if (db_disabled_)
+    return;
+  make_scoped_refptr(new BootstrapUsageLedgerTask(this))->Start();
+}
+
+void QuotaManager::ReconcileUsageCache() {
+  temporary_usage_tracker_->ReconcileUsageCache();
+}
+
 void QuotaManager::DidRunInitializeTask() {
   histogram_timer_.Start(FROM_HERE,
                          base::TimeDelta::FromMilliseconds(
@@ -1710,6 +1869,18 @@ void QuotaManager::DidRunInitializeTask() {
   GetTemporaryGlobalQuota(
       base::Bind(&QuotaManager::DidGetInitialTemporaryGlobalQuota,
                  weak_factory_.GetWeakPtr()));
+
+  if (usage_ledger_bootstrapped_) {
+    // The usage was served from the ledger, which may have missed the last
+    // changes before shutdown. Check it with the clients once the startup
+    // is over.
+    usage_reconcile_timer_.Start(
+        FROM_HERE,
+        base::TimeDelta::FromMilliseconds(kReconcileUsageDelayInMilliSeconds),
+        this, &QuotaManager::ReconcileUsageCache);
+  } else if (!is_incognito_ && !db_disabled_) {
+    BootstrapUsageLedger();
+  }
 }
 
 void QuotaManager::DidGetInitialTemporaryGlobalQuota(
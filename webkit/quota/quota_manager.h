@@ -204,6 +204,8 @@ class QuotaManager : public QuotaTaskObserver,
 
   static const int kEvictionIntervalInMilliSeconds;
 
+  static const int kReconcileUsageDelayInMilliSeconds;
+
  protected:
   virtual ~QuotaManager();
 
@@ -213,6 +215,7 @@ class QuotaManager : public QuotaTaskObserver,
   friend class MockStorageClient;
   friend class quota_internals::QuotaInternalsProxy;
   friend class QuotaManagerProxy;
+  friend class QuotaManagerPerfTest;
   friend class QuotaManagerTest;
   friend class QuotaTemporaryStorageEvictor;
   friend struct QuotaManagerDeleter;
@@ -228,6 +231,8 @@ class QuotaManager : public QuotaTaskObserver,
   class UpdateAccessTimeTask;
   class UpdateModifiedTimeTask;
   class GetModifiedSinceTask;
+  class UpdateOriginUsageTask;
+  class BootstrapUsageLedgerTask;
 
   class GetUsageInfoTask;
   class UsageAndQuotaDispatcherTask;
@@ -244,8 +249,10 @@ class QuotaManager : public QuotaTaskObserver,
 
   typedef QuotaDatabase::QuotaTableEntry QuotaTableEntry;
   typedef QuotaDatabase::OriginInfoTableEntry OriginInfoTableEntry;
+  typedef QuotaDatabase::OriginUsageTableEntry OriginUsageTableEntry;
   typedef std::vector<QuotaTableEntry> QuotaTableEntries;
   typedef std::vector<OriginInfoTableEntry> OriginInfoTableEntries;
+  typedef QuotaDatabase::OriginUsageTableEntries OriginUsageTableEntries;
 
   typedef base::Callback<void(const QuotaTableEntries&)>
       DumpQuotaTableCallback;
@@ -279,6 +286,7 @@ class QuotaManager : public QuotaTaskObserver,
   // The client must remain valid until OnQuotaManagerDestored is called.
   void RegisterClient(QuotaClient* client);
 
+  UsageTracker* CreateUsageTracker(StorageType type);
   UsageTracker* GetUsageTracker(StorageType type) const;
 
   // Extract cached origins list from the usage tracker.
@@ -339,6 +347,22 @@ class QuotaManager : public QuotaTaskObserver,
   virtual void GetUsageAndQuotaForEviction(
       const GetUsageAndQuotaForEvictionCallback& callback) OVERRIDE;
 
+  // Methods for the usage ledger, which persists the cached temporary usage
+  // so that it need not be gathered from the clients again at the next
+  // startup.
+  void DidLoadUsageLedger(bool bootstrapped,
+                          const OriginUsageTableEntries& entries);
+  void DidChangeOriginUsage(StorageType type,
+                            QuotaClient::ID client_id,
+                            const GURL& origin,
+                            int64 usage);
+  void FlushOriginUsage();
+  void BootstrapUsageLedger();
+  void DidGetGlobalUsageForUsageLedger(StorageType type,
+                                       int64 usage,
+                                       int64 unlimited_usage);
+  void ReconcileUsageCache();
+
   void DidRunInitializeTask();
   void DidGetInitialTemporaryGlobalQuota(QuotaStatusCode status,
                                          StorageType type,
@@ -367,6 +391,11 @@ class QuotaManager : public QuotaTaskObserver,
   // TODO(michaeln): Need a way to clear the cache, drop and
   // reinstantiate the trackers when they're not handling requests.
 
+  bool usage_ledger_bootstrapped_;
+  // Usage changes not written to the ledger yet.
+  OriginUsageTableEntries pending_origin_usage_;
+  base::OneShotTimer<QuotaManager> usage_reconcile_timer_;
+
   scoped_ptr<QuotaTemporaryStorageEvictor> temporary_storage_evictor_;
   EvictionContext eviction_context_;
 
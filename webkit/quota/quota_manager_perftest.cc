@@ -0,0 +1,115 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
+#include "base/perftimer.h"
+#include "base/scoped_temp_dir.h"
+#include "base/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webkit/quota/mock_special_storage_policy.h"
+#include "webkit/quota/mock_storage_client.h"
+#include "webkit/quota/quota_manager.h"
+
+namespace quota {
+
+namespace {
+
+const int kOriginCount = 10000;
+
+}  // namespace
+
+class QuotaManagerPerfTest : public testing::Test {
+ public:
+  QuotaManagerPerfTest()
+      : weak_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)),
+        usage_(-1) {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(data_dir_.CreateUniqueTempDir());
+    for (int i = 0; i < kOriginCount; ++i) {
+      origins_.push_back(
+          base::StringPrintf("http://www.origin%d.com/", i));
+    }
+    for (int i = 0; i < kOriginCount; ++i) {
+      MockOriginData data = { origins_[i].c_str(), kStorageTypeTemporary,
+                              i + 1 };
+      mock_data_.push_back(data);
+    }
+  }
+
+  virtual void TearDown() OVERRIDE {
+    quota_manager_ = NULL;
+    MessageLoop::current()->RunAllPending();
+  }
+
+ protected:
+  // Starts a quota manager for the profile in |data_dir_|, as the browser
+  // does at startup.
+  void StartQuotaManager() {
+    quota_manager_ = NULL;
+    MessageLoop::current()->RunAllPending();
+    quota_manager_ = new QuotaManager(
+        false /* is_incognito */,
+        data_dir_.path(),
+        base::MessageLoopProxy::current(),
+        base::MessageLoopProxy::current(),
+        new MockSpecialStoragePolicy);
+    quota_manager_->eviction_disabled_ = true;
+    quota_manager_->proxy()->RegisterClient(
+        new MockStorageClient(quota_manager_->proxy(), &mock_data_[0],
+                              QuotaClient::kFileSystem, mock_data_.size()));
+  }
+
+  // Returns the time it takes to get the temporary global usage.
+  base::TimeDelta TimeGlobalUsage() {
+    usage_ = -1;
+    timer_.reset(new PerfTimer);
+    quota_manager_->GetGlobalUsage(
+        kStorageTypeTemporary,
+        base::Bind(&QuotaManagerPerfTest::DidGetGlobalUsage,
+                   weak_factory_.GetWeakPtr()));
+    MessageLoop::current()->RunAllPending();
+    EXPECT_EQ(static_cast<int64>(kOriginCount) * (kOriginCount + 1) / 2,
+              usage_);
+    return elapsed_;
+  }
+
+ private:
+  void DidGetGlobalUsage(StorageType type, int64 usage,
+                         int64 unlimited_usage) {
+    elapsed_ = timer_->Elapsed();
+    usage_ = usage;
+  }
+
+  base::WeakPtrFactory<QuotaManagerPerfTest> weak_factory_;
+  ScopedTempDir data_dir_;
+  std::vector<std::string> origins_;
+  std::vector<MockOriginData> mock_data_;
+  scoped_refptr<QuotaManager> quota_manager_;
+  scoped_ptr<PerfTimer> timer_;
+  base::TimeDelta elapsed_;
+  int64 usage_;
+};
+
+TEST_F(QuotaManagerPerfTest, GlobalUsageAtStartup) {
+  // The first run asks every origin of the client for its usage, and
+  // records it in the usage ledger.
+  StartQuotaManager();
+  LogPerfResult("quota_global_usage_cold",
+                TimeGlobalUsage().InMillisecondsF(), "ms");
+
+  // The next one is served from the ledger.
+  StartQuotaManager();
+  LogPerfResult("quota_global_usage_from_ledger",
+                TimeGlobalUsage().InMillisecondsF(), "ms");
+}
+
+}  // namespace quota
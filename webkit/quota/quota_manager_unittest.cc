@@ -65,6 +65,20 @@ class QuotaManagerTest : public testing::Test {
     MessageLoop::current()->RunAllPending();
   }
 
+  // Replaces the quota manager with a new one for the same profile, as if
+  // the browser was restarted.
+  void RestartQuotaManager() {
+    quota_manager_ = NULL;
+    MessageLoop::current()->RunAllPending();
+    quota_manager_ = new QuotaManager(
+        false /* is_incognito */,
+        data_dir_.path(),
+        MessageLoopProxy::current(),
+        MessageLoopProxy::current(),
+        mock_special_storage_policy_);
+    quota_manager_->eviction_disabled_ = true;
+  }
+
  protected:
   MockStorageClient* CreateClient(
       const MockOriginData* mock_data,
@@ -238,6 +252,10 @@ class QuotaManagerTest : public testing::Test {
     quota_manager_->DeleteOriginFromDatabase(origin, type);
   }
 
+  void ReconcileUsageCache() {
+    quota_manager_->ReconcileUsageCache();
+  }
+
   void GetLRUOrigin(StorageType type) {
     lru_origin_ = GURL();
     quota_manager_->GetLRUOrigin(
@@ -1142,6 +1160,107 @@ TEST_F(QuotaManagerTest, GetUsage_WithDeleteOrigin) {
   EXPECT_EQ(predelete_host_pers, usage());
 }
 
+TEST_F(QuotaManagerTest, GetUsage_FromUsageLedger) {
+  static const MockOriginData kData[] = {
+    { "http://foo.com/",   kTemp,  1 },
+    { "http://foo.com:1/", kTemp, 20 },
+    { "http://bar.com/",   kPerm, 300 },
+  };
+  MockStorageClient* client = CreateClient(kData, ARRAYSIZE_UNSAFE(kData),
+      QuotaClient::kFileSystem);
+  RegisterClient(client);
+
+  // The first run records the usage of all the origins.
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1 + 20, usage());
+  client->ModifyOriginAndNotify(GURL("http://foo.com/"), kTemp, 4000);
+  client->AddOriginAndNotify(GURL("http://buz.com/"), kTemp, 50000);
+  MessageLoop::current()->RunAllPending();
+
+  // The client's data changes behind the quota manager's back, which the
+  // next run does not see until the usage is reconciled.
+  static const MockOriginData kChangedData[] = {
+    { "http://foo.com/",   kTemp, 1 + 4000 },
+    { "http://foo.com:1/", kTemp, 600000 },
+    { "http://bar.com/",   kPerm, 300 },
+    { "http://baz.com/",   kTemp, 7000000 },
+  };
+  RestartQuotaManager();
+  RegisterClient(CreateClient(kChangedData, ARRAYSIZE_UNSAFE(kChangedData),
+      QuotaClient::kFileSystem));
+
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1 + 4000 + 20 + 50000, usage());
+  GetGlobalUsage(kPerm);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(300, usage());
+  GetHostUsage("buz.com", kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(50000, usage());
+
+  ReconcileUsageCache();
+  MessageLoop::current()->RunAllPending();
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1 + 4000 + 600000 + 7000000, usage());
+  GetHostUsage("buz.com", kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, usage());
+
+  // The reconciled usage was recorded.
+  RestartQuotaManager();
+  RegisterClient(CreateClient(NULL, 0, QuotaClient::kFileSystem));
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1 + 4000 + 600000 + 7000000, usage());
+  GetHostUsage("baz.com", kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(7000000, usage());
+}
+
+TEST_F(QuotaManagerTest, NotifyStorageModified_FromUsageLedger) {
+  static const MockOriginData kData[] = {
+    { "http://foo.com/",   kTemp,  1 },
+    { "http://foo.com:1/", kTemp, 20 },
+  };
+  RegisterClient(CreateClient(kData, ARRAYSIZE_UNSAFE(kData),
+      QuotaClient::kFileSystem));
+  GetGlobalUsage(kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1 + 20, usage());
+
+  // The ledger is stale for foo.com/, and misses foo.com:2/.
+  static const MockOriginData kChangedData[] = {
+    { "http://foo.com/",   kTemp, 5000 },
+    { "http://foo.com:1/", kTemp, 20 },
+    { "http://foo.com:2/", kTemp, 300 },
+  };
+  RestartQuotaManager();
+  MockStorageClient* client = CreateClient(kChangedData,
+      ARRAYSIZE_UNSAFE(kChangedData), QuotaClient::kFileSystem);
+  RegisterClient(client);
+  GetHostUsage("foo.com", kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1 + 20, usage());
+
+  // Deleting data from those origins gathers their usage from the client,
+  // rather than taking the usage recorded for them below zero.
+  client->ModifyOriginAndNotify(GURL("http://foo.com/"), kTemp, -4000);
+  client->ModifyOriginAndNotify(GURL("http://foo.com:2/"), kTemp, -100);
+  MessageLoop::current()->RunAllPending();
+  GetHostUsage("foo.com", kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(1000 + 20 + 200, usage());
+
+  // Their usage is known from then on.
+  client->ModifyOriginAndNotify(GURL("http://foo.com/"), kTemp, -500);
+  GetHostUsage("foo.com", kTemp);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(500 + 20 + 200, usage());
+}
+
 TEST_F(QuotaManagerTest, GetAvailableSpaceTest) {
   GetAvailableSpace();
   MessageLoop::current()->RunAllPending();
@@ -47,7 +47,7 @@ class ClientUsageTracker::GatherUsageTaskBase : public QuotaTask {
     // We do not get usage for origins for which we have valid usage cache.
     std::vector<GURL> origins_to_gather;
     std::set<GURL> cached_origins;
-    client_tracker()->GetCachedOrigins(&cached_origins);
+    GetOriginsWithCachedUsage(&cached_origins);
     std::set<GURL> already_added;
     for (std::set<GURL>::const_iterator iter = origins.begin();
          iter != origins.end(); ++iter) {
@@ -86,6 +86,11 @@ class ClientUsageTracker::GatherUsageTaskBase : public QuotaTask {
     DeleteSoon();
   }
 
+  // Returns the origins whose cached usage is not gathered again.
+  virtual void GetOriginsWithCachedUsage(std::set<GURL>* origins) {
+    client_tracker()->GetCachedOrigins(origins);
+  }
+
   UsageTracker* tracker() const { return tracker_; }
   ClientUsageTracker* client_tracker() const { return client_tracker_; }
 
@@ -199,11 +204,56 @@ class ClientUsageTracker::GatherHostUsageTask
   DISALLOW_COPY_AND_ASSIGN(GatherHostUsageTask);
 };
 
+// A task class for checking the usage seeded from the usage ledger against
+// the client's, which also finds the origins missing from the ledger.
+// This class is self-destructed.
+class ClientUsageTracker::ReconcileUsageTask
+    : public GatherUsageTaskBase {
+ public:
+  ReconcileUsageTask(
+      UsageTracker* tracker,
+      QuotaClient* client)
+      : GatherUsageTaskBase(tracker, client),
+        client_(client),
+        weak_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)) {
+    DCHECK(client_);
+  }
+  virtual ~ReconcileUsageTask() {}
+
+ protected:
+  virtual void Run() OVERRIDE {
+    client_->GetOriginsForType(tracker()->type(),
+        base::Bind(&GatherUsageTaskBase::GetUsageForOrigins,
+                   weak_factory_.GetWeakPtr()));
+  }
+
+  virtual void GetOriginsWithCachedUsage(std::set<GURL>* origins) OVERRIDE {
+    GatherUsageTaskBase::GetOriginsWithCachedUsage(origins);
+    const std::set<GURL>& unverified_origins =
+        client_tracker()->unverified_origins_;
+    for (std::set<GURL>::const_iterator iter = unverified_origins.begin();
+         iter != unverified_origins.end(); ++iter) {
+      origins->erase(*iter);
+    }
+  }
+
+  virtual void Completed() OVERRIDE {
+    client_tracker()->ReconcileUsageComplete();
+  }
+
+ private:
+  QuotaClient* client_;
+  base::WeakPtrFactory<GatherUsageTaskBase> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReconcileUsageTask);
+};
+
 // UsageTracker ----------------------------------------------------------
 
 UsageTracker::UsageTracker(const QuotaClientList& clients, StorageType type,
                            SpecialStoragePolicy* special_storage_policy)
     : type_(type),
+      is_seeding_(false),
       weak_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)) {
   for (QuotaClientList::const_iterator iter = clients.begin();
       iter != clients.end();
@@ -226,6 +276,11 @@ ClientUsageTracker* UsageTracker::GetClientTracker(QuotaClient::ID client_id) {
 }
 
 void UsageTracker::GetGlobalUsage(const GlobalUsageCallback& callback) {
+  if (is_seeding_) {
+    pending_requests_.push_back(base::Bind(
+        &UsageTracker::GetGlobalUsage, weak_factory_.GetWeakPtr(), callback));
+    return;
+  }
   if (client_tracker_map_.size() == 0) {
     // No clients registered.
     callback.Run(type_, 0, 0);
@@ -249,6 +304,12 @@ void UsageTracker::GetGlobalUsage(const GlobalUsageCallback& callback) {
 
 void UsageTracker::GetHostUsage(
     const std::string& host, const HostUsageCallback& callback) {
+  if (is_seeding_) {
+    pending_requests_.push_back(base::Bind(
+        &UsageTracker::GetHostUsage, weak_factory_.GetWeakPtr(),
+        host, callback));
+    return;
+  }
   if (client_tracker_map_.size() == 0) {
     // No clients registered.
     callback.Run(host, type_, 0);
@@ -270,6 +331,12 @@ void UsageTracker::GetHostUsage(
 
 void UsageTracker::UpdateUsageCache(
     QuotaClient::ID client_id, const GURL& origin, int64 delta) {
+  if (is_seeding_) {
+    pending_requests_.push_back(base::Bind(
+        &UsageTracker::UpdateUsageCache, weak_factory_.GetWeakPtr(),
+        client_id, origin, delta));
+    return;
+  }
   ClientUsageTracker* client_tracker = GetClientTracker(client_id);
   DCHECK(client_tracker);
   client_tracker->UpdateUsageCache(origin, delta);
@@ -294,6 +361,45 @@ void UsageTracker::GetCachedOrigins(std::set<GURL>* origins) const {
   }
 }
 
+void UsageTracker::BeginSeeding() {
+  DCHECK(!is_seeding_);
+  DCHECK(!IsWorking());
+  is_seeding_ = true;
+}
+
+void UsageTracker::SeedUsageCache(
+    QuotaClient::ID client_id, const GURL& origin, int64 usage) {
+  DCHECK(is_seeding_);
+  ClientUsageTracker* client_tracker = GetClientTracker(client_id);
+  // The client may not be registered anymore.
+  if (client_tracker)
+    client_tracker->SeedUsageCache(origin, usage);
+}
+
+void UsageTracker::EndSeeding(bool seeded_all_origins) {
+  DCHECK(is_seeding_);
+  is_seeding_ = false;
+  for (ClientTrackerMap::iterator iter = client_tracker_map_.begin();
+       iter != client_tracker_map_.end(); ++iter) {
+    iter->second->EndSeeding(seeded_all_origins);
+  }
+
+  std::vector<base::Closure> requests;
+  requests.swap(pending_requests_);
+  for (std::vector<base::Closure>::const_iterator iter = requests.begin();
+       iter != requests.end(); ++iter) {
+    iter->Run();
+  }
+}
+
+void UsageTracker::ReconcileUsageCache() {
+  DCHECK(!is_seeding_);
+  for (ClientTrackerMap::iterator iter = client_tracker_map_.begin();
+       iter != client_tracker_map_.end(); ++iter) {
+    iter->second->ReconcileUsageCache();
+  }
+}
+
 void UsageTracker::DidGetClientGlobalUsage(StorageType type,
                                            int64 usage,
                                            int64 unlimited_usage) {
@@ -335,6 +441,12 @@ void UsageTracker::DidGetClientHostUsage(const std::string& host,
   }
 }
 
+void UsageTracker::DidChangeOriginUsage(
+    QuotaClient::ID client_id, const GURL& origin, int64 usage) {
+  if (!origin_usage_changed_callback_.is_null())
+    origin_usage_changed_callback_.Run(type_, client_id, origin, usage);
+}
+
 // ClientUsageTracker ----------------------------------------------------
 
 ClientUsageTracker::ClientUsageTracker(
@@ -348,7 +460,9 @@ ClientUsageTracker::ClientUsageTracker(
       global_usage_retrieved_(false),
       global_unlimited_usage_is_valid_(true),
       global_usage_task_(NULL),
-      special_storage_policy_(special_storage_policy) {
+      reconcile_task_(NULL),
+      special_storage_policy_(special_storage_policy),
+      weak_factory_(ALLOW_THIS_IN_INITIALIZER_LIST(this)) {
   DCHECK(tracker_);
   DCHECK(client_);
   if (special_storage_policy_)
@@ -390,12 +504,26 @@ void ClientUsageTracker::UpdateUsageCache(
     const GURL& origin, int64 delta) {
   std::string host = net::GetHostOrSpecFromURL(origin);
   if (cached_hosts_.find(host) != cached_hosts_.end()) {
-    cached_usage_[host][origin] += delta;
+    // The usage seeded for the origin may be stale, or missing if the origin
+    // was not in the ledger, in which case applying the delta to it could
+    // take it below zero.
+    UsageMap& origin_usage = cached_usage_[host];
+    if (unverified_origins_.find(origin) != unverified_origins_.end() ||
+        (seeded_hosts_.find(host) != seeded_hosts_.end() &&
+         origin_usage.find(origin) == origin_usage.end())) {
+      GatherOriginUsage(origin);
+      return;
+    }
+
+    int64& usage = origin_usage[origin];
+    usage += delta;
     global_usage_ += delta;
     if (global_unlimited_usage_is_valid_ && IsStorageUnlimited(origin))
       global_unlimited_usage_ += delta;
-    DCHECK_GE(cached_usage_[host][origin], 0);
+    DCHECK_GE(usage, 0);
     DCHECK_GE(global_usage_, 0);
+    if (delta)
+      tracker_->DidChangeOriginUsage(client_->id(), origin, usage);
     return;
   }
 
@@ -427,6 +555,32 @@ void ClientUsageTracker::GetCachedOrigins(std::set<GURL>* origins) const {
   }
 }
 
+void ClientUsageTracker::SeedUsageCache(const GURL& origin, int64 usage) {
+  std::string host = net::GetHostOrSpecFromURL(origin);
+  int64& cached_usage = cached_usage_[host][origin];
+  global_usage_ += usage - cached_usage;
+  cached_usage = usage;
+  cached_hosts_.insert(host);
+  seeded_hosts_.insert(host);
+  unverified_origins_.insert(origin);
+}
+
+void ClientUsageTracker::EndSeeding(bool seeded_all_origins) {
+  DCHECK(!global_usage_task_);
+  // Recomputed from the cache when it is asked for.
+  global_unlimited_usage_is_valid_ = false;
+  if (seeded_all_origins)
+    global_usage_retrieved_ = true;
+}
+
+void ClientUsageTracker::ReconcileUsageCache() {
+  // There is nothing to reconcile until the cache holds all the origins.
+  if (reconcile_task_ || !global_usage_retrieved_)
+    return;
+  reconcile_task_ = new ReconcileUsageTask(tracker_, client_);
+  reconcile_task_->Start();
+}
+
 void ClientUsageTracker::AddCachedOrigin(
     const GURL& origin, int64 usage) {
   std::string host = net::GetHostOrSpecFromURL(origin);
@@ -434,11 +588,13 @@ void ClientUsageTracker::AddCachedOrigin(
       insert(UsageMap::value_type(origin, 0)).first;
   int64 old_usage = iter->second;
   iter->second = usage;
+  unverified_origins_.erase(origin);
   int64 delta = usage - old_usage;
   if (delta) {
     global_usage_ += delta;
     if (global_unlimited_usage_is_valid_ && IsStorageUnlimited(origin))
       global_unlimited_usage_ += delta;
+    tracker_->DidChangeOriginUsage(client_->id(), origin, usage);
   }
   DCHECK_GE(iter->second, 0);
   DCHECK_GE(global_usage_, 0);
@@ -453,6 +609,7 @@ void ClientUsageTracker::GatherGlobalUsageComplete() {
   global_usage_task_ = NULL;
   // TODO(kinuko): Record when it has retrieved the global usage.
   global_usage_retrieved_ = true;
+  seeded_hosts_.clear();
 
   DCHECK(global_usage_callback_.HasCallbacks());
   global_usage_callback_.Run(type_, global_usage_,
@@ -471,6 +628,41 @@ void ClientUsageTracker::GatherHostUsageComplete(const std::string& host) {
   host_usage_callbacks_.Run(host, host, type_, GetCachedHostUsage(host));
 }
 
+void ClientUsageTracker::ReconcileUsageComplete() {
+  DCHECK(reconcile_task_ != NULL);
+  reconcile_task_ = NULL;
+
+  // The client did not report the origins which are still unverified, so
+  // their data is gone.
+  std::set<GURL> unverified_origins;
+  unverified_origins.swap(unverified_origins_);
+  for (std::set<GURL>::const_iterator iter = unverified_origins.begin();
+       iter != unverified_origins.end(); ++iter) {
+    AddCachedOrigin(*iter, 0);
+  }
+  seeded_hosts_.clear();
+}
+
+void ClientUsageTracker::GatherOriginUsage(const GURL& origin) {
+  // The usage the client reports includes the changes made until then.
+  if (!origins_being_gathered_.insert(origin).second)
+    return;
+  client_->GetOriginUsage(
+      origin, type_,
+      base::Bind(&ClientUsageTracker::DidGatherOriginUsage,
+                 weak_factory_.GetWeakPtr(), origin));
+}
+
+void ClientUsageTracker::DidGatherOriginUsage(const GURL& origin,
+                                              int64 usage) {
+  origins_being_gathered_.erase(origin);
+  // Defend against confusing inputs from QuotaClients.
+  DCHECK_GE(usage, 0);
+  if (usage < 0)
+    usage = 0;
+  AddCachedOrigin(origin, usage);
+}
+
 int64 ClientUsageTracker::GetCachedHostUsage(const std::string& host) const {
   HostUsageMap::const_iterator found = cached_usage_.find(host);
   if (found == cached_usage_.end())
@@ -10,6 +10,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/callback.h"
@@ -30,6 +31,13 @@ class ClientUsageTracker;
 // An instance of this class is created per storage type.
 class UsageTracker : public QuotaTaskObserver {
  public:
+  // Called with the new usage of |origin| for |client_id| whenever the
+  // cached usage changes.
+  typedef base::Callback<void(StorageType,
+                              QuotaClient::ID,
+                              const GURL&,
+                              int64)> OriginUsageChangedCallback;
+
   UsageTracker(const QuotaClientList& clients, StorageType type,
                SpecialStoragePolicy* special_storage_policy);
   virtual ~UsageTracker();
@@ -46,9 +54,32 @@ class UsageTracker : public QuotaTaskObserver {
   void GetCachedOrigins(std::set<GURL>* origins) const;
   bool IsWorking() const {
     return global_usage_callbacks_.HasCallbacks() ||
-           host_usage_callbacks_.HasAnyCallbacks();
+           host_usage_callbacks_.HasAnyCallbacks() ||
+           is_seeding_;
+  }
+
+  void set_origin_usage_changed_callback(
+      const OriginUsageChangedCallback& callback) {
+    origin_usage_changed_callback_ = callback;
   }
 
+  // Seeding fills the cache with usage recorded earlier instead of asking
+  // the clients for it. Usage requests and updates made in between
+  // BeginSeeding() and EndSeeding() are held back until the cache has been
+  // seeded. If |seeded_all_origins| is true, the seeded origins are taken
+  // to be all the origins with data, so the global usage is served from the
+  // cache.
+  void BeginSeeding();
+  void SeedUsageCache(QuotaClient::ID client_id,
+                      const GURL& origin,
+                      int64 usage);
+  void EndSeeding(bool seeded_all_origins);
+
+  // Asks the clients for the usage of the seeded origins and of any origins
+  // missing from the cache, and corrects the cache with it. The cached usage
+  // is served in the meantime.
+  void ReconcileUsageCache();
+
  private:
   struct TrackingInfo {
     TrackingInfo() : pending_clients(0), usage(0), unlimited_usage(0) {}
@@ -65,6 +96,9 @@ class UsageTracker : public QuotaTaskObserver {
   void DidGetClientHostUsage(const std::string& host,
                              StorageType type,
                              int64 usage);
+  void DidChangeOriginUsage(QuotaClient::ID client_id,
+                            const GURL& origin,
+                            int64 usage);
 
   const StorageType type_;
   ClientTrackerMap client_tracker_map_;
@@ -74,6 +108,12 @@ class UsageTracker : public QuotaTaskObserver {
   GlobalUsageCallbackQueue global_usage_callbacks_;
   HostUsageCallbackMap host_usage_callbacks_;
 
+  OriginUsageChangedCallback origin_usage_changed_callback_;
+
+  bool is_seeding_;
+  // Requests made while seeding, run in order by EndSeeding().
+  std::vector<base::Closure> pending_requests_;
+
   base::WeakPtrFactory<UsageTracker> weak_factory_;
   DISALLOW_COPY_AND_ASSIGN(UsageTracker);
 };
@@ -95,6 +135,11 @@ class ClientUsageTracker : public SpecialStoragePolicy::Observer,
   void GetCachedHostsUsage(std::map<std::string, int64>* host_usage) const;
   void GetCachedOrigins(std::set<GURL>* origins) const;
 
+  // See UsageTracker.
+  void SeedUsageCache(const GURL& origin, int64 usage);
+  void EndSeeding(bool seeded_all_origins);
+  void ReconcileUsageCache();
+
  private:
   typedef std::set<std::string> HostSet;
   typedef std::map<GURL, int64> UsageMap;
@@ -103,6 +148,7 @@ class ClientUsageTracker : public SpecialStoragePolicy::Observer,
   class GatherUsageTaskBase;
   class GatherGlobalUsageTask;
   class GatherHostUsageTask;
+  class ReconcileUsageTask;
 
   // Methods used by our GatherUsage tasks, as a task makes progress
   // origins and hosts are added incrementally to the cache.
@@ -110,6 +156,12 @@ class ClientUsageTracker : public SpecialStoragePolicy::Observer,
   void AddCachedHost(const std::string& host);
   void GatherGlobalUsageComplete();
   void GatherHostUsageComplete(const std::string& host);
+  void ReconcileUsageComplete();
+
+  // Asks the client for the usage of |origin|, whose cached usage can't be
+  // updated by a delta, and caches it.
+  void GatherOriginUsage(const GURL& origin);
+  void DidGatherOriginUsage(const GURL& origin, int64 usage);
 
   int64 GetCachedHostUsage(const std::string& host) const;
   int64 GetCachedGlobalUnlimitedUsage();
@@ -128,14 +180,23 @@ class ClientUsageTracker : public SpecialStoragePolicy::Observer,
   bool global_unlimited_usage_is_valid_;
   HostSet cached_hosts_;
   HostUsageMap cached_usage_;
+  // Seeded origins whose usage has not been gathered from the client since.
+  std::set<GURL> unverified_origins_;
+  // Seeded hosts which may have origins missing from the cache, until the
+  // origins of the client are all gathered.
+  HostSet seeded_hosts_;
+  // Origins whose usage is being gathered by GatherOriginUsage().
+  std::set<GURL> origins_being_gathered_;
 
   GatherGlobalUsageTask* global_usage_task_;
+  ReconcileUsageTask* reconcile_task_;
   GlobalUsageCallbackQueue global_usage_callback_;
   std::map<std::string, GatherHostUsageTask*> host_usage_tasks_;
   HostUsageCallbackMap host_usage_callbacks_;
 
   scoped_refptr<SpecialStoragePolicy> special_storage_policy_;
 
+  base::WeakPtrFactory<ClientUsageTracker> weak_factory_;
   DISALLOW_COPY_AND_ASSIGN(ClientUsageTracker);
 };
 